@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <tbx/constructor_wrapper.h>
 #include "opque.h"
+#include "mq_portal.h"
 
 #ifdef ACCRE_CONSTRUCTOR_PREPRAGMA_ARGS
 #pragma ACCRE_CONSTRUCTOR_PREPRAGMA_ARGS(gop_construct_fn)
@@ -23,9 +24,11 @@ static void gop_construct_fn() {
     apr_status_t ret = apr_initialize();
     assert(ret == APR_SUCCESS);
     init_opque_system();
+    mq_msg_pool_init();
 }
 
 static void gop_destruct_fn() { 
+    mq_msg_pool_destroy();
     destroy_opque_system();
     apr_terminate();
 }
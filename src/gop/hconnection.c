@@ -86,6 +86,11 @@ void close_hc(host_connection_t *hc, int quick)
     apr_status_t value;
     host_portal_t *hp;
 
+    if (hc->epoll_loop != NULL) {  //** Driven by the epoll engine so no threads to poke
+        hc_epoll_close(hc, quick);
+        return;
+    }
+
     //** Trigger the send thread to shutdown which also closes the recv thread
     log_printf(15, "close_hc: Closing ns=%d\n", tbx_ns_getid(hc->ns));
     lock_hc(hc);
@@ -651,6 +656,15 @@ int create_host_connection(host_portal_t *hp)
 
     recv_err = 0;
 
+    if (hp->context->epoll_threads > 0) {  //** Multiplex it on the epoll engine instead
+        apr_thread_mutex_lock(hp->context->lock);
+        if (hp->context->epoll == NULL) hp->context->epoll = hc_epoll_create(hp->context->epoll_threads);
+        apr_thread_mutex_unlock(hp->context->lock);
+
+        log_printf(3, "additional epoll connection host=%s:%d\n", hp->host, hp->port);
+        return(hc_epoll_create_connection(hp->context->epoll, hc));
+    }
+
     log_printf(3, "additional connection host=%s:%d\n", hp->host, hp->port);
     tbx_thread_create_warn(send_err, &(hc->send_thread), NULL, hc_send_thread, (void *)hc, hc->mpool);
 
@@ -0,0 +1,1104 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*************************************************************
+// epoll connection engine for the host portals.
+//
+// Instead of a send and recv thread per connection the sockets are spread
+// over a few I/O loops waiting on epoll.  Each connection is a small state
+// machine.  When it has a command staged and the socket is writable it needs
+// send_command()/send_phase(), and when the socket is readable it needs
+// recv_phase() for the oldest pending command.  The phases still use the
+// blocking tbx_ns calls with their own timeouts so the loop hands them to a
+// pool of phase threads instead of running them itself.  The socket is
+// registered EPOLLONESHOT so it stays quiet while a phase thread owns it, and
+// the phase thread kicks the connection back to the loop when it's done.
+// Staging, retiring, and rearming the socket are only done by the loop.
+// connect() is blocking so it is done by a small set of connector threads
+// which then hand the socket to its loop.
+//*************************************************************
+
+#define _log_module_index 227
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <tbx/assert_result.h>
+#include <apr_pools.h>
+#include <apr_thread_proc.h>
+#include <apr_thread_mutex.h>
+#include <apr_thread_cond.h>
+#include <apr_time.h>
+#include <tbx/apr_wrapper.h>
+#include <tbx/atomic_counter.h>
+#include <tbx/log.h>
+#include <tbx/network.h>
+#include <tbx/stack.h>
+#include <tbx/type_malloc.h>
+#include "opque.h"
+#include "host_portal.h"
+
+#define HC_EPOLL_MAX_EVENTS 256
+#define HC_EPOLL_CONNECTORS 4    //** Connector threads per I/O loop
+#define HC_EPOLL_PHASERS 16      //** Max phase threads per I/O loop.  They're started on demand
+
+#define HC_EPOLL_IDLE   0        //** hc->epoll_busy states.  The loop owns the connection
+#define HC_EPOLL_PHASE  1        //** A phase thread owns it
+#define HC_EPOLL_DONE   2        //** Phase finished and it's back with the loop
+#define HC_EPOLL_RETIRE 3        //** Phase finished and wants the connection retired
+
+typedef struct hc_epoll_loop_s hc_epoll_loop_t;
+
+struct hc_epoll_loop_s {
+    hc_epoll_t *ep;
+    apr_thread_t *thread;
+    apr_thread_mutex_t *lock;  //** Protects the kick list and shutdown
+    tbx_stack_t *kick;         //** Connections needing attention from other threads
+    tbx_stack_t *conns;        //** Connections registered with epoll.  Only touched by the loop
+    tbx_stack_t *retired;      //** Retired connections waiting to be handed back for reaping
+    int epfd;
+    int wakefd;
+    int shutdown;
+};
+
+struct hc_epoll_s {
+    apr_pool_t *mpool;
+    apr_thread_mutex_t *lock;  //** Protects the connect que and shutdown
+    apr_thread_cond_t *cond;
+    tbx_stack_t *connect_que;  //** New connections waiting on a connector
+    apr_thread_t **connector;
+    apr_thread_cond_t *phase_cond;
+    tbx_stack_t *phase_que;    //** Connections with a send or recv phase to run.  Also protected by lock
+    apr_thread_t **phaser;
+    hc_epoll_loop_t *loop;
+    tbx_atomic_unit32_t next_loop;
+    int n_loops;
+    int n_connectors;
+    int n_phasers;
+    int n_phasers_idle;
+    int max_phasers;
+    int shutdown;
+    int phase_shutdown;
+};
+
+void _hc_epoll_retire(hc_epoll_loop_t *loop, host_connection_t *hc, op_generic_t *hsop, apr_time_t cmd_pause_time);
+
+//*************************************************************
+// _hc_epoll_wake - Wakes up the I/O loop
+//*************************************************************
+
+void _hc_epoll_wake(hc_epoll_loop_t *loop)
+{
+    uint64_t one = 1;
+
+    if (write(loop->wakefd, &one, sizeof(one)) < 0) {
+        if (errno != EAGAIN) log_printf(0, "ERROR: Unable to wake the I/O loop errno=%d\n", errno);
+    }
+}
+
+//*************************************************************
+// _hc_epoll_kick - Flags the connection for a look by its I/O loop
+//*************************************************************
+
+void _hc_epoll_kick(host_connection_t *hc)
+{
+    hc_epoll_loop_t *loop = hc->epoll_loop;
+    int wake = 0;
+
+    apr_thread_mutex_lock(loop->lock);
+    if (hc->epoll_kicked == 0) {
+        hc->epoll_kicked = 1;
+        tbx_stack_push(loop->kick, (void *)hc);
+        wake = 1;
+    }
+    apr_thread_mutex_unlock(loop->lock);
+
+    if (wake == 1) _hc_epoll_wake(loop);
+}
+
+//*************************************************************
+// hc_epoll_kick_hportal - Kicks all the epoll driven connections for
+//    the host since new work has arrived.
+//    NOTE: The hportal lock should be held
+//*************************************************************
+
+void hc_epoll_kick_hportal(host_portal_t *hp)
+{
+    host_connection_t *hc;
+
+    tbx_stack_move_to_top(hp->conn_list);
+    while ((hc = (host_connection_t *)tbx_stack_get_current_data(hp->conn_list)) != NULL) {
+        if (hc->epoll_loop != NULL) _hc_epoll_kick(hc);
+        tbx_stack_move_down(hp->conn_list);
+    }
+}
+
+//*************************************************************
+// _hc_epoll_update - Updates the events we're listening for and rearms the
+//    socket.  We only ask for writability if there's a command waiting to go out.
+//*************************************************************
+
+void _hc_epoll_update(hc_epoll_loop_t *loop, host_connection_t *hc)
+{
+    struct epoll_event ev;
+    int events;
+
+    events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    lock_hc(hc);
+    if ((hc->curr_op != NULL) && (hc->shutdown_request == 0)) events |= EPOLLOUT;
+    unlock_hc(hc);
+
+    ev.events = events;
+    ev.data.ptr = hc;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_MOD, hc->epoll_fd, &ev) != 0) {
+        log_printf(0, "ERROR: epoll_ctl failed ns=%d errno=%d\n", tbx_ns_getid(hc->ns), errno);
+        return;
+    }
+    hc->epoll_events = events;
+}
+
+//*************************************************************
+// _hc_epoll_start_timer - Starts the timer on the oldest outstanding command
+//*************************************************************
+
+void _hc_epoll_start_timer(host_connection_t *hc)
+{
+    op_generic_t *hsop;
+    command_op_t *hop;
+
+    lock_hc(hc);
+    tbx_stack_move_to_bottom(hc->pending_stack);
+    hsop = (op_generic_t *)tbx_stack_get_current_data(hc->pending_stack);
+    if (hsop == NULL) hsop = hc->curr_op;
+    if (hsop != NULL) {
+        hop = &(hsop->op->cmd);
+        if (tbx_atomic_get(hop->on_top) == 0) {
+            lock_gop(hsop);  //** Have to lock the GOP here to prevent accidental reading
+            hop->start_time = apr_time_now();
+            hop->end_time = hop->start_time + hop->timeout;
+            unlock_gop(hsop);
+            tbx_atomic_set(hop->on_top, 1);
+        }
+    }
+    unlock_hc(hc);
+}
+
+//*************************************************************
+// _hc_epoll_stage - Pulls the next command off the host que if the
+//    connection has room for it
+//*************************************************************
+
+void _hc_epoll_stage(host_connection_t *hc)
+{
+    host_portal_t *hp = hc->hp;
+    op_generic_t *hsop;
+    command_op_t *hop;
+    int ready;
+
+    lock_hc(hc);
+    ready = ((hc->curr_op == NULL) && (hc->shutdown_request == 0) && (hc->curr_workload < hp->context->max_workload)) ? 1 : 0;
+    unlock_hc(hc);
+    if (ready == 0) return;
+
+    hportal_lock(hp);
+    hsop = _get_hportal_op(hp);
+    if (hsop != NULL) hp->executing_workload += hsop->op->cmd.workload;  //** Update the executing workload
+    hportal_unlock(hp);
+
+    if (hsop == NULL) return;
+
+    log_printf(5, "Staging new command.. ns=%d gid=%d\n", tbx_ns_getid(hc->ns), gop_id(hsop));
+
+    hop = &(hsop->op->cmd);
+    hop->start_time = apr_time_now();  //** This is changed in the recv phase also
+    hop->end_time = hop->start_time + hop->timeout;
+
+    lock_hc(hc);
+    hc->curr_op = hsop;
+    if (tbx_stack_count(hc->pending_stack) == 0) tbx_atomic_set(hop->on_top, 1);
+    unlock_hc(hc);
+}
+
+//*************************************************************
+// _hc_epoll_send - Sends the staged command.  Same as a pass through
+//    the send thread's loop.  Runs on a phase thread.
+//*************************************************************
+
+void _hc_epoll_send(host_connection_t *hc)
+{
+    tbx_ns_t *ns = hc->ns;
+    op_generic_t *hsop = hc->curr_op;
+    command_op_t *hop = &(hsop->op->cmd);
+    op_status_t finished;
+
+    finished = (hop->send_command != NULL) ? hop->send_command(hsop, ns) : op_success_status;
+    log_printf(5, "after send command.. ns=%d gid=%d finished=%d\n", tbx_ns_getid(ns), gop_id(hsop), finished.op_status);
+    if (finished.op_status != OP_STATE_SUCCESS) {  //** Leave it as curr_op so it's resubmitted when we retire
+        lock_hc(hc);
+        hc->shutdown_request = 1;
+        unlock_hc(hc);
+        return;
+    }
+
+    lock_hc(hc);
+    hc->last_used = apr_time_now();
+    hc->curr_workload += hop->workload;  //** Inc the current workload
+    if (tbx_atomic_get(hop->on_top) == 0) {
+        if (tbx_stack_count(hc->pending_stack) == 0) {
+            tbx_atomic_set(hop->on_top, 1);
+            hop->start_time = apr_time_now();  //** This is the real start/end time now
+            hop->end_time = hop->start_time + hop->timeout;
+        }
+    }
+    unlock_hc(hc);
+
+    finished = (hop->send_phase != NULL) ? hop->send_phase(hsop, ns) : op_success_status;
+    log_printf(5, "after send phase.. ns=%d gid=%d finished=%d\n", tbx_ns_getid(ns), gop_id(hsop), finished.op_status);
+
+    //** Always push the command on the pending stack even on a failure to collect the return code
+    lock_hc(hc);
+    hc->last_used = apr_time_now();
+    tbx_stack_push(hc->pending_stack, (void *)hsop);
+    hc->curr_op = NULL;
+    if (finished.op_status != OP_STATE_SUCCESS) {
+        hc->shutdown_request = 1;
+    } else if (hc->start_stable == 0) {
+        log_printf(5, "ns=%d start_stable=0 using non-persistent sockets Shutting down!\n", tbx_ns_getid(ns));
+        hc->shutdown_request = 1;
+    }
+    unlock_hc(hc);
+}
+
+//*************************************************************
+// _hc_epoll_recv - Runs the recv phase for the oldest pending command.
+//    Runs on a phase thread.  Returns 1 if the connection should be retired
+//    with epoll_retire_op and epoll_retire_pause set for the loop.
+//*************************************************************
+
+int _hc_epoll_recv(host_connection_t *hc)
+{
+    host_portal_t *hp = hc->hp;
+    tbx_ns_t *ns = hc->ns;
+    op_generic_t *hsop;
+    command_op_t *hop;
+    op_status_t status;
+
+    lock_hc(hc);
+    tbx_stack_move_to_bottom(hc->pending_stack);
+    hsop = (op_generic_t *)tbx_stack_get_current_data(hc->pending_stack);
+    unlock_hc(hc);
+
+    if (hsop == NULL) return(0);
+
+    hop = &(hsop->op->cmd);
+    if (tbx_atomic_inc(hop->on_top) == 0) {
+        hop->start_time = apr_time_now();  //**Start the timer
+        hop->end_time = hop->start_time + hop->timeout;
+    }
+
+    log_printf(5, "before recv phase.. ns=%d gid=%d\n", tbx_ns_getid(ns), gop_id(hsop));
+    status = (hop->recv_phase != NULL) ? hop->recv_phase(hsop, ns) : op_success_status;
+    hop->end_time = apr_time_now();
+    log_printf(5, "after recv phase.. ns=%d gid=%d finished=%d\n", tbx_ns_getid(ns), gop_id(hsop), status.op_status);
+
+    //** dec the current workload
+    hportal_lock(hp);
+    hp->executing_workload -= hop->workload;
+    hportal_unlock(hp);
+
+    lock_hc(hc);
+    hc->last_used = apr_time_now();
+    hc->curr_workload -= hop->workload;
+    tbx_stack_move_to_bottom(hc->pending_stack);
+    tbx_stack_delete_current(hc->pending_stack, 1, 0);
+    unlock_hc(hc);
+
+    if ((status.op_status == OP_STATE_RETRY) && (hop->retry_count > 0)) {
+        log_printf(5, "Dead socket so shutting down ns=%d retry in " TT " usec\n", tbx_ns_getid(ns), hop->retry_wait);
+        hc->epoll_retire_op = hsop;
+        hc->epoll_retire_pause = hop->retry_wait;
+        return(1);
+    } else if ((status.op_status == OP_STATE_TIMEOUT) && (hop->retry_count > 0)) {
+        hop->retry_count--;
+        log_printf(5, "Command timed out.  Retrying.. retry_count=%d  ns=%d gid=%d\n", hop->retry_count, tbx_ns_getid(ns), gop_id(hsop));
+        hc->epoll_retire_op = hsop;
+        hc->epoll_retire_pause = 0;
+        return(1);
+    }
+
+    log_printf(15, "marking op as completed status=%d retry_count=%d ns=%d gid=%d\n", status.op_status, hop->retry_count, tbx_ns_getid(ns), gop_id(hsop));
+    gop_mark_completed(hsop, status);
+
+    //**Update the number of commands processed **
+    lock_hc(hc);
+    hc->cmd_count++;
+    unlock_hc(hc);
+
+    hportal_lock(hp);
+    hp->cmds_processed++;
+    hportal_unlock(hp);
+
+    return(0);
+}
+
+//*************************************************************
+// _hc_epoll_finished - Checks if the connection should be retired
+//*************************************************************
+
+int _hc_epoll_finished(host_connection_t *hc)
+{
+    apr_time_t dtime;
+    int done;
+
+    lock_hc(hc);
+    if ((tbx_stack_count(hc->pending_stack) == 0) && (hc->curr_op == NULL) && (hc->shutdown_request == 0)) {
+        dtime = apr_time_now() - hc->last_used; //** Exit if not busy
+        if (dtime >= hc->hp->context->min_idle) {
+            hc->shutdown_request = 1;
+            log_printf(5, "ns=%d min_idle(" TT ") reached.  Shutting down! dtime=" TT "\n",
+                       tbx_ns_getid(hc->ns), hc->hp->context->min_idle, dtime);
+        }
+    }
+    done = ((hc->shutdown_request != 0) && (tbx_stack_count(hc->pending_stack) == 0)) ? 1 : 0;
+    unlock_hc(hc);
+
+    return(done);
+}
+
+//*************************************************************
+// _hc_epoll_phase - Runs the blocking phases the loop handed off and
+//    gives the connection back to the loop.  Runs on a phase thread.
+//*************************************************************
+
+void _hc_epoll_phase(host_connection_t *hc)
+{
+    int n, retire;
+
+    retire = 0;
+    if (hc->epoll_job & EPOLLIN) {  //** Handle every response we have data for.  Some may already be sitting in the ns buffer
+        do {
+            if (_hc_epoll_recv(hc) != 0) {
+                retire = 1;
+                break;
+            }
+            lock_hc(hc);
+            n = tbx_stack_count(hc->pending_stack);
+            unlock_hc(hc);
+        } while ((n > 0) && (tbx_ns_read_pending(hc->ns) > 0));
+    }
+
+    if ((retire == 0) && (hc->epoll_job & EPOLLOUT)) _hc_epoll_send(hc);
+
+    lock_hc(hc);
+    hc->epoll_busy = (retire == 1) ? HC_EPOLL_RETIRE : HC_EPOLL_DONE;
+    unlock_hc(hc);
+
+    _hc_epoll_kick(hc);
+}
+
+//*************************************************************
+// _hc_epoll_phaser - Phase thread
+//*************************************************************
+
+void *_hc_epoll_phaser(apr_thread_t *th, void *data)
+{
+    hc_epoll_t *ep = (hc_epoll_t *)data;
+    host_connection_t *hc;
+
+    apr_thread_mutex_lock(ep->lock);
+    while (1) {
+        hc = (host_connection_t *)tbx_stack_pop(ep->phase_que);
+        if (hc != NULL) {
+            apr_thread_mutex_unlock(ep->lock);
+            _hc_epoll_phase(hc);
+            apr_thread_mutex_lock(ep->lock);
+        } else if (ep->phase_shutdown == 1) {
+            break;
+        } else {
+            ep->n_phasers_idle++;
+            apr_thread_cond_wait(ep->phase_cond, ep->lock);
+            ep->n_phasers_idle--;
+        }
+    }
+    apr_thread_mutex_unlock(ep->lock);
+
+    apr_thread_exit(th, 0);
+    return(NULL);
+}
+
+//*************************************************************
+// _hc_epoll_phase_submit - Hands the connection to a phase thread.  The
+//    socket is left disarmed until it comes back.
+//*************************************************************
+
+void _hc_epoll_phase_submit(hc_epoll_t *ep, host_connection_t *hc, int job)
+{
+    lock_hc(hc);
+    hc->epoll_busy = HC_EPOLL_PHASE;
+    hc->epoll_job = job;
+    unlock_hc(hc);
+
+    apr_thread_mutex_lock(ep->lock);
+    tbx_stack_move_to_bottom(ep->phase_que);
+    tbx_stack_insert_below(ep->phase_que, (void *)hc);
+    if ((tbx_stack_count(ep->phase_que) > ep->n_phasers_idle) && (ep->n_phasers < ep->max_phasers)) {
+        tbx_thread_create_assert(&(ep->phaser[ep->n_phasers]), NULL, _hc_epoll_phaser, (void *)ep, ep->mpool);
+        ep->n_phasers++;
+    }
+    apr_thread_cond_signal(ep->phase_cond);
+    apr_thread_mutex_unlock(ep->lock);
+}
+
+//*************************************************************
+// _hc_epoll_service - Advances the connection's state machine given the
+//    socket events.  Returns 1 if the connection was retired.
+//*************************************************************
+
+int _hc_epoll_service(hc_epoll_loop_t *loop, host_connection_t *hc, int events)
+{
+    int n, busy, job;
+
+    lock_hc(hc);
+    busy = hc->epoll_busy;
+    if (busy != HC_EPOLL_PHASE) hc->epoll_busy = HC_EPOLL_IDLE;
+    unlock_hc(hc);
+
+    if (busy == HC_EPOLL_PHASE) return(0);  //** A phase thread has it and will kick us when done
+    if (busy == HC_EPOLL_RETIRE) {  //** The recv phase wants it shut down
+        _hc_epoll_retire(loop, hc, hc->epoll_retire_op, hc->epoll_retire_pause);
+        return(1);
+    }
+
+    job = 0;
+    if (events & (EPOLLIN|EPOLLERR|EPOLLHUP|EPOLLRDHUP)) {
+        lock_hc(hc);
+        n = tbx_stack_count(hc->pending_stack);
+        unlock_hc(hc);
+
+        if (n == 0) {  //** Nothing outstanding so the other side closed on us
+            log_printf(5, "Socket closed with nothing pending ns=%d events=%d\n", tbx_ns_getid(hc->ns), events);
+            _hc_epoll_retire(loop, hc, NULL, 0);
+            return(1);
+        }
+        job |= EPOLLIN;
+    }
+
+    if ((events & EPOLLOUT) && (hc->curr_op != NULL) && (hc->shutdown_request == 0)) job |= EPOLLOUT;
+
+    if (job != 0) {  //** The phases block so they don't run on the loop
+        _hc_epoll_phase_submit(loop->ep, hc, job);
+        return(0);
+    }
+
+    _hc_epoll_stage(hc);
+    _hc_epoll_start_timer(hc);
+
+    if (_hc_epoll_finished(hc) == 1) {
+        _hc_epoll_retire(loop, hc, NULL, 0);
+        return(1);
+    }
+
+    _hc_epoll_update(loop, hc);
+
+    return(0);
+}
+
+//*************************************************************
+// _hc_epoll_register - Adds a newly connected socket to the loop
+//*************************************************************
+
+void _hc_epoll_register(hc_epoll_loop_t *loop, host_connection_t *hc)
+{
+    struct epoll_event ev;
+
+    if (hc->net_connect_status != 0) {  //** connect() failed so just clean up
+        _hc_epoll_retire(loop, hc, NULL, 0);
+        return;
+    }
+
+    ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+    ev.data.ptr = hc;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, hc->epoll_fd, &ev) != 0) {
+        log_printf(0, "ERROR: Unable to add ns=%d to epoll errno=%d\n", tbx_ns_getid(hc->ns), errno);
+        _hc_epoll_retire(loop, hc, NULL, 0);
+        return;
+    }
+
+    hc->epoll_events = ev.events;
+    tbx_stack_push(loop->conns, (void *)hc);
+    hc->epoll_pos = tbx_stack_get_current_ptr(loop->conns);
+    hc->epoll_check_time = apr_time_now() + apr_time_make(hc->hp->context->check_connection_interval, 0);
+
+    _hc_epoll_service(loop, hc, 0);
+}
+
+//*************************************************************
+// _hc_epoll_retire - Shuts down the connection and resubmits any
+//    unfinished commands.  This is the tail of the recv thread.  The
+//    connection is placed on the retired list and handed back for reaping
+//    once any retry pause has expired.
+//*************************************************************
+
+void _hc_epoll_retire(hc_epoll_loop_t *loop, host_connection_t *hc, op_generic_t *hsop, apr_time_t cmd_pause_time)
+{
+    host_portal_t *hp = hc->hp;
+    portal_context_t *hpc = hp->context;
+    tbx_ns_t *ns = hc->ns;
+    struct epoll_event ev;
+    host_connection_t *khc;
+    op_generic_t *op;
+    apr_time_t pause_until;
+    int64_t cmds_processed;
+    int pending, n;
+
+    //** Stop taking kicks and drop it from epoll
+    apr_thread_mutex_lock(loop->lock);
+    if (hc->epoll_kicked == 1) {
+        tbx_stack_move_to_top(loop->kick);
+        while ((khc = (host_connection_t *)tbx_stack_get_current_data(loop->kick)) != NULL) {
+            if (khc == hc) {
+                tbx_stack_delete_current(loop->kick, 0, 0);
+                break;
+            }
+            tbx_stack_move_down(loop->kick);
+        }
+    }
+    hc->epoll_kicked = -1;
+    apr_thread_mutex_unlock(loop->lock);
+
+    if (hc->epoll_pos != NULL) {
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, hc->epoll_fd, &ev);
+        tbx_stack_move_to_ptr(loop->conns, hc->epoll_pos);
+        tbx_stack_delete_current(loop->conns, 1, 0);
+        hc->epoll_pos = NULL;
+    }
+
+    log_printf(5, "Total commands processed: %d (ns=%d, host=%s:%d)\n", hc->cmd_count, tbx_ns_getid(ns), hp->host, hp->port);
+
+    lock_hc(hc);
+    hpc->fn->close_connection(ns);
+    hc->curr_workload = 0;
+    hc->shutdown_request = 1;
+    hc->send_down = 1;  //** Notify anybody listening that the send side is down.
+    apr_thread_cond_broadcast(hc->send_cond);
+    unlock_hc(hc);
+
+    modify_hpc_thread_count(hpc, -1);
+
+    pending = 0;  //** This is used to decide if we should adjust tuning
+
+    //** Push any existing commands to be retried back on the stack **
+    if (hc->net_connect_status != 0) {  //** The connection failed
+        hportal_lock(hp);
+        cmds_processed = hc->epoll_start_cmds - hp->cmds_processed;
+        if (cmds_processed == 0) {  //** Nothing was processed
+            if (hp->n_conn == 1) {  //** I'm the last one to try and fail to connect so fail all the tasks
+                _hp_fail_tasks(hp, op_cant_connect_status);
+            } else if (hp->failed_conn_attempts > hp->abort_conn_attempts) { //** Can't connect so fail
+                log_printf(1, "ns=%d failing all commands failed_conn_attempts=%d\n", tbx_ns_getid(ns), hp->failed_conn_attempts);
+                _hp_fail_tasks(hp, op_cant_connect_status);
+            }
+        }
+        hportal_unlock(hp);
+    } else {
+        if (hc->curr_op != NULL) {  //** Staged but never sent
+            log_printf(15, "ns=%d Pushing staged task on stack gid=%d\n", tbx_ns_getid(ns), gop_id(hc->curr_op));
+            submit_hportal(hp, hc->curr_op, 1, 0);
+            hc->curr_op = NULL;
+            pending = 1;
+        }
+        if (hsop != NULL) {  //** This is the command being received
+            log_printf(15, "ns=%d Pushing current recving task on stack gid=%d\n", tbx_ns_getid(ns), gop_id(hsop));
+            hsop->op->cmd.retry_count--;  //** decr in case this command is a problem
+            submit_hportal(hp, hsop, 1, 0);
+            pending = 1;
+        }
+
+        //** and everything else on the pending_stack
+        while ((op = (op_generic_t *)tbx_stack_pop(hc->pending_stack)) != NULL) {
+            submit_hportal(hp, op, 1, 0);
+            pending = 1;
+        }
+    }
+
+    hportal_lock(hp);
+
+    //** Now remove myself from the hportal
+    hp->oops_send_end++;
+    hp->oops_recv_end++;
+    if (hp->n_conn < 0) hp->oops_neg++;
+    if (hp->n_conn > 0) hp->n_conn--;
+    tbx_stack_move_to_ptr(hp->conn_list, hc->my_pos);
+    tbx_stack_delete_current(hp->conn_list, 1, 0);
+
+    log_printf(6, "ns=%d cmd_pause_time=" TT " max_wait=%d pending=%d sleeping=%d start_stable=%d cmd_count=%d\n", tbx_ns_getid(ns), cmd_pause_time, hp->context->max_wait, pending, hp->sleeping_conn, hc->start_stable, hc->cmd_count);
+
+    if (pending == 1) {  //** My connection was lost so update tuning params
+        hp->stable_conn = hp->n_conn;
+        if (hc->cmd_count < 2) hp->stable_conn--;
+        if (hp->stable_conn < 0) hp->stable_conn = 0;
+
+        if (hp->sleeping_conn > 0) cmd_pause_time = 0;  //** If already sleeping don't adjust pause time and sleep as well
+
+        if (cmd_pause_time > 0) {
+            if (cmd_pause_time > apr_time_make(hp->context->max_wait, 0)) cmd_pause_time = apr_time_make(hp->context->max_wait, 0);
+
+            //** Check if we push out the check_hportal_connections check as well
+            pause_until = apr_time_now() + cmd_pause_time;
+            if ( hp->pause_until < pause_until) hp->pause_until = pause_until;
+        }
+
+        if ((hc->start_stable == 0) && (hc->cmd_count > 0)) cmd_pause_time = 0;
+    }
+    n = hp->n_conn;
+
+    hp->closing_conn++;
+    if (cmd_pause_time > 0) hp->sleeping_conn++;
+    hportal_unlock(hp);
+
+    //** The send/recv threads would sleep here.  We just hold on to it until the pause expires
+    hc->epoll_paused = (cmd_pause_time > 0) ? 1 : 0;
+    hc->epoll_pause_until = ((cmd_pause_time > 0) && (n <= 0)) ? apr_time_now() + cmd_pause_time : 0;
+    tbx_stack_push(loop->retired, (void *)hc);
+
+    log_printf(6, "ns=%d cmd_pause_time=" TT " n_conn=%d\n", tbx_ns_getid(ns), cmd_pause_time, n);
+}
+
+//*************************************************************
+// _hc_epoll_release - Hands a retired connection back to the hportal for reaping
+//*************************************************************
+
+void _hc_epoll_release(host_connection_t *hc)
+{
+    host_portal_t *hp = hc->hp;
+
+    if (hc->epoll_paused == 1) {
+        hportal_lock(hp);
+        hp->sleeping_conn--;
+        hportal_unlock(hp);
+    }
+
+    check_hportal_connections(hp);
+
+    hportal_lock(hp);
+    hp->closing_conn--;
+    tbx_stack_push(hp->closed_que, (void *)hc);
+    hportal_unlock(hp);
+
+    lock_hc(hc);  //** After this the reaper is free to destroy it
+    hc->epoll_done = 1;
+    apr_thread_cond_broadcast(hc->send_cond);
+    unlock_hc(hc);
+}
+
+//*************************************************************
+// _hc_epoll_release_retired - Releases the retired connections whose
+//    pause has expired
+//*************************************************************
+
+void _hc_epoll_release_retired(hc_epoll_loop_t *loop, int force)
+{
+    host_connection_t *hc;
+    apr_time_t now;
+
+    if (tbx_stack_count(loop->retired) == 0) return;
+
+    now = apr_time_now();
+    tbx_stack_move_to_top(loop->retired);
+    while ((hc = (host_connection_t *)tbx_stack_get_current_data(loop->retired)) != NULL) {
+        if ((force == 1) || (hc->epoll_pause_until <= now)) {
+            tbx_stack_delete_current(loop->retired, 0, 0);
+            _hc_epoll_release(hc);
+        } else {
+            tbx_stack_move_down(loop->retired);
+        }
+    }
+}
+
+//*************************************************************
+// _hc_epoll_tick - Periodic pass over the connections.  Handles command
+//    timeouts, idle connections, and the connection count checks.
+//*************************************************************
+
+void _hc_epoll_tick(hc_epoll_loop_t *loop, int shutdown)
+{
+    host_connection_t **list, *hc;
+    op_generic_t *hsop;
+    apr_time_t now;
+    int i, n, events;
+
+    n = tbx_stack_count(loop->conns);
+    if (n == 0) return;
+
+    //** Servicing can retire connections so work off a copy
+    tbx_type_malloc(list, host_connection_t *, n);
+    tbx_stack_move_to_top(loop->conns);
+    for (i=0; i<n; i++) {
+        list[i] = (host_connection_t *)tbx_stack_get_current_data(loop->conns);
+        tbx_stack_move_down(loop->conns);
+    }
+
+    now = apr_time_now();
+    for (i=0; i<n; i++) {
+        hc = list[i];
+        if (hc->epoll_kicked == -1) continue;
+
+        events = 0;
+        lock_hc(hc);
+        if (shutdown == 1) hc->shutdown_request = 1;
+        tbx_stack_move_to_bottom(hc->pending_stack);
+        hsop = (op_generic_t *)tbx_stack_get_current_data(hc->pending_stack);
+        if ((hsop != NULL) && (tbx_atomic_get(hsop->op->cmd.on_top) != 0) && (now > hsop->op->cmd.end_time)) {
+            events = EPOLLIN;  //** Out of time so let recv_phase() time it out
+        }
+        unlock_hc(hc);
+
+        if (_hc_epoll_service(loop, hc, events) == 1) continue;
+
+        if (now > hc->epoll_check_time) {  //** Time for periodic check on # connections
+            log_printf(15, "Checking if we need more connections. ns=%d\n", tbx_ns_getid(hc->ns));
+            check_hportal_connections(hc->hp);
+            hc->epoll_check_time = now + apr_time_make(hc->hp->context->check_connection_interval, 0);
+        }
+    }
+
+    free(list);
+}
+
+//*************************************************************
+// _hc_epoll_loop - I/O loop thread
+//*************************************************************
+
+void *_hc_epoll_loop(apr_thread_t *th, void *data)
+{
+    hc_epoll_loop_t *loop = (hc_epoll_loop_t *)data;
+    struct epoll_event ev[HC_EPOLL_MAX_EVENTS];
+    tbx_stack_t *kicked;
+    host_connection_t *hc;
+    apr_time_t now, next_tick;
+    uint64_t count;
+    int i, n, dt, shutdown;
+
+    kicked = tbx_stack_new();
+    next_tick = apr_time_now() + apr_time_from_sec(1);
+    shutdown = 0;
+
+    while (1) {
+        dt = (tbx_stack_count(loop->retired) > 0) ? 10 : 1000;  //** Poll faster if connections are waiting out a pause
+        n = epoll_wait(loop->epfd, ev, HC_EPOLL_MAX_EVENTS, dt);
+        if ((n < 0) && (errno != EINTR)) log_printf(0, "ERROR: epoll_wait errno=%d\n", errno);
+
+        for (i=0; i<n; i++) {
+            if (ev[i].data.ptr == (void *)loop) {  //** Wakeup from another thread
+                if (read(loop->wakefd, &count, sizeof(count)) < 0) count = 0;
+                continue;
+            }
+
+            hc = (host_connection_t *)ev[i].data.ptr;
+            if (hc->epoll_kicked == -1) continue;  //** Retired earlier in this batch
+            _hc_epoll_service(loop, hc, ev[i].events);
+        }
+
+        //** Grab everything that's been kicked
+        apr_thread_mutex_lock(loop->lock);
+        while ((hc = (host_connection_t *)tbx_stack_pop(loop->kick)) != NULL) {
+            hc->epoll_kicked = 0;
+            tbx_stack_push(kicked, (void *)hc);
+        }
+        shutdown = loop->shutdown;
+        apr_thread_mutex_unlock(loop->lock);
+
+        while ((hc = (host_connection_t *)tbx_stack_pop(kicked)) != NULL) {
+            if (hc->epoll_pos == NULL) {
+                _hc_epoll_register(loop, hc);
+            } else {
+                _hc_epoll_service(loop, hc, 0);
+            }
+        }
+
+        now = apr_time_now();
+        if ((now > next_tick) || (shutdown == 1)) {
+            _hc_epoll_tick(loop, shutdown);
+            next_tick = now + apr_time_from_sec(1);
+        }
+
+        _hc_epoll_release_retired(loop, shutdown);
+
+        if ((shutdown == 1) && (tbx_stack_count(loop->conns) == 0) && (tbx_stack_count(loop->retired) == 0)) break;
+    }
+
+    tbx_stack_free(kicked, 0);
+
+    apr_thread_exit(th, 0);
+    return(NULL);
+}
+
+//*************************************************************
+// _hc_epoll_connect - Makes the connection and hands it to its I/O loop.
+//    This is the start of the send thread.
+//*************************************************************
+
+void _hc_epoll_connect(host_connection_t *hc)
+{
+    host_portal_t *hp = hc->hp;
+    portal_context_t *hpc = hp->context;
+    tbx_ns_t *ns = hc->ns;
+
+    hportal_lock(hp);
+    hp->oops_send_start++;
+    hp->oops_recv_start++;
+    hc->epoll_start_cmds = hp->cmds_processed;  //** Used at the end to decide if retry
+    hportal_unlock(hp);
+
+    //** check if the host is invalid and if so flush the work que
+    if (hp->invalid_host == 1) {
+        log_printf(15, "Invalid host to host=%s:%d.  Emptying Que\n", hp->host, hp->port);
+        empty_hp_que(hp, op_invalid_host_status);
+        hc->net_connect_status = 1;
+    } else {  //** Make the connection
+        hc->net_connect_status = hpc->fn->connect(ns, hp->connect_context, hp->host, hp->port, hp->dt_connect);
+        if (hc->net_connect_status != 0) {
+            log_printf(5, "Can't connect to %s:%d!, ns=%d\n", hp->host, hp->port, tbx_ns_getid(ns));
+        } else {
+            hc->epoll_fd = tbx_ns_native_fd(ns);
+            if (hc->epoll_fd < 0) {
+                log_printf(0, "ERROR: ns=%d has no native socket to poll! host=%s:%d\n", tbx_ns_getid(ns), hp->host, hp->port);
+                hc->net_connect_status = 1;
+            }
+        }
+    }
+
+    log_printf(2, "New connection to host=%s:%d ns=%d status=%d\n", hp->host, hp->port, tbx_ns_getid(ns), hc->net_connect_status);
+
+    //** Store my position in the conn_list **
+    hportal_lock(hp);
+    hc->start_stable = hp->stable_conn;
+
+    if (hc->net_connect_status == 0) {
+        hp->successful_conn_attempts++;
+        hp->failed_conn_attempts = 0;  //** Reset the failed attempts
+    } else {
+        log_printf(1, "ns=%d failing all commands failed_conn_attempts=%d\n", tbx_ns_getid(ns), hp->failed_conn_attempts);
+        hp->failed_conn_attempts++;
+    }
+    tbx_stack_push(hp->conn_list, (void *)hc);
+    hc->my_pos = tbx_stack_get_current_ptr(hp->conn_list);
+    hportal_unlock(hp);
+
+    //** Hand it to the I/O loop.  A failed connection is cleaned up there also.
+    _hc_epoll_kick(hc);
+}
+
+//*************************************************************
+// _hc_epoll_connector - Connector thread
+//*************************************************************
+
+void *_hc_epoll_connector(apr_thread_t *th, void *data)
+{
+    hc_epoll_t *ep = (hc_epoll_t *)data;
+    host_connection_t *hc;
+
+    apr_thread_mutex_lock(ep->lock);
+    while (1) {
+        hc = (host_connection_t *)tbx_stack_pop(ep->connect_que);
+        if (hc != NULL) {
+            apr_thread_mutex_unlock(ep->lock);
+            _hc_epoll_connect(hc);
+            apr_thread_mutex_lock(ep->lock);
+        } else if (ep->shutdown == 1) {
+            break;
+        } else {
+            apr_thread_cond_wait(ep->cond, ep->lock);
+        }
+    }
+    apr_thread_mutex_unlock(ep->lock);
+
+    apr_thread_exit(th, 0);
+    return(NULL);
+}
+
+//*************************************************************
+// hc_epoll_create_connection - Queues a new connection to be made.
+//*************************************************************
+
+int hc_epoll_create_connection(hc_epoll_t *ep, host_connection_t *hc)
+{
+    hc->epoll_loop = &(ep->loop[tbx_atomic_inc(ep->next_loop) % ep->n_loops]);
+    hc->epoll_fd = -1;
+
+    apr_thread_mutex_lock(ep->lock);
+    tbx_stack_move_to_bottom(ep->connect_que);
+    tbx_stack_insert_below(ep->connect_que, (void *)hc);
+    apr_thread_cond_signal(ep->cond);
+    apr_thread_mutex_unlock(ep->lock);
+
+    return(0);
+}
+
+//*************************************************************
+// hc_epoll_wait_done - Waits until the connection has been released
+//*************************************************************
+
+void hc_epoll_wait_done(host_connection_t *hc)
+{
+    lock_hc(hc);
+    while (hc->epoll_done == 0) {
+        apr_thread_cond_wait(hc->send_cond, hc->lock);
+    }
+    unlock_hc(hc);
+}
+
+//*************************************************************
+// hc_epoll_close - Closes an epoll driven connection.  A quick close
+//    doesn't wait since it can come from the I/O loop itself via
+//    check_hportal_connections().
+//*************************************************************
+
+void hc_epoll_close(host_connection_t *hc, int quick)
+{
+    host_portal_t *hp = hc->hp;
+
+    log_printf(15, "Closing ns=%d quick=%d\n", tbx_ns_getid(hc->ns), quick);
+    lock_hc(hc);
+    hc->shutdown_request = 1;
+    unlock_hc(hc);
+
+    _hc_epoll_kick(hc);
+
+    if (quick == 1) {
+        lock_hc(hc);
+        hc->closing = 2;  //** Flag a reaper that I'm done with it
+        unlock_hc(hc);
+        return;
+    }
+
+    hc_epoll_wait_done(hc);
+
+    hportal_lock(hp);
+    _reap_hportal(hp, quick);  //** Clean up the closed connections.  Including hc passed in
+    hportal_unlock(hp);
+}
+
+//*************************************************************
+// hc_epoll_create - Creates the engine and starts the I/O loops
+//*************************************************************
+
+hc_epoll_t *hc_epoll_create(int n_loops)
+{
+    hc_epoll_t *ep;
+    hc_epoll_loop_t *loop;
+    struct epoll_event ev;
+    int i;
+
+    tbx_type_malloc_clear(ep, hc_epoll_t, 1);
+    apr_pool_create(&(ep->mpool), NULL);
+    apr_thread_mutex_create(&(ep->lock), APR_THREAD_MUTEX_DEFAULT, ep->mpool);
+    apr_thread_cond_create(&(ep->cond), ep->mpool);
+    apr_thread_cond_create(&(ep->phase_cond), ep->mpool);
+    ep->connect_que = tbx_stack_new();
+    ep->phase_que = tbx_stack_new();
+    ep->n_loops = n_loops;
+    ep->n_connectors = HC_EPOLL_CONNECTORS * n_loops;
+    ep->max_phasers = HC_EPOLL_PHASERS * n_loops;
+    tbx_type_malloc_clear(ep->phaser, apr_thread_t *, ep->max_phasers);
+
+    tbx_type_malloc_clear(ep->loop, hc_epoll_loop_t, ep->n_loops);
+    for (i=0; i<ep->n_loops; i++) {
+        loop = &(ep->loop[i]);
+        loop->ep = ep;
+        apr_thread_mutex_create(&(loop->lock), APR_THREAD_MUTEX_DEFAULT, ep->mpool);
+        loop->kick = tbx_stack_new();
+        loop->conns = tbx_stack_new();
+        loop->retired = tbx_stack_new();
+        loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+        loop->wakefd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+        assert((loop->epfd != -1) && (loop->wakefd != -1));
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = loop;
+        assert_result(epoll_ctl(loop->epfd, EPOLL_CTL_ADD, loop->wakefd, &ev), 0);
+
+        tbx_thread_create_assert(&(loop->thread), NULL, _hc_epoll_loop, (void *)loop, ep->mpool);
+    }
+
+    tbx_type_malloc_clear(ep->connector, apr_thread_t *, ep->n_connectors);
+    for (i=0; i<ep->n_connectors; i++) {
+        tbx_thread_create_assert(&(ep->connector[i]), NULL, _hc_epoll_connector, (void *)ep, ep->mpool);
+    }
+
+    log_printf(5, "loops=%d connectors=%d\n", ep->n_loops, ep->n_connectors);
+
+    return(ep);
+}
+
+//*************************************************************
+// hc_epoll_destroy - Shuts down the engine.  Any connections still
+//    open are closed.
+//*************************************************************
+
+void hc_epoll_destroy(hc_epoll_t *ep)
+{
+    hc_epoll_loop_t *loop;
+    apr_status_t value;
+    int i;
+
+    apr_thread_mutex_lock(ep->lock);
+    ep->shutdown = 1;
+    apr_thread_cond_broadcast(ep->cond);
+    apr_thread_mutex_unlock(ep->lock);
+
+    for (i=0; i<ep->n_connectors; i++) {
+        apr_thread_join(&value, ep->connector[i]);
+    }
+
+    for (i=0; i<ep->n_loops; i++) {
+        loop = &(ep->loop[i]);
+        apr_thread_mutex_lock(loop->lock);
+        loop->shutdown = 1;
+        apr_thread_mutex_unlock(loop->lock);
+        _hc_epoll_wake(loop);
+
+        apr_thread_join(&value, loop->thread);
+        close(loop->epfd);
+        close(loop->wakefd);
+        tbx_stack_free(loop->kick, 0);
+        tbx_stack_free(loop->conns, 0);
+        tbx_stack_free(loop->retired, 0);
+    }
+
+    //** The loops wait on any phases in flight so the phase threads can go now
+    apr_thread_mutex_lock(ep->lock);
+    ep->phase_shutdown = 1;
+    apr_thread_cond_broadcast(ep->phase_cond);
+    apr_thread_mutex_unlock(ep->lock);
+
+    for (i=0; i<ep->n_phasers; i++) {
+        apr_thread_join(&value, ep->phaser[i]);
+    }
+
+    log_printf(5, "phasers=%d\n", ep->n_phasers);
+
+    tbx_stack_free(ep->connect_que, 0);
+    tbx_stack_free(ep->phase_que, 0);
+    free(ep->phaser);
+    free(ep->connector);
+    free(ep->loop);
+    apr_pool_destroy(ep->mpool);
+    free(ep);
+}
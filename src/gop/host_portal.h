@@ -99,7 +99,23 @@ apr_thread_cond_t *recv_cond;
 apr_thread_t *send_thread; //** Sending thread
 apr_thread_t *recv_thread; //** recving thread
 apr_pool_t   *mpool;       //** MEmory pool for
+struct hc_epoll_loop_s *epoll_loop; //** epoll I/O loop driving the connection or NULL if using send/recv threads
+tbx_stack_ele_t *epoll_pos;    //** My position in the loop's connection list
+int epoll_fd;              //** Native socket registered with epoll
+int epoll_events;          //** Events currently registered
+int epoll_kicked;          //** 1=on the loop's kick list, -1=retired and ignoring kicks
+int epoll_done;            //** Retired and safe to reap
+int epoll_busy;            //** HC_EPOLL_* phase thread state
+int epoll_job;             //** Events the phase thread is handling
+op_generic_t *epoll_retire_op;  //** Command being received when the recv phase asked to retire
+apr_time_t epoll_retire_pause;  //** and its retry pause
+int epoll_paused;          //** Counted in hp->sleeping_conn until epoll_pause_until
+apr_time_t epoll_pause_until;  //** Retry pause before the connection is handed back for reaping
+apr_time_t epoll_check_time;   //** Next periodic check_hportal_connections() call
+int64_t epoll_start_cmds;      //** hp->cmds_processed when the connection was started
 } host_connection_t;
+
+typedef struct hc_epoll_s hc_epoll_t;
  
  
  
@@ -140,6 +156,15 @@ host_connection_t *new_host_connection();
 void destroy_host_connection(host_connection_t *hc);
 void close_hc(host_connection_t *dc, int quick);
 int create_host_connection(host_portal_t *hp);
+void empty_hp_que(host_portal_t *hp, op_status_t err_code);
+
+//** Routines for hconnection_epoll.c
+hc_epoll_t *hc_epoll_create(int n_loops);
+void hc_epoll_destroy(hc_epoll_t *ep);
+int hc_epoll_create_connection(hc_epoll_t *ep, host_connection_t *hc);
+void hc_epoll_close(host_connection_t *hc, int quick);
+void hc_epoll_wait_done(host_connection_t *hc);
+void hc_epoll_kick_hportal(host_portal_t *hp);
  
 #ifdef __cplusplus
 }
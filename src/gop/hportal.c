@@ -166,7 +166,11 @@ void _reap_hportal(host_portal_t *hp, int quick)
 
     tbx_stack_move_to_top(hp->closed_que);
     while ((hc = (host_connection_t *)tbx_stack_get_current_data(hp->closed_que)) != NULL) {
-        apr_thread_join(&value, hc->recv_thread);
+        if (hc->epoll_loop != NULL) {
+            hc_epoll_wait_done(hc);
+        } else {
+            apr_thread_join(&value, hc->recv_thread);
+        }
         log_printf(5, "hp=%s ns=%d\n", hp->skey, tbx_ns_getid(hc->ns));
         for (count=0; ((quick == 0) || (count < 2)); count++) {
             lock_hc(hc);  //** Make sure that no one is running close_hc() while we're trying to close it
@@ -277,6 +281,8 @@ void destroy_hportal_context(portal_context_t *hpc)
         destroy_hportal(hp);
     }
 
+    if (hpc->epoll != NULL) hc_epoll_destroy(hpc->epoll);
+
     apr_thread_mutex_destroy(hpc->lock);
 
     apr_hash_clear(hpc->table);
@@ -553,6 +559,7 @@ void _add_hportal_op(host_portal_t *hp, op_generic_t *hsop, int addtotop, int re
     }
 
     hportal_signal(hp);  //** Send a signal for any tasks listening
+    if (hp->context->epoll != NULL) hc_epoll_kick_hportal(hp);  //** and wake any epoll driven connections
 }
 
 //*************************************************************************
@@ -0,0 +1,621 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//***********************************************************************
+// Fair dispatch of incoming EXEC commands for MQ servers.
+//
+// Each command is mapped to a lane.  Cheap and expensive lanes each get
+// their own cap on running tasks so a flood of scans can't tie up every
+// worker.  Inside a lane every client gets its own FIFO and the clients are
+// keyed by the ID frame the server names for each command with
+// mq_dispatch_client_frame_set().  The frame has to hold the same identity
+// for every command.  Otherwise the sender address the ROUTER socket appends
+// is used, but that is unique for each connection and not each client.  The clients are served
+// with deficit round robin.  A task is charged its command's running
+// average service time so a client sending slow commands gets fewer of
+// them through per round.  Direct lane commands skip the queues and go
+// straight to the thread pool like before.  This is for things that
+// park, like heartbeat spins and lease polls, or that other tasks wait on.
+//***********************************************************************
+
+#define _log_module_index 230
+
+#include <apr_hash.h>
+#include <apr_pools.h>
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+#include <apr_time.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tbx/fmttypes.h>
+#include <tbx/log.h>
+#include <tbx/stack.h>
+#include <tbx/type_malloc.h>
+#include "mq_dispatch.h"
+#include "thread_pool.h"
+
+#define MQD_COST_WEIGHT 8  //** Each new sample moves the service time estimate 1/8 of the way
+
+typedef struct {
+    uint64_t bin[MQD_HIST_BINS];  //** bin[i] holds values in [2^(i-1), 2^i)
+} mqd_hist_t;
+
+typedef struct {
+    char *key;
+    int key_len;
+    char *name;
+    int lane;
+    int client_frame;        //** Frame after the command with the client ID.  0 uses the sender
+    int64_t cost;            //** Running estimate of the service time in us
+    uint64_t count;
+    mqd_hist_t depth;        //** Lane backlog seen on arrival
+    mqd_hist_t wait;         //** Time spent queued in us
+    mqd_hist_t exec;         //** Time spent executing in us
+} mqd_class_t;
+
+typedef struct {
+    char *hid;
+    int hid_len;
+    int n_pending;           //** Tasks queued or running.  The client is dropped when this hits 0
+    tbx_stack_t *queue[MQD_N_LANES];
+    int64_t deficit[MQD_N_LANES];
+    int on_ring[MQD_N_LANES];
+} mqd_client_t;
+
+typedef struct {
+    tbx_stack_t *ring;       //** Clients with queued tasks in round robin order
+    int running;
+    int max_running;
+    int n_queued;
+    int misses;              //** Clients passed over since the last dispatch
+} mqd_lane_t;
+
+struct mq_dispatch_s {
+    mq_portal_t *p;
+    apr_thread_mutex_t *lock;
+    apr_thread_cond_t *cond;
+    apr_pool_t *mpool;
+    apr_hash_t *classes;     //** Command classes keyed by the command
+    apr_hash_t *clients;     //** Clients with tasks queued or running keyed by the client ID
+    mqd_class_t *unknown;    //** Catch all for commands without a class
+    mqd_lane_t lane[MQD_N_LANES];
+    int64_t quantum;         //** Credit in us each client gets per round
+    int n_pending;           //** Tasks queued or running on all lanes
+};
+
+typedef struct {
+    mq_dispatch_t *d;
+    mq_task_t *task;
+    mqd_class_t *cls;
+    mqd_client_t *client;
+    apr_time_t queued;
+    int64_t cost;
+    int lane;
+} mqd_item_t;
+
+//***********************************************************************
+// _mqd_lane_name - Returns the lanes printable name
+//***********************************************************************
+
+static char *_mqd_lane_name(int lane)
+{
+    if (lane == MQD_LANE_CHEAP) return("cheap");
+    if (lane == MQD_LANE_EXPENSIVE) return("expensive");
+    return("direct");
+}
+
+//***********************************************************************
+// _mqd_hist_add - Adds the value to the histogram
+//***********************************************************************
+
+static void _mqd_hist_add(mqd_hist_t *h, int64_t v)
+{
+    int i;
+
+    i = 0;
+    while ((v > 0) && (i < MQD_HIST_BINS-1)) {
+        v >>= 1;
+        i++;
+    }
+
+    h->bin[i]++;
+}
+
+//***********************************************************************
+// _mqd_hist_pct - Returns the upper bound of the bin holding the percentile
+//***********************************************************************
+
+static int64_t _mqd_hist_pct(mqd_hist_t *h, double pct)
+{
+    uint64_t total, want, sum;
+    int i;
+
+    total = 0;
+    for (i=0; i<MQD_HIST_BINS; i++) total += h->bin[i];
+    if (total == 0) return(0);
+
+    want = pct * total;
+    if (want == 0) want = 1;
+
+    sum = 0;
+    for (i=0; i<MQD_HIST_BINS; i++) {
+        sum += h->bin[i];
+        if (sum >= want) break;
+    }
+
+    if (i >= MQD_HIST_BINS) i = MQD_HIST_BINS - 1;
+    return((i == 0) ? 0 : ((int64_t)1 << i) - 1);
+}
+
+//***********************************************************************
+// _mqd_hist_print - Prints the non-empty bins as "upper_bound:count"
+//***********************************************************************
+
+static void _mqd_hist_print(FILE *fd, char *name, char *type, mqd_hist_t *h)
+{
+    int i;
+
+    fprintf(fd, "%s|%s|", name, type);
+    for (i=0; i<MQD_HIST_BINS; i++) {
+        if (h->bin[i] == 0) continue;
+        fprintf(fd, " " I64T ":" LU, (i == 0) ? 0 : ((int64_t)1 << i) - 1, h->bin[i]);
+    }
+    fprintf(fd, "\n");
+}
+
+//***********************************************************************
+// _mqd_class_new - Creates a new command class
+//***********************************************************************
+
+static mqd_class_t *_mqd_class_new(mq_dispatch_t *d, void *cmd, int cmd_size, char *name, int lane)
+{
+    mqd_class_t *cls;
+
+    tbx_type_malloc_clear(cls, mqd_class_t, 1);
+    if (cmd_size > 0) {
+        tbx_type_malloc(cls->key, char, cmd_size);
+        memcpy(cls->key, cmd, cmd_size);
+    }
+    cls->key_len = cmd_size;
+    cls->name = strdup(name);
+    cls->lane = lane;
+    cls->cost = d->quantum;
+
+    return(cls);
+}
+
+//***********************************************************************
+// _mqd_class_destroy - Destroys a command class
+//***********************************************************************
+
+static void _mqd_class_destroy(mqd_class_t *cls)
+{
+    if (cls->key) free(cls->key);
+    free(cls->name);
+    free(cls);
+}
+
+//***********************************************************************
+// _mqd_client_new - Adds a new client to the table
+//    NOTE: The dispatch lock must be held
+//***********************************************************************
+
+static mqd_client_t *_mqd_client_new(mq_dispatch_t *d, void *hid, int hid_len)
+{
+    mqd_client_t *c;
+    int i;
+
+    tbx_type_malloc_clear(c, mqd_client_t, 1);
+    tbx_type_malloc(c->hid, char, hid_len+1);
+    if (hid_len > 0) memcpy(c->hid, hid, hid_len);
+    c->hid[hid_len] = 0;
+    c->hid_len = hid_len;
+    for (i=0; i<MQD_N_LANES; i++) c->queue[i] = tbx_stack_new();
+
+    apr_hash_set(d->clients, c->hid, c->hid_len, c);
+
+    return(c);
+}
+
+//***********************************************************************
+// _mqd_client_destroy - Removes the client from the table and destroys it
+//    NOTE: The dispatch lock must be held and the client must be idle
+//***********************************************************************
+
+static void _mqd_client_destroy(mq_dispatch_t *d, mqd_client_t *c)
+{
+    int i;
+
+    apr_hash_set(d->clients, c->hid, c->hid_len, NULL);
+    for (i=0; i<MQD_N_LANES; i++) tbx_stack_free(c->queue[i], 0);
+    free(c->hid);
+    free(c);
+}
+
+//***********************************************************************
+// _mqd_advance - Called after a full trip around the ring without
+//    dispatching anything.  Instead of spinning a quantum at a time until
+//    a slow command has enough credit, every client gets the rounds
+//    needed for the closest one to go.
+//    NOTE: The dispatch lock must be held
+//***********************************************************************
+
+static void _mqd_advance(mq_dispatch_t *d, int lane)
+{
+    mqd_lane_t *l = &(d->lane[lane]);
+    mqd_client_t *c;
+    mqd_item_t *item;
+    int64_t need, n, rounds;
+
+    rounds = -1;
+    tbx_stack_move_to_top(l->ring);
+    while ((c = tbx_stack_get_current_data(l->ring)) != NULL) {
+        tbx_stack_move_to_top(c->queue[lane]);
+        item = tbx_stack_get_current_data(c->queue[lane]);
+        need = item->cost - c->deficit[lane];
+        n = (need <= 0) ? 0 : (need + d->quantum - 1) / d->quantum;
+        if ((rounds < 0) || (n < rounds)) rounds = n;
+        tbx_stack_move_down(l->ring);
+    }
+
+    if (rounds > 0) {
+        tbx_stack_move_to_top(l->ring);
+        while ((c = tbx_stack_get_current_data(l->ring)) != NULL) {
+            c->deficit[lane] += rounds * d->quantum;
+            tbx_stack_move_down(l->ring);
+        }
+    }
+
+    l->misses = 0;
+}
+
+static void *_mqd_exec(apr_thread_t *th, void *arg);
+
+//***********************************************************************
+// _mqd_pump - Starts queued tasks on the lane until it's full or empty
+//    NOTE: The dispatch lock must be held
+//***********************************************************************
+
+static void _mqd_pump(mq_dispatch_t *d, int lane)
+{
+    mqd_lane_t *l = &(d->lane[lane]);
+    mqd_client_t *c;
+    mqd_item_t *item;
+
+    while ((l->running < l->max_running) && (tbx_stack_count(l->ring) > 0)) {
+        tbx_stack_move_to_top(l->ring);
+        c = tbx_stack_get_current_data(l->ring);
+        tbx_stack_move_to_top(c->queue[lane]);
+        item = tbx_stack_get_current_data(c->queue[lane]);
+
+        if (c->deficit[lane] < item->cost) {  //** Not enough credit so go to the back of the line
+            c->deficit[lane] += d->quantum;
+            tbx_stack_pop(l->ring);
+            tbx_stack_move_to_bottom(l->ring);
+            tbx_stack_insert_below(l->ring, c);
+            l->misses++;
+            if (l->misses >= tbx_stack_count(l->ring)) _mqd_advance(d, lane);
+            continue;
+        }
+
+        //** The client stays at the front as long as it has credit
+        l->misses = 0;
+        tbx_stack_pop(c->queue[lane]);
+        c->deficit[lane] -= item->cost;
+        if (tbx_stack_count(c->queue[lane]) == 0) {  //** Nothing left so drop off the ring.  Unused credit is forfeited
+            tbx_stack_pop(l->ring);
+            c->on_ring[lane] = 0;
+            c->deficit[lane] = 0;
+        }
+        l->n_queued--;
+        l->running++;
+
+        _mqd_hist_add(&(item->cls->wait), apr_time_now() - item->queued);
+        thread_pool_direct(d->p->tp, _mqd_exec, item);
+    }
+}
+
+//***********************************************************************
+// _mqd_exec - Runs the task and then starts the next one on the lane
+//***********************************************************************
+
+static void *_mqd_exec(apr_thread_t *th, void *arg)
+{
+    mqd_item_t *item = (mqd_item_t *)arg;
+    mq_dispatch_t *d = item->d;
+    mqd_class_t *cls = item->cls;
+    mqd_client_t *c = item->client;
+    apr_time_t dt;
+
+    dt = apr_time_now();
+    mqt_exec(th, item->task);  //** This also destroys the task
+    dt = apr_time_now() - dt;
+
+    apr_thread_mutex_lock(d->lock);
+    _mqd_hist_add(&(cls->exec), dt);
+    cls->cost += (dt - cls->cost) / MQD_COST_WEIGHT;
+    if (cls->cost < 1) cls->cost = 1;
+
+    if (c != NULL) {  //** Came from a queue so free up the slot
+        d->lane[item->lane].running--;
+        c->n_pending--;
+        if (c->n_pending == 0) _mqd_client_destroy(d, c);
+        _mqd_pump(d, item->lane);
+    }
+
+    d->n_pending--;
+    if (d->n_pending == 0) apr_thread_cond_broadcast(d->cond);
+    apr_thread_mutex_unlock(d->lock);
+
+    free(item);
+
+    return(NULL);
+}
+
+//***********************************************************************
+// mq_dispatch_submit - Queues an incoming EXEC/TRACKEXEC task
+//***********************************************************************
+
+void mq_dispatch_submit(mq_dispatch_t *d, mq_task_t *task)
+{
+    mqd_item_t *item;
+    mqd_class_t *cls;
+    mqd_client_t *c;
+    mqd_lane_t *l;
+    mq_frame_t *f;
+    void *key, *hid;
+    int klen, hid_len, lane, i;
+
+    //** Peek at the command and client.  The frames are left for mqt_exec.
+    mq_msg_first(task->msg);    //** Empty frame
+    mq_msg_next(task->msg);     //** Version
+    mq_msg_next(task->msg);     //** MQ command
+    mq_msg_next(task->msg);     //** ID
+    f = mq_msg_next(task->msg); //** User command
+    mq_get_frame(f, &key, &klen);
+
+    tbx_type_malloc(item, mqd_item_t, 1);
+    item->d = d;
+    item->task = task;
+    item->client = NULL;
+    item->queued = apr_time_now();
+
+    apr_thread_mutex_lock(d->lock);
+    cls = (key != NULL) ? apr_hash_get(d->classes, key, klen) : NULL;
+    if (cls == NULL) cls = d->unknown;
+    cls->count++;
+    item->cls = cls;
+    item->cost = cls->cost;
+    item->lane = lane = cls->lane;
+    d->n_pending++;
+
+    if (lane == MQD_LANE_DIRECT) {
+        _mqd_hist_add(&(cls->depth), 0);
+        _mqd_hist_add(&(cls->wait), 0);
+        apr_thread_mutex_unlock(d->lock);
+        thread_pool_direct(d->p->tp, _mqd_exec, item);
+        return;
+    }
+
+    l = &(d->lane[lane]);
+    _mqd_hist_add(&(cls->depth), l->n_queued);
+
+    hid = NULL;
+    hid_len = 0;
+    for (i=0; (i<cls->client_frame) && (f != NULL); i++) f = mq_msg_next(task->msg);
+    if ((cls->client_frame > 0) && (f != NULL)) mq_get_frame(f, &hid, &hid_len);
+    if (hid_len <= 0) { //** Fall back to the sender the ROUTER socket appends
+        f = mq_msg_last(task->msg);
+        mq_get_frame(f, &hid, &hid_len);
+    }
+
+    c = apr_hash_get(d->clients, hid, hid_len);
+    if (c == NULL) c = _mqd_client_new(d, hid, hid_len);
+    c->n_pending++;
+    item->client = c;
+
+    tbx_stack_move_to_bottom(c->queue[lane]);
+    tbx_stack_insert_below(c->queue[lane], item);
+    l->n_queued++;
+
+    if (c->on_ring[lane] == 0) {  //** New arrivals start at the back with no credit
+        c->on_ring[lane] = 1;
+        c->deficit[lane] = 0;
+        tbx_stack_move_to_bottom(l->ring);
+        tbx_stack_insert_below(l->ring, c);
+    }
+
+    _mqd_pump(d, lane);
+    apr_thread_mutex_unlock(d->lock);
+}
+
+//***********************************************************************
+// mq_dispatch_class_set - Sets the lane and name used for the command.
+//    Commands without a class go to the cheap lane.
+//***********************************************************************
+
+void mq_dispatch_class_set(mq_dispatch_t *d, void *cmd, int cmd_size, char *name, int lane)
+{
+    mqd_class_t *cls;
+
+    apr_thread_mutex_lock(d->lock);
+    cls = apr_hash_get(d->classes, cmd, cmd_size);
+    if (cls == NULL) {
+        cls = _mqd_class_new(d, cmd, cmd_size, name, lane);
+        apr_hash_set(d->classes, cls->key, cls->key_len, cls);
+    } else {
+        free(cls->name);
+        cls->name = strdup(name);
+        cls->lane = lane;
+    }
+    apr_thread_mutex_unlock(d->lock);
+}
+
+//***********************************************************************
+// mq_dispatch_client_frame_set - Sets which frame after the command holds
+//    the client ID used for fairness.  The ROUTER sender is different for
+//    every connection so a client with several connections would get a
+//    share for each.  Setting it to 0 goes back to using the sender.  The
+//    command's class must already be set.
+//***********************************************************************
+
+void mq_dispatch_client_frame_set(mq_dispatch_t *d, void *cmd, int cmd_size, int frame)
+{
+    mqd_class_t *cls;
+
+    apr_thread_mutex_lock(d->lock);
+    cls = apr_hash_get(d->classes, cmd, cmd_size);
+    if (cls != NULL) {
+        cls->client_frame = frame;
+    } else {
+        log_printf(0, "ERROR: No class for the command!\n");
+    }
+    apr_thread_mutex_unlock(d->lock);
+}
+
+//***********************************************************************
+// mq_dispatch_print - Dumps the lane state and the per command queue
+//    depth and latency histograms
+//***********************************************************************
+
+void mq_dispatch_print(mq_dispatch_t *d, FILE *fd)
+{
+    apr_hash_index_t *hi;
+    mqd_class_t *cls;
+    mqd_lane_t *l;
+    int i, pass;
+
+    apr_thread_mutex_lock(d->lock);
+    fprintf(fd, "#dispatch: quantum=" I64T "us clients=%u pending=%d\n", d->quantum, apr_hash_count(d->clients), d->n_pending);
+    for (i=0; i<MQD_N_LANES; i++) {
+        l = &(d->lane[i]);
+        fprintf(fd, "#lane=%s running=%d/%d queued=%d clients=%d\n", _mqd_lane_name(i), l->running, l->max_running, l->n_queued, tbx_stack_count(l->ring));
+    }
+
+    //** 1st pass is the summary and the 2nd the raw histograms
+    for (pass=0; pass<2; pass++) {
+        if (pass == 0) {
+            fprintf(fd, "#command|lane|count|cost_us|depth_p50|depth_p99|wait_p50_us|wait_p99_us|exec_p50_us|exec_p99_us\n");
+        } else {
+            fprintf(fd, "#command|histogram| bin_upper_bound:count ...\n");
+        }
+
+        hi = apr_hash_first(NULL, d->classes);
+        cls = d->unknown;
+        while (cls != NULL) {
+            if (pass == 0) {
+                fprintf(fd, "%s|%s|" LU "|" I64T "|" I64T "|" I64T "|" I64T "|" I64T "|" I64T "|" I64T "\n", cls->name, _mqd_lane_name(cls->lane),
+                        cls->count, cls->cost, _mqd_hist_pct(&(cls->depth), 0.5), _mqd_hist_pct(&(cls->depth), 0.99),
+                        _mqd_hist_pct(&(cls->wait), 0.5), _mqd_hist_pct(&(cls->wait), 0.99),
+                        _mqd_hist_pct(&(cls->exec), 0.5), _mqd_hist_pct(&(cls->exec), 0.99));
+            } else if (cls->count > 0) {
+                _mqd_hist_print(fd, cls->name, "depth", &(cls->depth));
+                _mqd_hist_print(fd, cls->name, "wait_us", &(cls->wait));
+                _mqd_hist_print(fd, cls->name, "exec_us", &(cls->exec));
+            }
+
+            if (hi == NULL) break;
+            cls = apr_hash_this_val(hi);
+            hi = apr_hash_next(hi);
+        }
+    }
+    apr_thread_mutex_unlock(d->lock);
+}
+
+//***********************************************************************
+// mq_dispatch_create - Creates a new dispatcher for the portal.  If the
+//    lane limits are <= 0 then a quarter of the MQ context's worker threads
+//    go to expensive commands and the rest to cheap ones.  The quantum is
+//    in us.
+//***********************************************************************
+
+mq_dispatch_t *mq_dispatch_create(mq_portal_t *p, int max_cheap, int max_expensive, int quantum)
+{
+    mq_dispatch_t *d;
+    int i, n;
+
+    tbx_type_malloc_clear(d, mq_dispatch_t, 1);
+    apr_pool_create(&(d->mpool), NULL);
+    apr_thread_mutex_create(&(d->lock), APR_THREAD_MUTEX_DEFAULT, d->mpool);
+    apr_thread_cond_create(&(d->cond), d->mpool);
+    d->classes = apr_hash_make(d->mpool);
+    d->clients = apr_hash_make(d->mpool);
+    d->p = p;
+    d->quantum = (quantum > 0) ? quantum : 1000;
+    d->unknown = _mqd_class_new(d, NULL, 0, "unknown", MQD_LANE_CHEAP);
+
+    n = p->mqc->max_threads;
+    if (max_expensive <= 0) max_expensive = (n > 4) ? n / 4 : 1;
+    if (max_cheap <= 0) max_cheap = (n > max_expensive) ? n - max_expensive : 1;
+    d->lane[MQD_LANE_CHEAP].max_running = max_cheap;
+    d->lane[MQD_LANE_EXPENSIVE].max_running = max_expensive;
+    for (i=0; i<MQD_N_LANES; i++) d->lane[i].ring = tbx_stack_new();
+
+    log_printf(1, "host=%s max_cheap=%d max_expensive=%d quantum=" I64T "\n", p->host, max_cheap, max_expensive, d->quantum);
+
+    return(d);
+}
+
+//***********************************************************************
+// mq_dispatch_destroy - Destroys the dispatcher.  Any tasks still queued
+//    are dropped and the running ones are waited on.  The portal should
+//    already be removed so nothing new arrives.
+//***********************************************************************
+
+void mq_dispatch_destroy(mq_dispatch_t *d)
+{
+    apr_hash_index_t *hi;
+    mqd_client_t *c;
+    mqd_item_t *item;
+    mqd_lane_t *l;
+    int i, n;
+
+    apr_thread_mutex_lock(d->lock);
+    n = 0;
+    for (i=0; i<MQD_N_LANES; i++) {
+        l = &(d->lane[i]);
+        while ((c = tbx_stack_pop(l->ring)) != NULL) {
+            while ((item = tbx_stack_pop(c->queue[i])) != NULL) {
+                mq_task_destroy(item->task);
+                free(item);
+                c->n_pending--;
+                d->n_pending--;
+                l->n_queued--;
+                n++;
+            }
+            c->on_ring[i] = 0;
+            if (c->n_pending == 0) _mqd_client_destroy(d, c);
+        }
+    }
+    if (n > 0) log_printf(1, "Dropped %d queued tasks\n", n);
+
+    while (d->n_pending > 0) {
+        apr_thread_cond_wait(d->cond, d->lock);
+    }
+    apr_thread_mutex_unlock(d->lock);
+
+    for (hi = apr_hash_first(NULL, d->classes); hi != NULL; hi = apr_hash_next(hi)) {
+        _mqd_class_destroy(apr_hash_this_val(hi));
+    }
+    _mqd_class_destroy(d->unknown);
+    for (i=0; i<MQD_N_LANES; i++) tbx_stack_free(d->lane[i].ring, 0);
+
+    apr_thread_cond_destroy(d->cond);
+    apr_thread_mutex_destroy(d->lock);
+    apr_pool_destroy(d->mpool);
+    free(d);
+}
@@ -0,0 +1,51 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//***********************************************************************
+// MQ server side fair dispatch header
+//***********************************************************************
+
+#include "gop/gop_visibility.h"
+#include <stdio.h>
+#include "mq_portal.h"
+
+#ifndef _MQ_DISPATCH_H_
+#define _MQ_DISPATCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MQD_LANE_DIRECT    -1  //** Skips the queues and goes straight to the thread pool
+#define MQD_LANE_CHEAP      0  //** Short interactive commands
+#define MQD_LANE_EXPENSIVE  1  //** Long running scans, iterators, and regex ops
+#define MQD_N_LANES         2
+
+#define MQD_HIST_BINS      32  //** log2 buckets
+
+GOP_API mq_dispatch_t *mq_dispatch_create(mq_portal_t *p, int max_cheap, int max_expensive, int quantum);
+GOP_API void mq_dispatch_destroy(mq_dispatch_t *d);
+GOP_API void mq_dispatch_class_set(mq_dispatch_t *d, void *cmd, int cmd_size, char *name, int lane);
+GOP_API void mq_dispatch_client_frame_set(mq_dispatch_t *d, void *cmd, int cmd_size, int frame);
+GOP_API void mq_dispatch_print(mq_dispatch_t *d, FILE *fd);
+GOP_API void mq_dispatch_submit(mq_dispatch_t *d, mq_task_t *task);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
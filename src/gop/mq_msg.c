@@ -22,6 +22,217 @@
 #include <tbx/type_malloc.h>
 #include <tbx/log.h>
 #include <stdlib.h>
+#include <apr_thread_proc.h>
+
+//*************************************************************
+// Frame and message recycling.  Each thread keeps a small cache of
+// free mq_frame_t and mq_msg_t objects.  When a thread's cache fills up
+// or runs dry a batch is moved to or from a shared depot.  This keeps
+// the common case lock free even when objects are created in one thread
+// and destroyed in another like the portal's send path does.
+//*************************************************************
+
+#define MQ_POOL_THREAD_MAX  256    //** Max free objects of each type a thread caches
+#define MQ_POOL_BATCH       64     //** Objects moved between a thread and the depot at once
+#define MQ_POOL_DEPOT_MAX   16384  //** Max free objects of each type held in the depot
+
+#define MQ_POOL_FRAME 0
+#define MQ_POOL_MSG   1
+
+typedef struct mq_pool_obj_s {  //** Overlays the start of a free object
+    struct mq_pool_obj_s *next;
+} mq_pool_obj_t;
+
+typedef struct {
+    mq_pool_obj_t *head;
+    int n;
+} mq_pool_list_t;
+
+typedef struct {
+    mq_pool_list_t list[2];
+} mq_pool_cache_t;
+
+static apr_threadkey_t *_mq_pool_key = NULL;
+static apr_thread_mutex_t *_mq_pool_lock = NULL;
+static apr_pool_t *_mq_pool_mpool = NULL;
+static mq_pool_list_t _mq_pool_depot[2];
+
+//*************************************************************
+// _mq_pool_list_free - Frees all the objects in the list
+//*************************************************************
+
+void _mq_pool_list_free(mq_pool_list_t *l)
+{
+    mq_pool_obj_t *o;
+
+    while ((o = l->head) != NULL) {
+        l->head = o->next;
+        free(o);
+    }
+    l->n = 0;
+}
+
+//*************************************************************
+// _mq_pool_cache_destroy - Thread exit destructor for the cache.  The
+//     objects are handed back to the depot if there's room.
+//*************************************************************
+
+void _mq_pool_cache_destroy(void *arg)
+{
+    mq_pool_cache_t *c = (mq_pool_cache_t *)arg;
+    mq_pool_obj_t *o;
+    int i;
+
+    for (i=0; i<2; i++) {
+        apr_thread_mutex_lock(_mq_pool_lock);
+        while ((_mq_pool_depot[i].n < MQ_POOL_DEPOT_MAX) && ((o = c->list[i].head) != NULL)) {
+            c->list[i].head = o->next;
+            c->list[i].n--;
+            o->next = _mq_pool_depot[i].head;
+            _mq_pool_depot[i].head = o;
+            _mq_pool_depot[i].n++;
+        }
+        apr_thread_mutex_unlock(_mq_pool_lock);
+        _mq_pool_list_free(&(c->list[i]));
+    }
+
+    free(c);
+}
+
+//*************************************************************
+// mq_msg_pool_init - Sets up the frame/msg recycling
+//*************************************************************
+
+void mq_msg_pool_init()
+{
+    if (_mq_pool_key != NULL) return;
+
+    apr_pool_create(&_mq_pool_mpool, NULL);
+    apr_thread_mutex_create(&_mq_pool_lock, APR_THREAD_MUTEX_DEFAULT, _mq_pool_mpool);
+    memset(_mq_pool_depot, 0, sizeof(_mq_pool_depot));
+    apr_threadkey_private_create(&_mq_pool_key, _mq_pool_cache_destroy, _mq_pool_mpool);
+}
+
+//*************************************************************
+// mq_msg_pool_destroy - Tears down the recycling.  Objects destroyed
+//     afterwards are just freed.
+//*************************************************************
+
+void mq_msg_pool_destroy()
+{
+    apr_threadkey_t *key = _mq_pool_key;
+    mq_pool_cache_t *c = NULL;
+
+    if (key == NULL) return;
+
+    apr_threadkey_private_get((void *)&c, key);
+    _mq_pool_key = NULL;
+    if (c != NULL) {
+        apr_threadkey_private_set(NULL, key);
+        _mq_pool_cache_destroy(c);
+    }
+
+    _mq_pool_list_free(&(_mq_pool_depot[MQ_POOL_FRAME]));
+    _mq_pool_list_free(&(_mq_pool_depot[MQ_POOL_MSG]));
+    apr_threadkey_private_delete(key);
+    apr_thread_mutex_destroy(_mq_pool_lock);
+    apr_pool_destroy(_mq_pool_mpool);
+    _mq_pool_lock = NULL;
+}
+
+//*************************************************************
+// _mq_pool_cache - Returns the calling thread's cache or NULL if
+//     recycling is disabled
+//*************************************************************
+
+mq_pool_cache_t *_mq_pool_cache()
+{
+    mq_pool_cache_t *c = NULL;
+
+    if (_mq_pool_key == NULL) return(NULL);
+
+    apr_threadkey_private_get((void *)&c, _mq_pool_key);
+    if (c == NULL) {
+        tbx_type_malloc_clear(c, mq_pool_cache_t, 1);
+        apr_threadkey_private_set(c, _mq_pool_key);
+    }
+
+    return(c);
+}
+
+//*************************************************************
+// _mq_pool_get - Returns a recycled object of the given type or NULL
+//*************************************************************
+
+void *_mq_pool_get(int type)
+{
+    mq_pool_cache_t *c = _mq_pool_cache();
+    mq_pool_list_t *l;
+    mq_pool_obj_t *o;
+    int i;
+
+    if (c == NULL) return(NULL);
+
+    l = &(c->list[type]);
+    if (l->head == NULL) {  //** Empty so try and grab a batch from the depot
+        apr_thread_mutex_lock(_mq_pool_lock);
+        for (i=0; (i<MQ_POOL_BATCH) && ((o = _mq_pool_depot[type].head) != NULL); i++) {
+            _mq_pool_depot[type].head = o->next;
+            _mq_pool_depot[type].n--;
+            o->next = l->head;
+            l->head = o;
+            l->n++;
+        }
+        apr_thread_mutex_unlock(_mq_pool_lock);
+        if (l->head == NULL) return(NULL);
+    }
+
+    o = l->head;
+    l->head = o->next;
+    l->n--;
+
+    return(o);
+}
+
+//*************************************************************
+// _mq_pool_put - Recycles the object or frees it if the caches are full
+//*************************************************************
+
+void _mq_pool_put(int type, void *ptr)
+{
+    mq_pool_cache_t *c = _mq_pool_cache();
+    mq_pool_list_t *l;
+    mq_pool_obj_t *o = (mq_pool_obj_t *)ptr;
+    int i;
+
+    if (c == NULL) {
+        free(ptr);
+        return;
+    }
+
+    l = &(c->list[type]);
+    if (l->n >= MQ_POOL_THREAD_MAX) {  //** Full so send a batch to the depot
+        apr_thread_mutex_lock(_mq_pool_lock);
+        for (i=0; (i<MQ_POOL_BATCH) && (_mq_pool_depot[type].n < MQ_POOL_DEPOT_MAX); i++) {
+            o = l->head;
+            l->head = o->next;
+            l->n--;
+            o->next = _mq_pool_depot[type].head;
+            _mq_pool_depot[type].head = o;
+            _mq_pool_depot[type].n++;
+        }
+        apr_thread_mutex_unlock(_mq_pool_lock);
+        if (l->n >= MQ_POOL_THREAD_MAX) {  //** Depot is full as well
+            free(ptr);
+            return;
+        }
+        o = (mq_pool_obj_t *)ptr;
+    }
+
+    o->next = l->head;
+    l->head = o;
+    l->n++;
+}
 
 //**************************************************************
 //  mq_get_frame - Returns the frame data
@@ -69,7 +280,12 @@ char *mq_frame_strdup(mq_frame_t *f)
 
 mq_msg_t *mq_msg_new()
 {
-    return(tbx_stack_new());
+    mq_msg_t *msg = _mq_pool_get(MQ_POOL_MSG);
+
+    if (msg == NULL) return(tbx_stack_new());
+
+    tbx_stack_init(msg);
+    return(msg);
 }
 mq_frame_t *mq_msg_first(mq_msg_t *msg)
 {
@@ -128,9 +344,9 @@ void mq_frame_set(mq_frame_t *f, void *data, int len, int auto_free)
 
 mq_frame_t *mq_frame_new(void *data, int len, int auto_free)
 {
-    mq_frame_t *f;
+    mq_frame_t *f = _mq_pool_get(MQ_POOL_FRAME);
 
-    tbx_type_malloc(f, mq_frame_t, 1);
+    if (f == NULL) tbx_type_malloc(f, mq_frame_t, 1);
     mq_frame_set(f, data, len, auto_free);
 
     return(f);
@@ -159,7 +375,7 @@ void mq_frame_destroy(mq_frame_t *f)
     } else if (f->auto_free == MQF_MSG_INTERNAL_FREE) {
         zmq_msg_close(&(f->zmsg));
     }
-    free(f);
+    _mq_pool_put(MQ_POOL_FRAME, f);
 }
 
 void mq_msg_destroy(mq_msg_t *msg)
@@ -170,7 +386,7 @@ void mq_msg_destroy(mq_msg_t *msg)
         mq_frame_destroy(f);
     }
 
-    tbx_stack_free(msg, 0);
+    _mq_pool_put(MQ_POOL_MSG, msg);
 }
 
 void mq_msg_push_mem(mq_msg_t *msg, void *data, int len, int auto_free)
@@ -303,6 +303,7 @@ mq_ongoing_object_t *mq_ongoing_add(mq_ongoing_t *mqon, int auto_clean, char *id
         oh->id_len = id_len;
 
         oh->heartbeat = 60;
+        oh->caps = 0;
         sscanf(id, "%d:", &(oh->heartbeat));
         log_printf(5, "heartbeat interval=%d\n", oh->heartbeat);
         oh->next_check = apr_time_now() + apr_time_from_sec(oh->heartbeat);
@@ -386,6 +387,38 @@ void mq_ongoing_release(mq_ongoing_t *mqon, char *id, int id_len, intptr_t key)
     return;
 }
 
+//***********************************************************************
+// mq_ongoing_host_caps_set - Stores the capabilities the host advertised
+//***********************************************************************
+
+void mq_ongoing_host_caps_set(mq_ongoing_t *mqon, char *id, int id_len, int caps)
+{
+    mq_ongoing_host_t *oh;
+
+    apr_thread_mutex_lock(mqon->lock);
+    oh = apr_hash_get(mqon->id_table, id, id_len);
+    if (oh != NULL) oh->caps = caps;
+    apr_thread_mutex_unlock(mqon->lock);
+}
+
+//***********************************************************************
+// mq_ongoing_host_caps_get - Returns the capabilities the host advertised
+//     or 0 if we haven't heard from it yet
+//***********************************************************************
+
+int mq_ongoing_host_caps_get(mq_ongoing_t *mqon, char *id, int id_len)
+{
+    mq_ongoing_host_t *oh;
+    int caps = 0;
+
+    apr_thread_mutex_lock(mqon->lock);
+    oh = apr_hash_get(mqon->id_table, id, id_len);
+    if (oh != NULL) caps = oh->caps;
+    apr_thread_mutex_unlock(mqon->lock);
+
+    return(caps);
+}
+
 //***********************************************************************
 // mq_ongoing_remove - Removes an onging object from the tracking table
 //***********************************************************************
@@ -66,6 +66,7 @@ typedef struct {
 
 typedef struct {
     int heartbeat;
+    int caps;                   //** Stream capabilities the host advertised
     apr_time_t next_check;
     char *id;
     int id_len;
@@ -96,6 +97,8 @@ GOP_API mq_ongoing_object_t *mq_ongoing_add(mq_ongoing_t *mqon, int auto_clean,
 GOP_API void *mq_ongoing_remove(mq_ongoing_t *mqon, char *id, int id_len, intptr_t key);
 GOP_API void *mq_ongoing_get(mq_ongoing_t *mqon, char *id, int id_len, intptr_t key);
 GOP_API void mq_ongoing_release(mq_ongoing_t *mqon, char *id, int id_len, intptr_t key);
+GOP_API void mq_ongoing_host_caps_set(mq_ongoing_t *mqon, char *id, int id_len, int caps);
+GOP_API int mq_ongoing_host_caps_get(mq_ongoing_t *mqon, char *id, int id_len);
 GOP_API mq_ongoing_t *mq_ongoing_create(mq_context_t *mqc, mq_portal_t *server_portal, int check_interval, int mode);
 GOP_API void mq_ongoing_destroy(mq_ongoing_t *mqon);
 
@@ -17,11 +17,14 @@
 #include <tbx/log.h>
 #include <tbx/assert_result.h>
 #include "mq_portal.h"
+#include "mq_dispatch.h"
 #include <tbx/type_malloc.h>
 #include "apr_base64.h"
 #include <tbx/apr_wrapper.h>
 #include <tbx/random.h>
 #include <tbx/fmttypes.h>
+#include <errno.h>
+#include <fcntl.h>
 
 //** Poll index for connection monitoring
 #define PI_CONN 0   //** Actual connection
@@ -293,7 +296,7 @@ void mq_command_exec(mq_command_table_t *t, mq_task_t *task, void *key, int klen
 int mq_submit(mq_portal_t *p, mq_task_t *task)
 {
     char c;
-    int backlog, err;
+    int backlog, err, want;
     mq_task_t *t;
     apr_thread_mutex_lock(p->lock);
 
@@ -305,11 +308,17 @@ int mq_submit(mq_portal_t *p, mq_task_t *task)
     tbx_stack_insert_below(p->tasks, task);
     backlog = tbx_stack_count(p->tasks);
     log_printf(2, "portal=%s backlog=%d active_conn=%d max_conn=%d total_conn=%d\n", p->host, backlog, p->active_conn, p->max_conn, p->total_conn);
-    tbx_log_flush();
 
-//** Noitify the connections
-    c = 1;
-    mq_pipe_write(p->efd[1], &c);
+//** Notify the connections.  Wakeups are coalesced so we only signal if there
+//** aren't already enough pending to cover the backlog in batches.
+    want = (backlog + MQ_TASK_BATCH - 1) / MQ_TASK_BATCH;
+    if (want > p->active_conn) want = p->active_conn;
+    if (want < 1) want = 1;
+    if (p->n_wakeup < want) {
+        p->n_wakeup++;
+        c = 1;
+        mq_pipe_write(p->efd[1], &c);
+    }
 
 //** Check if we need more connections
     err = 0;
@@ -336,7 +345,6 @@ int mq_submit(mq_portal_t *p, mq_task_t *task)
     }
 
     log_printf(2, "END portal=%s err=%d backlog=%d active_conn=%d total_conn=%d max_conn=%d\n", p->host, err, backlog, p->active_conn, p->total_conn, p->max_conn);
-    tbx_log_flush();
 
     apr_thread_mutex_unlock(p->lock);
 
@@ -1112,7 +1120,11 @@ int mqc_process_incoming(mq_conn_t *c, int *nproc)
 //** It's up to the task to send any tracking information back.
             log_printf(5, "Submiting task for execution\n");
             task = mq_task_new(c->pc->mqc, msg, NULL, c->pc, -1);
-            thread_pool_direct(c->pc->tp, mqt_exec, task);
+            if (c->pc->dispatch != NULL) {
+                mq_dispatch_submit(c->pc->dispatch, task);
+            } else {
+                thread_pool_direct(c->pc->tp, mqt_exec, task);
+            }
         } else {   //** Unknwon command so drop it
             log_printf(5, "ERROR: Unknown command.  Dropping\n");
             c->stats.incoming[MQS_UNKNOWN_INDEX]++;
@@ -1134,48 +1146,17 @@ skip:
 }
 
 //**************************************************************
-// mqc_process_task - Sends the new task
-//   npoll -- When processing the task if c->pc->n_close > 0
-//   then no tasks is processed but instead n_close is decremented
-//   and npoll set to 1 to stop monitoring the incoming task port
+// _mqc_send_task - Sends a single task and starts tracking it if needed
 //**************************************************************
 
-int mqc_process_task(mq_conn_t *c, int *npoll, int *nproc)
+int _mqc_send_task(mq_conn_t *c, mq_task_t *task)
 {
-    mq_task_t *task = NULL;
     mq_frame_t *f;
     mq_task_monitor_t *tn;
     char b64[1024];
-    char *data, v;
+    char *data;
     int i, size, tracking;
 
-//** Read an event
-    i = mq_pipe_read(c->pc->efd[0], &v);
-
-//** Get the new task or start a wind down if requested
-    apr_thread_mutex_lock(c->pc->lock);
-    if (c->pc->n_close > 0) { //** Wind down request
-        c->pc->n_close--;
-        *npoll = 1;
-    } else {  //** Got a new task
-        task = tbx_stack_pop(c->pc->tasks);
-    }
-    apr_thread_mutex_unlock(c->pc->lock);
-
-    if (i == -1) {
-        log_printf(1, "OOPS! read=-1 task=%p!\n", task);
-    }
-
-//** Wind down triggered so return
-    if (*npoll == 1) return(0);
-
-    if (task == NULL) {
-        log_printf(0, "Nothing to do\n");
-        return(0);
-    }
-
-    (*nproc)++;  //** Inc processed commands
-
 //** Convert the MAx exec time in sec to an abs timeout in usec
     task->timeout = apr_time_now() + apr_time_from_sec(task->timeout);
 
@@ -1261,6 +1242,82 @@ int mqc_process_task(mq_conn_t *c, int *npoll, int *nproc)
     return(0);
 }
 
+//**************************************************************
+// mqc_process_task - Sends the new tasks.  Up to MQ_TASK_BATCH tasks are
+//   pulled from the portal for each wakeup.  If more are left we re-arm
+//   the wakeup so another connection, or us, picks them up.  If a send
+//   fails the rest of the batch goes back on the front of the portal queue
+//   since this connection is about to be torn down.
+//   npoll -- When processing the task if c->pc->n_close > 0
+//   then no tasks is processed but instead n_close is decremented
+//   and npoll set to 1 to stop monitoring the incoming task port
+//**************************************************************
+
+int mqc_process_task(mq_conn_t *c, int *npoll, int *nproc)
+{
+    mq_task_t *task[MQ_TASK_BATCH];
+    char v;
+    int i, n, err;
+
+//** Read an event
+    i = mq_pipe_read(c->pc->efd[0], &v);
+
+//** Get the new tasks or start a wind down if requested
+    n = 0;
+    apr_thread_mutex_lock(c->pc->lock);
+    if (i == 1) c->pc->n_wakeup--;
+    if (c->pc->n_close > 0) { //** Wind down request
+        c->pc->n_close--;
+        *npoll = 1;
+    } else {  //** Grab a batch of tasks
+        while ((n < MQ_TASK_BATCH) && ((task[n] = tbx_stack_pop(c->pc->tasks)) != NULL)) n++;
+    }
+    if ((tbx_stack_count(c->pc->tasks) > 0) && (c->pc->n_wakeup == 0)) {  //** Still more to do so re-arm
+        c->pc->n_wakeup++;
+        v = 1;
+        mq_pipe_write(c->pc->efd[1], &v);
+    }
+    apr_thread_mutex_unlock(c->pc->lock);
+
+    if ((i == -1) && (errno != EAGAIN)) {
+        log_printf(1, "OOPS! read=-1 n=%d errno=%d!\n", n, errno);
+    }
+
+//** Wind down triggered so return
+    if (*npoll == 1) return(0);
+
+    if (n == 0) {
+        log_printf(5, "Nothing to do\n");
+        return(0);
+    }
+
+    log_printf(5, "sending n=%d tasks\n", n);
+    err = 0;
+    for (i=0; i<n; i++) {
+        (*nproc)++;  //** Inc processed commands
+        err = _mqc_send_task(c, task[i]);
+        if (err != 0) break;
+    }
+
+    if (err == 0) return(0);
+
+    //** Put back what we didn't send in the same order and wake someone up to send them
+    i++;
+    log_printf(1, "Send failed.  Requeueing %d tasks\n", n-i);
+    if (i < n) {
+        apr_thread_mutex_lock(c->pc->lock);
+        for (n=n-1; n>=i; n--) tbx_stack_push(c->pc->tasks, task[n]);
+        if (c->pc->n_wakeup == 0) {
+            c->pc->n_wakeup++;
+            v = 1;
+            mq_pipe_write(c->pc->efd[1], &v);
+        }
+        apr_thread_mutex_unlock(c->pc->lock);
+    }
+
+    return(1);
+}
+
 //**************************************************************
 // mq_conn_make - Makes the actual connection.  Returns 0 for
 //    success and 1 for failure.
@@ -1643,11 +1700,12 @@ void mq_portal_destroy(mq_portal_t *p)
     tbx_log_flush();
     p->n_close = p->active_conn;
     n = p->n_close;
-    apr_thread_mutex_unlock(p->lock);
+    p->n_wakeup += n;
 
 //** Signal them
     c = 1;
     for (i=0; i<n; i++) mq_pipe_write(p->efd[1], &c);
+    apr_thread_mutex_unlock(p->lock);
 
     //** Wait for them all to complete
     apr_thread_mutex_lock(p->lock);
@@ -1714,6 +1772,17 @@ mq_command_table_t *mq_portal_command_table(mq_portal_t *portal)
     return(portal->command_table);
 }
 
+//**************************************************************
+// mq_portal_dispatch_set - Routes incoming EXEC commands through the
+//    dispatcher instead of straight to the thread pool.  This should
+//    be set before the portal is installed.
+//**************************************************************
+
+void mq_portal_dispatch_set(mq_portal_t *portal, mq_dispatch_t *d)
+{
+    portal->dispatch = d;
+}
+
 //**************************************************************
 // mq_portal_remove - Removes a server portal in the context
 //**************************************************************
@@ -144,6 +144,9 @@ typedef struct mq_socket_s mq_socket_t;
 struct mq_task_s;
 typedef struct mq_task_s mq_task_t;
 
+struct mq_dispatch_s;
+typedef struct mq_dispatch_s mq_dispatch_t;
+
 #ifdef MQ_PIPE_COMM
 typedef int mq_pipe_t;       //** Event notification FD
 #else
@@ -236,6 +239,8 @@ typedef struct {  //** MQ connection container
     apr_pool_t *mpool;       //** MEmory pool for connection/thread. APR mpools aren't thread safe!!!!!!!
 } mq_conn_t;
 
+#define MQ_TASK_BATCH 64  //** Max tasks a connection pulls from the portal per wakeup
+
 struct mq_portal_s {   //** Container for managing connections to a single host
     char *host;       //** Host address
     int connect_mode; //** Connection mode connect vs bind
@@ -248,6 +253,7 @@ struct mq_portal_s {   //** Container for managing connections to a single host
     int heartbeat_failure;     //** Missing heartbeat DT for failure classification
     int counter;               //** Connections counter
     int n_close;               //** Number of connections being requested to close
+    int n_wakeup;              //** Number of wakeups sitting in efd that haven't been read
     int socket_type;           //** Socket type
     uint64_t n_ops;            //** Operation count
     double min_ops_per_sec;    //** Minimum ops/sec needed to keep a connection open.
@@ -257,6 +263,7 @@ struct mq_portal_s {   //** Container for managing connections to a single host
     apr_thread_mutex_t *lock;  //** Context lock
     apr_thread_cond_t *cond;   //** Shutdown complete cond
     mq_command_table_t *command_table; //** Server command ops for execution
+    mq_dispatch_t *dispatch;   //** Optional fair dispatcher for incoming EXEC commands
     void *implementation_arg; //** Implementation-specific pointer for general use. Round robin uses this as worker table
     apr_pool_t *mpool;         //** Context memory pool
     thread_pool_context_t *tp; //** Worker thread pool to use
@@ -301,8 +308,8 @@ struct mq_context_s {      //** Main MQ context
 //--------------------------------------------------------------
 
 #ifdef MQ_PIPE_COMM
-//  #define mq_pipe_create(ctx, pfd)  assert_result(pipe(pfd), 0); fcntl(pfd[0], F_SETFL, O_NONBLOCK)
-#define mq_pipe_create(ctx, pfd)  assert_result(pipe(pfd), 0)
+//** The read side is non-blocking since several connections poll the same pipe and wakeups are coalesced
+#define mq_pipe_create(ctx, pfd)  assert_result(pipe(pfd), 0); fcntl(pfd[0], F_SETFL, O_NONBLOCK)
 #define mq_pipe_poll_store(pollfd, cfd, mode) (pollfd)->fd = cfd;  (pollfd)->events = mode
 #define mq_pipe_destroy(ctx, pfd) if (pfd[0] != -1) { close(pfd[0]); close(pfd[1]); }
 #define mq_pipe_read(fd, c) read(fd, c, 1)
@@ -320,6 +327,8 @@ typedef mq_context_t *(mq_create_t)(tbx_inip_file_t *ifd, char *section);
 
 GOP_API char *mq_id2str(char *id, int id_len, char *str, int str_len);
 
+void mq_msg_pool_init();
+void mq_msg_pool_destroy();
 GOP_API mq_msg_t *mq_msg_new();
 GOP_API int mq_get_frame(mq_frame_t *f, void **data, int *size);
 GOP_API char *mq_frame_strdup(mq_frame_t *f);
@@ -369,6 +378,8 @@ GOP_API void mq_portal_destroy(mq_portal_t *p);
 GOP_API mq_portal_t *mq_portal_create(mq_context_t *mqc, char *host, int connect_mode);
 GOP_API mq_portal_t *mq_portal_lookup(mq_context_t *mqc, char *host, int connect_mode);
 GOP_API mq_command_table_t *mq_portal_command_table(mq_portal_t *portal);
+GOP_API void mq_portal_dispatch_set(mq_portal_t *portal, mq_dispatch_t *d);
+void *mqt_exec(apr_thread_t *th, void *arg);
 GOP_API mq_context_t *mq_create_context(tbx_inip_file_t *ifd, char *section);
 GOP_API void mq_destroy_context(mq_context_t *mqp);
 mq_socket_t *zero_create_socket(mq_socket_context_t *ctx, int stype);
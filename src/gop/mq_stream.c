@@ -29,9 +29,47 @@
 #include <tbx/varint.h>
 #include <tbx/packer.h>
 #include <tbx/apr_wrapper.h>
+#include <tbx/stack.h>
+
+//** Request for more data waiting on the writer
+typedef struct {
+    mq_msg_t *address;
+    mq_frame_t *fid;
+    int free_address;
+    int pipelined;
+    apr_time_t deadline;  //** When it has to be answered to beat the reader's timeout
+} mqs_parked_t;
+
+//***********************************************************************
+// mqs_pack_type - Maps the stream pack type to the packer's
+//***********************************************************************
+
+int mqs_pack_type(char tbx_pack_type)
+{
+    if (tbx_pack_type == MQS_PACK_COMPRESS) return(PACK_COMPRESS);
+    if (tbx_pack_type == MQS_PACK_LZ) return(PACK_LZ);
+    return(PACK_NONE);
+}
+
+//***********************************************************************
+// mqs_seq_frame - Makes the chunk sequence frame for pipelined streams
+//***********************************************************************
+
+mq_frame_t *mqs_seq_frame(int seq)
+{
+    unsigned char buffer[16];
+    unsigned char *bytes;
+    int n;
+
+    n = tbx_zigzag_encode(seq, buffer);
+    tbx_type_malloc(bytes, unsigned char, n);
+    memcpy(bytes, buffer, n);
+    return(mq_frame_new(bytes, n, MQF_MSG_AUTO_FREE));
+}
 
 //***********************************************************************
-// mqs_response_client_more - Handles a response for more data from the server
+// mqs_response_client_more - Handles a response for more data from the server.
+//    The chunk is parked until the reader gets to it.
 //***********************************************************************
 
 op_status_t mqs_response_client_more(void *task_arg, int tid)
@@ -39,94 +77,87 @@ op_status_t mqs_response_client_more(void *task_arg, int tid)
     mq_task_t *task = (mq_task_t *)task_arg;
     mq_stream_t *mqs = (mq_stream_t *)task->arg;
     op_status_t status = op_success_status;
+    mq_frame_t *f;
+    unsigned char *data;
+    int64_t seq;
+    int n, slot;
 
     log_printf(5, "START msid=%d\n", mqs->msid);
 
     //** Parse the response
     mq_remove_header(task->response, 1);
 
-    //** Wait for a notification that the data can be processed
     apr_thread_mutex_lock(mqs->lock);
-    log_printf(5, "INIT STATUS msid=%d waiting=%d processed=%d\n", mqs->msid, mqs->waiting, mqs->processed);
     mqs->transfer_packets++;
-    mqs->waiting = 0;
-    apr_thread_cond_broadcast(mqs->cond);
 
-    //** Now wait until the application is ready
-    while (mqs->waiting == 0) {
-        apr_thread_cond_wait(mqs->cond, mqs->lock);
+    //** Figure out which chunk it is.  Pipelined writers tag them since the
+    //** responses can be processed out of order.  Otherwise only 1 is in flight.
+    if (mqs->pipelined == 1) {
+        seq = -1;
+        mq_msg_first(task->response);
+        f = mq_msg_next(task->response);
+        if (f != NULL) {
+            mq_get_frame(f, (void **)&data, &n);
+            if ((n <= 0) || (tbx_zigzag_decode(data, n, &seq) < 0)) seq = -1;
+        }
+    } else {
+        seq = mqs->n_requested;
     }
 
-    //** Can accept the data
-    mq_get_frame(mq_msg_first(task->response), (void **)&(mqs->data), &(mqs->len));
-    tbx_pack_read_new_data(mqs->pack, &(mqs->data[MQS_HEADER]), mqs->len-MQS_HEADER);
-
-    //** Notify the consumer it's available
-    mqs->waiting = -2;
-    apr_thread_cond_broadcast(mqs->cond);
-
-    //** Wait until it's consumed
-    while (mqs->processed == 0) {
-        apr_thread_cond_wait(mqs->cond, mqs->lock);
+    slot = (seq < 0) ? 0 : seq % MQS_READ_AHEAD;
+    if ((seq > mqs->seq) && (seq <= mqs->n_requested) && (mqs->chunk[slot] == NULL)) {
+        mqs->chunk[slot] = task->response;
+        task->response = NULL;  //** We'll free it once it's consumed
+        apr_thread_cond_broadcast(mqs->cond);
+    } else {  //** Reply to a request sent after the stream ended
+        log_printf(5, "Dropping chunk msid=%d seq=" I64T " last_seq=%d\n", mqs->msid, seq, mqs->seq);
     }
 
-    mqs->data = NULL;    //** Nullify the data so it's not accidentally accessed
-    mqs->processed = 0;  //** and reset the processed flag back to 0
-
     apr_thread_mutex_unlock(mqs->lock);
 
-    log_printf(5, "END msid=%d status=%d %d\n", mqs->msid, status.op_status, status.error_code);
+    log_printf(5, "END msid=%d seq=" I64T " status=%d %d\n", mqs->msid, seq, status.op_status, status.error_code);
 
     return(status);
 }
 
-
 //***********************************************************************
-// mq_stream_read_request - Places a request for more data
+// mqs_read_more_submit - Sends a single request for more data
 //***********************************************************************
 
-void mq_stream_read_request(mq_stream_t *mqs)
+void mqs_read_more_submit(mq_stream_t *mqs, char mode)
 {
     mq_msg_t *msg;
+    op_generic_t *gop;
+    unsigned char *mbuf;
 
-    //** If 1st time make all the variables
-    if (mqs->mpool == NULL) {
-        apr_pool_create(&mqs->mpool, NULL);
-        apr_thread_mutex_create(&(mqs->lock), APR_THREAD_MUTEX_DEFAULT, mqs->mpool);
-        apr_thread_cond_create(&(mqs->cond), mqs->mpool);
-    }
+    log_printf(5, "msid=%d mode=%c\n", mqs->msid, mode);
 
-    log_printf(5, "msid=%d want_more=%c\n", mqs->msid, mqs->want_more);
+    //** The 2nd mode byte has the codecs we support.  Only pipelined writers understand it.
+    tbx_type_malloc(mbuf, unsigned char, 2);
+    mbuf[0] = mode;
+    mbuf[1] = MQS_CAP_LZ;
 
     //** Form the message
     msg = mq_make_exec_core_msg(mqs->remote_host, 1);
     mq_msg_append_mem(msg, MQS_MORE_DATA_KEY, MQS_MORE_DATA_SIZE, MQF_MSG_KEEP_DATA);
     mq_msg_append_mem(msg, mqs->host_id, mqs->hid_len, MQF_MSG_KEEP_DATA);
     mq_msg_append_mem(msg, mqs->stream_id, mqs->sid_len, MQF_MSG_KEEP_DATA);
-    mq_msg_append_mem(msg, &(mqs->want_more), 1, MQF_MSG_KEEP_DATA);  //** Want more data
+    mq_msg_append_mem(msg, mbuf, (mqs->pipelined == 1) ? 2 : 1, MQF_MSG_AUTO_FREE);
     mq_msg_append_mem(msg, NULL, 0, MQF_MSG_KEEP_DATA);
-//DELETE???  mq_apply_return_address_msg(msg, mqs->remote_host, 0);
-
-    //** Make the gop
-    mqs->gop_waiting = new_mq_op(mqs->mqc, msg, mqs_response_client_more, mqs, NULL, mqs->timeout);
 
-    //** Start executing it
-
-    apr_thread_mutex_lock(mqs->lock);
-    mqs->waiting = 1;
-    apr_thread_mutex_unlock(mqs->lock);
-    gop_start_execution(mqs->gop_waiting);
+    //** Make the gop and start executing it
+    gop = new_mq_op(mqs->mqc, msg, mqs_response_client_more, mqs, NULL, mqs->timeout);
+    opque_add(mqs->q, gop);
 }
 
 //***********************************************************************
-// mq_stream_read_wait - Waits for data to become available
+// mq_stream_read_request - Tops off the requests for more data so there
+//    are read_ahead chunks either in flight or waiting to be consumed.
 //***********************************************************************
 
-int mq_stream_read_wait(mq_stream_t *mqs)
+void mq_stream_read_request(mq_stream_t *mqs)
 {
-    int err = 0;
-    apr_interval_time_t dt;
-    op_status_t status;
+    int i, n;
 
     //** If 1st time make all the variables
     if (mqs->mpool == NULL) {
@@ -134,87 +165,98 @@ int mq_stream_read_wait(mq_stream_t *mqs)
         apr_thread_mutex_create(&(mqs->lock), APR_THREAD_MUTEX_DEFAULT, mqs->mpool);
         apr_thread_cond_create(&(mqs->cond), mqs->mpool);
     }
+    if (mqs->q == NULL) {
+        mqs->q = new_opque();
+        opque_start_execution(mqs->q);
+    }
 
-    dt = apr_time_from_sec(1);
-
-
-    //** Flag the just processed gop to clean up
+    //** Reserve the chunk slots before sending so the responses have a place to go
     apr_thread_mutex_lock(mqs->lock);
-    log_printf(5, "START msid=%d waiting=%d processed=%d gop_processed=%p\n", mqs->msid, mqs->waiting, mqs->processed, mqs->gop_processed);
-    if (mqs->gop_processed != NULL) mqs->processed = 1;
-    apr_thread_cond_broadcast(mqs->cond);
+    n = mqs->read_ahead - (mqs->n_requested - mqs->seq);
+    if (n < 0) n = 0;
+    mqs->n_requested += n;
+    apr_thread_mutex_unlock(mqs->lock);
+
+    log_printf(5, "msid=%d want_more=%c sending=%d n_requested=%d seq=%d\n", mqs->msid, mqs->want_more, n, mqs->n_requested, mqs->seq);
 
-    if (mqs->data) {
-        if (mqs->data[MQS_STATE_INDEX] != MQS_MORE) err = 1;
+    for (i=0; i<n; i++) {
+        mqs_read_more_submit(mqs, mqs->want_more);
     }
-    apr_thread_mutex_unlock(mqs->lock);
+}
+
+//***********************************************************************
+// mq_stream_read_wait - Waits for the next chunk to become available
+//***********************************************************************
+
+int mq_stream_read_wait(mq_stream_t *mqs)
+{
+    op_generic_t *gop;
+    mq_msg_t *response;
+    int err, slot;
 
-    if (mqs->gop_processed != NULL) {
-        gop_waitany(mqs->gop_processed);
-        gop_free(mqs->gop_processed, OP_DESTROY);
-        mqs->gop_processed = NULL;
+    if (mqs->data != NULL) {
+        if (mqs->data[MQS_STATE_INDEX] != MQS_MORE) {
+            log_printf(2, "ERROR no more data available!\n");
+            return(-1);
+        }
     }
+    if (mqs->q == NULL) return(-1);
 
-    if (err != 0) {
-        log_printf(2, "ERROR no more data available!\n");
-        return(-1);
+    //** Done with the current chunk
+    if (mqs->response != NULL) {
+        mq_msg_destroy(mqs->response);
+        mqs->response = NULL;
     }
+    mqs->data = NULL;
 
-    //** Now handle the waiting gop
+    //** Wait for the next one in order
+    err = 0;
+    slot = (mqs->seq + 1) % MQS_READ_AHEAD;
     apr_thread_mutex_lock(mqs->lock);
-    log_printf(5, "before loop msid=%d waiting=%d processed=%d\n", mqs->msid, mqs->waiting, mqs->processed);
-
-    while (mqs->waiting == 1) {
-        log_printf(5, "LOOP msid=%d waiting=%d processed=%d\n", mqs->msid, mqs->waiting, mqs->processed);
-        if (gop_will_block(mqs->gop_waiting) == 0)  { //** Oops!  failed request
-            status = gop_get_status(mqs->gop_waiting);
-            log_printf(2, "msid=%d gid=%d status=%d\n", mqs->msid, gop_id(mqs->gop_waiting), status.op_status);
-            if (status.op_status != OP_STATE_SUCCESS) {
-                mqs->waiting = -3;
+    log_printf(5, "START msid=%d seq=%d n_requested=%d\n", mqs->msid, mqs->seq, mqs->n_requested);
+    while ((mqs->chunk[slot] == NULL) && (err == 0)) {
+        //** Reap any finished requests checking for failures
+        while ((gop = opque_get_next_finished(mqs->q)) != NULL) {
+            if (gop_completed_successfully(gop) != OP_STATE_SUCCESS) {
+                log_printf(2, "msid=%d gid=%d failed\n", mqs->msid, gop_id(gop));
                 err = 1;
-            } else {
-                apr_thread_cond_timedwait(mqs->cond, mqs->lock, dt);
             }
-        } else {
-            apr_thread_cond_timedwait(mqs->cond, mqs->lock, dt);
+            gop_free(gop, OP_DESTROY);
         }
-    }
 
-    if (mqs->waiting == 0) {  //** Flag the receiver to accept the data
-        mqs->waiting = -1;
-        apr_thread_cond_broadcast(mqs->cond);  //** Let the receiver know we're ready to accept the data
+        if ((mqs->chunk[slot] == NULL) && (err == 0)) apr_thread_cond_timedwait(mqs->cond, mqs->lock, apr_time_from_sec(1));
+    }
 
-        //** Wait for the data to be accepted
-        while (mqs->waiting != -2) {
-            apr_thread_cond_wait(mqs->cond, mqs->lock);
-        }
-    } else if (mqs->waiting == -3) { //**error occured
-        err = 1;
+    response = mqs->chunk[slot];
+    if (response != NULL) {
+        mqs->chunk[slot] = NULL;
+        mqs->seq++;
+        err = 0;
     }
     apr_thread_mutex_unlock(mqs->lock);
 
-    //** Flip states
-    mqs->gop_processed = mqs->gop_waiting;
-    mqs->gop_waiting = NULL;
+    if (response == NULL) {
+        log_printf(2, "ERROR msid=%d seq=%d failed request\n", mqs->msid, mqs->seq+1);
+        return(1);
+    }
 
-    //** This shouldn't get triggered but just in case lets throw an error.
-    if ((mqs->gop_processed == NULL) && (mqs->data != NULL)) {
-        if ((mqs->data[MQS_STATE_INDEX] == MQS_MORE) && (mqs->want_more == MQS_MORE)) {
-            err = 3;
-            log_printf(0, "ERROR: MQS gop processed=waiting=NULL  want_more set!!!!!! err=%d\n", err);
-            fprintf(stderr, "ERROR: MQS gop processed=waiting=NULL want_more set!!!!!! err=%d\n", err);
-        }
+    //** Hand it to the unpacker
+    mqs->response = response;
+    mq_get_frame(mq_msg_first(response), (void **)&(mqs->data), &(mqs->len));
+    if (mqs->len < (int)MQS_HEADER) {
+        log_printf(0, "ERROR msid=%d short chunk len=%d\n", mqs->msid, mqs->len);
+        mqs->data = NULL;
+        return(1);
     }
+    tbx_pack_read_new_data(mqs->pack, &(mqs->data[MQS_HEADER]), mqs->len-MQS_HEADER);
 
-    //** Check if we need to fire off the next request
-    if (mqs->data != NULL) {
-        if ((mqs->data[MQS_STATE_INDEX] == MQS_MORE) && (mqs->want_more == MQS_MORE)) {
-            mq_stream_read_request(mqs);
-        }
+    //** Keep the pipeline full
+    if ((mqs->data[MQS_STATE_INDEX] == MQS_MORE) && (mqs->want_more == MQS_MORE)) {
+        mq_stream_read_request(mqs);
     }
 
-    log_printf(5, "err=%d\n", err);
-    return(err);
+    log_printf(5, "END msid=%d seq=%d\n", mqs->msid, mqs->seq);
+    return(0);
 }
 
 //***********************************************************************
@@ -288,6 +330,8 @@ int64_t mq_stream_read_varint(mq_stream_t *mqs, int *error)
 
 void mq_stream_read_destroy(mq_stream_t *mqs)
 {
+    op_generic_t *gop;
+    int i;
 
     log_printf(1, "START msid=%d\n", mqs->msid);
 
@@ -301,18 +345,27 @@ void mq_stream_read_destroy(mq_stream_t *mqs)
     //** Change the flag which signals we don't want anything else
     apr_thread_mutex_lock(mqs->lock);
     mqs->want_more = MQS_ABORT;
+    apr_thread_mutex_unlock(mqs->lock);
 
-    //** Consume all the current data and request the pending
-    while ((mqs->gop_processed != NULL) || (mqs->gop_waiting != NULL)) {
-        log_printf(1, "Clearing pending processed=%p waiting=%p msid=%d\n", mqs->gop_processed, mqs->gop_waiting, mqs->msid);
-        if (mqs->gop_processed != NULL) log_printf(1, "processed gid=%d\n", gop_id(mqs->gop_processed));
-        if (mqs->gop_waiting != NULL) log_printf(1, "waiting gid=%d\n", gop_id(mqs->gop_waiting));
-        mqs->want_more = MQS_ABORT;
-        apr_thread_mutex_unlock(mqs->lock);
-        mq_stream_read_wait(mqs);
-        apr_thread_mutex_lock(mqs->lock);
+    //** A pipelined writer has requests parked so tell it to stop
+    if ((mqs->pipelined == 1) && (mqs->q != NULL)) {
+        if ((mqs->data == NULL) || (mqs->data[MQS_STATE_INDEX] == MQS_MORE)) mqs_read_more_submit(mqs, MQS_ABORT);
     }
 
+    //** Wait for all the pending requests
+    if (mqs->q != NULL) {
+        log_printf(1, "Clearing pending msid=%d n_requested=%d seq=%d\n", mqs->msid, mqs->n_requested, mqs->seq);
+        while ((gop = opque_waitany(mqs->q)) != NULL) {
+            gop_free(gop, OP_DESTROY);
+        }
+        opque_free(mqs->q, OP_DESTROY);
+    }
+    for (i=0; i<MQS_READ_AHEAD; i++) {
+        if (mqs->chunk[i] != NULL) mq_msg_destroy(mqs->chunk[i]);
+    }
+    if (mqs->response != NULL) mq_msg_destroy(mqs->response);
+
+    apr_thread_mutex_lock(mqs->lock);
     if (tbx_log_level() >= 15) {
         char *rhost = mq_address_to_string(mqs->remote_host);
         log_printf(15, "remote_host as string = %s\n", rhost);
@@ -344,6 +397,7 @@ void mq_stream_read_destroy(mq_stream_t *mqs)
 mq_stream_t *mq_stream_read_create(mq_context_t *mqc, mq_ongoing_t *on, char *host_id, int hid_len, mq_frame_t *fdata, mq_msg_t *remote_host, int to)
 {
     mq_stream_t *mqs;
+    intptr_t key;
     int ptype;
 
     tbx_type_malloc_clear(mqs, mq_stream_t, 1);
@@ -369,7 +423,17 @@ mq_stream_t *mq_stream_read_create(mq_context_t *mqc, mq_ongoing_t *on, char *ho
     tbx_type_malloc(mqs->stream_id, char, mqs->sid_len);
     memcpy(mqs->stream_id, &(mqs->data[MQS_HANDLE_INDEX]), mqs->sid_len);
 
-    ptype = (mqs->data[MQS_PACK_INDEX] == MQS_PACK_COMPRESS) ? PACK_COMPRESS : PACK_NONE;
+    //** See if the writer can handle multiple requests in flight
+    key = 0;
+    if (mqs->sid_len == sizeof(key)) memcpy(&key, &(mqs->data[MQS_HANDLE_INDEX]), sizeof(key));
+    if (key & MQS_HANDLE_PIPELINE) {
+        mqs->pipelined = 1;
+        mqs->read_ahead = MQS_READ_AHEAD;
+    } else {
+        mqs->read_ahead = 1;
+    }
+
+    ptype = mqs_pack_type(mqs->data[MQS_PACK_INDEX]);
     log_printf(1, "msid=%d ptype=%d tbx_pack_type=%c\n", mqs->msid, ptype, mqs->data[MQS_PACK_INDEX]);
     mqs->pack = tbx_pack_create(ptype, PACK_READ, &(mqs->data[MQS_HEADER]), mqs->len - MQS_HEADER);
 
@@ -407,11 +471,34 @@ mq_stream_t *mq_stream_read_create(mq_context_t *mqc, mq_ongoing_t *on, char *ho
 //***********************************************************************
 
 //***********************************************************************
-// mqs_write_send - Forms and sends a write response
+// mqs_send_stale - Tells a pipelined reader there's nothing left for the
+//    request.  It's sent for requests past the end of the stream.
+//***********************************************************************
+
+int mqs_send_stale(mq_context_t *mqc, mq_portal_t *portal, mq_msg_t *address, mq_frame_t *fid)
+{
+    mq_msg_t *response;
+    unsigned char *data;
+
+    tbx_type_malloc_clear(data, unsigned char, MQS_HEADER);
+    data[MQS_STATE_INDEX] = MQS_FINISHED;
+    data[MQS_PACK_INDEX] = MQS_PACK_RAW;
+
+    response = mq_make_response_core_msg(address, fid);
+    mq_msg_append_mem(response, data, MQS_HEADER, MQF_MSG_AUTO_FREE);
+    mq_msg_append_frame(response, mqs_seq_frame(-1));
+    mq_msg_append_mem(response, NULL, 0, MQF_MSG_KEEP_DATA);  //** Empty frame
+
+    return(mq_submit(portal, mq_task_new(mqc, response, NULL, NULL, 30)));
+}
+
+//***********************************************************************
+// mqs_write_send - Forms and sends a write response.  If with_seq is set
+//    the chunk sequence number is added for pipelined readers.
 //  **NOTE: Assumes mqs is locked!!!! ***
 //***********************************************************************
 
-int mqs_write_send(mq_stream_t *mqs, mq_msg_t *address, mq_frame_t *fid)
+int mqs_write_send(mq_stream_t *mqs, mq_msg_t *address, mq_frame_t *fid, int with_seq)
 {
     int err;
     unsigned char *new_data;
@@ -419,11 +506,16 @@ int mqs_write_send(mq_stream_t *mqs, mq_msg_t *address, mq_frame_t *fid)
 
     mqs->sent_data = 1;
 
-    if (mqs->data == NULL) return(-1);
+    if (mqs->data == NULL) {  //** Already sent the last chunk
+        if (with_seq == 0) return(-1);
+        mqs_send_stale(mqs->mqc, mqs->server_portal, address, fid);
+        return(0);
+    }
 
-    log_printf(1, "msid=%d address frame count=%d state_index=%c\n", mqs->msid, tbx_stack_count(address), mqs->data[MQS_STATE_INDEX]);
+    log_printf(1, "msid=%d address frame count=%d state_index=%c seq=%d\n", mqs->msid, tbx_stack_count(address), mqs->data[MQS_STATE_INDEX], mqs->seq);
     response = mq_make_response_core_msg(address, fid);
     mq_msg_append_mem(response, mqs->data, MQS_HEADER + tbx_pack_used(mqs->pack), MQF_MSG_AUTO_FREE);
+    if (with_seq == 1) mq_msg_append_frame(response, mqs_seq_frame(mqs->seq));
     mq_msg_append_mem(response, NULL, 0, MQF_MSG_KEEP_DATA);  //** Empty frame
 
 //char buffer[1024];
@@ -453,6 +545,7 @@ int mqs_write_send(mq_stream_t *mqs, mq_msg_t *address, mq_frame_t *fid)
     }
 
     mqs->transfer_packets++;
+    mqs->seq++;
 
     err = mq_submit(mqs->server_portal, mq_task_new(mqs->mqc, response, NULL, NULL, 30));
     if (err != 0) {
@@ -466,31 +559,66 @@ int mqs_write_send(mq_stream_t *mqs, mq_msg_t *address, mq_frame_t *fid)
 }
 
 //***********************************************************************
-// mqs_flusher_thread - Makes sure the write sends a response before the timeout
+// mqs_heartbeat_dt - How long a request for more data can be parked before
+//    it has to be answered to beat the reader's timeout
 //***********************************************************************
 
-void *mqs_flusher_thread(apr_thread_t *th, void *arg)
+apr_time_t mqs_heartbeat_dt(int timeout)
 {
-    mq_stream_t *mqs = (mq_stream_t *)arg;
-    apr_time_t wakeup;
+    if (timeout > 60) return(apr_time_from_sec(timeout - 20));
+    if (timeout > 5) return(apr_time_from_sec(timeout - 5));
+    return(apr_time_from_sec(1));
+}
 
-    log_printf(1, "START: msid=%d\n", mqs->msid);
+//***********************************************************************
+// _mqs_park - Queues a request for more data.  The writer answers the
+//    oldest one each time it flushes.
+//  **NOTE: Assumes mqs is locked!!!! ***
+//***********************************************************************
 
-    //** Figure out when to flush
-    if (mqs->timeout > 60) {
-        wakeup = apr_time_from_sec(mqs->timeout - 20);
-    } else if (mqs->timeout > 5) {
-        wakeup = apr_time_from_sec(mqs->timeout - 5);
-    } else {
-        wakeup = apr_time_from_sec(1);
-    }
+void _mqs_park(mq_stream_t *mqs, mq_msg_t *address, int free_address, mq_frame_t *fid, int pipelined)
+{
+    mqs_parked_t *pr;
+
+    tbx_type_malloc(pr, mqs_parked_t, 1);
+    pr->address = address;
+    pr->free_address = free_address;
+    pr->fid = fid;
+    pr->pipelined = pipelined;
+    pr->deadline = apr_time_now() + mqs_heartbeat_dt(mqs->timeout);
+
+    tbx_stack_move_to_bottom(mqs->parked);
+    tbx_stack_insert_below(mqs->parked, pr);
+    mqs->waiting = tbx_stack_count(mqs->parked);
+    apr_thread_cond_broadcast(mqs->cond);
+}
 
-    //** Sleep until needed
-    apr_thread_mutex_lock(mqs->lock);
-    mqs->waiting = 1;
-    if (mqs->ready == 0) apr_thread_cond_timedwait(mqs->cond, mqs->lock, wakeup);
+//***********************************************************************
+// _mqs_parked_destroy - Destroys a parked request
+//***********************************************************************
+
+void _mqs_parked_destroy(mqs_parked_t *pr)
+{
+    if (pr->fid != NULL) mq_frame_destroy(pr->fid);
+    if (pr->free_address == 1) mq_msg_destroy(pr->address);
+    free(pr);
+}
+
+//***********************************************************************
+// _mqs_parked_send - Sends whatever is buffered to the oldest parked request
+//  **NOTE: Assumes mqs is locked!!!! ***
+//***********************************************************************
+
+int _mqs_parked_send(mq_stream_t *mqs)
+{
+    mqs_parked_t *pr;
+    int err;
+
+    tbx_stack_move_to_top(mqs->parked);
+    pr = tbx_stack_pop(mqs->parked);
+    if (pr == NULL) return(1);
+    mqs->waiting = tbx_stack_count(mqs->parked);
 
-    log_printf(5, "msid=%d want_more=%c state_index=%c data=%p\n", mqs->msid, mqs->want_more, mqs->data[MQS_STATE_INDEX], mqs->data);
     //** Form the message. NOTE that the rest of the message is the address
     if (mqs->want_more == MQS_ABORT) {
         if (mqs->data != NULL) mqs->data[MQS_STATE_INDEX] = mqs->want_more;
@@ -498,26 +626,69 @@ void *mqs_flusher_thread(apr_thread_t *th, void *arg)
         if (mqs->data[MQS_STATE_INDEX] != MQS_MORE) mqs->want_more = mqs->data[MQS_STATE_INDEX];
     }
 
-    mqs_write_send(mqs, mqs->address, mqs->fid);
-    tbx_pack_consumed(mqs->pack);
-    mqs->expire = 0;  //** The new stream request will set this
-    mqs->ready = 0;
-    mqs->waiting = 0;
+    if ((mqs->data == NULL) && (pr->pipelined == 0)) {  //** Nothing left to send an old reader
+        err = -1;
+    } else {
+        err = mqs_write_send(mqs, pr->address, pr->fid, pr->pipelined);
+        pr->fid = NULL;  //** The response owns it now
+    }
+
+    if (err != 0) {
+        log_printf(5, "ERROR during send! Triggering an abort. msid=%d\n", mqs->msid);
+        mqs->want_more = MQS_ABORT;
+    }
+    _mqs_parked_destroy(pr);
+
+    //** Reset the size and let the writer know it's sent
+    mqs->expire = 0;  //** The next stream request will set this
     tbx_pack_consumed(mqs->pack);
     apr_thread_cond_broadcast(mqs->cond);
 
+    return(err);
+}
+
+//***********************************************************************
+// mqs_flusher_thread - Makes sure parked requests get a response before
+//    the reader times out.  If the writer hasn't flushed by the deadline
+//    whatever is buffered is sent to keep the stream alive.
+//***********************************************************************
+
+void *mqs_flusher_thread(apr_thread_t *th, void *arg)
+{
+    mq_stream_t *mqs = (mq_stream_t *)arg;
+    mqs_parked_t *pr;
+    apr_time_t now;
+
+    log_printf(1, "START: msid=%d\n", mqs->msid);
+
+    apr_thread_mutex_lock(mqs->lock);
+    while (mqs->shutdown == 0) {
+        tbx_stack_move_to_top(mqs->parked);
+        pr = tbx_stack_get_current_data(mqs->parked);
+        if (pr == NULL) {
+            apr_thread_cond_wait(mqs->cond, mqs->lock);
+            continue;
+        }
+
+        now = apr_time_now();
+        if (pr->deadline <= now) {
+            log_printf(1, "Deadline hit sending what we have msid=%d\n", mqs->msid);
+            _mqs_parked_send(mqs);
+        } else {
+            apr_thread_cond_timedwait(mqs->cond, mqs->lock, pr->deadline - now);
+        }
+    }
     apr_thread_mutex_unlock(mqs->lock);
 
     log_printf(1, "END: msid=%d\n", mqs->msid);
 
-//** We can exit now cause it's up to the caller to send a new request
-//** Which will be handled by the callback
-
     return(NULL);
 }
 
 //***********************************************************************
-// mqs_server_more_cb - Sends more data to the client
+// mqs_server_more_cb - Handles a reader's request for more data.  The request
+//    is parked on the stream and the worker returns.  It's answered by the
+//    writer's next flush or by the flusher thread at the deadline.
 //***********************************************************************
 
 void mqs_server_more_cb(void *arg, mq_task_t *task)
@@ -527,16 +698,14 @@ void mqs_server_more_cb(void *arg, mq_task_t *task)
     mq_msg_t *msg;
     mq_frame_t *f, *fid, *fmqs, *fuid;
     unsigned char *data, *id, mode;
-    apr_time_t wakeup;
     intptr_t key;
-    int len, id_size, err;
-    int64_t timeout;
+    int len, id_size, msid, pipelined, caps;
 
 
     log_printf(5, "START\n");
 
-    msg = task->msg;  //** Don't have to worry about msg cleanup.  It's handled at a higher level
-    err = -1;
+    msg = task->msg;  //** Don't have to worry about msg cleanup.  It's handled at a higher level unless we park it
+    msid = -1;
 
     //** Parse the response
     mq_remove_header(msg, 0);
@@ -550,17 +719,13 @@ void mqs_server_more_cb(void *arg, mq_task_t *task)
     fmqs = mq_msg_pop(msg);  //** This is the MQS handle
     mq_get_frame(fmqs, (void **)&data, &len);
     log_printf(5, "id_size=%d handle_len=%d\n", id_size, len);
-    key = *(intptr_t *)data;
-    if ((mqs = mq_ongoing_get(ongoing, (char *)id, id_size, key)) == NULL) {
-        log_printf(5, "Invalid handle!\n");
-        goto fail;
-    }
+    key = *(intptr_t *)data & ~((intptr_t)MQS_HANDLE_PIPELINE);
 
-    log_printf(1, "msid=%d\n", mqs->msid);
-
-    f = mq_msg_pop(msg);     //** This is the mode MQS_MORE or MQS_ABORT along with the timeout
+    f = mq_msg_pop(msg);     //** This is the mode MQS_MORE or MQS_ABORT.  Pipelined readers also send their caps
     mq_get_frame(f, (void **)&data, &len);
-    if (len == 1) {
+    pipelined = (len == 2) ? 1 : 0;
+    caps = (pipelined == 1) ? data[1] : 0;
+    if ((len == 1) || (len == 2)) {
         if (data[0] == MQS_MORE) {
             mode = MQS_MORE;
         } else if (data[0] == MQS_ABORT) {
@@ -573,70 +738,42 @@ void mqs_server_more_cb(void *arg, mq_task_t *task)
         log_printf(5, "Invalid mode size=%d! Triggering an abort.\n", len);
         mode = MQS_ABORT;
     }
-
-    //** Now read the timeout
-//  tbx_zigzag_decode(&(data[1]), len-1, &timeout);
-    timeout = mqs->timeout;
-
     mq_frame_destroy(f);
 
-    //** Notify the streamer that we can move data
-    apr_thread_mutex_lock(mqs->lock);
-    mqs->waiting = 1;
-    mqs->expire = apr_time_now() + apr_time_from_sec(timeout);
-    apr_thread_cond_broadcast(mqs->cond);
-
-    mqs->want_more = mode;
-
-    //** Now wait until the application is ready or we are going to timeout
-    if (timeout > 60) {
-        wakeup = apr_time_from_sec(timeout - 20);
-    } else if (mqs->timeout > 5) {
-        wakeup = apr_time_from_sec(timeout - 5);
-    } else {
-        wakeup = apr_time_from_sec(1);
-    }
-    wakeup += apr_time_now();
-
-    log_printf(1, "Waiting for application to consume data msid=%d\n", mqs->msid);
-    err = 0;
-    while ((mqs->ready == 0) && (mqs->want_more == MQS_MORE)) {
-        apr_thread_cond_timedwait(mqs->cond, mqs->lock, apr_time_from_sec(1));
-        if (apr_time_now() > wakeup) {
-            err = 1;     //** Kick out and send whatever's there
-            mqs->ready = 1;
+    if ((mqs = mq_ongoing_get(ongoing, (char *)id, id_size, key)) == NULL) {
+        log_printf(5, "Invalid handle!\n");
+        if (pipelined == 1) {
+            mqs_send_stale(ongoing->mqc, ongoing->server_portal, msg, fid); //** Stream is already gone
+        } else {
+            mq_frame_destroy(fid);
         }
-        log_printf(1, "msid=%d err=%d ready=%d want_more=%c\n", mqs->msid, err, mqs->ready, mqs->want_more);
+        goto fail;
     }
-    log_printf(1, "Application has consumed the data msid=%d err=%d\n", mqs->msid, err);
 
-    //** Form the message. NOTE that the rest of the message is the address
-    if (mqs->want_more == MQS_ABORT) {
-        if (mqs->data != NULL) mqs->data[MQS_STATE_INDEX] = mqs->want_more;
-    } else if (mqs->data != NULL) {
-        if (mqs->data[MQS_STATE_INDEX] != MQS_MORE) mqs->want_more = mqs->data[MQS_STATE_INDEX];
-    }
+    log_printf(1, "msid=%d mode=%c pipelined=%d caps=%d\n", mqs->msid, mode, pipelined, caps);
+    if (pipelined == 1) mq_ongoing_host_caps_set(ongoing, (char *)id, id_size, caps);
 
-    err = mqs_write_send(mqs, msg, fid);
+    //** Park the request.  The address is the rest of the message so we take it
+    apr_thread_mutex_lock(mqs->lock);
+    mqs->expire = apr_time_now() + apr_time_from_sec(mqs->timeout);
+    task->msg = NULL;
+    _mqs_park(mqs, msg, 1, fid, pipelined);
 
-    if (err != 0) {
-        log_printf(5, "ERROR during send! Triggering an abort.\n");
-        mqs->want_more = MQS_ABORT;
-    }
+    //** Pipelined requests can be handled out of order so a trailing MORE can't undo an ABORT or FINISHED
+    if (mode == MQS_ABORT) mqs->want_more = MQS_ABORT;
 
-    //** Let caller know it's sent and reset the size
-    mqs->ready = 0;
-    mqs->waiting = 0;
-    mqs->expire = 0;
-    err = mqs->msid;
-    tbx_pack_consumed(mqs->pack);
-    apr_thread_cond_broadcast(mqs->cond);
+    if (mqs->want_more != MQS_MORE) {  //** Nothing more is coming so answer it now
+        _mqs_parked_send(mqs);
+    } else if ((mqs->flusher_thread == NULL) && (mqs->shutdown == 0)) {  //** Make sure it's answered before the reader gives up
+        tbx_thread_create_assert(&(mqs->flusher_thread), NULL, mqs_flusher_thread,  (void *)mqs, mqs->mpool);
+    }
+    msid = mqs->msid;
     apr_thread_mutex_unlock(mqs->lock);
 
     mq_ongoing_release(ongoing, (char *)id, id_size, key);  //** Do this to avoiud a deadlock on failure in mqs_on_fail()
 
 fail:
-    log_printf(1, "END msid=%d\n", err);
+    log_printf(1, "END msid=%d\n", msid);
 
     mq_frame_destroy(fuid);
     mq_frame_destroy(fmqs);
@@ -646,7 +783,8 @@ fail:
 
 
 //***********************************************************************
-// mq_stream_write_flush - Flushs pending data
+// mq_stream_write_flush - Sends the pending data to the oldest parked
+//    request waiting for one if needed
 //***********************************************************************
 
 int mq_stream_write_flush(mq_stream_t *mqs)
@@ -656,33 +794,24 @@ int mq_stream_write_flush(mq_stream_t *mqs)
 
     dt = apr_time_from_sec(1);
 
-    //** Let a pending call know we have data ready
     apr_thread_mutex_lock(mqs->lock);
     expire = apr_time_now() + apr_time_from_sec(mqs->timeout);
-    mqs->ready = 1;
-    apr_thread_cond_broadcast(mqs->cond);
 
-    //** Now wait for the pending call acknowledgement
+    //** Wait for a request to send it to
     log_printf(1, "Flushing stream msid=%d now=" TT " timeout(s)=%d waiting=%d\n", mqs->msid, apr_time_now(), mqs->timeout, mqs->waiting);
-    while (mqs->waiting == 0) {
+    while ((tbx_stack_count(mqs->parked) == 0) && (err == 0)) {
         if (((mqs->want_more == MQS_ABORT) || (mqs->data == NULL) || mqs->dead_connection == 1))  { //** Oops! No client request or abort flagged
             if (apr_time_now() > expire) log_printf(0, "EXPIRED msid=%d now=" TT " expire= " TT " timeout(s)=%d\n", mqs->msid, apr_time_now(), expire, mqs->timeout);
-            mqs->waiting = -3;
             err = 1;
         } else {
             apr_thread_cond_timedwait(mqs->cond, mqs->lock, dt);
         }
     }
 
-    while ((mqs->ready == 1) && (mqs->waiting != -3)) {
-        apr_thread_cond_timedwait(mqs->cond, mqs->lock, dt);
-        log_printf(1, "waiting for send to complete msid=%d ready=%d now=" TT " timeout(s)=%d\n", mqs->msid, mqs->ready, apr_time_now(), mqs->timeout);
-    }
+    if (err == 0) _mqs_parked_send(mqs);
 
     log_printf(1, "Stream flush completed.  mqs->waiting=%d msid=%d want_more=%c dead=%d data=%p now=" TT "\n", mqs->waiting, mqs->msid, mqs->want_more, mqs->dead_connection, mqs->data, apr_time_now());
 
-    if ((err == 0) && (mqs->waiting < -1)) err = 1;  //** Check if sending had an error
-
     apr_thread_mutex_unlock(mqs->lock);
 
     return(err);
@@ -705,6 +834,28 @@ op_generic_t *mqs_write_on_fail(void *arg, void *handle)
     return(gop_dummy(op_success_status));
 }
 
+//***********************************************************************
+// mqs_write_grow - Grows the send buffer.  Returns 1 if it grew and 0
+//    if it's already at the max size.
+//***********************************************************************
+
+int mqs_write_grow(mq_stream_t *mqs, int nleft)
+{
+    int nbytes;
+
+    if (mqs->len >= mqs->max_size) return(0);
+
+    nbytes = 2 * mqs->len + nleft;
+    if (nbytes > mqs->max_size) nbytes = mqs->max_size;
+
+    log_printf(5, "growing space=%d\n", nbytes);
+    tbx_type_realloc(mqs->data, unsigned char, nbytes);
+    mqs->len = nbytes;
+    tbx_pack_write_resized(mqs->pack, &(mqs->data[MQS_HEADER]), mqs->len - MQS_HEADER);
+
+    return(1);
+}
+
 //***********************************************************************
 // mq_stream_write - Writes data to the stream
 //***********************************************************************
@@ -727,18 +878,7 @@ int mq_stream_write(mq_stream_t *mqs, void *vdata, int len)
         grew_space = 0;
         nbytes = mqs->len - tbx_pack_used(mqs->pack) - MQS_HEADER;
         log_printf(5, "nbytes=%d mqs->len=%d mqs->max_size=%d\n", nbytes, mqs->len, mqs->max_size);
-        if (nbytes < nleft) { //** See if we can grow the space
-            if (mqs->len < mqs->max_size) {
-                nbytes = 2 * mqs->len + nleft;
-                if (nbytes > mqs->max_size) nbytes = mqs->max_size;
-
-                log_printf(5, "growing space=%d\n", nbytes);
-                tbx_type_realloc(mqs->data, unsigned char, nbytes);
-                mqs->len = nbytes;
-                tbx_pack_write_resized(mqs->pack, &(mqs->data[MQS_HEADER]), mqs->len - MQS_HEADER);
-                grew_space = 1;
-            }
-        }
+        if (nbytes < nleft) grew_space = mqs_write_grow(mqs, nleft); //** See if we can grow the space
 
         nbytes = tbx_pack_write(mqs->pack, &(data[dpos]), nleft);
         log_printf(5, "nbytes_packed=%d nleft=%d mqs->len=%d\n", nbytes, nleft, mqs->len);
@@ -749,6 +889,9 @@ int mq_stream_write(mq_stream_t *mqs, void *vdata, int len)
             tbx_pack_consumed(mqs->pack);    //** Rest so garbage data isn't sent
         }
 
+        //** A block codec can stop short with room left so try growing before flushing
+        if ((nleft > 0) && (grew_space == 0)) grew_space = mqs_write_grow(mqs, nleft);
+
         if ((nleft > 0) && (grew_space == 0)) {  //** Need to flush the data
             if (mqs->mpool == NULL) {  //** Got to configure everything
                 apr_pool_create(&mqs->mpool, NULL);
@@ -758,9 +901,8 @@ int mq_stream_write(mq_stream_t *mqs, void *vdata, int len)
                 mqs->oo = mq_ongoing_add(mqs->ongoing, 0, mqs->host_id, mqs->hid_len, mqs, mqs_write_on_fail, NULL);
 
                 if (nleft > 0) mqs->data[MQS_STATE_INDEX] = MQS_MORE;
-                mqs_write_send(mqs, mqs->address, mqs->fid);
+                mqs_write_send(mqs, mqs->address, mqs->fid, 0);
                 mqs->expire = 0;  //** The new stream request will set this
-                mqs->waiting = 0;
                 //apr_thread_mutex_unlock(mqs->lock);
             } else {
                 apr_thread_mutex_unlock(mqs->lock);
@@ -792,7 +934,7 @@ int mq_stream_write(mq_stream_t *mqs, void *vdata, int len)
                 }
 
                 if (mqs->sent_data == 0) { //** 1st send
-                    mqs_write_send(mqs, mqs->address, mqs->fid);
+                    mqs_write_send(mqs, mqs->address, mqs->fid, 0);
                     mqs->sent_data = 1;
                     tbx_pack_consumed(mqs->pack);
                 } else {  //** Got a pending request so just do a flush
@@ -838,6 +980,7 @@ int mq_stream_write_varint(mq_stream_t *mqs, int64_t value)
 void mq_stream_write_destroy(mq_stream_t *mqs)
 {
     apr_status_t status;
+    mqs_parked_t *pr;
     int abort_error = 0;
 
     log_printf(1, "Destroying stream msid=%d\n", mqs->msid);
@@ -881,6 +1024,16 @@ void mq_stream_write_destroy(mq_stream_t *mqs)
         mq_ongoing_remove(mqs->ongoing, mqs->host_id, mqs->hid_len, mqs->oo->key);
     }
 
+    //** Anything still parked won't get data so let pipelined readers know
+    while ((pr = tbx_stack_pop(mqs->parked)) != NULL) {
+        if (pr->pipelined == 1) {
+            mqs_send_stale(mqs->mqc, mqs->server_portal, pr->address, pr->fid);
+            pr->fid = NULL;
+        }
+        _mqs_parked_destroy(pr);
+    }
+    tbx_stack_free(mqs->parked, 0);
+
     //** Clean up
     if (mqs->mpool != NULL) {
         apr_thread_mutex_destroy(mqs->lock);
@@ -923,6 +1076,7 @@ mq_stream_t *mq_stream_write_create(mq_context_t *mqc, mq_portal_t *server_porta
     mqs->want_more = MQS_MORE;
     mqs->expire = apr_time_from_sec(timeout) + apr_time_now();
     mqs->msid = tbx_atomic_global_counter();
+    mqs->parked = tbx_stack_new();
 
     mq_get_frame(hid, (void **)&(mqs->host_id), &(mqs->hid_len));
 
@@ -930,11 +1084,14 @@ mq_stream_t *mq_stream_write_create(mq_context_t *mqc, mq_portal_t *server_porta
     mqs->len = 4 * 1024;
     tbx_type_malloc_clear(mqs->data, unsigned char, mqs->len);
     mqs->data[MQS_STATE_INDEX] = MQS_MORE;
+    if ((tbx_pack_type == MQS_PACK_COMPRESS) && (mq_ongoing_host_caps_get(ongoing, mqs->host_id, mqs->hid_len) & MQS_CAP_LZ)) {
+        tbx_pack_type = MQS_PACK_LZ;  //** The reader can handle the faster codec
+    }
     mqs->data[MQS_PACK_INDEX] = tbx_pack_type;
     mqs->data[MQS_HANDLE_SIZE_INDEX] = sizeof(intptr_t);
-    key = (intptr_t)mqs;
+    key = (intptr_t)mqs | MQS_HANDLE_PIPELINE;  //** Let the reader know it can pipeline requests
     memcpy(&(mqs->data[MQS_HANDLE_INDEX]), &key, sizeof(key));
-    ptype = (mqs->data[MQS_PACK_INDEX] == MQS_PACK_COMPRESS) ? PACK_COMPRESS : PACK_NONE;
+    ptype = mqs_pack_type(mqs->data[MQS_PACK_INDEX]);
     log_printf(1, "msid=%d ptype=%d tbx_pack_type=%c\n", mqs->msid, ptype, mqs->data[MQS_PACK_INDEX]);
     mqs->pack = tbx_pack_create(ptype, PACK_WRITE, &(mqs->data[MQS_HEADER]), mqs->len-MQS_HEADER);
 
@@ -947,6 +1104,7 @@ mq_stream_t *mq_stream_write_create(mq_context_t *mqc, mq_portal_t *server_porta
         apr_thread_cond_create(&(mqs->cond), mqs->mpool);
         mqs->oo = mq_ongoing_add(mqs->ongoing, 0, mqs->host_id, mqs->hid_len, mqs, mqs_write_on_fail, NULL);
         mqs->sent_data = 1;
+        _mqs_park(mqs, mqs->address, 0, mqs->fid, 0);  //** The original request gets the 1st chunk
         tbx_thread_create_assert(&(mqs->flusher_thread), NULL, mqs_flusher_thread,  (void *)mqs, mqs->mpool);
     }
 
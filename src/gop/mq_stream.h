@@ -23,6 +23,7 @@
 #include "mq_portal.h"
 #include "mq_ongoing.h"
 #include <tbx/packer.h>
+#include <tbx/stack.h>
 
 #ifndef _MQ_STREAM_H_
 #define _MQ_STREAM_H_
@@ -41,7 +42,17 @@ extern "C" {
 
 //** Pack type
 #define MQS_PACK_RAW 'R'
-#define MQS_PACK_COMPRESS 'Z'
+#define MQS_PACK_COMPRESS 'Z'   //** Uses MQS_PACK_LZ instead if the reader supports it
+#define MQS_PACK_LZ 'L'
+
+//** Tagged in the low bit of the handle by writers that accept pipelined
+//** requests.  The chunks they send back carry a sequence number frame.
+#define MQS_HANDLE_PIPELINE 1
+
+//** Codecs a pipelined reader supports.  Sent in the 2nd byte of the more request mode.
+#define MQS_CAP_LZ 1
+
+#define MQS_READ_AHEAD 4   //** Max chunks a pipelined reader has outstanding
 
 #define MQS_READ  0
 #define MQS_WRITE 1
@@ -63,8 +74,9 @@ typedef struct {
     mq_portal_t *server_portal;
     mq_frame_t *fid;
     mq_frame_t *hid;
-    op_generic_t *gop_waiting;
-    op_generic_t *gop_processed;
+    opque_t *q;                          //** Outstanding requests for more data
+    mq_msg_t *chunk[MQS_READ_AHEAD];     //** Chunks received but not yet consumed
+    mq_msg_t *response;                  //** Chunk currently being consumed
     mq_ongoing_t *ongoing;
     mq_ongoing_object_t *oo;
     char want_more;
@@ -80,9 +92,12 @@ typedef struct {
     tbx_pack_t *pack;
     int len;
     int bpos;
-    int waiting;
-    int processed;
-    int ready;
+    tbx_stack_t *parked;   //** FIFO of requests for more data waiting on the writer
+    int waiting;           //** Number of parked requests for more data
+    int read_ahead;
+    int n_requested;
+    int seq;
+    int pipelined;
     int type;
     int timeout;
     int max_size;
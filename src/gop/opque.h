@@ -131,6 +131,8 @@ typedef struct {             //** Handle for maintaining all the ecopy connectio
     int abort_conn_attempts;   //** If this many failed connection requests occur in a row we abort
     int check_connection_interval; //** Max time to wait for a thread to check for a close
     int max_retry;             //** Default max number of times to retry an op
+    int epoll_threads;         //** If >0 connections are multiplexed on this many epoll I/O threads instead of a send/recv thread pair each
+    struct hc_epoll_s *epoll;  //** epoll connection engine.  Created on first use
     int count;                 //** Internal Counter
     apr_time_t   next_check;       //** Time for next compact_dportal call
     tbx_ns_timeout_t dt;          //** Default wait time
@@ -36,10 +36,16 @@ extern "C" {
 #define TP_E_NOP               -1
 #define TP_E_IGNORE            -2
 
+#define TP_EXEC_WS   0   //** Work stealing executor
+#define TP_EXEC_APR  1   //** APR thread pool
+
+typedef struct tp_ws_s tp_ws_t;
+
 typedef struct {
     char *name;
     portal_context_t *pc;
     apr_thread_pool_t *tp;
+    tp_ws_t *ws;
     tbx_stack_t **reserve_stack;
     int *overflow_running_depth;
     tbx_atomic_unit32_t n_overflow;
@@ -83,6 +89,10 @@ GOP_API void thread_pool_destroy_context(thread_pool_context_t *tpc);
 
 void thread_pool_exec_fn(void *arg, op_generic_t *op);
 
+tp_ws_t *tp_ws_create(int min_workers, int max_workers, int max_concurrency, int recursion_depth, apr_pool_t *tp_pool);
+void tp_ws_destroy(tp_ws_t *ws);
+void tp_ws_submit(tp_ws_t *ws, apr_thread_start_t fn, void *arg, int depth);
+
 #ifdef __cplusplus
 }
 #endif
@@ -136,6 +136,11 @@ void _tp_submit_op(void *arg, op_generic_t *gop)
     op->via_submit = 1;
     running = tbx_atomic_inc(op->tpc->n_running) + 1;
 
+    if (op->tpc->ws != NULL) {  //** The executor does its own concurrency and overflow slots by depth
+        tp_ws_submit(op->tpc->ws, (apr_thread_start_t)thread_pool_exec_fn, gop, (op->depth > 0) ? op->depth : 1);
+        return;
+    }
+
     if (running > op->tpc->max_concurrency) {
         apr_thread_mutex_lock(_tp_lock);
         tbx_atomic_inc(op->tpc->n_overflow);
@@ -205,10 +210,17 @@ void _tp_close_connection(tbx_ns_t *ns)
 
 int thread_pool_direct(thread_pool_context_t *tpc, apr_thread_start_t fn, void *arg)
 {
-    int err = apr_thread_pool_push(tpc->tp, fn, arg, APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+    int err;
 
     tbx_atomic_inc(tpc->n_direct);
 
+    if (tpc->ws != NULL) {
+        tp_ws_submit(tpc->ws, fn, arg, 0);
+        return(0);
+    }
+
+    err = apr_thread_pool_push(tpc->tp, fn, arg, APR_THREAD_TASK_PRIORITY_NORMAL, NULL);
+
     log_printf(10, "tpd=%d\n", tbx_atomic_get(tpc->n_direct));
     if (err != APR_SUCCESS) {
         log_printf(0, "ERROR submiting task!  err=%d\n", err);
@@ -241,7 +253,8 @@ thread_pool_context_t *thread_pool_create_context(char *tp_name, int min_threads
 //  char buffer[1024];
     thread_pool_context_t *tpc;
     apr_interval_time_t dt;
-    int i;
+    char *eval;
+    int i, mode;
 
     log_printf(15, "count=%d\n", _tp_context_count);
 
@@ -267,10 +280,21 @@ thread_pool_context_t *thread_pool_create_context(char *tp_name, int min_threads
         log_printf(0, "Specified max threads and recursion depth don't work. Adjusting max_threads=%d\n", tpc->max_threads);
     }
 
-    dt = tpc->min_idle * 1000000;
-    assert_result(apr_thread_pool_create(&(tpc->tp), tpc->min_threads, tpc->max_threads, _tp_pool), APR_SUCCESS);
-    apr_thread_pool_idle_wait_set(tpc->tp, dt);
-    apr_thread_pool_threshold_set(tpc->tp, 0);
+    //** See which executor to use
+    eval = NULL;
+    apr_thread_mutex_lock(_tp_lock);
+    apr_env_get(&eval, "GOP_TP_EXECUTOR", _tp_pool);
+    apr_thread_mutex_unlock(_tp_lock);
+    mode = ((eval != NULL) && (strcmp(eval, "apr") == 0)) ? TP_EXEC_APR : TP_EXEC_WS;
+
+    if (mode == TP_EXEC_WS) {
+        tpc->ws = tp_ws_create(tpc->min_threads, tpc->max_threads, tpc->max_concurrency, tpc->recursion_depth, _tp_pool);
+    } else {
+        dt = tpc->min_idle * 1000000;
+        assert_result(apr_thread_pool_create(&(tpc->tp), tpc->min_threads, tpc->max_threads, _tp_pool), APR_SUCCESS);
+        apr_thread_pool_idle_wait_set(tpc->tp, dt);
+        apr_thread_pool_threshold_set(tpc->tp, 0);
+    }
 
     tpc->name = (tp_name == NULL) ? NULL : strdup(tp_name);
     tbx_atomic_set(tpc->n_ops, 0);
@@ -299,10 +323,14 @@ void thread_pool_destroy_context(thread_pool_context_t *tpc)
     int i;
     log_printf(15, "thread_pool_destroy_context: Shutting down! count=%d\n", _tp_context_count);
 
-    log_printf(15, "tpc->name=%s  high=%zu idle=%zu\n", tpc->name, apr_thread_pool_threads_high_count(tpc->tp),  apr_thread_pool_threads_idle_timeout_count(tpc->tp));
     destroy_hportal_context(tpc->pc);
 
-    apr_thread_pool_destroy(tpc->tp);
+    if (tpc->ws != NULL) {
+        tp_ws_destroy(tpc->ws);
+    } else {
+        log_printf(15, "tpc->name=%s  high=%zu idle=%zu\n", tpc->name, apr_thread_pool_threads_high_count(tpc->tp),  apr_thread_pool_threads_idle_timeout_count(tpc->tp));
+        apr_thread_pool_destroy(tpc->tp);
+    }
 
     if (tbx_atomic_dec(_tp_context_count) == 0) {
         if (_tp_stats > 0) thread_pool_stats_print();
@@ -0,0 +1,500 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*************************************************************
+// Work stealing executor used behind thread_pool_context_t.
+//
+// Each worker owns a deque.  Nested tasks submitted from a worker go on
+// the bottom of its own deque and are run LIFO so nested ops execute hot
+// on the thread that created them.  Top level ops go on a shared injection
+// queue and direct tasks on their own queue.  Idle workers run nested work
+// first, stealing FIFO from the top of the other workers' deques, and only
+// then take new top level work.
+//
+// Like the APR pool's reserve stacks, at most max_concurrency ops run
+// normally.  Once that's exhausted a nested task can still run in one of
+// the recursion_depth overflow slots but only if it's deeper than every
+// op already using an overflow slot.  The deepest op always has room for
+// its children so a parent blocked in gop_waitall can't starve them.
+// Direct tasks don't count against the concurrency just like before.
+//*************************************************************
+
+#define _log_module_index 226
+
+#include <assert.h>
+#include <tbx/assert_result.h>
+#include <apr_atomic.h>
+#include <apr_pools.h>
+#include <apr_thread_proc.h>
+#include <tbx/apr_wrapper.h>
+#include <tbx/atomic_counter.h>
+#include <tbx/log.h>
+#include <tbx/type_malloc.h>
+#include "thread_pool.h"
+
+#define TP_WS_DEQUE_SIZE 64  //** Initial deque size.  It grows as needed
+
+#define TP_WS_SLOT_DIRECT -2  //** Direct task so no concurrency slot
+#define TP_WS_SLOT_NORMAL -1  //** Running under max_concurrency
+
+typedef struct {
+    apr_thread_start_t fn;
+    void *arg;
+    int depth;
+    int slot;       //** TP_WS_SLOT_* or the overflow slot used
+} tp_ws_task_t;
+
+typedef struct {    //** Circular deque.  Owner works the bottom and thieves the top
+    apr_thread_mutex_t *lock;
+    tp_ws_task_t *task;
+    int size;
+    int top;
+    int n;
+} tp_ws_deque_t;
+
+typedef struct {
+    tp_ws_t *ws;
+    tp_ws_deque_t dq;
+    apr_thread_t *thread;
+    int index;
+} tp_ws_worker_t;
+
+struct tp_ws_s {
+    apr_pool_t *mpool;
+    apr_thread_mutex_t *lock;   //** Protects sleeping, spawning, the overflow slots, and shutdown
+    apr_thread_cond_t *cond;
+    tp_ws_deque_t inject;       //** Top level ops
+    tp_ws_deque_t nest;         //** Nested ops submitted from outside the pool
+    tp_ws_deque_t direct;       //** Direct tasks
+    tp_ws_worker_t *worker;
+    int *overflow_depth;        //** Depth running in each overflow slot or -1 if free
+    tbx_atomic_unit32_t n_workers;
+    tbx_atomic_unit32_t n_idle;
+    tbx_atomic_unit32_t n_pending;
+    tbx_atomic_unit32_t n_running;  //** Ops running under max_concurrency
+    tbx_atomic_unit32_t n_epoch;    //** Bumped on every submit and completion so sleepers don't miss work
+    tbx_atomic_unit32_t n_steals;
+    tbx_atomic_unit32_t n_overflow;
+    int max_workers;
+    int max_concurrency;
+    int recursion_depth;
+    int shutdown;
+};
+
+static apr_threadkey_t *_tp_ws_worker_key = NULL;
+
+//*************************************************************
+// _tp_ws_deque_init - Initializes a deque
+//*************************************************************
+
+void _tp_ws_deque_init(tp_ws_deque_t *dq, apr_pool_t *mpool)
+{
+    apr_thread_mutex_create(&(dq->lock), APR_THREAD_MUTEX_DEFAULT, mpool);
+    dq->size = TP_WS_DEQUE_SIZE;
+    tbx_type_malloc(dq->task, tp_ws_task_t, dq->size);
+    dq->top = 0;
+    dq->n = 0;
+}
+
+//*************************************************************
+// _tp_ws_deque_push - Adds a task to the bottom of the deque
+//*************************************************************
+
+void _tp_ws_deque_push(tp_ws_deque_t *dq, apr_thread_start_t fn, void *arg, int depth)
+{
+    tp_ws_task_t *t;
+    int i, slot;
+
+    apr_thread_mutex_lock(dq->lock);
+    if (dq->n == dq->size) {  //** Full so double it and unwrap
+        tbx_type_malloc(t, tp_ws_task_t, 2*dq->size);
+        for (i=0; i<dq->n; i++) t[i] = dq->task[(dq->top + i) % dq->size];
+        free(dq->task);
+        dq->task = t;
+        dq->top = 0;
+        dq->size = 2*dq->size;
+    }
+
+    slot = (dq->top + dq->n) % dq->size;
+    dq->task[slot].fn = fn;
+    dq->task[slot].arg = arg;
+    dq->task[slot].depth = depth;
+    dq->n++;
+    apr_thread_mutex_unlock(dq->lock);
+}
+
+//*************************************************************
+// _tp_ws_deque_pop - Removes a task from the bottom (LIFO) or the top (FIFO)
+//    of the deque.  Returns 0 if a task was found.
+//*************************************************************
+
+int _tp_ws_deque_pop(tp_ws_deque_t *dq, int from_top, tp_ws_task_t *task)
+{
+    if (dq->n == 0) return(1);  //** Racy peek to skip the lock on empty deques
+
+    apr_thread_mutex_lock(dq->lock);
+    if (dq->n == 0) {
+        apr_thread_mutex_unlock(dq->lock);
+        return(1);
+    }
+
+    if (from_top == 1) {
+        *task = dq->task[dq->top];
+        dq->top = (dq->top + 1) % dq->size;
+    } else {
+        *task = dq->task[(dq->top + dq->n - 1) % dq->size];
+    }
+    dq->n--;
+    apr_thread_mutex_unlock(dq->lock);
+
+    return(0);
+}
+
+//*************************************************************
+// _tp_ws_deque_take - Removes the newest task deeper than min_depth.
+//    Returns 0 if a task was found.
+//*************************************************************
+
+int _tp_ws_deque_take(tp_ws_deque_t *dq, int min_depth, tp_ws_task_t *task)
+{
+    int i, j;
+
+    if (dq->n == 0) return(1);
+
+    apr_thread_mutex_lock(dq->lock);
+    for (i=dq->n-1; i>=0; i--) {
+        if (dq->task[(dq->top + i) % dq->size].depth > min_depth) break;
+    }
+    if (i < 0) {
+        apr_thread_mutex_unlock(dq->lock);
+        return(1);
+    }
+
+    *task = dq->task[(dq->top + i) % dq->size];
+    for (j=i; j<dq->n-1; j++) dq->task[(dq->top + j) % dq->size] = dq->task[(dq->top + j + 1) % dq->size];
+    dq->n--;
+    apr_thread_mutex_unlock(dq->lock);
+
+    return(0);
+}
+
+//*************************************************************
+// _tp_ws_slot_get - Reserves a normal concurrency slot.  Returns 0 on success.
+//*************************************************************
+
+int _tp_ws_slot_get(tp_ws_t *ws)
+{
+    apr_uint32_t n;
+
+    do {
+        n = tbx_atomic_get(ws->n_running);
+        if ((int)n >= ws->max_concurrency) return(1);
+    } while (apr_atomic_cas32(&(ws->n_running), n+1, n) != n);
+
+    return(0);
+}
+
+//*************************************************************
+// _tp_ws_slot_release - Releases the slot used by a finished task and lets
+//    any sleepers know something changed
+//*************************************************************
+
+void _tp_ws_slot_release(tp_ws_t *ws, tp_ws_task_t *task)
+{
+    if (task->slot == TP_WS_SLOT_NORMAL) {
+        tbx_atomic_dec(ws->n_running);
+    } else if (task->slot >= 0) {
+        apr_thread_mutex_lock(ws->lock);
+        ws->overflow_depth[task->slot] = -1;
+        apr_thread_mutex_unlock(ws->lock);
+    }
+
+    tbx_atomic_inc(ws->n_epoch);
+    if ((tbx_atomic_get(ws->n_pending) > 0) && (tbx_atomic_get(ws->n_idle) > 0)) {
+        apr_thread_mutex_lock(ws->lock);
+        apr_thread_cond_signal(ws->cond);
+        apr_thread_mutex_unlock(ws->lock);
+    }
+}
+
+//*************************************************************
+// _tp_ws_find_nested - Looks for nested work.  Checks the worker's own
+//    deque, then the outside nested queue, then tries to steal from the others.
+//    Only tasks deeper than min_depth are considered if min_depth >= 0.
+//*************************************************************
+
+int _tp_ws_find_nested(tp_ws_worker_t *w, int min_depth, tp_ws_task_t *task)
+{
+    tp_ws_t *ws = w->ws;
+    tp_ws_deque_t *dq;
+    int i, n;
+
+    if (min_depth < 0) {
+        if (_tp_ws_deque_pop(&(w->dq), 0, task) == 0) return(0);
+        if (_tp_ws_deque_pop(&(ws->nest), 1, task) == 0) return(0);
+    } else {
+        if (_tp_ws_deque_take(&(w->dq), min_depth, task) == 0) return(0);
+        if (_tp_ws_deque_take(&(ws->nest), min_depth, task) == 0) return(0);
+    }
+
+    n = tbx_atomic_get(ws->n_workers);
+    for (i=1; i<n; i++) {
+        dq = &(ws->worker[(w->index + i) % n].dq);
+        if (((min_depth < 0) ? _tp_ws_deque_pop(dq, 1, task) : _tp_ws_deque_take(dq, min_depth, task)) == 0) {
+            tbx_atomic_inc(ws->n_steals);
+            return(0);
+        }
+    }
+
+    return(1);
+}
+
+//*************************************************************
+// _tp_ws_find_overflow - Looks for a nested task that can run in an overflow
+//    slot.  It has to be deeper than anything already in overflow.
+//*************************************************************
+
+int _tp_ws_find_overflow(tp_ws_worker_t *w, tp_ws_task_t *task)
+{
+    tp_ws_t *ws = w->ws;
+    int i, dmax, slot, err;
+
+    apr_thread_mutex_lock(ws->lock);
+    dmax = 1;  //** Top level ops never overflow
+    slot = -1;
+    for (i=0; i<ws->recursion_depth; i++) {
+        if (ws->overflow_depth[i] > dmax) dmax = ws->overflow_depth[i];
+        if (ws->overflow_depth[i] == -1) slot = i;
+    }
+
+    err = 1;
+    if (slot != -1) {
+        err = _tp_ws_find_nested(w, dmax, task);
+        if (err == 0) {
+            ws->overflow_depth[slot] = task->depth;
+            task->slot = slot;
+            tbx_atomic_inc(ws->n_overflow);
+        }
+    }
+    apr_thread_mutex_unlock(ws->lock);
+
+    return(err);
+}
+
+//*************************************************************
+// _tp_ws_find_task - Looks for the next task for the worker.  Nested work
+//    comes before new top level ops which are capped at max_concurrency.
+//    Direct tasks are last and don't need a slot.
+//*************************************************************
+
+int _tp_ws_find_task(tp_ws_worker_t *w, tp_ws_task_t *task)
+{
+    tp_ws_t *ws = w->ws;
+
+    if (_tp_ws_slot_get(ws) == 0) {
+        if ((_tp_ws_find_nested(w, -1, task) == 0) || (_tp_ws_deque_pop(&(ws->inject), 1, task) == 0)) {
+            task->slot = TP_WS_SLOT_NORMAL;
+            return(0);
+        }
+        tbx_atomic_dec(ws->n_running);  //** Nothing to use it on
+    } else if (_tp_ws_find_overflow(w, task) == 0) {
+        return(0);
+    }
+
+    if (_tp_ws_deque_pop(&(ws->direct), 1, task) == 0) {
+        task->slot = TP_WS_SLOT_DIRECT;
+        return(0);
+    }
+
+    return(1);
+}
+
+//*************************************************************
+// _tp_ws_worker - Worker thread
+//*************************************************************
+
+void *_tp_ws_worker(apr_thread_t *th, void *data)
+{
+    tp_ws_worker_t *w = (tp_ws_worker_t *)data;
+    tp_ws_t *ws = w->ws;
+    tp_ws_task_t task;
+    apr_uint32_t epoch;
+
+    apr_threadkey_private_set(w, _tp_ws_worker_key);
+
+    while (1) {
+        epoch = tbx_atomic_get(ws->n_epoch);
+        if (_tp_ws_find_task(w, &task) == 0) {
+            tbx_atomic_dec(ws->n_pending);
+            task.fn(th, task.arg);
+            _tp_ws_slot_release(ws, &task);
+            continue;
+        }
+
+        //** Nothing we can run so go to sleep.  We flag ourselves idle before checking
+        //** the epoch so a submitter or finisher either sees us idle or we see its change.
+        //** Pending tasks may be waiting on a slot so they don't keep us awake.
+        apr_thread_mutex_lock(ws->lock);
+        tbx_atomic_inc(ws->n_idle);
+        if (tbx_atomic_get(ws->n_epoch) != epoch) {
+            tbx_atomic_dec(ws->n_idle);
+            apr_thread_mutex_unlock(ws->lock);
+            continue;
+        }
+        if ((ws->shutdown == 1) && (tbx_atomic_get(ws->n_pending) == 0)) {
+            tbx_atomic_dec(ws->n_idle);
+            apr_thread_mutex_unlock(ws->lock);
+            break;
+        }
+        apr_thread_cond_timedwait(ws->cond, ws->lock, apr_time_from_sec(1));
+        tbx_atomic_dec(ws->n_idle);
+        apr_thread_mutex_unlock(ws->lock);
+    }
+
+    apr_thread_exit(th, 0);
+    return(NULL);
+}
+
+//*************************************************************
+// _tp_ws_spawn - Starts a new worker if we're below the limit
+//    NOTE: ws->lock should be held
+//*************************************************************
+
+void _tp_ws_spawn(tp_ws_t *ws, int limit)
+{
+    tp_ws_worker_t *w;
+    int n;
+
+    n = tbx_atomic_get(ws->n_workers);
+    if (n >= limit) return;
+
+    w = &(ws->worker[n]);
+    w->ws = ws;
+    w->index = n;
+    _tp_ws_deque_init(&(w->dq), ws->mpool);
+    tbx_atomic_inc(ws->n_workers);  //** Publish it after the deque is ready for thieves
+    tbx_thread_create_assert(&(w->thread), NULL, _tp_ws_worker, (void *)w, ws->mpool);
+}
+
+//*************************************************************
+// tp_ws_submit - Submits a task to the executor.  depth is the op's recursion
+//    depth with 0 for direct tasks and 1 for top level ops.
+//*************************************************************
+
+void tp_ws_submit(tp_ws_t *ws, apr_thread_start_t fn, void *arg, int depth)
+{
+    tp_ws_worker_t *w = NULL;
+
+    if (depth >= ws->recursion_depth) {  //** Same clamp the reserve stacks use
+        log_printf(0, "Task recursion depth >= max specified in the TP!!!! depth=%d max=%d\n", depth, ws->recursion_depth);
+        depth = ws->recursion_depth - 1;
+    }
+
+    if (depth == 0) {
+        _tp_ws_deque_push(&(ws->direct), fn, arg, depth);
+    } else if (depth == 1) {
+        _tp_ws_deque_push(&(ws->inject), fn, arg, depth);
+    } else {
+        apr_threadkey_private_get((void *)&w, _tp_ws_worker_key);
+        if ((w != NULL) && (w->ws == ws)) {
+            _tp_ws_deque_push(&(w->dq), fn, arg, depth);  //** Keep it local so it runs LIFO
+        } else {
+            _tp_ws_deque_push(&(ws->nest), fn, arg, depth);
+        }
+    }
+
+    tbx_atomic_inc(ws->n_pending);
+    tbx_atomic_inc(ws->n_epoch);
+
+    //** Wake someone up or add a worker if everyone is busy
+    if (tbx_atomic_get(ws->n_idle) > 0) {
+        apr_thread_mutex_lock(ws->lock);
+        apr_thread_cond_signal(ws->cond);
+        apr_thread_mutex_unlock(ws->lock);
+    } else if ((int)tbx_atomic_get(ws->n_workers) < ws->max_workers) {
+        apr_thread_mutex_lock(ws->lock);
+        _tp_ws_spawn(ws, ws->max_workers);
+        apr_thread_mutex_unlock(ws->lock);
+    }
+}
+
+//*************************************************************
+// tp_ws_create - Creates the executor.  Workers are started on demand.
+//    max_workers should leave recursion_depth threads above max_concurrency
+//    for the overflow slots.
+//*************************************************************
+
+tp_ws_t *tp_ws_create(int min_workers, int max_workers, int max_concurrency, int recursion_depth, apr_pool_t *tp_pool)
+{
+    tp_ws_t *ws;
+    int i;
+
+    if (_tp_ws_worker_key == NULL) apr_threadkey_private_create(&_tp_ws_worker_key, NULL, tp_pool);
+
+    tbx_type_malloc_clear(ws, tp_ws_t, 1);
+    apr_pool_create(&(ws->mpool), NULL);
+    apr_thread_mutex_create(&(ws->lock), APR_THREAD_MUTEX_DEFAULT, ws->mpool);
+    apr_thread_cond_create(&(ws->cond), ws->mpool);
+    _tp_ws_deque_init(&(ws->inject), ws->mpool);
+    _tp_ws_deque_init(&(ws->nest), ws->mpool);
+    _tp_ws_deque_init(&(ws->direct), ws->mpool);
+
+    ws->max_workers = max_workers;
+    ws->max_concurrency = (max_concurrency > 0) ? max_concurrency : max_workers;
+    ws->recursion_depth = (recursion_depth > 1) ? recursion_depth : 2;
+    tbx_type_malloc_clear(ws->worker, tp_ws_worker_t, ws->max_workers);
+    tbx_type_malloc(ws->overflow_depth, int, ws->recursion_depth);
+    for (i=0; i<ws->recursion_depth; i++) ws->overflow_depth[i] = -1;
+
+    apr_thread_mutex_lock(ws->lock);
+    for (i=0; i<min_workers; i++) _tp_ws_spawn(ws, ws->max_workers);
+    apr_thread_mutex_unlock(ws->lock);
+
+    return(ws);
+}
+
+//*************************************************************
+// tp_ws_destroy - Drains any remaining tasks and shuts down the workers
+//*************************************************************
+
+void tp_ws_destroy(tp_ws_t *ws)
+{
+    apr_status_t value;
+    int i, n;
+
+    apr_thread_mutex_lock(ws->lock);
+    ws->shutdown = 1;
+    if ((tbx_atomic_get(ws->n_workers) == 0) && (tbx_atomic_get(ws->n_pending) > 0)) _tp_ws_spawn(ws, 1);  //** Make sure someone drains the queue
+    apr_thread_cond_broadcast(ws->cond);
+    apr_thread_mutex_unlock(ws->lock);
+
+    n = tbx_atomic_get(ws->n_workers);
+    for (i=0; i<n; i++) {
+        apr_thread_join(&value, ws->worker[i].thread);
+        apr_thread_mutex_destroy(ws->worker[i].dq.lock);
+        free(ws->worker[i].dq.task);
+    }
+
+    log_printf(5, "workers=%d steals=%d overflow=%d\n", n, tbx_atomic_get(ws->n_steals), tbx_atomic_get(ws->n_overflow));
+
+    free(ws->inject.task);
+    free(ws->nest.task);
+    free(ws->direct.task);
+    free(ws->overflow_depth);
+    free(ws->worker);
+    apr_pool_destroy(ws->mpool);
+    free(ws);
+}
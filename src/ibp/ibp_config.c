@@ -602,6 +602,15 @@ int  ibp_get_max_retry(ibp_context_t *ic)
 {
     return(ic->max_retry);
 }
+void ibp_set_epoll_threads(ibp_context_t *ic, int n)
+{
+    ic->epoll_threads = n;
+    ic->pc->epoll_threads = n;
+}
+int  ibp_get_epoll_threads(ibp_context_t *ic)
+{
+    return(ic->epoll_threads);
+}
 void ibp_set_transfer_rate(ibp_context_t *ic, double rate)
 {
     ic->transfer_rate = rate;
@@ -629,6 +638,7 @@ void copy_ibp_config(ibp_context_t *cfg)
     cfg->pc->abort_conn_attempts = cfg->abort_conn_attempts;
     cfg->pc->check_connection_interval = cfg->check_connection_interval;
     cfg->pc->max_retry = cfg->max_retry;
+    cfg->pc->epoll_threads = cfg->epoll_threads;
 }
 
 //**********************************************************
@@ -736,12 +746,13 @@ int ibp_load_config(ibp_context_t *ic, tbx_inip_file_t *keyfile, char *section)
     ic->connection_mode = tbx_inip_get_integer(keyfile, section, "connection_mode", ic->connection_mode);
     ic->transfer_rate = tbx_inip_get_double(keyfile, section, "transfer_rate", ic->transfer_rate);
     ic->rr_size = tbx_inip_get_integer(keyfile, section, "rr_size", ic->rr_size);
+    ic->epoll_threads = tbx_inip_get_integer(keyfile, section, "epoll_threads", ic->epoll_threads);
 
     ibp_cc_load(keyfile, ic);
 
     copy_ibp_config(ic);
 
-    log_printf(1, "section=%s cmode=%d min_depot_threads=%d max_depot_threads=%d max_connections=%d max_thread_workload=%" PRId64 " coalesce_enable=%d dt_connect=" TT "\n", section, ic->connection_mode, ic->min_threads, ic->max_threads, ic->max_connections, ic->max_workload, ic->coalesce_enable, ((apr_time_t) ic->dt_connect));
+    log_printf(1, "section=%s cmode=%d min_depot_threads=%d max_depot_threads=%d max_connections=%d max_thread_workload=%" PRId64 " coalesce_enable=%d dt_connect=" TT " epoll_threads=%d\n", section, ic->connection_mode, ic->min_threads, ic->max_threads, ic->max_connections, ic->max_workload, ic->coalesce_enable, ((apr_time_t) ic->dt_connect), ic->epoll_threads);
 
     return(0);
 }
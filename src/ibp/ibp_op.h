@@ -75,6 +75,7 @@ int max_retry;        //** Max number of times to retry a command before failing
 int coalesce_ops;     //** If 1 then Read and Write ops for the same allocation are coalesced
 int connection_mode;  //** Connection mode
 int rr_size;          //** Round robin connection count. Only used ir cmode = RR
+int epoll_threads;    //** If >0 depot connections are multiplexed on this many epoll I/O threads
 double transfer_rate; //** Transfer rate in bytes/sec used for calculating timeouts.  Set to 0 to disable function
 tbx_atomic_unit32_t rr_count; //** RR counter
 ibp_connect_context_t cc[IBP_MAX_NUM_CMDS+1];  //** Default connection contexts for EACH command
@@ -396,6 +397,8 @@ void ibp_set_check_interval(ibp_context_t *ic, int n);
 int  ibp_get_check_interval(ibp_context_t *ic);
 void ibp_set_max_retry(ibp_context_t *ic, int n);
 int  ibp_get_max_retry(ibp_context_t *ic);
+IBP_API void ibp_set_epoll_threads(ibp_context_t *ic, int n);
+IBP_API int  ibp_get_epoll_threads(ibp_context_t *ic);
 IBP_API void ibp_set_read_cc(ibp_context_t *ic, ibp_connect_context_t *cc);
 IBP_API void ibp_set_write_cc(ibp_context_t *ic, ibp_connect_context_t *cc);
 void ibp_set_transfer_rate(ibp_context_t *ic, double rate);
@@ -32,6 +32,7 @@
 #include <tbx/fmttypes.h>
 #include <tbx/network.h>
 #include <tbx/log.h>
+#include <tbx/random.h>
 #include "ibp.h"
 #include "iovec_sync.h"
 #include "io_wrapper.h"
@@ -407,7 +408,7 @@ void random_allocs(ibp_capset_t *caps, int n, int asize, int block_size, double
 
     for (j=0; j<nblocks; j++) {
         for (i=0; i<n; i++) {
-            rnd = rand()/(RAND_MAX + 1.0);
+            rnd = tbx_rng_get_double(tbx_rng_thread());
 
             if ((j==(nblocks-1)) && (rem > 0)) {
                 len = rem;
@@ -470,16 +471,16 @@ double small_write_allocs(ibp_capset_t *caps, int n, int asize, int small_count,
 
     nbytes = 0;
     for (i=0; i<small_count; i++) {
-        rnd = rand()/(RAND_MAX+1.0);
+        rnd = tbx_rng_get_double(tbx_rng_thread());
         slot = n * rnd;
 
-        rnd = rand()/(RAND_MAX+1.0);
+        rnd = tbx_rng_get_double(tbx_rng_thread());
         rnd = lmin + (lmax - lmin) * rnd;
         io_size = exp(rnd);
         if (io_size == 0) io_size = 1;
         nbytes = nbytes + io_size;
 
-        rnd = rand()/(RAND_MAX+1.0);
+        rnd = tbx_rng_get_double(tbx_rng_thread());
         offset = (asize - io_size) * rnd;
 
         tbx_tbuf_single(&(buf[i]), io_size, buffer);
@@ -530,16 +531,16 @@ double small_read_allocs(ibp_capset_t *caps, int n, int asize, int small_count,
 
     nbytes = 0;
     for (i=0; i<small_count; i++) {
-        rnd = rand()/(RAND_MAX+1.0);
+        rnd = tbx_rng_get_double(tbx_rng_thread());
         slot = n * rnd;
 
-        rnd = rand()/(RAND_MAX+1.0);
+        rnd = tbx_rng_get_double(tbx_rng_thread());
         rnd = lmin + (lmax - lmin) * rnd;
         io_size = exp(rnd);
         if (io_size == 0) io_size = 1;
         nbytes = nbytes + io_size;
 
-        rnd = rand()/(RAND_MAX+1.0);
+        rnd = tbx_rng_get_double(tbx_rng_thread());
         offset = (asize - io_size) * rnd;
 
         tbx_tbuf_single(&(buf[i]), io_size, buffer);
@@ -593,21 +594,21 @@ double small_random_allocs(ibp_capset_t *caps, int n, int asize, double readfrac
 
     nbytes = 0;
     for (i=0; i<small_count; i++) {
-        rnd = rand()/(RAND_MAX+1.0);
+        rnd = tbx_rng_get_double(tbx_rng_thread());
         slot = n * rnd;
 
-        rnd = rand()/(RAND_MAX+1.0);
+        rnd = tbx_rng_get_double(tbx_rng_thread());
         rnd = lmin + (lmax - lmin) * rnd;
         io_size = exp(rnd);
         if (io_size == 0) io_size = 1;
         nbytes = nbytes + io_size;
 
-        rnd = rand()/(RAND_MAX+1.0);
+        rnd = tbx_rng_get_double(tbx_rng_thread());
         offset = (asize - io_size) * rnd;
 
 //     log_printf(15, "small_random_allocs: slot=%d offset=%d size=%d\n", slot, offset, io_size);
 
-        rnd = rand()/(RAND_MAX+1.0);
+        rnd = tbx_rng_get_double(tbx_rng_thread());
         if (rnd < readfrac) {
             tbx_tbuf_single(&(buf[i]), io_size, rbuffer);
             op = new_ibp_read_op(ic, get_ibp_cap(&(caps[slot]), IBP_READCAP), offset, &(buf[i]), 0, io_size, ibp_timeout);
@@ -40,6 +40,8 @@ typedef struct {
     ex_off_t hi;
     int start_prefetch;
     int start_trigger;
+    amp_stream_rate_t rate;
+    amp_stream_adapt_t adapt;
     op_generic_t *gop;
 } amp_prefetch_op_t;
 
@@ -130,6 +132,21 @@ ex_off_t _amp_max_bytes(cache_t *c)
     return(cp->max_bytes);
 }
 
+//*************************************************************************
+//  _amp_stream_adapt_init - Resets a stream's prefetch feedback
+//*************************************************************************
+
+void _amp_stream_adapt_init(cache_t *c, amp_stream_adapt_t *adapt)
+{
+    cache_amp_t *cp = (cache_amp_t *)c->fn.priv;
+
+    adapt->fetch_latency = 0;
+    adapt->waste = 0;
+    adapt->floor = cp->min_prefetch_size;
+    adapt->prefetch_bytes = 0;
+    adapt->unused_bytes = 0;
+}
+
 //*************************************************************************
 //  _amp_stream_get - returns the *nearest* stream ot the offset if nbytes<=0.
 //      Otherwise it will create a blank new page stream with the offset and return it.
@@ -162,6 +179,10 @@ amp_page_stream_t *_amp_stream_get(cache_t *c, segment_t *seg, ex_off_t offset,
             ps->nbytes = nbytes;
             ps->prefetch_size = 0;
             ps->trigger_distance = 0;
+            ps->rate.rate = 0;
+            ps->rate.offset = offset;
+            ps->rate.time = 0;
+            _amp_stream_adapt_init(c, &(ps->adapt));
 
             log_printf(_amp_logging, "seg=" XIDT " offset=" XOT " moving to MRU ps=%p ps->last_offset=" XOT "\n", segment_id(seg), offset, ps, ps->last_offset);
 
@@ -270,6 +291,8 @@ void *amp_dirty_thread(apr_thread_t *th, void *data)
         }
         opque_free(q, OP_DESTROY);
 
+        //** Give any excess free arena memory back to the kernel
+        if (c->arena != NULL) cache_arena_set_trim(c->arena, cp->arena_keep_fraction * cp->max_bytes);
 
         cache_lock(c);
 
@@ -308,6 +331,98 @@ void _amp_adjust_dirty(cache_t *c, ex_off_t tweak)
     }
 }
 
+//*************************************************************************
+// _amp_page_link - Adds a new page to the replacement list.  For CLOCK the
+//     page is placed just behind the ring's hand so it gets a full revolution
+//     before being examined.
+//*************************************************************************
+
+void _amp_page_link(cache_amp_t *cp, cache_page_t *p)
+{
+    page_amp_t *lp = (page_amp_t *)p->priv;
+    amp_clock_ring_t *r;
+
+    if (cp->replacement == AMP_REPLACE_CLOCK) {
+        lp->ring = cp->ring_next;
+        cp->ring_next = (cp->ring_next + 1) % cp->n_rings;
+        r = &(cp->ring[lp->ring]);
+        if (r->hand != NULL) {
+            tbx_stack_move_to_ptr(r->stack, r->hand);
+            tbx_stack_insert_above(r->stack, p);
+        } else {
+            tbx_stack_move_to_bottom(r->stack);
+            tbx_stack_insert_below(r->stack, p);
+        }
+        lp->ele = tbx_stack_get_current_ptr(r->stack);
+    } else {
+        tbx_stack_push(cp->stack, p);
+        lp->ele = tbx_stack_get_current_ptr(cp->stack);
+    }
+}
+
+//*************************************************************************
+// _amp_page_unlink - Removes the page from the replacement list.  For LRU
+//     the stack's current position is moved up if move_up is set so eviction
+//     scans from the bottom can continue.  Otherwise it's moved down.
+//*************************************************************************
+
+void _amp_page_unlink(cache_amp_t *cp, page_amp_t *lp, int move_up)
+{
+    amp_clock_ring_t *r;
+
+    if (lp->ele == NULL) return;
+
+    if (cp->replacement == AMP_REPLACE_CLOCK) {
+        r = &(cp->ring[lp->ring]);
+        if (r->hand == lp->ele) r->hand = tbx_stack_ele_get_down(lp->ele);
+        tbx_stack_move_to_ptr(r->stack, lp->ele);
+        tbx_stack_delete_current(r->stack, 1, 0);
+    } else {
+        tbx_stack_move_to_ptr(cp->stack, lp->ele);
+        tbx_stack_delete_current(cp->stack, move_up, 0);
+    }
+
+    lp->ele = NULL;
+}
+
+//*************************************************************************
+// _amp_clock_next - Returns the page under the next ring's hand and advances
+//     the hand.  The rings are visited round robin.
+//*************************************************************************
+
+cache_page_t *_amp_clock_next(cache_amp_t *cp)
+{
+    amp_clock_ring_t *r;
+    tbx_stack_ele_t *ele;
+    int i;
+
+    for (i=0; i<cp->n_rings; i++) {
+        r = &(cp->ring[cp->ring_sweep]);
+        cp->ring_sweep = (cp->ring_sweep + 1) % cp->n_rings;
+        if (tbx_stack_count(r->stack) == 0) continue;
+
+        ele = (r->hand != NULL) ? r->hand : tbx_stack_get_top(r->stack);
+        r->hand = tbx_stack_ele_get_down(ele);  //** A NULL wraps back to the top next time
+        return((cache_page_t *)tbx_stack_ele_get_data(ele));
+    }
+
+    return(NULL);
+}
+
+//*************************************************************************
+// _amp_clock_pages - Returns the number of pages on all the CLOCK rings
+//*************************************************************************
+
+int _amp_clock_pages(cache_amp_t *cp)
+{
+    int i, n;
+
+    n = 0;
+    for (i=0; i<cp->n_rings; i++) n += tbx_stack_count(cp->ring[i].stack);
+
+    return(n);
+}
+
 //*************************************************************************
 //  _amp_new_page - Creates the physical page
 //*************************************************************************
@@ -323,19 +438,18 @@ cache_page_t *_amp_new_page(cache_t *c, segment_t *seg)
     p = &(lp->page);
     p->curr_data = &(p->data[0]);
     p->current_index = 0;
-    tbx_type_malloc_clear(p->curr_data->ptr, char, s->page_size);
+    p->curr_data->ptr = cache_page_buffer_new(c, s->page_size, 1);
 
     cp->bytes_used += s->page_size;
 
     p->priv = (void *)lp;
     p->seg = seg;
     p->offset = tbx_atomic_dec(amp_dummy);
-    p->bit_fields = C_EMPTY;  //** This way it's not accidentally deleted
+    tbx_atomic_set(p->bit_fields, C_EMPTY);  //** This way it's not accidentally deleted
     lp->stream_offset = -1;
 
     //** Store my position
-    tbx_stack_push(cp->stack, p);
-    lp->ele = tbx_stack_get_current_ptr(cp->stack);
+    _amp_page_link(cp, p);
 
     log_printf(_amp_logging, " seg=" XIDT " MRU page created initial->offset=" XOT " page_size=" XOT " bytes_used=" XOT " stack_size=%d\n", segment_id(seg), p->offset, s->page_size, cp->bytes_used, tbx_stack_count(cp->stack));
     return(p);
@@ -383,6 +497,111 @@ void _amp_process_waiters(cache_t *c)
 
 }
 
+//*******************************************************************************
+// _amp_stream_rate_update - Folds the time it took the reader to get from the
+//    last sample to the current one into the stream's rate and makes the
+//    current sample the new reference point.
+//*******************************************************************************
+
+void _amp_stream_rate_update(amp_stream_rate_t *prev, amp_stream_rate_t *curr)
+{
+    double r;
+
+    curr->rate = prev->rate;
+    if ((prev->time <= 0) || (curr->time <= prev->time) || (curr->offset <= prev->offset)) return;
+
+    r = (double)(curr->offset - prev->offset) / (double)(curr->time - prev->time);
+    curr->rate = (prev->rate > 0) ? 0.5*(prev->rate + r) : r;
+}
+
+//*******************************************************************************
+// _amp_prefetch_adapt - Resizes the stream's prefetch window using the measured
+//    prefetch round trip, the reader's consumption rate, the segment hit/miss
+//    times, and the fraction of the stream's prefetched pages evicted without
+//    a hit.  The window covers twice the bytes the reader consumes during a
+//    round trip.  It's doubled if the reader is stalling and halved, but never
+//    below the bandwidth delay product, if to much is wasted.
+//    NOTE: Cache lock should be held by calling thread
+//*******************************************************************************
+
+void _amp_prefetch_adapt(cache_t *c, amp_prefetch_op_t *ap, amp_page_stream_t *ps, apr_time_t dt, int nloaded, int pending_read)
+{
+    cache_amp_t *cp = (cache_amp_t *)c->fn.priv;
+    cache_segment_t *s = (cache_segment_t *)ap->seg->priv;
+    amp_stream_table_t *as = (amp_stream_table_t *)s->cache_priv;
+    amp_stream_adapt_t *a = &(ps->adapt);
+    apr_time_t dhit, dmiss;
+    ex_off_t max_pages, bdp_bytes;
+    double waste;
+    int target, bdp, stalled, wasteful;
+
+    //** Pick up where the previous window on the stream left off
+    a->fetch_latency = ap->adapt.fetch_latency;
+    a->waste = ap->adapt.waste;
+    a->floor = ap->adapt.floor;
+    a->prefetch_bytes += ap->adapt.prefetch_bytes;
+    a->unused_bytes += ap->adapt.unused_bytes;
+
+    //** Update the round trip.  Only loads tell us anything about the depots.
+    if (nloaded > 0) {
+        a->fetch_latency = (a->fetch_latency > 0) ? (3*a->fetch_latency + dt) / 4 : dt;
+        a->prefetch_bytes += nloaded * s->page_size;
+    }
+
+    //** and the fraction of the stream's prefetched pages being tossed unused
+    if (a->prefetch_bytes >= 64*s->page_size) {
+        waste = (double)a->unused_bytes / (double)a->prefetch_bytes;
+        if (waste > 1) waste = 1;
+        a->waste = 0.75*a->waste + 0.25*waste;
+        a->prefetch_bytes = 0;
+        a->unused_bytes = 0;
+    }
+
+    //** See if the reader has been stuck waiting on misses since the last time
+    segment_lock(ap->seg);
+    dhit = s->stats.hit_time - as->hit_time_mark;
+    dmiss = s->stats.miss_time - as->miss_time_mark;
+    as->hit_time_mark = s->stats.hit_time;
+    as->miss_time_mark = s->stats.miss_time;
+    segment_unlock(ap->seg);
+
+    stalled = ((pending_read > 0) || (dmiss > dhit)) ? 1 : 0;
+    wasteful = (a->waste > cp->prefetch_waste_target) ? 1 : 0;
+
+    //** Bandwidth delay product of the stream
+    bdp = 2 * ap->rate.rate * a->fetch_latency / s->page_size;
+    if (wasteful == 1) {
+        target = ap->start_prefetch / 2;
+        if (target < bdp) target = bdp;
+    } else {
+        target = (bdp > ap->start_prefetch) ? bdp : ap->start_prefetch;
+        if ((stalled == 1) && (target < 2*ap->start_prefetch)) target = 2*ap->start_prefetch;
+    }
+
+    max_pages = c->max_fetch_size / s->page_size;
+    if (target > max_pages) target = max_pages;
+    if (target < 2) target = 2;
+
+    ps->prefetch_size = target;
+    ps->trigger_distance = target / 2;
+    if (pending_read > 0) ps->trigger_distance += (ap->hi + s->page_size - ap->lo) / s->page_size;  //** Start the next one sooner
+    if (ps->trigger_distance > ps->prefetch_size - 1) ps->trigger_distance = ps->prefetch_size - 1;
+
+    //** Adjust the stream's floor the same way
+    if (wasteful == 1) {
+        bdp_bytes = (ex_off_t)bdp * s->page_size;
+        a->floor /= 2;
+        if (a->floor < bdp_bytes) a->floor = bdp_bytes;
+        if (a->floor < s->page_size) a->floor = s->page_size;
+    } else if (stalled == 1) {
+        a->floor *= 2;
+    }
+    if (a->floor > c->max_fetch_size) a->floor = c->max_fetch_size;
+
+    log_printf(_amp_slog, "seg=" XIDT " hi=" XOT " dt=" TT " latency=" TT " rate=%lf waste=%lf stalled=%d prefetch=%d trigger=%d floor=" XOT "\n",
+               segment_id(ap->seg), ap->hi, dt, a->fetch_latency, ap->rate.rate, a->waste, stalled, ps->prefetch_size, ps->trigger_distance, a->floor);
+}
+
 //*******************************************************************************
 // amp_pretech_fn - Does the actual prefetching
 //*******************************************************************************
@@ -398,9 +617,11 @@ op_status_t amp_prefetch_fn(void *arg, int id)
     page_amp_t *lp;
     amp_page_stream_t *ps;
     ex_off_t offset, *poff, trigger_offset, nbytes;
+    apr_time_t dt;
     tbx_sl_iter_t it;
     int n_pages, i, nloaded, pending_read;
 
+    dt = apr_time_now();
     nbytes = ap->hi + s->page_size - ap->lo;
     trigger_offset = ap->hi - ap->start_trigger*s->page_size;
 
@@ -424,12 +645,14 @@ op_status_t amp_prefetch_fn(void *arg, int id)
                     p = NULL;
                 } else {
                     if (offset == ap->hi) { //** Kick out we hit the end
+                        lp = (page_amp_t *)p->priv;
+                        tbx_atomic_or(lp->bit_fields, CAMP_LAST);  //** Stream end so hits take the locked path
                         offset += s->page_size;
                         p = NULL;
                     } else {
                         if (offset == trigger_offset) {  //** Set the trigger page
                             lp = (page_amp_t *)p->priv;
-                            lp->bit_fields |= CAMP_TAG;
+                            tbx_atomic_or(lp->bit_fields, CAMP_TAG);
                             lp->stream_offset = ap->hi;
                             log_printf(_amp_logging, "seg=" XIDT " SET_TAG offset=" XOT "\n", segment_id(ap->seg), offset);
                         }
@@ -452,10 +675,15 @@ op_status_t amp_prefetch_fn(void *arg, int id)
 
                 if (page[i].p->offset == trigger_offset) {
                     lp = (page_amp_t *)page[i].p->priv;
-                    lp->bit_fields |= CAMP_TAG;
+                    tbx_atomic_or(lp->bit_fields, CAMP_TAG);
                     lp->stream_offset = ap->hi;
                     log_printf(_amp_logging, "seg=" XIDT " SET_TAG offset=" XOT " last=" XOT "\n", segment_id(ap->seg), offset, lp->stream_offset);
                 }
+
+                if (page[i].p->offset == ap->hi) {  //** Stream end so hits take the locked path
+                    lp = (page_amp_t *)page[i].p->priv;
+                    tbx_atomic_or(lp->bit_fields, CAMP_LAST);
+                }
             }
             offset = page[n_pages-1].p->offset;
             offset += s->page_size;
@@ -467,16 +695,24 @@ op_status_t amp_prefetch_fn(void *arg, int id)
         }
     }
 
+    dt = apr_time_now() - dt;
+
     //** Update the stream info
     cache_lock(s->c);
     ps = _amp_stream_get(s->c, seg, ap->hi, nbytes, NULL);
     if (ps != NULL) {
-        ps->prefetch_size = (ap->start_prefetch >  (ps->trigger_distance+1)) ? ap->start_prefetch : ps->trigger_distance + 1;
-        ps->trigger_distance = ap->start_trigger;
-        if (pending_read > 0) {
-            ps->trigger_distance += (ap->hi + s->page_size - ap->lo) / s->page_size;
-            log_printf(_amp_logging, "seg=" XIDT " LAST read waiting=%d for offset=" XOT " increasing trigger_distance=%d prefetch_pages=%d\n", segment_id(ap->seg), pending_read, ap->hi, ps->trigger_distance, ps->prefetch_size);
+        if (cp->adaptive_prefetch == 1) {
+            _amp_prefetch_adapt(s->c, ap, ps, dt, nloaded, pending_read);
+        } else {
+            ps->prefetch_size = (ap->start_prefetch >  (ps->trigger_distance+1)) ? ap->start_prefetch : ps->trigger_distance + 1;
+            ps->trigger_distance = ap->start_trigger;
+            if (pending_read > 0) {
+                ps->trigger_distance += (ap->hi + s->page_size - ap->lo) / s->page_size;
+                log_printf(_amp_logging, "seg=" XIDT " LAST read waiting=%d for offset=" XOT " increasing trigger_distance=%d prefetch_pages=%d\n", segment_id(ap->seg), pending_read, ap->hi, ps->trigger_distance, ps->prefetch_size);
+            }
         }
+        ps->rate = ap->rate;  //** Carry the reader's rate along the stream
+        if (cp->adaptive_prefetch == 0) ps->adapt = ap->adapt;
     }
 
     cp->prefetch_in_process -= nbytes;  //** Adjust the prefetch bytes
@@ -505,11 +741,11 @@ op_status_t amp_prefetch_fn(void *arg, int id)
 //   NOTE : ASsumes the cache is locked!
 //*******************************************************************************
 
-void _amp_prefetch(segment_t *seg, ex_off_t lo, ex_off_t hi, int start_prefetch, int start_trigger)
+void _amp_prefetch(segment_t *seg, ex_off_t lo, ex_off_t hi, int start_prefetch, int start_trigger, amp_stream_rate_t *rate, amp_stream_adapt_t *adapt)
 {
     cache_segment_t *s = (cache_segment_t *)seg->priv;
     cache_amp_t *cp = (cache_amp_t *)s->c->fn.priv;
-    ex_off_t lo_row, hi_row, nbytes, dn;
+    ex_off_t lo_row, hi_row, nbytes, dn, floor;
     amp_prefetch_op_t *ca;
     op_generic_t *gop;
     int tid;
@@ -525,9 +761,10 @@ void _amp_prefetch(segment_t *seg, ex_off_t lo, ex_off_t hi, int start_prefetch,
     }
 
     nbytes = hi + s->page_size - lo;
-    if (nbytes < cp->min_prefetch_size) {
-        log_printf(_amp_logging, " SMALL prefetch!  nbytes=" XOT "\n", nbytes);
-        hi = lo + cp->min_prefetch_size;
+    floor = (adapt != NULL) ? adapt->floor : cp->min_prefetch_size;
+    if (nbytes < floor) {
+        log_printf(_amp_logging, " SMALL prefetch!  nbytes=" XOT " floor=" XOT "\n", nbytes, floor);
+        hi = lo + floor;
     }
 
     if (s->total_size <= hi) {
@@ -573,6 +810,20 @@ void _amp_prefetch(segment_t *seg, ex_off_t lo, ex_off_t hi, int start_prefetch,
     ca->hi = hi_row;
     ca->start_prefetch = start_prefetch;
     ca->start_trigger = start_trigger;
+    if (rate != NULL) {
+        ca->rate = *rate;
+    } else {
+        ca->rate.rate = 0;
+        ca->rate.offset = lo_row;
+        ca->rate.time = 0;
+    }
+    if (adapt != NULL) {
+        ca->adapt = *adapt;
+        adapt->prefetch_bytes = 0;  //** The new window picks up the waste sample
+        adapt->unused_bytes = 0;
+    } else {
+        _amp_stream_adapt_init(s->c, &(ca->adapt));
+    }
     gop = new_thread_pool_op(s->tpc_unlimited, NULL, amp_prefetch_fn, (void *)ca, free, 1);
     ca->gop = gop;
 //log_printf(15, "tid=%d seg=" XIDT " lo=" XOT " hi=" XOT " rw_mode=%d ca=%p gid=%d\n", tid, segment_id(seg), lo, hi, rw_mode, ca, gop_id(gop));
@@ -607,18 +858,17 @@ int _amp_pages_release(cache_t *c, cache_page_t **page, int n_pages)
 
             cp->bytes_used -= s->page_size;
             if (lp->ele != NULL) {
-                tbx_stack_move_to_ptr(cp->stack, lp->ele);
-                tbx_stack_delete_current(cp->stack, 0, 0);
+                _amp_page_unlink(cp, lp, 0);
             } else {
                 cp->limbo_pages--;
                 log_printf(15, "seg=" XIDT " limbo page p->offset=" XOT " limbo=%d\n", segment_id(p->seg), p->offset, cp->limbo_pages);
             }
 
             if (p->offset > -1) {
-                tbx_list_remove(s->pages, &(p->offset), p);  //** Have to do this here cause p->offset is the key var
+                cache_page_table_remove(s, p);  //** Have to do this here cause p->offset is the key var
             }
-            if (p->data[0].ptr) free(p->data[0].ptr);
-            if (p->data[1].ptr) free(p->data[1].ptr);
+            cache_page_buffer_free(c, p->data[0].ptr);
+            cache_page_buffer_free(c, p->data[1].ptr);
             free(lp);
         }
     }
@@ -652,28 +902,24 @@ void _amp_pages_destroy(cache_t *c, cache_page_t **page, int n_pages, int remove
         p = page[i];
         s = (cache_segment_t *)p->seg->priv;
 
-        count = p->access_pending[CACHE_READ] + p->access_pending[CACHE_WRITE] + p->access_pending[CACHE_FLUSH];
+        if (remove_from_segment == 1) {  //** Have to check and remove under the page table lock
+            count = (cache_page_table_remove_idle(s, p, CACHE_MARK_ONLY_RELEASE) == 1) ? 0 : 1;
+        } else {
+            count = cache_page_count(p);
+        }
 
         if (count == 0) {  //** No one is listening
             log_printf(15, "amp_pages_destroy i=%d p->offset=" XOT " seg=" XIDT " remove_from_segment=%d limbo=%d\n", i, p->offset, segment_id(p->seg), remove_from_segment, cp->limbo_pages);
             cp->bytes_used -= s->page_size;
             lp = (page_amp_t *)p->priv;
 
-            if (lp->ele != NULL) {
-                tbx_stack_move_to_ptr(cp->stack, lp->ele);
-                tbx_stack_delete_current(cp->stack, 0, 0);
-            }
-
-            if (remove_from_segment == 1) {
-                s = (cache_segment_t *)p->seg->priv;
-                tbx_list_remove(s->pages, &(p->offset), p);  //** Have to do this here cause p->offset is the key var
-            }
+            _amp_page_unlink(cp, lp, 0);
 
-            if (p->data[0].ptr) free(p->data[0].ptr);
-            if (p->data[1].ptr) free(p->data[1].ptr);
+            cache_page_buffer_free(c, p->data[0].ptr);
+            cache_page_buffer_free(c, p->data[1].ptr);
             free(lp);
         } else {  //** Someone is listening so trigger them and also clear the bits so it will be released
-            p->bit_fields = C_TORELEASE;
+            if (remove_from_segment == 0) tbx_atomic_set(p->bit_fields, C_TORELEASE);
             log_printf(15, "amp_pages_destroy i=%d p->offset=" XOT " seg=" XIDT " remove_from_segment=%d cr=%d cw=%d cf=%d limbo=%d\n", i, p->offset,
                        segment_id(p->seg), remove_from_segment, p->access_pending[CACHE_READ], p->access_pending[CACHE_WRITE], p->access_pending[CACHE_FLUSH], cp->limbo_pages);
         }
@@ -694,6 +940,7 @@ int _amp_page_access(cache_t *c, cache_page_t *p, int rw_mode, ex_off_t request_
     cache_segment_t *s = (cache_segment_t *)p->seg->priv;
     page_amp_t *lp = (page_amp_t *)p->priv;
     amp_page_stream_t *ps, *pse;
+    amp_stream_rate_t rate;
     ex_off_t lo, hi, psize, last_offset;
     int prefetch_pages, trigger_distance, tag;
 
@@ -702,8 +949,9 @@ int _amp_page_access(cache_t *c, cache_page_t *p, int rw_mode, ex_off_t request_
     //** Only update the position if the page is linked.
     //** Otherwise the page is destined to be dropped
     if (lp->ele != NULL) {
-        //** Move to the MRU position
-        if ((lp->bit_fields & CAMP_ACCESSED) > 0) {
+        if (cp->replacement == AMP_REPLACE_CLOCK) {  //** CLOCK just flags it as referenced
+            tbx_atomic_or(lp->bit_fields, CAMP_REF);
+        } else if ((lp->bit_fields & CAMP_ACCESSED) > 0) {  //** Move to the MRU position
             log_printf(_amp_logging, "seg=" XIDT " MRU offset=" XOT "\n", segment_id(p->seg), p->offset);
             tbx_stack_move_to_ptr(cp->stack, lp->ele);
             tbx_stack_unlink_current(cp->stack, 1);
@@ -712,7 +960,7 @@ int _amp_page_access(cache_t *c, cache_page_t *p, int rw_mode, ex_off_t request_
         }
 
         if (rw_mode == CACHE_WRITE) {  //** Write update so return
-            lp->bit_fields |= CAMP_ACCESSED;
+            tbx_atomic_or(lp->bit_fields, CAMP_ACCESSED);
             return(0);
         }
 
@@ -722,12 +970,16 @@ int _amp_page_access(cache_t *c, cache_page_t *p, int rw_mode, ex_off_t request_
         //** Check if we need to do a prefetch
         tag = lp->bit_fields & CAMP_TAG;
         if (tag > 0) {
-            lp->bit_fields ^= CAMP_TAG;
+            tbx_atomic_and(lp->bit_fields, ~CAMP_TAG);
             ps = _amp_stream_get(c, p->seg, lp->stream_offset, -1, &pse);
+            rate.rate = 0;
+            rate.offset = p->offset;
+            rate.time = apr_time_now();
             if (ps != NULL) {
                 last_offset = ps->last_offset;
                 prefetch_pages = ps->prefetch_size;
                 trigger_distance = ps->trigger_distance;
+                _amp_stream_rate_update(&(ps->rate), &rate);
             } else {
                 last_offset = lp->stream_offset;
                 prefetch_pages = request_len / s->page_size;
@@ -740,7 +992,7 @@ int _amp_page_access(cache_t *c, cache_page_t *p, int rw_mode, ex_off_t request_
             if ((hi - last_offset - psize + 1) > s->c->max_fetch_size) hi = last_offset + psize + s->c->max_fetch_size;
             lo = last_offset + psize;
             log_printf(_amp_slog, "seg=" XIDT " HIT_TAG offset=" XOT " last_offset=" XOT " lo=" XOT " hi=" XOT " prefetch_pages=%d\n", segment_id(p->seg), p->offset, lp->stream_offset, lo, hi, prefetch_pages);
-            _amp_prefetch(p->seg, last_offset + psize, hi, prefetch_pages, trigger_distance);
+            _amp_prefetch(p->seg, last_offset + psize, hi, prefetch_pages, trigger_distance, &rate, (ps != NULL) ? &(ps->adapt) : NULL);
         } else {
             _amp_stream_get(c, p->seg, p->offset, -1, &pse);
         }
@@ -752,12 +1004,143 @@ int _amp_page_access(cache_t *c, cache_page_t *p, int rw_mode, ex_off_t request_
             }
         }
 
-        lp->bit_fields |= CAMP_ACCESSED;
+        if ((lp->bit_fields & CAMP_LAST) > 0) tbx_atomic_and(lp->bit_fields, ~CAMP_LAST);
+        tbx_atomic_or(lp->bit_fields, CAMP_ACCESSED);
+    }
+
+    return(0);
+}
+
+//*************************************************************************
+//  _amp_page_touch - Lock free version of _amp_page_access used by CLOCK.
+//    A plain hit only sets the page's reference bits.  Pages that trigger a
+//    prefetch or end a stream return 1 so the caller does a full
+//    _amp_page_access with the cache lock held.
+//    NOTE: The caller must hold a reference to the page
+//*************************************************************************
+
+int _amp_page_touch(cache_t *c, cache_page_t *p, int rw_mode, ex_off_t request_len)
+{
+    cache_amp_t *cp = (cache_amp_t *)c->fn.priv;
+    page_amp_t *lp = (page_amp_t *)p->priv;
+
+    if (cp->replacement != AMP_REPLACE_CLOCK) return(1);
+    if (rw_mode == CACHE_FLUSH) return(0);
+    if ((tbx_atomic_get(lp->bit_fields) & (CAMP_TAG|CAMP_LAST)) > 0) return(1);
+
+    tbx_atomic_or(lp->bit_fields, CAMP_REF|CAMP_ACCESSED);
+
+    return(0);
+}
+
+//*************************************************************************
+// _amp_page_free - Frees the page if it's clean, has been used or recycled,
+//    and no one is accessing it.  Returns 1 if the page was freed.  Otherwise
+//    the page is left in place with its bits adjusted based on mark_mode.
+//*************************************************************************
+
+int _amp_page_free(cache_t *c, cache_page_t *p, int mark_mode)
+{
+    cache_amp_t *cp = (cache_amp_t *)c->fn.priv;
+    cache_segment_t *s = (cache_segment_t *)p->seg->priv;
+    page_amp_t *lp = (page_amp_t *)p->priv;
+
+    if ((p->bit_fields & C_ISDIRTY) != 0) return(0);  //** Got to flush the page first
+    if ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) == 0) return(0);
+    if (cache_page_table_remove_idle(s, p, mark_mode) == 0) return(0);  //** Someone is using it
+
+    log_printf(_amp_logging, "freeing page seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
+    _amp_page_unlink(cp, lp, 1);
+    cache_page_buffer_free(c, p->data[0].ptr);
+    cache_page_buffer_free(c, p->data[1].ptr);
+    free(lp);
+
+    return(1);
+}
+
+//*************************************************************************
+// _amp_evict_page - Frees the page if possible.  Otherwise it's flagged for
+//    release, added to the flush table if dirty, and unlinked into limbo.
+//    Returns 1 if the page was freed and 0 if the release is pending.
+//*************************************************************************
+
+int _amp_evict_page(cache_t *c, cache_page_t *p, tbx_list_t *table)
+{
+    cache_amp_t *cp = (cache_amp_t *)c->fn.priv;
+    page_amp_t *lp = (page_amp_t *)p->priv;
+    page_table_t *ptable;
+    tbx_pch_t pt_pch;
+
+    if (_amp_page_free(c, p, CACHE_MARK_TORELEASE) == 1) return(1);
+
+    //** Couldn't perform an immediate release
+    if ((p->access_pending[CACHE_FLUSH] == 0) && ((p->bit_fields & C_ISDIRTY) != 0)) {  //** Make sure it's not already being flushed and it's dirty
+        ptable = (page_table_t *)tbx_list_search(table, (tbx_list_key_t *)&(segment_id(p->seg)));
+        if (ptable == NULL) {  //** Have to make a new segment entry
+            pt_pch = tbx_pch_reserve(cp->free_page_tables);
+            ptable = (page_table_t *)tbx_pch_data(&pt_pch);
+            ptable->seg = p->seg;
+            ptable->id = segment_id(p->seg);
+//                   s->dumping_pages++;  //** This makes sure we don't free the segment
+            ptable->pch = pt_pch;
+            tbx_list_insert(table, &(ptable->id), ptable);
+            ptable->lo = p->offset;
+            ptable->hi = p->offset;
+        } else {
+            if (ptable->lo > p->offset) ptable->lo = p->offset;
+            if (ptable->hi < p->offset) ptable->hi = p->offset;
+        }
     }
+    tbx_atomic_or(p->bit_fields, C_TORELEASE);
+
+    log_printf(_amp_logging, "in use marking for release seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
+
+    _amp_page_unlink(cp, lp, 1);  //** Mark it as removed from the list so a page_release doesn't free also
+    cp->limbo_pages++;
+    log_printf(15, "UNLINKING seg=" XIDT " p->offset=" XOT " bits=%d limbo=%d\n", segment_id(p->seg), p->offset, p->bit_fields, cp->limbo_pages);
 
     return(0);
 }
 
+//*************************************************************************
+// _amp_page_recycle - Flags a page that made it through the list without a
+//    hit as old and shrinks the prefetch window of its stream
+//*************************************************************************
+
+void _amp_page_recycle(cache_t *c, cache_page_t *p)
+{
+    page_amp_t *lp = (page_amp_t *)p->priv;
+    amp_page_stream_t *ps;
+
+    tbx_atomic_or(lp->bit_fields, CAMP_OLD);  //** Flag it as old
+
+    log_printf(_amp_logging, "seg=" XIDT " MRU retry offset=" XOT "\n", segment_id(p->seg), p->offset);
+
+    //** Tweak the stream info
+    _amp_stream_get(c, p->seg, p->offset, -1, &ps);  //** Don't care about the initial element in the chaing.  Just the last
+    if (ps != NULL) {
+        if (ps->prefetch_size > 0) ps->prefetch_size--;
+        if (ps->trigger_distance > 0) ps->trigger_distance--;
+        if ((ps->prefetch_size-1) < ps->trigger_distance) ps->trigger_distance = ps->prefetch_size - 1;
+    }
+}
+
+//*************************************************************************
+// _amp_page_unused - Counts a page evicted without a hit against the cache
+//    and the stream that prefetched it
+//*************************************************************************
+
+void _amp_page_unused(cache_t *c, cache_page_t *p)
+{
+    cache_segment_t *s = (cache_segment_t *)p->seg->priv;
+    amp_page_stream_t *ps;
+
+    c->stats.unused_bytes += s->page_size;
+
+    _amp_stream_get(c, p->seg, p->offset, -1, &ps);  //** The end of the chain is what the next prefetch uses
+    if (ps != NULL) ps->adapt.unused_bytes += s->page_size;
+}
+
 //*************************************************************************
 //  _amp_free_mem - Frees page memory OPPORTUNISTICALLY
 //   Returns the pending bytes to free.  Aborts as soon as it encounters
@@ -772,41 +1155,49 @@ int _amp_free_mem(cache_t *c, segment_t *pseg, ex_off_t bytes_to_free)
     page_amp_t *lp;
     tbx_stack_ele_t *ele;
     ex_off_t total_bytes, pending_bytes;
-    int count, err;
+    int err, n;
 
     total_bytes = 0;
     err = 0;
 
     log_printf(_amp_logging, "START seg=" XIDT " bytes_to_free=" XOT " bytes_used=" XOT " stack_size=%d\n", segment_id(pseg), bytes_to_free, cp->bytes_used, tbx_stack_count(cp->stack));
 
-    tbx_stack_move_to_bottom(cp->stack);
-    ele = tbx_stack_get_current_ptr(cp->stack);
-    while ((total_bytes < bytes_to_free) && (ele != NULL) && (err == 0)) {
-        p = (cache_page_t *)tbx_stack_ele_get_data(ele);
-        lp = (page_amp_t *)p->priv;
-        if ((p->bit_fields & C_TORELEASE) == 0) { //** Skip it if already flagged for removal
-            count = p->access_pending[CACHE_READ] + p->access_pending[CACHE_WRITE] + p->access_pending[CACHE_FLUSH];
-            if (count == 0) { //** No one is using it
-                if (((p->bit_fields & C_ISDIRTY) == 0) && ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) > 0)) {  //** Don't have to flush it
-                    s = (cache_segment_t *)p->seg->priv;
+    if (cp->replacement == AMP_REPLACE_CLOCK) {
+        n = 2*_amp_clock_pages(cp);  //** Enough for each page to lose its reference bit
+        while ((total_bytes < bytes_to_free) && (err == 0) && (n > 0) && ((p = _amp_clock_next(cp)) != NULL)) {
+            n--;
+            lp = (page_amp_t *)p->priv;
+            if ((p->bit_fields & C_TORELEASE) > 0) continue;  //** Skip it if already flagged for removal
+
+            if ((lp->bit_fields & CAMP_REF) > 0) {  //** Referenced since the last sweep so give it a 2nd chance
+                tbx_atomic_and(lp->bit_fields, ~CAMP_REF);
+            } else {
+                s = (cache_segment_t *)p->seg->priv;
+                if (_amp_page_free(c, p, CACHE_MARK_NONE) == 1) {
+                    total_bytes += s->page_size;
+                } else {
+                    err = 1;
+                }
+            }
+        }
+    } else {
+        tbx_stack_move_to_bottom(cp->stack);
+        ele = tbx_stack_get_current_ptr(cp->stack);
+        while ((total_bytes < bytes_to_free) && (ele != NULL) && (err == 0)) {
+            p = (cache_page_t *)tbx_stack_ele_get_data(ele);
+            if ((p->bit_fields & C_TORELEASE) == 0) { //** Skip it if already flagged for removal
+                s = (cache_segment_t *)p->seg->priv;
+                if (_amp_page_free(c, p, CACHE_MARK_NONE) == 1) {
                     total_bytes += s->page_size;
-                    log_printf(_amp_logging, "amp_free_mem: freeing page seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
-                    tbx_list_remove(s->pages, &(p->offset), p);  //** Have to do this here cause p->offset is the key var
-                    tbx_stack_delete_current(cp->stack, 1, 0);
-                    if (p->data[0].ptr) free(p->data[0].ptr);
-                    if (p->data[1].ptr) free(p->data[1].ptr);
-                    free(lp);
-                } else {         //** Got to flush the page first
+                } else {  //** Either in use or got to flush the page first
                     err = 1;
                 }
             } else {
-                err = 1;
+                tbx_stack_move_up(cp->stack);
             }
-        } else {
-            tbx_stack_move_up(cp->stack);
-        }
 
-        ele = tbx_stack_get_current_ptr(cp->stack);
+            ele = tbx_stack_get_current_ptr(cp->stack);
+        }
     }
 
     cp->bytes_used -= total_bytes;
@@ -830,14 +1221,13 @@ ex_off_t _amp_attempt_free_mem(cache_t *c, segment_t *page_seg, ex_off_t bytes_t
     tbx_stack_ele_t *ele, *curr_ele;
     op_generic_t *gop;
     opque_t *q;
-    amp_page_stream_t *ps;
     ex_off_t total_bytes, freed_bytes, pending_bytes;
     ex_id_t *segid;
     tbx_list_iter_t sit;
-    int count, n;
+    int n;
     tbx_list_t *table;
     page_table_t *ptable;
-    tbx_pch_t pch, pt_pch;
+    tbx_pch_t pch;
 
     log_printf(15, "START seg=" XIDT " bytes_to_free=" XOT " bytes_used=" XOT " stack_size=%d\n", segment_id(page_seg), bytes_to_free, cp->bytes_used, tbx_stack_count(cp->stack));
 
@@ -845,96 +1235,77 @@ ex_off_t _amp_attempt_free_mem(cache_t *c, segment_t *page_seg, ex_off_t bytes_t
     pending_bytes = 0;
     total_bytes = 0;
     q = NULL;
+    s = (cache_segment_t *)page_seg->priv;
 
     //** cache_lock(c) is already acquired
     pch = tbx_pch_reserve(cp->free_pending_tables);
     table = *(tbx_list_t **)tbx_pch_data(&pch);
 
     //** Get the list of pages to free
-    tbx_stack_move_to_bottom(cp->stack);
-    ele = tbx_stack_get_current_ptr(cp->stack);
-    while ((total_bytes < bytes_to_free) && (ele != NULL)) {
-        p = (cache_page_t *)tbx_stack_ele_get_data(ele);
-        lp = (page_amp_t *)p->priv;
-        s = (cache_segment_t *)p->seg->priv;
-
-        log_printf(15, "checking page for release seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
-        tbx_log_flush();
+    if (cp->replacement == AMP_REPLACE_CLOCK) {
+        //** Sweep the rings.  Hits only set bits so they never wait on us.
+        n = 3*_amp_clock_pages(cp);  //** Enough to clear the reference bit, recycle, and then evict each page
+        while ((total_bytes < bytes_to_free) && (n > 0) && ((p = _amp_clock_next(cp)) != NULL)) {
+            n--;
+            lp = (page_amp_t *)p->priv;
+            s = (cache_segment_t *)p->seg->priv;
 
-        if ((p->bit_fields & C_TORELEASE) == 0) { //** Skip it if already flagged for removal
-            if ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) > 0) {  //** Already used once or cycled so ok to evict
-                if ((lp->bit_fields & CAMP_ACCESSED) == 0) c->stats.unused_bytes += s->page_size;
+            log_printf(15, "checking page for release seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
 
-                n = 0;
-                count = p->access_pending[CACHE_READ] + p->access_pending[CACHE_WRITE] + p->access_pending[CACHE_FLUSH];
-                if (count == 0) { //** No one is using it
-                    if (((p->bit_fields & C_ISDIRTY) == 0) && ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) > 0)) {  //** Don't have to flush it
+            if ((p->bit_fields & C_TORELEASE) == 0) { //** Skip it if already flagged for removal
+                if ((lp->bit_fields & CAMP_REF) > 0) {  //** Referenced since the last sweep so give it a 2nd chance
+                    tbx_atomic_and(lp->bit_fields, ~CAMP_REF);
+                } else if ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) > 0) {  //** Already used once or cycled so ok to evict
+                    if ((lp->bit_fields & CAMP_ACCESSED) == 0) _amp_page_unused(c, p);
+                    if (_amp_evict_page(c, p, table) == 1) {
                         freed_bytes += s->page_size;
-                        log_printf(_amp_logging, "freeing page seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
-                        tbx_list_remove(s->pages, &(p->offset), p);  //** Have to do this here cause p->offset is the key var
-                        tbx_stack_delete_current(cp->stack, 1, 0);
-                        if (p->data[0].ptr) free(p->data[0].ptr);
-                        if (p->data[1].ptr) free(p->data[1].ptr);
-                        free(lp);
-                        n = 1;
+                    } else {
+                        pending_bytes += s->page_size;
                     }
+                } else {
+                    _amp_page_recycle(c, p);
                 }
+            }
 
-                if (n == 0) { //** Couldn't perform an immediate release
-                    if ((p->access_pending[CACHE_FLUSH] == 0) && ((p->bit_fields & C_ISDIRTY) != 0)) {  //** Make sure it's not already being flushed and it's dirty
-                        ptable = (page_table_t *)tbx_list_search(table, (tbx_list_key_t *)&(segment_id(p->seg)));
-                        if (ptable == NULL) {  //** Have to make a new segment entry
-                            pt_pch = tbx_pch_reserve(cp->free_page_tables);
-                            ptable = (page_table_t *)tbx_pch_data(&pt_pch);
-                            ptable->seg = p->seg;
-                            ptable->id = segment_id(p->seg);
-//                   s->dumping_pages++;  //** This makes sure we don't free the segment
-                            ptable->pch = pt_pch;
-                            tbx_list_insert(table, &(ptable->id), ptable);
-                            ptable->lo = p->offset;
-                            ptable->hi = p->offset;
-                        } else {
-                            if (ptable->lo > p->offset) ptable->lo = p->offset;
-                            if (ptable->hi < p->offset) ptable->hi = p->offset;
-                        }
-                    }
-                    p->bit_fields |= C_TORELEASE;
+            total_bytes = freed_bytes + pending_bytes;
+        }
+    } else {
+        tbx_stack_move_to_bottom(cp->stack);
+        ele = tbx_stack_get_current_ptr(cp->stack);
+        while ((total_bytes < bytes_to_free) && (ele != NULL)) {
+            p = (cache_page_t *)tbx_stack_ele_get_data(ele);
+            lp = (page_amp_t *)p->priv;
+            s = (cache_segment_t *)p->seg->priv;
 
-                    log_printf(_amp_logging, "in use marking for release seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
+            log_printf(15, "checking page for release seg=" XIDT " p->offset=" XOT " bits=%d\n", segment_id(p->seg), p->offset, p->bit_fields);
+            tbx_log_flush();
+
+            if ((p->bit_fields & C_TORELEASE) == 0) { //** Skip it if already flagged for removal
+                if ((lp->bit_fields & (CAMP_OLD|CAMP_ACCESSED)) > 0) {  //** Already used once or cycled so ok to evict
+                    if ((lp->bit_fields & CAMP_ACCESSED) == 0) _amp_page_unused(c, p);
+
+                    //** Either way the page is unlinked and the current position moves up
+                    if (_amp_evict_page(c, p, table) == 1) {
+                        freed_bytes += s->page_size;
+                    } else {
+                        pending_bytes += s->page_size;
+                    }
+                } else {
+                    _amp_page_recycle(c, p);
 
-                    pending_bytes += s->page_size;
-                    tbx_stack_unlink_current(cp->stack, 1);  //** Unlink it.  This is ele
-                    free(lp->ele);
-                    lp->ele = NULL;  //** Mark it as removed from the list so a page_release doesn't free also
-                    cp->limbo_pages++;
-//log_printf(_amp_logging, "UNLINKING seg=" XIDT " p->offset=" XOT " bits=%d limbo=%d\n", segment_id(p->seg), p->offset, p->bit_fields, cp->limbo_pages);
-                    log_printf(15, "UNLINKING seg=" XIDT " p->offset=" XOT " bits=%d limbo=%d\n", segment_id(p->seg), p->offset, p->bit_fields, cp->limbo_pages);
+                    tbx_stack_unlink_current(cp->stack, 1);  //** and move it to the MRU slot.  This is ele
+                    curr_ele = tbx_stack_get_current_ptr(cp->stack);
+                    tbx_stack_move_to_top(cp->stack);
+                    tbx_stack_link_insert_above(cp->stack, lp->ele);
+                    tbx_stack_move_to_ptr(cp->stack, curr_ele);
                 }
             } else {
-                lp->bit_fields |= CAMP_OLD;  //** Flag it as old
-
-                log_printf(_amp_logging, "seg=" XIDT " MRU retry offset=" XOT "\n", segment_id(p->seg), p->offset);
-
-                tbx_stack_unlink_current(cp->stack, 1);  //** and move it to the MRU slot.  This is ele
-                curr_ele = tbx_stack_get_current_ptr(cp->stack);
-                tbx_stack_move_to_top(cp->stack);
-                tbx_stack_link_insert_above(cp->stack, lp->ele);
-                tbx_stack_move_to_ptr(cp->stack, curr_ele);
-
-                //** Tweak the stream info
-                _amp_stream_get(c, p->seg, p->offset, -1, &ps);  //** Don't care about the initial element in the chaing.  Just the last
-                if (ps != NULL) {
-                    if (ps->prefetch_size > 0) ps->prefetch_size--;
-                    if (ps->trigger_distance > 0) ps->trigger_distance--;
-                    if ((ps->prefetch_size-1) < ps->trigger_distance) ps->trigger_distance = ps->prefetch_size - 1;
-                }
+                tbx_stack_move_up(cp->stack);  //** Marked for release so move to the next page
             }
-        } else {
-            tbx_stack_move_up(cp->stack);  //** Marked for release so move to the next page
-        }
 
-        total_bytes = freed_bytes + pending_bytes;
-        if (total_bytes < bytes_to_free) ele = tbx_stack_get_current_ptr(cp->stack);
+            total_bytes = freed_bytes + pending_bytes;
+            if (total_bytes < bytes_to_free) ele = tbx_stack_get_current_ptr(cp->stack);
+        }
     }
 
 
@@ -1168,6 +1539,9 @@ void amp_update(cache_t *c, segment_t *seg, int rw_mode, ex_off_t lo, ex_off_t h
     log_printf(_amp_slog, "seg=" XIDT " hi=" XOT " pps=%p prevp=%d npages=%d lo=" XOT " hi=" XOT "\n", segment_id(seg), hi, pps, prevp, npages, lo, hi);
     ps = _amp_stream_get(c, seg, hi, nbytes, NULL);
     ps->prefetch_size = prevp + npages;
+    if (pps != NULL) ps->rate.rate = pps->rate.rate;
+    ps->rate.offset = lo;  //** Start timing the reader from the miss
+    ps->rate.time = apr_time_now();
     if (ps->prefetch_size > as->start_apt_pages) {
         ps->trigger_distance = as->start_apt_pages / 2;
 
@@ -1177,7 +1551,7 @@ void amp_update(cache_t *c, segment_t *seg, int rw_mode, ex_off_t lo, ex_off_t h
         if (p2) {
             if (*poff < hi) {
                 lp2 = (page_amp_t *)p2->priv;
-                lp2->bit_fields |= CAMP_TAG;
+                tbx_atomic_or(lp2->bit_fields, CAMP_TAG);
                 lp2->stream_offset = ps->last_offset;
                 log_printf(_amp_slog, "seg=" XIDT " SET_TAG offset=" XOT " last=" XOT "\n", segment_id(seg), p2->offset, lp2->stream_offset);
             }
@@ -1185,6 +1559,12 @@ void amp_update(cache_t *c, segment_t *seg, int rw_mode, ex_off_t lo, ex_off_t h
 
     }
 
+    p2 = tbx_list_search(s->pages, (tbx_list_key_t *)&hi);  //** Flag the stream end so a hit goes through _amp_page_access
+    if (p2 != NULL) {
+        lp2 = (page_amp_t *)p2->priv;
+        tbx_atomic_or(lp2->bit_fields, CAMP_LAST);
+    }
+
     log_printf(_amp_slog, "seg=" XIDT " MODIFY ps=%p last_offset=" XOT " prefetch=%d trigger=%d\n", segment_id(seg), ps, ps->last_offset, ps->prefetch_size, ps->trigger_distance);
 
     //** and load the extra pages
@@ -1192,7 +1572,7 @@ void amp_update(cache_t *c, segment_t *seg, int rw_mode, ex_off_t lo, ex_off_t h
     if (prevp > 0) {
         lo = hi + s->page_size;
         hi = lo + prevp * s->page_size - 1;
-        _amp_prefetch(seg, lo, hi, pps->prefetch_size, pps->trigger_distance);
+        _amp_prefetch(seg, lo, hi, pps->prefetch_size, pps->trigger_distance, &(ps->rate), &(pps->adapt));
     }
 
     cache_unlock(s->c);
@@ -1245,6 +1625,8 @@ void amp_adding_segment(cache_t *c, segment_t *seg)
     stable->streams = tbx_list_create(0, &skiplist_compare_ex_off, NULL, NULL, NULL);
     stable->max_streams = cp->max_streams;
     stable->index = 0;
+    stable->hit_time_mark = s->stats.hit_time;
+    stable->miss_time_mark = s->stats.miss_time;
     stable->start_apt_pages = cp->async_prefetch_threshold / s->page_size;
     if (stable->start_apt_pages < 2) stable->start_apt_pages = 2;
 
@@ -1265,6 +1647,7 @@ void amp_adding_segment(cache_t *c, segment_t *seg)
 
 void amp_removing_segment(cache_t *c, segment_t *seg)
 {
+    cache_amp_t *cp = (cache_amp_t *)c->fn.priv;
     cache_segment_t *s = (cache_segment_t *)seg->priv;
     amp_stream_table_t *stable = (amp_stream_table_t *)s->cache_priv;
 
@@ -1275,6 +1658,9 @@ void amp_removing_segment(cache_t *c, segment_t *seg)
 
     stable = NULL;  //** Make sure we clear it and gen a core dump if accidentally used
 
+    //** The segment's pages are gone so the cache may have shrunk
+    if (c->arena != NULL) cache_arena_set_trim(c->arena, cp->arena_keep_fraction * cp->max_bytes);
+
     return;
 }
 
@@ -1325,12 +1711,18 @@ int amp_cache_destroy(cache_t *c)
     }
 
     tbx_stack_free(cp->stack, 1);
+    if (cp->ring != NULL) {
+        for (n=0; n<cp->n_rings; n++) tbx_stack_free(cp->ring[n].stack, 1);
+        free(cp->ring);
+    }
     tbx_stack_free(cp->waiting_stack, 0);
     tbx_stack_free(cp->pending_free_tasks, 0);
 
     tbx_pc_destroy(cp->free_pending_tables);
     tbx_pc_destroy(cp->free_page_tables);
 
+    if (c->arena != NULL) cache_arena_set_destroy(c->arena);
+
     free(cp);
     free(c);
 
@@ -1362,8 +1754,11 @@ cache_t *amp_cache_create(void *arg, data_attr_t *da, int timeout)
     c->bytes_used = 0;
     c->prefetch_in_process = 0;
     c->dirty_fraction = 0.1;
+    c->arena_keep_fraction = 0.05;
     c->async_prefetch_threshold = 256*1024*1024;
     c->min_prefetch_size = 1024*1024;
+    c->adaptive_prefetch = 1;
+    c->prefetch_waste_target = 0.2;
     cache->n_ppages = 0;
     cache->max_fetch_fraction = 0.1;
     cache->max_fetch_size = cache->max_fetch_fraction * c->max_bytes;
@@ -1375,6 +1770,11 @@ cache_t *amp_cache_create(void *arg, data_attr_t *da, int timeout)
     c->dirty_max_wait = apr_time_make(1, 0);
     c->flush_in_progress = 0;
     c->limbo_pages = 0;
+    c->replacement = AMP_REPLACE_LRU;
+    c->ring = NULL;
+    c->n_rings = 0;
+    c->ring_next = 0;
+    c->ring_sweep = 0;
     c->free_pending_tables = tbx_pc_new("free_pending_tables", 50, sizeof(tbx_list_t *), cache->mpool, free_pending_table_new, free_pending_table_free);
     c->free_page_tables = tbx_pc_new("free_page_tables", 50, sizeof(page_table_t), cache->mpool, free_page_tables_new, free_page_tables_free);
 
@@ -1384,6 +1784,7 @@ cache_t *amp_cache_create(void *arg, data_attr_t *da, int timeout)
     cache->fn.cache_update = amp_update;
     cache->fn.cache_miss_tag = _amp_miss_tag;
     cache->fn.s_page_access = _amp_page_access;
+    cache->fn.s_page_touch = _amp_page_touch;
     cache->fn.s_pages_release = _amp_pages_release;
     cache->fn.destroy = amp_cache_destroy;
     cache->fn.adding_segment = amp_adding_segment;
@@ -1405,7 +1806,8 @@ cache_t *amp_cache_load(void *arg, tbx_inip_file_t *fd, char *grp, data_attr_t *
 {
     cache_t *c;
     cache_amp_t *cp;
-    int dt;
+    char *mode;
+    int dt, i;
 
     if (grp == NULL) grp = "cache-amp";
 
@@ -1423,6 +1825,8 @@ cache_t *amp_cache_load(void *arg, tbx_inip_file_t *fd, char *grp, data_attr_t *
     c->default_page_size = tbx_inip_get_integer(fd, grp, "default_page_size", c->default_page_size);
     cp->async_prefetch_threshold = tbx_inip_get_integer(fd, grp, "async_prefetch_threshold", cp->async_prefetch_threshold);
     cp->min_prefetch_size = tbx_inip_get_integer(fd, grp, "min_prefetch_bytes", cp->min_prefetch_size);
+    cp->adaptive_prefetch = tbx_inip_get_integer(fd, grp, "adaptive_prefetch", cp->adaptive_prefetch);
+    cp->prefetch_waste_target = tbx_inip_get_double(fd, grp, "prefetch_waste_target", cp->prefetch_waste_target);
     dt = tbx_inip_get_integer(fd, grp, "dirty_max_wait", apr_time_sec(cp->dirty_max_wait));
     cp->dirty_max_wait = apr_time_make(dt, 0);
     c->max_fetch_fraction = tbx_inip_get_double(fd, grp, "max_fetch_fraction", c->max_fetch_fraction);
@@ -1430,6 +1834,26 @@ cache_t *amp_cache_load(void *arg, tbx_inip_file_t *fd, char *grp, data_attr_t *
     c->write_temp_overflow_fraction = tbx_inip_get_double(fd, grp, "write_temp_overflow_fraction", c->write_temp_overflow_fraction);
     c->write_temp_overflow_size = c->write_temp_overflow_fraction * cp->max_bytes;
     c->n_ppages = tbx_inip_get_integer(fd, grp, "ppages", c->n_ppages);
+    c->n_page_shards = tbx_inip_get_integer(fd, grp, "page_shards", c->n_page_shards);
+
+    //** Get the replacement policy
+    mode = tbx_inip_get_string(fd, grp, "replacement", "lru");
+    if (strcmp(mode, "clock") == 0) {
+        cp->replacement = AMP_REPLACE_CLOCK;
+        cp->n_rings = tbx_inip_get_integer(fd, grp, "replacement_rings", AMP_CLOCK_RINGS);
+        if (cp->n_rings < 1) cp->n_rings = 1;
+        tbx_type_malloc_clear(cp->ring, amp_clock_ring_t, cp->n_rings);
+        for (i=0; i<cp->n_rings; i++) cp->ring[i].stack = tbx_stack_new();
+    } else if (strcmp(mode, "lru") != 0) {
+        log_printf(0, "Unknown replacement policy: %s  Using lru.\n", mode);
+    }
+    free(mode);
+
+    //** See if we use an arena for the page buffers
+    if (tbx_inip_get_integer(fd, grp, "page_arena", 1) == 1) {
+        c->arena = cache_arena_set_create(cp->max_bytes, tbx_inip_get_integer(fd, grp, "page_arena_huge_pages", 1));
+        cp->arena_keep_fraction = tbx_inip_get_double(fd, grp, "page_arena_keep_fraction", cp->arena_keep_fraction);
+    }
 
     cache_unlock(c);
 
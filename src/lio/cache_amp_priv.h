@@ -30,19 +30,48 @@ extern "C" {
 #define CAMP_ACCESSED 1  //** Page has been accessed
 #define CAMP_TAG      2  //** Tag page for pretech
 #define CAMP_OLD      4  //** Page has been recycled without a hit
+#define CAMP_REF      8  //** CLOCK reference bit.  Set on each hit and cleared by the sweep
+#define CAMP_LAST    16  //** Page is the end of a prefetch stream
+
+#define AMP_REPLACE_LRU    0  //** Single global LRU stack
+#define AMP_REPLACE_CLOCK  1  //** Sharded CLOCK rings with a reference bit per page
+
+#define AMP_CLOCK_RINGS   16  //** Default number of CLOCK rings
  
 typedef struct {
 cache_page_t page;  //** Actual page
-tbx_stack_ele_t *ele;   //** LRU position
+tbx_stack_ele_t *ele;   //** LRU or CLOCK ring position
 ex_off_t stream_offset;
-int bit_fields;
+tbx_atomic_unit32_t bit_fields;
+int ring;           //** CLOCK ring the page lives on
 } page_amp_t;
+
+typedef struct {
+tbx_stack_t *stack;       //** Pages on the ring
+tbx_stack_ele_t *hand;    //** Next page to examine.  NULL means start at the top
+} amp_clock_ring_t;
  
+typedef struct {        //** Reader consumption rate estimate carried along a stream
+double rate;           //** Bytes/usec
+ex_off_t offset;       //** Offset and time of the last sample
+apr_time_t time;
+} amp_stream_rate_t;
+
+typedef struct {        //** Prefetch feedback carried along a stream
+apr_time_t fetch_latency;  //** Average prefetch round trip
+double waste;              //** Average fraction of prefetched pages evicted without a hit
+ex_off_t floor;            //** Smallest prefetch issued
+ex_off_t prefetch_bytes;   //** Bytes prefetched and evicted unused since the last waste sample
+ex_off_t unused_bytes;
+} amp_stream_adapt_t;
+
 typedef struct {
 ex_off_t last_offset;
 ex_off_t nbytes;
 int prefetch_size;
 int trigger_distance;
+amp_stream_rate_t rate;
+amp_stream_adapt_t adapt;
 } amp_page_stream_t;
  
 typedef struct {
@@ -51,10 +80,13 @@ amp_page_stream_t *stream_table;
 tbx_list_t *streams;
 int index;
 int start_apt_pages;
+apr_time_t hit_time_mark;   //** Segment hit/miss times at the last prefetch adjustment
+apr_time_t miss_time_mark;
 } amp_stream_table_t;
  
 typedef struct {
 tbx_stack_t *stack;
+amp_clock_ring_t *ring;
 tbx_stack_t *waiting_stack;
 tbx_stack_t *pending_free_tasks;
 tbx_pc_t *free_pending_tables;
@@ -68,10 +100,17 @@ ex_off_t dirty_bytes_trigger;
 ex_off_t prefetch_in_process;
 ex_off_t async_prefetch_threshold;
 ex_off_t min_prefetch_size;
+double   prefetch_waste_target;
 double   dirty_fraction;
+double   arena_keep_fraction;
 int      max_streams;
 int      flush_in_progress;
 int      limbo_pages;
+int      replacement;
+int      n_rings;
+int      ring_next;
+int      ring_sweep;
+int      adaptive_prefetch;
 } cache_amp_t;
  
 typedef struct {
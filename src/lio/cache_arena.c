@@ -0,0 +1,472 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//***********************************************************************
+// Slab arenas for cache page buffers.  Each page size in use gets its own
+// arena.  The whole cache size is reserved up front as a single mapping,
+// optionally backed by transparent huge pages, and carved into fixed size
+// slots handed out from a lock free free list.
+//***********************************************************************
+
+#define _log_module_index 225
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <apr_atomic.h>
+#include <tbx/type_malloc.h>
+#include <tbx/log.h>
+#include "cache.h"
+
+#define ARENA_SLOT(v) ((apr_uint32_t)((v) & 0xFFFFFFFF))
+#define ARENA_HEAD(tag, slot) ((((apr_uint64_t)(tag)) << 32) | (apr_uint64_t)(slot))
+#define ARENA_NEXT_TAG(v) (((v) >> 32) + 1)
+
+#define CACHE_ARENA_MAX_UNIT 16  //** Max huge or OS pages in a unit
+
+//*************************************************************************
+// _arena_cas - Swaps in the new free list head if it hasn't changed
+//*************************************************************************
+
+static inline int _arena_cas(cache_arena_t *a, apr_uint64_t old, apr_uint64_t new)
+{
+    return(__sync_bool_compare_and_swap(&(a->head), old, new));
+}
+
+//*************************************************************************
+// _arena_push - Pushes a chain of slots, first...last, on the free list.
+//    The slot numbers are offset by 1 so 0 can mark the end of the list.
+//*************************************************************************
+
+static void _arena_push(cache_arena_t *a, apr_uint32_t first, apr_uint32_t last)
+{
+    apr_uint64_t old;
+
+    do {
+        old = a->head;
+        a->next[last-1] = ARENA_SLOT(old);
+    } while (!_arena_cas(a, old, ARENA_HEAD(ARENA_NEXT_TAG(old), first)));
+}
+
+//*************************************************************************
+// _arena_pop - Pops a slot off the free list.  Returns the slot+1 or 0 if
+//    the list is empty.  The tag in the head keeps a stale next from
+//    being installed if the slot was popped and pushed back underneath us.
+//*************************************************************************
+
+static apr_uint32_t _arena_pop(cache_arena_t *a)
+{
+    apr_uint64_t old;
+    apr_uint32_t slot;
+
+    do {
+        old = a->head;
+        slot = ARENA_SLOT(old);
+        if (slot == 0) return(0);
+    } while (!_arena_cas(a, old, ARENA_HEAD(ARENA_NEXT_TAG(old), a->next[slot-1])));
+
+    return(slot);
+}
+
+//*************************************************************************
+// _arena_addr - Returns the address of the slot.  Slots are packed into
+//    units and never straddle one.
+//*************************************************************************
+
+static inline char *_arena_addr(cache_arena_t *a, apr_uint32_t slot)
+{
+    return(a->base + (ex_off_t)(slot / a->per_unit) * a->unit_size + (ex_off_t)(slot % a->per_unit) * a->slot_size);
+}
+
+//*************************************************************************
+// cache_arena_create - Reserves an arena of size bytes carved into
+//    slot_size buffers.  Memory is only committed as slots are used.
+//    Memory is given back to the kernel a unit at a time.  With huge pages
+//    a unit is made of whole huge pages so releasing memory doesn't split them.
+//*************************************************************************
+
+cache_arena_t *cache_arena_create(ex_off_t slot_size, ex_off_t size, int huge_pages)
+{
+    cache_arena_t *a;
+    ex_off_t unit, n, m;
+
+    unit = (huge_pages) ? CACHE_ARENA_HUGE_PAGE : getpagesize();
+    if (slot_size <= 0) {
+        log_printf(0, "ERROR: Invalid arena slot_size=" XOT "\n", slot_size);
+        return(NULL);
+    }
+
+    tbx_type_malloc_clear(a, cache_arena_t, 1);
+    a->slot_size = slot_size;
+
+    //** Find the smallest unit that wastes less than 1/8th of its space
+    for (m=1; m<=CACHE_ARENA_MAX_UNIT; m++) {
+        n = (m * unit) / slot_size;
+        if (n == 0) continue;
+        if ((a->per_unit == 0) || ((m * unit - n * slot_size) * 8 <= m * unit)) {
+            a->unit_size = m * unit;
+            a->per_unit = n;
+            if ((m * unit - n * slot_size) * 8 <= m * unit) break;
+        }
+    }
+    if (a->per_unit == 0) {  //** Huge slot so just round it up
+        a->unit_size = ((slot_size + unit - 1) / unit) * unit;
+        a->per_unit = 1;
+    }
+
+    n = size / a->unit_size;
+    if ((n <= 0) || ((n * a->per_unit) >= 0xFFFFFFFF)) {
+        log_printf(0, "ERROR: Invalid arena size=" XOT " slot_size=" XOT "\n", size, slot_size);
+        free(a);
+        return(NULL);
+    }
+    a->n_units = n;
+    a->n_slots = n * a->per_unit;
+    a->size = n * a->unit_size;
+    a->huge_pages = huge_pages;
+
+    //** Over reserve so the slots can start on a huge page boundary
+    a->map_size = a->size + CACHE_ARENA_HUGE_PAGE;
+    a->map = mmap(NULL, a->map_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+    if (a->map == MAP_FAILED) {
+        log_printf(0, "ERROR: Unable to reserve arena size=" XOT "\n", a->map_size);
+        free(a);
+        return(NULL);
+    }
+    a->base = a->map + ((CACHE_ARENA_HUGE_PAGE - ((apr_uintptr_t)a->map % CACHE_ARENA_HUGE_PAGE)) % CACHE_ARENA_HUGE_PAGE);
+
+#ifdef MADV_HUGEPAGE
+    if (huge_pages) {
+        if (madvise(a->base, a->size, MADV_HUGEPAGE) != 0) {
+            log_printf(1, "Transparent huge pages not available for the arena\n");
+            a->huge_pages = 0;
+        }
+    }
+#else
+    a->huge_pages = 0;
+#endif
+
+    tbx_type_malloc(a->next, apr_uint32_t, a->n_slots);
+    tbx_type_malloc_clear(a->resident, apr_uint32_t, a->n_units);
+    tbx_type_malloc_clear(a->unit_free, apr_uint32_t, a->n_units);
+    a->head = 0;
+
+    log_printf(5, "arena size=" XOT " slot_size=" XOT " unit_size=" XOT " n_slots=%u per_unit=%u huge_pages=%d\n", a->size, a->slot_size, a->unit_size, a->n_slots, a->per_unit, a->huge_pages);
+
+    return(a);
+}
+
+//*************************************************************************
+// cache_arena_destroy - Releases the arena.  All slots should be free.
+//*************************************************************************
+
+void cache_arena_destroy(cache_arena_t *a)
+{
+    if (tbx_atomic_get(a->n_used) != 0) {
+        log_printf(0, "ERROR: Destroying arena with %u slots in use\n", tbx_atomic_get(a->n_used));
+    }
+
+    munmap(a->map, a->map_size);
+    free(a->next);
+    free(a->resident);
+    free(a->unit_free);
+    free(a);
+}
+
+//*************************************************************************
+// cache_arena_alloc - Returns a free slot or NULL if the arena is full
+//*************************************************************************
+
+void *cache_arena_alloc(cache_arena_t *a)
+{
+    apr_uint32_t slot;
+
+    slot = _arena_pop(a);
+    if (slot == 0) {  //** Nothing on the free list so carve from the untouched tail
+        slot = tbx_atomic_inc(a->n_touched);
+        if (slot >= a->n_slots) {
+            tbx_atomic_dec(a->n_touched);
+            return(NULL);
+        }
+        slot++;
+    }
+    slot--;
+
+    //** Other slots in the unit can be allocated at the same time so flag it atomically
+    if (apr_atomic_cas32(&(a->resident[slot / a->per_unit]), 1, 0) == 0) tbx_atomic_inc(a->n_resident);
+    tbx_atomic_inc(a->n_used);
+
+    return(_arena_addr(a, slot));
+}
+
+//*************************************************************************
+// cache_arena_free - Returns the buffer to the arena.  If the buffer
+//    didn't come from the arena 1 is returned and nothing is done.
+//*************************************************************************
+
+int cache_arena_free(cache_arena_t *a, void *ptr)
+{
+    char *cptr = (char *)ptr;
+    ex_off_t off;
+    apr_uint32_t slot;
+
+    if ((cptr < a->base) || (cptr >= a->base + a->size)) return(1);
+
+    off = cptr - a->base;
+    slot = (off / a->unit_size) * a->per_unit + (off % a->unit_size) / a->slot_size;
+    tbx_atomic_dec(a->n_used);
+    _arena_push(a, slot+1, slot+1);
+
+    return(0);
+}
+
+//*************************************************************************
+// cache_arena_free_bytes - Returns the resident memory not holding pages
+//*************************************************************************
+
+static ex_off_t cache_arena_free_bytes(cache_arena_t *a)
+{
+    return((ex_off_t)tbx_atomic_get(a->n_resident) * a->unit_size - (ex_off_t)tbx_atomic_get(a->n_used) * a->slot_size);
+}
+
+//*************************************************************************
+// cache_arena_trim - Gives free units back to the kernel until at most
+//    keep_bytes of free memory is left resident.  Only units whose slots
+//    are all free are released.  Returns the bytes released.
+//*************************************************************************
+
+ex_off_t cache_arena_trim(cache_arena_t *a, ex_off_t keep_bytes)
+{
+    apr_uint64_t old;
+    apr_uint32_t first, last, slot, unit;
+    ex_off_t free_bytes, trimmed;
+
+    free_bytes = cache_arena_free_bytes(a);
+    if (free_bytes <= keep_bytes) return(0);
+
+    if (apr_atomic_cas32(&(a->trimming), 1, 0) != 0) return(0);  //** Someone else is already on it
+
+    //** Detach the whole free list.  Allocations fall back to the tail or malloc while we work
+    do {
+        old = a->head;
+        first = ARENA_SLOT(old);
+        if (first == 0) {
+            tbx_atomic_set(a->trimming, 0);
+            return(0);
+        }
+    } while (!_arena_cas(a, old, ARENA_HEAD(ARENA_NEXT_TAG(old), 0)));
+
+    //** Count the free slots in each unit.  We own all of them now.
+    slot = first;
+    do {
+        a->unit_free[(slot-1) / a->per_unit]++;
+        slot = a->next[slot-1];
+    } while (slot != 0);
+
+    //** Release the units that are completely free.  The count is cleared on
+    //** the 1st visit so each unit is only checked once.
+    trimmed = 0;
+    slot = first;
+    do {
+        last = slot;
+        unit = (slot-1) / a->per_unit;
+        if ((free_bytes > keep_bytes) && (a->unit_free[unit] == a->per_unit) && (a->resident[unit] == 1)) {
+            madvise(a->base + (ex_off_t)unit * a->unit_size, a->unit_size, MADV_DONTNEED);
+            tbx_atomic_set(a->resident[unit], 0);
+            tbx_atomic_dec(a->n_resident);
+            free_bytes -= a->unit_size;
+            trimmed += a->unit_size;
+        }
+        a->unit_free[unit] = 0;
+        slot = a->next[slot-1];
+    } while (slot != 0);
+
+    //** and splice it back
+    _arena_push(a, first, last);
+    tbx_atomic_set(a->trimming, 0);
+
+    log_printf(5, "trimmed=" XOT " free_bytes=" XOT " keep_bytes=" XOT "\n", trimmed, free_bytes, keep_bytes);
+
+    return(trimmed);
+}
+
+//*************************************************************************
+// cache_arena_stats - Adds the arena occupancy to the stats
+//*************************************************************************
+
+void cache_arena_stats(cache_arena_t *a, cache_stats_t *cs)
+{
+    cs->arena_bytes += a->size;
+    cs->arena_used_bytes += (ex_off_t)tbx_atomic_get(a->n_used) * a->slot_size;
+    cs->arena_resident_bytes += (ex_off_t)tbx_atomic_get(a->n_resident) * a->unit_size;
+}
+
+//*************************************************************************
+// cache_arena_set_create - Creates an empty set of arenas.  An arena is
+//    added for each page size as it's used and reserves size bytes.
+//*************************************************************************
+
+cache_arena_set_t *cache_arena_set_create(ex_off_t size, int huge_pages)
+{
+    cache_arena_set_t *as;
+
+    tbx_type_malloc_clear(as, cache_arena_set_t, 1);
+    as->size = size;
+    as->huge_pages = huge_pages;
+
+    return(as);
+}
+
+//*************************************************************************
+// cache_arena_set_destroy - Destroys all the arenas
+//*************************************************************************
+
+void cache_arena_set_destroy(cache_arena_set_t *as)
+{
+    int i;
+
+    for (i=0; i<as->n_classes; i++) cache_arena_destroy(as->arena[i]);
+    free(as);
+}
+
+//*************************************************************************
+// cache_arena_set_get - Returns the arena for the page size or NULL
+//*************************************************************************
+
+static cache_arena_t *cache_arena_set_get(cache_arena_set_t *as, ex_off_t size)
+{
+    int i, n;
+
+    n = as->n_classes;
+    __sync_synchronize();  //** Pairs with the barrier in cache_arena_set_add()
+    for (i=0; i<n; i++) {
+        if (as->arena[i]->slot_size == size) return(as->arena[i]);
+    }
+
+    return(NULL);
+}
+
+//*************************************************************************
+// cache_arena_set_add - Adds an arena for the page size.  Returns NULL if
+//    we're out of classes.
+//    NOTE: Assumes the cache lock is held
+//*************************************************************************
+
+static cache_arena_t *cache_arena_set_add(cache_arena_set_t *as, ex_off_t size)
+{
+    cache_arena_t *a;
+
+    if (as->n_classes >= CACHE_ARENA_CLASSES) return(NULL);
+
+    a = cache_arena_create(size, as->size, as->huge_pages);
+    if (a == NULL) return(NULL);
+
+    as->arena[as->n_classes] = a;
+    __sync_synchronize();  //** Make sure the arena is visible before the count
+    as->n_classes++;
+
+    log_printf(1, "Added page arena for page_size=" XOT " n_classes=%d\n", size, as->n_classes);
+    return(a);
+}
+
+//*************************************************************************
+// cache_arena_set_trim - Trims the arenas so at most keep_bytes of free
+//    memory is left resident across all of them.  Returns the bytes released.
+//*************************************************************************
+
+ex_off_t cache_arena_set_trim(cache_arena_set_t *as, ex_off_t keep_bytes)
+{
+    ex_off_t trimmed, free_bytes, keep;
+    int i, n;
+
+    n = as->n_classes;
+    __sync_synchronize();
+
+    trimmed = 0;
+    for (i=0; i<n; i++) {
+        free_bytes = cache_arena_free_bytes(as->arena[i]);
+        keep = (free_bytes < keep_bytes) ? free_bytes : keep_bytes;
+        if (keep < 0) keep = 0;
+        keep_bytes -= keep;
+        trimmed += cache_arena_trim(as->arena[i], keep);
+    }
+
+    return(trimmed);
+}
+
+//*************************************************************************
+// cache_arena_set_stats - Adds the occupancy of all the arenas to the stats
+//*************************************************************************
+
+void cache_arena_set_stats(cache_arena_set_t *as, cache_stats_t *cs)
+{
+    int i;
+
+    for (i=0; i<as->n_classes; i++) cache_arena_stats(as->arena[i], cs);
+}
+
+//*************************************************************************
+// cache_page_buffer_new - Allocates a page buffer.  Buffers come from the
+//    arena for their size if it has room.
+//    NOTE: Assumes the cache lock is held
+//*************************************************************************
+
+void *cache_page_buffer_new(cache_t *c, ex_off_t size, int clear)
+{
+    cache_arena_t *a;
+    char *ptr;
+
+    if (c->arena != NULL) {
+        a = cache_arena_set_get(c->arena, size);
+        if (a == NULL) a = cache_arena_set_add(c->arena, size);
+        if (a != NULL) {
+            ptr = cache_arena_alloc(a);
+            if (ptr != NULL) {
+                if (clear) memset(ptr, 0, size);
+                return(ptr);
+            }
+        }
+    }
+
+    if (clear) {
+        tbx_type_malloc_clear(ptr, char, size);
+    } else {
+        tbx_type_malloc(ptr, char, size);
+    }
+
+    return(ptr);
+}
+
+//*************************************************************************
+// cache_page_buffer_free - Frees a buffer from cache_page_buffer_new
+//*************************************************************************
+
+void cache_page_buffer_free(cache_t *c, void *ptr)
+{
+    int i, n;
+
+    if (ptr == NULL) return;
+
+    if (c->arena != NULL) {
+        n = c->arena->n_classes;
+        __sync_synchronize();
+        for (i=0; i<n; i++) {
+            if (cache_arena_free(c->arena->arena[i], ptr) == 0) return;
+        }
+    }
+
+    free(ptr);
+}
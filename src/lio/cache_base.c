@@ -62,6 +62,7 @@ void cache_base_create(cache_t *c, data_attr_t *da, int timeout)
     c->da = da;
     c->timeout = timeout;
     c->default_page_size = 16*1024;
+    c->n_page_shards = CACHE_PAGE_SHARDS;
 }
 
 //*************************************************************
@@ -43,6 +43,14 @@ extern "C" {
 #define C_EMPTY     2
 #define C_TORELEASE 4
 
+#define CACHE_PAGE_SHARDS 16      //** Default number of page table shards per segment
+
+#define CACHE_MARK_NONE          0  //** Leave a busy page's bits alone
+#define CACHE_MARK_TORELEASE     1  //** Add C_TORELEASE to a busy page
+#define CACHE_MARK_ONLY_RELEASE  2  //** Replace a busy page's bits with just C_TORELEASE
+
+#define CACHE_ARENA_HUGE_PAGE (2*1024*1024)  //** Transparent huge page size the arena is aligned to
+
 struct cache_s;
 typedef struct cache_s cache_t;
 
@@ -67,10 +75,43 @@ typedef struct {
     ex_off_t hit_bytes;
     ex_off_t miss_bytes;
     ex_off_t unused_bytes;
+    ex_off_t arena_bytes;          //** Page arena reservation
+    ex_off_t arena_used_bytes;     //** Arena slots holding pages
+    ex_off_t arena_resident_bytes; //** Arena slots backed by memory
     apr_time_t hit_time;
     apr_time_t miss_time;
 } cache_stats_t;
 
+typedef struct {       //** Slab of fixed size page buffers carved from one mapping
+    char *map;
+    char *base;
+    ex_off_t map_size;
+    ex_off_t slot_size;
+    ex_off_t size;
+    ex_off_t unit_size;          //** Slots are released back to the kernel a unit at a time
+    volatile apr_uint64_t head;  //** Free list head.  Hi word is an ABA tag and the low word is slot+1
+    apr_uint32_t *next;          //** Free list links
+    apr_uint32_t *resident;      //** Set if the unit is backed by memory
+    apr_uint32_t *unit_free;     //** Scratch space for trimming
+    tbx_atomic_unit32_t n_used;
+    tbx_atomic_unit32_t n_resident; //** Units backed by memory
+    tbx_atomic_unit32_t n_touched;  //** Slots handed out from the untouched tail
+    tbx_atomic_unit32_t trimming;
+    apr_uint32_t n_slots;
+    apr_uint32_t n_units;
+    apr_uint32_t per_unit;       //** Slots in each unit
+    int huge_pages;
+} cache_arena_t;
+
+#define CACHE_ARENA_CLASSES 8     //** Max number of distinct page sizes with their own arena
+
+typedef struct {       //** An arena for each page size in use.  Classes are only ever added.
+    cache_arena_t *arena[CACHE_ARENA_CLASSES];
+    volatile int n_classes;
+    ex_off_t size;               //** Address space reserved for each class
+    int huge_pages;
+} cache_arena_set_t;
+
 typedef struct {
     apr_thread_cond_t *cond;
     int count;
@@ -88,12 +129,19 @@ typedef struct {
     int flags;
 } cache_partial_page_t;
 
+typedef struct {     //** Offset hashed slice of a segment's page table
+    apr_thread_mutex_t *lock;
+    tbx_list_t *pages;
+} cache_page_shard_t;
+
 typedef struct {
     cache_t *c;
     void *cache_priv;
     segment_t *child_seg;
     thread_pool_context_t *tpc_unlimited;
-    tbx_list_t *pages;
+    tbx_list_t *pages;            //** Ordered page index.  Protected by the cache lock
+    cache_page_shard_t *shard;    //** Point lookup index used for lock free hits
+    int n_shards;
     tbx_list_t *partial_pages;
     apr_thread_mutex_t *lock;
     apr_thread_cond_t  *flush_cond;
@@ -117,7 +165,7 @@ typedef struct {
 
 typedef struct {
     char *ptr;
-    int  usage_count;
+    tbx_atomic_unit32_t usage_count;
 } data_page_t;
 
 typedef struct {
@@ -127,9 +175,10 @@ typedef struct {
     void *priv;
     ex_off_t offset;
     tbx_pch_t cond_pch;
-    int  bit_fields;
-    int access_pending[3];
-    int used_count;
+    tbx_atomic_unit32_t bit_fields;
+    tbx_atomic_unit32_t access_pending[3];
+    tbx_atomic_unit32_t write_seq;   //** Odd while a write hit is copying into the page
+    tbx_atomic_unit32_t used_count;  //** Bumped lock free on CLOCK read hits
     int current_index;
 }  cache_page_t;
 
@@ -158,6 +207,7 @@ struct cache_fn_s {
     void (*cache_update)(cache_t *c, segment_t *seg, int rw_mode, ex_off_t lo, ex_off_t hi, void *miss);
     void (*cache_miss_tag)(cache_t *c, segment_t *seg, int rw_mode, ex_off_t lo, ex_off_t hi, ex_off_t missing_offset, void **miss);
     int (*s_page_access)(cache_t *c, cache_page_t *p, int rw_mode, ex_off_t request_len);
+    int (*s_page_touch)(cache_t *c, cache_page_t *p, int rw_mode, ex_off_t request_len);  //** Optional lock free s_page_access.  Returns 1 if s_page_access is still needed
     int (*s_pages_release)(cache_t *c, cache_page_t **p, int n_pages);
     cache_t *(*get_handle)(cache_t *);
     int (*destroy)(cache_t *c);
@@ -178,6 +228,8 @@ struct cache_s {
     double   max_fetch_fraction;
     double   write_temp_overflow_fraction;
     int n_ppages;
+    int n_page_shards;
+    cache_arena_set_t *arena;  //** Page buffer arenas.  NULL means malloc is used
     int timeout;
     int  shutdown_request;
 };
@@ -189,6 +241,8 @@ extern tbx_atomic_unit32_t _cache_count;
 #define cache_unlock(c) apr_thread_mutex_unlock((c)->lock)
 #define cache_get_handle(c) (c)->fn.get_handle(c)
 #define cache_destroy(c) (c)->fn.destroy(c)
+#define cache_page_shard(s, off) (&((s)->shard[((off) / (s)->page_size) % (s)->n_shards]))
+#define cache_page_count(p) (tbx_atomic_get((p)->access_pending[CACHE_READ]) + tbx_atomic_get((p)->access_pending[CACHE_WRITE]) + tbx_atomic_get((p)->access_pending[CACHE_FLUSH]))
 
 LIO_API cache_stats_t get_cache_stats(cache_t *c);
 cache_t *cache_base_handle(cache_t *);
@@ -201,6 +255,26 @@ LIO_API int cache_drop_pages(segment_t *seg, ex_off_t lo, ex_off_t hi);
 int cache_release_pages(int n_pages, page_handle_t *page, int rw_mode);
 void _cache_drain_writes(segment_t *seg, cache_page_t *p);
 void cache_advise(segment_t *seg, segment_rw_hints_t *rw_hints, int rw_mode, ex_off_t lo, ex_off_t hi, page_handle_t *page, int *n_pages, int force_load);
+LIO_API void cache_page_table_create(cache_segment_t *s, int n_shards, apr_pool_t *mpool);
+LIO_API void cache_page_table_destroy(cache_segment_t *s);
+LIO_API void cache_page_table_insert(cache_segment_t *s, cache_page_t *p);
+void cache_page_table_remove(cache_segment_t *s, cache_page_t *p);
+int cache_page_table_remove_idle(cache_segment_t *s, cache_page_t *p, int mark_mode);
+LIO_API int cache_page_table_pin(cache_segment_t *s, ex_off_t poff, page_handle_t *ph);
+void cache_page_table_swap_data(cache_segment_t *s, cache_page_t *p, int index);
+LIO_API int cache_page_table_unpin(cache_segment_t *s, page_handle_t *ph);
+cache_arena_t *cache_arena_create(ex_off_t slot_size, ex_off_t size, int huge_pages);
+void cache_arena_destroy(cache_arena_t *a);
+void *cache_arena_alloc(cache_arena_t *a);
+int cache_arena_free(cache_arena_t *a, void *ptr);
+ex_off_t cache_arena_trim(cache_arena_t *a, ex_off_t keep_bytes);
+void cache_arena_stats(cache_arena_t *a, cache_stats_t *cs);
+cache_arena_set_t *cache_arena_set_create(ex_off_t size, int huge_pages);
+void cache_arena_set_destroy(cache_arena_set_t *as);
+ex_off_t cache_arena_set_trim(cache_arena_set_t *as, ex_off_t keep_bytes);
+void cache_arena_set_stats(cache_arena_set_t *as, cache_stats_t *cs);
+void *cache_page_buffer_new(cache_t *c, ex_off_t size, int clear);
+void cache_page_buffer_free(cache_t *c, void *ptr);
 
 void *free_page_tables_new(void *arg, int size);
 void free_page_tables_free(void *arg, int size, void *data);
@@ -0,0 +1,410 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//******************************************************************************
+// GF(2^8) Reed-Solomon region engine.  Used in place of Jerasure's scalar
+// region multiply for w=8 matrix codes.  The field and coding matrices are
+// the same as Jerasure's so the encoded bytes are identical.
+//
+// Each coefficient c is split into two 16 entry tables, c*x and c*(x<<4),
+// so a byte is multiplied with two PSHUFB lookups on its nibbles.  All the
+// sources are accumulated into the destination in a single pass.
+//******************************************************************************
+
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <tbx/assert_result.h>
+#include <jerasure/jerasure.h>
+#include "erasure_gf8.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GF8_X86
+#include <immintrin.h>
+#endif
+
+#define GF8_PRIM_POLY   0x11d   //** Same as Jerasure's w=8 polynomial, 0435 octal
+#define GF8_STACK_SRCS  64      //** Dot products with more sources than this malloc the tables
+
+typedef struct {   //** Split multiplication table for a single coefficient
+    unsigned char lo[16];
+    unsigned char hi[16];
+} gf8_table_t;
+
+typedef void (gf8_dotprod_fn_t)(int n, gf8_table_t *t, char **src, char *dest, int nbytes);
+
+static const char *_gf8_isa_name[GF8_ISA_MAX] = { "jerasure", "ssse3", "avx2" };
+static gf8_dotprod_fn_t *_gf8_dotprod = NULL;
+static int _gf8_isa = GF8_ISA_AUTO;
+
+//******************************************************************************
+// gf8_multiply - Multiplies 2 field elements
+//******************************************************************************
+
+unsigned char gf8_multiply(unsigned char a, unsigned char b)
+{
+    unsigned int x = a;
+    unsigned char prod = 0;
+
+    while (b) {
+        if (b & 1) prod ^= x;
+        b >>= 1;
+        x <<= 1;
+        if (x & 0x100) x ^= GF8_PRIM_POLY;
+    }
+
+    return(prod);
+}
+
+//******************************************************************************
+//  _gf8_table_init - Fills in the split tables for the coefficient
+//******************************************************************************
+
+static void _gf8_table_init(gf8_table_t *t, unsigned char c)
+{
+    int x;
+
+    for (x=0; x<16; x++) {
+        t->lo[x] = gf8_multiply(c, x);
+        t->hi[x] = gf8_multiply(c, x << 4);
+    }
+}
+
+//******************************************************************************
+//  _gf8_dotprod_scalar_range - Does bytes [start, nbytes) a byte at a time.
+//     Used for the tails of the vector kernels.
+//******************************************************************************
+
+static void _gf8_dotprod_scalar_range(int n, gf8_table_t *t, char **src, char *dest, int start, int nbytes)
+{
+    unsigned char b, c;
+    int i, j;
+
+    for (j=start; j<nbytes; j++) {
+        c = 0;
+        for (i=0; i<n; i++) {
+            b = src[i][j];
+            c ^= t[i].lo[b & 0x0f] ^ t[i].hi[b >> 4];
+        }
+        dest[j] = c;
+    }
+}
+
+#ifdef GF8_X86
+
+//******************************************************************************
+//  _gf8_dotprod_ssse3 - 32 bytes per pass
+//******************************************************************************
+
+__attribute__((target("ssse3")))
+static void _gf8_dotprod_ssse3(int n, gf8_table_t *t, char **src, char *dest, int nbytes)
+{
+    __m128i mask, lo, hi, a0, a1, s0, s1;
+    char *s;
+    int i, j;
+
+    mask = _mm_set1_epi8(0x0f);
+    for (j=0; j+32 <= nbytes; j += 32) {
+        a0 = _mm_setzero_si128();
+        a1 = _mm_setzero_si128();
+        for (i=0; i<n; i++) {
+            lo = _mm_loadu_si128((__m128i *)t[i].lo);
+            hi = _mm_loadu_si128((__m128i *)t[i].hi);
+            s = src[i] + j;
+            s0 = _mm_loadu_si128((__m128i *)s);
+            s1 = _mm_loadu_si128((__m128i *)(s + 16));
+            a0 = _mm_xor_si128(a0, _mm_shuffle_epi8(lo, _mm_and_si128(s0, mask)));
+            a0 = _mm_xor_si128(a0, _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s0, 4), mask)));
+            a1 = _mm_xor_si128(a1, _mm_shuffle_epi8(lo, _mm_and_si128(s1, mask)));
+            a1 = _mm_xor_si128(a1, _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s1, 4), mask)));
+        }
+        _mm_storeu_si128((__m128i *)(dest + j), a0);
+        _mm_storeu_si128((__m128i *)(dest + j + 16), a1);
+    }
+
+    _gf8_dotprod_scalar_range(n, t, src, dest, j, nbytes);
+}
+
+//******************************************************************************
+//  _gf8_dotprod_avx2 - 64 bytes per pass
+//******************************************************************************
+
+__attribute__((target("avx2")))
+static void _gf8_dotprod_avx2(int n, gf8_table_t *t, char **src, char *dest, int nbytes)
+{
+    __m256i mask, lo, hi, a0, a1, s0, s1;
+    char *s;
+    int i, j;
+
+    mask = _mm256_set1_epi8(0x0f);
+    for (j=0; j+64 <= nbytes; j += 64) {
+        a0 = _mm256_setzero_si256();
+        a1 = _mm256_setzero_si256();
+        for (i=0; i<n; i++) {
+            lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)t[i].lo));
+            hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i *)t[i].hi));
+            s = src[i] + j;
+            s0 = _mm256_loadu_si256((__m256i *)s);
+            s1 = _mm256_loadu_si256((__m256i *)(s + 32));
+            a0 = _mm256_xor_si256(a0, _mm256_shuffle_epi8(lo, _mm256_and_si256(s0, mask)));
+            a0 = _mm256_xor_si256(a0, _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(s0, 4), mask)));
+            a1 = _mm256_xor_si256(a1, _mm256_shuffle_epi8(lo, _mm256_and_si256(s1, mask)));
+            a1 = _mm256_xor_si256(a1, _mm256_shuffle_epi8(hi, _mm256_and_si256(_mm256_srli_epi64(s1, 4), mask)));
+        }
+        _mm256_storeu_si256((__m256i *)(dest + j), a0);
+        _mm256_storeu_si256((__m256i *)(dest + j + 32), a1);
+    }
+
+    _gf8_dotprod_scalar_range(n, t, src, dest, j, nbytes);
+}
+
+static gf8_dotprod_fn_t *_gf8_isa_fn[GF8_ISA_MAX] = { NULL, _gf8_dotprod_ssse3, _gf8_dotprod_avx2 };
+
+#else
+
+static gf8_dotprod_fn_t *_gf8_isa_fn[GF8_ISA_MAX] = { NULL, NULL, NULL };
+
+#endif
+
+//******************************************************************************
+//  gf8_isa_supported - Returns 1 if the CPU can run the ISA's kernel
+//******************************************************************************
+
+int gf8_isa_supported(int isa)
+{
+    if ((isa < 0) || (isa >= GF8_ISA_MAX)) return(0);
+    if (isa == GF8_ISA_JERASURE) return(1);
+    if (_gf8_isa_fn[isa] == NULL) return(0);
+
+#ifdef GF8_X86
+    __builtin_cpu_init();
+    switch (isa) {
+    case GF8_ISA_SSSE3:
+        return(__builtin_cpu_supports("ssse3") ? 1 : 0);
+    case GF8_ISA_AVX2:
+        return(__builtin_cpu_supports("avx2") ? 1 : 0);
+    }
+#endif
+
+    return(1);
+}
+
+//******************************************************************************
+//  gf8_isa_name - Returns the ISA's name
+//******************************************************************************
+
+const char *gf8_isa_name(int isa)
+{
+    if ((isa < 0) || (isa >= GF8_ISA_MAX)) return("unknown");
+    return(_gf8_isa_name[isa]);
+}
+
+//******************************************************************************
+//  gf8_set_isa - Selects the kernel.  GF8_ISA_AUTO picks the widest one the
+//     CPU supports.  GF8_ISA_JERASURE turns the engine off.  Returns the ISA
+//     used or -1 if it isn't supported.
+//******************************************************************************
+
+int gf8_set_isa(int isa)
+{
+    if (isa == GF8_ISA_AUTO) {
+        for (isa=GF8_ISA_MAX-1; isa>GF8_ISA_JERASURE; isa--) {
+            if (gf8_isa_supported(isa) == 1) break;
+        }
+    } else if (gf8_isa_supported(isa) == 0) {
+        return(-1);
+    }
+
+    _gf8_isa = isa;
+    _gf8_dotprod = _gf8_isa_fn[isa];
+
+    return(isa);
+}
+
+//******************************************************************************
+//  gf8_get_isa - Returns the ISA currently in use
+//******************************************************************************
+
+int gf8_get_isa()
+{
+    if (_gf8_isa == GF8_ISA_AUTO) gf8_set_isa(GF8_ISA_AUTO);
+    return(_gf8_isa);
+}
+
+//******************************************************************************
+//  gf8_dotprod - Stores sum(coef[i]*src[i]) in dest.  dest can be one of the
+//     src blocks.  If the engine is disabled the Jerasure region multiply is used.
+//******************************************************************************
+
+void gf8_dotprod(int n, int *coef, char **src, char *dest, int nbytes)
+{
+    gf8_table_t stack_t[GF8_STACK_SRCS];
+    char *stack_src[GF8_STACK_SRCS];
+    gf8_table_t *t;
+    char **s;
+    int i, m;
+
+    if (gf8_get_isa() == GF8_ISA_JERASURE) {
+        jerasure_matrix_dotprod(n, 8, coef, NULL, n, src, &dest, nbytes);  //** dest_id=n is coding[0]
+        return;
+    }
+
+    t = stack_t;
+    s = stack_src;
+    if (n > GF8_STACK_SRCS) {
+        t = (gf8_table_t *)malloc(sizeof(gf8_table_t)*n);
+        s = (char **)malloc(sizeof(char *)*n);
+        assert((t != NULL) && (s != NULL));
+    }
+
+    //** Drop the 0 coefficients since they don't contribute anything
+    m = 0;
+    for (i=0; i<n; i++) {
+        if (coef[i] == 0) continue;
+        _gf8_table_init(&(t[m]), coef[i]);
+        s[m] = src[i];
+        m++;
+    }
+
+    if (m == 0) {
+        memset(dest, 0, nbytes);
+    } else {
+        _gf8_dotprod(m, t, s, dest, nbytes);
+    }
+
+    if (t != stack_t) {
+        free(t);
+        free(s);
+    }
+}
+
+//******************************************************************************
+//  _gf8_matrix_row - Applies the matrix row to the devices in ids and stores
+//     the result in dest.  ids follow Jerasure's convention: 0..k-1 are data
+//     and k..k+m-1 are coding.  A NULL ids is the data devices in order.
+//******************************************************************************
+
+static void _gf8_matrix_row(int k, int *row, int *ids, char **data, char **coding, char *dest, int size)
+{
+    char *stack_src[GF8_STACK_SRCS];
+    char **src;
+    int i;
+
+    src = stack_src;
+    if (k > GF8_STACK_SRCS) {
+        src = (char **)malloc(sizeof(char *)*k);
+        assert(src != NULL);
+    }
+
+    for (i=0; i<k; i++) {
+        if (ids == NULL) {
+            src[i] = data[i];
+        } else {
+            src[i] = (ids[i] < k) ? data[ids[i]] : coding[ids[i]-k];
+        }
+    }
+
+    gf8_dotprod(k, row, src, dest, size);
+
+    if (src != stack_src) free(src);
+}
+
+//******************************************************************************
+//  gf8_matrix_encode - Same as jerasure_matrix_encode() with w=8
+//******************************************************************************
+
+void gf8_matrix_encode(int k, int m, int *matrix, char **data, char **coding, int size)
+{
+    int i;
+
+    for (i=0; i<m; i++) {
+        gf8_dotprod(k, &(matrix[i*k]), data, coding[i], size);
+    }
+}
+
+//******************************************************************************
+//  gf8_matrix_decode - Same as jerasure_matrix_decode() with w=8 and
+//     row_k_ones=1.  If only a single data device is lost and the first
+//     coding device is intact the missing device is recovered from the
+//     all ones row without inverting anything.
+//******************************************************************************
+
+int gf8_matrix_decode(int k, int m, int *matrix, int *erasures, char **data, char **coding, int size)
+{
+    int *erased, *decoding_matrix, *dm_ids, *ids;
+    int i, edd, lastdrive;
+
+    erased = jerasure_erasures_to_erased(k, m, erasures);
+    if (erased == NULL) return(-1);
+
+    //** Count the data drives lost
+    lastdrive = k;
+    edd = 0;
+    for (i=0; i<k; i++) {
+        if (erased[i]) {
+            edd++;
+            lastdrive = i;
+        }
+    }
+    if (erased[k]) lastdrive = k;
+
+    dm_ids = NULL;
+    decoding_matrix = NULL;
+    if ((edd > 1) || ((edd > 0) && erased[k])) {
+        dm_ids = (int *)malloc(sizeof(int)*k);
+        decoding_matrix = (int *)malloc(sizeof(int)*k*k);
+        assert((dm_ids != NULL) && (decoding_matrix != NULL));
+
+        if (jerasure_make_decoding_matrix(k, m, 8, matrix, erased, decoding_matrix, dm_ids) < 0) {
+            free(erased);
+            free(dm_ids);
+            free(decoding_matrix);
+            return(-1);
+        }
+    }
+
+    //** Decode the data drives using the inverted matrix
+    for (i=0; (edd > 0) && (i < lastdrive); i++) {
+        if (erased[i]) {
+            _gf8_matrix_row(k, &(decoding_matrix[i*k]), dm_ids, data, coding, data[i], size);
+            edd--;
+        }
+    }
+
+    //** The last one comes from the all ones row and the first coding device
+    if (edd > 0) {
+        ids = (int *)malloc(sizeof(int)*k);
+        assert(ids != NULL);
+        for (i=0; i<k; i++) ids[i] = (i < lastdrive) ? i : i+1;
+        _gf8_matrix_row(k, matrix, ids, data, coding, data[lastdrive], size);
+        free(ids);
+    }
+
+    //** And re-encode any lost coding devices
+    for (i=0; i<m; i++) {
+        if (erased[k+i]) {
+            gf8_dotprod(k, &(matrix[i*k]), data, coding[i], size);
+        }
+    }
+
+    free(erased);
+    if (dm_ids != NULL) free(dm_ids);
+    if (decoding_matrix != NULL) free(decoding_matrix);
+
+    return(0);
+}
@@ -0,0 +1,46 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef __ERASURE_GF8_H_
+#define __ERASURE_GF8_H_
+
+#include "lio/lio_visibility.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GF8_ISA_AUTO     -1
+#define GF8_ISA_JERASURE  0   //** Disables the engine and uses Jerasure's region multiply
+#define GF8_ISA_SSSE3     1
+#define GF8_ISA_AVX2      2
+#define GF8_ISA_MAX       3
+
+LIO_API int gf8_isa_supported(int isa);
+LIO_API const char *gf8_isa_name(int isa);
+LIO_API int gf8_set_isa(int isa);
+LIO_API int gf8_get_isa();
+LIO_API unsigned char gf8_multiply(unsigned char a, unsigned char b);
+LIO_API void gf8_dotprod(int n, int *coef, char **src, char *dest, int nbytes);
+void gf8_matrix_encode(int k, int m, int *matrix, char **data, char **coding, int size);
+int gf8_matrix_decode(int k, int m, int *matrix, int *erasures, char **data, char **coding, int size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -26,6 +26,7 @@
 #include <jerasure/reed_sol.h>
 #include <jerasure/jerasure.h>
 #include "raid4.h"
+#include "erasure_gf8.h"
 #include "erasure_tools.h"
 #include <tbx/log.h>
 
@@ -304,6 +305,12 @@ void schedule_encode_block(erasure_plan_t *plan, char **ptr, int block_size)
 
 void matrix_encode_block(erasure_plan_t *plan, char **ptr, int block_size)
 {
+    if ((plan->w == 8) && (gf8_get_isa() != GF8_ISA_JERASURE)) {  //** Use the vectorized GF(2^8) engine
+        gf8_matrix_encode(plan->data_strips, plan->parity_strips, plan->encode_matrix,
+                          ptr, &(ptr[plan->data_strips]), block_size);
+        return;
+    }
+
     jerasure_matrix_encode(plan->data_strips, plan->parity_strips, plan->w, plan->encode_matrix,
                            ptr, &(ptr[plan->data_strips]), block_size);
 }
@@ -436,6 +443,11 @@ int et_encode(erasure_plan_t *plan, const char *fname, long long int foffset, co
 
 int matrix_decode_block(erasure_plan_t *plan, char **ptr, int block_size, int *erasures)
 {
+    if ((plan->w == 8) && (gf8_get_isa() != GF8_ISA_JERASURE)) {
+        return(gf8_matrix_decode(plan->data_strips, plan->parity_strips, plan->encode_matrix, erasures,
+                                 ptr, &(ptr[plan->data_strips]), block_size));
+    }
+
     return(jerasure_matrix_decode(plan->data_strips, plan->parity_strips, plan->w, plan->encode_matrix, 1, erasures,
                                   ptr, &(ptr[plan->data_strips]), block_size));
 }
@@ -22,6 +22,7 @@ extern "C" {
 #endif
 
 #include <stdio.h>
+#include "lio/lio_visibility.h"
 
 extern int _debug;
 #define debug_printf(...) \
@@ -64,11 +65,11 @@ struct erasure_plan_s {    //** Contains the erasure parameters
 
 int nearest_prime(int w, int force_larger);
 int et_method_type(char *meth);
-erasure_plan_t *et_new_plan(int method, long long int strip_size,
+LIO_API erasure_plan_t *et_new_plan(int method, long long int strip_size,
                             int data_strips, int parity_strips, int w, int packet_size, int base_unit);
 erasure_plan_t *et_generate_plan(long long int file_size, int method,
                                  int data_strips, int parity_strips, int w, int packet_low, int packet_high);
-void et_destroy_plan(erasure_plan_t *plan);
+LIO_API void et_destroy_plan(erasure_plan_t *plan);
 int et_encode(erasure_plan_t *plan, const char *fname, long long int foffset, const char *pname, long long int poffset, int buffersize);
 int et_decode(erasure_plan_t *plan, long long int fsize, const char *fname, long long int foffset, const char *pname, long long int poffset, int buffersize, int *erasures);
 
@@ -47,6 +47,10 @@ extern "C" {
 #define LO_SIZE_USED 0
 #define LO_SIZE_MAX  1
 
+#define SEGMENT_COPY_DEFAULT_BUFS 4   //** Default number of buffers kept in flight by segment_copy/get/put
+#define SEGMENT_DEPOT_COPY_MAX_TRANSFER (20*1024*1024)  //** Largest single depot-depot copy
+#define SEGMENT_DEPOT_COPY_MAX_INFLIGHT 64               //** Depot-depot copies kept in flight
+
 #define INSPECT_FORCE_REPAIR          128   //** Make the repair even if it leads to data loss
 #define INSPECT_SOFT_ERROR_FAIL       256   //** Treat soft errors as hard
 #define INSPECT_FORCE_RECONSTRUCTION  512   //** Don't use depot-depot copies for data movement.  Instead use reconstruction
@@ -81,6 +85,13 @@ typedef void segment_priv_t;
 struct segment_s;
 typedef struct segment_s segment_t;
  
+typedef struct {     //** Piece of a segment stored contiguously in a single data block
+data_block_t *data;
+ex_off_t seg_offset;
+ex_off_t cap_offset;
+ex_off_t len;
+} segment_extent_t;
+ 
 typedef struct {     //** Structure for contaiing hints to the various segment drivers
 int lun_max_blacklist;  //** Max number of devs to blacklist per stripe for performance
 int number_blacklisted;
@@ -115,6 +126,7 @@ ex_off_t (*size)(segment_t *seg);
 int (*serialize)(segment_t *seg, exnode_exchange_t *exp);
 int (*deserialize)(segment_t *seg, ex_id_t id, exnode_exchange_t *exp);
 void (*destroy)(segment_t *seg);
+int (*extents)(segment_t *seg, ex_off_t lo, ex_off_t hi, tbx_stack_t *stack);  //** Optional.  Only for layouts without redundancy
 } segment_fn_t;
  
 //#define inspect_printf(fd, ...) if ((fd) != NULL) fprintf(fd, __VA_ARGS__)
@@ -134,6 +146,7 @@ void (*destroy)(segment_t *seg);
 #define segment_block_size(s) (s)->fn.block_size(s)
 #define segment_serialize(s, exp) (s)->fn.serialize(s, exp)
 #define segment_deserialize(s, id, exp) (s)->fn.deserialize(s, id, exp)
+#define segment_extents(s, lo, hi, stack) (((s)->fn.extents == NULL) ? -1 : (s)->fn.extents(s, lo, hi, stack))
 #define segment_lock(s) apr_thread_mutex_lock((s)->lock)
 #define segment_unlock(s) apr_thread_mutex_unlock((s)->lock)
  
@@ -201,9 +214,10 @@ segment_t *view_search_by_id(exnode_t *ex, ex_id_t id);
 //** Segment related functions
 #define segment_get_header(seg) &((seg)->header)
 #define segment_set_header(seg, new_head) (seg)->header = *(new_head)
-LIO_API op_generic_t *segment_copy(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, segment_t *src_seg, segment_t *dest_seg, ex_off_t src_offset, ex_off_t dest_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int do_truncate, int timoeut);
-op_generic_t *segment_put(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, FILE *fd, segment_t *dest_seg, ex_off_t dest_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int do_truncate, int timeout);
-op_generic_t *segment_get(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, segment_t *src_seg, FILE *fd, ex_off_t src_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int timeout);
+LIO_API op_generic_t *segment_copy(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, segment_t *src_seg, segment_t *dest_seg, ex_off_t src_offset, ex_off_t dest_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int n_bufs, int do_truncate, int timoeut);
+op_generic_t *segment_put(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, FILE *fd, segment_t *dest_seg, ex_off_t dest_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int n_bufs, int do_truncate, int timeout);
+op_generic_t *segment_get(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, segment_t *src_seg, FILE *fd, ex_off_t src_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int n_bufs, int timeout);
+op_generic_t *segment_depot_copy(thread_pool_context_t *tpc, data_attr_t *da, segment_t *src_seg, segment_t *dest_seg, int timeout);
 segment_t *load_segment(service_manager_t *ess, ex_id_t id, exnode_exchange_t *ex);
  
 void generate_ex_id(ex_id_t *id);
@@ -68,6 +68,8 @@ struct lio_config_s {
     data_attr_t *da;
     tbx_inip_file_t *ifd;
     tbx_list_t *open_index;
+    apr_hash_t *ex_cache;        //** Deserialized exnodes of recently closed files keyed by inode
+    tbx_stack_t *ex_cache_lru;   //** Most recently closed on top
     creds_t *creds;
     apr_thread_mutex_t *lock;
     apr_pool_t *mpool;
@@ -87,6 +89,7 @@ struct lio_config_s {
     int calc_adler32;
     int timeout;
     int max_attr;
+    int ex_cache_max;
     int anonymous_creation;
     int auto_translate;
     int ref_cnt;
@@ -105,11 +108,31 @@ typedef struct {
     local_object_iter_t *lit;
 } unified_object_iter_t;
 
+typedef struct {    //** Shared by all the copies in a lio_cp to throttle tasks and track progress
+    apr_thread_mutex_t *lock;
+    apr_thread_cond_t *cond;
+    apr_pool_t *mpool;
+    int max_tasks;         //** Max number of file copies and ranged parts in flight
+    int n_tasks;           //** Current number in flight
+    int max_parts;         //** Max number of ranged parts a single file is split into
+    int report_interval;   //** How often to print the progress in seconds.  0 disables it
+    ex_off_t part_size;    //** Files are split into parts of at least this size
+    ex_off_t bytes_done;
+    ex_off_t files_done;
+    ex_off_t last_bytes;
+    ex_off_t last_files;
+    apr_time_t start;
+    apr_time_t last_report;
+} lio_cp_sched_t;
+
 typedef struct {
     segment_rw_hints_t *rw_hints;
+    lio_cp_sched_t *sched;   //** Optional transfer scheduler
+    int sched_slot;          //** The copy holds a scheduler task slot it needs to release
     lio_path_tuple_t src_tuple;
     lio_path_tuple_t dest_tuple;
     ex_off_t bufsize;
+    int n_bufs;    //** Number of buffers kept in flight.  <= 0 uses the default
     int slow;
 } lio_cp_file_t;
 
@@ -123,7 +146,9 @@ typedef struct {
     int obj_types;
     int max_spawn;
     int slow;
+    int n_bufs;
     ex_off_t bufsize;
+    lio_cp_sched_t *sched;  //** Optional transfer scheduler
 } lio_cp_path_t;
 
 LIO_API extern lio_config_t *lio_gc;
@@ -148,6 +173,8 @@ struct lio_file_handle_s {  //** Shared file handle
     segment_t *seg;
     lio_config_t *lc;
     ex_id_t vid;
+    ex_id_t ino;
+    char *exnode;     //** Exnode text the handle was loaded from.  Only kept if the exnode cache is enabled
     int ref_count;
     int remove_on_close;
     ex_off_t readahead_end;
@@ -185,6 +212,9 @@ LIO_API os_object_iter_t *lio_create_object_iter(lio_config_t *lc, creds_t *cred
 LIO_API os_object_iter_t *lio_create_object_iter_alist(lio_config_t *lc, creds_t *creds, os_regex_table_t *path, os_regex_table_t *obj_regex, int object_types, int recurse_depth, char **key, void **val, int *v_size, int n_keys);
 LIO_API int lio_next_object(lio_config_t *lc, os_object_iter_t *it, char **fname, int *prefix_len);
 LIO_API void lio_destroy_object_iter(lio_config_t *lc, os_object_iter_t *it);
+LIO_API os_du_iter_t *lio_create_du_iter(lio_config_t *lc, creds_t *creds, os_regex_table_t *path, os_regex_table_t *obj_regex, int object_types, int recurse_depth, int rollup_depth, int flags);
+LIO_API int lio_next_du(lio_config_t *lc, os_du_iter_t *it, char **fname, int64_t *bytes, int64_t *count);
+LIO_API void lio_destroy_du_iter(lio_config_t *lc, os_du_iter_t *it);
 
 LIO_API int lio_fopen_flags(char *sflags);
 LIO_API op_generic_t *gop_lio_open_object(lio_config_t *lc, creds_t *creds, char *path, int mode, char *id, lio_fd_t **fd, int max_wait);
@@ -215,9 +245,9 @@ ex_off_t lio_size(lio_fd_t *fd);
 op_generic_t *gop_lio_truncate(lio_fd_t *fd, ex_off_t new_size);
 // NOT IMPLEMENTED op_generic_t *gop_lio_stat(lio_t *lc, const char *fname, struct stat *stat);
 
-LIO_API op_generic_t *gop_lio_cp_local2lio(FILE *sfd, lio_fd_t *dfd, ex_off_t bufsize, char *buffer, segment_rw_hints_t *rw_hints);
-LIO_API op_generic_t *gop_lio_cp_lio2local(lio_fd_t *sfd, FILE *dfd, ex_off_t bufsize, char *buffer, segment_rw_hints_t *rw_hints);
-op_generic_t *gop_lio_cp_lio2lio(lio_fd_t *sfd, lio_fd_t *dfd, ex_off_t bufsize, char *buffer, int hints, segment_rw_hints_t *rw_hints);
+LIO_API op_generic_t *gop_lio_cp_local2lio(FILE *sfd, lio_fd_t *dfd, ex_off_t bufsize, char *buffer, int n_bufs, segment_rw_hints_t *rw_hints);
+LIO_API op_generic_t *gop_lio_cp_lio2local(lio_fd_t *sfd, FILE *dfd, ex_off_t bufsize, char *buffer, int n_bufs, segment_rw_hints_t *rw_hints);
+op_generic_t *gop_lio_cp_lio2lio(lio_fd_t *sfd, lio_fd_t *dfd, ex_off_t bufsize, char *buffer, int n_bufs, int hints, segment_rw_hints_t *rw_hints);
 
 //op_generic_t *gop_lio_symlink_attr(lio_config_t *lc, creds_t *creds, char *src_path, char *key_src, const char *path_dest, char *key_dest);
 //op_generic_t *gop_lio_symlink_multiple_attrs(lio_config_t *lc, creds_t *creds, char **src_path, char **key_src, const char *path_dest, char **key_dest, int n);
@@ -243,6 +273,7 @@ LIO_API int lio_encode_error_counts(segment_errors_t *serr, char **key, char **v
 LIO_API void lio_get_error_counts(lio_config_t *lc, segment_t *seg, segment_errors_t *serr);
 int lio_update_error_counts(lio_config_t *lc, creds_t *creds, char *path, segment_t *seg, int mode);
 int lio_update_exnode_attrs(lio_config_t *lc, creds_t *creds, exnode_t *ex, segment_t *seg, char *fname, segment_errors_t *serr);
+void lio_ex_cache_destroy(lio_config_t *lc);
 
 LIO_API int lio_next_fsck(lio_config_t *lc, lio_fsck_iter_t *oit, char **bad_fname, int *bad_atype);
 LIO_API lio_fsck_iter_t *lio_create_fsck_iter(lio_config_t *lc, creds_t *creds, char *path, int owner_mode, char *owner, int exnode_mode);
@@ -276,6 +307,13 @@ op_status_t cp_lio2lio(lio_cp_file_t *cp);
 op_status_t cp_local2lio(lio_cp_file_t *cp);
 op_status_t cp_lio2local(lio_cp_file_t *cp);
 LIO_API op_status_t lio_cp_file_fn(void *arg, int id);
+LIO_API lio_cp_sched_t *lio_cp_sched_create(int max_tasks, ex_off_t part_size, int max_parts, int report_interval);
+LIO_API void lio_cp_sched_destroy(lio_cp_sched_t *s);
+LIO_API void lio_cp_sched_acquire(lio_cp_sched_t *s);
+LIO_API int lio_cp_sched_acquire_extra(lio_cp_sched_t *s, int n);
+LIO_API void lio_cp_sched_release(lio_cp_sched_t *s, int n);
+LIO_API void lio_cp_sched_progress(lio_cp_sched_t *s, ex_off_t nbytes, int nfiles);
+LIO_API void lio_cp_sched_report(lio_cp_sched_t *s);
 int lio_cp_create_dir(tbx_list_t *table, lio_path_tuple_t tuple);
 LIO_API op_status_t lio_cp_path_fn(void *arg, int id);
 LIO_API op_generic_t *lioc_truncate(lio_path_tuple_t *tuple, ex_off_t new_size);
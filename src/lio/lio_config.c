@@ -732,6 +732,9 @@ void lio_destroy_nl(lio_config_t *lio)
 
     log_printf(15, "removing lio=%s\n", lio->section_name);
 
+    //** The cached exnodes need the services so they go 1st
+    lio_ex_cache_destroy(lio);
+
     if (_lc_object_destroy(lio->rs_section) <= 0) {
         rs_destroy_service(lio->rs);
     }
@@ -854,6 +857,7 @@ lio_config_t *lio_create_nl(char *fname, char *section, char *user, char *exe_na
     lio->timeout = tbx_inip_get_integer(lio->ifd, section, "timeout", 120);
     lio->max_attr = tbx_inip_get_integer(lio->ifd, section, "max_attr_size", 10*1024*1024);
     lio->calc_adler32 = tbx_inip_get_integer(lio->ifd, section, "calc_adler32", 0);
+    lio->ex_cache_max = tbx_inip_get_integer(lio->ifd, section, "exnode_cache_size", 64);
     lio->readahead = tbx_inip_get_integer(lio->ifd, section, "readahead", 0);
     lio->readahead_trigger = lio->readahead * tbx_inip_get_double(lio->ifd, section, "readahead_trigger", 1.0);
 
@@ -870,6 +874,14 @@ lio_config_t *lio_create_nl(char *fname, char *section, char *user, char *exe_na
     *val = tbx_inip_get_integer(lio->ifd, section, "jerase_paranoid", 0);
     add_service(lio->ess, ESS_RUNNING, "jerase_paranoid", val);
 
+    //** and how Jerase writes are split up for encoding
+    tbx_type_malloc(val, int, 1);  //** NOTE: this is not freed on a destroy
+    *val = tbx_inip_get_integer(lio->ifd, section, "jerase_encode_batch", 4*1024*1024);
+    add_service(lio->ess, ESS_RUNNING, "jerase_encode_batch", val);
+    tbx_type_malloc(val, int, 1);  //** NOTE: this is not freed on a destroy
+    *val = tbx_inip_get_integer(lio->ifd, section, "jerase_encode_threads", 4);
+    add_service(lio->ess, ESS_RUNNING, "jerase_encode_threads", val);
+
     cores = tbx_inip_get_integer(lio->ifd, section, "tpc_unlimited", 200);
     max_recursion = tbx_inip_get_integer(lio->ifd, section, "tpc_max_recursion", 10);
     sprintf(buffer, "tpc:%d", cores);
@@ -1048,6 +1060,10 @@ lio_config_t *lio_create_nl(char *fname, char *section, char *user, char *exe_na
     assert_result(apr_pool_create(&(lio->mpool), NULL), APR_SUCCESS);
     apr_thread_mutex_create(&(lio->lock), APR_THREAD_MUTEX_DEFAULT, lio->mpool);
 
+    //** Deserialized exnodes from recently closed files
+    lio->ex_cache = apr_hash_make(lio->mpool);
+    lio->ex_cache_lru = tbx_stack_new();
+
     return(lio);
 }
 
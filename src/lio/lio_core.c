@@ -188,30 +188,14 @@ void lio_get_timestamp(char *val, int *timestamp, char **id)
 
 int lioc_get_multiple_attrs(lio_config_t *lc, creds_t *creds, char *path, char *id, char **key, void **val, int *v_size, int n_keys)
 {
-    int err, serr;
-    os_fd_t *fd;
-
-    err = gop_sync_exec(os_open_object(lc->os, creds, path, OS_MODE_READ_IMMEDIATE, id, &fd, lc->timeout));
-    if (err != OP_STATE_SUCCESS) {
-        log_printf(1, "ERROR opening object=%s\n", path);
-        return(err);
-    }
-
-    //** IF the attribute doesn't exist *val == NULL an *v_size = 0
-    serr = gop_sync_exec(os_get_multiple_attrs(lc->os, creds, fd, key, val, v_size, n_keys));
-
-    //** Close the parent
-    err = gop_sync_exec(os_close_object(lc->os, fd));
-    if (err != OP_STATE_SUCCESS) {
-        log_printf(1, "ERROR closing object=%s\n", path);
-    }
+    op_status_t status;
 
-    if (serr != OP_STATE_SUCCESS) {
+    status = os_path_get_multiple_attrs(lc->os, creds, path, id, key, val, v_size, n_keys, lc->timeout);
+    if (status.op_status != OP_STATE_SUCCESS) {
         log_printf(1, "ERROR getting attributes object=%s\n", path);
-        err = OP_STATE_FAILURE;
     }
 
-    return(err);
+    return(status.op_status);
 }
 
 //***********************************************************************
@@ -220,30 +204,15 @@ int lioc_get_multiple_attrs(lio_config_t *lc, creds_t *creds, char *path, char *
 
 int lioc_get_attr(lio_config_t *lc, creds_t *creds, char *path, char *id, char *key, void **val, int *v_size)
 {
-    int err, serr;
-    os_fd_t *fd;
-
-    err = gop_sync_exec(os_open_object(lc->os, creds, path, OS_MODE_READ_IMMEDIATE, id, &fd, lc->timeout));
-    if (err != OP_STATE_SUCCESS) {
-        log_printf(1, "ERROR opening object=%s\n", path);
-        return(err);
-    }
+    op_status_t status;
 
     //** IF the attribute doesn't exist *val == NULL an *v_size = 0
-    serr = gop_sync_exec(os_get_attr(lc->os, creds, fd, key, val, v_size));
-
-    //** Close the parent
-    err = gop_sync_exec(os_close_object(lc->os, fd));
-    if (err != OP_STATE_SUCCESS) {
-        log_printf(1, "ERROR closing object=%s\n", path);
-    }
-
-    if (serr != OP_STATE_SUCCESS) {
+    status = os_path_get_multiple_attrs(lc->os, creds, path, id, &key, val, v_size, 1, lc->timeout);
+    if (status.op_status != OP_STATE_SUCCESS) {
         log_printf(1, "ERROR getting attribute object=%s\n", path);
-        err = OP_STATE_FAILURE;
     }
 
-    return(err);
+    return(status.op_status);
 }
 
 //***********************************************************************
@@ -1164,9 +1133,20 @@ op_status_t cp_lio2lio(lio_cp_file_t *cp)
         gop = segment_clone(sseg, cp->dest_tuple.lc->da, &dseg, CLONE_STRUCT_AND_DATA, NULL, cp->dest_tuple.lc->timeout);
         log_printf(5, "src=%s  clone gid=%d\n", cp->src_tuple.path, gop_id(gop));
     } else {
-        info_printf(lio_ifd, 1, "Slow copy:( %s->%s\n", cp->src_tuple.path, cp->dest_tuple.path);
-        tbx_type_malloc(buffer, char, cp->bufsize+1);
-        gop = segment_copy(cp->dest_tuple.lc->tpc_unlimited, cp->dest_tuple.lc->da, cp->rw_hints, sseg, dseg, 0, 0, -1, cp->bufsize, buffer, 1, cp->dest_tuple.lc->timeout);
+        //** Layouts differ so try mapping the blocks onto each other and copying depot-depot
+        err = OP_STATE_FAILURE;
+        if (cp->slow == 0) {
+            info_printf(lio_ifd, 1, "Depot copy %s->%s\n", cp->src_tuple.path, cp->dest_tuple.path);
+            err = gop_sync_exec(segment_depot_copy(cp->dest_tuple.lc->tpc_unlimited, cp->dest_tuple.lc->da, sseg, dseg, cp->dest_tuple.lc->timeout));
+        }
+
+        if (err == OP_STATE_SUCCESS) {
+            gop = gop_dummy(op_success_status);
+        } else {
+            info_printf(lio_ifd, 1, "Slow copy:( %s->%s\n", cp->src_tuple.path, cp->dest_tuple.path);
+            tbx_type_malloc(buffer, char, cp->bufsize+1);
+            gop = segment_copy(cp->dest_tuple.lc->tpc_unlimited, cp->dest_tuple.lc->da, cp->rw_hints, sseg, dseg, 0, 0, -1, cp->bufsize, buffer, cp->n_bufs, 1, cp->dest_tuple.lc->timeout);
+        }
     }
     err = gop_waitall(gop);
 
@@ -1286,7 +1266,7 @@ op_status_t cp_local2lio(lio_cp_file_t *cp)
     tbx_type_malloc(buffer, char, cp->bufsize+1);
 
     log_printf(0, "BEFORE PUT\n");
-    err = gop_sync_exec(segment_put(cp->dest_tuple.lc->tpc_unlimited, cp->dest_tuple.lc->da, cp->rw_hints, fd, seg, 0, -1, cp->bufsize, buffer, 1, 3600));
+    err = gop_sync_exec(segment_put(cp->dest_tuple.lc->tpc_unlimited, cp->dest_tuple.lc->da, cp->rw_hints, fd, seg, 0, -1, cp->bufsize, buffer, cp->n_bufs, 1, 3600));
     log_printf(0, "AFTER PUT\n");
 
     fclose(fd);
@@ -1379,7 +1359,7 @@ op_status_t cp_lio2local(lio_cp_file_t *cp)
     }
 
     tbx_type_malloc(buffer, char, cp->bufsize+1);
-    gop_sync_exec(segment_get(cp->src_tuple.lc->tpc_unlimited, cp->src_tuple.lc->da, cp->rw_hints, seg, fd, 0, -1, cp->bufsize, buffer, 3600));
+    gop_sync_exec(segment_get(cp->src_tuple.lc->tpc_unlimited, cp->src_tuple.lc->da, cp->rw_hints, seg, fd, 0, -1, cp->bufsize, buffer, cp->n_bufs, 3600));
     free(buffer);
 
     fclose(fd);
@@ -343,6 +343,125 @@ void _lio_remove_file_handle(lio_config_t *lc, lio_file_handle_t *fh)
     tbx_list_remove(lc->open_index, (tbx_list_key_t *)&(fh->vid), (tbx_list_data_t *)fh);
 }
 
+//***********************************************************************
+// Exnode cache - Keeps the deserialized exnodes of recently closed files
+//    that weren't modified.  Entries are keyed by inode and the exnode text
+//    they were loaded from is used as the version.  Reopening an unchanged
+//    file reuses the exnode and skips parsing altogether.  The cached data
+//    pages are dropped on close so only the layout is reused.
+//***********************************************************************
+
+typedef struct {
+    ex_id_t ino;
+    ex_id_t vid;
+    char *exnode;
+    exnode_t *ex;
+    segment_t *seg;
+    tbx_stack_ele_t *ele;
+} lio_ex_cache_entry_t;
+
+//***********************************************************************
+// _lio_ex_cache_remove - Removes the entry from the cache and returns it.
+//  ****NOTE: assumes that lio_lock(lfs) has been called ****
+//***********************************************************************
+
+lio_ex_cache_entry_t *_lio_ex_cache_remove(lio_config_t *lc, lio_ex_cache_entry_t *ce)
+{
+    apr_hash_set(lc->ex_cache, &(ce->ino), sizeof(ex_id_t), NULL);
+    tbx_stack_move_to_ptr(lc->ex_cache_lru, ce->ele);
+    tbx_stack_delete_current(lc->ex_cache_lru, 0, 0);
+
+    return(ce);
+}
+
+//***********************************************************************
+// _lio_ex_cache_entry_destroy - Destroys a cache entry and it's exnode
+//***********************************************************************
+
+void _lio_ex_cache_entry_destroy(lio_ex_cache_entry_t *ce)
+{
+    exnode_destroy(ce->ex);
+    free(ce->exnode);
+    free(ce);
+}
+
+//***********************************************************************
+// _lio_ex_cache_get - Returns the cached exnode for the inode if it was
+//    loaded from the same text.  The entry is removed from the cache and
+//    the caller takes ownership.  Stale entries are destroyed.
+//  ****NOTE: assumes that lio_lock(lfs) has been called ****
+//***********************************************************************
+
+lio_ex_cache_entry_t *_lio_ex_cache_get(lio_config_t *lc, ex_id_t ino, char *exnode)
+{
+    lio_ex_cache_entry_t *ce;
+
+    ce = apr_hash_get(lc->ex_cache, &ino, sizeof(ex_id_t));
+    if (ce == NULL) return(NULL);
+
+    _lio_ex_cache_remove(lc, ce);
+    if (strcmp(ce->exnode, exnode) != 0) {  //** The exnode has changed
+        log_printf(5, "STALE ino=" XIDT "\n", ino);
+        _lio_ex_cache_entry_destroy(ce);
+        return(NULL);
+    }
+
+    return(ce);
+}
+
+//***********************************************************************
+// _lio_ex_cache_put - Adds the file handle's exnode to the cache.  Returns
+//    0 if the cache took it and 1 if the caller should destroy it.
+//  ****NOTE: assumes that lio_lock(lfs) has been called ****
+//***********************************************************************
+
+int _lio_ex_cache_put(lio_config_t *lc, lio_file_handle_t *fh)
+{
+    lio_ex_cache_entry_t *ce;
+
+    if ((lc->ex_cache_max <= 0) || (fh->exnode == NULL)) return(1);
+
+    //** Drop any older version
+    ce = apr_hash_get(lc->ex_cache, &(fh->ino), sizeof(ex_id_t));
+    if (ce != NULL) _lio_ex_cache_entry_destroy(_lio_ex_cache_remove(lc, ce));
+
+    //** Make room if needed
+    while (tbx_stack_count(lc->ex_cache_lru) >= lc->ex_cache_max) {
+        tbx_stack_move_to_bottom(lc->ex_cache_lru);
+        ce = tbx_stack_get_current_data(lc->ex_cache_lru);
+        _lio_ex_cache_entry_destroy(_lio_ex_cache_remove(lc, ce));
+    }
+
+    tbx_type_malloc(ce, lio_ex_cache_entry_t, 1);
+    ce->ino = fh->ino;
+    ce->vid = fh->vid;
+    ce->exnode = fh->exnode;
+    ce->ex = fh->ex;
+    ce->seg = fh->seg;
+    fh->exnode = NULL;
+
+    tbx_stack_push(lc->ex_cache_lru, ce);
+    ce->ele = tbx_stack_get_top(lc->ex_cache_lru);
+    apr_hash_set(lc->ex_cache, &(ce->ino), sizeof(ex_id_t), ce);
+
+    return(0);
+}
+
+//***********************************************************************
+// lio_ex_cache_destroy - Destroys all the cached exnodes
+//***********************************************************************
+
+void lio_ex_cache_destroy(lio_config_t *lc)
+{
+    lio_ex_cache_entry_t *ce;
+
+    while ((ce = tbx_stack_pop(lc->ex_cache_lru)) != NULL) {
+        _lio_ex_cache_entry_destroy(ce);
+    }
+
+    tbx_stack_free(lc->ex_cache_lru, 0);
+}
+
 //*************************************************************************
 // gop_lio_open_object - Attempt to open the object for R/W
 //*************************************************************************
@@ -368,6 +487,8 @@ op_status_t lio_myopen_fn(void *arg, int id)
     char *exnode;
     ex_id_t ino, vid;
     exnode_exchange_t *exp;
+    lio_ex_cache_entry_t *ce;
+    char *exnode_copy = NULL;
     op_status_t status;
     int dtype, err;
 
@@ -417,7 +538,38 @@ op_status_t lio_myopen_fn(void *arg, int id)
         return(op_failure_status);
     }
 
+    //** See if we still have the exnode from a previous open
+    lio_lock(lc);
+    ce = _lio_ex_cache_get(lc, ino, exnode);
+    if (ce != NULL) {
+        log_printf(2, "EXNODE_CACHE_HIT fname=%s ino=" XIDT "\n", op->path, ino);
+        free(exnode);
+        fh = _lio_get_file_handle(lc, ce->vid);
+        if (fh != NULL) {  //** Someone else loaded it while it was cached so use theirs
+            fh->ref_count++;
+            fd->fh = fh;
+            lio_unlock(lc);
+            *op->fd = fd;
+            _lio_ex_cache_entry_destroy(ce);
+            return(op_success_status);
+        }
+
+        tbx_type_malloc_clear(fh, lio_file_handle_t, 1);
+        fh->vid = ce->vid;
+        fh->ino = ino;
+        fh->exnode = ce->exnode;
+        fh->ex = ce->ex;
+        fh->seg = ce->seg;
+        fh->ref_count++;
+        fh->lc = lc;
+        free(ce);
+        exp = NULL;
+        goto opened;
+    }
+    lio_unlock(lc);
+
     //** Load the exnode and get the default view ID
+    if (lc->ex_cache_max > 0) exnode_copy = strdup(exnode);
     exp = exnode_exchange_text_parse(exnode);
     vid = exnode_exchange_get_default_view_id(exp);
     if (vid == 0) {  //** Make sure the vid is valid.
@@ -426,6 +578,7 @@ op_status_t lio_myopen_fn(void *arg, int id)
         *op->fd = NULL;
         free(op->path);
         exnode_exchange_destroy(exp);
+        if (exnode_copy) free(exnode_copy);
         return(op_failure_status);
     }
 
@@ -439,12 +592,15 @@ op_status_t lio_myopen_fn(void *arg, int id)
         lio_unlock(lc);
         *op->fd = fd;
         exnode_exchange_destroy(exp);
+        if (exnode_copy) free(exnode_copy);
         return(op_success_status);
     }
 
     //** New file to open
     tbx_type_malloc_clear(fh, lio_file_handle_t, 1);
     fh->vid = vid;
+    fh->ino = ino;
+    fh->exnode = exnode_copy;
     fh->ref_count++;
     fh->lc = lc;
 
@@ -464,6 +620,7 @@ op_status_t lio_myopen_fn(void *arg, int id)
         goto cleanup;
     }
 
+opened:
     if (lc->calc_adler32) fh->write_table = tbx_list_create(0, &skiplist_compare_ex_off, NULL, NULL, NULL);
 
     //Add it to the file open table
@@ -486,7 +643,7 @@ op_status_t lio_myopen_fn(void *arg, int id)
         }
     }
 
-    exnode_exchange_destroy(exp);  //** Clean up
+    if (exp) exnode_exchange_destroy(exp);  //** Clean up
 
     return(status);
 
@@ -494,7 +651,8 @@ cleanup:  //** We only make it here on a failure
     log_printf(1, "ERROR in cleanup! fname=%s\n", op->path);
 
     exnode_destroy(fh->ex);
-    exnode_exchange_destroy(exp);
+    if (exp) exnode_exchange_destroy(exp);
+    if (fh->exnode) free(fh->exnode);
     free(fd->path);
     free(fh);
     free(fd);
@@ -597,6 +755,13 @@ op_status_t lio_myclose_fn(void *arg, int id)
             }
         }
 
+        //** If the exnode is going to be cached drop the pages backing it.  Another
+        //** client can overwrite the data in place without changing the exnode so
+        //** the next open has to go back to the depot.  Everything was flushed above.
+        if ((lc->ex_cache_max > 0) && (fh->remove_on_close == 0) && (serr.hard == 0) && (serr.soft == 0) && (serr.write == 0)) {
+            cache_drop_pages(fh->seg, 0, segment_size(fh->seg)+1);
+        }
+
         //** Check again that no one else has opened the file
         lio_lock(lc);
         if (fh->ref_count > 0) {  //** Somebody else opened it while we were flushing buffers
@@ -606,10 +771,13 @@ op_status_t lio_myclose_fn(void *arg, int id)
             return(status);
         }
 
-        //** Tear everything down
-        exnode_destroy(fh->ex);
+        //** Tear everything down.  Clean exnodes are kept around for the next open
         _lio_remove_file_handle(lc, fh);
+        if ((fh->remove_on_close == 1) || (serr.hard > 0) || (serr.soft > 0) || (serr.write > 0) || (_lio_ex_cache_put(lc, fh) != 0)) {
+            exnode_destroy(fh->ex);
+        }
         lio_unlock(lc);
+        if (fh->exnode != NULL) free(fh->exnode);
 
         if (fh->write_table != NULL) lio_store_and_release_adler32(lc, fd->creds, fh->write_table, fd->path);
         if (fh->remove_on_close == 1) status = gop_sync_exec_status(gop_lio_remove_object(lc, fd->creds, fd->path, NULL, lio_exists(lc, fd->creds, fd->path)));
@@ -655,6 +823,7 @@ op_status_t lio_myclose_fn(void *arg, int id)
     _lio_remove_file_handle(lc, fh);
 
     lio_unlock(lc);
+    if (fh->exnode != NULL) free(fh->exnode);
 
     dt = apr_time_now() - now;
     dt /= APR_USEC_PER_SEC;
@@ -1180,6 +1349,7 @@ typedef struct {
     lio_fd_t *slfd, *dlfd;
     ex_off_t bufsize;
     char *buffer;
+    int n_bufs;
     int hints;
     segment_rw_hints_t *rw_hints;
 } lio_cp_fn_t;
@@ -1204,7 +1374,7 @@ op_status_t lio_cp_local2lio_fn(void *arg, int id)
         tbx_type_malloc(buffer, char, bufsize+1);
     }
 
-    status = gop_sync_exec_status(segment_put(lfh->lc->tpc_unlimited, lfh->lc->da, op->rw_hints, ffd, lfh->seg, 0, -1, bufsize, buffer, 1, 3600));
+    status = gop_sync_exec_status(segment_put(lfh->lc->tpc_unlimited, lfh->lc->da, op->rw_hints, ffd, lfh->seg, 0, -1, bufsize, buffer, op->n_bufs, 1, 3600));
     lfh->modified = 1; //** Flag it as modified so the new exnode gets stored
 
     //** Clean up
@@ -1215,7 +1385,7 @@ op_status_t lio_cp_local2lio_fn(void *arg, int id)
 
 //***********************************************************************
 
-op_generic_t *gop_lio_cp_local2lio(FILE *sfd, lio_fd_t *dfd, ex_off_t bufsize, char *buffer, segment_rw_hints_t *rw_hints)
+op_generic_t *gop_lio_cp_local2lio(FILE *sfd, lio_fd_t *dfd, ex_off_t bufsize, char *buffer, int n_bufs, segment_rw_hints_t *rw_hints)
 {
     lio_cp_fn_t *op;
 
@@ -1223,6 +1393,7 @@ op_generic_t *gop_lio_cp_local2lio(FILE *sfd, lio_fd_t *dfd, ex_off_t bufsize, c
 
     op->buffer = buffer;
     op->bufsize = bufsize;
+    op->n_bufs = n_bufs;
     op->sffd = sfd;
     op->dlfd = dfd;
     op->rw_hints = rw_hints;
@@ -1251,7 +1422,7 @@ op_status_t lio_cp_lio2local_fn(void *arg, int id)
         tbx_type_malloc(buffer, char, bufsize+1);
     }
 
-    status = gop_sync_exec_status(segment_get(lfh->lc->tpc_unlimited, lfh->lc->da, op->rw_hints, lfh->seg, ffd, 0, -1, bufsize, buffer, 3600));
+    status = gop_sync_exec_status(segment_get(lfh->lc->tpc_unlimited, lfh->lc->da, op->rw_hints, lfh->seg, ffd, 0, -1, bufsize, buffer, op->n_bufs, 3600));
 
     //** Clean up
     if (op->buffer == NULL) free(buffer);
@@ -1261,7 +1432,7 @@ op_status_t lio_cp_lio2local_fn(void *arg, int id)
 
 //***********************************************************************
 
-op_generic_t *gop_lio_cp_lio2local(lio_fd_t *sfd, FILE *dfd, ex_off_t bufsize, char *buffer, segment_rw_hints_t *rw_hints)
+op_generic_t *gop_lio_cp_lio2local(lio_fd_t *sfd, FILE *dfd, ex_off_t bufsize, char *buffer, int n_bufs, segment_rw_hints_t *rw_hints)
 {
     lio_cp_fn_t *op;
 
@@ -1269,6 +1440,7 @@ op_generic_t *gop_lio_cp_lio2local(lio_fd_t *sfd, FILE *dfd, ex_off_t bufsize, c
 
     op->buffer = buffer;
     op->bufsize = bufsize;
+    op->n_bufs = n_bufs;
     op->slfd = sfd;
     op->dffd = dfd;
     op->rw_hints = rw_hints;
@@ -1303,18 +1475,26 @@ op_status_t lio_cp_lio2lio_fn(void *arg, int id)
     if ((strcmp(sig1, sig2) == 0) && ((op->hints & LIO_COPY_INDIRECT) == 0)) {
         status = gop_sync_exec_status(segment_clone(sfh->seg, dfh->lc->da, &(dfh->seg), CLONE_STRUCT_AND_DATA, NULL, dfh->lc->timeout));
     } else {
+        //** Layouts differ so try a depot-depot copy before sending the data through us
+        status = op_failure_status;
+        if ((op->hints & LIO_COPY_INDIRECT) == 0) {
+            status = gop_sync_exec_status(segment_depot_copy(dfh->lc->tpc_unlimited, dfh->lc->da, sfh->seg, dfh->seg, dfh->lc->timeout));
+        }
+        if (status.op_status == OP_STATE_SUCCESS) goto finished;
+
         buffer = op->buffer;
         bufsize = (op->bufsize <= 0) ? LIO_COPY_BUFSIZE-1 : op->bufsize-1;
 
         if (buffer == NULL) { //** Need to make it ourself
             tbx_type_malloc(buffer, char, bufsize+1);
         }
-        status = gop_sync_exec_status(segment_copy(dfh->lc->tpc_unlimited, dfh->lc->da, op->rw_hints, sfh->seg, dfh->seg, 0, 0, -1, bufsize, buffer, 1, dfh->lc->timeout));
+        status = gop_sync_exec_status(segment_copy(dfh->lc->tpc_unlimited, dfh->lc->da, op->rw_hints, sfh->seg, dfh->seg, 0, 0, -1, bufsize, buffer, op->n_bufs, 1, dfh->lc->timeout));
 
         //** Clean up
         if (op->buffer == NULL) free(buffer);
     }
 
+finished:
     dfh->modified = 1; //** Flag it as modified so the new exnode gets stored
 
     return(status);
@@ -1322,7 +1502,7 @@ op_status_t lio_cp_lio2lio_fn(void *arg, int id)
 
 //***********************************************************************
 
-op_generic_t *gop_lio_cp_lio2lio(lio_fd_t *sfd, lio_fd_t *dfd, ex_off_t bufsize, char *buffer, int hints, segment_rw_hints_t *rw_hints)
+op_generic_t *gop_lio_cp_lio2lio(lio_fd_t *sfd, lio_fd_t *dfd, ex_off_t bufsize, char *buffer, int n_bufs, int hints, segment_rw_hints_t *rw_hints)
 {
     lio_cp_fn_t *op;
 
@@ -1330,6 +1510,7 @@ op_generic_t *gop_lio_cp_lio2lio(lio_fd_t *sfd, lio_fd_t *dfd, ex_off_t bufsize,
 
     op->buffer = buffer;
     op->bufsize = bufsize;
+    op->n_bufs = n_bufs;
     op->slfd = sfd;
     op->dlfd = dfd;
     op->hints = hints;
@@ -1338,6 +1519,240 @@ op_generic_t *gop_lio_cp_lio2lio(lio_fd_t *sfd, lio_fd_t *dfd, ex_off_t bufsize,
     return(new_thread_pool_op(dfd->lc->tpc_unlimited, NULL, lio_cp_lio2lio_fn, (void *)op, free, 1));
 }
 
+//*************************************************************************
+//  lio_cp transfer scheduler.  All the file copies and the ranged parts of
+//  large files share a single pool of task slots so lots of small files
+//  overlap while a huge file can still fan out over the idle slots.
+//*************************************************************************
+
+#define LIO_COPY_MIN_PART_BUFSIZE (4*1024*1024)
+
+//*************************************************************************
+// lio_cp_sched_create - Creates a new transfer scheduler
+//*************************************************************************
+
+lio_cp_sched_t *lio_cp_sched_create(int max_tasks, ex_off_t part_size, int max_parts, int report_interval)
+{
+    lio_cp_sched_t *s;
+
+    tbx_type_malloc_clear(s, lio_cp_sched_t, 1);
+    apr_pool_create(&(s->mpool), NULL);
+    apr_thread_mutex_create(&(s->lock), APR_THREAD_MUTEX_DEFAULT, s->mpool);
+    apr_thread_cond_create(&(s->cond), s->mpool);
+
+    s->max_tasks = (max_tasks > 0) ? max_tasks : 1;
+    s->part_size = part_size;
+    s->max_parts = (max_parts > 0) ? max_parts : 1;
+    s->report_interval = report_interval;
+    s->start = apr_time_now();
+    s->last_report = s->start;
+
+    return(s);
+}
+
+//*************************************************************************
+// lio_cp_sched_destroy - Destroys the scheduler
+//*************************************************************************
+
+void lio_cp_sched_destroy(lio_cp_sched_t *s)
+{
+    apr_thread_mutex_destroy(s->lock);
+    apr_thread_cond_destroy(s->cond);
+    apr_pool_destroy(s->mpool);
+    free(s);
+}
+
+//*************************************************************************
+// lio_cp_sched_acquire - Blocks until a task slot is free and takes it
+//*************************************************************************
+
+void lio_cp_sched_acquire(lio_cp_sched_t *s)
+{
+    apr_thread_mutex_lock(s->lock);
+    while (s->n_tasks >= s->max_tasks) {
+        apr_thread_cond_wait(s->cond, s->lock);
+    }
+    s->n_tasks++;
+    apr_thread_mutex_unlock(s->lock);
+}
+
+//*************************************************************************
+// lio_cp_sched_acquire_extra - Takes up to n of the currently free slots
+//     without blocking and returns how many were taken
+//*************************************************************************
+
+int lio_cp_sched_acquire_extra(lio_cp_sched_t *s, int n)
+{
+    int got;
+
+    apr_thread_mutex_lock(s->lock);
+    got = s->max_tasks - s->n_tasks;
+    if (got > n) got = n;
+    if (got < 0) got = 0;
+    s->n_tasks += got;
+    apr_thread_mutex_unlock(s->lock);
+
+    return(got);
+}
+
+//*************************************************************************
+// lio_cp_sched_release - Returns n task slots
+//*************************************************************************
+
+void lio_cp_sched_release(lio_cp_sched_t *s, int n)
+{
+    if (n <= 0) return;
+
+    apr_thread_mutex_lock(s->lock);
+    s->n_tasks -= n;
+    apr_thread_cond_broadcast(s->cond);
+    apr_thread_mutex_unlock(s->lock);
+}
+
+//*************************************************************************
+// lio_cp_sched_progress - Adds the completed bytes and files and prints
+//     the rates since the last report if the interval has passed
+//*************************************************************************
+
+void lio_cp_sched_progress(lio_cp_sched_t *s, ex_off_t nbytes, int nfiles)
+{
+    apr_time_t now;
+    double dt, mbs, fps;
+    ex_off_t bytes, files;
+
+    apr_thread_mutex_lock(s->lock);
+    s->bytes_done += nbytes;
+    s->files_done += nfiles;
+
+    if (s->report_interval <= 0) {
+        apr_thread_mutex_unlock(s->lock);
+        return;
+    }
+
+    now = apr_time_now();
+    if ((now - s->last_report) < apr_time_from_sec(s->report_interval)) {
+        apr_thread_mutex_unlock(s->lock);
+        return;
+    }
+
+    dt = (double)(now - s->last_report) / APR_USEC_PER_SEC;
+    mbs = (double)(s->bytes_done - s->last_bytes) / dt / (1024.0*1024.0);
+    fps = (double)(s->files_done - s->last_files) / dt;
+    bytes = s->bytes_done;
+    files = s->files_done;
+    s->last_report = now;
+    s->last_bytes = bytes;
+    s->last_files = files;
+    apr_thread_mutex_unlock(s->lock);
+
+    info_printf(lio_ifd, 0, "progress: files=" XOT " bytes=" XOT " rate=%.1f MB/s files=%.1f/s\n", files, bytes, mbs, fps);
+}
+
+//*************************************************************************
+// lio_cp_sched_report - Prints the overall average rates
+//*************************************************************************
+
+void lio_cp_sched_report(lio_cp_sched_t *s)
+{
+    double dt;
+
+    apr_thread_mutex_lock(s->lock);
+    dt = (double)(apr_time_now() - s->start) / APR_USEC_PER_SEC;
+    if (dt <= 0) dt = 1e-6;
+    info_printf(lio_ifd, 0, "total: files=" XOT " bytes=" XOT " time=%.1fs rate=%.1f MB/s files=%.1f/s\n", s->files_done, s->bytes_done,
+                dt, (double)s->bytes_done / dt / (1024.0*1024.0), (double)s->files_done / dt);
+    apr_thread_mutex_unlock(s->lock);
+}
+
+//*************************************************************************
+// _lio_cp_file_parts - Returns how many ranged parts the file should be
+//     split into.  The extra part slots are taken from the scheduler.
+//*************************************************************************
+
+int _lio_cp_file_parts(lio_cp_file_t *cp, ex_off_t size)
+{
+    ex_off_t want;
+
+    if ((cp->sched == NULL) || (cp->sched->part_size <= 0)) return(1);
+
+    want = size / cp->sched->part_size;
+    if (want > cp->sched->max_parts) want = cp->sched->max_parts;
+    if (want <= 1) return(1);
+
+    return(1 + lio_cp_sched_acquire_extra(cp->sched, want-1));
+}
+
+//*************************************************************************
+// _lio_cp_parts - Copies the file as n concurrent ranged parts.  Each part
+//     has it's own local FILE and buffer.  The destination should already
+//     be sized.
+//*************************************************************************
+
+op_status_t _lio_cp_parts(lio_cp_file_t *cp, lio_file_handle_t *lfh, char *local_path, int to_local, ex_off_t size, int n)
+{
+    FILE **fd;
+    char **buffer;
+    ex_off_t psize, off, len, bufsize;
+    opque_t *q;
+    op_generic_t *gop;
+    op_status_t status;
+    int i, nerr;
+
+    bufsize = ((cp->bufsize <= 0) ? LIO_COPY_BUFSIZE : cp->bufsize) / n;
+    if (bufsize < LIO_COPY_MIN_PART_BUFSIZE) bufsize = LIO_COPY_MIN_PART_BUFSIZE;
+    psize = size / n;
+
+    tbx_type_malloc_clear(fd, FILE *, n);
+    tbx_type_malloc_clear(buffer, char *, n);
+
+    nerr = 0;
+    q = new_opque();
+    for (i=0; i<n; i++) {
+        off = i * psize;
+        len = (i == n-1) ? size - off : psize;
+
+        fd[i] = fopen(local_path, (to_local) ? "r+" : "r");
+        if (fd[i] == NULL) {
+            info_printf(lio_ifd, 0, "ERROR: Failed opening local file for part %d!  path=%s\n", i, local_path);
+            nerr++;
+            break;
+        }
+        fseeko(fd[i], off, SEEK_SET);
+        tbx_type_malloc(buffer[i], char, bufsize);
+
+        if (to_local) {
+            gop = segment_get(lfh->lc->tpc_unlimited, lfh->lc->da, cp->rw_hints, lfh->seg, fd[i], off, len, bufsize-1, buffer[i], cp->n_bufs, lfh->lc->timeout);
+        } else {
+            gop = segment_put(lfh->lc->tpc_unlimited, lfh->lc->da, cp->rw_hints, fd[i], lfh->seg, off, len, bufsize-1, buffer[i], cp->n_bufs, 0, lfh->lc->timeout);
+        }
+        gop_set_myid(gop, i);
+        opque_add(q, gop);
+        log_printf(5, "part=%d off=" XOT " len=" XOT " path=%s\n", i, off, len, local_path);
+    }
+
+    while ((gop = opque_waitany(q)) != NULL) {
+        i = gop_get_myid(gop);
+        status = gop_get_status(gop);
+        if (status.op_status != OP_STATE_SUCCESS) {
+            info_printf(lio_ifd, 0, "ERROR: Failed copying part %d of %s\n", i, local_path);
+            nerr++;
+        } else {
+            lio_cp_sched_progress(cp->sched, (i == n-1) ? size - i*psize : psize, 0);
+        }
+        gop_free(gop, OP_DESTROY);
+    }
+    opque_free(q, OP_DESTROY);
+
+    for (i=0; i<n; i++) {
+        if (fd[i] != NULL) fclose(fd[i]);
+        if (buffer[i] != NULL) free(buffer[i]);
+    }
+    free(fd);
+    free(buffer);
+
+    return((nerr == 0) ? op_success_status : op_failure_status);
+}
+
 //*************************************************************************
 // lio_cp_file_fn - Actual cp function.  Copies a regex to a dest *dir*
 //*************************************************************************
@@ -1349,6 +1764,9 @@ op_status_t lio_cp_file_fn(void *arg, int id)
     FILE *sffd, *dffd;
     lio_fd_t *slfd, *dlfd;
     char *buffer;
+    struct stat st;
+    ex_off_t size;
+    int n_parts;
 
 //printf("dummy %d", cp->src_tuple.is_lio);
 //printf(" %d", cp->dest_tuple.is_lio);
@@ -1359,9 +1777,12 @@ op_status_t lio_cp_file_fn(void *arg, int id)
 //return(op_success_status);
 
     buffer = NULL;
+    size = 0;
+    n_parts = 1;
 
     if ((cp->src_tuple.is_lio == 0) && (cp->dest_tuple.is_lio == 0)) {  //** Not allowed to both go to disk
         info_printf(lio_ifd, 0, "Both source(%s) and destination(%s) are local files!\n", cp->src_tuple.path, cp->dest_tuple.path);
+        if ((cp->sched != NULL) && (cp->sched_slot)) lio_cp_sched_release(cp->sched, 1);
         return(op_failure_status);
     }
 
@@ -1378,8 +1799,21 @@ op_status_t lio_cp_file_fn(void *arg, int id)
             if (dlfd == NULL) info_printf(lio_ifd, 0, "ERROR: Failed opening destination file!  path=%s\n", cp->dest_tuple.path);
             status = op_failure_status;
         } else {
-            tbx_type_malloc(buffer, char, cp->bufsize+1);
-            status = gop_sync_exec_status(gop_lio_cp_local2lio(sffd, dlfd, cp->bufsize, buffer, cp->rw_hints));
+            if ((fstat(fileno(sffd), &st) == 0) && (S_ISREG(st.st_mode))) size = st.st_size;
+            n_parts = _lio_cp_file_parts(cp, size);
+            if (n_parts > 1) {  //** Big file so size the destination and send it in parallel parts
+                status = gop_sync_exec_status(segment_truncate(dlfd->fh->seg, dlfd->lc->da, size, dlfd->lc->timeout));
+                if (status.op_status == OP_STATE_SUCCESS) status = _lio_cp_parts(cp, dlfd->fh, cp->src_tuple.path, 0, size, n_parts);
+                if (status.op_status != OP_STATE_SUCCESS) {  //** Don't leave a full sized file with holes behind
+                    info_printf(lio_ifd, 0, "ERROR: Failed copying parts.  Truncating destination!  path=%s\n", cp->dest_tuple.path);
+                    gop_sync_exec(gop_lio_truncate(dlfd, 0));
+                }
+                dlfd->fh->modified = 1;
+                size = 0;  //** The parts already reported their bytes
+            } else {
+                tbx_type_malloc(buffer, char, cp->bufsize+1);
+                status = gop_sync_exec_status(gop_lio_cp_local2lio(sffd, dlfd, cp->bufsize, buffer, cp->n_bufs, cp->rw_hints));
+            }
         }
         if (dlfd != NULL) {
             close_status = gop_sync_exec_status(gop_lio_close_object(dlfd));
@@ -1396,8 +1830,24 @@ op_status_t lio_cp_file_fn(void *arg, int id)
             if (dffd == NULL) info_printf(lio_ifd, 0, "ERROR: Failed opening destination file!  path=%s\n", cp->dest_tuple.path);
             status = op_failure_status;
         } else {
-            tbx_type_malloc(buffer, char, cp->bufsize+1);
-            status = gop_sync_exec_status(gop_lio_cp_lio2local(slfd, dffd, cp->bufsize, buffer, cp->rw_hints));
+            size = lio_size(slfd);
+            n_parts = _lio_cp_file_parts(cp, size);
+            if (n_parts > 1) {  //** Big file so size the destination and pull it in parallel parts
+                if (ftruncate(fileno(dffd), size) == 0) {
+                    status = _lio_cp_parts(cp, slfd->fh, cp->dest_tuple.path, 1, size, n_parts);
+                    if (status.op_status != OP_STATE_SUCCESS) {  //** Same for a local file
+                        info_printf(lio_ifd, 0, "ERROR: Failed copying parts.  Truncating destination!  path=%s\n", cp->dest_tuple.path);
+                        if (ftruncate(fileno(dffd), 0) != 0) info_printf(lio_ifd, 0, "ERROR: Failed truncating destination file!  path=%s\n", cp->dest_tuple.path);
+                    }
+                } else {
+                    info_printf(lio_ifd, 0, "ERROR: Failed sizing destination file!  path=%s\n", cp->dest_tuple.path);
+                    status = op_failure_status;
+                }
+                size = 0;
+            } else {
+                tbx_type_malloc(buffer, char, cp->bufsize+1);
+                status = gop_sync_exec_status(gop_lio_cp_lio2local(slfd, dffd, cp->bufsize, buffer, cp->n_bufs, cp->rw_hints));
+            }
         }
         if (slfd != NULL) gop_sync_exec(gop_lio_close_object(slfd));
         if (dffd != NULL) fclose(dffd);
@@ -1410,8 +1860,9 @@ op_status_t lio_cp_file_fn(void *arg, int id)
             if (dlfd == NULL) info_printf(lio_ifd, 0, "ERROR: Failed opening destination file!  path=%s\n", cp->dest_tuple.path);
             status = op_failure_status;
         } else {
+            size = lio_size(slfd);
             tbx_type_malloc(buffer, char, cp->bufsize+1);
-            status = gop_sync_exec_status(gop_lio_cp_lio2lio(slfd, dlfd, cp->bufsize, buffer, cp->slow, cp->rw_hints));
+            status = gop_sync_exec_status(gop_lio_cp_lio2lio(slfd, dlfd, cp->bufsize, buffer, cp->n_bufs, cp->slow, cp->rw_hints));
         }
         if (slfd != NULL) gop_sync_exec(gop_lio_close_object(slfd));
         if (dlfd != NULL) {
@@ -1422,6 +1873,11 @@ op_status_t lio_cp_file_fn(void *arg, int id)
 
     if (buffer != NULL) free(buffer);
 
+    if (cp->sched != NULL) {
+        if (status.op_status == OP_STATE_SUCCESS) lio_cp_sched_progress(cp->sched, size, 1);
+        lio_cp_sched_release(cp->sched, n_parts - 1 + cp->sched_slot);
+    }
+
     return(status);
 }
 
@@ -1545,7 +2001,14 @@ op_status_t lio_cp_path_fn(void *arg, int id)
         c->dest_tuple = cp->dest_tuple;
         c->dest_tuple.path = strdup(dname);
         c->bufsize = cp->bufsize;
+        c->n_bufs = cp->n_bufs;
         c->slow = cp->slow;
+        c->sched = cp->sched;
+        c->sched_slot = 0;
+        if (cp->sched != NULL) {  //** Wait for a global slot so all the paths share the link
+            lio_cp_sched_acquire(cp->sched);
+            c->sched_slot = 1;
+        }
 
         gop = new_thread_pool_op(lio_gc->tpc_unlimited, NULL, lio_cp_file_fn, (void *)c, NULL, 1);
         gop_set_myid(gop, slot);
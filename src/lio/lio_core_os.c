@@ -736,6 +736,37 @@ void lio_destroy_object_iter(lio_config_t *lc, os_object_iter_t *it)
 }
 
 
+//*************************************************************************
+// lio_create_du_iter - Creates a du iterator returning the space used
+//    rolled up rollup_depth levels below the path
+//*************************************************************************
+
+os_du_iter_t *lio_create_du_iter(lio_config_t *lc, creds_t *creds, os_regex_table_t *path, os_regex_table_t *obj_regex, int object_types, int recurse_depth, int rollup_depth, int flags)
+{
+    return(os_create_du_iter(lc->os, creds, path, obj_regex, object_types, recurse_depth, rollup_depth, flags));
+}
+
+
+//*************************************************************************
+// lio_next_du - Returns the next du rollup entry
+//*************************************************************************
+
+int lio_next_du(lio_config_t *lc, os_du_iter_t *it, char **fname, int64_t *bytes, int64_t *count)
+{
+    return(os_next_du(lc->os, it, fname, bytes, count));
+}
+
+
+//*************************************************************************
+// lio_destroy_du_iter - Destroy's a du iterator
+//*************************************************************************
+
+void lio_destroy_du_iter(lio_config_t *lc, os_du_iter_t *it)
+{
+    os_destroy_du_iter(lc->os, it);
+}
+
+
 //***********************************************************************
 // lio_*_attrs - Get/Set LIO attribute routines
 //***********************************************************************
@@ -760,30 +791,14 @@ typedef struct {
 
 int lio_get_multiple_attrs(lio_config_t *lc, creds_t *creds, const char *path, char *id, char **key, void **val, int *v_size, int n_keys)
 {
-    int err, serr;
-    os_fd_t *fd;
-
-    err = gop_sync_exec(os_open_object(lc->os, creds, (char *)path, OS_MODE_READ_IMMEDIATE, id, &fd, lc->timeout));
-    if (err != OP_STATE_SUCCESS) {
-        log_printf(1, "ERROR opening object=%s\n", path);
-        return(err);
-    }
-
-    //** IF the attribute doesn't exist *val == NULL an *v_size = 0
-    serr = gop_sync_exec(os_get_multiple_attrs(lc->os, creds, fd, key, val, v_size, n_keys));
-
-    //** Close the parent
-    err = gop_sync_exec(os_close_object(lc->os, fd));
-    if (err != OP_STATE_SUCCESS) {
-        log_printf(1, "ERROR closing object=%s\n", path);
-    }
+    op_status_t status;
 
-    if (serr != OP_STATE_SUCCESS) {
+    status = os_path_get_multiple_attrs(lc->os, creds, (char *)path, id, key, val, v_size, n_keys, lc->timeout);
+    if (status.op_status != OP_STATE_SUCCESS) {
         log_printf(1, "ERROR getting attributes object=%s\n", path);
-        err = OP_STATE_FAILURE;
     }
 
-    return(err);
+    return(status.op_status);
 }
 
 //***********************************************************************
@@ -825,30 +840,15 @@ op_generic_t *gop_lio_get_multiple_attrs(lio_config_t *lc, creds_t *creds, const
 
 int lio_get_attr(lio_config_t *lc, creds_t *creds, const char *path, char *id, char *key, void **val, int *v_size)
 {
-    int err, serr;
-    os_fd_t *fd;
-
-    err = gop_sync_exec(os_open_object(lc->os, creds, (char *)path, OS_MODE_READ_IMMEDIATE, id, &fd, lc->timeout));
-    if (err != OP_STATE_SUCCESS) {
-        log_printf(1, "ERROR opening object=%s\n", path);
-        return(err);
-    }
+    op_status_t status;
 
     //** IF the attribute doesn't exist *val == NULL an *v_size = 0
-    serr = gop_sync_exec(os_get_attr(lc->os, creds, fd, key, val, v_size));
-
-    //** Close the parent
-    err = gop_sync_exec(os_close_object(lc->os, fd));
-    if (err != OP_STATE_SUCCESS) {
-        log_printf(1, "ERROR closing object=%s\n", path);
-    }
-
-    if (serr != OP_STATE_SUCCESS) {
+    status = os_path_get_multiple_attrs(lc->os, creds, (char *)path, id, &key, val, v_size, 1, lc->timeout);
+    if (status.op_status != OP_STATE_SUCCESS) {
         log_printf(1, "ERROR getting attribute object=%s\n", path);
-        err = OP_STATE_FAILURE;
     }
 
-    return(err);
+    return(status.op_status);
 }
 
 //***********************************************************************
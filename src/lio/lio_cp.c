@@ -36,10 +36,11 @@
 int main(int argc, char **argv)
 {
     int i, start_index, start_option, n_paths, n_errors;
-    int max_spawn, keepln;
+    int max_spawn, keepln, n_bufs, max_parts, report_interval;
     int obj_types = OS_OBJECT_ANY;
-    ex_off_t bufsize;
+    ex_off_t bufsize, part_size;
     char ppbuf[64];
+    lio_cp_sched_t *sched;
     lio_cp_path_t *flist;
     lio_cp_file_t cpf;
     op_generic_t *gop;
@@ -50,16 +51,24 @@ int main(int argc, char **argv)
 
     recurse_depth = 10000;
     bufsize = 20*1024*1024;
+    n_bufs = SEGMENT_COPY_DEFAULT_BUFS;
+    part_size = 256*1024*1024;
+    max_parts = 8;
+    report_interval = 0;
 
 //printf("argc=%d\n", argc);
     if (argc < 2) {
         printf("\n");
-        printf("lio_cp LIO_COMMON_OPTIONS [-rd recurse_depth] [-ln] [-b bufsize_mb] [-f] src_path1 .. src_pathN dest_path\n");
+        printf("lio_cp LIO_COMMON_OPTIONS [-rd recurse_depth] [-ln] [-b bufsize_mb] [-w n_bufs] [-ps part_size] [-pn max_parts] [-p secs] [-f] src_path1 .. src_pathN dest_path\n");
         lio_print_options(stdout);
         printf("\n");
         printf("    -ln                - Follow links.  Otherwise they are ignored\n");
         printf("    -rd recurse_depth  - Max recursion depth on directories. Defaults to %d\n", recurse_depth);
         printf("    -b bufsize         - Buffer size to use for *each* transfer. Units supported (Default=%s)\n", tbx_stk_pretty_print_int_with_scale(bufsize, ppbuf));
+        printf("    -w n_bufs          - Number of pieces the buffer is split into and kept in flight for each transfer (Default=%d)\n", n_bufs);
+        printf("    -ps part_size      - Files at least twice this size are split into ranged parts copied in parallel. 0 disables it. Units supported (Default=%s)\n", tbx_stk_pretty_print_int_with_scale(part_size, ppbuf));
+        printf("    -pn max_parts      - Max number of parallel parts a single file is split into (Default=%d)\n", max_parts);
+        printf("    -p secs            - Print the aggregate MB/s and files/s every secs seconds\n");
         printf("    -f                 - Force a slow or traditional copy by reading from the source and copying to the destination\n");
         printf("    src_path*          - Source path glob to copy\n");
         printf("    dest_path          - Destination file or directory\n");
@@ -100,6 +109,22 @@ int main(int argc, char **argv)
             i++;
             bufsize = tbx_stk_string_get_integer(argv[i]);
             i++;
+        } else if (strcmp(argv[i], "-w") == 0) {  //** Get the transfer window
+            i++;
+            n_bufs = atoi(argv[i]);
+            i++;
+        } else if (strcmp(argv[i], "-ps") == 0) {  //** Ranged part size
+            i++;
+            part_size = tbx_stk_string_get_integer(argv[i]);
+            i++;
+        } else if (strcmp(argv[i], "-pn") == 0) {  //** Max parts per file
+            i++;
+            max_parts = atoi(argv[i]);
+            i++;
+        } else if (strcmp(argv[i], "-p") == 0) {  //** Progress interval
+            i++;
+            report_interval = atoi(argv[i]);
+            i++;
         }
 
     } while ((start_option < i) && (i<argc));
@@ -132,8 +157,10 @@ int main(int argc, char **argv)
 
     tbx_type_malloc_clear(flist, lio_cp_path_t, n_paths);
 
-    max_spawn = lio_parallel_task_count / n_paths;
+    //** All the paths share the scheduler's task slots so each can spawn up to the global limit
+    max_spawn = lio_parallel_task_count;
     if (max_spawn <= 0) max_spawn = 1;
+    sched = lio_cp_sched_create(max_spawn, part_size, max_parts, report_interval);
 
     for (i=0; i<n_paths; i++) {
         flist[i].src_tuple = lio_path_resolve(lio_gc->auto_translate, argv[i+start_index]);
@@ -145,7 +172,9 @@ int main(int argc, char **argv)
         flist[i].obj_types = obj_types;
         flist[i].max_spawn = max_spawn;
         flist[i].bufsize = bufsize;
+        flist[i].n_bufs = n_bufs;
         flist[i].slow = slow;
+        flist[i].sched = sched;
     }
 
     //** Do some sanity checking and handle the simple case directly
@@ -176,8 +205,11 @@ int main(int argc, char **argv)
             cpf.src_tuple = flist[0].src_tuple; //c->src_tuple.path = fname;
             cpf.dest_tuple = flist[0].dest_tuple; //c->dest_tuple.path = strdup(dname);
             cpf.bufsize = flist[0].bufsize;
+            cpf.n_bufs = flist[0].n_bufs;
             cpf.slow = flist[0].slow;
             cpf.rw_hints = NULL;
+            cpf.sched = sched;
+            cpf.sched_slot = 0;
             status = lio_cp_file_fn(&cpf, 0);
 
             if (status.op_status != OP_STATE_SUCCESS) {
@@ -231,6 +263,9 @@ finished:
 
     free(flist);
 
+    if (report_interval > 0) lio_cp_sched_report(sched);
+    lio_cp_sched_destroy(sched);
+
     if (n_errors > 0) info_printf(lio_ifd, 0, "Failed copying %d file(s)!\n", n_errors);
 
 //tbx_set_log_level(20);
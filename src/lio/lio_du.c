@@ -80,10 +80,11 @@ int main(int argc, char **argv)
     tbx_list_t *table, *sum_table, *lt;
     os_regex_table_t *rp_single, *ro_single;
     os_object_iter_t *it;
+    os_du_iter_t *dit;
     tbx_list_iter_t lit;
     char *key = "system.exnode.size";
-    char *val, *file;
-    int64_t bytes;
+    char *val;
+    int64_t bytes, count;
     ex_off_t total_files, total_bytes;
     int v_size, sumonly, ignoreln;
     int recurse_depth = 10000;
@@ -186,21 +187,17 @@ int main(int argc, char **argv)
             rg_mode = 0;  //** Use the initial rp
         }
 
-        //** Make the toplevel list
+        //** The tally is done by the OS so only the summaries come back
         if (sumonly == 1) {
             log_printf(15, "MAIN SUMONLY=1\n");
-            v_size = -1024;
-            val = NULL;
-            it = lio_create_object_iter_alist(tuple.lc, tuple.creds, rp_single, ro_single, OS_OBJECT_ANY, 0, &key, (void **)&val, &v_size, 1);
-            if (it == NULL) {
-                log_printf(0, "ERROR: Failed with object_iter creation\n");
+            dit = lio_create_du_iter(tuple.lc, tuple.creds, rp_single, ro_single, OS_OBJECT_ANY, recurse_depth, 1, (ignoreln == 1) ? OS_DU_IGNORE_LINKS : 0);
+            if (dit == NULL) {
+                log_printf(0, "ERROR: Failed with du_iter creation\n");
                 return_code = EIO;
                 goto finished;
             }
 
-            while ((ftype = lio_next_object(tuple.lc, it, &fname, &prefix_len)) > 0) {
-                if (((ftype & OS_OBJECT_SYMLINK) > 0) && (ignoreln == 1)) continue;  //** Ignoring links
-
+            while ((ftype = lio_next_du(tuple.lc, dit, &fname, &bytes, &count)) > 0) {
                 log_printf(15, "sumonly inserting fname=%s\n", fname);
                 tbx_type_malloc_clear(de, du_entry_t, 1);
                 plen = strlen(fname);
@@ -210,57 +207,38 @@ int main(int argc, char **argv)
                 de->fname[plen+1] = 0;
                 free(fname);
                 de->ftype = ftype;
-
-                if (val != NULL) sscanf(val, I64T, &(de->bytes));
+                de->bytes = bytes;
+                de->count = count;
                 tbx_list_insert(sum_table, de->fname, de);
-
-                v_size = -1024;
-                free(val);
-                val = NULL;
             }
 
-            lio_destroy_object_iter(tuple.lc, it);
+            lio_destroy_du_iter(tuple.lc, dit);
 
             log_printf(15, "sum_table=%d\n", tbx_list_key_count(sum_table));
-        }
-
-        log_printf(15, "MAIN LOOP\n");
+        } else {
+            log_printf(15, "MAIN LOOP\n");
 
-        v_size = -1024;
-        val = NULL;
-        it = lio_create_object_iter_alist(tuple.lc, tuple.creds, rp_single, ro_single, OS_OBJECT_ANY, recurse_depth, &key, (void **)&val, &v_size, 1);
-        if (it == NULL) {
-            log_printf(0, "ERROR: Failed with object_iter creation\n");
-            return_code = EIO;
-            goto finished;
-        }
+            v_size = -1024;
+            val = NULL;
+            it = lio_create_object_iter_alist(tuple.lc, tuple.creds, rp_single, ro_single, OS_OBJECT_ANY, recurse_depth, &key, (void **)&val, &v_size, 1);
+            if (it == NULL) {
+                log_printf(0, "ERROR: Failed with object_iter creation\n");
+                return_code = EIO;
+                goto finished;
+            }
 
-        while ((ftype = lio_next_object(tuple.lc, it, &fname, &prefix_len)) > 0) {
-//printf("fname=%s\n", fname);
-            if (((ftype & OS_OBJECT_SYMLINK) > 0) && (ignoreln == 1)) continue;  //** Ignoring links
-//printf("fname2=%s\n", fname);
-
-            if ((sumonly == 1) && ((ftype & OS_OBJECT_FILE) > 0)) {
-                bytes = 0;
-                if (val != NULL) sscanf(val, I64T, &bytes);
-
-                lit = tbx_list_iter_search(sum_table, NULL, 0);
-                while ((tbx_list_next(&lit, (tbx_list_key_t **)&file, (tbx_list_data_t **)&de)) == 0) {
-                    if ((strncmp(de->fname, fname, strlen(de->fname)) == 0) && ((de->ftype & OS_OBJECT_DIR) > 0)) {
-                        log_printf(15, "accum de->fname=%s fname=%s\n", de->fname, fname);
-                        de->bytes += bytes;
-                        de->count++;
-                    }
+            while ((ftype = lio_next_object(tuple.lc, it, &fname, &prefix_len)) > 0) {
+                if (((ftype & OS_OBJECT_SYMLINK) > 0) && (ignoreln == 1)) {  //** Ignoring links
+                    free(fname);
+                    continue;
                 }
-                free(fname);
-            } else {
+
                 tbx_type_malloc_clear(de, du_entry_t, 1);
                 de->fname = fname;
                 de->ftype = ftype;
 
                 if (val != NULL) sscanf(val, I64T, &(de->bytes));
 
-//printf("fname=%s size=" I64T "\n", de->fname, de->bytes);
                 if (nosort == 1) {
                     du_format_entry(lio_ifd, de, sumonly);
                     free(de->fname);
@@ -268,15 +246,15 @@ int main(int argc, char **argv)
                 } else {
                     tbx_list_insert(table, de->fname, de);
                 }
+
+                v_size = -1024;
+                free(val);
+                val = NULL;
             }
 
-            v_size = -1024;
-            free(val);
-            val = NULL;
+            lio_destroy_object_iter(tuple.lc, it);
         }
 
-        lio_destroy_object_iter(tuple.lc, it);
-
         lio_path_release(&tuple);
         if (rp_single != NULL) {
             os_regex_table_destroy(rp_single);
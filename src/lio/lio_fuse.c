@@ -44,7 +44,8 @@ void print_usage(void)
            "       -f                     foreground operation\n"
            "                                (REQUIRED unless  '-c /absolute/path/lio.cfg' is specified and all included files are absolute paths)"
            "       -o OPT[,OPT...]        mount options\n"
-           "                                (for possible values of OPT see 'man mount.fuse' or see 'lio_fuse -ho')\n");
+           "                                (for possible values of OPT see 'man mount.fuse' or see 'lio_fuse -ho')\n"
+           "                                (use_ino,attr_timeout=N,entry_timeout=N let the kernel reuse the stat info from readdir)\n");
 }
 
 int main(int argc, char **argv)
@@ -54,6 +54,9 @@ lio_config_t *lc;
 apr_pool_t *mpool;
 apr_thread_mutex_t *lock;
 apr_hash_t *open_files;
+apr_hash_t *stat_cache;         //** Stat info from readdir used to answer the getattr calls that follow
+apr_time_t stat_cache_timeout;
+int stat_cache_max;
 struct fuse_operations fops;
 char *id;
 char *mount_point;
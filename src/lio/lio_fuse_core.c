@@ -62,6 +62,12 @@ typedef struct {
     struct stat stat;
 } lfs_dir_entry_t;
 
+typedef struct {
+    char *fname;
+    struct stat stat;
+    apr_time_t expire;
+} lfs_stat_cache_entry_t;
+
 typedef struct {
     char *fname;
     ex_id_t sid;
@@ -195,6 +201,136 @@ void _lfs_parse_stat_vals(lio_fuse_t *lfs, char *fname, struct stat *stat, char
     }
 }
 
+//*************************************************************************
+// _lfs_stat_cache_purge - Removes stat cache entries.  If all=0 only the
+//   expired entries are removed.
+//   NOTE: The lfs lock should be held
+//*************************************************************************
+
+void _lfs_stat_cache_purge(lio_fuse_t *lfs, int all)
+{
+    apr_hash_index_t *hi;
+    lfs_stat_cache_entry_t *sce;
+    apr_time_t now;
+
+    now = apr_time_now();
+    for (hi = apr_hash_first(NULL, lfs->stat_cache); hi != NULL; hi = apr_hash_next(hi)) {
+        apr_hash_this(hi, NULL, NULL, (void **)&sce);
+        if ((all == 1) || (sce->expire < now)) {
+            apr_hash_set(lfs->stat_cache, sce->fname, APR_HASH_KEY_STRING, NULL);
+            free(sce->fname);
+            free(sce);
+        }
+    }
+}
+
+//*************************************************************************
+// _lfs_stat_cache_remove - Drops the path from the stat cache
+//   NOTE: The lfs lock should be held
+//*************************************************************************
+
+void _lfs_stat_cache_remove(lio_fuse_t *lfs, const char *fname)
+{
+    lfs_stat_cache_entry_t *sce;
+
+    sce = apr_hash_get(lfs->stat_cache, fname, APR_HASH_KEY_STRING);
+    if (sce == NULL) return;
+
+    apr_hash_set(lfs->stat_cache, sce->fname, APR_HASH_KEY_STRING, NULL);
+    free(sce->fname);
+    free(sce);
+}
+
+//*************************************************************************
+// _lfs_stat_cache_remove_tree - Drops the path and everything under it
+//   from the stat cache
+//   NOTE: The lfs lock should be held
+//*************************************************************************
+
+void _lfs_stat_cache_remove_tree(lio_fuse_t *lfs, const char *fname)
+{
+    apr_hash_index_t *hi;
+    lfs_stat_cache_entry_t *sce;
+    int len;
+
+    _lfs_stat_cache_remove(lfs, fname);
+
+    len = strlen(fname);
+    while ((len > 0) && (fname[len-1] == '/')) len--;
+
+    for (hi = apr_hash_first(NULL, lfs->stat_cache); hi != NULL; hi = apr_hash_next(hi)) {
+        apr_hash_this(hi, NULL, NULL, (void **)&sce);
+        if ((strncmp(sce->fname, fname, len) == 0) && (sce->fname[len] == '/')) {
+            apr_hash_set(lfs->stat_cache, sce->fname, APR_HASH_KEY_STRING, NULL);
+            free(sce->fname);
+            free(sce);
+        }
+    }
+}
+
+//*************************************************************************
+// lfs_stat_cache_remove - Drops the path from the stat cache
+//*************************************************************************
+
+void lfs_stat_cache_remove(lio_fuse_t *lfs, const char *fname)
+{
+    lfs_lock(lfs);
+    _lfs_stat_cache_remove(lfs, fname);
+    lfs_unlock(lfs);
+}
+
+//*************************************************************************
+// lfs_stat_cache_add - Stores the stat info returned with a directory entry
+//*************************************************************************
+
+void lfs_stat_cache_add(lio_fuse_t *lfs, const char *fname, struct stat *stat)
+{
+    lfs_stat_cache_entry_t *sce;
+
+    if (lfs->stat_cache_timeout <= 0) return;
+
+    lfs_lock(lfs);
+    sce = apr_hash_get(lfs->stat_cache, fname, APR_HASH_KEY_STRING);
+    if (sce == NULL) {
+        if ((int)apr_hash_count(lfs->stat_cache) >= lfs->stat_cache_max) {
+            _lfs_stat_cache_purge(lfs, 0);
+            if ((int)apr_hash_count(lfs->stat_cache) >= lfs->stat_cache_max) _lfs_stat_cache_purge(lfs, 1);
+        }
+        tbx_type_malloc(sce, lfs_stat_cache_entry_t, 1);
+        sce->fname = strdup(fname);
+        apr_hash_set(lfs->stat_cache, sce->fname, APR_HASH_KEY_STRING, sce);
+    }
+    sce->stat = *stat;
+    sce->expire = apr_time_now() + lfs->stat_cache_timeout;
+    lfs_unlock(lfs);
+}
+
+//*************************************************************************
+// lfs_stat_cache_get - Fills in the stat from the cache.  Returns 0 on a hit.
+//   Open files always miss since their size comes from the open handle.
+//*************************************************************************
+
+int lfs_stat_cache_get(lio_fuse_t *lfs, const char *fname, struct stat *stat)
+{
+    lfs_stat_cache_entry_t *sce;
+    int err;
+
+    err = 1;
+    lfs_lock(lfs);
+    sce = apr_hash_get(lfs->stat_cache, fname, APR_HASH_KEY_STRING);
+    if (sce != NULL) {
+        if (sce->expire < apr_time_now()) {
+            _lfs_stat_cache_remove(lfs, fname);
+        } else if (apr_hash_get(lfs->open_files, fname, APR_HASH_KEY_STRING) == NULL) {
+            *stat = sce->stat;
+            err = 0;
+        }
+    }
+    lfs_unlock(lfs);
+
+    return(err);
+}
+
 //*************************************************************************
 // lfs_get_context - Returns the LFS context.  If none is available it aborts
 //*************************************************************************
@@ -226,6 +362,12 @@ int lfs_stat(const char *fname, struct stat *stat)
     log_printf(1, "fname=%s\n", fname);
     tbx_log_flush();
 
+    //** See if we just got it from a readdir
+    if (lfs_stat_cache_get(lfs, fname, stat) == 0) {
+        log_printf(1, "END fname=%s STAT_CACHE_HIT\n", fname);
+        return(0);
+    }
+
     for (i=0; i<_inode_key_size; i++) v_size[i] = -lfs->lc->max_attr;
     err = lio_get_multiple_attrs(lfs->lc, lfs->lc->creds, fname, NULL, _inode_keys, (void **)val, v_size, _inode_key_size);
 
@@ -355,6 +497,7 @@ int lfs_readdir(const char *dname, void *buf, fuse_fill_dir_t filler, off_t off,
     lfs_dir_entry_t *de;
     int ftype, prefix_len, n, i;
     char *fname;
+    char path[OS_PATH_MAX];
     struct stat stbuf;
     apr_time_t now;
     double dt;
@@ -407,6 +550,10 @@ int lfs_readdir(const char *dname, void *buf, fuse_fill_dir_t filler, off_t off,
         de->dentry = strdup(fname+prefix_len+1);
         _lfs_parse_stat_vals(dit->lfs, fname, &(de->stat), dit->val, dit->v_size);
         free(fname);
+
+        //** Keep the stat around for the getattr the kernel issues next for each entry
+        snprintf(path, OS_PATH_MAX, "%s/%s", (strcmp(dit->dot_path, "/") == 0) ? "" : dit->dot_path, de->dentry);
+        lfs_stat_cache_add(dit->lfs, path, &(de->stat));
         log_printf(1, "next fname=%s ftype=%d prefix_len=%d ino=" XIDT " off=" XOT "\n", de->dentry, ftype, prefix_len, de->stat.st_ino, off);
 
         tbx_stack_move_to_bottom(dit->stack);
@@ -438,6 +585,8 @@ int lfs_object_create(lio_fuse_t *lfs, const char *fname, mode_t mode, int ftype
     log_printf(1, "fname=%s\n", fname);
     tbx_log_flush();
 
+    lfs_stat_cache_remove(lfs, fname);
+
     //** Make sure it doesn't exists
     n = lioc_exists(lfs->lc, lfs->lc->creds, (char *)fname);
     if (n != 0) {  //** File already exists
@@ -487,6 +636,8 @@ int lfs_mkdir(const char *fname, mode_t mode)
 int lfs_actual_remove(lio_fuse_t *lfs, const char *fname, int ftype)
 {
     int err;
+
+    lfs_stat_cache_remove(lfs, fname);
     err = gop_sync_exec(gop_lio_remove_object(lfs->lc, lfs->lc->creds, (char *)fname, NULL, 0));
 
     log_printf(1, "remove err=%d\n", err);
@@ -607,6 +758,7 @@ int lfs_release(const char *fname, struct fuse_file_info *fi)
     remove_on_close = 0;
 
     lfs_lock(lfs);
+    _lfs_stat_cache_remove(lfs, fname);
     fop = apr_hash_get(lfs->open_files, fname, APR_HASH_KEY_STRING);
     if (fop) {
         remove_on_close = fop->remove_on_close;
@@ -807,6 +959,14 @@ int lfs_rename(const char *oldname, const char *newname)
 
     //** Do the move
     err = gop_sync_exec(gop_lio_move_object(lfs->lc, lfs->lc->creds, (char *)oldname, (char *)newname));
+
+    //** Anything cached under either name is now wrong.  Done after the move
+    //** so entries cached while it was in flight are dropped as well.
+    lfs_lock(lfs);
+    _lfs_stat_cache_remove_tree(lfs, oldname);
+    _lfs_stat_cache_remove_tree(lfs, newname);
+    lfs_unlock(lfs);
+
     if (err != OP_STATE_SUCCESS) {
         return(-EIO);
     }
@@ -852,6 +1012,8 @@ int lfs_truncate(const char *fname, off_t new_size)
     log_printf(1, "fname=%s\n", fname);
     tbx_log_flush();
 
+    lfs_stat_cache_remove(lfs, fname);
+
     ts = new_size;
     log_printf(15, "adjusting size=" XOT "\n", ts);
 
@@ -893,6 +1055,8 @@ int lfs_utimens(const char *fname, const struct timespec tv[2])
     log_printf(1, "fname=%s\n", fname);
     tbx_log_flush();
 
+    lfs_stat_cache_remove(lfs, fname);
+
     key = "system.modify_attr";
     ts = tv[1].tv_sec;
     snprintf(buf, 1024, XOT "|%s", ts, lfs->id);
@@ -1256,6 +1420,8 @@ int lfs_setxattr(const char *fname, const char *name, const char *fval, size_t s
     log_printf(1, "fname=%s size=%zu attr_name=%s\n", fname, size, name);
     tbx_log_flush();
 
+    lfs_stat_cache_remove(lfs, fname);
+
     if (flags != 0) { //** Got an XATTR_CREATE/XATTR_REPLACE
         v_size = 0;
         val = NULL;
@@ -1301,6 +1467,7 @@ int lfs_removexattr(const char *fname, const char *name)
         return(0);
     }
 
+    lfs_stat_cache_remove(lfs, fname);
     v_size = -1;
     err = lio_set_attr(lfs->lc, lfs->lc->creds, (char *)fname, NULL, (char *)name, NULL, v_size);
     if (err != OP_STATE_SUCCESS) {
@@ -1322,6 +1489,11 @@ int lfs_hardlink(const char *oldname, const char *newname)
     log_printf(1, "oldname=%s newname=%s\n", oldname, newname);
     tbx_log_flush();
 
+    lfs_lock(lfs);
+    _lfs_stat_cache_remove(lfs, oldname);  //** The link count changes
+    _lfs_stat_cache_remove(lfs, newname);
+    lfs_unlock(lfs);
+
     //** Now do the hard link
     err = gop_sync_exec(gop_lio_link_object(lfs->lc, lfs->lc->creds, 0, (char *)oldname, (char *)newname, lfs->id));
     if (err != OP_STATE_SUCCESS) {
@@ -1383,6 +1555,8 @@ int lfs_symlink(const char *link, const char *newname)
     log_printf(1, "link=%s newname=%s\n", link, newname);
     tbx_log_flush();
 
+    lfs_stat_cache_remove(lfs, newname);
+
     //** If the link is an absolute path we need to peel off the mount point to the get attribs to link correctly
     //** We only support symlinks within LFS
     link2 = link;
@@ -1511,6 +1685,9 @@ void *lfs_init_real(struct fuse_conn_info *conn,
     apr_pool_create(&(lfs->mpool), NULL);
     apr_thread_mutex_create(&(lfs->lock), APR_THREAD_MUTEX_DEFAULT, lfs->mpool);
     lfs->open_files = apr_hash_make(lfs->mpool);
+    lfs->stat_cache = apr_hash_make(lfs->mpool);
+    lfs->stat_cache_timeout = apr_time_from_sec(tbx_inip_get_integer(lfs->lc->ifd, section, "readdir_stat_timeout", 5));
+    lfs->stat_cache_max = tbx_inip_get_integer(lfs->lc->ifd, section, "readdir_stat_max", 100000);
 
     //** Get the default host ID for opens
     char hostname[1024];
@@ -1556,6 +1733,7 @@ void lfs_destroy(void *private_data)
     //** Clean up everything else
     if (lfs->id != NULL) free (lfs->id);
     free(lfs->mount_point);
+    _lfs_stat_cache_purge(lfs, 1);
     apr_thread_mutex_destroy(lfs->lock);
     apr_pool_destroy(lfs->mpool);
 
@@ -33,6 +33,7 @@
 int main(int argc, char **argv)
 {
     ex_off_t bufsize;
+    int n_bufs;
     int err, err_close, ftype, i, start_index, start_option;
     char *buffer;
     lio_fd_t *fd;
@@ -44,13 +45,15 @@ int main(int argc, char **argv)
     _lio_ifd = stderr;  //** Default to all information going to stderr since the output is file data.
 
     bufsize = 20*1024*1024;
+    n_bufs = SEGMENT_COPY_DEFAULT_BUFS;
 
 //printf("argc=%d\n", argc);
     if (argc < 2) {
         printf("\n");
-        printf("lio_get LIO_COMMON_OPTIONS [-b bufsize] src_file1 .. src_file_N\n");
+        printf("lio_get LIO_COMMON_OPTIONS [-b bufsize] [-w n_bufs] src_file1 .. src_file_N\n");
         lio_print_options(stdout);
         printf("    -b bufsize         - Buffer size to use. Units supported (Default=%s)\n", tbx_stk_pretty_print_int_with_scale(bufsize, ppbuf));
+        printf("    -w n_bufs          - Number of pieces the buffer is split into and kept in flight (Default=%d)\n", n_bufs);
         printf("    src_file           - Source file\n");
         return(1);
     }
@@ -65,6 +68,10 @@ int main(int argc, char **argv)
                 i++;
                 bufsize = tbx_stk_string_get_integer(argv[i]);
                 i++;
+            } else if (strcmp(argv[i], "-w") == 0) {  //** Get the transfer window
+                i++;
+                n_bufs = atoi(argv[i]);
+                i++;
             }
 
         } while ((start_option < i) && (i<argc));
@@ -99,7 +106,7 @@ int main(int argc, char **argv)
         }
 
         //** Do the get
-        err = gop_sync_exec(gop_lio_cp_lio2local(fd, stdout, bufsize, buffer, NULL));
+        err = gop_sync_exec(gop_lio_cp_lio2local(fd, stdout, bufsize, buffer, n_bufs, NULL));
         if (err != OP_STATE_SUCCESS) {
             info_printf(lio_ifd, 0, "Failed reading data!  path=%s\n", tuple.path);
         }
@@ -32,6 +32,7 @@
 int main(int argc, char **argv)
 {
     ex_off_t bufsize;
+    int n_bufs;
     int err, err_close, dtype, i, start_index, start_option;
     lio_fd_t *fd;
     char *buffer;
@@ -39,12 +40,14 @@ int main(int argc, char **argv)
     lio_path_tuple_t tuple;
 
     bufsize = 20*1024*1024;
+    n_bufs = SEGMENT_COPY_DEFAULT_BUFS;
 
     if (argc < 2) {
         printf("\n");
-        printf("lio_put LIO_COMMON_OPTIONS [-b bufsize] dest_file\n");
+        printf("lio_put LIO_COMMON_OPTIONS [-b bufsize] [-w n_bufs] dest_file\n");
         lio_print_options(stdout);
         printf("    -b bufsize         - Buffer size to use. Units supported (Default=%s)\n", tbx_stk_pretty_print_int_with_scale(bufsize, ppbuf));
+        printf("    -w n_bufs          - Number of pieces the buffer is split into and kept in flight (Default=%d)\n", n_bufs);
         printf("    dest_file          - Destination file\n");
         return(1);
     }
@@ -62,6 +65,10 @@ int main(int argc, char **argv)
             i++;
             bufsize = tbx_stk_string_get_integer(argv[i]);
             i++;
+        } else if (strcmp(argv[i], "-w") == 0) {  //** Get the transfer window
+            i++;
+            n_bufs = atoi(argv[i]);
+            i++;
         }
 
     } while ((start_option < i) && (i<argc));
@@ -100,7 +107,7 @@ int main(int argc, char **argv)
     }
 
     //** Do the put
-    err = gop_sync_exec(gop_lio_cp_local2lio(stdin, fd, bufsize, buffer, NULL));
+    err = gop_sync_exec(gop_lio_cp_local2lio(stdin, fd, bufsize, buffer, n_bufs, NULL));
     if (err != OP_STATE_SUCCESS) {
         info_printf(lio_ifd, 0, "Failed writing data!  path=%s\n", tuple.path);
     }
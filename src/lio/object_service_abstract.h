@@ -68,6 +68,8 @@ extern "C" {
  
 #define OS_CREDS_INI_TYPE 0  //** Load creds from file
  
+#define OS_DU_IGNORE_LINKS 1  //** Skip symlinked objects when tallying usage
+ 
 typedef struct os_authz_s os_authz_t;
  
 typedef struct {
@@ -79,6 +81,7 @@ typedef void os_fd_t;
 typedef void os_attr_iter_t;
 typedef void os_object_iter_t;
 typedef void os_fsck_iter_t;
+typedef void os_du_iter_t;
  
 typedef struct {
 char *expression;
@@ -125,6 +128,10 @@ os_object_iter_t *(*create_object_iter_alist)(object_service_fn_t *os, creds_t *
 int (*next_object)(os_object_iter_t *it, char **fname, int *prefix_len);
 void (*destroy_object_iter)(os_object_iter_t *it);
  
+os_du_iter_t *(*create_du_iter)(object_service_fn_t *os, creds_t *creds, os_regex_table_t *path, os_regex_table_t *obj_regex, int object_types, int recurse_depth, int rollup_depth, int flags);
+int (*next_du)(object_service_fn_t *os, os_du_iter_t *it, char **fname, int64_t *bytes, int64_t *count);
+void (*destroy_du_iter)(object_service_fn_t *os, os_du_iter_t *it);
+ 
 op_generic_t *(*open_object)(object_service_fn_t *os, creds_t *creds, char *path, int mode, char *id, os_fd_t **fd, int max_wait);
 op_generic_t *(*close_object)(object_service_fn_t *os, os_fd_t *fd);
 op_generic_t *(*abort_open_object)(object_service_fn_t *os, op_generic_t *gop);
@@ -137,6 +144,7 @@ op_generic_t *(*set_attr)(object_service_fn_t *os, creds_t *creds, os_fd_t *fd,
 op_generic_t *(*move_attr)(object_service_fn_t *os, creds_t *creds, os_fd_t *fd, char *key_old, char *key_new);
 op_generic_t *(*copy_attr)(object_service_fn_t *os, creds_t *creds, os_fd_t *fd_src, char *key_src, os_fd_t *fd_dest, char *key_dest);
 op_generic_t *(*get_multiple_attrs)(object_service_fn_t *os, creds_t *creds, os_fd_t *fd, char **key, void **val, int *v_size, int n);
+op_generic_t *(*get_multiple_attrs_immediate)(object_service_fn_t *os, creds_t *creds, char *path, char *id, char **key, void **val, int *v_size, int n);
 op_generic_t *(*set_multiple_attrs)(object_service_fn_t *os, creds_t *creds, os_fd_t *fd, char **key, void **val, int *v_size, int n);
 op_generic_t *(*move_multiple_attrs)(object_service_fn_t *os, creds_t *creds, os_fd_t *fd, char **key_old, char **key_new, int n);
 op_generic_t *(*copy_multiple_attrs)(object_service_fn_t *os, creds_t *creds, os_fd_t *fd_src, char **key_src, os_fd_t *fd_dest, char **key_dest, int n);
@@ -176,6 +184,10 @@ typedef object_service_fn_t *(os_create_t)(service_manager_t *ess, tbx_inip_file
 #define os_next_object(os, it, fname, plen) (os)->next_object(it, fname, plen)
 #define os_destroy_object_iter(os, it) (os)->destroy_object_iter(it)
  
+#define os_create_du_iter(os, c, path, obj_regex, otypes, depth, rollup, flags) (os)->create_du_iter(os, c, path, obj_regex, otypes, depth, rollup, flags)
+#define os_next_du(os, it, fname, bytes, count) (os)->next_du(os, it, fname, bytes, count)
+#define os_destroy_du_iter(os, it) (os)->destroy_du_iter(os, it)
+ 
 #define os_open_object(os, c, path, mode, id, fd, max_wait) (os)->open_object(os, c, path, mode, id, fd, max_wait)
 #define os_close_object(os, fd) (os)->close_object(os, fd)
 #define os_abort_open_object(os, gop) (os)->abort_open_object(os, gop)
@@ -188,6 +200,7 @@ typedef object_service_fn_t *(os_create_t)(service_manager_t *ess, tbx_inip_file
 #define os_move_attr(os, c, fd, key_old, key_new) (os)->move_attr(os, c, fd, key_old, key_new)
 #define os_copy_attr(os, c, fd_src, key_src, fd_dest, key_dest) (os)->copy_attr(os, c, fd_src, key_src, fd_dest, key_dest)
 #define os_get_multiple_attrs(os, c, fd, keys, vals, v_sizes, n) (os)->get_multiple_attrs(os, c, fd, keys, vals, v_sizes, n)
+#define os_get_multiple_attrs_immediate(os, c, path, id, keys, vals, v_sizes, n) (os)->get_multiple_attrs_immediate(os, c, path, id, keys, vals, v_sizes, n)
 #define os_set_multiple_attrs(os, c, fd, keys, vals, v_sizes, n) (os)->set_multiple_attrs(os, c, fd, keys, vals, v_sizes, n)
 #define os_move_multiple_attrs(os, c, fd, key_old, key_new, n) (os)->move_multiple_attrs(os, c, fd, key_old, key_new, n)
 #define os_copy_multiple_attrs(os, c, fd_src, key_src, fd_dest, key_dest, n) (os)->copy_multiple_attrs(os, c, fd_src, key_src, fd_dest, key_dest, n)
@@ -200,6 +213,10 @@ typedef object_service_fn_t *(os_create_t)(service_manager_t *ess, tbx_inip_file
 LIO_API int os_local_filetype(char *path);
 LIO_API int os_regex_is_fixed(os_regex_table_t *regex);
 LIO_API void os_path_split(const char *path, char **dir, char **file);
+LIO_API os_du_iter_t *os_create_du_iter_generic(object_service_fn_t *os, creds_t *creds, os_regex_table_t *path, os_regex_table_t *obj_regex, int object_types, int recurse_depth, int rollup_depth, int flags);
+LIO_API int os_next_du_generic(object_service_fn_t *os, os_du_iter_t *it, char **fname, int64_t *bytes, int64_t *count);
+LIO_API void os_destroy_du_iter_generic(object_service_fn_t *os, os_du_iter_t *it);
+LIO_API op_status_t os_path_get_multiple_attrs(object_service_fn_t *os, creds_t *creds, char *path, char *id, char **key, void **val, int *v_size, int n, int max_wait);
 os_regex_table_t *os_regex_table_create(int n);
 LIO_API void os_regex_table_destroy(os_regex_table_t *table);
 LIO_API os_regex_table_t *os_path_glob2regex(char *path);
@@ -0,0 +1,129 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//*************************************************************************
+// Converts an os_file tree between the file-per-attribute layout and the
+// attribute log.  It works directly on the base_path so the object
+// service must not be running.
+//*************************************************************************
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include "os_file_priv.h"
+#include "os_file_attr_log.h"
+
+typedef struct {
+    int store;
+    int n_dirs;
+    int n_attrs;
+    int n_failed;
+} migrate_stats_t;
+
+//*************************************************************************
+// migrate_tree - Recursively walks the tree converting every attribute
+//     directory.  Symlinked dirs are skipped since the real directory is
+//     in the hardlink tree which is walked separately.
+//*************************************************************************
+
+void migrate_tree(char *path, migrate_stats_t *ms)
+{
+    DIR *d;
+    struct dirent *entry;
+    struct stat s;
+    int n;
+    char fname[OS_PATH_MAX];
+
+    d = opendir(path);
+    if (d == NULL) return;
+
+    while ((entry = readdir(d)) != NULL) {
+        if ((strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0)) continue;
+
+        snprintf(fname, OS_PATH_MAX, "%s/%s", path, entry->d_name);
+        if ((lstat(fname, &s) != 0) || (!S_ISDIR(s.st_mode))) continue;
+
+        if (strncmp(entry->d_name, FILE_ATTR_PREFIX, FILE_ATTR_PREFIX_LEN) == 0) {  //** Attribute directory
+            n = osf_alog_migrate(fname, ms->store);
+            if (n < 0) {
+                printf("ERROR: Failed migrating %s\n", fname);
+                ms->n_failed++;
+            } else {
+                ms->n_dirs++;
+                ms->n_attrs += n;
+            }
+        }
+
+        migrate_tree(fname, ms);  //** Directory attr dirs also hold the children's attr dirs
+    }
+
+    closedir(d);
+}
+
+//*************************************************************************
+//*************************************************************************
+
+int main(int argc, char **argv)
+{
+    migrate_stats_t ms;
+    char path[OS_PATH_MAX];
+    int i;
+
+    if (argc < 2) {
+        printf("\n");
+        printf("os_attr_migrate [-to log|file] base_path\n");
+        printf("    -to log|file  - Destination attribute store.  Default is log.\n");
+        printf("    base_path     - The os_file base_path.  The object service must be stopped.\n");
+        printf("\n");
+        return(1);
+    }
+
+    memset(&ms, 0, sizeof(ms));
+    ms.store = OSF_ATTR_STORE_LOG;
+
+    i = 1;
+    if (strcmp(argv[i], "-to") == 0) {
+        i++;
+        if (i >= argc) {
+            printf("Missing store type!\n");
+            return(1);
+        }
+        if (strcmp(argv[i], "file") == 0) {
+            ms.store = OSF_ATTR_STORE_FILE;
+        } else if (strcmp(argv[i], "log") != 0) {
+            printf("Unknown store type: %s\n", argv[i]);
+            return(1);
+        }
+        i++;
+    }
+
+    if (i >= argc) {
+        printf("Missing base_path!\n");
+        return(1);
+    }
+
+    snprintf(path, OS_PATH_MAX, "%s/file", argv[i]);
+    migrate_tree(path, &ms);
+    snprintf(path, OS_PATH_MAX, "%s/hardlink", argv[i]);
+    migrate_tree(path, &ms);
+
+    printf("Migrated %d attributes in %d attribute directories to the %s store.  Failed directories: %d\n",
+           ms.n_attrs, ms.n_dirs, (ms.store == OSF_ATTR_STORE_LOG) ? "log" : "file", ms.n_failed);
+
+    return((ms.n_failed == 0) ? 0 : 1);
+}
@@ -333,6 +333,206 @@ void os_path_split(const char *path, char **dir, char **file)
 
 }
 
+//***********************************************************************
+// os_path_get_multiple_attrs - Opens the object, gets the attributes, and
+//   closes it.  If the OS provides a compound call it's used so this is a
+//   single op instead of 3.
+//***********************************************************************
+
+op_status_t os_path_get_multiple_attrs(object_service_fn_t *os, creds_t *creds, char *path, char *id, char **key, void **val, int *v_size, int n, int max_wait)
+{
+    op_status_t status;
+    os_fd_t *fd;
+    int err;
+
+    if (os->get_multiple_attrs_immediate != NULL) {
+        return(gop_sync_exec_status(os_get_multiple_attrs_immediate(os, creds, path, id, key, val, v_size, n)));
+    }
+
+    err = gop_sync_exec(os_open_object(os, creds, path, OS_MODE_READ_IMMEDIATE, id, &fd, max_wait));
+    if (err != OP_STATE_SUCCESS) {
+        log_printf(1, "ERROR opening object=%s\n", path);
+        return(op_failure_status);
+    }
+
+    //** IF the attribute doesn't exist *val == NULL an *v_size = 0
+    status = gop_sync_exec_status(os_get_multiple_attrs(os, creds, fd, key, val, v_size, n));
+
+    //** Close the parent
+    err = gop_sync_exec(os_close_object(os, fd));
+    if (err != OP_STATE_SUCCESS) {
+        log_printf(1, "ERROR closing object=%s\n", path);
+    }
+
+    return(status);
+}
+
+//***********************************************************************
+// Generic du iterator.  This walks the objects with an alist iterator
+// on the same OS and tallies the file sizes into rollup entries.  When
+// it runs on the OS that holds the namespace only the rollups have to
+// go any further.
+//***********************************************************************
+
+typedef struct {
+    char *fname;
+    int64_t bytes;    //** Bytes in the files under the entry
+    int64_t count;    //** Number of files under the entry
+    int ftype;
+    int seen;         //** The entry itself was returned by the iterator
+    int skip;         //** Ignored symlink
+} os_du_entry_t;
+
+typedef struct {
+    tbx_list_t *table;
+    tbx_list_iter_t lit;
+    int rollup_depth;
+} os_du_iter_generic_t;
+
+//***********************************************************************
+// os_du_rollup_len - Returns the length of the rollup entry's name.  The
+//   object name is cut rollup_depth levels below the prefix.
+//***********************************************************************
+
+int os_du_rollup_len(char *fname, int prefix_len, int rollup_depth)
+{
+    int i, n, len;
+
+    len = strlen(fname);
+    n = (prefix_len < 0) ? 0 : prefix_len;
+    if (n > len) n = len;
+
+    for (i=0; i<rollup_depth; i++) {
+        while (fname[n] == '/') n++;
+        if (fname[n] == 0) break;
+        while ((fname[n] != '/') && (fname[n] != 0)) n++;
+    }
+
+    return(n);
+}
+
+//***********************************************************************
+// os_create_du_iter_generic - Tallies the usage for all the matching objects.
+//   Every object is rolled up into its ancestor rollup_depth levels below
+//   the path prefix.  A rollup_depth of 1 gives the du -s view and 0 a
+//   single total.  The directories need to be in object_types for them
+//   to get an entry.
+//***********************************************************************
+
+os_du_iter_t *os_create_du_iter_generic(object_service_fn_t *os, creds_t *creds, os_regex_table_t *path, os_regex_table_t *obj_regex, int object_types, int recurse_depth, int rollup_depth, int flags)
+{
+    os_du_iter_generic_t *it;
+    os_object_iter_t *oit;
+    os_du_entry_t *de;
+    char *key = "system.exnode.size";
+    char *val, *fname;
+    int64_t bytes;
+    int v_size, ftype, prefix_len, n, is_link;
+    char c;
+
+    v_size = -1024;
+    val = NULL;
+    oit = os_create_object_iter_alist(os, creds, path, obj_regex, object_types, recurse_depth, &key, (void **)&val, &v_size, 1);
+    if (oit == NULL) {
+        log_printf(1, "ERROR creating the object iter!\n");
+        return(NULL);
+    }
+
+    tbx_type_malloc_clear(it, os_du_iter_generic_t, 1);
+    it->table = tbx_list_create(0, &tbx_list_string_compare, NULL, tbx_list_no_key_free, tbx_list_no_data_free);
+    it->rollup_depth = rollup_depth;
+
+    while ((ftype = os_next_object(os, oit, &fname, &prefix_len)) > 0) {
+        bytes = 0;
+        if (val != NULL) {
+            sscanf(val, I64T, &bytes);
+            free(val);
+            val = NULL;
+        }
+        v_size = -1024;
+
+        //** Find the rollup entry
+        n = os_du_rollup_len(fname, prefix_len, rollup_depth);
+        c = fname[n];
+        fname[n] = 0;
+        de = tbx_list_search(it->table, (n > 0) ? fname : "/");
+        if (de == NULL) {
+            tbx_type_malloc_clear(de, os_du_entry_t, 1);
+            de->fname = strdup((n > 0) ? fname : "/");
+            de->ftype = OS_OBJECT_DIR;  //** If it isn't the object itself it's a parent
+            tbx_list_insert(it->table, de->fname, de);
+        }
+        fname[n] = c;
+
+        is_link = ((flags & OS_DU_IGNORE_LINKS) && (ftype & OS_OBJECT_SYMLINK)) ? 1 : 0;
+        if (c == 0) {  //** It's the entry itself
+            de->ftype = ftype;
+            de->seen = 1;
+            de->skip = is_link;
+        }
+
+        if ((ftype & OS_OBJECT_FILE) && (is_link == 0)) {
+            de->bytes += bytes;
+            de->count++;
+        }
+
+        free(fname);
+    }
+
+    os_destroy_object_iter(os, oit);
+
+    log_printf(5, "n_entries=%d\n", tbx_list_key_count(it->table));
+    it->lit = tbx_list_iter_search(it->table, NULL, 0);
+    return(it);
+}
+
+//***********************************************************************
+// os_next_du_generic - Returns the next rollup entry in sorted order.
+//   The object type is returned, or 0 when finished, and the caller owns
+//   the name.
+//***********************************************************************
+
+int os_next_du_generic(object_service_fn_t *os, os_du_iter_t *oit, char **fname, int64_t *bytes, int64_t *count)
+{
+    os_du_iter_generic_t *it = (os_du_iter_generic_t *)oit;
+    os_du_entry_t *de;
+    char *key;
+
+    while (tbx_list_next(&(it->lit), (tbx_list_key_t **)&key, (tbx_list_data_t **)&de) == 0) {
+        if (de->skip == 1) continue;
+        if ((de->seen == 0) && (it->rollup_depth > 0)) continue;  //** The entry itself didn't match
+
+        *fname = strdup(de->fname);
+        *bytes = de->bytes;
+        *count = de->count;
+        return(de->ftype);
+    }
+
+    *fname = NULL;
+    return(0);
+}
+
+//***********************************************************************
+// os_destroy_du_iter_generic - Destroys the du iterator
+//***********************************************************************
+
+void os_destroy_du_iter_generic(object_service_fn_t *os, os_du_iter_t *oit)
+{
+    os_du_iter_generic_t *it = (os_du_iter_generic_t *)oit;
+    tbx_list_iter_t lit;
+    os_du_entry_t *de;
+    char *key;
+
+    lit = tbx_list_iter_search(it->table, NULL, 0);
+    while (tbx_list_next(&lit, (tbx_list_key_t **)&key, (tbx_list_data_t **)&de) == 0) {
+        free(de->fname);
+        free(de);
+    }
+
+    tbx_list_destroy(it->table);
+    free(it);
+}
+
 //***********************************************************************
 // os_regex_table_pack - Packs a regex table into the buffer and returns
 //   the number of chars used or a negative value representing the needed space
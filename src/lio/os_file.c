@@ -23,6 +23,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <dirent.h>
+#include <limits.h>
 #include <unistd.h>
 #include <assert.h>
 #include <tbx/assert_result.h>
@@ -41,6 +42,7 @@
 #include "thread_pool.h"
 #include "os_file.h"
 #include "os_file_priv.h"
+#include "os_file_attr_log.h"
 #include <tbx/append_printf.h>
 
 //tbx_atomic_unit32_t _path_parse_count = 0;
@@ -100,6 +102,8 @@ typedef struct {
     apr_pool_t       *mpool;  //** Needa separate pool for making the va_index. Only way to do this since no apr_hash_iter_destroy fn exists
     apr_hash_index_t *va_index;
     os_regex_table_t *regex;
+    osf_alog_t *alog;
+    int alog_index;
     char *key;
     void *value;
     int v_max;
@@ -235,6 +239,8 @@ char *resolve_hardlink(object_service_fn_t *os, char *src_path, int add_prefix);
 apr_thread_mutex_t *osf_retrieve_lock(object_service_fn_t *os, char *path, int *table_slot);
 int osf_set_attr(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char *attr, void *val, int v_size, int *atype, int append_val);
 int osf_get_attr(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char *attr, void **val, int *v_size, int *atype);
+int osf_get_attr_alog(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char *attr, void **val, int *v_size, int *atype, osf_alog_t *alog);
+int osf_set_attr_alog(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char *attr, void *val, int v_size, int *atype, int append_val, osf_alog_t *alog);
 op_generic_t *osfile_set_attr(object_service_fn_t *os, creds_t *creds, os_fd_t *fd, char *key, void *val, int v_size);
 os_attr_iter_t *osfile_create_attr_iter(object_service_fn_t *os, creds_t *creds, os_fd_t *ofd, os_regex_table_t *attr, int v_max);
 void osfile_destroy_attr_iter(os_attr_iter_t *oit);
@@ -1011,6 +1017,7 @@ int va_attr_type_get_attr(os_virtual_attr_t *myva, object_service_fn_t *os, cred
     osfile_fd_t *fd = (osfile_fd_t *)ofd;
     osfile_priv_t *osf = (osfile_priv_t *)fd->os->priv;
     os_virtual_attr_t *va;
+    osf_alog_t *alog;
     int ftype, bufsize, n;
     char *key;
     char buffer[32];
@@ -1030,6 +1037,11 @@ int va_attr_type_get_attr(os_virtual_attr_t *myva, object_service_fn_t *os, cred
         snprintf(fullname, OS_PATH_MAX, "%s/%s", fd->attr_dir, key);
         ftype = os_local_filetype(fullname);
         if (ftype & OS_OBJECT_BROKEN_LINK) ftype = ftype ^ OS_OBJECT_BROKEN_LINK;
+        if ((ftype == 0) && (osf->attr_store == OSF_ATTR_STORE_LOG)) {
+            alog = osf_alog_load(fd->attr_dir);
+            if (osf_alog_exists(alog, key) == 1) ftype = OS_OBJECT_FILE;
+            osf_alog_destroy(alog);
+        }
     }
 
     snprintf(buffer, sizeof(buffer), "%d", ftype);
@@ -2570,6 +2582,7 @@ op_status_t osfile_copy_multiple_attrs_fn(void *arg, int id)
     osfile_priv_t *osf = (osfile_priv_t *)op->os->priv;
     op_status_t status;
     apr_thread_mutex_t *lock_src, *lock_dest;
+    osf_alog_t *alog_src, *alog_dest;
     void *val;
     int v_size;
     int slot_src, slot_dest;
@@ -2589,6 +2602,11 @@ op_status_t osfile_copy_multiple_attrs_fn(void *arg, int id)
         osf_obj_lock(lock_src);
     }
 
+    alog_src = alog_dest = NULL;
+    if (osf->attr_store == OSF_ATTR_STORE_LOG) {
+        alog_dest = osf_alog_load(op->fd_dest->attr_dir);
+        alog_src = (strcmp(op->fd_src->attr_dir, op->fd_dest->attr_dir) == 0) ? alog_dest : osf_alog_load(op->fd_src->attr_dir);
+    }
 
     status = op_success_status;
     for (i=0; i<op->n; i++) {
@@ -2598,9 +2616,9 @@ op_status_t osfile_copy_multiple_attrs_fn(void *arg, int id)
 
             v_size = -osf->max_copy;
             val = NULL;
-            err = osf_get_attr(op->os, op->creds, op->fd_src, op->key_src[i], &val, &v_size, &atype);
+            err = osf_get_attr_alog(op->os, op->creds, op->fd_src, op->key_src[i], &val, &v_size, &atype, alog_src);
             if (err == 0) {
-                err = osf_set_attr(op->os, op->creds, op->fd_dest, op->key_dest[i], val, v_size, &atype, 0);
+                err = osf_set_attr_alog(op->os, op->creds, op->fd_dest, op->key_dest[i], val, v_size, &atype, 0, alog_dest);
                 free(val);
                 if (err != 0) {
                     status.op_status = OP_STATE_FAILURE;
@@ -2616,6 +2634,15 @@ op_status_t osfile_copy_multiple_attrs_fn(void *arg, int id)
         }
     }
 
+    if (alog_dest != NULL) {
+        if (osf_alog_flush(alog_dest) != 0) {
+            status.op_status = OP_STATE_FAILURE;
+            status.error_code++;
+        }
+        if (alog_src != alog_dest) osf_alog_destroy(alog_src);
+        osf_alog_destroy(alog_dest);
+    }
+
     osf_obj_unlock(lock_src);
     if (lock_dest != NULL) osf_obj_unlock(lock_dest);
 
@@ -2670,6 +2697,65 @@ op_generic_t *osfile_copy_attr(object_service_fn_t *os, creds_t *creds, os_fd_t
     return(new_thread_pool_op(osf->tpc, NULL, osfile_copy_multiple_attrs_fn, (void *)op, free, 1));
 }
 
+//***********************************************************************
+// osf_attr_log_spill - Moves an attribute out of the log and into its own
+//     file so it can be the target of an attribute symlink.  Relative
+//     paths are resolved the same way osf_resolve_attr_path does.
+//***********************************************************************
+
+void osf_attr_log_spill(object_service_fn_t *os, osfile_fd_t *fd_link, char *src_path, char *key)
+{
+    osfile_priv_t *osf = (osfile_priv_t *)os->priv;
+    apr_thread_mutex_t *lock;
+    osf_alog_t *alog;
+    FILE *fd;
+    void *val;
+    char *attr_dir, *pdir, *pfile;
+    int v_size, ftype;
+    char path[OS_PATH_MAX];
+    char fname[OS_PATH_MAX];
+
+    if (src_path[0] == '/') {
+        snprintf(path, OS_PATH_MAX, "%s", src_path);
+    } else if ((fd_link->ftype & OS_OBJECT_DIR) && ((fd_link->ftype & OS_OBJECT_SYMLINK) == 0)) {
+        snprintf(path, OS_PATH_MAX, "%s/%s", fd_link->object_name, src_path);
+    } else {
+        os_path_split(fd_link->object_name, &pdir, &pfile);
+        snprintf(path, OS_PATH_MAX, "%s/%s", pdir, src_path);
+        free(pdir);
+        free(pfile);
+    }
+
+    snprintf(fname, OS_PATH_MAX, "%s%s", osf->file_path, path);
+    ftype = os_local_filetype(fname);
+    if (ftype == 0) return;
+    attr_dir = object_attr_dir(os, osf->file_path, path, ftype);
+
+    lock = osf_retrieve_lock(os, path, NULL);
+    osf_obj_lock(lock);
+
+    alog = osf_alog_load(attr_dir);
+    v_size = -INT_MAX;
+    val = NULL;
+    if (osf_alog_get(alog, key, &val, &v_size) == 0) {
+        snprintf(fname, OS_PATH_MAX, "%s/%s", attr_dir, key);
+        fd = fopen(fname, "w");
+        if (fd != NULL) {
+            if (v_size > 0) fwrite(val, v_size, 1, fd);
+            fclose(fd);
+            osf_alog_set(alog, key, NULL, -1, 0);
+            osf_alog_flush(alog);
+        } else {
+            log_printf(0, "ERROR spilling attr fname=%s\n", fname);
+        }
+        free(val);
+    }
+    osf_alog_destroy(alog);
+
+    osf_obj_unlock(lock);
+    free(attr_dir);
+}
+
 //***********************************************************************
 // osfile_symlink_multiple_attrs_fn - Actually links the multiple attrs
 //***********************************************************************
@@ -2685,6 +2771,12 @@ op_status_t osfile_symlink_multiple_attrs_fn(void *arg, int id)
     int slot_dest;
     int i, err;
 
+    //** Link targets have to be real files.  This is done before locking the dest
+    //** since the source has to be locked while it's being changed.
+    if (osf->attr_store == OSF_ATTR_STORE_LOG) {
+        for (i=0; i<op->n; i++) osf_attr_log_spill(op->os, op->fd_dest, op->src_path[i], op->key_src[i]);
+    }
+
     //** Lock the source
     lock_dest = osf_retrieve_lock(op->os, op->fd_dest->object_name, &slot_dest);
     osf_obj_lock(lock_dest);
@@ -2779,13 +2871,18 @@ op_status_t osfile_move_multiple_attrs_fn(void *arg, int id)
     os_virtual_attr_t *va1, *va2;
     op_status_t status;
     apr_thread_mutex_t *lock;
-    int i, err;
+    osf_alog_t *alog;
+    struct stat s;
+    void *val;
+    int i, err, v_size;
     char sfname[OS_PATH_MAX];
     char dfname[OS_PATH_MAX];
 
     lock = osf_retrieve_lock(op->os, op->fd->object_name, NULL);
     osf_obj_lock(lock);
 
+    alog = (osf->attr_store == OSF_ATTR_STORE_LOG) ? osf_alog_load(op->fd->attr_dir) : NULL;
+
     status = op_success_status;
     for (i=0; i<op->n; i++) {
         if ((osaz_attr_create(osf->osaz, op->creds, op->fd->object_name, op->key_new[i]) == 1) &&
@@ -2799,7 +2896,20 @@ op_status_t osfile_move_multiple_attrs_fn(void *arg, int id)
             } else {
                 snprintf(sfname, OS_PATH_MAX, "%s/%s", op->fd->attr_dir, op->key_old[i]);
                 snprintf(dfname, OS_PATH_MAX, "%s/%s", op->fd->attr_dir, op->key_new[i]);
-                err = rename(sfname, dfname);
+                if ((alog != NULL) && (lstat(sfname, &s) != 0)) {  //** It's in the log
+                    v_size = -INT_MAX;
+                    val = NULL;
+                    err = osf_alog_get(alog, op->key_old[i], &val, &v_size);
+                    if (err == 0) {
+                        if (lstat(dfname, &s) == 0) safe_remove(op->os, dfname);
+                        osf_alog_set(alog, op->key_new[i], val, v_size, 0);
+                        osf_alog_set(alog, op->key_old[i], NULL, -1, 0);
+                        free(val);
+                    }
+                } else {
+                    err = rename(sfname, dfname);
+                    if ((err == 0) && (alog != NULL)) osf_alog_set(alog, op->key_new[i], NULL, -1, 0);
+                }
             }
 
             if (err != 0) {
@@ -2812,6 +2922,14 @@ op_status_t osfile_move_multiple_attrs_fn(void *arg, int id)
         }
     }
 
+    if (alog != NULL) {
+        if (osf_alog_flush(alog) != 0) {
+            status.op_status = OP_STATE_FAILURE;
+            status.error_code++;
+        }
+        osf_alog_destroy(alog);
+    }
+
     osf_obj_unlock(lock);
 
     return(status);
@@ -2866,10 +2984,22 @@ op_generic_t *osfile_move_attr(object_service_fn_t *os, creds_t *creds, os_fd_t
 //***********************************************************************
 
 int osf_get_attr(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char *attr, void **val, int *v_size, int *atype)
+{
+    return(osf_get_attr_alog(os, creds, ofd, attr, val, v_size, atype, NULL));
+}
+
+//***********************************************************************
+// osf_get_attr_alog - Gets the attribute using an already loaded attribute
+//     log.  If alog is NULL and the log store is used it's loaded just for
+//     this attribute.
+//***********************************************************************
+
+int osf_get_attr_alog(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char *attr, void **val, int *v_size, int *atype, osf_alog_t *alog)
 {
     osfile_priv_t *osf = (osfile_priv_t *)os->priv;
     os_virtual_attr_t *va;
     tbx_list_iter_t it;
+    osf_alog_t *a;
     char *ca;
     FILE *fd;
     char fname[OS_PATH_MAX];
@@ -2904,7 +3034,17 @@ int osf_get_attr(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char
     }
 
 
-    //** Lastly look at the actual attributes
+    //** Lastly look at the actual attributes.  Anything in the log can't also be a file.
+    if (osf->attr_store == OSF_ATTR_STORE_LOG) {
+        a = (alog == NULL) ? osf_alog_load(ofd->attr_dir) : alog;
+        n = osf_alog_get(a, attr, val, v_size);
+        if (alog == NULL) osf_alog_destroy(a);
+        if (n == 0) {
+            *atype = OS_OBJECT_FILE;
+            return(0);
+        }
+    }
+
     n = osf_resolve_attr_path(os, fname, ofd->object_name, attr, ofd->ftype, atype, 20);
 //  snprintf(fname, OS_PATH_MAX, "%s/%s", ofd->attr_dir, attr);
     log_printf(15, "fname=%s *v_size=%d resolve=%d\n", fname, *v_size, n);
@@ -2957,17 +3097,21 @@ int osf_get_attr(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char
 op_status_t osf_get_ma_links(void *arg, int id, int first_link)
 {
     osfile_attr_op_t *op = (osfile_attr_op_t *)arg;
+    osfile_priv_t *osf = (osfile_priv_t *)op->os->priv;
     int err, i, atype, n_locks;
     apr_thread_mutex_t *lock_table[op->n+1];
+    osf_alog_t *alog;
     op_status_t status;
 
     status = op_success_status;
 
     osf_multi_lock(op->os, op->creds, op->fd, op->key, op->n, first_link, lock_table, &n_locks);
 
+    alog = (osf->attr_store == OSF_ATTR_STORE_LOG) ? osf_alog_load(op->fd->attr_dir) : NULL;
+
     err = 0;
     for (i=0; i<op->n; i++) {
-        err += osf_get_attr(op->os, op->creds, op->fd, op->key[i], (void **)&(op->val[i]), &(op->v_size[i]), &atype);
+        err += osf_get_attr_alog(op->os, op->creds, op->fd, op->key[i], (void **)&(op->val[i]), &(op->v_size[i]), &atype, alog);
         if (op->v_size[i] > 0) {
             log_printf(15, "PTR i=%d key=%s val=%s v_size=%d\n", i, op->key[i], (char *)op->val[i], op->v_size[i]);
         } else {
@@ -2975,6 +3119,8 @@ op_status_t osf_get_ma_links(void *arg, int id, int first_link)
         }
     }
 
+    if (alog != NULL) osf_alog_destroy(alog);
+
     osf_multi_unlock(lock_table, n_locks);
 
     if (err != 0) status = op_failure_status;
@@ -2990,22 +3136,27 @@ op_status_t osf_get_ma_links(void *arg, int id, int first_link)
 op_status_t osf_get_multiple_attr_fn(void *arg, int id)
 {
     osfile_attr_op_t *op = (osfile_attr_op_t *)arg;
+    osfile_priv_t *osf = (osfile_priv_t *)op->os->priv;
 //  apr_time_t date;
 //  char timestamp[OS_PATH_MAX];
     int err, i, j, atype, v_start[op->n], oops;
     op_status_t status;
     apr_thread_mutex_t *lock;
+    osf_alog_t *alog;
 
     status = op_success_status;
 
     lock = osf_retrieve_lock(op->os, op->fd->object_name, NULL);
     osf_obj_lock(lock);
 
+    //** All the attributes in the log come from a single read
+    alog = (osf->attr_store == OSF_ATTR_STORE_LOG) ? osf_alog_load(op->fd->attr_dir) : NULL;
+
     err = 0;
     oops = 0;
     for (i=0; i<op->n; i++) {
         v_start[i] = op->v_size[i];
-        err += osf_get_attr(op->os, op->creds, op->fd, op->key[i], (void **)&(op->val[i]), &(op->v_size[i]), &atype);
+        err += osf_get_attr_alog(op->os, op->creds, op->fd, op->key[i], (void **)&(op->val[i]), &(op->v_size[i]), &atype, alog);
         if (op->v_size[i] != 0) {
             log_printf(15, "PTR i=%d key=%s val=%s v_size=%d atype=%d err=%d\n", i, op->key[i], (char *)op->val[i], op->v_size[i], atype, err);
         } else {
@@ -3022,6 +3173,8 @@ op_status_t osf_get_multiple_attr_fn(void *arg, int id)
 //  snprintf(timestamp, OS_PATH_MAX, TT "|%s|%s", date, cred_get_id(op->creds), op->fd->id);
 //  lowlevel_set_attr(op->os, op->fd->attr_dir, "system.access", timestamp, strlen(timestamp));
 
+    if (alog != NULL) osf_alog_destroy(alog);
+
     osf_obj_unlock(lock);
 
     if (oops == 1) { //** Multi object locking required
@@ -3101,10 +3254,22 @@ op_generic_t *osfile_get_multiple_attrs(object_service_fn_t *os, creds_t *creds,
 
 int lowlevel_set_attr(object_service_fn_t *os, char *attr_dir, char *attr, void *val, int v_size)
 {
+    osfile_priv_t *osf = (osfile_priv_t *)os->priv;
+    osf_alog_t *alog;
+    struct stat s;
     FILE *fd;
     char fname[OS_PATH_MAX];
+    int err;
 
     snprintf(fname, OS_PATH_MAX, "%s/%s", attr_dir, attr);
+    if ((osf->attr_store == OSF_ATTR_STORE_LOG) && ((v_size < 0) || (lstat(fname, &s) != 0))) {
+        alog = osf_alog_load(attr_dir);
+        osf_alog_set(alog, attr, val, v_size, 0);
+        err = osf_alog_flush(alog);
+        osf_alog_destroy(alog);
+        if (v_size >= 0) return(err);
+    }
+
     if (v_size < 0) { //** Want to remove the attribute
         safe_remove(os, fname);
     } else {
@@ -3122,11 +3287,50 @@ int lowlevel_set_attr(object_service_fn_t *os, char *attr_dir, char *attr, void
 //***********************************************************************
 
 int osf_set_attr(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char *attr, void *val, int v_size, int *atype, int append_val)
+{
+    return(osf_set_attr_alog(os, creds, ofd, attr, val, v_size, atype, append_val, NULL));
+}
+
+//***********************************************************************
+// osf_set_attr_log - Stores the attribute in the log.  If alog is NULL the
+//     log is loaded and flushed just for this attribute.
+//***********************************************************************
+
+int osf_set_attr_log(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char *attr, void *val, int v_size, int append_val, osf_alog_t *alog)
+{
+    osfile_priv_t *osf = (osfile_priv_t *)os->priv;
+    osf_alog_t *a;
+    int err;
+
+    a = (alog == NULL) ? osf_alog_load(ofd->attr_dir) : alog;
+
+    err = 0;
+    if ((v_size >= 0) && (osf_alog_exists(a, attr) == 0)) {
+        if (osaz_attr_create(osf->osaz, creds, ofd->object_name, attr) == 0) err = 1;
+    }
+
+    if (err == 0) osf_alog_set(a, attr, val, v_size, append_val);
+
+    if (alog == NULL) {
+        if (err == 0) err = osf_alog_flush(a);
+        osf_alog_destroy(a);
+    }
+
+    return(err);
+}
+
+//***********************************************************************
+// osf_set_attr_alog - Sets the attribute using an already loaded attribute log.
+//     Updates are only staged in the log so the caller must flush it.
+//***********************************************************************
+
+int osf_set_attr_alog(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char *attr, void *val, int v_size, int *atype, int append_val, osf_alog_t *alog)
 {
     osfile_priv_t *osf = (osfile_priv_t *)os->priv;
     tbx_list_iter_t it;
     FILE *fd;
     os_virtual_attr_t *va;
+    struct stat s;
     int n;
     char *ca;
     char fname[OS_PATH_MAX];
@@ -3155,11 +3359,21 @@ int osf_set_attr(object_service_fn_t *os, creds_t *creds, osfile_fd_t *ofd, char
 
     if (v_size < 0) { //** Want to remove the attribute
         if (osaz_attr_remove(osf->osaz, creds, ofd->object_name, attr) == 0) return(1);
+        if (osf->attr_store == OSF_ATTR_STORE_LOG) osf_set_attr_log(os, creds, ofd, attr, NULL, -1, 0, alog);
         snprintf(fname, OS_PATH_MAX, "%s/%s", ofd->attr_dir, attr);
         safe_remove(os, fname);
         return(0);
     }
 
+    //** Existing attribute files and links take precedence over the log
+    if (osf->attr_store == OSF_ATTR_STORE_LOG) {
+        snprintf(fname, OS_PATH_MAX, "%s/%s", ofd->attr_dir, attr);
+        if (lstat(fname, &s) != 0) {
+            *atype = OS_OBJECT_FILE;
+            return(osf_set_attr_log(os, creds, ofd, attr, val, v_size, append_val, alog));
+        }
+    }
+
     n = osf_resolve_attr_path(os, fname, ofd->object_name, attr, ofd->ftype, atype, 20);
     if (n != 0) {
         log_printf(15, "ERROR resolving path: fname=%s object_name=%s attr=%s\n", fname, ofd->object_name, attr);
@@ -3191,17 +3405,27 @@ op_status_t osf_set_multiple_attr_fn(void *arg, int id)
 //op_status_t osf_set_ma_links(void *arg, int id, int first_link)
 {
     osfile_attr_op_t *op = (osfile_attr_op_t *)arg;
+    osfile_priv_t *osf = (osfile_priv_t *)op->os->priv;
     int err, i, atype, n_locks;
     apr_thread_mutex_t *lock_table[op->n+1];
+    osf_alog_t *alog;
     op_status_t status;
 
     status = op_success_status;
 
     osf_multi_lock(op->os, op->creds, op->fd, op->key, op->n, 0, lock_table, &n_locks);
 
+    //** Everything destined for the log goes out in a single append
+    alog = (osf->attr_store == OSF_ATTR_STORE_LOG) ? osf_alog_load(op->fd->attr_dir) : NULL;
+
     err = 0;
     for (i=0; i<op->n; i++) {
-        err += osf_set_attr(op->os, op->creds, op->fd, op->key[i], op->val[i], op->v_size[i], &atype, 0);
+        err += osf_set_attr_alog(op->os, op->creds, op->fd, op->key[i], op->val[i], op->v_size[i], &atype, 0, alog);
+    }
+
+    if (alog != NULL) {
+        if (osf_alog_flush(alog) != 0) err++;
+        osf_alog_destroy(alog);
     }
 
     osf_multi_unlock(lock_table, n_locks);
@@ -3296,6 +3520,23 @@ int osfile_next_attr(os_attr_iter_t *oit, char **key, void **val, int *v_size)
 //     it->va_index = apr_hash_next(it->va_index);
     }
 
+    //** Then anything in the attribute log
+    if (it->alog != NULL) {
+        while (osf_alog_next(it->alog, &(it->alog_index), key) == 0) {
+            for (i=0; i<rex->n; i++) {
+                n = (rex->regex_entry[i].fixed == 1) ? strcmp(rex->regex_entry[i].expression, *key) : regexec(&(rex->regex_entry[i].compiled), *key, 0, NULL, 0);
+                if (n == 0) { //** got a match
+                    if (osaz_attr_access(osf->osaz, it->creds, it->fd->object_name, *key, OS_MODE_READ_BLOCKING) == 1) {
+                        *v_size = it->v_max;
+                        osf_alog_get(it->alog, *key, val, v_size);
+                        *key = strdup(*key);
+                        return(0);
+                    }
+                }
+            }
+        }
+    }
+
     if (it->d == NULL) {
         log_printf(0, "ERROR: it->d=NULL\n");
         return(-1);
@@ -3350,6 +3591,7 @@ os_attr_iter_t *osfile_create_attr_iter(object_service_fn_t *os, creds_t *creds,
     it->va_index = apr_hash_first(it->mpool, osf->vattr_hash);
 
     it->d = opendir(fd->attr_dir);
+    if (osf->attr_store == OSF_ATTR_STORE_LOG) it->alog = osf_alog_load(fd->attr_dir);
     it->regex = attr;
     it->fd = fd;
     it->creds = creds;
@@ -3366,6 +3608,7 @@ void osfile_destroy_attr_iter(os_attr_iter_t *oit)
 {
     osfile_attr_iter_t *it = (osfile_attr_iter_t *)oit;
     if (it->d != NULL) closedir(it->d);
+    if (it->alog != NULL) osf_alog_destroy(it->alog);
 
     apr_pool_destroy(it->mpool);
     free(it);
@@ -3922,7 +4165,7 @@ int osf_next_fsck(os_fsck_iter_t *oit, char **fname)
 
     if (it->ad != NULL) {  //** Checking attribute dir
         while ((entry = readdir(it->ad)) != NULL) {
-            if (strncmp(entry->d_name, FILE_ATTR_PREFIX, FILE_ATTR_PREFIX_LEN) == 0) {  //** Got a match
+            if ((strncmp(entry->d_name, FILE_ATTR_PREFIX, FILE_ATTR_PREFIX_LEN) == 0) && (strcmp(entry->d_name, OSF_ALOG_NAME) != 0)) {  //** Got a match
                 snprintf(fullname, OS_PATH_MAX, "%s/%s", it->ad_path, &(entry->d_name[FILE_ATTR_PREFIX_LEN]));
                 log_printf(15, "ad_path=%s fname=%s d_name=%s\n", it->ad_path, fullname, entry->d_name);
                 *fname = strdup(fullname);
@@ -4172,11 +4415,15 @@ object_service_fn_t *object_service_file_create(service_manager_t *ess, tbx_inip
         osf->internal_lock_size = 200;
         osf->max_copy = 1024*1024;
         osf->hardlink_dir_size = 256;
+        osf->attr_store = OSF_ATTR_STORE_FILE;
     } else {
         osf->base_path = tbx_inip_get_string(fd, section, "base_path", "./osfile");
         osf->internal_lock_size = tbx_inip_get_integer(fd, section, "lock_table_size", 200);
         osf->max_copy = tbx_inip_get_integer(fd, section, "max_copy", 1024*1024);
         osf->hardlink_dir_size = tbx_inip_get_integer(fd, section, "hardlink_dir_size", 256);
+        atype = tbx_inip_get_string(fd, section, "attr_store", "file");
+        osf->attr_store = (strcmp(atype, "log") == 0) ? OSF_ATTR_STORE_LOG : OSF_ATTR_STORE_FILE;
+        free(atype);
         asection = tbx_inip_get_string(fd, section, "authz", NULL);
         atype = (asection == NULL) ? strdup(OSAZ_TYPE_FAKE) : tbx_inip_get_string(fd, asection, "type", OSAZ_TYPE_FAKE);
         osaz_create = lookup_service(ess, OSAZ_AVAILABLE, atype);
@@ -4316,6 +4563,9 @@ object_service_fn_t *object_service_file_create(service_manager_t *ess, tbx_inip
     os->create_object_iter_alist = osfile_create_object_iter_alist;
     os->next_object = osfile_next_object;
     os->destroy_object_iter = osfile_destroy_object_iter;
+    os->create_du_iter = os_create_du_iter_generic;  //** We hold the namespace so tally it right here
+    os->next_du = os_next_du_generic;
+    os->destroy_du_iter = os_destroy_du_iter_generic;
     os->open_object = osfile_open_object;
     os->close_object = osfile_close_object;
     os->abort_open_object = osfile_abort_open_object;
@@ -0,0 +1,708 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//***********************************************************************
+// Log structured attribute store for the file object service.
+//
+// All the attributes for an object are kept in a single append only log
+// in the object's attribute directory.  Each record is a header followed by
+// the NULL terminated key and the value.  A removal is a record with a
+// negative value size.  Loading the log is one read and the latest record
+// for each key is indexed in memory.  Updates are staged and appended with
+// a single write.  Once the dead records outweigh the live ones the log is
+// rewritten and renamed over the old one.
+//
+// Callers are expected to hold the object lock while using a log.
+//***********************************************************************
+
+#define _log_module_index 228
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <tbx/atomic_counter.h>
+#include <tbx/fmttypes.h>
+#include <tbx/log.h>
+#include <tbx/type_malloc.h>
+#include "os_file_priv.h"
+#include "os_file_attr_log.h"
+
+#define OSF_ALOG_MAGIC 0x4c414641       //** "AFAL"
+#define OSF_ALOG_COMPACT_MIN 4096       //** Don't bother compacting logs smaller than this
+#define OSF_ALOG_MODE (S_IRUSR|S_IWUSR|S_IRGRP|S_IWGRP|S_IROTH|S_IWOTH)
+#define OSF_ALOG_TEMP_TRIES 16          //** Attempts at a unique compaction file name
+
+typedef struct {
+    uint32_t magic;
+    uint32_t klen;      //** Includes the NULL terminator
+    int32_t v_size;     //** -1 is a removal
+} osf_alog_rec_t;
+
+typedef struct {
+    char *key;
+    char *val;
+    int klen;
+    int v_size;         //** -1 if the key has been removed
+    int key_own;        //** Key/val were malloced instead of pointing into the load buffer
+    int val_own;
+} osf_alog_entry_t;
+
+static tbx_atomic_unit32_t _alog_temp_seq = 0;
+
+struct osf_alog_s {
+    char *fname;
+    char *buf;          //** Log contents as loaded
+    osf_alog_entry_t *entry;
+    int *slot;          //** Open addressed index into entry
+    int n;
+    int n_max;
+    int n_slots;
+    int64_t size;       //** Bytes of valid records on disk
+    int64_t file_size;  //** Actual file size.  Larger than size if the tail is torn
+    int64_t live;       //** Bytes used by the latest record of each live key
+    char *pending;      //** Staged records waiting to be flushed
+    int p_used;
+    int p_max;
+};
+
+//***********************************************************************
+// _alog_hash - FNV-1a hash of the key
+//***********************************************************************
+
+uint32_t _alog_hash(char *key, int klen)
+{
+    uint32_t h = 2166136261u;
+    int i;
+
+    for (i=0; i<klen; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 16777619u;
+    }
+
+    return(h);
+}
+
+//***********************************************************************
+// _alog_find - Returns the entry index for the key or -1
+//***********************************************************************
+
+int _alog_find(osf_alog_t *a, char *key, int klen)
+{
+    uint32_t mask;
+    int i, j;
+
+    if (a->n_slots == 0) return(-1);
+
+    mask = a->n_slots - 1;
+    for (i = _alog_hash(key, klen) & mask; (j = a->slot[i]) != -1; i = (i+1) & mask) {
+        if ((a->entry[j].klen == klen) && (memcmp(a->entry[j].key, key, klen) == 0)) return(j);
+    }
+
+    return(-1);
+}
+
+//***********************************************************************
+// _alog_slot_insert - Adds the entry to the index
+//***********************************************************************
+
+void _alog_slot_insert(osf_alog_t *a, int j)
+{
+    uint32_t mask;
+    int i;
+
+    mask = a->n_slots - 1;
+    for (i = _alog_hash(a->entry[j].key, a->entry[j].klen) & mask; a->slot[i] != -1; i = (i+1) & mask) ;
+    a->slot[i] = j;
+}
+
+//***********************************************************************
+// _alog_reindex - Grows the index and reinserts all the entries
+//***********************************************************************
+
+void _alog_reindex(osf_alog_t *a)
+{
+    int i;
+
+    a->n_slots = (a->n_slots == 0) ? 64 : 2*a->n_slots;
+    free(a->slot);
+    tbx_type_malloc(a->slot, int, a->n_slots);
+    for (i=0; i<a->n_slots; i++) a->slot[i] = -1;
+
+    for (i=0; i<a->n; i++) _alog_slot_insert(a, i);
+}
+
+//***********************************************************************
+// _alog_apply - Makes the record the current value for the key.  If copy is
+//    set the key and value are duplicated.
+//***********************************************************************
+
+void _alog_apply(osf_alog_t *a, char *key, int klen, char *val, int v_size, int copy)
+{
+    osf_alog_entry_t *e;
+    int i;
+
+    i = _alog_find(a, key, klen);
+    if (i == -1) {
+        if (a->n == a->n_max) {
+            a->n_max = (a->n_max == 0) ? 16 : 2*a->n_max;
+            tbx_type_realloc(a->entry, osf_alog_entry_t, a->n_max);
+        }
+        if (2*(a->n+1) > a->n_slots) _alog_reindex(a);
+
+        i = a->n;
+        a->n++;
+        e = &(a->entry[i]);
+        memset(e, 0, sizeof(osf_alog_entry_t));
+        e->klen = klen;
+        e->v_size = -1;
+        if (copy) {
+            tbx_type_malloc(e->key, char, klen);
+            memcpy(e->key, key, klen);
+            e->key_own = 1;
+        } else {
+            e->key = key;
+        }
+        _alog_slot_insert(a, i);
+    } else {
+        e = &(a->entry[i]);
+    }
+
+    //** Retire the old value
+    if (e->v_size >= 0) a->live -= sizeof(osf_alog_rec_t) + e->klen + e->v_size;
+    if (e->val_own) free(e->val);
+    e->val = NULL;
+    e->val_own = 0;
+
+    e->v_size = v_size;
+    if (v_size < 0) return;
+
+    a->live += sizeof(osf_alog_rec_t) + klen + v_size;
+    if (copy) {
+        tbx_type_malloc(e->val, char, v_size + 1);
+        if (v_size > 0) memcpy(e->val, val, v_size);
+        e->val_own = 1;
+    } else {
+        e->val = val;
+    }
+}
+
+//***********************************************************************
+// _alog_parse - Indexes the records in the load buffer
+//***********************************************************************
+
+void _alog_parse(osf_alog_t *a)
+{
+    osf_alog_rec_t rec;
+    int64_t off, rlen;
+
+    off = 0;
+    while (off + (int64_t)sizeof(rec) <= a->file_size) {
+        memcpy(&rec, a->buf + off, sizeof(rec));
+        rlen = sizeof(rec) + rec.klen + ((rec.v_size > 0) ? rec.v_size : 0);
+        if ((rec.magic != OSF_ALOG_MAGIC) || (rec.klen == 0) || (rec.v_size < -1) ||
+                (off + rlen > a->file_size) || (a->buf[off + sizeof(rec) + rec.klen - 1] != 0)) {
+            break;
+        }
+
+        _alog_apply(a, a->buf + off + sizeof(rec), rec.klen, a->buf + off + sizeof(rec) + rec.klen, rec.v_size, 0);
+        off += rlen;
+    }
+
+    if (off != a->file_size) {
+        log_printf(0, "ERROR: Torn attribute log fname=%s size=" I64T " valid=" I64T ". Dropping the tail\n", a->fname, a->file_size, off);
+    }
+
+    a->size = off;
+}
+
+//***********************************************************************
+// _alog_reset - Frees the index and load buffer
+//***********************************************************************
+
+void _alog_reset(osf_alog_t *a)
+{
+    int i;
+
+    for (i=0; i<a->n; i++) {
+        if (a->entry[i].key_own) free(a->entry[i].key);
+        if (a->entry[i].val_own) free(a->entry[i].val);
+    }
+    a->n = 0;
+    if (a->slot != NULL) {
+        for (i=0; i<a->n_slots; i++) a->slot[i] = -1;
+    }
+    if (a->buf != NULL) free(a->buf);
+    a->buf = NULL;
+    a->size = a->file_size = a->live = 0;
+}
+
+//***********************************************************************
+// _alog_write_all - Writes the whole buffer handling short writes
+//***********************************************************************
+
+int _alog_write_all(int fd, char *buf, int64_t nbytes)
+{
+    ssize_t n;
+    int64_t off;
+
+    for (off=0; off<nbytes; off += n) {
+        n = write(fd, buf + off, nbytes - off);
+        if (n <= 0) {
+            if ((n == -1) && (errno == EINTR)) {
+                n = 0;
+                continue;
+            }
+            return(-1);
+        }
+    }
+
+    return(0);
+}
+
+//***********************************************************************
+// _alog_stage - Adds a record to the pending buffer
+//***********************************************************************
+
+void _alog_stage(char **buf, int *used, int *bmax, char *key, int klen, char *val, int v_size)
+{
+    osf_alog_rec_t rec;
+    int n;
+
+    n = sizeof(rec) + klen + ((v_size > 0) ? v_size : 0);
+    if (*used + n > *bmax) {
+        *bmax = 2*(*used + n);
+        tbx_type_realloc(*buf, char, *bmax);
+    }
+
+    rec.magic = OSF_ALOG_MAGIC;
+    rec.klen = klen;
+    rec.v_size = (v_size < 0) ? -1 : v_size;
+    memcpy(*buf + *used, &rec, sizeof(rec));
+    memcpy(*buf + *used + sizeof(rec), key, klen);
+    if (v_size > 0) memcpy(*buf + *used + sizeof(rec) + klen, val, v_size);
+    *used += n;
+}
+
+//***********************************************************************
+// osf_alog_load - Loads and indexes the attribute log for the directory.
+//    A missing log is treated as empty.
+//***********************************************************************
+
+osf_alog_t *osf_alog_load(char *attr_dir)
+{
+    osf_alog_t *a;
+    struct stat s;
+    ssize_t n;
+    int64_t off;
+    int fd;
+    char fname[OS_PATH_MAX];
+
+    tbx_type_malloc_clear(a, osf_alog_t, 1);
+    snprintf(fname, OS_PATH_MAX, "%s/%s", attr_dir, OSF_ALOG_NAME);
+    a->fname = strdup(fname);
+
+    fd = open(fname, O_RDONLY);
+    if (fd == -1) return(a);
+
+    if ((fstat(fd, &s) != 0) || (s.st_size == 0)) {
+        close(fd);
+        return(a);
+    }
+
+    tbx_type_malloc(a->buf, char, s.st_size);
+    for (off=0; off<s.st_size; off += n) {
+        n = read(fd, a->buf + off, s.st_size - off);
+        if (n <= 0) {
+            if ((n == -1) && (errno == EINTR)) {
+                n = 0;
+                continue;
+            }
+            break;
+        }
+    }
+    close(fd);
+
+    a->file_size = off;
+    _alog_parse(a);
+
+    log_printf(15, "fname=%s size=" I64T " live=" I64T " n=%d\n", a->fname, a->size, a->live, a->n);
+
+    return(a);
+}
+
+//***********************************************************************
+// osf_alog_destroy - Releases the log.  Any staged updates are discarded.
+//***********************************************************************
+
+void osf_alog_destroy(osf_alog_t *a)
+{
+    _alog_reset(a);
+    if (a->entry != NULL) free(a->entry);
+    if (a->slot != NULL) free(a->slot);
+    if (a->pending != NULL) free(a->pending);
+    free(a->fname);
+    free(a);
+}
+
+//***********************************************************************
+// osf_alog_get - Retrieves the attribute using the same sizing rules as
+//    osf_get_attr.  Returns 1 if the key isn't in the log.
+//***********************************************************************
+
+int osf_alog_get(osf_alog_t *a, char *key, void **val, int *v_size)
+{
+    osf_alog_entry_t *e;
+    int i, bsize;
+
+    i = _alog_find(a, key, strlen(key)+1);
+    if ((i == -1) || (a->entry[i].v_size < 0)) return(1);
+
+    e = &(a->entry[i]);
+    if (*v_size < 0) { //** Need to determine the size
+        *v_size = (e->v_size > (-*v_size)) ? -*v_size : e->v_size;
+        bsize = *v_size + 1;
+        *val = malloc(bsize);
+    } else {
+        bsize = *v_size;
+        if (e->v_size < *v_size) *v_size = e->v_size;
+    }
+
+    if (*v_size > 0) memcpy(*val, e->val, *v_size);
+    if (bsize > *v_size) ((char *)(*val))[*v_size] = 0;  //** Add a NULL terminator in case it may be a string
+
+    return(0);
+}
+
+//***********************************************************************
+// osf_alog_exists - Returns 1 if the key has a live value in the log
+//***********************************************************************
+
+int osf_alog_exists(osf_alog_t *a, char *key)
+{
+    int i;
+
+    i = _alog_find(a, key, strlen(key)+1);
+    return(((i == -1) || (a->entry[i].v_size < 0)) ? 0 : 1);
+}
+
+//***********************************************************************
+// osf_alog_set - Stages an attribute update.  A negative v_size removes the
+//    key.  Nothing is written until osf_alog_flush is called.
+//***********************************************************************
+
+void osf_alog_set(osf_alog_t *a, char *key, void *val, int v_size, int append_val)
+{
+    osf_alog_entry_t *e;
+    char *merged;
+    int i, klen;
+
+    klen = strlen(key) + 1;
+
+    if ((append_val == 1) && (v_size >= 0)) {
+        i = _alog_find(a, key, klen);
+        if ((i != -1) && (a->entry[i].v_size > 0)) {
+            e = &(a->entry[i]);
+            tbx_type_malloc(merged, char, e->v_size + v_size + 1);
+            memcpy(merged, e->val, e->v_size);
+            if (v_size > 0) memcpy(merged + e->v_size, val, v_size);
+            v_size += e->v_size;
+            _alog_stage(&(a->pending), &(a->p_used), &(a->p_max), key, klen, merged, v_size);
+            _alog_apply(a, key, klen, merged, v_size, 1);
+            free(merged);
+            return;
+        }
+    }
+
+    //** Removing a key that isn't there is a no-op
+    if ((v_size < 0) && (osf_alog_exists(a, key) == 0)) return;
+
+    _alog_stage(&(a->pending), &(a->p_used), &(a->p_max), key, klen, val, v_size);
+    _alog_apply(a, key, klen, val, v_size, 1);
+}
+
+//***********************************************************************
+// osf_alog_flush - Appends all the staged updates with a single write and
+//    compacts the log if it's mostly dead records.
+//***********************************************************************
+
+int osf_alog_flush(osf_alog_t *a)
+{
+    struct stat s;
+    int fd, err, changed;
+
+    if (a->p_used == 0) return(0);
+
+    fd = open(a->fname, O_WRONLY|O_CREAT|O_APPEND, OSF_ALOG_MODE);
+    if (fd == -1) {
+        log_printf(0, "ERROR opening attr log fname=%s errno=%d\n", a->fname, errno);
+        return(-1);
+    }
+
+    //** Someone else holding the object lock, a virtual attribute for example, may have
+    //** appended since we loaded.  If so leave the tail and compaction alone.
+    changed = ((fstat(fd, &s) != 0) || (s.st_size != a->file_size)) ? 1 : 0;
+
+    //** Get rid of any torn tail before appending
+    if ((changed == 0) && (a->file_size > a->size)) {
+        if (ftruncate(fd, a->size) != 0) {
+            log_printf(0, "ERROR truncating attr log fname=%s errno=%d\n", a->fname, errno);
+            changed = 1;
+        }
+    }
+
+    err = _alog_write_all(fd, a->pending, a->p_used);
+    close(fd);
+    if (err != 0) {
+        log_printf(0, "ERROR writing attr log fname=%s nbytes=%d errno=%d\n", a->fname, a->p_used, errno);
+        a->p_used = 0;
+        return(-1);
+    }
+
+    a->size += a->p_used;
+    a->file_size = a->size;
+    a->p_used = 0;
+
+    if ((changed == 0) && (a->size > OSF_ALOG_COMPACT_MIN) && ((a->size - a->live) > a->live)) osf_alog_compact(a);
+
+    return(0);
+}
+
+//***********************************************************************
+// _alog_sync_dir - fsyncs the directory holding the log so a rename is durable
+//***********************************************************************
+
+int _alog_sync_dir(char *fname)
+{
+    char *dname, *slash;
+    int fd, err;
+
+    dname = strdup(fname);
+    slash = strrchr(dname, '/');
+    if (slash == dname) {
+        slash[1] = 0;
+    } else if (slash != NULL) {
+        slash[0] = 0;
+    } else {
+        strcpy(dname, ".");
+    }
+
+    err = -1;
+    fd = open(dname, O_RDONLY|O_DIRECTORY);
+    if (fd != -1) {
+        err = fsync(fd);
+        close(fd);
+    }
+    free(dname);
+
+    return(err);
+}
+
+//***********************************************************************
+// osf_alog_compact - Rewrites the log with only the live records.  The new
+//    log is written and synced to a temp file and renamed over the old one.
+//***********************************************************************
+
+int osf_alog_compact(osf_alog_t *a)
+{
+    osf_alog_entry_t *e;
+    char *buf;
+    int i, fd, used, bmax, err;
+    char tname[OS_PATH_MAX];
+
+    bmax = a->live + 1;
+    used = 0;
+    tbx_type_malloc(buf, char, bmax);
+    for (i=0; i<a->n; i++) {
+        e = &(a->entry[i]);
+        if (e->v_size >= 0) _alog_stage(&buf, &used, &bmax, e->key, e->klen, e->val, e->v_size);
+    }
+
+    //** O_EXCL won't clobber an existing entry if it happens to match an object name.  It's created
+    //** with the same mode and umask as a fresh log.
+    fd = -1;
+    for (i=0; (fd == -1) && (i<OSF_ALOG_TEMP_TRIES); i++) {
+        snprintf(tname, OS_PATH_MAX, "%s.%d.%u", a->fname, getpid(), tbx_atomic_inc(_alog_temp_seq));
+        fd = open(tname, O_WRONLY|O_CREAT|O_EXCL, OSF_ALOG_MODE);
+        if ((fd == -1) && (errno != EEXIST)) break;
+    }
+    if (fd == -1) {
+        log_printf(0, "ERROR creating compaction file fname=%s errno=%d\n", a->fname, errno);
+        free(buf);
+        return(-1);
+    }
+
+    err = _alog_write_all(fd, buf, used);
+    if (err == 0) err = fsync(fd);  //** Make sure the data is down before it replaces the old log
+    close(fd);
+    if ((err != 0) || (rename(tname, a->fname) != 0)) {
+        log_printf(0, "ERROR compacting attr log fname=%s errno=%d\n", a->fname, errno);
+        unlink(tname);
+        free(buf);
+        return(-1);
+    }
+
+    if (_alog_sync_dir(a->fname) != 0) {
+        log_printf(0, "ERROR syncing attr log directory fname=%s errno=%d\n", a->fname, errno);
+    }
+
+    log_printf(5, "fname=%s old=" I64T " new=%d\n", a->fname, a->size, used);
+
+    //** Reindex from the compacted image
+    _alog_reset(a);
+    a->buf = buf;
+    a->file_size = used;
+    _alog_parse(a);
+
+    return(0);
+}
+
+//***********************************************************************
+// osf_alog_next - Iterates over the live keys.  *index should start at 0.
+//    Returns 0 and the key or -1 when done.
+//***********************************************************************
+
+int osf_alog_next(osf_alog_t *a, int *index, char **key)
+{
+    while (*index < a->n) {
+        (*index)++;
+        if (a->entry[*index-1].v_size >= 0) {
+            *key = a->entry[*index-1].key;
+            return(0);
+        }
+    }
+
+    return(-1);
+}
+
+//***********************************************************************
+// _alog_read_file - Reads an attribute file into a malloced buffer
+//***********************************************************************
+
+char *_alog_read_file(char *fname, int *v_size)
+{
+    FILE *fd;
+    char *val;
+    long n;
+
+    fd = fopen(fname, "r");
+    if (fd == NULL) return(NULL);
+
+    fseek(fd, 0L, SEEK_END);
+    n = ftell(fd);
+    fseek(fd, 0L, SEEK_SET);
+
+    tbx_type_malloc(val, char, n+1);
+    *v_size = fread(val, 1, n, fd);
+    fclose(fd);
+
+    return(val);
+}
+
+//***********************************************************************
+// osf_alog_migrate - Converts a single attribute directory to the given store.
+//    Symlinked attributes are always left as files.  Returns the number of
+//    attributes moved or -1 on error.
+//***********************************************************************
+
+int osf_alog_migrate(char *attr_dir, int store)
+{
+    osf_alog_t *a;
+    DIR *d;
+    FILE *fd;
+    struct dirent *entry;
+    struct stat s;
+    char **moved;
+    char *val, *key;
+    int i, n, n_max, v_size, err;
+    char fname[OS_PATH_MAX];
+
+    a = osf_alog_load(attr_dir);
+    n = 0;
+    err = 0;
+
+    if (store == OSF_ATTR_STORE_LOG) {
+        d = opendir(attr_dir);
+        if (d == NULL) {
+            osf_alog_destroy(a);
+            return(-1);
+        }
+
+        n_max = 16;
+        tbx_type_malloc(moved, char *, n_max);
+        while ((entry = readdir(d)) != NULL) {
+            if ((strncmp(entry->d_name, FILE_ATTR_PREFIX, FILE_ATTR_PREFIX_LEN) == 0) ||
+                    (strcmp(entry->d_name, ".") == 0) || (strcmp(entry->d_name, "..") == 0)) continue;
+
+            snprintf(fname, OS_PATH_MAX, "%s/%s", attr_dir, entry->d_name);
+            if ((lstat(fname, &s) != 0) || (!S_ISREG(s.st_mode))) continue;
+
+            val = _alog_read_file(fname, &v_size);
+            if (val == NULL) {
+                err = 1;
+                continue;
+            }
+            osf_alog_set(a, entry->d_name, val, v_size, 0);
+            free(val);
+
+            if (n == n_max) {
+                n_max = 2*n_max;
+                tbx_type_realloc(moved, char *, n_max);
+            }
+            moved[n] = strdup(entry->d_name);
+            n++;
+        }
+        closedir(d);
+
+        //** Only remove the files once the log is safely written
+        if (osf_alog_flush(a) != 0) err = 1;
+        for (i=0; i<n; i++) {
+            if (err == 0) {
+                snprintf(fname, OS_PATH_MAX, "%s/%s", attr_dir, moved[i]);
+                unlink(fname);
+            }
+            free(moved[i]);
+        }
+        free(moved);
+    } else {
+        i = 0;
+        while (osf_alog_next(a, &i, &key) == 0) {
+            snprintf(fname, OS_PATH_MAX, "%s/%s", attr_dir, key);
+            if (lstat(fname, &s) == 0) continue;  //** Existing files always win
+
+            fd = fopen(fname, "w");
+            if (fd == NULL) {
+                err = 1;
+                continue;
+            }
+            if (a->entry[i-1].v_size > 0) fwrite(a->entry[i-1].val, a->entry[i-1].v_size, 1, fd);
+            fclose(fd);
+            n++;
+        }
+
+        if (err == 0) unlink(a->fname);
+    }
+
+    osf_alog_destroy(a);
+
+    return((err == 0) ? n : -1);
+}
@@ -0,0 +1,54 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//***********************************************************************
+// Log structured attribute store for the file object service
+//***********************************************************************
+
+#include "lio/lio_visibility.h"
+
+#ifndef _OS_FILE_ATTR_LOG_H_
+#define _OS_FILE_ATTR_LOG_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OSF_ATTR_STORE_FILE 0    //** One file per attribute
+#define OSF_ATTR_STORE_LOG  1    //** Append only key/value log per attribute directory
+
+//** The log lives in the object's attribute directory under the bare FILE_ATTR_PREFIX.
+//** That can never collide with a child object's attribute directory.
+#define OSF_ALOG_NAME "_^FA^_"
+
+typedef struct osf_alog_s osf_alog_t;
+
+LIO_API osf_alog_t *osf_alog_load(char *attr_dir);
+LIO_API void osf_alog_destroy(osf_alog_t *a);
+LIO_API int osf_alog_get(osf_alog_t *a, char *key, void **val, int *v_size);
+LIO_API int osf_alog_exists(osf_alog_t *a, char *key);
+LIO_API void osf_alog_set(osf_alog_t *a, char *key, void *val, int v_size, int append_val);
+LIO_API int osf_alog_flush(osf_alog_t *a);
+LIO_API int osf_alog_compact(osf_alog_t *a);
+LIO_API int osf_alog_next(osf_alog_t *a, int *index, char **key);
+LIO_API int osf_alog_migrate(char *attr_dir, int store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -72,6 +72,7 @@ typedef struct {
     os_virtual_attr_t timestamp_pva;
     os_virtual_attr_t append_pva;
     int max_copy;
+    int attr_store;
 } osfile_priv_t;
 
 
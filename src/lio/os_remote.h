@@ -30,8 +30,16 @@ extern "C" {
 #define OS_TYPE_REMOTE_SERVER "os_remote_server"
 #define OS_TYPE_REMOTE_CLIENT "os_remote_client"
 
+//** Cache lease notifications delivered by the remote client
+#define OSRC_LEASE_INVALIDATE 0   //** Drop the path and anything under it
+#define OSRC_LEASE_FLUSH      1   //** Drop everything.  Leases are now being tracked by the server
+#define OSRC_LEASE_LOST       2   //** Drop everything.  Leases are no longer being tracked
+
+typedef void (osrc_lease_fn_t)(void *arg, int mode, char *path);
+
 object_service_fn_t *object_service_remote_server_create(service_manager_t *ess, tbx_inip_file_t *fd, char *section);
 object_service_fn_t *object_service_remote_client_create(service_manager_t *ess, tbx_inip_file_t *ifd, char *section);
+int osrc_lease_register(object_service_fn_t *os, osrc_lease_fn_t *fn, void *arg);
 
 
 #ifdef __cplusplus
@@ -22,6 +22,7 @@
 
 #include <apr_network_io.h>
 #include <tbx/assert_result.h>
+#include <tbx/apr_wrapper.h>
 #include "ex3_system.h"
 #include "object_service_abstract.h"
 #include <tbx/type_malloc.h>
@@ -74,6 +75,15 @@ typedef struct {
     int finished;
 } osrc_fsck_iter_t;
 
+typedef struct {
+    object_service_fn_t *os;
+    mq_stream_t *mqs;
+    mq_msg_t *response;
+    os_du_iter_t *generic;  //** Used when the server can't do the tally
+    int answered;           //** Got a response from the server
+    int finished;
+} osrc_du_iter_t;
+
 typedef struct {
     object_service_fn_t *os;
 //  void *it;
@@ -135,6 +145,11 @@ typedef struct {
     uint64_t my_id;
 } osrc_set_regex_t;
 
+typedef struct {
+    int reset;
+    tbx_stack_t *paths;
+} osrc_lease_poll_t;
+
 //***********************************************************************
 // osrc_add_creds - Adds the creds to the message
 //***********************************************************************
@@ -1219,6 +1234,34 @@ fail:
 }
 
 
+//***********************************************************************
+// osrc_append_get_attr_list - Adds the frame with the attributes to get
+//***********************************************************************
+
+void osrc_append_get_attr_list(object_service_fn_t *os, osrc_mult_attr_t *ma, mq_msg_t *msg)
+{
+    osrc_priv_t *osrc = (osrc_priv_t *)os->priv;
+    int i, bpos, len, nmax;
+    char *data;
+
+    nmax = 12;  //** Add just a little extra
+    for (i=0; i<ma->n; i++) {
+        nmax += strlen(ma->key[i]) + 4 + 4;
+    }
+    tbx_type_malloc(data, char, nmax);
+    bpos = tbx_zigzag_encode(osrc->max_stream, (unsigned char *)data);
+    bpos += tbx_zigzag_encode(osrc->timeout, (unsigned char *)&(data[bpos]));
+    bpos += tbx_zigzag_encode(ma->n, (unsigned char *)&(data[bpos]));
+    for (i=0; i<ma->n; i++) {
+        len = strlen(ma->key[i]);
+        bpos += tbx_zigzag_encode(len, (unsigned char *)&(data[bpos]));
+        memcpy(&(data[bpos]), ma->key[i], len);
+        bpos += len;
+        bpos += tbx_zigzag_encode(ma->v_size[i], (unsigned char *)&(data[bpos]));
+    }
+    mq_msg_append_mem(msg, data, bpos, MQF_MSG_AUTO_FREE);
+}
+
 //***********************************************************************
 // osrc_get_mult_attrs_internal - Retreives multiple object attribute
 //   If *v_size < 0 then space is allocated up to a max of abs(v_size)
@@ -1231,8 +1274,6 @@ op_generic_t *osrc_get_mult_attrs_internal(object_service_fn_t *os, osrc_mult_at
     osrc_object_fd_t *ofd = (osrc_object_fd_t *)ma->fd;
     mq_msg_t *msg;
     op_generic_t *gop;
-    int i, bpos, len, nmax;
-    char *data;
 
     log_printf(5, "START\n");
 
@@ -1247,22 +1288,7 @@ op_generic_t *osrc_get_mult_attrs_internal(object_service_fn_t *os, osrc_mult_at
     mq_msg_append_mem(msg, ofd->data, ofd->size, MQF_MSG_KEEP_DATA);
 
     //** Form the attribute frame
-    nmax = 12;  //** Add just a little extra
-    for (i=0; i<ma->n; i++) {
-        nmax += strlen(ma->key[i]) + 4 + 4;
-    }
-    tbx_type_malloc(data, char, nmax);
-    bpos = tbx_zigzag_encode(osrc->max_stream, (unsigned char *)data);
-    bpos += tbx_zigzag_encode(osrc->timeout, (unsigned char *)&(data[bpos]));
-    bpos += tbx_zigzag_encode(ma->n, (unsigned char *)&(data[bpos]));
-    for (i=0; i<ma->n; i++) {
-        len = strlen(ma->key[i]);
-        bpos += tbx_zigzag_encode(len, (unsigned char *)&(data[bpos]));
-        memcpy(&(data[bpos]), ma->key[i], len);
-        bpos += len;
-        bpos += tbx_zigzag_encode(ma->v_size[i], (unsigned char *)&(data[bpos]));
-    }
-    mq_msg_append_mem(msg, data, bpos, MQF_MSG_AUTO_FREE);
+    osrc_append_get_attr_list(os, ma, msg);
 
     mq_msg_append_mem(msg, NULL, 0, MQF_MSG_KEEP_DATA);
 
@@ -1295,6 +1321,47 @@ op_generic_t *osrc_get_multiple_attrs(object_service_fn_t *os, creds_t *creds, o
     return(osrc_get_mult_attrs_internal(os, ma, creds));
 }
 
+//***********************************************************************
+// osrc_get_multiple_attrs_immediate - Opens the object, retreives the
+//   attributes, and closes it on the server in a single round trip.
+//   If *v_size < 0 then space is allocated up to a max of abs(v_size)
+//   and upon return *v_size contains the bytes loaded
+//***********************************************************************
+
+op_generic_t *osrc_get_multiple_attrs_immediate(object_service_fn_t *os, creds_t *creds, char *path, char *id, char **key, void **val, int *v_size, int n)
+{
+    osrc_priv_t *osrc = (osrc_priv_t *)os->priv;
+    osrc_mult_attr_t *ma;
+    mq_msg_t *msg;
+
+    tbx_type_malloc_clear(ma, osrc_mult_attr_t, 1);
+    ma->os = os;
+    ma->key = key;
+    ma->val = val;
+    ma->v_size = v_size;
+    ma->n = n;
+
+    //** Form the message
+    msg = mq_make_exec_core_msg(osrc->remote_host, 1);
+    mq_msg_append_mem(msg, OSR_GET_MULTIPLE_ATTR_IMMEDIATE_KEY, OSR_GET_MULTIPLE_ATTR_IMMEDIATE_SIZE, MQF_MSG_KEEP_DATA);
+    mq_msg_append_mem(msg, osrc->host_id, osrc->host_id_len, MQF_MSG_KEEP_DATA);
+    osrc_add_creds(os, creds, msg);
+
+    //** Lock ID, object, and attribute frames
+    if (id != NULL) {
+        mq_msg_append_mem(msg, id, strlen(id)+1, MQF_MSG_KEEP_DATA);
+    } else {
+        mq_msg_append_mem(msg, NULL, 0, MQF_MSG_KEEP_DATA);
+    }
+    mq_msg_append_mem(msg, path, strlen(path)+1, MQF_MSG_KEEP_DATA);
+    osrc_append_get_attr_list(os, ma, msg);
+
+    mq_msg_append_mem(msg, NULL, 0, MQF_MSG_KEEP_DATA);
+
+    //** The response is the same as a normal get so reuse it's handler
+    return(new_mq_op(osrc->mqc, msg, osrc_response_get_multiple_attrs, ma, free, osrc->timeout));
+}
+
 //***********************************************************************
 // osrc_get_attr - Retreives a single object attribute
 //   If *v_size < 0 then space is allocated up to a max of abs(v_size)
@@ -2392,6 +2459,230 @@ void osrc_destroy_fsck_iter(object_service_fn_t *os, os_fsck_iter_t *oit)
 }
 
 
+//***********************************************************************
+// osrc_next_du - Returns the next du rollup entry
+//***********************************************************************
+
+int osrc_next_du(object_service_fn_t *os, os_du_iter_t *oit, char **fname, int64_t *bytes, int64_t *count)
+{
+    osrc_du_iter_t *it = (osrc_du_iter_t *)oit;
+    int n, err, ftype;
+
+    if (it->generic != NULL) return(os_next_du_generic(os, it->generic, fname, bytes, count));
+
+    *fname = NULL;
+    if (it->finished == 1) return(0);
+
+    //** Read the object type.  0 means no more entries
+    ftype = mq_stream_read_varint(it->mqs, &err);
+    if ((err != 0) || (ftype <= 0)) {
+        if (err != 0) log_printf(5, "ERROR reading object type!\n");
+        it->finished = 1;
+        return(0);
+    }
+
+    //** Now the name
+    n = mq_stream_read_varint(it->mqs, &err);
+    if ((err != 0) || (n <= 0)) {
+        log_printf(5, "ERROR reading fname len! n=%d\n", n);
+        it->finished = 1;
+        return(0);
+    }
+    tbx_type_malloc(*fname, char, n+1);
+    (*fname)[n] = 0;
+    err = mq_stream_read(it->mqs, *fname, n);
+    if (err != 0) {
+        log_printf(5, "ERROR reading fname!\n");
+        free(*fname);
+        *fname = NULL;
+        it->finished = 1;
+        return(0);
+    }
+
+    //** And the tally
+    *bytes = mq_stream_read_varint(it->mqs, &err);
+    if (err == 0) *count = mq_stream_read_varint(it->mqs, &err);
+    if (err != 0) {
+        log_printf(5, "ERROR reading the tally! fname=%s\n", *fname);
+        free(*fname);
+        *fname = NULL;
+        it->finished = 1;
+        return(0);
+    }
+
+    return(ftype);
+}
+
+//***********************************************************************
+// osrc_response_du_iter - Handles the create_du_iter() response
+//***********************************************************************
+
+op_status_t osrc_response_du_iter(void *task_arg, int tid)
+{
+    mq_task_t *task = (mq_task_t *)task_arg;
+    osrc_du_iter_t *it = (osrc_du_iter_t *)task->arg;
+    osrc_priv_t *osrc = (osrc_priv_t *)it->os->priv;
+    op_status_t status;
+    mq_frame_t *f;
+    char *data;
+    int err, len;
+
+    log_printf(5, "START\n");
+
+    status = op_success_status;
+    it->answered = 1;
+
+    //** Parse the response
+    mq_remove_header(task->response, 1);
+
+    //** A server that doesn't know the command sends back a bare status
+    f = mq_msg_first(task->response);
+    mq_get_frame(f, (void **)&data, &len);
+    if (len < (int)MQS_HEADER) {
+        status = mq_read_status_frame(f, 0);
+        if (status.op_status == OP_STATE_SUCCESS) status = op_failure_status;
+        log_printf(5, "END status=%d %d\n", status.op_status, status.error_code);
+        return(status);
+    }
+
+    it->mqs = mq_stream_read_create(osrc->mqc, osrc->ongoing, osrc->host_id, osrc->host_id_len, f, osrc->remote_host, osrc->stream_timeout);
+
+    //** Parse the status
+    status.op_status = mq_stream_read_varint(it->mqs, &err);
+    status.error_code = mq_stream_read_varint(it->mqs, &err);
+
+    if (err != 0) {
+        status.op_status= OP_STATE_FAILURE;    //** Trigger a failure if error reading from the stream
+    }
+    if (status.op_status == OP_STATE_FAILURE) {
+        mq_stream_destroy(it->mqs);
+        it->mqs = NULL;
+    } else {
+        //** Remove the response from the task to keep it from being freed.
+        //** We'll do it manually
+        it->response = task->response;
+        task->response = NULL;
+    }
+
+    log_printf(5, "END status=%d %d\n", status.op_status, status.error_code);
+
+    return(status);
+}
+
+//***********************************************************************
+// osrc_create_du_iter - Has the server do the du tally and stream back
+//   just the rollups.  If the server doesn't know the command or never
+//   answers, which is what older servers do, we fall back to walking the
+//   objects from here.  Any other failure is returned.  Once the server
+//   has come up short we don't ask it again.
+//***********************************************************************
+
+os_du_iter_t *osrc_create_du_iter(object_service_fn_t *os, creds_t *creds, os_regex_table_t *path, os_regex_table_t *obj_regex, int object_types, int recurse_depth, int rollup_depth, int flags)
+{
+    osrc_priv_t *osrc = (osrc_priv_t *)os->priv;
+    osrc_du_iter_t *it;
+    int bpos, bufsize, again, n;
+    unsigned char *buffer;
+    mq_msg_t *msg;
+    op_generic_t *gop;
+    op_status_t status;
+
+    log_printf(5, "START\n");
+
+    //** Make the iterator handle
+    tbx_type_malloc_clear(it, osrc_du_iter_t, 1);
+    it->os = os;
+
+    if (osrc->du_generic == 1) goto generic;
+
+    //** Form the message
+    msg = mq_make_exec_core_msg(osrc->remote_host, 1);
+    mq_msg_append_mem(msg, OSR_DU_ITER_KEY, OSR_DU_ITER_SIZE, MQF_MSG_KEEP_DATA);
+    mq_msg_append_mem(msg, osrc->host_id, osrc->host_id_len, MQF_MSG_KEEP_DATA);
+    osrc_add_creds(os, creds, msg);
+
+    bufsize = 4096;
+    tbx_type_malloc(buffer, unsigned char, bufsize);
+    do {
+        again = 0;
+        bpos = 0;
+
+        bpos += tbx_zigzag_encode(osrc->timeout, buffer);
+        bpos += tbx_zigzag_encode(recurse_depth, &(buffer[bpos]));
+        bpos += tbx_zigzag_encode(object_types, &(buffer[bpos]));
+        bpos += tbx_zigzag_encode(rollup_depth, &(buffer[bpos]));
+        bpos += tbx_zigzag_encode(flags, &(buffer[bpos]));
+
+        n = os_regex_table_pack(path, &(buffer[(again==0) ? bpos : 0]), bufsize-bpos);
+        if (n < 0) {
+            again = 1;
+            n = -n;
+        }
+        bpos += n;
+
+        n = os_regex_table_pack(obj_regex, &(buffer[(again==0) ? bpos : 0]), bufsize-bpos);
+        if (n < 0) {
+            again = 1;
+            n = -n;
+        }
+        bpos += n;
+
+        if (again == 1) {
+            bufsize = bpos + 10;
+            free(buffer);
+            tbx_type_malloc(buffer, unsigned char, bufsize);
+        }
+    } while (again == 1);
+
+    mq_msg_append_mem(msg, buffer, bpos, MQF_MSG_AUTO_FREE);
+    mq_msg_append_mem(msg, NULL, 0, MQF_MSG_KEEP_DATA);
+
+    //** Make the gop and execute it
+    gop = new_mq_op(osrc->mqc, msg, osrc_response_du_iter, it, NULL, osrc->timeout);
+    gop_waitall(gop);
+    status = gop_get_status(gop);
+    gop_free(gop, OP_DESTROY);
+    if (status.op_status == OP_STATE_SUCCESS) goto finished;
+
+    if ((status.error_code != OSR_UNKNOWN_COMMAND) && (it->answered == 1)) {
+        log_printf(5, "Remote du failed status=%d error_code=%d\n", status.op_status, status.error_code);
+        free(it);
+        return(NULL);
+    }
+
+    //** The server doesn't have the command so do the tally ourselves from now on
+    log_printf(1, "Server doesn't support du. answered=%d Falling back to the generic iter\n", it->answered);
+    osrc->du_generic = 1;
+
+generic:
+    it->generic = os_create_du_iter_generic(os, creds, path, obj_regex, object_types, recurse_depth, rollup_depth, flags);
+    if (it->generic == NULL) {
+        free(it);
+        return(NULL);
+    }
+
+finished:
+    log_printf(5, "END\n");
+
+    return(it);
+}
+
+//***********************************************************************
+// osrc_destroy_du_iter - Destroys a du iterator
+//***********************************************************************
+
+void osrc_destroy_du_iter(object_service_fn_t *os, os_du_iter_t *oit)
+{
+    osrc_du_iter_t *it = (osrc_du_iter_t *)oit;
+
+    if (it->generic != NULL) os_destroy_du_iter_generic(os, it->generic);
+    if (it->mqs != NULL) mq_stream_destroy(it->mqs);
+    if (it->response != NULL) mq_msg_destroy(it->response);
+
+    free(it);
+}
+
+
 //***********************************************************************
 // osrc_cred_init - Intialize a set of credentials
 //***********************************************************************
@@ -2430,6 +2721,143 @@ void osrc_cred_destroy(object_service_fn_t *os, creds_t *creds)
 }
 
 
+//***********************************************************************
+// osrc_response_lease - Handles the lease poll response
+//***********************************************************************
+
+op_status_t osrc_response_lease(void *task_arg, int tid)
+{
+    mq_task_t *task = (mq_task_t *)task_arg;
+    osrc_lease_poll_t *lp = (osrc_lease_poll_t *)task->arg;
+    mq_frame_t *f;
+    op_status_t status;
+    char *data;
+    int n;
+    int64_t reset;
+
+    log_printf(5, "START\n");
+
+    //** Parse the response
+    mq_remove_header(task->response, 1);
+
+    status = mq_read_status_frame(mq_msg_first(task->response), 0);
+    if ((status.op_status != OP_STATE_SUCCESS) || (lp == NULL)) goto finished;
+
+    mq_get_frame(mq_msg_next(task->response), (void **)&data, &n);
+    if (tbx_zigzag_decode((unsigned char *)data, n, &reset) < 0) reset = 1;
+    lp->reset = reset;
+
+    while ((f = mq_msg_next(task->response)) != NULL) {
+        mq_get_frame(f, (void **)&data, &n);
+        if (n <= 0) break;  //** Hit the empty trailing frame
+        tbx_stack_push(lp->paths, strndup(data, n));
+    }
+
+finished:
+    log_printf(5, "END status=%d %d\n", status.op_status, status.error_code);
+
+    return(status);
+}
+
+//***********************************************************************
+// osrc_lease_op - Generates a lease poll.  A negative wait releases the
+//     leases held on the server.
+//***********************************************************************
+
+op_generic_t *osrc_lease_op(object_service_fn_t *os, int wait, osrc_lease_poll_t *lp)
+{
+    osrc_priv_t *osrc = (osrc_priv_t *)os->priv;
+    mq_msg_t *msg;
+    unsigned char *buffer;
+    int n;
+
+    //** Form the message
+    msg = mq_make_exec_core_msg(osrc->remote_host, 1);
+    mq_msg_append_mem(msg, OSR_LEASE_KEY, OSR_LEASE_SIZE, MQF_MSG_KEEP_DATA);
+    mq_msg_append_mem(msg, osrc->host_id, osrc->host_id_len, MQF_MSG_KEEP_DATA);
+
+    tbx_type_malloc(buffer, unsigned char, 16);
+    n = tbx_zigzag_encode(wait, buffer);
+    mq_msg_append_mem(msg, buffer, n, MQF_MSG_AUTO_FREE);
+    mq_msg_append_mem(msg, NULL, 0, MQF_MSG_KEEP_DATA);
+
+    //** Make the gop.  The server can park it for up to wait seconds.
+    return(new_mq_op(osrc->mqc, msg, osrc_response_lease, lp, NULL, ((wait > 0) ? wait : 0) + osrc->timeout));
+}
+
+//***********************************************************************
+// osrc_lease_thread - Polls the server for cache invalidations and hands
+//     them to the registered callback
+//***********************************************************************
+
+void *osrc_lease_thread(apr_thread_t *th, void *data)
+{
+    object_service_fn_t *os = (object_service_fn_t *)data;
+    osrc_priv_t *osrc = (osrc_priv_t *)os->priv;
+    osrc_lease_poll_t lp;
+    op_status_t status;
+    char *path;
+    int lost;
+
+    lp.paths = tbx_stack_new();
+    lost = 1;
+
+    //** The server drops our leases if the heartbeats stop
+    mq_ongoing_host_inc(osrc->ongoing, osrc->remote_host, osrc->host_id, osrc->host_id_len, osrc->heartbeat);
+
+    apr_thread_mutex_lock(osrc->lock);
+    while (osrc->shutdown == 0) {
+        apr_thread_mutex_unlock(osrc->lock);
+
+        lp.reset = 0;
+        status = gop_sync_exec_status(osrc_lease_op(os, osrc->lease_poll, &lp));
+        if (status.op_status == OP_STATE_SUCCESS) {
+            if ((lp.reset == 1) || (lost == 1)) osrc->lease_fn(osrc->lease_arg, OSRC_LEASE_FLUSH, NULL);
+            lost = 0;
+            while ((path = tbx_stack_pop(lp.paths)) != NULL) {
+                log_printf(5, "invalidate path=%s\n", path);
+                osrc->lease_fn(osrc->lease_arg, OSRC_LEASE_INVALIDATE, path);
+                free(path);
+            }
+            apr_thread_mutex_lock(osrc->lock);
+        } else {
+            log_printf(1, "Lease poll failed. lost=%d\n", lost);
+            if (lost == 0) osrc->lease_fn(osrc->lease_arg, OSRC_LEASE_LOST, NULL);
+            lost = 1;
+            while ((path = tbx_stack_pop(lp.paths)) != NULL) free(path);
+
+            //** Don't hammer the server while it's unreachable
+            apr_thread_mutex_lock(osrc->lock);
+            if (osrc->shutdown == 0) apr_thread_cond_timedwait(osrc->cond, osrc->lock, apr_time_from_sec(osrc->spin_interval));
+        }
+    }
+    apr_thread_mutex_unlock(osrc->lock);
+
+    mq_ongoing_host_dec(osrc->ongoing, osrc->remote_host, osrc->host_id, osrc->host_id_len);
+    tbx_stack_free(lp.paths, 1);
+
+    return(NULL);
+}
+
+//***********************************************************************
+// osrc_lease_register - Starts tracking cache leases with the server.
+//     The callback is notified of any invalidations.  Only a single
+//     consumer is supported.
+//***********************************************************************
+
+int osrc_lease_register(object_service_fn_t *os, osrc_lease_fn_t *fn, void *arg)
+{
+    osrc_priv_t *osrc = (osrc_priv_t *)os->priv;
+
+    if (osrc->lease_thread != NULL) return(1);
+
+    osrc->lease_fn = fn;
+    osrc->lease_arg = arg;
+    tbx_thread_create_assert(&(osrc->lease_thread), NULL, osrc_lease_thread, (void *)os, osrc->mpool);
+
+    return(0);
+}
+
 //***********************************************************************
 // os_remote_client_destroy
 //***********************************************************************
@@ -2437,6 +2865,18 @@ void osrc_cred_destroy(object_service_fn_t *os, creds_t *creds)
 void osrc_destroy(object_service_fn_t *os)
 {
     osrc_priv_t *osrc = (osrc_priv_t *)os->priv;
+    apr_status_t value;
+
+    //** Stop the lease poller.  Releasing the leases kicks out the parked poll.
+    if (osrc->lease_thread != NULL) {
+        apr_thread_mutex_lock(osrc->lock);
+        osrc->shutdown = 1;
+        apr_thread_cond_broadcast(osrc->cond);
+        apr_thread_mutex_unlock(osrc->lock);
+
+        gop_sync_exec(osrc_lease_op(os, -1, NULL));
+        apr_thread_join(&value, osrc->lease_thread);
+    }
 
     if (osrc->os_remote != NULL) {
         os_destroy(osrc->os_remote);
@@ -2500,6 +2940,7 @@ object_service_fn_t *object_service_remote_client_create(service_manager_t *ess,
     osrc->stream_timeout = tbx_inip_get_integer(fd, section, "stream_timeout", 65);
     osrc->spin_interval = tbx_inip_get_integer(fd, section, "spin_interval", 1);
     osrc->spin_fail = tbx_inip_get_integer(fd, section, "spin_fail", 4);
+    osrc->lease_poll = tbx_inip_get_integer(fd, section, "lease_poll", 30);
 
     apr_pool_create(&osrc->mpool, NULL);
     apr_thread_mutex_create(&(osrc->lock), APR_THREAD_MUTEX_DEFAULT, osrc->mpool);
@@ -2548,6 +2989,7 @@ object_service_fn_t *object_service_remote_client_create(service_manager_t *ess,
     os->symlink_attr = osrc_symlink_attr;//DONE
     os->copy_attr = osrc_copy_attr;//DONE
     os->get_multiple_attrs = osrc_get_multiple_attrs;//DONE
+    os->get_multiple_attrs_immediate = osrc_get_multiple_attrs_immediate;
     os->set_multiple_attrs = osrc_set_multiple_attrs;//DONE
     os->copy_multiple_attrs = osrc_copy_multiple_attrs;//DONE
     os->symlink_multiple_attrs = osrc_symlink_multiple_attrs;//DONE
@@ -2559,6 +3001,9 @@ object_service_fn_t *object_service_remote_client_create(service_manager_t *ess,
     os->next_attr = osrc_next_attr;
     os->destroy_attr_iter = osrc_destroy_attr_iter;
 
+    os->create_du_iter = osrc_create_du_iter;
+    os->next_du = osrc_next_du;
+    os->destroy_du_iter = osrc_destroy_du_iter;
     os->create_fsck_iter = osrc_create_fsck_iter;
     os->destroy_fsck_iter = osrc_destroy_fsck_iter;
     os->next_fsck = osrc_next_fsck;
@@ -22,6 +22,8 @@
 #include "authn_abstract.h"
 #include "mq_portal.h"
 #include "mq_ongoing.h"
+#include "mq_dispatch.h"
+#include "os_remote.h"
 
 #ifndef _OS_REMOTE_PRIV_H_
 #define _OS_REMOTE_PRIV_H_
@@ -59,6 +61,8 @@ extern "C" {
 #define OSR_ABORT_REGEX_SET_MULT_ATTR_SIZE 30
 #define OSR_GET_MULTIPLE_ATTR_KEY  "os_get_mult"
 #define OSR_GET_MULTIPLE_ATTR_SIZE 11
+#define OSR_GET_MULTIPLE_ATTR_IMMEDIATE_KEY  "os_get_mult_immediate"
+#define OSR_GET_MULTIPLE_ATTR_IMMEDIATE_SIZE 21
 #define OSR_SET_MULTIPLE_ATTR_KEY  "os_set_mult"
 #define OSR_SET_MULTIPLE_ATTR_SIZE 11
 #define OSR_COPY_MULTIPLE_ATTR_KEY  "os_copy_mult"
@@ -75,10 +79,16 @@ extern "C" {
 #define OSR_ATTR_ITER_SIZE          12
 #define OSR_FSCK_ITER_KEY           "os_fsck_iter"
 #define OSR_FSCK_ITER_SIZE          12
+#define OSR_DU_ITER_KEY             "os_du_iter"
+#define OSR_DU_ITER_SIZE            10
 #define OSR_FSCK_OBJECT_KEY         "os_fsck_object"
 #define OSR_FSCK_OBJECT_SIZE        14
 #define OSR_SPIN_HB_KEY             "os_spin_hb"
 #define OSR_SPIN_HB_SIZE            10
+#define OSR_LEASE_KEY               "os_lease"
+#define OSR_LEASE_SIZE              8
+
+#define OSR_UNKNOWN_COMMAND    -1001   //** error_code sent back for a command the server doesn't know
 
 //** Types of ongoing objects stored
 #define OSR_ONGOING_FD_TYPE    0
@@ -86,6 +96,27 @@ extern "C" {
 #define OSR_ONGOING_ATTR_ITER   2
 #define OSR_ONGOING_FSCK_ITER   3
 
+typedef struct {    //** Client holding cache leases on the server
+    char *host_id;
+    int host_id_len;
+    apr_pool_t *mpool;
+    apr_hash_t *paths;          //** Paths the client could have cached
+    apr_hash_t *aliases;        //** Cached paths of symlinked or hardlinked objects.  Any change breaks them
+    tbx_stack_t *pending;       //** Invalidations waiting for the next poll
+    mq_msg_t *poll;             //** Response for the parked poll or NULL
+    apr_time_t poll_expire;     //** When the parked poll gets an empty answer
+    int reset;                  //** Client has to drop everything
+    int overflow;               //** Too many paths to track so every change is sent
+    int in_use;                 //** Lease commands currently using the record
+    int dead;                   //** Removed from the lease table
+} osrs_lease_t;
+
+typedef struct {
+    os_fd_t *fd;
+    char *path;
+    int alias;                  //** Object is a symlink or hardlink so it has other names
+} osrs_fd_path_t;
+
 typedef struct {
     object_service_fn_t *os_child;  //** Actual OS used
     apr_thread_mutex_t *lock;
@@ -100,6 +131,7 @@ typedef struct {
     apr_hash_t *spin;           //** Abort spin handles
     char *hostname;             //** Addres to bind to
     mq_portal_t *server_portal;
+    mq_dispatch_t *dispatch;    //** Per client fair dispatch of incoming commands
     thread_pool_context_t *tpc;
     int ongoing_interval;       //** Ongoing command check interval
     int shutdown;
@@ -109,6 +141,14 @@ typedef struct {
     creds_t *dummy_creds;       //** Dummy creds. Should be replaced when proper AuthN/AuthZ is added
     char *fname_active;         //** Filename for logging ACTIVE operations.
     char *fname_activity;       //** Filename for logging create/remove/move operations.
+    apr_thread_mutex_t *lease_lock;
+    apr_thread_cond_t *lease_cond;
+    apr_hash_t *lease_table;    //** Clients holding cache leases keyed by host id
+    apr_hash_t *fd_path;        //** Object name for each open fd.  Used to target invalidations
+    int lease_max_paths;        //** Max paths tracked per client before every change is sent
+    int lease_max_wait;         //** Max time a lease poll is parked waiting for invalidations
+    int lease_polls;            //** Lease polls currently parked
+    apr_thread_t *lease_thread; //** Answers parked lease polls when they expire
 } osrs_priv_t;
 
 typedef struct {
@@ -134,6 +174,11 @@ typedef struct {
     int heartbeat;
     int shutdown;
     int max_stream;
+    apr_thread_t *lease_thread;    //** Polls the server for cache invalidations
+    osrc_lease_fn_t *lease_fn;
+    void *lease_arg;
+    int lease_poll;                //** How long the server can park a lease poll
+    int du_generic;                //** Server didn't answer a du so always walk from here
 } osrc_priv_t;
 
 #ifdef __cplusplus
@@ -35,6 +35,7 @@
 #include "mq_helpers.h"
 #include <tbx/varint.h>
 #include <tbx/string_token.h>
+#include <tbx/apr_wrapper.h>
 #include "mq_stream.h"
 #include "authn_fake.h"
 
@@ -96,6 +97,8 @@ void osrs_print_active_table(object_service_fn_t *os, FILE *fd)
         a = tbx_stack_get_current_data(osrs->active_lru);
     }
     apr_thread_mutex_unlock(osrs->lock);
+
+    if (osrs->dispatch != NULL) mq_dispatch_print(osrs->dispatch, fd);
 }
 
 
@@ -303,6 +306,615 @@ op_status_t osrs_perform_abort_handle(object_service_fn_t *os, char *handle, int
     return(status);
 }
 
+//***********************************************************************
+// osrs_type_alias - Returns 1 if the "os.type" value is for a symlink or
+//     hardlink and so the object can be changed through another name
+//***********************************************************************
+
+int osrs_type_alias(void *val, int v_size)
+{
+    char buf[32];
+    int ftype;
+
+    if ((v_size <= 0) || (v_size >= (int)sizeof(buf))) return(1);  //** Don't know so play it safe
+    memcpy(buf, val, v_size);
+    buf[v_size] = 0;
+    ftype = atoi(buf);
+
+    return((ftype & (OS_OBJECT_SYMLINK|OS_OBJECT_HARDLINK)) ? 1 : 0);
+}
+
+//***********************************************************************
+// osrs_object_alias - Returns 1 if the object is a symlink or hardlink and
+//     so can be changed through another name
+//***********************************************************************
+
+int osrs_object_alias(object_service_fn_t *os, creds_t *creds, os_fd_t *fd)
+{
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    char buf[32];
+    void *val = buf;
+    int v_size;
+
+    v_size = sizeof(buf) - 1;
+    if (gop_sync_exec(os_get_attr(osrs->os_child, creds, fd, "os.type", &val, &v_size)) != OP_STATE_SUCCESS) return(1);
+    return(osrs_type_alias(buf, v_size));
+}
+
+//***********************************************************************
+// osrs_fd_path_add - Remembers the object name for an open fd so changes
+//     made through the fd can be turned into invalidations.  The object type
+//     is filled in later from the first attribute read or change that needs it.
+//***********************************************************************
+
+void osrs_fd_path_add(object_service_fn_t *os, os_fd_t *fd, char *path)
+{
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    osrs_fd_path_t *fp;
+
+    tbx_type_malloc(fp, osrs_fd_path_t, 1);
+    fp->fd = fd;
+    fp->path = strdup(path);
+    fp->alias = -1;
+
+    apr_thread_mutex_lock(osrs->lease_lock);
+    apr_hash_set(osrs->fd_path, &(fp->fd), sizeof(os_fd_t *), fp);
+    apr_thread_mutex_unlock(osrs->lease_lock);
+}
+
+//***********************************************************************
+// osrs_fd_path_remove - Forgets the object name for the fd
+//***********************************************************************
+
+void osrs_fd_path_remove(object_service_fn_t *os, os_fd_t *fd)
+{
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    osrs_fd_path_t *fp;
+
+    apr_thread_mutex_lock(osrs->lease_lock);
+    fp = apr_hash_get(osrs->fd_path, &fd, sizeof(os_fd_t *));
+    if (fp != NULL) apr_hash_set(osrs->fd_path, &fd, sizeof(os_fd_t *), NULL);
+    apr_thread_mutex_unlock(osrs->lease_lock);
+
+    if (fp != NULL) {
+        free(fp->path);
+        free(fp);
+    }
+}
+
+//***********************************************************************
+// osrs_ongoing_close_object - Closes an fd whose client stopped heartbeating
+//***********************************************************************
+
+op_generic_t *osrs_ongoing_close_object(void *arg, void *handle)
+{
+    object_service_fn_t *os = (object_service_fn_t *)arg;
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+
+    osrs_fd_path_remove(os, handle);
+    return(os_close_object(osrs->os_child, handle));
+}
+
+//***********************************************************************
+// _osrs_lease_clear_paths - Drops all the paths in the table
+//***********************************************************************
+
+void _osrs_lease_clear_paths(apr_hash_t *table)
+{
+    apr_hash_index_t *hi;
+    char *path;
+
+    for (hi = apr_hash_first(NULL, table); hi != NULL; hi = apr_hash_next(hi)) {
+        path = apr_hash_this_val(hi);
+        apr_hash_set(table, path, APR_HASH_KEY_STRING, NULL);
+        free(path);
+    }
+}
+
+//***********************************************************************
+// _osrs_lease_clear - Drops all the tracked paths and pending invalidations.
+//     NOTE: Assumes the lease_lock is held
+//***********************************************************************
+
+void _osrs_lease_clear(osrs_lease_t *l)
+{
+    char *path;
+
+    _osrs_lease_clear_paths(l->paths);
+    _osrs_lease_clear_paths(l->aliases);
+
+    while ((path = tbx_stack_pop(l->pending)) != NULL) free(path);
+}
+
+//***********************************************************************
+// _osrs_lease_reply - Sends the parked poll, if any, whatever the client has
+//     waiting.  A dropped record gets a failure so the client flushes.
+//     NOTE: Assumes the lease_lock is held
+//***********************************************************************
+
+void _osrs_lease_reply(osrs_priv_t *osrs, osrs_lease_t *l)
+{
+    mq_msg_t *response;
+    unsigned char *data;
+    char *path;
+    int n;
+
+    if (l->poll == NULL) return;
+    response = l->poll;
+    l->poll = NULL;
+    osrs->lease_polls--;
+
+    if (l->dead == 0) {
+        mq_msg_append_frame(response, mq_make_status_frame(op_success_status));
+
+        tbx_type_malloc(data, unsigned char, 16);
+        n = tbx_zigzag_encode(l->reset, data);
+        mq_msg_append_mem(response, data, n, MQF_MSG_AUTO_FREE);
+        l->reset = 0;
+
+        while ((path = tbx_stack_pop(l->pending)) != NULL) {
+            mq_msg_append_mem(response, path, strlen(path)+1, MQF_MSG_AUTO_FREE);
+        }
+    } else {
+        mq_msg_append_frame(response, mq_make_status_frame(op_failure_status));
+    }
+
+    mq_msg_append_mem(response, NULL, 0, MQF_MSG_KEEP_DATA);  //** Empty frame
+
+    mq_submit(osrs->server_portal, mq_task_new(osrs->mqc, response, NULL, NULL, 30));
+}
+
+//***********************************************************************
+// _osrs_lease_drop - Removes the client from the lease table and frees it
+//     if no lease commands are using it.
+//     NOTE: Assumes the lease_lock is held
+//***********************************************************************
+
+void _osrs_lease_drop(osrs_priv_t *osrs, osrs_lease_t *l)
+{
+    if (l->dead == 0) {
+        l->dead = 1;
+        apr_hash_set(osrs->lease_table, l->host_id, l->host_id_len, NULL);
+        _osrs_lease_reply(osrs, l);
+    }
+
+    if (l->in_use > 0) return;  //** The last one out does the free
+
+    _osrs_lease_clear(l);
+    tbx_stack_free(l->pending, 0);
+    apr_pool_destroy(l->mpool);
+    free(l->host_id);
+    free(l);
+}
+
+//***********************************************************************
+// osrs_lease_expire - Drops the client's leases.  Called by the ongoing
+//     thread when the client stops heartbeating.
+//***********************************************************************
+
+op_generic_t *osrs_lease_expire(void *arg, void *handle)
+{
+    object_service_fn_t *os = (object_service_fn_t *)arg;
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+
+    log_printf(5, "Expiring leases for host=%s\n", ((osrs_lease_t *)handle)->host_id);
+
+    apr_thread_mutex_lock(osrs->lease_lock);
+    _osrs_lease_drop(osrs, (osrs_lease_t *)handle);
+    apr_thread_mutex_unlock(osrs->lease_lock);
+
+    return(gop_dummy(op_success_status));
+}
+
+//***********************************************************************
+// _osrs_lease_add - Records that the client could be caching the path.
+//     Paths to objects with other names are kept separately since a change
+//     through any of the other names has to break them.
+//     NOTE: Assumes the lease_lock is held
+//***********************************************************************
+
+void _osrs_lease_add(osrs_priv_t *osrs, char *host_id, int id_len, char *path, int alias)
+{
+    osrs_lease_t *l;
+    apr_hash_t *table;
+    char *p;
+
+    l = apr_hash_get(osrs->lease_table, host_id, id_len);
+    if ((l == NULL) || (l->overflow == 1)) return;  //** Not using leases or already sending everything
+
+    table = (alias == 1) ? l->aliases : l->paths;
+    if (apr_hash_get(table, path, APR_HASH_KEY_STRING) != NULL) return;
+
+    if ((apr_hash_count(l->paths) + apr_hash_count(l->aliases)) >= (unsigned int)osrs->lease_max_paths) {
+        log_printf(1, "Lease table full for host=%s.  Sending all changes\n", l->host_id);
+        l->overflow = 1;
+        _osrs_lease_clear(l);
+        return;
+    }
+
+    p = strdup(path);
+    apr_hash_set(table, p, APR_HASH_KEY_STRING, p);
+}
+
+//***********************************************************************
+// osrs_lease_add - Records that the client could be caching the path
+//***********************************************************************
+
+void osrs_lease_add(object_service_fn_t *os, char *host_id, int id_len, char *path, int alias)
+{
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+
+    apr_thread_mutex_lock(osrs->lease_lock);
+    _osrs_lease_add(osrs, host_id, id_len, path, alias);
+    apr_thread_mutex_unlock(osrs->lease_lock);
+}
+
+//***********************************************************************
+// _osrs_lease_settle - Moves a lease that was added as an alias, since the
+//     object type wasn't known yet, over to the plain paths now that the
+//     object turned out to have only the one name.  A lease broken in the
+//     meantime stays broken.
+//     NOTE: Assumes the lease_lock is held
+//***********************************************************************
+
+void _osrs_lease_settle(osrs_priv_t *osrs, char *host_id, int id_len, char *path)
+{
+    osrs_lease_t *l;
+    char *p;
+
+    l = apr_hash_get(osrs->lease_table, host_id, id_len);
+    if (l == NULL) return;
+
+    p = apr_hash_get(l->aliases, path, APR_HASH_KEY_STRING);
+    if (p == NULL) return;
+
+    apr_hash_set(l->aliases, p, APR_HASH_KEY_STRING, NULL);
+    if (apr_hash_get(l->paths, p, APR_HASH_KEY_STRING) != NULL) {
+        free(p);
+    } else {
+        apr_hash_set(l->paths, p, APR_HASH_KEY_STRING, p);
+    }
+}
+
+//***********************************************************************
+// osrs_lease_settle - Finishes a lease added with an unknown object type
+//     once the type has been read
+//***********************************************************************
+
+void osrs_lease_settle(object_service_fn_t *os, char *host_id, int id_len, char *path, int alias)
+{
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+
+    if (alias != 0) return;  //** Already where it belongs
+
+    apr_thread_mutex_lock(osrs->lease_lock);
+    _osrs_lease_settle(osrs, host_id, id_len, path);
+    apr_thread_mutex_unlock(osrs->lease_lock);
+}
+
+//***********************************************************************
+// osrs_lease_add_fd - Records a lease on the object the fd refers to.  If
+//     the object type isn't known yet the lease is kept with the aliases,
+//     which is always safe, and 1 is returned so the caller fetches "os.type"
+//     with the attributes and calls osrs_lease_settle_fd().
+//***********************************************************************
+
+int osrs_lease_add_fd(object_service_fn_t *os, char *host_id, int id_len, os_fd_t *fd)
+{
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    osrs_fd_path_t *fp;
+    int unknown;
+
+    unknown = 0;
+    apr_thread_mutex_lock(osrs->lease_lock);
+    fp = apr_hash_get(osrs->fd_path, &fd, sizeof(os_fd_t *));
+    if (fp != NULL) {
+        unknown = (fp->alias < 0) ? 1 : 0;
+        _osrs_lease_add(osrs, host_id, id_len, fp->path, (fp->alias == 0) ? 0 : 1);
+    }
+    apr_thread_mutex_unlock(osrs->lease_lock);
+
+    return(unknown);
+}
+
+//***********************************************************************
+// osrs_lease_settle_fd - Records the fd's object type and finishes the lease
+//     added by osrs_lease_add_fd()
+//***********************************************************************
+
+void osrs_lease_settle_fd(object_service_fn_t *os, char *host_id, int id_len, os_fd_t *fd, int alias)
+{
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    osrs_fd_path_t *fp;
+
+    apr_thread_mutex_lock(osrs->lease_lock);
+    fp = apr_hash_get(osrs->fd_path, &fd, sizeof(os_fd_t *));
+    if (fp != NULL) {
+        fp->alias = alias;
+        if (alias == 0) _osrs_lease_settle(osrs, host_id, id_len, fp->path);
+    }
+    apr_thread_mutex_unlock(osrs->lease_lock);
+}
+
+//***********************************************************************
+// _osrs_lease_invalidate - Queues an invalidation for every client holding
+//     a lease on the path.  If tree is set leases on anything under the path
+//     are also broken.  A NULL path or a change made through a symlink or
+//     hardlink breaks every lease since we can't name everything it touched.
+//     Any change also breaks the leases on aliased objects since it could have
+//     been made through another of their names.
+//     NOTE: Assumes the lease_lock is held
+//***********************************************************************
+
+void _osrs_lease_invalidate(osrs_priv_t *osrs, char *path, int tree, int alias)
+{
+    apr_hash_index_t *hi, *phi;
+    osrs_lease_t *l;
+    char *p;
+    int len, hit;
+
+    if (apr_hash_count(osrs->lease_table) == 0) return;
+
+    len = 0;
+    if (alias == 1) path = NULL;
+    if (path != NULL) {
+        len = strlen(path);
+        while ((len > 1) && (path[len-1] == '/')) len--;
+        if ((len == 1) && (path[0] == '/')) path = NULL;  //** Everything is under the root
+    }
+
+    for (hi = apr_hash_first(NULL, osrs->lease_table); hi != NULL; hi = apr_hash_next(hi)) {
+        l = apr_hash_this_val(hi);
+
+        hit = l->overflow;
+        if (path == NULL) {
+            hit = -1;
+        } else {
+            p = apr_hash_get(l->paths, path, APR_HASH_KEY_STRING);
+            if (p != NULL) {
+                apr_hash_set(l->paths, p, APR_HASH_KEY_STRING, NULL);
+                free(p);
+                hit = 1;
+            }
+
+            if (tree == 1) {
+                for (phi = apr_hash_first(NULL, l->paths); phi != NULL; phi = apr_hash_next(phi)) {
+                    p = apr_hash_this_val(phi);
+                    if ((strncmp(p, path, len) == 0) && (p[len] == '/')) {
+                        apr_hash_set(l->paths, p, APR_HASH_KEY_STRING, NULL);
+                        free(p);
+                        hit = 1;
+                    }
+                }
+            }
+        }
+
+        if ((hit == 0) && (apr_hash_count(l->aliases) == 0)) continue;
+
+        if ((hit < 0) || ((tbx_stack_count(l->pending) + apr_hash_count(l->aliases)) >= (unsigned int)osrs->lease_max_paths)) {  //** Have the client drop everything
+            l->reset = 1;
+            _osrs_lease_clear(l);
+        } else if (l->reset == 0) {
+            if (hit == 1) tbx_stack_push(l->pending, strndup(path, len));
+
+            //** Every name of an aliased object goes
+            for (phi = apr_hash_first(NULL, l->aliases); phi != NULL; phi = apr_hash_next(phi)) {
+                p = apr_hash_this_val(phi);
+                apr_hash_set(l->aliases, p, APR_HASH_KEY_STRING, NULL);
+                tbx_stack_push(l->pending, p);
+            }
+        }
+
+        _osrs_lease_reply(osrs, l);
+    }
+}
+
+//***********************************************************************
+// osrs_lease_invalidate - Breaks the leases on the path
+//***********************************************************************
+
+void osrs_lease_invalidate(object_service_fn_t *os, char *path, int tree)
+{
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+
+    apr_thread_mutex_lock(osrs->lease_lock);
+    _osrs_lease_invalidate(osrs, path, tree, 0);
+    apr_thread_mutex_unlock(osrs->lease_lock);
+}
+
+//***********************************************************************
+// osrs_lease_invalidate_fd - Breaks the leases on the object the fd refers to.
+//     The object type is only looked up if someone holds leases and no
+//     earlier read through the fd fetched it.
+//***********************************************************************
+
+void osrs_lease_invalidate_fd(object_service_fn_t *os, creds_t *creds, os_fd_t *fd)
+{
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    osrs_fd_path_t *fp;
+    int alias;
+
+    apr_thread_mutex_lock(osrs->lease_lock);
+    fp = apr_hash_get(osrs->fd_path, &fd, sizeof(os_fd_t *));
+    if ((fp != NULL) && (fp->alias < 0) && (apr_hash_count(osrs->lease_table) > 0)) {
+        apr_thread_mutex_unlock(osrs->lease_lock);
+        alias = osrs_object_alias(os, creds, fd);
+        apr_thread_mutex_lock(osrs->lease_lock);
+        fp = apr_hash_get(osrs->fd_path, &fd, sizeof(os_fd_t *));
+        if (fp != NULL) fp->alias = alias;
+    }
+    if (fp != NULL) _osrs_lease_invalidate(osrs, fp->path, 0, (fp->alias == 0) ? 0 : 1);
+    apr_thread_mutex_unlock(osrs->lease_lock);
+}
+
+//***********************************************************************
+// osrs_lease_thread - Answers parked lease polls whose wait has expired
+//***********************************************************************
+
+void *osrs_lease_thread(apr_thread_t *th, void *data)
+{
+    object_service_fn_t *os = (object_service_fn_t *)data;
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    apr_hash_index_t *hi;
+    osrs_lease_t *l;
+    apr_time_t now;
+
+    apr_thread_mutex_lock(osrs->lease_lock);
+    while (osrs->shutdown == 0) {
+        apr_thread_cond_timedwait(osrs->lease_cond, osrs->lease_lock, apr_time_from_sec(1));
+
+        if (osrs->lease_polls == 0) continue;
+        now = apr_time_now();
+        for (hi = apr_hash_first(NULL, osrs->lease_table); hi != NULL; hi = apr_hash_next(hi)) {
+            l = apr_hash_this_val(hi);
+            if ((l->poll != NULL) && ((l->poll_expire <= now) || (osrs->shutdown == 1))) _osrs_lease_reply(osrs, l);
+        }
+    }
+
+    //** Send everyone home
+    for (hi = apr_hash_first(NULL, osrs->lease_table); hi != NULL; hi = apr_hash_next(hi)) {
+        _osrs_lease_reply(osrs, apr_hash_this_val(hi));
+    }
+    apr_thread_mutex_unlock(osrs->lease_lock);
+
+    apr_thread_exit(th, 0);
+    return(NULL);
+}
+
+//***********************************************************************
+// osrs_lease_cb - Processes a lease poll.  If the client has nothing waiting
+//     the response is parked on the lease record and the worker returns.  It's
+//     sent by the next invalidation or by the lease thread when the wait time
+//     expires.  A negative wait releases the client's leases.
+//***********************************************************************
+
+void osrs_lease_cb(void *arg, mq_task_t *task)
+{
+    object_service_fn_t *os = (object_service_fn_t *)arg;
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    mq_frame_t *fid, *fuid, *fwait;
+    mq_msg_t *msg, *response;
+    osrs_lease_t *l;
+    unsigned char *data;
+    char *id;
+    int id_size, fsize, is_new;
+    int64_t wait;
+    intptr_t key;
+
+    log_printf(5, "Processing incoming request\n");
+
+    //** Parse the command.
+    msg = task->msg;
+    mq_remove_header(msg, 0);
+
+    fid = mq_msg_pop(msg);  //** This is the ID for responses
+    mq_frame_destroy(mq_msg_pop(msg));  //** Drop the application command frame
+
+    fuid = mq_msg_pop(msg);  //** Host/user ID
+    mq_get_frame(fuid, (void **)&id, &id_size);
+
+    fwait = mq_msg_pop(msg);  //** How long to wait
+    mq_get_frame(fwait, (void **)&data, &fsize);
+    if (tbx_zigzag_decode(data, fsize, &wait) < 0) wait = 0;
+
+    response = mq_make_response_core_msg(msg, fid);
+
+    if (wait < 0) {  //** Client is releasing its leases
+        apr_thread_mutex_lock(osrs->lease_lock);
+        l = apr_hash_get(osrs->lease_table, id, id_size);
+        key = (intptr_t)l;
+        apr_thread_mutex_unlock(osrs->lease_lock);
+
+        //** If the ongoing entry is already gone the expire routine has it
+        if ((l != NULL) && (mq_ongoing_remove(osrs->ongoing, id, id_size, key) != NULL)) {
+            apr_thread_mutex_lock(osrs->lease_lock);
+            _osrs_lease_drop(osrs, l);
+            apr_thread_mutex_unlock(osrs->lease_lock);
+        }
+
+        mq_msg_append_frame(response, mq_make_status_frame(op_success_status));
+        mq_msg_append_mem(response, NULL, 0, MQF_MSG_KEEP_DATA);  //** Empty frame
+        mq_submit(osrs->server_portal, mq_task_new(osrs->mqc, response, NULL, NULL, 30));
+        goto finished;
+    }
+
+    if (wait > osrs->lease_max_wait) wait = osrs->lease_max_wait;
+
+    //** Find or make the lease record
+    is_new = 0;
+    apr_thread_mutex_lock(osrs->lease_lock);
+    l = apr_hash_get(osrs->lease_table, id, id_size);
+    if (l == NULL) {
+        log_printf(5, "New lease host=%s\n", id);
+        tbx_type_malloc_clear(l, osrs_lease_t, 1);
+        tbx_type_malloc(l->host_id, char, id_size);
+        memcpy(l->host_id, id, id_size);
+        l->host_id_len = id_size;
+        assert_result(apr_pool_create(&(l->mpool), NULL), APR_SUCCESS);
+        l->paths = apr_hash_make(l->mpool);
+        l->aliases = apr_hash_make(l->mpool);
+        l->pending = tbx_stack_new();
+        l->reset = 1;  //** Anything the client already has could be stale
+        apr_hash_set(osrs->lease_table, l->host_id, l->host_id_len, l);
+        is_new = 1;
+    }
+    l->in_use++;
+    apr_thread_mutex_unlock(osrs->lease_lock);
+
+    //** The leases are dropped if the client stops heartbeating
+    if (is_new == 1) mq_ongoing_add(osrs->ongoing, 1, l->host_id, l->host_id_len, l, osrs_lease_expire, os);
+
+    //** Park the poll.  A stale one from the same client is answered now.
+    apr_thread_mutex_lock(osrs->lease_lock);
+    _osrs_lease_reply(osrs, l);
+    l->poll = response;
+    l->poll_expire = apr_time_now() + apr_time_from_sec(wait);
+    osrs->lease_polls++;
+
+    //** Answer right away if there's already something to send or the record is gone
+    if ((l->dead == 1) || (l->reset == 1) || (tbx_stack_count(l->pending) > 0) || (wait == 0) || (osrs->shutdown == 1)) {
+        _osrs_lease_reply(osrs, l);
+    }
+
+    l->in_use--;
+    if ((l->dead == 1) && (l->in_use == 0)) _osrs_lease_drop(osrs, l);
+    apr_thread_mutex_unlock(osrs->lease_lock);
+
+finished:
+    mq_frame_destroy(fwait);
+    mq_frame_destroy(fuid);
+}
+
+//***********************************************************************
+// osrs_unknown_cb - Lets the client know we don't support the command so it
+//     can fall back to another method
+//***********************************************************************
+
+void osrs_unknown_cb(void *arg, mq_task_t *task)
+{
+    object_service_fn_t *os = (object_service_fn_t *)arg;
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    mq_frame_t *fid;
+    mq_msg_t *msg, *response;
+    op_status_t status;
+
+    log_printf(5, "Processing incoming request\n");
+
+    msg = task->msg;
+    mq_remove_header(msg, 0);
+
+    fid = mq_msg_pop(msg);  //** This is the ID
+
+    //** Form the response
+    status.op_status = OP_STATE_FAILURE;
+    status.error_code = OSR_UNKNOWN_COMMAND;
+    response = mq_make_response_core_msg(msg, fid);
+    mq_msg_append_frame(response, mq_make_status_frame(status));
+    mq_msg_append_mem(response, NULL, 0, MQF_MSG_KEEP_DATA);  //** Empty frame
+
+    mq_submit(osrs->server_portal, mq_task_new(osrs->mqc, response, NULL, NULL, 30));
+}
+
 //***********************************************************************
 // osrs_exists_cb - Processes the object exists command
 //***********************************************************************
@@ -518,6 +1130,7 @@ void osrs_remove_object_cb(void *arg, mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_lease_invalidate(os, name, 1);
     } else {
         status = op_failure_status;
     }
@@ -660,6 +1273,7 @@ void osrs_remove_regex_object_cb(void *arg, mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        osrs_lease_invalidate(os, NULL, 1);  //** No telling what was removed so break every lease
     } else {
         status = op_failure_status;
     }
@@ -922,6 +1536,10 @@ void osrs_move_object_cb(void *arg, mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) {
+            osrs_lease_invalidate(os, src_name, 1);
+            osrs_lease_invalidate(os, dest_name, 1);
+        }
     } else {
         status = op_failure_status;
     }
@@ -1015,7 +1633,8 @@ void osrs_open_object_cb(void *arg, mq_task_t *task)
         mq_get_frame(fhb, (void **)&handle, &handle_len);
         log_printf(5, "handle=%s\n", handle);
         log_printf(5, "handle_len=%d\n", handle_len);
-        oo = mq_ongoing_add(osrs->ongoing, 1, handle, handle_len, (void *)fd, (mq_ongoing_fail_t *)osrs->os_child->close_object, osrs->os_child);
+        osrs_fd_path_add(os, fd, src_name);
+        oo = mq_ongoing_add(osrs->ongoing, 1, handle, handle_len, (void *)fd, osrs_ongoing_close_object, os);
 
         n=sizeof(intptr_t);
         log_printf(5, "PTR key=%" PRIdPTR " len=%d\n", oo->key, n);
@@ -1078,6 +1697,7 @@ void osrs_close_object_cb(void *arg, mq_task_t *task)
     if ((handle = mq_ongoing_remove(osrs->ongoing, id, fsize, key)) != NULL) {
         log_printf(6, "Found handle\n");
 
+        osrs_fd_path_remove(os, handle);
         gop = os_close_object(osrs->os_child, handle);
         gop_waitall(gop);
         status = gop_get_status(gop);
@@ -1101,6 +1721,174 @@ void osrs_close_object_cb(void *arg, mq_task_t *task)
 
 //***********************************************************************
 // osrs_abort_open_object_cb - Aborts a pending open object call
+//***********************************************************************
+// osrs_parse_get_attr_list - Parses the list of attributes to retrieve.
+//   Returns 0 on success.  The arrays are returned even on failure and
+//   must be freed with osrs_free_get_attr_list().  They have a spare slot
+//   at the end for osrs_get_attr_type_slot().
+//***********************************************************************
+
+int osrs_parse_get_attr_list(object_service_fn_t *os, unsigned char *data, int fsize, int64_t *max_stream, int64_t *timeout, int64_t *n, char ***key_list, void ***val_list, int **v_size_list)
+{
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    int i, bpos, nbytes;
+    int64_t v;
+    char **key;
+    int *v_size;
+
+    *n = 0;
+
+    i = tbx_zigzag_decode(data, fsize, max_stream);
+    if (i<0) return(1);
+    if ((*max_stream <= 0) || (*max_stream > osrs->max_stream)) *max_stream = osrs->max_stream;
+    bpos = i;
+    fsize -= i;
+
+    i = tbx_zigzag_decode(&(data[bpos]), fsize, timeout);
+    if (i<0) return(1);
+    if (*timeout < 0) *timeout = 10;
+    bpos += i;
+    fsize -= i;
+
+    i = tbx_zigzag_decode(&(data[bpos]), fsize, n);
+    if ((i<0) || (*n<=0)) {
+        *n = 0;
+        return(1);
+    }
+    bpos += i;
+    fsize -= i;
+
+    log_printf(5, "max_stream=%" PRId64 " timeout=%" PRId64 " n=%" PRId64 "\n", *max_stream, *timeout, *n);
+    tbx_type_malloc_clear(key, char *, *n + 1);
+    tbx_type_malloc_clear(*val_list, void *, *n + 1);
+    tbx_type_malloc(v_size, int, *n + 1);
+    *key_list = key;
+    *v_size_list = v_size;
+
+    for (i=0; i<*n; i++) {
+        nbytes = tbx_zigzag_decode(&(data[bpos]), fsize, &v);
+        log_printf(5, "i=%d klen=" XOT " bpos=%d\n", i, v, bpos);
+
+        if ((nbytes<0) || (v<=0)) return(1);
+        bpos += nbytes;
+        fsize -= nbytes;
+
+        tbx_type_malloc(key[i], char, v+1);
+        if (v > fsize) return(1);
+        memcpy(key[i], &(data[bpos]), v);
+        key[i][v] = 0;
+        bpos += v;
+        fsize -= v;
+        log_printf(5, "i=%d key=%s bpos=%d\n", i, key[i], bpos);
+
+        nbytes = tbx_zigzag_decode(&(data[bpos]), fsize, &v);
+        if (nbytes<0) return(1);
+        bpos += nbytes;
+        fsize -= nbytes;
+        v_size[i] = -llabs(v);
+        log_printf(5, "i=%d v_size=" XOT " bpos=%d\n", i, v, bpos);
+    }
+
+    return(0);
+}
+
+//***********************************************************************
+// osrs_free_get_attr_list - Frees the attribute list and any values
+//   including the spare slot
+//***********************************************************************
+
+void osrs_free_get_attr_list(char **key, void **val, int *v_size, int n)
+{
+    int i;
+
+    if (key) {
+        for (i=0; i<=n; i++) if (key[i]) free(key[i]);
+        free(key);
+    }
+
+    if (val) {
+        for (i=0; i<=n; i++) if (val[i]) free(val[i]);
+        free(val);
+    }
+
+    if (v_size) free(v_size);
+}
+
+//***********************************************************************
+// osrs_get_attr_type_slot - Returns the slot in the attribute list holding
+//   "os.type" adding it in the spare slot if the client didn't ask for it.
+//   n is updated to the number of attributes to fetch.
+//***********************************************************************
+
+int osrs_get_attr_type_slot(char **key, int *v_size, int64_t *n)
+{
+    int i;
+
+    for (i=0; i<*n; i++) {
+        if (strcmp(key[i], "os.type") == 0) return(i);
+    }
+
+    key[i] = strdup("os.type");
+    v_size[i] = -32;
+    (*n)++;
+
+    return(i);
+}
+
+//***********************************************************************
+// osrs_write_get_attr_results - Writes the status and attribute values
+//***********************************************************************
+
+void osrs_write_get_attr_results(mq_stream_t *mqs, op_status_t status, void **val, int *v_size, int n)
+{
+    unsigned char buffer[32];
+    int i;
+
+    i = tbx_zigzag_encode(status.op_status, buffer);
+    i = i + tbx_zigzag_encode(status.error_code, &(buffer[i]));
+    mq_stream_write(mqs, buffer, i);
+
+    log_printf(5, "status.op_status=%d status.error_code=%d len=%d\n", status.op_status, status.error_code, i);
+    if (status.op_status == OP_STATE_SUCCESS) {
+        for (i=0; i<n; i++) {
+            mq_stream_write_varint(mqs, v_size[i]);
+            if (v_size[i] > 0) {
+                mq_stream_write(mqs, val[i], v_size[i]);
+            }
+            if (v_size[i] > 0) {
+                log_printf(15, "val[%d]=%s\n", i, (char *)val[i]);
+            } else {
+                log_printf(15, "val[%d]=NULL\n", i);
+            }
+        }
+    }
+}
+
+//***********************************************************************
+// osrs_finish_get_attr_stream - Flushes the response stream or sends a
+//   failure if the request couldn't be processed.
+//***********************************************************************
+
+void osrs_finish_get_attr_stream(object_service_fn_t *os, mq_stream_t *mqs, mq_msg_t *msg, mq_frame_t *fid, mq_frame_t *hid)
+{
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    unsigned char buffer[32];
+    op_status_t status;
+    int i;
+
+    if (mqs != NULL) {
+        mq_stream_destroy(mqs);  //** This also flushes the data to the client
+    } else {  //** there was an error processing the record
+        log_printf(5, "ERROR status being returned!\n");
+        mqs = mq_stream_write_create(osrs->mqc, osrs->server_portal, osrs->ongoing, MQS_PACK_RAW, 1024, 30, msg, fid, hid, 0);
+        status = op_failure_status;
+        i = tbx_zigzag_encode(status.op_status, buffer);
+        i = i + tbx_zigzag_encode(status.error_code, &(buffer[i]));
+        mq_stream_write(mqs, buffer, i);
+        mq_stream_destroy(mqs);
+    }
+}
+
 //***********************************************************************
 
 void osrs_abort_open_object_cb(void *arg, mq_task_t *task)
@@ -1149,20 +1937,126 @@ void osrs_get_mult_attr_cb(void *arg, mq_task_t *task)
     osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
     mq_frame_t *fid, *fuid, *fcred, *fdata, *ffd, *hid;
     creds_t *creds;
-    char *id;
+    char *id;
+    unsigned char *data;
+    op_generic_t *gop;
+    int fsize, len, id_size;
+    int64_t max_stream, timeout, n, nget;
+    mq_msg_t *msg;
+    mq_stream_t *mqs;
+    op_status_t status;
+    char **key;
+    void **val;
+    int *v_size;
+    int tslot;
+    os_fd_t *fd;
+    intptr_t fd_key;
+
+    log_printf(5, "Processing incoming request\n");
+
+    mqs = NULL;
+    key = NULL;
+    val = NULL;
+    v_size = NULL;
+    n = 0;
+
+    //** Parse the command.
+    msg = task->msg;
+    mq_remove_header(msg, 0);
+
+    fid = mq_msg_pop(msg);  //** This is the ID for responses
+    mq_frame_destroy(mq_msg_pop(msg));  //** Drop the application command frame
+    hid = mq_msg_pop(msg);  //** This is the Host ID for the ongoing stream
+
+    fcred = mq_msg_pop(msg);  //** This has the creds
+    creds = osrs_get_creds(os, fcred);
+
+    fuid = mq_msg_pop(msg);  //** Host/user ID
+    mq_get_frame(fuid, (void **)&id, &id_size);
+
+    //** Get the fd handle
+    ffd = mq_msg_pop(msg);  //** Host/user ID
+    mq_get_frame(ffd, (void **)&data, &len);
+    fd_key = *(intptr_t *)data;
+
+    log_printf(5, "PTR key=%" PRIdPTR " len=%d\n", fd_key, len);
+
+    fdata = mq_msg_pop(msg);  //** attr list
+    mq_get_frame(fdata, (void **)&data, &fsize);
+
+    log_printf(5, "PTR key=%" PRIdPTR " len=%d id=%s id_len=%d\n", fd_key, len, id, id_size);
+
+    //** Now check if the handle is valid
+    if ((fd = mq_ongoing_get(osrs->ongoing, (char *)id, id_size, fd_key)) == NULL) {
+        log_printf(5, "Invalid handle!\n");
+        goto fail;
+    }
+
+    //** Parse the attr list
+    if (osrs_parse_get_attr_list(os, data, fsize, &max_stream, &timeout, &n, &key, &val, &v_size) != 0) goto fail;
+
+    //** Execute the get attribute call
+    if (creds != NULL) {
+        nget = n;
+        tslot = -1;
+        if (osrs_lease_add_fd(os, id, id_size, fd) == 1) {  //** Done before the read so a racing change still breaks it
+            tslot = osrs_get_attr_type_slot(key, v_size, &nget);  //** Need the type so get it with the rest
+        }
+        gop = os_get_multiple_attrs(osrs->os_child, creds, fd, key, val, v_size, nget);
+        gop_waitall(gop);
+        status = gop_get_status(gop);
+        gop_free(gop, OP_DESTROY);
+        if ((tslot >= 0) && (status.op_status == OP_STATE_SUCCESS)) {
+            osrs_lease_settle_fd(os, id, id_size, fd, osrs_type_alias(val[tslot], v_size[tslot]));
+        }
+    } else {
+        status = op_failure_status;
+    }
+
+    //** Create the stream
+    mqs = mq_stream_write_create(osrs->mqc, osrs->server_portal, osrs->ongoing, MQS_PACK_COMPRESS, max_stream, timeout, msg, fid, hid, 0);
+    osrs_update_active_table(os, hid);  //** Update the active log
+
+    //** Return the results
+    osrs_write_get_attr_results(mqs, status, val, v_size, n);
+
+fail:
+    if (fd != NULL) mq_ongoing_release(osrs->ongoing, (char *)id, id_size, fd_key);
+
+    osrs_release_creds(os, creds);
+
+    mq_frame_destroy(ffd);
+    mq_frame_destroy(fuid);
+    mq_frame_destroy(fdata);
+    mq_frame_destroy(fcred);
+
+    osrs_finish_get_attr_stream(os, mqs, msg, fid, hid);
+    osrs_free_get_attr_list(key, val, v_size, n);
+}
+
+//***********************************************************************
+// osrs_get_mult_attr_immediate_cb - Opens the object, retrieves the
+//   attributes, and closes it in one request.  The response is the same
+//   as for osrs_get_mult_attr_cb.
+//***********************************************************************
+
+void osrs_get_mult_attr_immediate_cb(void *arg, mq_task_t *task)
+{
+    object_service_fn_t *os = (object_service_fn_t *)arg;
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    mq_frame_t *fid, *fuid, *fcred, *fname, *fdata, *hid;
+    creds_t *creds;
+    char *path, *id, *host_id;
     unsigned char *data;
-    op_generic_t *gop;
-    int fsize, bpos, len, id_size, i;
-    int64_t max_stream, timeout, n, v, nbytes;
+    int fsize, plen, host_id_len, tslot;
+    int64_t max_stream, timeout, n, nget;
     mq_msg_t *msg;
     mq_stream_t *mqs;
     op_status_t status;
-    unsigned char buffer[32];
     char **key;
     void **val;
     int *v_size;
     os_fd_t *fd;
-    intptr_t fd_key;
 
     log_printf(5, "Processing incoming request\n");
 
@@ -1170,6 +2064,7 @@ void osrs_get_mult_attr_cb(void *arg, mq_task_t *task)
     key = NULL;
     val = NULL;
     v_size = NULL;
+    n = 0;
 
     //** Parse the command.
     msg = task->msg;
@@ -1178,84 +2073,43 @@ void osrs_get_mult_attr_cb(void *arg, mq_task_t *task)
     fid = mq_msg_pop(msg);  //** This is the ID for responses
     mq_frame_destroy(mq_msg_pop(msg));  //** Drop the application command frame
     hid = mq_msg_pop(msg);  //** This is the Host ID for the ongoing stream
+    mq_get_frame(hid, (void **)&host_id, &host_id_len);
 
     fcred = mq_msg_pop(msg);  //** This has the creds
     creds = osrs_get_creds(os, fcred);
 
-    fuid = mq_msg_pop(msg);  //** Host/user ID
-    mq_get_frame(fuid, (void **)&id, &id_size);
-
-    //** Get the fd handle
-    ffd = mq_msg_pop(msg);  //** Host/user ID
-    mq_get_frame(ffd, (void **)&data, &len);
-    fd_key = *(intptr_t *)data;
+    fuid = mq_msg_pop(msg);  //** User ID for storing in lock attribute
 
-    log_printf(5, "PTR key=%" PRIdPTR " len=%d\n", fd_key, len);
+    fname = mq_msg_pop(msg);  //** Object name
+    mq_get_frame(fname, (void **)&path, &plen);
 
     fdata = mq_msg_pop(msg);  //** attr list
     mq_get_frame(fdata, (void **)&data, &fsize);
 
-    log_printf(5, "PTR key=%" PRIdPTR " len=%d id=%s id_len=%d\n", fd_key, len, id, id_size);
-
-    //** Now check if the handle is valid
-    if ((fd = mq_ongoing_get(osrs->ongoing, (char *)id, id_size, fd_key)) == NULL) {
-        log_printf(5, "Invalid handle!\n");
-        goto fail_fd;
-    }
-
-    //** Parse the attr list
-    i = tbx_zigzag_decode(data, fsize, &max_stream);
-    if (i<0) goto fail_fd;
-    if ((max_stream <= 0) || (max_stream > osrs->max_stream)) max_stream = osrs->max_stream;
-    bpos = i;
-    fsize -= i;
-
-    i = tbx_zigzag_decode(&(data[bpos]), fsize, &timeout);
-    if (i<0) goto fail_fd;
-    if (timeout < 0) timeout = 10;
-    bpos += i;
-    fsize -= i;
-
-    i = tbx_zigzag_decode(&(data[bpos]), fsize, &n);
-    if ((i<0) || (n<=0)) goto fail_fd;
-    bpos += i;
-    fsize -= i;
-
-    log_printf(5, "max_stream=%" PRId64 " timeout=%" PRId64 " n=%" PRId64 "\n", max_stream, timeout, n);
-    tbx_type_malloc_clear(key, char *, n);
-    tbx_type_malloc_clear(val, void *, n);
-    tbx_type_malloc(v_size, int, n);
-
-    for (i=0; i<n; i++) {
-        nbytes = tbx_zigzag_decode(&(data[bpos]), fsize, &v);
-        log_printf(5, "i=%d klen=" XOT " bpos=%d\n", i, v, bpos);
-
-        if ((nbytes<0) || (v<=0)) goto fail;
-        bpos += nbytes;
-        fsize -= nbytes;
-
-        tbx_type_malloc(key[i], char, v+1);
-        if (v > fsize) goto fail;
-        memcpy(key[i], &(data[bpos]), v);
-        key[i][v] = 0;
-        bpos += v;
-        fsize -= nbytes;
-        log_printf(5, "i=%d key=%s bpos=%d\n", i, key[i], bpos);
+    if ((plen <= 0) || (path[plen-1] != 0)) goto fail;  //** Make sure the name is NULL terminated
+    if (osrs_parse_get_attr_list(os, data, fsize, &max_stream, &timeout, &n, &key, &val, &v_size) != 0) goto fail;
 
-        nbytes = tbx_zigzag_decode(&(data[bpos]), fsize, &v);
-        if (nbytes<0) goto fail;
-        bpos += nbytes;
-        fsize -= nbytes;
-        v_size[i] = -llabs(v);
-        log_printf(5, "i=%d v_size=" XOT " bpos=%d\n", i, v, bpos);
-    }
+    log_printf(5, "fname=%s n=%" PRId64 "\n", path, n);
 
-    //** Execute the get attribute call
+    //** Do the open, get, and close
     if (creds != NULL) {
-        gop = os_get_multiple_attrs(osrs->os_child, creds, fd, key, val, v_size, n);
-        gop_waitall(gop);
-        status = gop_get_status(gop);
-        gop_free(gop, OP_DESTROY);
+        id = mq_frame_strdup(fuid);
+        status = gop_sync_exec_status(os_open_object(osrs->os_child, creds, path, OS_MODE_READ_IMMEDIATE, id, &fd, timeout));
+        if (id != NULL) free(id);
+        if (status.op_status == OP_STATE_SUCCESS) {
+            //** The lease goes in before the read so a racing change still breaks it.  The type
+            //** isn't known until the read so it starts out as an alias which is always safe.
+            osrs_lease_add(os, host_id, host_id_len, path, 1);
+            nget = n;
+            tslot = osrs_get_attr_type_slot(key, v_size, &nget);
+            status = gop_sync_exec_status(os_get_multiple_attrs(osrs->os_child, creds, fd, key, val, v_size, nget));
+            if (status.op_status == OP_STATE_SUCCESS) {
+                osrs_lease_settle(os, host_id, host_id_len, path, osrs_type_alias(val[tslot], v_size[tslot]));
+            }
+            if (gop_sync_exec(os_close_object(osrs->os_child, fd)) != OP_STATE_SUCCESS) {
+                log_printf(1, "ERROR closing object=%s\n", path);
+            }
+        }
     } else {
         status = op_failure_status;
     }
@@ -1265,59 +2119,18 @@ void osrs_get_mult_attr_cb(void *arg, mq_task_t *task)
     osrs_update_active_table(os, hid);  //** Update the active log
 
     //** Return the results
-    i = tbx_zigzag_encode(status.op_status, buffer);
-    i = i + tbx_zigzag_encode(status.error_code, &(buffer[i]));
-    mq_stream_write(mqs, buffer, i);
-
-    log_printf(5, "status.op_status=%d status.error_code=%d len=%d\n", status.op_status, status.error_code, i);
-    if (status.op_status == OP_STATE_SUCCESS) {
-        for (i=0; i<n; i++) {
-            mq_stream_write_varint(mqs, v_size[i]);
-            if (v_size[i] > 0) {
-                mq_stream_write(mqs, val[i], v_size[i]);
-            }
-            if (v_size[i] > 0) {
-                log_printf(15, "val[%d]=%s\n", i, (char *)val[i]);
-            } else {
-                log_printf(15, "val[%d]=NULL\n", i);
-            }
-        }
-    }
+    osrs_write_get_attr_results(mqs, status, val, v_size, n);
 
-fail_fd:
 fail:
-    if (fd != NULL) mq_ongoing_release(osrs->ongoing, (char *)id, id_size, fd_key);
-
     osrs_release_creds(os, creds);
 
-    mq_frame_destroy(ffd);
     mq_frame_destroy(fuid);
+    mq_frame_destroy(fname);
     mq_frame_destroy(fdata);
     mq_frame_destroy(fcred);
 
-    if (mqs != NULL) {
-        mq_stream_destroy(mqs);  //** This also flushes the data to the client
-    } else {  //** there was an error processing the record
-        log_printf(5, "ERROR status being returned!\n");
-        mqs = mq_stream_write_create(osrs->mqc, osrs->server_portal, osrs->ongoing, MQS_PACK_RAW, 1024, 30, msg, fid, hid, 0);
-        status = op_failure_status;
-        i = tbx_zigzag_encode(status.op_status, buffer);
-        i = i + tbx_zigzag_encode(status.error_code, &(buffer[i]));
-        mq_stream_write(mqs, buffer, i);
-        mq_stream_destroy(mqs);
-    }
-
-    if (key) {
-        for (i=0; i<n; i++) if (key[i]) free(key[i]);
-        free(key);
-    }
-
-    if (val) {
-        for (i=0; i<n; i++) if (val[i]) free(val[i]);
-        free(val);
-    }
-
-    if (v_size) free(v_size);
+    osrs_finish_get_attr_stream(os, mqs, msg, fid, hid);
+    osrs_free_get_attr_list(key, val, v_size, n);
 }
 
 //***********************************************************************
@@ -1444,6 +2257,7 @@ void osrs_set_mult_attr_cb(void *arg, mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_lease_invalidate_fd(os, creds, fd);
     } else {
         status = op_failure_status;
     }
@@ -1718,6 +2532,7 @@ void osrs_regex_set_mult_attr_cb(void *arg, mq_task_t *task)
 
         gop_waitall(spin.gop);
         status = gop_get_status(spin.gop);
+        osrs_lease_invalidate(os, NULL, 1);  //** No telling what was changed so break every lease
     } else {
         status = op_failure_status;
     }
@@ -1885,6 +2700,7 @@ void osrs_copy_mult_attr_cb(void *arg, mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_lease_invalidate_fd(os, creds, fd_dest);
     } else {
         status = op_failure_status;
     }
@@ -2040,6 +2856,7 @@ void osrs_move_mult_attr_cb(void *arg, mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_lease_invalidate_fd(os, creds, fd_src);
     } else {
         status = op_failure_status;
     }
@@ -2208,6 +3025,7 @@ void osrs_symlink_mult_attr_cb(void *arg, mq_task_t *task)
         gop_waitall(gop);
         status = gop_get_status(gop);
         gop_free(gop, OP_DESTROY);
+        if (status.op_status == OP_STATE_SUCCESS) osrs_lease_invalidate_fd(os, creds, fd_dest);
     } else {
         status = op_failure_status;
     }
@@ -2264,10 +3082,10 @@ void osrs_object_iter_alist_cb(void *arg, mq_task_t *task)
     int *v_size;
     char **key;
     char **val;
-    char *fname;
+    char *fname, *host_id;
     os_regex_table_t *path, *object_regex;
     creds_t *creds;
-    int fsize, bpos, n, i, err, ftype, prefix_len;
+    int fsize, bpos, n, i, err, ftype, prefix_len, id_len;
     int64_t recurse_depth, obj_types, timeout, n_attrs, len;
     mq_msg_t *msg;
     os_object_iter_t *it;
@@ -2383,10 +3201,13 @@ fail:
     if (it == NULL) goto finished;
 
     //** Pack up the data and send it out
+    mq_get_frame(hid, (void **)&host_id, &id_len);
     err = 0;
     while (((ftype = os_next_object(osrs->os_child, it, &fname, &prefix_len)) > 0) && (err == 0)) {
         osrs_update_active_table(os, hid);  //** Update the active log
 
+        if (n_attrs > 0) osrs_lease_add(os, host_id, id_len, fname, (ftype & (OS_OBJECT_SYMLINK|OS_OBJECT_HARDLINK)) ? 1 : 0);  //** The attrs can be cached
+
         len = strlen(fname);
         n = tbx_zigzag_encode(ftype, tbuf);
         n += tbx_zigzag_encode(prefix_len, &(tbuf[n]));
@@ -2445,6 +3266,162 @@ finished:
 
 }
 
+//***********************************************************************
+// osrs_du_iter_cb - Handles the du iterator.  The tally is done here and
+//    only the rollups are sent back.
+//***********************************************************************
+
+void osrs_du_iter_cb(void *arg, mq_task_t *task)
+{
+    object_service_fn_t *os = (object_service_fn_t *)arg;
+    osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
+    mq_frame_t *fid, *fcred, *fdata, *hid;
+    unsigned char *buffer;
+    unsigned char tbuf[64];
+    char *fname;
+    os_regex_table_t *path, *object_regex;
+    creds_t *creds;
+    int fsize, bpos, n, err, ftype;
+    int64_t recurse_depth, obj_types, timeout, rollup_depth, flags, len, bytes, count;
+    mq_msg_t *msg;
+    os_du_iter_t *it;
+    mq_stream_t *mqs;
+    op_status_t status;
+
+    log_printf(5, "Processing incoming request\n");
+
+    it = NULL;
+
+    //** Parse the command.
+    msg = task->msg;
+    mq_remove_header(msg, 0);
+
+    fid = mq_msg_pop(msg);  //** This is the ID
+    mq_frame_destroy(mq_msg_pop(msg));  //** Drop the application command frame
+    hid = mq_msg_pop(msg);  //** This is the Host ID for the ongoing stream
+
+    fcred = mq_msg_pop(msg);  //** This has the creds
+    creds = osrs_get_creds(os, fcred);
+
+    fdata = mq_msg_pop(msg);  //** This has the data
+    mq_get_frame(fdata, (void **)&buffer, &fsize);
+
+    //** Parse the buffer
+    path = NULL;
+    object_regex = NULL;
+    bpos = 0;
+
+    //** Get the stream timeout
+    n = tbx_zigzag_decode(&(buffer[bpos]), fsize-bpos, &timeout);
+    if (n < 0) {
+        timeout = 60;
+        mqs = mq_stream_write_create(osrs->mqc, osrs->server_portal, osrs->ongoing, MQS_PACK_COMPRESS, osrs->max_stream, timeout, msg, fid, hid, 0);
+        goto fail;
+    }
+    bpos += n;
+
+    //** Create the stream now and launch the flusher so the client gets
+    //** heartbeats while we tally.  Nothing is written until it's done.
+    mqs = mq_stream_write_create(osrs->mqc, osrs->server_portal, osrs->ongoing, MQS_PACK_COMPRESS, osrs->max_stream, timeout, msg, fid, hid, 1);
+
+    n = tbx_zigzag_decode(&(buffer[bpos]), fsize-bpos, &recurse_depth);
+    if (n < 0) goto fail;
+    bpos += n;
+
+    n = tbx_zigzag_decode(&(buffer[bpos]), fsize-bpos, &obj_types);
+    if (n < 0) goto fail;
+    bpos += n;
+
+    n = tbx_zigzag_decode(&(buffer[bpos]), fsize-bpos, &rollup_depth);
+    if (n < 0) goto fail;
+    bpos += n;
+
+    n = tbx_zigzag_decode(&(buffer[bpos]), fsize-bpos, &flags);
+    if (n < 0) goto fail;
+    bpos += n;
+
+    path = os_regex_table_unpack(&(buffer[bpos]), fsize-bpos, &n);
+    if ((n == 0) || (path == NULL)) {
+        log_printf(0, "path=NULL\n");
+        goto fail;
+    }
+    bpos += n;
+
+    object_regex = os_regex_table_unpack(&(buffer[bpos]), fsize-bpos, &n);
+    if (n == 0) {
+        log_printf(0, "object_regex=NULL n=%d", n);
+        goto fail;
+    }
+    bpos += n;
+
+    //** run the task
+    if (creds != NULL) {
+        if (osrs->os_child->create_du_iter != NULL) {
+            it = os_create_du_iter(osrs->os_child, creds, path, object_regex, obj_types, recurse_depth, rollup_depth, flags);
+        } else {
+            it = os_create_du_iter_generic(osrs->os_child, creds, path, object_regex, obj_types, recurse_depth, rollup_depth, flags);
+        }
+    }
+
+fail:
+    //** Encode the status
+    status = (it != NULL) ? op_success_status : op_failure_status;
+    n = tbx_zigzag_encode(status.op_status, tbuf);
+    n = n + tbx_zigzag_encode(status.error_code, &(tbuf[n]));
+    mq_stream_write(mqs, tbuf, n);
+
+    //** Check if we kick out due to an error
+    if (it == NULL) goto finished;
+
+    //** Send the rollups
+    err = 0;
+    while (1) {
+        if (osrs->os_child->create_du_iter != NULL) {
+            ftype = os_next_du(osrs->os_child, it, &fname, &bytes, &count);
+        } else {
+            ftype = os_next_du_generic(osrs->os_child, it, &fname, &bytes, &count);
+        }
+        if (ftype <= 0) break;
+
+        len = strlen(fname);
+        n = tbx_zigzag_encode(ftype, tbuf);
+        n += tbx_zigzag_encode(len, &(tbuf[n]));
+        err += mq_stream_write(mqs, tbuf, n);
+        err += mq_stream_write(mqs, fname, len);
+        n = tbx_zigzag_encode(bytes, tbuf);
+        n += tbx_zigzag_encode(count, &(tbuf[n]));
+        err += mq_stream_write(mqs, tbuf, n);
+
+        log_printf(5, "ftype=%d fname=%s bytes=" I64T " count=" I64T "\n", ftype, fname, bytes, count);
+        free(fname);
+
+        if (err != 0) break;  //** Got a write error so break;
+    }
+
+    //** Flag this as the last entry
+    n = tbx_zigzag_encode(0, tbuf);
+    mq_stream_write(mqs, tbuf, n);
+
+    if (osrs->os_child->create_du_iter != NULL) {
+        os_destroy_du_iter(osrs->os_child, it);
+    } else {
+        os_destroy_du_iter_generic(osrs->os_child, it);
+    }
+
+finished:
+    osrs_release_creds(os, creds);
+
+    mq_frame_destroy(fdata);
+    mq_frame_destroy(fcred);
+
+    //** Flush the buffer
+    mq_stream_destroy(mqs);
+
+    //** Clean up
+    if (path != NULL) os_regex_table_destroy(path);
+    if (object_regex != NULL) os_regex_table_destroy(object_regex);
+}
+
 //***********************************************************************
 // osrs_object_iter_aregex_cb - Handles the attr regex object iterator
 //***********************************************************************
@@ -3014,13 +3991,38 @@ void os_remote_server_destroy(object_service_fn_t *os)
 {
     osrs_priv_t *osrs = (osrs_priv_t *)os->priv;
     osrs_active_t *a;
+    osrs_lease_t *l;
+    osrs_fd_path_t *fp;
+    apr_hash_index_t *hi;
+    apr_status_t value;
+
+    //** Kick out any parked lease polls
+    apr_thread_mutex_lock(osrs->lease_lock);
+    osrs->shutdown = 1;
+    apr_thread_cond_broadcast(osrs->lease_cond);
+    apr_thread_mutex_unlock(osrs->lease_lock);
+    apr_thread_join(&value, osrs->lease_thread);
 
     //** Remove the server portal
     mq_portal_remove(osrs->mqc, osrs->server_portal);
 
-    //** Shutdown the ongoing thread and task
+    //** Shutdown the ongoing thread and task.  This also expires the leases.
     mq_ongoing_destroy(osrs->ongoing);
 
+    //** Wait for any commands still running
+    mq_dispatch_destroy(osrs->dispatch);
+
+    //** Clean up any stragglers.  The hashes get destroyed with the pool.
+    for (hi = apr_hash_first(NULL, osrs->lease_table); hi != NULL; hi = apr_hash_next(hi)) {
+        l = apr_hash_this_val(hi);
+        _osrs_lease_drop(osrs, l);
+    }
+    for (hi = apr_hash_first(NULL, osrs->fd_path); hi != NULL; hi = apr_hash_next(hi)) {
+        fp = apr_hash_this_val(hi);
+        free(fp->path);
+        free(fp);
+    }
+
     //** Now destroy it
     mq_portal_destroy(osrs->server_portal);
 
@@ -3092,6 +4094,12 @@ object_service_fn_t *object_service_remote_server_create(service_manager_t *ess,
     osrs->spin = apr_hash_make(osrs->mpool);
     assert(osrs->spin != NULL);
 
+    //** Cache lease tracking
+    apr_thread_mutex_create(&(osrs->lease_lock), APR_THREAD_MUTEX_DEFAULT, osrs->mpool);
+    apr_thread_cond_create(&(osrs->lease_cond), osrs->mpool);
+    osrs->lease_table = apr_hash_make(osrs->mpool);
+    osrs->fd_path = apr_hash_make(osrs->mpool);
+
     //** Get the host name we bind to
     osrs->hostname= tbx_inip_get_string(fd, section, "address", NULL);
 
@@ -3105,6 +4113,10 @@ object_service_fn_t *object_service_remote_server_create(service_manager_t *ess,
     //** Max Stream size
     osrs->max_stream = tbx_inip_get_integer(fd, section, "max_stream", 1024*1024);
 
+    //** Cache lease limits
+    osrs->lease_max_paths = tbx_inip_get_integer(fd, section, "lease_max_paths", 100000);
+    osrs->lease_max_wait = tbx_inip_get_integer(fd, section, "lease_max_wait", 60);
+
     //** Start the child OS.
     stype = tbx_inip_get_string(fd, section, "os_local", NULL);
     if (stype == NULL) {  //** Oops missing child OS
@@ -3156,6 +4168,7 @@ object_service_fn_t *object_service_remote_server_create(service_manager_t *ess,
     mq_command_set(ctable, OSR_REGEX_SET_MULT_ATTR_KEY, OSR_REGEX_SET_MULT_ATTR_SIZE, os, osrs_regex_set_mult_attr_cb);
     mq_command_set(ctable, OSR_ABORT_REGEX_SET_MULT_ATTR_KEY, OSR_ABORT_REGEX_SET_MULT_ATTR_SIZE, os, osrs_abort_regex_set_mult_attr_cb);
     mq_command_set(ctable, OSR_GET_MULTIPLE_ATTR_KEY, OSR_GET_MULTIPLE_ATTR_SIZE, os, osrs_get_mult_attr_cb);
+    mq_command_set(ctable, OSR_GET_MULTIPLE_ATTR_IMMEDIATE_KEY, OSR_GET_MULTIPLE_ATTR_IMMEDIATE_SIZE, os, osrs_get_mult_attr_immediate_cb);
     mq_command_set(ctable, OSR_SET_MULTIPLE_ATTR_KEY, OSR_SET_MULTIPLE_ATTR_SIZE, os, osrs_set_mult_attr_cb);
     mq_command_set(ctable, OSR_COPY_MULTIPLE_ATTR_KEY, OSR_COPY_MULTIPLE_ATTR_SIZE, os, osrs_copy_mult_attr_cb);
     mq_command_set(ctable, OSR_MOVE_MULTIPLE_ATTR_KEY, OSR_MOVE_MULTIPLE_ATTR_SIZE, os, osrs_move_mult_attr_cb);
@@ -3164,12 +4177,81 @@ object_service_fn_t *object_service_remote_server_create(service_manager_t *ess,
     mq_command_set(ctable, OSR_OBJECT_ITER_AREGEX_KEY, OSR_OBJECT_ITER_AREGEX_SIZE, os, osrs_object_iter_aregex_cb);
     mq_command_set(ctable, OSR_ATTR_ITER_KEY, OSR_ATTR_ITER_SIZE, os, osrs_attr_iter_cb);
     mq_command_set(ctable, OSR_FSCK_ITER_KEY, OSR_FSCK_ITER_SIZE, os, osrs_fsck_iter_cb);
+    mq_command_set(ctable, OSR_DU_ITER_KEY, OSR_DU_ITER_SIZE, os, osrs_du_iter_cb);
     mq_command_set(ctable, OSR_FSCK_OBJECT_KEY, OSR_FSCK_OBJECT_SIZE, os, osrs_fsck_object_cb);
+    mq_command_set(ctable, OSR_LEASE_KEY, OSR_LEASE_SIZE, os, osrs_lease_cb);
+    mq_command_table_set_default(ctable, os, osrs_unknown_cb);
+
+    //** Put a fair dispatcher in front of the table so a client running big scans can't starve
+    //** everyone else.  Aborts, heartbeats, closes, and the parked lease polls skip the queues.
+    //** Closes go direct since they release what a blocked open is waiting on.
+    osrs->dispatch = mq_dispatch_create(osrs->server_portal, tbx_inip_get_integer(fd, section, "dispatch_cheap_threads", 0),
+                                        tbx_inip_get_integer(fd, section, "dispatch_expensive_threads", 0),
+                                        tbx_inip_get_integer(fd, section, "dispatch_quantum_us", 1000));
+    mq_dispatch_class_set(osrs->dispatch, OSR_SPIN_HB_KEY, OSR_SPIN_HB_SIZE, "spin_hb", MQD_LANE_DIRECT);
+    mq_dispatch_class_set(osrs->dispatch, OSR_EXISTS_KEY, OSR_EXISTS_SIZE, "exists", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_CREATE_OBJECT_KEY, OSR_CREATE_OBJECT_SIZE, "create_object", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_REMOVE_OBJECT_KEY, OSR_REMOVE_OBJECT_SIZE, "remove_object", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_REMOVE_REGEX_OBJECT_KEY, OSR_REMOVE_REGEX_OBJECT_SIZE, "remove_regex_object", MQD_LANE_EXPENSIVE);
+    mq_dispatch_class_set(osrs->dispatch, OSR_ABORT_REMOVE_REGEX_OBJECT_KEY, OSR_ABORT_REMOVE_REGEX_OBJECT_SIZE, "abort_remove_regex_object", MQD_LANE_DIRECT);
+    mq_dispatch_class_set(osrs->dispatch, OSR_MOVE_OBJECT_KEY, OSR_MOVE_OBJECT_SIZE, "move_object", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_SYMLINK_OBJECT_KEY, OSR_SYMLINK_OBJECT_SIZE, "symlink_object", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_HARDLINK_OBJECT_KEY, OSR_HARDLINK_OBJECT_SIZE, "hardlink_object", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_OPEN_OBJECT_KEY, OSR_OPEN_OBJECT_SIZE, "open_object", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_CLOSE_OBJECT_KEY, OSR_CLOSE_OBJECT_SIZE, "close_object", MQD_LANE_DIRECT);
+    mq_dispatch_class_set(osrs->dispatch, OSR_ABORT_OPEN_OBJECT_KEY, OSR_ABORT_OPEN_OBJECT_SIZE, "abort_open_object", MQD_LANE_DIRECT);
+    mq_dispatch_class_set(osrs->dispatch, OSR_REGEX_SET_MULT_ATTR_KEY, OSR_REGEX_SET_MULT_ATTR_SIZE, "regex_set_mult_attr", MQD_LANE_EXPENSIVE);
+    mq_dispatch_class_set(osrs->dispatch, OSR_ABORT_REGEX_SET_MULT_ATTR_KEY, OSR_ABORT_REGEX_SET_MULT_ATTR_SIZE, "abort_regex_set_mult_attr", MQD_LANE_DIRECT);
+    mq_dispatch_class_set(osrs->dispatch, OSR_GET_MULTIPLE_ATTR_KEY, OSR_GET_MULTIPLE_ATTR_SIZE, "get_mult_attr", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_GET_MULTIPLE_ATTR_IMMEDIATE_KEY, OSR_GET_MULTIPLE_ATTR_IMMEDIATE_SIZE, "get_mult_attr_immediate", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_SET_MULTIPLE_ATTR_KEY, OSR_SET_MULTIPLE_ATTR_SIZE, "set_mult_attr", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_COPY_MULTIPLE_ATTR_KEY, OSR_COPY_MULTIPLE_ATTR_SIZE, "copy_mult_attr", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_MOVE_MULTIPLE_ATTR_KEY, OSR_MOVE_MULTIPLE_ATTR_SIZE, "move_mult_attr", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_SYMLINK_MULTIPLE_ATTR_KEY, OSR_SYMLINK_MULTIPLE_ATTR_SIZE, "symlink_mult_attr", MQD_LANE_CHEAP);
+    mq_dispatch_class_set(osrs->dispatch, OSR_OBJECT_ITER_ALIST_KEY, OSR_OBJECT_ITER_ALIST_SIZE, "object_iter_alist", MQD_LANE_EXPENSIVE);
+    mq_dispatch_class_set(osrs->dispatch, OSR_OBJECT_ITER_AREGEX_KEY, OSR_OBJECT_ITER_AREGEX_SIZE, "object_iter_aregex", MQD_LANE_EXPENSIVE);
+    mq_dispatch_class_set(osrs->dispatch, OSR_ATTR_ITER_KEY, OSR_ATTR_ITER_SIZE, "attr_iter", MQD_LANE_EXPENSIVE);
+    mq_dispatch_class_set(osrs->dispatch, OSR_FSCK_ITER_KEY, OSR_FSCK_ITER_SIZE, "fsck_iter", MQD_LANE_EXPENSIVE);
+    mq_dispatch_class_set(osrs->dispatch, OSR_DU_ITER_KEY, OSR_DU_ITER_SIZE, "du_iter", MQD_LANE_EXPENSIVE);
+    mq_dispatch_class_set(osrs->dispatch, OSR_FSCK_OBJECT_KEY, OSR_FSCK_OBJECT_SIZE, "fsck_object", MQD_LANE_EXPENSIVE);
+    mq_dispatch_class_set(osrs->dispatch, OSR_LEASE_KEY, OSR_LEASE_SIZE, "lease", MQD_LANE_DIRECT);
+    mq_dispatch_class_set(osrs->dispatch, MQS_MORE_DATA_KEY, MQS_MORE_DATA_SIZE, "stream_more_data", MQD_LANE_DIRECT);
+    mq_dispatch_class_set(osrs->dispatch, ONGOING_KEY, ONGOING_SIZE, "ongoing", MQD_LANE_DIRECT);
+
+    //** Every queued command carries the client's creds handle.  It comes right after the command
+    //** or after the host ID for the commands that have one.  The host ID isn't sent with all of
+    //** them so the creds handle is what we key on.  Both are fixed for the client process unlike
+    //** the connection it used.
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_EXISTS_KEY, OSR_EXISTS_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_CREATE_OBJECT_KEY, OSR_CREATE_OBJECT_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_REMOVE_OBJECT_KEY, OSR_REMOVE_OBJECT_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_MOVE_OBJECT_KEY, OSR_MOVE_OBJECT_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_SYMLINK_OBJECT_KEY, OSR_SYMLINK_OBJECT_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_HARDLINK_OBJECT_KEY, OSR_HARDLINK_OBJECT_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_OPEN_OBJECT_KEY, OSR_OPEN_OBJECT_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_SET_MULTIPLE_ATTR_KEY, OSR_SET_MULTIPLE_ATTR_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_COPY_MULTIPLE_ATTR_KEY, OSR_COPY_MULTIPLE_ATTR_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_MOVE_MULTIPLE_ATTR_KEY, OSR_MOVE_MULTIPLE_ATTR_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_SYMLINK_MULTIPLE_ATTR_KEY, OSR_SYMLINK_MULTIPLE_ATTR_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_FSCK_OBJECT_KEY, OSR_FSCK_OBJECT_SIZE, 1);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_REMOVE_REGEX_OBJECT_KEY, OSR_REMOVE_REGEX_OBJECT_SIZE, 2);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_REGEX_SET_MULT_ATTR_KEY, OSR_REGEX_SET_MULT_ATTR_SIZE, 2);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_GET_MULTIPLE_ATTR_KEY, OSR_GET_MULTIPLE_ATTR_SIZE, 2);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_GET_MULTIPLE_ATTR_IMMEDIATE_KEY, OSR_GET_MULTIPLE_ATTR_IMMEDIATE_SIZE, 2);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_OBJECT_ITER_ALIST_KEY, OSR_OBJECT_ITER_ALIST_SIZE, 2);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_OBJECT_ITER_AREGEX_KEY, OSR_OBJECT_ITER_AREGEX_SIZE, 2);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_ATTR_ITER_KEY, OSR_ATTR_ITER_SIZE, 2);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_FSCK_ITER_KEY, OSR_FSCK_ITER_SIZE, 2);
+    mq_dispatch_client_frame_set(osrs->dispatch, OSR_DU_ITER_KEY, OSR_DU_ITER_SIZE, 2);
+    mq_portal_dispatch_set(osrs->server_portal, osrs->dispatch);
 
     //** Make the ongoing checker
     osrs->ongoing = mq_ongoing_create(osrs->mqc, osrs->server_portal, osrs->ongoing_interval, ONGOING_SERVER);
     assert(osrs->ongoing != NULL);
 
+    //** And the thread answering expired lease polls
+    tbx_thread_create_assert(&(osrs->lease_thread), NULL, osrs_lease_thread, (void *)os, osrs->mpool);
+
     //** This is to handle client stream responses
     mq_command_set(ctable, MQS_MORE_DATA_KEY, MQS_MORE_DATA_SIZE, osrs->ongoing, mqs_server_more_cb);
 
@@ -28,11 +28,17 @@
 #include "thread_pool.h"
 #include "os_file.h"
 #include "os_timecache.h"
+#include "os_timecache_index.h"
 #include "os_remote.h"
 
 #define OSTC_LOCK(ostc); log_printf(5, "LOCK\n"); apr_thread_mutex_lock(ostc->lock)
 #define OSTC_UNLOCK(ostc) log_printf(5, "UNLOCK\n"); apr_thread_mutex_unlock(ostc->lock)
 
+//** An object's attrs are read by index hits holding just the stripe lock so
+//** changing them requires the stripe write lock in addition to ostc->lock
+#define OSTC_OBJ_LOCK(ostc, obj) ostc_index_write_lock((ostc)->index, (obj)->stripe)
+#define OSTC_OBJ_UNLOCK(ostc, obj) ostc_index_unlock((ostc)->index, (obj)->stripe)
+
 #define OSTC_ITER_ALIST  0
 #define OSTC_ITER_AREGEX 1
 
@@ -51,15 +57,20 @@ typedef struct {
     apr_time_t expire;
 } ostcdb_attr_t;
 
-typedef struct {
+typedef struct ostcdb_object_s ostcdb_object_t;
+
+struct ostcdb_object_s {
     char *fname;
+    char *path;               //** Full path.  This is the index key
     int ftype;
+    int stripe;               //** Index stripe for the path
     char *link;
     apr_pool_t *mpool;
     apr_hash_t *objects;
     apr_hash_t *attrs;
+    ostcdb_object_t *parent;
     apr_time_t expire;
-} ostcdb_object_t;
+};
 
 typedef struct {
     char *fname;
@@ -104,6 +115,7 @@ typedef struct {
     int v_max;
     ostc_cacheprep_t cp;
     int iter_type;
+    uint64_t lease_gen;
 } ostc_object_iter_t;
 
 typedef struct {
@@ -112,6 +124,8 @@ typedef struct {
     ostc_fd_t *fd;
     ostc_fd_t *fd_dest;
     char **src_path;
+    char *path;     //** Used by the immediate ops which don't have an FD
+    char *id;
     char **key;
     char **key_dest;
     void **val;
@@ -138,9 +152,13 @@ typedef struct {
     apr_pool_t *mpool;
     thread_pool_context_t *tpc;
     ostcdb_object_t *cache_root;
+    ostc_index_t *index;           //** Full path -> ostcdb_object_t used for lookups that skip the walk
     apr_time_t entry_timeout;
+    apr_time_t lease_timeout;      //** Entry lifetime while the server is tracking our leases
     apr_time_t cleanup_interval;
     apr_thread_t *cleanup_thread;
+    uint64_t lease_gen;            //** Bumped on every invalidation
+    int lease_active;
     int shutdown;
 } ostc_priv_t;
 
@@ -159,6 +177,7 @@ typedef struct {
 
 op_status_t ostc_close_object_fn(void *arg, int tid);
 op_status_t ostc_delayed_open_object(object_service_fn_t *os, ostc_fd_t *fd);
+void ostc_cache_remove_object(object_service_fn_t *os, char *path);
 
 //***********************************************************************
 // free_ostcdb_attr - Destroys a cached attribute
@@ -198,57 +217,132 @@ ostcdb_attr_t *new_ostcdb_attr(char *key, void *val, int v_size, apr_time_t expi
 }
 
 //***********************************************************************
-// free_ostcdb_object - Destroys a cache object
+// _ostcdb_object_release - Frees the object's memory.  The object must
+//     already be out of the index and have no children.
 //***********************************************************************
 
-void free_ostcdb_object(ostcdb_object_t *obj)
+void _ostcdb_object_release(ostcdb_object_t *obj)
 {
-    ostcdb_object_t *o;
-    ostcdb_attr_t *a;
-    apr_hash_index_t *ohi;
     apr_hash_index_t *ahi;
 
-    //** Free my attributes
     for (ahi = apr_hash_first(NULL, obj->attrs); ahi != NULL; ahi = apr_hash_next(ahi)) {
-        a = apr_hash_this_val(ahi);
-        free_ostcdb_attr(a);
+        free_ostcdb_attr(apr_hash_this_val(ahi));
     }
 
-    //** Now free all the children objects
+    if (obj->fname != NULL) free(obj->fname);
+    if (obj->path != NULL) free(obj->path);
+    if (obj->link != NULL) free(obj->link);
+    apr_pool_destroy(obj->mpool);
+    free(obj);
+}
+
+//***********************************************************************
+// free_ostcdb_object - Destroys a cache object and all it's children.
+//     The caller is responsible for removing it from the parent.
+//     NOTE: ostc->lock must be held by the calling process
+//***********************************************************************
+
+void free_ostcdb_object(ostc_priv_t *ostc, ostcdb_object_t *obj)
+{
+    apr_hash_index_t *ohi;
+
+    //** Free all the children objects
     if (obj->objects != NULL) {
         for (ohi = apr_hash_first(NULL, obj->objects); ohi != NULL; ohi = apr_hash_next(ohi)) {
-            o = apr_hash_this_val(ohi);
-            free_ostcdb_object(o);
+            free_ostcdb_object(ostc, apr_hash_this_val(ohi));
         }
     }
 
-    if (obj->fname != NULL) free(obj->fname);
-    if (obj->link != NULL) free(obj->link);
-    apr_pool_destroy(obj->mpool);
-    free(obj);
+    //** Pull it from the index.  Once we have the write lock no readers can still be using it
+    OSTC_OBJ_LOCK(ostc, obj);
+    if (ostc_index_get(ostc->index, obj->stripe, obj->path) == obj) ostc_index_set(ostc->index, obj->stripe, obj->path, NULL);
+    OSTC_OBJ_UNLOCK(ostc, obj);
+
+    _ostcdb_object_release(obj);
 }
 
 //***********************************************************************
-// new_ostcdb_object - Creates a new cache object
+// new_ostcdb_object - Creates a new cache object and adds it to the index.
+//     The caller is responsible for adding it to the parent.
+//     NOTE: ostc->lock must be held by the calling process
 //***********************************************************************
 
-ostcdb_object_t *new_ostcdb_object(char *entry, int ftype, apr_time_t expire, apr_pool_t *mpool)
+ostcdb_object_t *new_ostcdb_object(ostc_priv_t *ostc, ostcdb_object_t *parent, char *entry, int ftype, apr_time_t expire)
 {
     ostcdb_object_t *obj;
+    int n;
 
-    tbx_type_malloc(obj, ostcdb_object_t, 1);
+    tbx_type_malloc_clear(obj, ostcdb_object_t, 1);
 
     obj->fname = entry;
     obj->expire = expire;
     obj->ftype = ftype;
-    obj->link = NULL;
+    obj->parent = parent;
+    if (parent == NULL) {
+        obj->path = strdup("/");
+    } else {
+        n = strlen(parent->path) + 1 + strlen(entry) + 1;
+        tbx_type_malloc(obj->path, char, n);
+        snprintf(obj->path, n, "%s%s%s", parent->path, (parent->parent == NULL) ? "" : "/", entry);
+    }
     apr_pool_create(&(obj->mpool), NULL);
-    obj->objects = (ftype & OS_OBJECT_DIR) ? apr_hash_make(mpool) : NULL;
-    obj->attrs = apr_hash_make(mpool);
+    obj->objects = (ftype & OS_OBJECT_DIR) ? apr_hash_make(obj->mpool) : NULL;
+    obj->attrs = apr_hash_make(obj->mpool);
+
+    obj->stripe = ostc_index_stripe(ostc->index, obj->path);
+    OSTC_OBJ_LOCK(ostc, obj);
+    ostc_index_set(ostc->index, obj->stripe, obj->path, obj);
+    OSTC_OBJ_UNLOCK(ostc, obj);
 
     return(obj);
 }
 
+//***********************************************************************
+// _ostc_drop_children - Removes all the object's children
+//     NOTE: ostc->lock must be held by the calling process
+//***********************************************************************
+
+void _ostc_drop_children(ostc_priv_t *ostc, ostcdb_object_t *obj)
+{
+    apr_hash_index_t *hi;
+    ostcdb_object_t *o;
+
+    if (obj->objects == NULL) return;
+
+    for (hi = apr_hash_first(NULL, obj->objects); hi != NULL; hi = apr_hash_next(hi)) {
+        o = apr_hash_this_val(hi);
+        apr_hash_set(obj->objects, o->fname, APR_HASH_KEY_STRING, NULL);
+        free_ostcdb_object(ostc, o);
+    }
+}
+
+//***********************************************************************
+// _ostc_prune_attrs - Frees the object's expired attributes and returns
+//     the number kept.
+//     NOTE: ostc->lock and the object's stripe write lock must be held
+//***********************************************************************
+
+int _ostc_prune_attrs(ostcdb_object_t *obj, apr_time_t expired)
+{
+    ostcdb_attr_t *a;
+    apr_hash_index_t *hi;
+    int akept;
+
+    akept = 0;
+    for (hi = apr_hash_first(NULL, obj->attrs); hi != NULL; hi = apr_hash_next(hi)) {
+        a = apr_hash_this_val(hi);
+        log_printf(5, "fname=%s attr=%s a->expire=" TT " expired=" TT "\n", obj->fname, a->key, a->expire, expired);
+        if (a->expire < expired) {
+            apr_hash_set(obj->attrs, a->key, APR_HASH_KEY_STRING, NULL);
+            free_ostcdb_attr(a);
+        } else {
+            akept++;
+        }
+    }
+
+    return(akept);
+}
+
 //***********************************************************************
 // _ostc_cleanup - Clean's out the cache of expired objects/attributes
 //     NOTE: ostc->lock must be held by the calling process
@@ -256,8 +350,8 @@ ostcdb_object_t *new_ostcdb_object(char *entry, int ftype, apr_time_t expire, ap
 
 int _ostc_cleanup(object_service_fn_t *os, ostcdb_object_t *obj, apr_time_t expired)
 {
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
     ostcdb_object_t *o;
-    ostcdb_attr_t *a;
     apr_hash_index_t *hi;
     int okept, akept, result;
 
@@ -272,43 +366,139 @@ int _ostc_cleanup(object_service_fn_t *os, ostcdb_object_t *obj, apr_time_t expi
             okept += result;
             if (result == 0) {
                 apr_hash_set(obj->objects, o->fname, APR_HASH_KEY_STRING, NULL);
-                free_ostcdb_object(o);
+                free_ostcdb_object(ostc, o);
             }
         }
     }
 
     //** Free my expired attributes
-    akept = 0;
-    for (hi = apr_hash_first(NULL, obj->attrs); hi != NULL; hi = apr_hash_next(hi)) {
-        a = apr_hash_this_val(hi);
-        log_printf(5, "fname=%s attr=%s a->expire=" TT " expired=" TT "\n", obj->fname, a->key, a->expire, expired);
-        if (a->expire < expired) {
-            apr_hash_set(obj->attrs, a->key, APR_HASH_KEY_STRING, NULL);
-            free_ostcdb_attr(a);
-        } else {
-            akept++;
-        }
-    }
+    OSTC_OBJ_LOCK(ostc, obj);
+    akept = _ostc_prune_attrs(obj, expired);
+    OSTC_OBJ_UNLOCK(ostc, obj);
 
     log_printf(5, "fname=%s akept=%d okept=%d o+a=%d\n", obj->fname, akept, okept, akept+okept);
     return(akept + okept);
 }
 
 //***********************************************************************
-// ostc_cache_compact_thread - Thread for cleaning out the cache
+// _ostc_cleanup_stripe - Cleans out the expired entries for the objects on
+//     a single index stripe.  Objects left empty are removed.  Removing an
+//     object can leave the parent empty and it will get picked up when it's
+//     stripe is processed.
+//     NOTE: ostc->lock must be held by the calling process
+//***********************************************************************
+
+void _ostc_cleanup_stripe(object_service_fn_t *os, int stripe, apr_time_t expired)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    ostcdb_object_t *obj;
+    apr_hash_index_t *hi;
+    int akept;
+
+    ostc_index_write_lock(ostc->index, stripe);
+    for (hi = ostc_index_first(ostc->index, stripe); hi != NULL; hi = apr_hash_next(hi)) {
+        obj = apr_hash_this_val(hi);
+        akept = _ostc_prune_attrs(obj, expired);
+        if ((akept > 0) || (obj->parent == NULL)) continue;
+        if ((obj->objects != NULL) && (apr_hash_count(obj->objects) > 0)) continue;
+
+        //** Nothing left so drop it
+        apr_hash_set(obj->parent->objects, obj->fname, APR_HASH_KEY_STRING, NULL);
+        ostc_index_set(ostc->index, stripe, obj->path, NULL);
+        _ostcdb_object_release(obj);
+    }
+    ostc_index_unlock(ostc->index, stripe);
+}
+
+//***********************************************************************
+// _ostc_expire_all - Returns a cleanup cutoff that purges every entry
+//***********************************************************************
+
+apr_time_t _ostc_expire_all(ostc_priv_t *ostc)
+{
+    return(apr_time_now() + 4*(ostc->entry_timeout + ostc->lease_timeout));
+}
+
+//***********************************************************************
+// ostc_lease_gen - Returns the invalidation generation.  This is grabbed
+//     before fetching so anything that races an invalidation only gets
+//     the normal entry_timeout.
+//***********************************************************************
+
+uint64_t ostc_lease_gen(ostc_priv_t *ostc)
+{
+    uint64_t gen;
+
+    OSTC_LOCK(ostc);
+    gen = ostc->lease_gen;
+    OSTC_UNLOCK(ostc);
+
+    return(gen);
+}
+
+//***********************************************************************
+// _ostc_entry_expire - Returns the expiration for an entry fetched at lease_gen
+//     NOTE: ostc->lock must be held by the calling process
+//***********************************************************************
+
+apr_time_t _ostc_entry_expire(ostc_priv_t *ostc, uint64_t lease_gen)
+{
+    if ((ostc->lease_active == 1) && (lease_gen == ostc->lease_gen)) {
+        return(apr_time_now() + ostc->lease_timeout);
+    }
+
+    return(apr_time_now() + ostc->entry_timeout);
+}
+
+//***********************************************************************
+// ostc_lease_cb - Handles the invalidations pushed by the remote server
+//***********************************************************************
+
+void ostc_lease_cb(void *arg, int mode, char *path)
+{
+    object_service_fn_t *os = (object_service_fn_t *)arg;
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+
+    log_printf(5, "mode=%d path=%s\n", mode, path);
+
+    OSTC_LOCK(ostc);
+    ostc->lease_gen++;
+    if (mode != OSRC_LEASE_INVALIDATE) {
+        ostc->lease_active = (mode == OSRC_LEASE_FLUSH) ? 1 : 0;
+        _ostc_cleanup(os, ostc->cache_root, _ostc_expire_all(ostc));
+    }
+    OSTC_UNLOCK(ostc);
+
+    if (mode == OSRC_LEASE_INVALIDATE) ostc_cache_remove_object(os, path);
+}
+
+//***********************************************************************
+// ostc_cache_compact_thread - Thread for cleaning out the cache.  The sweep
+//     is done a stripe at a time dropping the lock in between so it never
+//     holds up the whole cache.
 //***********************************************************************
 
 void *ostc_cache_compact_thread(apr_thread_t *th, void *data)
 {
     object_service_fn_t *os = (object_service_fn_t *)data;
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    apr_time_t expired;
+    int i, n;
+
+    n = ostc_index_stripes(ostc->index);
 
     OSTC_LOCK(ostc);
     while (ostc->shutdown == 0) {
         apr_thread_cond_timedwait(ostc->cond, ostc->lock, ostc->cleanup_interval);
 
         log_printf(5, "START: Running an attribute cleanup\n");
-        _ostc_cleanup(os, ostc->cache_root, apr_time_now());
+        expired = apr_time_now();
+        for (i=0; (i<n) && (ostc->shutdown == 0); i++) {
+            _ostc_cleanup_stripe(os, i, expired);
+            OSTC_UNLOCK(ostc);
+            apr_thread_yield();
+            OSTC_LOCK(ostc);
+        }
         log_printf(5, "END: cleanup finished\n");
     }
     OSTC_UNLOCK(ostc);
@@ -431,12 +621,12 @@ int ostc_attr_cacheprep_ftype(ostc_cacheprep_t *cp)
 //   NOTE:  Assumes the cache lock is held
 //***********************************************************************
 
-int _ostc_cache_tree_walk(object_service_fn_t *os, char *fname, tbx_stack_t *tree, ostcdb_object_t *replacement_obj, int add_terminal_ftype, int max_recurse)
+int _ostc_cache_tree_walk(object_service_fn_t *os, char *fname, tbx_stack_t *tree, int add_terminal_ftype, int max_recurse)
 {
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
     int i, n, start, end, loop, err;
     tbx_stack_t rtree;
-    ostcdb_object_t *curr, *next, *prev;
+    ostcdb_object_t *curr, *next;
 
     log_printf(5, "fname=%s add_terminal_ftype=%d\n", fname, add_terminal_ftype);
 
@@ -485,12 +675,8 @@ int _ostc_cache_tree_walk(object_service_fn_t *os, char *fname, tbx_stack_t *tre
         if (next == NULL) {  //** Check if at the end
             if (fname[i] == 0) { //** Yup at the end
                 if (add_terminal_ftype > 0)  { //** Want to add the terminal
-                    if (curr) { //** Make sure we have something to add it to
-                        if (replacement_obj == NULL) {
-                            next = new_ostcdb_object(strndup(&(fname[start]), n), add_terminal_ftype, apr_time_now() + ostc->entry_timeout, ostc->mpool);
-                        } else {
-                            next = replacement_obj;
-                        }
+                    if ((curr) && (curr->objects)) { //** Make sure we have something to add it to
+                        next = new_ostcdb_object(ostc, curr, strndup(&(fname[start]), n), add_terminal_ftype, apr_time_now() + ostc->entry_timeout);
                         apr_hash_set(curr->objects, (void *)next->fname, n, next);
                         tbx_stack_move_to_bottom(tree);
                         tbx_stack_insert_below(tree, next);
@@ -518,7 +704,7 @@ int _ostc_cache_tree_walk(object_service_fn_t *os, char *fname, tbx_stack_t *tre
                 //*** Need to make a new stack and recurse it only keeping the bottom element
                 tbx_stack_init(&rtree);
                 tbx_stack_dup(tree, &rtree);
-                if (_ostc_cache_tree_walk(os, next->link, &rtree, NULL, add_terminal_ftype, max_recurse-1) != 0) {
+                if (_ostc_cache_tree_walk(os, next->link, &rtree, add_terminal_ftype, max_recurse-1) != 0) {
                     tbx_stack_empty(&rtree, 0);
                     err = -1;
                     goto finished;
@@ -535,21 +721,6 @@ int _ostc_cache_tree_walk(object_service_fn_t *os, char *fname, tbx_stack_t *tre
         curr = next;
     }
 
-    //** IF we made it here and this is non-NULL we need to replace the object we just located
-    //** With the one provided
-    if (replacement_obj != NULL) {
-        tbx_stack_move_up(tree);
-        prev = tbx_stack_get_current_data(tree);
-        apr_hash_set(prev->objects, curr->fname, APR_HASH_KEY_STRING, NULL);
-        apr_hash_set(prev->objects, replacement_obj->fname, strlen(replacement_obj->fname), replacement_obj);
-
-        free_ostcdb_object(curr);
-
-        tbx_stack_move_to_bottom(tree);
-        tbx_stack_delete_current(tree, 1, 0);
-        tbx_stack_insert_below(tree, replacement_obj);
-    }
-
     err = 0;
 finished:
     log_printf(15, "fname=%s err=%d\n", fname, err);
@@ -609,7 +780,7 @@ int _ostcdb_resolve_attr_link(object_service_fn_t *os, tbx_stack_t *tree, char *
     //** and pop the terminal which is up.  This will pop us up to the directory for the walk
     tbx_stack_move_to_bottom(&rtree);
     tbx_stack_delete_current(&rtree, 1, 0);
-    if (_ostc_cache_tree_walk(os, alink, &rtree, NULL, 0, OSTC_MAX_RECURSE) != 0) {
+    if (_ostc_cache_tree_walk(os, alink, &rtree, 0, OSTC_MAX_RECURSE) != 0) {
         if (i> -1) alink[i] = '/';
         goto finished;
     }
@@ -640,28 +811,15 @@ finished:
 
 
 //***********************************************************************
-//  ostc_cache_move_object - Moves an existing cache object within the cache
+//  ostc_cache_move_object - Handles a moved object.  Every object under the
+//     source is keyed in the index by it's full path so instead of re-keying
+//     the subtree both ends are dropped and get repopulated on the next access.
 //***********************************************************************
 
 void ostc_cache_move_object(object_service_fn_t *os, creds_t *creds, char *src_path, char *dest_path)
 {
-    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
-    tbx_stack_t stree, dtree;
-    ostcdb_object_t *obj;
-
-    tbx_stack_init(&stree);
-
-    OSTC_LOCK(ostc);
-    if (_ostc_cache_tree_walk(os, src_path, &stree, NULL, 0, OSTC_MAX_RECURSE) == 0) {
-        tbx_stack_move_to_bottom(&stree);
-        obj = tbx_stack_get_current_data(&stree);
-        tbx_stack_init(&dtree);
-        _ostc_cache_tree_walk(os, src_path, &dtree, obj, obj->ftype, OSTC_MAX_RECURSE);  //** Do the walk and substitute
-        tbx_stack_empty(&dtree, 0);
-    }
-    OSTC_UNLOCK(ostc);
-
-    tbx_stack_empty(&stree, 0);
+    ostc_cache_remove_object(os, src_path);
+    ostc_cache_remove_object(os, dest_path);
 }
 
 //***********************************************************************
@@ -672,18 +830,20 @@ void ostc_cache_remove_object(object_service_fn_t *os, char *path)
 {
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
     tbx_stack_t tree;
-    ostcdb_object_t *obj, *parent;
+    ostcdb_object_t *obj;
 
     tbx_stack_init(&tree);
 
     OSTC_LOCK(ostc);
-    if (_ostc_cache_tree_walk(os, path, &tree, NULL, 0, OSTC_MAX_RECURSE) == 0) {
+    if (_ostc_cache_tree_walk(os, path, &tree, 0, OSTC_MAX_RECURSE) == 0) {
         tbx_stack_move_to_bottom(&tree);
         obj = tbx_stack_get_current_data(&tree);
-        tbx_stack_move_up(&tree);
-        parent = tbx_stack_get_current_data(&tree);
-        apr_hash_set(parent->objects, obj->fname, APR_HASH_KEY_STRING, NULL);
-        free_ostcdb_object(obj);
+        if (obj->parent == NULL) {  //** It's the root so just purge everything
+            _ostc_cleanup(os, obj, _ostc_expire_all(ostc));
+        } else {
+            apr_hash_set(obj->parent->objects, obj->fname, APR_HASH_KEY_STRING, NULL);
+            free_ostcdb_object(ostc, obj);
+        }
     }
     OSTC_UNLOCK(ostc);
 
@@ -706,10 +866,11 @@ void ostc_cache_remove_attrs(object_service_fn_t *os, char *fname, char **key, i
     tbx_stack_init(&tree);
 
     OSTC_LOCK(ostc);
-    if (_ostc_cache_tree_walk(os, fname, &tree, NULL, 0, OSTC_MAX_RECURSE) != 0) goto finished;
+    if (_ostc_cache_tree_walk(os, fname, &tree, 0, OSTC_MAX_RECURSE) != 0) goto finished;
 
     tbx_stack_move_to_bottom(&tree);
     obj = tbx_stack_get_current_data(&tree);
+    OSTC_OBJ_LOCK(ostc, obj);
     for (i=0; i<n; i++) {
         attr = apr_hash_get(obj->attrs, key[i], APR_HASH_KEY_STRING);
         if (attr != NULL) {
@@ -717,6 +878,7 @@ void ostc_cache_remove_attrs(object_service_fn_t *os, char *fname, char **key, i
             free_ostcdb_attr(attr);
         }
     }
+    OSTC_OBJ_UNLOCK(ostc, obj);
 finished:
     OSTC_UNLOCK(ostc);
 
@@ -739,10 +901,11 @@ void ostc_cache_move_attrs(object_service_fn_t *os, char *fname, char **key_old,
     tbx_stack_init(&tree);
 
     OSTC_LOCK(ostc);
-    if (_ostc_cache_tree_walk(os, fname, &tree, NULL, 0, OSTC_MAX_RECURSE) != 0) goto finished;
+    if (_ostc_cache_tree_walk(os, fname, &tree, 0, OSTC_MAX_RECURSE) != 0) goto finished;
 
     tbx_stack_move_to_bottom(&tree);
     obj = tbx_stack_get_current_data(&tree);
+    OSTC_OBJ_LOCK(ostc, obj);
     for (i=0; i<n; i++) {
         attr = apr_hash_get(obj->attrs, key_old[i], APR_HASH_KEY_STRING);
         if (attr != NULL) {
@@ -758,6 +921,7 @@ void ostc_cache_move_attrs(object_service_fn_t *os, char *fname, char **key_old,
             apr_hash_set(obj->attrs, attr->key, APR_HASH_KEY_STRING, attr);
         }
     }
+    OSTC_OBJ_UNLOCK(ostc, obj);
 
 finished:
     OSTC_UNLOCK(ostc);
@@ -770,19 +934,22 @@ finished:
 //  ostc_cache_process_attrs - Merges the attrs into the cache
 //***********************************************************************
 
-void ostc_cache_process_attrs(object_service_fn_t *os, char *fname, int ftype, char **key_list, void **val, int *v_size, int n)
+void ostc_cache_process_attrs(object_service_fn_t *os, char *fname, int ftype, char **key_list, void **val, int *v_size, int n, uint64_t lease_gen)
 {
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
     tbx_stack_t tree;
     ostcdb_object_t *obj, *aobj;
     ostcdb_attr_t *attr;
+    apr_time_t expire;
     char *key, *lkey;
     int i;
 
     tbx_stack_init(&tree);
 
     OSTC_LOCK(ostc);
-    if (_ostc_cache_tree_walk(os, fname, &tree, NULL, ftype, OSTC_MAX_RECURSE) != 0) goto finished;
+    if (_ostc_cache_tree_walk(os, fname, &tree, ftype, OSTC_MAX_RECURSE) != 0) goto finished;
+
+    expire = _ostc_entry_expire(ostc, lease_gen);
 
     log_printf(5, "fname=%s stack_size=%d\n", fname, tbx_stack_count(&tree));
 
@@ -796,6 +963,7 @@ void ostc_cache_process_attrs(object_service_fn_t *os, char *fname, int ftype, c
     if (val[2*n]) { //** got a symlink
         obj->link = (char *)val[2*n];
         val[2*n] = NULL;
+        _ostc_drop_children(ostc, obj);  //** Lookups through a link follow it so anything cached below is stale
     }
     for (i=0; i<n; i++) {
         key = key_list[i];
@@ -809,17 +977,20 @@ void ostc_cache_process_attrs(object_service_fn_t *os, char *fname, int ftype, c
             log_printf(5, "TARGET obj=%s key=%s\n", aobj->fname, attr->key);
 
             //** Make the attr on the target link
+            OSTC_OBJ_LOCK(ostc, aobj);
             if (attr->val) free(attr->val);
             tbx_type_malloc(attr->val, void, v_size[i]+1);
             memcpy(attr->val, val[i], v_size[i]);
             ((char *)(attr->val))[v_size[i]] = 0;  //** NULL terminate
             attr->v_size = v_size[i];
+            OSTC_OBJ_UNLOCK(ostc, aobj);
 
             //** Now make the pointer on the source
+            OSTC_OBJ_LOCK(ostc, obj);
             attr = apr_hash_get(obj->attrs, key, APR_HASH_KEY_STRING);
             if (attr == NULL) {
                 log_printf(5, "NEW obj=%s key=%s link=%s\n", obj->fname, key, lkey);
-                attr = new_ostcdb_attr(key, NULL, -1234, apr_time_now() + ostc->entry_timeout);
+                attr = new_ostcdb_attr(key, NULL, -1234, expire);
                 apr_hash_set(obj->attrs, attr->key, APR_HASH_KEY_STRING, attr);
             } else {
                 log_printf(5, "OLD obj=%s key=%s link=%s\n", obj->fname, key, lkey);
@@ -827,16 +998,20 @@ void ostc_cache_process_attrs(object_service_fn_t *os, char *fname, int ftype, c
                 if (attr->val) free(attr->val);
                 attr->v_size = -1234;
                 attr->val = NULL;
+                attr->expire = expire;
             }
             attr->link = lkey;
+            OSTC_OBJ_UNLOCK(ostc, obj);
             val[n+i] = NULL;
             v_size[n+i] = 0;
         } else {
+            OSTC_OBJ_LOCK(ostc, obj);
             attr = apr_hash_get(obj->attrs, key, APR_HASH_KEY_STRING);
             if (attr == NULL) {
-                attr = new_ostcdb_attr(key, val[i], v_size[i], apr_time_now() + ostc->entry_timeout);
+                attr = new_ostcdb_attr(key, val[i], v_size[i], expire);
                 apr_hash_set(obj->attrs, attr->key, APR_HASH_KEY_STRING, attr);
             } else {
+                attr->expire = expire;
                 if (attr->link) {
                     free(attr->link);
                     attr->link = NULL;
@@ -851,6 +1026,7 @@ void ostc_cache_process_attrs(object_service_fn_t *os, char *fname, int ftype, c
                 }
                 attr->v_size = v_size[i];
             }
+            OSTC_OBJ_UNLOCK(ostc, obj);
         }
     }
 
@@ -861,6 +1037,82 @@ finished:
 }
 
 
+//***********************************************************************
+// _ostc_cache_fetch_indexed - Attempts the fetch using just the path index.
+//     Only the path's stripe is read locked so hits don't block each other.
+//     Returns 0 if the fetch was handled and status is set or 1 if the
+//     path isn't indexed or the attributes are links and the walk is needed.
+//***********************************************************************
+
+int _ostc_cache_fetch_indexed(ostc_priv_t *ostc, char *fname, char **key, void **val, int *v_size, int n, op_status_t *status)
+{
+    ostcdb_object_t *obj;
+    ostcdb_attr_t *attr;
+    int i, stripe, err;
+
+    stripe = ostc_index_stripe(ostc->index, fname);
+    ostc_index_read_lock(ostc->index, stripe);
+    obj = ostc_index_get(ostc->index, stripe, fname);
+    if (obj == NULL) {
+        err = 1;
+        goto finished;
+    }
+
+    //** Make sure everything is there before copying so there's nothing to unroll
+    for (i=0; i<n; i++) {
+        attr = apr_hash_get(obj->attrs, key[i], APR_HASH_KEY_STRING);
+        if (attr == NULL) {  //** Not in cache so need to pull it
+            *status = op_failure_status;
+            err = 0;
+            goto finished;
+        }
+        if (attr->link != NULL) {  //** Let the walk resolve it
+            err = 1;
+            goto finished;
+        }
+    }
+
+    for (i=0; i<n; i++) {
+        attr = apr_hash_get(obj->attrs, key[i], APR_HASH_KEY_STRING);
+        osf_store_val(attr->val, attr->v_size, &(val[i]), &(v_size[i]));
+    }
+
+    *status = op_success_status;
+    err = 0;
+
+finished:
+    ostc_index_unlock(ostc->index, stripe);
+
+    log_printf(5, "fname=%s n=%d err=%d\n", fname, n, err);
+    return(err);
+}
+
+//***********************************************************************
+// ostc_cache_exists - Returns 0 if the object is in the cache
+//***********************************************************************
+
+int ostc_cache_exists(object_service_fn_t *os, char *fname)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    tbx_stack_t tree;
+    int stripe, err;
+
+    stripe = ostc_index_stripe(ostc->index, fname);
+    ostc_index_read_lock(ostc->index, stripe);
+    err = (ostc_index_get(ostc->index, stripe, fname) != NULL) ? 0 : 1;
+    ostc_index_unlock(ostc->index, stripe);
+    if (err == 0) return(0);
+
+    //** Not a canonical path so fall back to the walk
+    tbx_stack_init(&tree);
+    OSTC_LOCK(ostc);
+    err = _ostc_cache_tree_walk(os, fname, &tree, 0, OSTC_MAX_RECURSE);
+    OSTC_UNLOCK(ostc);
+    tbx_stack_empty(&tree, 0);
+
+    return(err);
+}
+
 //***********************************************************************
 // ostc_cache_fetch - Attempts to process the attribute request from cached data
 //***********************************************************************
@@ -876,12 +1128,15 @@ op_status_t ostc_cache_fetch(object_service_fn_t *os, char *fname, char **key, v
     int vs[n];
     int i, oops;
 
+    //** Most hits are plain attributes on a canonical path so try the index first
+    if (_ostc_cache_fetch_indexed(ostc, fname, key, val, v_size, n, &status) == 0) return(status);
+
     tbx_stack_init(&tree);
     oops = 0;
 
 //log_printf(5, "fname=%s\n", fname);
     OSTC_LOCK(ostc);
-    if (_ostc_cache_tree_walk(os, fname, &tree, NULL, 0, OSTC_MAX_RECURSE) != 0) goto finished;
+    if (_ostc_cache_tree_walk(os, fname, &tree, 0, OSTC_MAX_RECURSE) != 0) goto finished;
 
     tbx_stack_move_to_bottom(&tree);
     obj = tbx_stack_get_current_data(&tree);
@@ -940,7 +1195,7 @@ void ostc_cache_update_attrs(object_service_fn_t *os, char *fname, char **key, v
 {
     ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
     tbx_stack_t tree;
-    ostcdb_object_t *obj;
+    ostcdb_object_t *obj, *lobj;
     ostcdb_attr_t *attr;
     int i;
 
@@ -949,7 +1204,7 @@ void ostc_cache_update_attrs(object_service_fn_t *os, char *fname, char **key, v
     log_printf(15, "fname=%s n=%d key[0]=%s\n", fname, n, key[0]);
 
     OSTC_LOCK(ostc);
-    if (_ostc_cache_tree_walk(os, fname, &tree, NULL, 0, OSTC_MAX_RECURSE) != 0) goto finished;
+    if (_ostc_cache_tree_walk(os, fname, &tree, 0, OSTC_MAX_RECURSE) != 0) goto finished;
 
     tbx_stack_move_to_bottom(&tree);
     obj = tbx_stack_get_current_data(&tree);
@@ -957,11 +1212,13 @@ void ostc_cache_update_attrs(object_service_fn_t *os, char *fname, char **key, v
         attr = apr_hash_get(obj->attrs, key[i], APR_HASH_KEY_STRING);
         if (attr == NULL) continue;  //** Not in cache so ignore updating it
 
+        lobj = obj;
         if (attr->link != NULL) {  //** Got to resolve the link
-            _ostcdb_resolve_attr_link(os, &tree, attr->link, &obj, &attr, OSTC_MAX_RECURSE);
+            _ostcdb_resolve_attr_link(os, &tree, attr->link, &lobj, &attr, OSTC_MAX_RECURSE);
             if (attr == NULL) continue;  //** Can't follow the link
         }
 
+        OSTC_OBJ_LOCK(ostc, lobj);
         attr->v_size = v_size[i];
         if (attr->val) {
             free(attr->val);
@@ -972,6 +1229,7 @@ void ostc_cache_update_attrs(object_service_fn_t *os, char *fname, char **key, v
             memcpy(attr->val, val[i], attr->v_size);
             ((char *)(attr->val))[v_size[i]] = 0;  //** NULL terminate
         }
+        OSTC_OBJ_UNLOCK(ostc, lobj);
     }
 
 finished:
@@ -996,13 +1254,16 @@ int _ostc_cache_populate_prefix(object_service_fn_t *os, creds_t *creds, char *p
     int v_size[1];
     int err, start, end, len, ftype;
     int max_wait = 10;
+    uint64_t lease_gen;
     op_status_t status;
 
     len = strlen(path);
     if (len == 1) return(0);  //** Nothing to do.  Just a '/'
 
     tbx_stack_init(&tree);
-    err = _ostc_cache_tree_walk(os, path, &tree, NULL, 0, OSTC_MAX_RECURSE);
+    OSTC_LOCK(ostc);
+    err = _ostc_cache_tree_walk(os, path, &tree, 0, OSTC_MAX_RECURSE);
+    OSTC_UNLOCK(ostc);
     tbx_stack_empty(&tree, 0);
     if (err <= 0)  return(err);
 
@@ -1028,6 +1289,7 @@ int _ostc_cache_populate_prefix(object_service_fn_t *os, creds_t *creds, char *p
     v_size[0] = -100;
     ostc_attr_cacheprep_setup(&cp, 1, key_array, (void **)val_array, v_size, 1);
 
+    lease_gen = ostc_lease_gen(ostc);
     err = gop_sync_exec(os_open_object(ostc->os_child, creds, fname, OS_MODE_READ_IMMEDIATE, NULL, &fd, max_wait));
     if (err != OP_STATE_SUCCESS) {
         log_printf(1, "ERROR opening object=%s\n", path);
@@ -1047,7 +1309,7 @@ int _ostc_cache_populate_prefix(object_service_fn_t *os, creds_t *creds, char *p
     if (status.op_status == OP_STATE_SUCCESS) {
         ftype = ostc_attr_cacheprep_ftype(&cp);
         log_printf(1, "storing=%s ftype=%d end=%d len=%d v_size[0]=%d\n", fname, ftype, end, len, cp.v_size[0]);
-        ostc_cache_process_attrs(os, fname, ftype, cp.key, cp.val, cp.v_size, cp.n_keys);
+        ostc_cache_process_attrs(os, fname, ftype, cp.key, cp.val, cp.v_size, cp.n_keys, lease_gen);
         ostc_attr_cacheprep_copy(&cp, (void **)val_array, v_size);
         if (end < (len-1)) { //** Recurse and add the next layer
             log_printf(1, "recursing object=%s\n", path);
@@ -1080,7 +1342,7 @@ op_status_t ostc_remove_regex_object_fn(void *arg, int tid)
     //** Since we don't know what was removed we're going to purge everything to make life easy.
     if (status.op_status == OP_STATE_SUCCESS) {
         apr_thread_mutex_lock(ostc->lock);
-        _ostc_cleanup(op->os, ostc->cache_root, apr_time_now() + 4*ostc->entry_timeout);
+        _ostc_cleanup(op->os, ostc->cache_root, _ostc_expire_all(ostc));
         apr_thread_mutex_unlock(ostc->lock);
     }
 
@@ -1540,6 +1802,7 @@ op_status_t ostc_get_attrs_fn(void *arg, int tid)
     ostc_priv_t *ostc = (ostc_priv_t *)ma->os->priv;
     op_status_t status;
     int ftype;
+    uint64_t lease_gen;
     ostc_cacheprep_t cp;
 
 
@@ -1557,6 +1820,7 @@ op_status_t ostc_get_attrs_fn(void *arg, int tid)
 
     ostc_attr_cacheprep_setup(&cp, ma->n, ma->key, ma->val, ma->v_size, 1);
 
+    lease_gen = ostc_lease_gen(ostc);
     if (ma->fd->fd_child == NULL) {
         status = ostc_delayed_open_object(ma->os, ma->fd);
         if (status.op_status == OP_STATE_FAILURE) goto failed;
@@ -1567,7 +1831,7 @@ op_status_t ostc_get_attrs_fn(void *arg, int tid)
     //** Store them in the cache on success
     if (status.op_status == OP_STATE_SUCCESS) {
         ftype = ostc_attr_cacheprep_ftype(&cp);
-        ostc_cache_process_attrs(ma->os, ma->fd->fname, ftype, cp.key, cp.val, cp.v_size, cp.n_keys);
+        ostc_cache_process_attrs(ma->os, ma->fd->fname, ftype, cp.key, cp.val, cp.v_size, cp.n_keys, lease_gen);
         ostc_attr_cacheprep_copy(&cp, ma->val, ma->v_size);
     }
 
@@ -1600,6 +1864,70 @@ op_generic_t *ostc_get_multiple_attrs(object_service_fn_t *os, creds_t *creds, o
     return(new_thread_pool_op(ostc->tpc, NULL, ostc_get_attrs_fn, (void *)ma, free, 1));
 }
 
+//***********************************************************************
+// ostc_get_attrs_immediate_fn - Handles the attribute get when there's no
+//   FD.  Cache misses are passed to the child as a single compound call.
+//***********************************************************************
+
+op_status_t ostc_get_attrs_immediate_fn(void *arg, int tid)
+{
+    ostc_mult_attr_t *ma = (ostc_mult_attr_t *)arg;
+    ostc_priv_t *ostc = (ostc_priv_t *)ma->os->priv;
+    op_status_t status;
+    int ftype;
+    uint64_t lease_gen;
+    ostc_cacheprep_t cp;
+
+    //** 1st see if we can satisfy everything from cache
+    status = ostc_cache_fetch(ma->os, ma->path, ma->key, ma->val, ma->v_size, ma->n);
+    if (status.op_status == OP_STATE_SUCCESS) {
+        log_printf(10, "ATTR_CACHE_HIT: fname=%s key[0]=%s n_keys=%d\n", ma->path, ma->key[0], ma->n);
+        return(status);
+    }
+    log_printf(10, "ATTR_CACHE_MISS fname=%s key[0]=%s n_keys=%d\n", ma->path, ma->key[0], ma->n);
+
+    _ostc_cache_populate_prefix(ma->os, ma->creds, ma->path, 0);
+
+    ostc_attr_cacheprep_setup(&cp, ma->n, ma->key, ma->val, ma->v_size, 1);
+
+    lease_gen = ostc_lease_gen(ostc);
+    status = os_path_get_multiple_attrs(ostc->os_child, ma->creds, ma->path, ma->id, cp.key, cp.val, cp.v_size, cp.n_keys_total, 0);
+
+    //** Store them in the cache on success
+    if (status.op_status == OP_STATE_SUCCESS) {
+        ftype = ostc_attr_cacheprep_ftype(&cp);
+        ostc_cache_process_attrs(ma->os, ma->path, ftype, cp.key, cp.val, cp.v_size, cp.n_keys, lease_gen);
+        ostc_attr_cacheprep_copy(&cp, ma->val, ma->v_size);
+    }
+
+    ostc_attr_cacheprep_destroy(&cp);
+
+    return(status);
+}
+
+//***********************************************************************
+// ostc_get_multiple_attrs_immediate - Opens the object, retrieves the
+//   attributes, and closes it.
+//***********************************************************************
+
+op_generic_t *ostc_get_multiple_attrs_immediate(object_service_fn_t *os, creds_t *creds, char *path, char *id, char **key, void **val, int *v_size, int n)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+    ostc_mult_attr_t *ma;
+
+    tbx_type_malloc_clear(ma, ostc_mult_attr_t, 1);
+    ma->os = os;
+    ma->creds = creds;
+    ma->path = path;
+    ma->id = id;
+    ma->key = key;
+    ma->val = val;
+    ma->v_size = v_size;
+    ma->n = n;
+
+    return(new_thread_pool_op(ostc->tpc, NULL, ostc_get_attrs_immediate_fn, (void *)ma, free, 1));
+}
+
 //***********************************************************************
 // ostc_get_attr - Retreives a single object attribute
 //   If *v_size < 0 then space is allocated up to a max of abs(v_size)
@@ -1795,7 +2123,7 @@ int ostc_next_object(os_object_iter_t *oit, char **fname, int *prefix_len)
     if (it->iter_type == OSTC_ITER_ALIST) {
         //** Copy any results back
         ostc_attr_cacheprep_copy(&(it->cp), it->val, it->v_size);
-        ostc_cache_process_attrs(it->os, *fname, ftype, it->cp.key, it->cp.val, it->cp.v_size, it->n_keys);
+        ostc_cache_process_attrs(it->os, *fname, ftype, it->cp.key, it->cp.val, it->cp.v_size, it->n_keys, it->lease_gen);
 
         //** We have to do a manual cleanup and can't call the CP destroy method
         for (i=it->cp.n_keys; i<it->cp.n_keys_total; i++) {
@@ -1915,6 +2243,7 @@ os_object_iter_t *ostc_create_object_iter_alist(object_service_fn_t *os, creds_t
     memcpy(it->v_size_initial, it->v_size, n_keys*sizeof(int));
 
     //** Make the gop and execute it
+    it->lease_gen = ostc_lease_gen(ostc);
     it->it_child = os_create_object_iter_alist(ostc->os_child, creds, path, object_regex, object_types,
                    recurse_depth, it->cp.key, it->cp.val, it->cp.v_size, it->cp.n_keys_total);
 
@@ -1938,21 +2267,13 @@ os_object_iter_t *ostc_create_object_iter_alist(object_service_fn_t *os, creds_t
 op_status_t ostc_open_object_fn(void *arg, int tid)
 {
     ostc_open_op_t *op = (ostc_open_op_t *)arg;
-    ostc_priv_t *ostc = (ostc_priv_t *)op->os->priv;
     op_status_t status;
     ostc_fd_t *fd;
-    tbx_stack_t tree;
-    int err;
 
     log_printf(5, "mode=%d OS_MODE_READ_IMMEDIATE=%d fname=%s\n", op->mode, OS_MODE_READ_IMMEDIATE, op->path);
 
     if (op->mode == OS_MODE_READ_IMMEDIATE) { //** Can use a delayed open if the object is in cache
-        tbx_stack_init(&tree);
-        OSTC_LOCK(ostc);
-        err = _ostc_cache_tree_walk(op->os, op->path, &tree, NULL, 0, OSTC_MAX_RECURSE);
-        OSTC_UNLOCK(ostc);
-        tbx_stack_empty(&tree, 0);
-        if (err == 0) goto finished;
+        if (ostc_cache_exists(op->os, op->path) == 0) goto finished;
     }
 
     //** Force an immediate file open
@@ -2113,6 +2434,40 @@ void ostc_destroy_fsck_iter(object_service_fn_t *os, os_fsck_iter_t *oit)
 }
 
 
+//***********************************************************************
+// ostc_create_du_iter - Creates a du iterator.  The tally is done by the
+//    child so nothing here is cached.
+//***********************************************************************
+
+os_du_iter_t *ostc_create_du_iter(object_service_fn_t *os, creds_t *creds, os_regex_table_t *path, os_regex_table_t *obj_regex, int object_types, int recurse_depth, int rollup_depth, int flags)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+
+    return(os_create_du_iter(ostc->os_child, creds, path, obj_regex, object_types, recurse_depth, rollup_depth, flags));
+}
+
+//***********************************************************************
+// ostc_next_du - Returns the next du entry
+//***********************************************************************
+
+int ostc_next_du(object_service_fn_t *os, os_du_iter_t *it, char **fname, int64_t *bytes, int64_t *count)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+
+    return(os_next_du(ostc->os_child, it, fname, bytes, count));
+}
+
+//***********************************************************************
+// ostc_destroy_du_iter - Destroys a du iterator
+//***********************************************************************
+
+void ostc_destroy_du_iter(object_service_fn_t *os, os_du_iter_t *it)
+{
+    ostc_priv_t *ostc = (ostc_priv_t *)os->priv;
+
+    os_destroy_du_iter(ostc->os_child, it);
+}
+
 //***********************************************************************
 // ostc_cred_init - Intialize a set of credentials
 //***********************************************************************
@@ -2160,8 +2515,9 @@ void ostc_destroy(object_service_fn_t *os)
     apr_thread_join(&value, ostc->cleanup_thread);
 
     //** Dump the cache 1 last time just to be safe
-    _ostc_cleanup(os, ostc->cache_root, apr_time_now() + 4*ostc->entry_timeout);
-    free_ostcdb_object(ostc->cache_root);
+    _ostc_cleanup(os, ostc->cache_root, _ostc_expire_all(ostc));
+    free_ostcdb_object(ostc, ostc->cache_root);
+    ostc_index_destroy(ostc->index);
 
     free(ostc);
     free(os);
@@ -2204,7 +2560,9 @@ object_service_fn_t *object_service_timecache_create(service_manager_t *ess, tbx
     }
 
     ostc->entry_timeout = apr_time_from_sec(tbx_inip_get_integer(fd, section, "entry_timeout", 20));
+    ostc->lease_timeout = apr_time_from_sec(tbx_inip_get_integer(fd, section, "lease_timeout", 0));
     ostc->cleanup_interval = apr_time_from_sec(tbx_inip_get_integer(fd, section, "cleanup_interval", 120));
+    ostc->index = ostc_index_create(tbx_inip_get_integer(fd, section, "index_stripes", 64));
 
     apr_pool_create(&ostc->mpool, NULL);
     apr_thread_mutex_create(&(ostc->lock), APR_THREAD_MUTEX_DEFAULT, ostc->mpool);
@@ -2212,7 +2570,7 @@ object_service_fn_t *object_service_timecache_create(service_manager_t *ess, tbx
     apr_thread_cond_create(&(ostc->cond), ostc->mpool);
 
     //** Make the root node
-    ostc->cache_root = new_ostcdb_object(strdup("/"), OS_OBJECT_DIR, 0, ostc->mpool);
+    ostc->cache_root = new_ostcdb_object(ostc, NULL, strdup("/"), OS_OBJECT_DIR, 0);
 
     //** Get the thread pool to use
     ostc->tpc = lookup_service(ess, ESS_RUNNING, ESS_TPC_UNLIMITED); assert(ostc->tpc != NULL);
@@ -2243,6 +2601,7 @@ object_service_fn_t *object_service_timecache_create(service_manager_t *ess, tbx
     os->symlink_attr = ostc_symlink_attr;
     os->copy_attr = ostc_copy_attr;
     os->get_multiple_attrs = ostc_get_multiple_attrs;
+    os->get_multiple_attrs_immediate = ostc_get_multiple_attrs_immediate;
     os->set_multiple_attrs = ostc_set_multiple_attrs;
     os->copy_multiple_attrs = ostc_copy_multiple_attrs;
     os->symlink_multiple_attrs = ostc_symlink_multiple_attrs;
@@ -2254,6 +2613,10 @@ object_service_fn_t *object_service_timecache_create(service_manager_t *ess, tbx
     os->next_attr = ostc_next_attr;
     os->destroy_attr_iter = ostc_destroy_attr_iter;
 
+    os->create_du_iter = ostc_create_du_iter;
+    os->next_du = ostc_next_du;
+    os->destroy_du_iter = ostc_destroy_du_iter;
+
     os->create_fsck_iter = ostc_create_fsck_iter;
     os->destroy_fsck_iter = ostc_destroy_fsck_iter;
     os->next_fsck = ostc_next_fsck;
@@ -2261,6 +2624,17 @@ object_service_fn_t *object_service_timecache_create(service_manager_t *ess, tbx
 
     tbx_thread_create_assert(&(ostc->cleanup_thread), NULL, ostc_cache_compact_thread, (void *)os, ostc->mpool);
 
+    //** If the child is a remote client have the server push invalidations so entries can live longer
+    if (ostc->lease_timeout > 0) {
+        if (strcmp(ostc->os_child->type, OS_TYPE_REMOTE_CLIENT) != 0) {
+            log_printf(0, "WARNING: lease_timeout requires an os_remote_client child.  Using entry_timeout. child=%s\n", ostc->os_child->type);
+            ostc->lease_timeout = 0;
+        } else if (osrc_lease_register(ostc->os_child, ostc_lease_cb, os) != 0) {
+            log_printf(0, "WARNING: The child is already providing leases to someone else.  Using entry_timeout.\n");
+            ostc->lease_timeout = 0;
+        }
+    }
+
     log_printf(10, "END\n");
 
     return(os);
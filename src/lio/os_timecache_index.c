@@ -0,0 +1,168 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//***********************************************************************
+// Lock striped full path index for the timecache.
+//
+// Paths are hashed onto a fixed set of stripes.  Each stripe has its own
+// table, pool, and read/write lock so lookups only contend with writers
+// touching the same stripe and never with other readers.  The key strings
+// are owned by the caller and must stay valid while they are in the index.
+//***********************************************************************
+
+#define _log_module_index 229
+
+#include <apr_pools.h>
+#include <apr_thread_rwlock.h>
+#include <stdint.h>
+#include <string.h>
+#include <tbx/log.h>
+#include <tbx/type_malloc.h>
+#include "os_timecache_index.h"
+
+typedef struct {
+    apr_thread_rwlock_t *lock;
+    apr_hash_t *table;
+    apr_pool_t *mpool;  //** Each stripe gets its own pool so the locks don't share cache lines
+} ostc_stripe_t;
+
+struct ostc_index_s {
+    ostc_stripe_t *stripe;
+    int n_stripes;
+    uint32_t mask;
+};
+
+//***********************************************************************
+// ostc_index_create - Creates a new index.  The number of stripes is
+//     rounded up to a power of 2.
+//***********************************************************************
+
+ostc_index_t *ostc_index_create(int n_stripes)
+{
+    ostc_index_t *idx;
+    int i, n;
+
+    n = 1;
+    while (n < n_stripes) n <<= 1;
+
+    tbx_type_malloc_clear(idx, ostc_index_t, 1);
+    tbx_type_malloc_clear(idx->stripe, ostc_stripe_t, n);
+    idx->n_stripes = n;
+    idx->mask = n - 1;
+
+    for (i=0; i<n; i++) {
+        apr_pool_create(&(idx->stripe[i].mpool), NULL);
+        apr_thread_rwlock_create(&(idx->stripe[i].lock), idx->stripe[i].mpool);
+        idx->stripe[i].table = apr_hash_make(idx->stripe[i].mpool);
+    }
+
+    log_printf(5, "n_stripes=%d\n", n);
+    return(idx);
+}
+
+//***********************************************************************
+// ostc_index_destroy - Destroys the index.  The values are left alone.
+//***********************************************************************
+
+void ostc_index_destroy(ostc_index_t *idx)
+{
+    int i;
+
+    for (i=0; i<idx->n_stripes; i++) {
+        apr_thread_rwlock_destroy(idx->stripe[i].lock);
+        apr_pool_destroy(idx->stripe[i].mpool);
+    }
+
+    free(idx->stripe);
+    free(idx);
+}
+
+//***********************************************************************
+// ostc_index_stripes - Returns the number of stripes
+//***********************************************************************
+
+int ostc_index_stripes(ostc_index_t *idx)
+{
+    return(idx->n_stripes);
+}
+
+//***********************************************************************
+// ostc_index_stripe - Returns the stripe the path maps to (FNV-1a)
+//***********************************************************************
+
+int ostc_index_stripe(ostc_index_t *idx, const char *path)
+{
+    const unsigned char *p;
+    uint32_t h;
+
+    h = 2166136261U;
+    for (p = (const unsigned char *)path; *p != 0; p++) {
+        h ^= *p;
+        h *= 16777619U;
+    }
+
+    return(h & idx->mask);
+}
+
+//***********************************************************************
+// ostc_index_read_lock/write_lock/unlock - Stripe locking
+//***********************************************************************
+
+void ostc_index_read_lock(ostc_index_t *idx, int stripe)
+{
+    apr_thread_rwlock_rdlock(idx->stripe[stripe].lock);
+}
+
+void ostc_index_write_lock(ostc_index_t *idx, int stripe)
+{
+    apr_thread_rwlock_wrlock(idx->stripe[stripe].lock);
+}
+
+void ostc_index_unlock(ostc_index_t *idx, int stripe)
+{
+    apr_thread_rwlock_unlock(idx->stripe[stripe].lock);
+}
+
+//***********************************************************************
+// ostc_index_get - Returns the value stored for the path or NULL.
+//     NOTE: The stripe lock must be held.
+//***********************************************************************
+
+void *ostc_index_get(ostc_index_t *idx, int stripe, const char *path)
+{
+    return(apr_hash_get(idx->stripe[stripe].table, path, APR_HASH_KEY_STRING));
+}
+
+//***********************************************************************
+// ostc_index_set - Stores the value for the path.  A NULL value removes it.
+//     NOTE: The stripe write lock must be held.
+//***********************************************************************
+
+void ostc_index_set(ostc_index_t *idx, int stripe, const char *path, void *val)
+{
+    apr_hash_set(idx->stripe[stripe].table, path, APR_HASH_KEY_STRING, val);
+}
+
+//***********************************************************************
+// ostc_index_first - Starts an iteration over the stripe.  The current
+//     entry can be removed while iterating.
+//     NOTE: The stripe lock must be held for the whole iteration.
+//***********************************************************************
+
+apr_hash_index_t *ostc_index_first(ostc_index_t *idx, int stripe)
+{
+    return(apr_hash_first(NULL, idx->stripe[stripe].table));
+}
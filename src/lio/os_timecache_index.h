@@ -0,0 +1,49 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+//***********************************************************************
+// Lock striped full path index used by the timecache object service
+//***********************************************************************
+
+#include "lio/lio_visibility.h"
+#include <apr_hash.h>
+
+#ifndef _OS_TIMECACHE_INDEX_H_
+#define _OS_TIMECACHE_INDEX_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ostc_index_s ostc_index_t;
+
+LIO_API ostc_index_t *ostc_index_create(int n_stripes);
+LIO_API void ostc_index_destroy(ostc_index_t *idx);
+LIO_API int ostc_index_stripes(ostc_index_t *idx);
+LIO_API int ostc_index_stripe(ostc_index_t *idx, const char *path);
+LIO_API void ostc_index_read_lock(ostc_index_t *idx, int stripe);
+LIO_API void ostc_index_write_lock(ostc_index_t *idx, int stripe);
+LIO_API void ostc_index_unlock(ostc_index_t *idx, int stripe);
+LIO_API void *ostc_index_get(ostc_index_t *idx, int stripe, const char *path);
+LIO_API void ostc_index_set(ostc_index_t *idx, int stripe, const char *path, void *val);
+LIO_API apr_hash_index_t *ostc_index_first(ostc_index_t *idx, int stripe);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
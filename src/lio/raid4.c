@@ -14,37 +14,277 @@
    limitations under the License.
 */
 
+//******************************************************************************
+// RAID4 parity.  The parity is the XOR of all the data strips.  All N inputs
+// are XOR'ed into the output in a single pass using the widest vector unit
+// the CPU has, picked at runtime.
+//******************************************************************************
+
 #include <string.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <tbx/assert_result.h>
+#include "raid4.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAID4_X86
+#include <immintrin.h>
+#endif
+
+#define RAID4_STACK_STRIPS 64   //** Decodes with more strips than this malloc the pointer table
+
+typedef void (raid4_xor_fn_t)(int n, char **src, char *dest, int nbytes);
+
+static const char *_raid4_isa_name[RAID4_ISA_MAX] = { "scalar", "sse2", "avx2", "avx512" };
+static raid4_xor_fn_t *_raid4_xor = NULL;
+static int _raid4_isa = RAID4_ISA_AUTO;
 
 //******************************************************************************
-//  xor_block - XOR's a block of data
+//  _raid4_xor_scalar_range - XOR's bytes [start, nbytes) a word at a time.
+//     Used for the portable kernel and the tails of the vector kernels.
 //******************************************************************************
 
-void xor_block(char *data, char *parity, int nbytes)
+static void _raid4_xor_scalar_range(int n, char **src, char *dest, int start, int nbytes)
 {
-    int i;
+    uint64_t w, v;
+    char c;
+    int i, j;
 
-    for (i=0; i<nbytes; i++) parity[i] = parity[i] ^ data[i];
+    for (j=start; j+8 <= nbytes; j += 8) {
+        memcpy(&w, src[0] + j, 8);
+        for (i=1; i<n; i++) {
+            memcpy(&v, src[i] + j, 8);
+            w ^= v;
+        }
+        memcpy(dest + j, &w, 8);
+    }
 
-    return;
+    for (; j<nbytes; j++) {
+        c = src[0][j];
+        for (i=1; i<n; i++) c ^= src[i][j];
+        dest[j] = c;
+    }
+}
+
+//******************************************************************************
+
+static void _raid4_xor_scalar(int n, char **src, char *dest, int nbytes)
+{
+    _raid4_xor_scalar_range(n, src, dest, 0, nbytes);
 }
 
+#ifdef RAID4_X86
 
 //******************************************************************************
-//  raid4_encode - Encodes the given data blocks
+//  _raid4_xor_sse2 - 64 bytes per pass
 //******************************************************************************
 
-void raid4_encode(int data_strips, char **data, char **parity, int block_size)
+__attribute__((target("sse2")))
+static void _raid4_xor_sse2(int n, char **src, char *dest, int nbytes)
+{
+    __m128i a0, a1, a2, a3;
+    char *s;
+    int i, j;
+
+    for (j=0; j+64 <= nbytes; j += 64) {
+        s = src[0] + j;
+        a0 = _mm_loadu_si128((__m128i *)s);
+        a1 = _mm_loadu_si128((__m128i *)(s + 16));
+        a2 = _mm_loadu_si128((__m128i *)(s + 32));
+        a3 = _mm_loadu_si128((__m128i *)(s + 48));
+        for (i=1; i<n; i++) {
+            s = src[i] + j;
+            a0 = _mm_xor_si128(a0, _mm_loadu_si128((__m128i *)s));
+            a1 = _mm_xor_si128(a1, _mm_loadu_si128((__m128i *)(s + 16)));
+            a2 = _mm_xor_si128(a2, _mm_loadu_si128((__m128i *)(s + 32)));
+            a3 = _mm_xor_si128(a3, _mm_loadu_si128((__m128i *)(s + 48)));
+        }
+        _mm_storeu_si128((__m128i *)(dest + j), a0);
+        _mm_storeu_si128((__m128i *)(dest + j + 16), a1);
+        _mm_storeu_si128((__m128i *)(dest + j + 32), a2);
+        _mm_storeu_si128((__m128i *)(dest + j + 48), a3);
+    }
+
+    for (; j+16 <= nbytes; j += 16) {
+        a0 = _mm_loadu_si128((__m128i *)(src[0] + j));
+        for (i=1; i<n; i++) a0 = _mm_xor_si128(a0, _mm_loadu_si128((__m128i *)(src[i] + j)));
+        _mm_storeu_si128((__m128i *)(dest + j), a0);
+    }
+
+    _raid4_xor_scalar_range(n, src, dest, j, nbytes);
+}
+
+//******************************************************************************
+//  _raid4_xor_avx2 - 128 bytes per pass
+//******************************************************************************
+
+__attribute__((target("avx2")))
+static void _raid4_xor_avx2(int n, char **src, char *dest, int nbytes)
+{
+    __m256i a0, a1, a2, a3;
+    char *s;
+    int i, j;
+
+    for (j=0; j+128 <= nbytes; j += 128) {
+        s = src[0] + j;
+        a0 = _mm256_loadu_si256((__m256i *)s);
+        a1 = _mm256_loadu_si256((__m256i *)(s + 32));
+        a2 = _mm256_loadu_si256((__m256i *)(s + 64));
+        a3 = _mm256_loadu_si256((__m256i *)(s + 96));
+        for (i=1; i<n; i++) {
+            s = src[i] + j;
+            a0 = _mm256_xor_si256(a0, _mm256_loadu_si256((__m256i *)s));
+            a1 = _mm256_xor_si256(a1, _mm256_loadu_si256((__m256i *)(s + 32)));
+            a2 = _mm256_xor_si256(a2, _mm256_loadu_si256((__m256i *)(s + 64)));
+            a3 = _mm256_xor_si256(a3, _mm256_loadu_si256((__m256i *)(s + 96)));
+        }
+        _mm256_storeu_si256((__m256i *)(dest + j), a0);
+        _mm256_storeu_si256((__m256i *)(dest + j + 32), a1);
+        _mm256_storeu_si256((__m256i *)(dest + j + 64), a2);
+        _mm256_storeu_si256((__m256i *)(dest + j + 96), a3);
+    }
+
+    for (; j+32 <= nbytes; j += 32) {
+        a0 = _mm256_loadu_si256((__m256i *)(src[0] + j));
+        for (i=1; i<n; i++) a0 = _mm256_xor_si256(a0, _mm256_loadu_si256((__m256i *)(src[i] + j)));
+        _mm256_storeu_si256((__m256i *)(dest + j), a0);
+    }
+
+    _raid4_xor_scalar_range(n, src, dest, j, nbytes);
+}
+
+//******************************************************************************
+//  _raid4_xor_avx512 - 256 bytes per pass
+//******************************************************************************
+
+__attribute__((target("avx512f")))
+static void _raid4_xor_avx512(int n, char **src, char *dest, int nbytes)
+{
+    __m512i a0, a1, a2, a3;
+    char *s;
+    int i, j;
+
+    for (j=0; j+256 <= nbytes; j += 256) {
+        s = src[0] + j;
+        a0 = _mm512_loadu_si512((void *)s);
+        a1 = _mm512_loadu_si512((void *)(s + 64));
+        a2 = _mm512_loadu_si512((void *)(s + 128));
+        a3 = _mm512_loadu_si512((void *)(s + 192));
+        for (i=1; i<n; i++) {
+            s = src[i] + j;
+            a0 = _mm512_xor_si512(a0, _mm512_loadu_si512((void *)s));
+            a1 = _mm512_xor_si512(a1, _mm512_loadu_si512((void *)(s + 64)));
+            a2 = _mm512_xor_si512(a2, _mm512_loadu_si512((void *)(s + 128)));
+            a3 = _mm512_xor_si512(a3, _mm512_loadu_si512((void *)(s + 192)));
+        }
+        _mm512_storeu_si512((void *)(dest + j), a0);
+        _mm512_storeu_si512((void *)(dest + j + 64), a1);
+        _mm512_storeu_si512((void *)(dest + j + 128), a2);
+        _mm512_storeu_si512((void *)(dest + j + 192), a3);
+    }
+
+    for (; j+64 <= nbytes; j += 64) {
+        a0 = _mm512_loadu_si512((void *)(src[0] + j));
+        for (i=1; i<n; i++) a0 = _mm512_xor_si512(a0, _mm512_loadu_si512((void *)(src[i] + j)));
+        _mm512_storeu_si512((void *)(dest + j), a0);
+    }
+
+    _raid4_xor_scalar_range(n, src, dest, j, nbytes);
+}
+
+static raid4_xor_fn_t *_raid4_isa_fn[RAID4_ISA_MAX] = { _raid4_xor_scalar, _raid4_xor_sse2, _raid4_xor_avx2, _raid4_xor_avx512 };
+
+#else
+
+static raid4_xor_fn_t *_raid4_isa_fn[RAID4_ISA_MAX] = { _raid4_xor_scalar, NULL, NULL, NULL };
+
+#endif
+
+//******************************************************************************
+//  raid4_isa_supported - Returns 1 if the CPU can run the ISA's kernel
+//******************************************************************************
+
+int raid4_isa_supported(int isa)
+{
+    if ((isa < 0) || (isa >= RAID4_ISA_MAX)) return(0);
+    if (_raid4_isa_fn[isa] == NULL) return(0);
+
+#ifdef RAID4_X86
+    __builtin_cpu_init();
+    switch (isa) {
+    case RAID4_ISA_SSE2:
+        return(__builtin_cpu_supports("sse2") ? 1 : 0);
+    case RAID4_ISA_AVX2:
+        return(__builtin_cpu_supports("avx2") ? 1 : 0);
+    case RAID4_ISA_AVX512:
+        return(__builtin_cpu_supports("avx512f") ? 1 : 0);
+    }
+#endif
+
+    return(1);
+}
+
+//******************************************************************************
+//  raid4_isa_name - Returns the ISA's name
+//******************************************************************************
+
+const char *raid4_isa_name(int isa)
 {
-    int i;
+    if ((isa < 0) || (isa >= RAID4_ISA_MAX)) return("unknown");
+    return(_raid4_isa_name[isa]);
+}
 
-    memcpy(parity[0], data[0], block_size);
+//******************************************************************************
+//  raid4_set_isa - Selects the XOR kernel.  RAID4_ISA_AUTO picks the widest
+//     one the CPU supports.  Returns the ISA used or -1 if it isn't supported.
+//******************************************************************************
 
-    for (i=1; i<data_strips; i++) xor_block(data[i], parity[0], block_size);
+int raid4_set_isa(int isa)
+{
+    if (isa == RAID4_ISA_AUTO) {
+        for (isa=RAID4_ISA_MAX-1; isa>RAID4_ISA_SCALAR; isa--) {
+            if (raid4_isa_supported(isa) == 1) break;
+        }
+    } else if (raid4_isa_supported(isa) == 0) {
+        return(-1);
+    }
+
+    _raid4_isa = isa;
+    _raid4_xor = _raid4_isa_fn[isa];
+
+    return(isa);
+}
+
+//******************************************************************************
+//  raid4_get_isa - Returns the ISA currently in use
+//******************************************************************************
+
+int raid4_get_isa()
+{
+    if (_raid4_xor == NULL) raid4_set_isa(RAID4_ISA_AUTO);
+    return(_raid4_isa);
+}
+
+//******************************************************************************
+//  raid4_xor - Stores the XOR of the n src blocks in dest.  dest can be one
+//     of the src blocks.
+//******************************************************************************
+
+void raid4_xor(int n, char **src, char *dest, int nbytes)
+{
+    if (_raid4_xor == NULL) raid4_set_isa(RAID4_ISA_AUTO);
+    _raid4_xor(n, src, dest, nbytes);
+}
+
+//******************************************************************************
+//  raid4_encode - Encodes the given data blocks
+//******************************************************************************
+
+void raid4_encode(int data_strips, char **data, char **parity, int block_size)
+{
+    raid4_xor(data_strips, data, parity[0], block_size);
 
     return;
 }
@@ -55,21 +295,31 @@ void raid4_encode(int data_strips, char **data, char **parity, int block_size)
 
 int raid4_decode(int data_strips, int *erasures, char **data, char **parity, int block_size)
 {
-    int i, k;
+    char *stack_src[RAID4_STACK_STRIPS];
+    char **src;
+    int i, k, n;
 
     if (erasures[1] != -1) return(-1);  //** Too many missing blocks to recover from
     if (erasures[0] >= data_strips) return(0);  //** Lost parity only so return
 
-    k = erasures[0];
-    memcpy(data[k], parity[0], block_size);
+    src = stack_src;
+    if (data_strips > RAID4_STACK_STRIPS) {
+        src = (char **)malloc(sizeof(char *)*data_strips);
+        assert(src != NULL);
+    }
 
+    //** The missing strip is the XOR of the parity and the remaining strips
+    k = erasures[0];
+    n = 0;
+    src[n++] = parity[0];
     for (i=0; i<data_strips; i++) {
-        if (i != k) {
-            xor_block(data[i], data[k], block_size);
-        }
+        if (i != k) src[n++] = data[i];
     }
 
+    raid4_xor(n, src, data[k], block_size);
+
+    if (src != stack_src) free(src);
+
     return(0);
 }
 
-
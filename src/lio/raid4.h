@@ -17,10 +17,24 @@
 #ifndef __RAID4_H_
 #define __RAID4_H_
 
+#include "lio/lio_visibility.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define RAID4_ISA_AUTO   -1
+#define RAID4_ISA_SCALAR  0
+#define RAID4_ISA_SSE2    1
+#define RAID4_ISA_AVX2    2
+#define RAID4_ISA_AVX512  3
+#define RAID4_ISA_MAX     4
+
+LIO_API int raid4_isa_supported(int isa);
+LIO_API const char *raid4_isa_name(int isa);
+LIO_API int raid4_set_isa(int isa);
+LIO_API int raid4_get_isa();
+LIO_API void raid4_xor(int n, char **src, char *dest, int nbytes);
 void raid4_encode(int data_strips, char **data, char **parity, int block_size);
 int raid4_decode(int data_strips, int *erasures, char **data, char **parity, int block_size);
 
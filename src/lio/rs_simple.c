@@ -246,7 +246,7 @@ op_generic_t *rs_simple_request(resource_service_fn_t *arg, data_attr_t *da, rs_
         found = 0;
         loop_end = 1;
         query_local = NULL;
-        rnd_off = tbx_random_get_int64(0, rss->n_rids-1);
+        rnd_off = tbx_random_fast_int64(0, rss->n_rids-1);
 //rnd_off = 0;  //FIXME
 
         if (hints_list != NULL) {
@@ -672,7 +672,7 @@ void rss_mapping_notify(resource_service_fn_t *rs, int new_version, int status_c
     apr_ssize_t klen;
     void *rid;
 
-    if (status_change > 0) status_change = tbx_random_get_int64(0, 100000);
+    if (status_change > 0) status_change = tbx_random_fast_int64(0, 100000);
 
     apr_thread_mutex_lock(rss->update_lock);
     for (hi = apr_hash_first(NULL, rss->mapping_updates); hi != NULL; hi = apr_hash_next(hi)) {
@@ -911,7 +911,7 @@ int _rs_simple_load(resource_service_fn_t *res, char *fname)
         for (i=0; i < rss->n_rids; i++) {
             tbx_list_next(&it, (tbx_list_key_t **)&key, (tbx_list_data_t **)&rse);
 
-            n = tbx_random_get_int64(0, rss->n_rids-1);
+            n = tbx_random_fast_int64(0, rss->n_rids-1);
 //n = i;  //FIXME
             while (rss->random_array[n] != NULL) {
                 n = (n+1) % rss->n_rids;
@@ -20,9 +20,12 @@
 
 #define _log_module_index 160
 
+#include <sys/types.h>
+#include <sys/stat.h>
 #include "ex3_abstract.h"
 #include "ex3_system.h"
 #include <tbx/list.h>
+#include <tbx/network.h>
 #include <tbx/random.h>
 #include <tbx/type_malloc.h>
 #include <tbx/log.h>
@@ -38,10 +41,21 @@ typedef struct {
     ex_off_t dest_offset;
     ex_off_t len;
     ex_off_t bufsize;
+    int n_bufs;
     int timeout;
     int truncate;
 } segment_copy_t;
 
+typedef struct {    //** A single buffer in the copy ring
+    tbx_tbuf_t tbuf;
+    ex_tbx_iovec_t ex;
+    char *buffer;
+    ex_off_t offset;    //** Source offset for copy/get and file offset for put
+    ex_off_t len;
+    op_generic_t *gop;
+    int writing;
+} segment_copy_slot_t;
+
 //***********************************************************************
 // load_segment - Loads the given segment from the file/struct
 //***********************************************************************
@@ -74,103 +88,121 @@ segment_t *load_segment(service_manager_t *ess, ex_id_t id, exnode_exchange_t *e
 }
 
 //***********************************************************************
-// segment_copy_func - Does the actual segment copy operation
+// _segment_copy_ring - Splits the buffer into the ring of slots used for
+//     the transfer.  The number of slots and the size of each are returned.
+//***********************************************************************
+
+segment_copy_slot_t *_segment_copy_ring(segment_copy_t *sc, int *n_bufs, ex_off_t *bufsize)
+{
+    segment_copy_slot_t *slot;
+    int i, n;
+
+    n = (sc->n_bufs > 0) ? sc->n_bufs : SEGMENT_COPY_DEFAULT_BUFS;
+    if (n > sc->bufsize) n = sc->bufsize;
+    if (n < 1) n = 1;
+    *bufsize = sc->bufsize / n;
+
+    tbx_type_malloc_clear(slot, segment_copy_slot_t, n);
+    for (i=0; i<n; i++) {
+        slot[i].buffer = &(sc->buffer[i * (*bufsize)]);
+        tbx_tbuf_single(&(slot[i].tbuf), *bufsize, slot[i].buffer);
+    }
+
+    *n_bufs = n;
+    return(slot);
+}
+
+//***********************************************************************
+// _segment_copy_read - Generates the read for the next source block into
+//     the slot and advances the read position.
+//***********************************************************************
+
+op_generic_t *_segment_copy_read(segment_copy_t *sc, segment_copy_slot_t *s, ex_off_t *rpos, ex_off_t *nbytes, ex_off_t bufsize)
+{
+    s->writing = 0;
+    s->offset = *rpos;
+    s->len = (*nbytes > bufsize) ? bufsize : *nbytes;
+    *rpos += s->len;
+    *nbytes -= s->len;
+
+    ex_iovec_single(&(s->ex), s->offset, s->len);
+    s->gop = segment_read(sc->src, sc->da, sc->rw_hints, 1, &(s->ex), &(s->tbuf), 0, sc->timeout);
+    return(s->gop);
+}
+
+//***********************************************************************
+// segment_copy_func - Does the actual segment copy operation.  Each slot
+//     in the ring cycles between reading the next block and writing it
+//     so up to n_bufs transfers are in flight without a lock step barrier.
 //***********************************************************************
 
 op_status_t segment_copy_func(void *arg, int id)
 {
     segment_copy_t *sc = (segment_copy_t *)arg;
-    tbx_tbuf_t *wbuf, *rbuf, *tmpbuf;
-    tbx_tbuf_t tbuf1, tbuf2;
-    int err;
-    ex_off_t bufsize;
-    ex_off_t rpos, wpos, rlen, wlen, tlen, nbytes, dend;
-    ex_tbx_iovec_t rex, wex;
+    segment_copy_slot_t *slot, *s;
+    int i, n, nerr;
+    ex_off_t bufsize, rpos, wpos, nbytes, dend;
     opque_t *q;
-    op_generic_t *rgop, *wgop;
+    op_generic_t *gop;
     op_status_t status;
 
-    //** Set up the buffers
-    bufsize = sc->bufsize / 2;  //** The buffer is split for R/W
-    tbx_tbuf_single(&tbuf1, bufsize, sc->buffer);
-    tbx_tbuf_single(&tbuf2, bufsize, &(sc->buffer[bufsize]));
-    rbuf = &tbuf1;
-    wbuf = &tbuf2;
+    slot = _segment_copy_ring(sc, &n, &bufsize);
 
     //** Check the length
     nbytes = segment_size(sc->src) - sc->src_offset;
-    if (nbytes < 0) {
-        rlen = bufsize;
-    } else {
-        rlen = (nbytes > bufsize) ? bufsize : nbytes;
-    }
+    if (nbytes < 0) nbytes = 0;
     if ((sc->len != -1) && (sc->len < nbytes)) nbytes = sc->len;
 
     //** Go ahead and reserve the space in the destintaion
     dend = sc->dest_offset + nbytes;
-    log_printf(1, "reserving space=" XOT "\n", dend);
+    log_printf(1, "reserving space=" XOT " n_bufs=%d bufsize=" XOT "\n", dend, n, bufsize);
     gop_sync_exec(segment_truncate(sc->dest, sc->da, -dend, sc->timeout));
 
-    //** Read the initial block
+    //** Prime the ring
     rpos = sc->src_offset;
-    wpos = sc->dest_offset;
-//  rlen = (nbytes > bufsize) ? bufsize : nbytes;
-    wlen = 0;
-    ex_iovec_single(&rex, rpos, rlen);
-    rpos += rlen;
-    nbytes -= rlen;
-    rgop = segment_read(sc->src, sc->da, sc->rw_hints, 1, &rex, rbuf, 0, sc->timeout);
-    err = gop_waitall(rgop);
-    if (err != OP_STATE_SUCCESS) {
-        log_printf(1, "Intial read failed! src=%" PRIu64 " rpos=" XOT " len=" XOT "\n", segment_id(sc->src), rpos, rlen);
-        gop_free(rgop, OP_DESTROY);
-        return(op_failure_status);
+    nerr = 0;
+    q = new_opque();
+    for (i=0; (i<n) && (nbytes > 0); i++) {
+        gop = _segment_copy_read(sc, &(slot[i]), &rpos, &nbytes, bufsize);
+        gop_set_myid(gop, i);
+        opque_add(q, gop);
     }
-    gop_free(rgop, OP_DESTROY);
 
-    q = new_opque();
-    do {
-        //** Swap the buffers
-        tmpbuf = rbuf;
-        rbuf = wbuf;
-        wbuf = tmpbuf;
-        tlen = rlen;
-        rlen = wlen;
-        wlen = tlen;
-
-        log_printf(1, "sseg=" XIDT " dseg=" XIDT " wpos=%" PRId64 " rlen=%" PRId64 " wlen=%" PRId64 "\n", segment_id(sc->src), segment_id(sc->dest), wpos, rlen, wlen);
-
-        //** Start the write
-        ex_iovec_single(&wex, wpos, wlen);
-        wpos += wlen;
-        wgop = segment_write(sc->dest, sc->da, sc->rw_hints, 1, &wex, wbuf, 0, sc->timeout);
-        opque_add(q, wgop);
-
-        //** Read in the next block
-//     rlen = (nbytes > bufsize) ? bufsize : nbytes;
-        if (nbytes < 0) {
-            rlen = bufsize;
-        } else {
-            rlen = (nbytes > bufsize) ? bufsize : nbytes;
-        }
-        if (rlen > 0) {
-            ex_iovec_single(&rex, rpos, rlen);
-            rpos += rlen;
-            nbytes -= rlen;
-            rgop = segment_read(sc->src, sc->da, sc->rw_hints, 1, &rex, rbuf, 0, sc->timeout);
-            opque_add(q, rgop);
-        }
+    while ((gop = opque_waitany(q)) != NULL) {
+        i = gop_get_myid(gop);
+        s = &(slot[i]);
+        status = gop_get_status(gop);
+        gop_free(gop, OP_DESTROY);
+        s->gop = NULL;
 
-        err = opque_waitall(q);
-        if (err != OP_STATE_SUCCESS) {
-            log_printf(1, "ERROR read/write failed! src=" XIDT " rpos=" XOT " len=" XOT "\n", segment_id(sc->src), rpos, rlen);
-            opque_free(q, OP_DESTROY);
-            return(op_failure_status);
+        if (status.op_status != OP_STATE_SUCCESS) {
+            log_printf(1, "ERROR %s failed! sseg=" XIDT " dseg=" XIDT " off=" XOT " len=" XOT "\n", ((s->writing == 0) ? "read" : "write"),
+                       segment_id(sc->src), segment_id(sc->dest), s->offset, s->len);
+            nerr++;
+            continue;
+        }
+        if (nerr > 0) continue;  //** Just draining what's still in flight
+
+        if (s->writing == 0) {  //** Got the data so push it to the destination
+            log_printf(1, "sseg=" XIDT " dseg=" XIDT " slot=%d off=" XOT " len=" XOT "\n", segment_id(sc->src), segment_id(sc->dest), i, s->offset, s->len);
+            s->writing = 1;
+            ex_iovec_single(&(s->ex), sc->dest_offset + s->offset - sc->src_offset, s->len);
+            s->gop = segment_write(sc->dest, sc->da, sc->rw_hints, 1, &(s->ex), &(s->tbuf), 0, sc->timeout);
+            gop_set_myid(s->gop, i);
+            opque_add(q, s->gop);
+        } else if (nbytes > 0) {  //** Slot is free so reuse it for the next block
+            gop = _segment_copy_read(sc, s, &rpos, &nbytes, bufsize);
+            gop_set_myid(gop, i);
+            opque_add(q, gop);
         }
-    } while (rlen > 0);
+    }
 
     opque_free(q, OP_DESTROY);
+    free(slot);
+
+    if (nerr > 0) return(op_failure_status);
 
+    wpos = sc->dest_offset + rpos - sc->src_offset;
     if (sc->truncate == 1) {  //** Truncate if wanted
         gop_sync_exec(segment_truncate(sc->dest, sc->da, wpos, sc->timeout));
     }
@@ -186,10 +218,12 @@ op_status_t segment_copy_func(void *arg, int id)
 //      by reading from the source and writing to the destination.
 //      This is not a depot-depot copy.  The data goes through the client.
 //
+//      The buffer is split into n_bufs slots which are kept in flight.
+//      If n_bufs <= 0 then SEGMENT_COPY_DEFAULT_BUFS is used.
 //      If len == -1 then all available data from src is copied
 //***********************************************************************
 
-op_generic_t *segment_copy(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, segment_t *src_seg, segment_t *dest_seg, ex_off_t src_offset, ex_off_t dest_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int do_truncate, int timeout)
+op_generic_t *segment_copy(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, segment_t *src_seg, segment_t *dest_seg, ex_off_t src_offset, ex_off_t dest_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int n_bufs, int do_truncate, int timeout)
 {
     segment_copy_t *sc;
 
@@ -205,6 +239,7 @@ op_generic_t *segment_copy(thread_pool_context_t *tpc, data_attr_t *da, segment_
     sc->len = len;
     sc->bufsize = bufsize;
     sc->buffer = buffer;
+    sc->n_bufs = n_bufs;
     sc->truncate = do_truncate;
 
     return(new_thread_pool_op(tpc, NULL, segment_copy_func, (void *)sc, free, 1));
@@ -212,127 +247,266 @@ op_generic_t *segment_copy(thread_pool_context_t *tpc, data_attr_t *da, segment_
 
 
 //***********************************************************************
-// segment_get_func - Does the actual segment get operation
+// _segment_extent_array - Converts the extent stack into an array
 //***********************************************************************
 
-op_status_t segment_get_func(void *arg, int id)
+segment_extent_t **_segment_extent_array(tbx_stack_t *stack, int *n)
+{
+    segment_extent_t **ext;
+    int i;
+
+    *n = tbx_stack_count(stack);
+    tbx_type_malloc(ext, segment_extent_t *, *n + 1);
+    tbx_stack_move_to_top(stack);
+    for (i=0; i < *n; i++) {
+        ext[i] = tbx_stack_get_current_data(stack);
+        tbx_stack_move_down(stack);
+    }
+
+    return(ext);
+}
+
+//***********************************************************************
+// _segment_depot_copy_issue - Adds the depot-depot copies for the range
+//     splitting it up as needed.  The number of copies in flight is capped.
+//***********************************************************************
+
+void _segment_depot_copy_issue(segment_copy_t *sc, opque_t *q, data_block_t *sdata, ex_off_t soff, data_block_t *ddata, ex_off_t doff, ex_off_t len, int *n, int *nerr)
+{
+    op_generic_t *gop;
+    ex_off_t nbytes;
+
+    while (len > 0) {
+        while ((opque_tasks_left(q) >= SEGMENT_DEPOT_COPY_MAX_INFLIGHT) && ((gop = opque_waitany(q)) != NULL)) {
+            if (gop_completed_successfully(gop) != OP_STATE_SUCCESS) (*nerr)++;
+            gop_free(gop, OP_DESTROY);
+        }
+
+        nbytes = (len > SEGMENT_DEPOT_COPY_MAX_TRANSFER) ? SEGMENT_DEPOT_COPY_MAX_TRANSFER : len;
+        gop = ds_copy(ddata->ds, sc->da, DS_PUSH, NS_TYPE_SOCK, "",
+                      ds_get_cap(sdata->ds, sdata->cap, DS_CAP_READ), soff,
+                      ds_get_cap(ddata->ds, ddata->cap, DS_CAP_WRITE), doff, nbytes, sc->timeout);
+        opque_add(q, gop);
+        (*n)++;
+
+        soff += nbytes;
+        doff += nbytes;
+        len -= nbytes;
+    }
+}
+
+//***********************************************************************
+// segment_depot_copy_func - Plans and runs the depot-depot copy
+//***********************************************************************
+
+op_status_t segment_depot_copy_func(void *arg, int id)
 {
     segment_copy_t *sc = (segment_copy_t *)arg;
-    tbx_tbuf_t *wbuf, *rbuf, *tmpbuf;
-    tbx_tbuf_t tbuf1, tbuf2;
-    char *rb, *wb, *tb;
-    ex_off_t bufsize;
-    int err;
-    ex_off_t rpos, wpos, rlen, wlen, tlen, nbytes, got, total;
-    ex_tbx_iovec_t rex;
-    apr_time_t loop_start, file_start;
-    double dt_loop, dt_file;
+    tbx_stack_t *sstack, *dstack;
+    segment_extent_t **sext, **dext;
+    data_block_t *sdata, *ddata;
+    ex_off_t size, lo, hi, send, dend, soff, doff, scap, dcap, len, plen;
+    int i, j, ns, nd, n, nerr;
+    opque_t *q;
     op_generic_t *gop;
     op_status_t status;
 
-    //** Set up the buffers
-    bufsize = sc->bufsize / 2;  //** The buffer is split for R/W
-    rb = sc->buffer;
-    wb = &(sc->buffer[bufsize]);
-    tbx_tbuf_single(&tbuf1, bufsize, rb);
-    tbx_tbuf_single(&tbuf2, bufsize, wb);
-    rbuf = &tbuf1;
-    wbuf = &tbuf2;
+    size = segment_size(sc->src);
+
+    //** Make sure everything is on the depots and the destination space exists
+    if (size > 0) gop_sync_exec(segment_flush(sc->src, sc->da, 0, size-1, sc->timeout));
+    if (gop_sync_exec(segment_truncate(sc->dest, sc->da, size, sc->timeout)) != OP_STATE_SUCCESS) {
+        log_printf(1, "ERROR growing dseg=" XIDT " to " XOT "\n", segment_id(sc->dest), size);
+        return(op_failure_status);
+    }
+    if (size == 0) return(op_success_status);
+
+    //** The copy bypasses the destination's cache so any pages it holds are
+    //** superseded.  Dirty ones are dropped too or a later flush would clobber it.
+    cache_drop_pages(sc->dest, 0, size);
+
+    //** Get both layouts
+    sstack = tbx_stack_new();
+    dstack = tbx_stack_new();
+    if ((segment_extents(sc->src, 0, size-1, sstack) != 0) || (segment_extents(sc->dest, 0, size-1, dstack) != 0)) {
+        log_printf(5, "Layout not supported sseg=" XIDT " dseg=" XIDT "\n", segment_id(sc->src), segment_id(sc->dest));
+        tbx_stack_free(sstack, 1);
+        tbx_stack_free(dstack, 1);
+        return(op_failure_status);
+    }
+    sext = _segment_extent_array(sstack, &ns);
+    dext = _segment_extent_array(dstack, &nd);
+
+    //** Walk both extent lists together.  Each overlap is a piece that lives in a
+    //** single source and destination block.  Pieces that continue the previous one
+    //** in both blocks are merged so striped layouts don't turn into tiny copies.
+    q = new_opque();
+    opque_start_execution(q);
+    nerr = 0;
+    n = 0;
+    i = j = 0;
+    plen = 0;
+    sdata = ddata = NULL;
+    soff = doff = 0;
+    while ((i < ns) && (j < nd) && (nerr == 0)) {
+        send = sext[i]->seg_offset + sext[i]->len;
+        dend = dext[j]->seg_offset + dext[j]->len;
+        lo = (sext[i]->seg_offset > dext[j]->seg_offset) ? sext[i]->seg_offset : dext[j]->seg_offset;
+        hi = (send < dend) ? send : dend;
+        len = hi - lo;
+
+        if (len > 0) {
+            if (sext[i]->data->ds != dext[j]->data->ds) {
+                log_printf(5, "Different data services sseg=" XIDT " dseg=" XIDT "\n", segment_id(sc->src), segment_id(sc->dest));
+                nerr++;
+                break;
+            }
+
+            scap = sext[i]->cap_offset + lo - sext[i]->seg_offset;
+            dcap = dext[j]->cap_offset + lo - dext[j]->seg_offset;
+            if ((plen > 0) && (sdata == sext[i]->data) && (ddata == dext[j]->data) && (soff + plen == scap) && (doff + plen == dcap)) {
+                plen += len;
+            } else {
+                if (plen > 0) _segment_depot_copy_issue(sc, q, sdata, soff, ddata, doff, plen, &n, &nerr);
+                sdata = sext[i]->data;
+                ddata = dext[j]->data;
+                soff = scap;
+                doff = dcap;
+                plen = len;
+            }
+        }
+
+        if (send <= dend) i++;
+        if (dend <= send) j++;
+    }
+
+    if ((plen > 0) && (nerr == 0)) _segment_depot_copy_issue(sc, q, sdata, soff, ddata, doff, plen, &n, &nerr);
+    if ((i < ns) && (nerr == 0)) {
+        log_printf(1, "ERROR destination layout too small! dseg=" XIDT " size=" XOT "\n", segment_id(sc->dest), size);
+        nerr++;
+    }
+
+    while ((gop = opque_waitany(q)) != NULL) {
+        if (gop_completed_successfully(gop) != OP_STATE_SUCCESS) nerr++;
+        gop_free(gop, OP_DESTROY);
+    }
+    opque_free(q, OP_DESTROY);
+
+    //** And again in case a reader pulled in pages while the copies were running
+    cache_drop_pages(sc->dest, 0, size);
+
+    log_printf(5, "sseg=" XIDT " dseg=" XIDT " size=" XOT " src_extents=%d dest_extents=%d copies=%d nerr=%d\n",
+               segment_id(sc->src), segment_id(sc->dest), size, ns, nd, n, nerr);
+
+    free(sext);
+    free(dext);
+    tbx_stack_free(sstack, 1);
+    tbx_stack_free(dstack, 1);
+
+    if (nerr > 0) return(op_failure_status);
+
+    status = op_success_status;
+    status.error_code = size;
+    return(status);
+}
+
+//***********************************************************************
+// segment_depot_copy - Copies the data between segments with differing
+//      layouts using depot-depot copies so the data never touches the
+//      client.  The extents of each segment are mapped onto each other and
+//      a copy is issued for every overlap.  The destination is truncated
+//      to the source size.
+//
+//      Fails if either segment can't report it's extents (for example if
+//      it has parity) or the blocks use different data services.  The
+//      caller should fall back to segment_copy() in that case.
+//***********************************************************************
+
+op_generic_t *segment_depot_copy(thread_pool_context_t *tpc, data_attr_t *da, segment_t *src_seg, segment_t *dest_seg, int timeout)
+{
+    segment_copy_t *sc;
+
+    tbx_type_malloc_clear(sc, segment_copy_t, 1);
+
+    sc->da = da;
+    sc->timeout = timeout;
+    sc->src = src_seg;
+    sc->dest = dest_seg;
+
+    return(new_thread_pool_op(tpc, NULL, segment_depot_copy_func, (void *)sc, free, 1));
+}
+
+
+//***********************************************************************
+// segment_get_func - Does the actual segment get operation.  The file is
+//     written sequentially so the oldest read is waited on while the rest
+//     of the ring keeps streaming.
+//***********************************************************************
 
+op_status_t segment_get_func(void *arg, int id)
+{
+    segment_copy_t *sc = (segment_copy_t *)arg;
+    segment_copy_slot_t *slot, *s;
+    ex_off_t bufsize;
+    int i, n, err;
+    ex_off_t rpos, nbytes, got, total;
+    apr_time_t file_start;
+    double dt_file;
+    op_status_t status;
+
+    slot = _segment_copy_ring(sc, &n, &bufsize);
     status = op_success_status;
 
-    //** Read the initial block
+    //** Check the length
     rpos = sc->src_offset;
-    wpos = 0;
     nbytes = segment_size(sc->src) - sc->src_offset;
-    if (nbytes < 0) {
-        rlen = bufsize;
-    } else {
-        rlen = (nbytes > bufsize) ? bufsize : nbytes;
-    }
+    if (nbytes < 0) nbytes = 0;
+    if ((sc->len != -1) && (sc->len < nbytes)) nbytes = sc->len;
 
-    log_printf(5, "FILE fd=%p\n", sc->fd);
-
-    ex_iovec_single(&rex, rpos, rlen);
-    wlen = 0;
-    rpos += rlen;
-    nbytes -= rlen;
-    loop_start = apr_time_now();
-    gop = segment_read(sc->src, sc->da, sc->rw_hints, 1, &rex, rbuf, 0, sc->timeout);
-    err = gop_waitall(gop);
-    if (err != OP_STATE_SUCCESS) {
-        log_printf(1, "Intial read failed! src=" XIDT " rpos=" XOT " len=" XOT "\n", segment_id(sc->src), rpos, rlen);
-        gop_free(gop, OP_DESTROY);
-        return(op_failure_status);
+    log_printf(5, "FILE fd=%p n_bufs=%d bufsize=" XOT " nbytes=" XOT "\n", sc->fd, n, bufsize, nbytes);
+
+    //** Prime the ring
+    for (i=0; (i<n) && (nbytes > 0); i++) {
+        gop_start_execution(_segment_copy_read(sc, &(slot[i]), &rpos, &nbytes, bufsize));
     }
-    gop_free(gop, OP_DESTROY);
 
     total = 0;
-
-    do {
-        //** Swap the buffers
-        tb = rb;
-        rb = wb;
-        wb = tb;
-        tmpbuf = rbuf;
-        rbuf = wbuf;
-        wbuf = tmpbuf;
-        tlen = rlen;
-        rlen = wlen;
-        wlen = tlen;
-
-        log_printf(1, "sseg=" XIDT " rpos=" XOT " wpos=" XOT " rlen=" XOT " wlen=" XOT " nbytes=" XOT "\n", segment_id(sc->src), rpos, wpos, rlen, wlen, nbytes);
-
-        //** Read in the next block
-        if (nbytes < 0) {
-            rlen = bufsize;
-        } else {
-            rlen = (nbytes > bufsize) ? bufsize : nbytes;
-        }
-        if (rlen > 0) {
-            ex_iovec_single(&rex, rpos, rlen);
-            loop_start = apr_time_now();
-            gop = segment_read(sc->src, sc->da, sc->rw_hints, 1, &rex, rbuf, 0, sc->timeout);
-            gop_start_execution(gop);  //** Start doing the transfer
-            rpos += rlen;
-            nbytes -= rlen;
+    i = 0;
+    while (slot[i].gop != NULL) {
+        s = &(slot[i]);
+        err = gop_waitall(s->gop);
+        gop_free(s->gop, OP_DESTROY);
+        s->gop = NULL;
+        if (err != OP_STATE_SUCCESS) {
+            log_printf(1, "ERROR read(sseg=" XIDT ") failed! off=" XOT " len=" XOT "\n", segment_id(sc->src), s->offset, s->len);
+            status = op_failure_status;
+            break;
         }
 
-        //** Start the write
         file_start = apr_time_now();
-        got = fwrite(wb, 1, wlen, sc->fd);
+        got = fwrite(s->buffer, 1, s->len, sc->fd);
         dt_file = apr_time_now() - file_start;
         dt_file /= (double)APR_USEC_PER_SEC;
         total += got;
-        log_printf(5, "sid=" XIDT " fwrite(wb,1," XOT ", sc->fd)=" XOT " total=" XOT "\n", segment_id(sc->src), wlen, got, total);
-        if (wlen != got) {
-            log_printf(1, "ERROR from fread=%d  dest sid=" XIDT "\n", errno, segment_id(sc->dest));
+        log_printf(5, "sid=" XIDT " fwrite(wb,1," XOT ", sc->fd)=" XOT " total=" XOT " dt_file=%lf\n", segment_id(sc->src), s->len, got, total, dt_file);
+        if (s->len != got) {
+            log_printf(1, "ERROR from fwrite=%d  src sid=" XIDT "\n", errno, segment_id(sc->src));
             status = op_failure_status;
-            gop_waitall(gop);
-            gop_free(gop, OP_DESTROY);
-            goto fail;
+            break;
         }
 
-        wpos += wlen;
+        if (nbytes > 0) gop_start_execution(_segment_copy_read(sc, s, &rpos, &nbytes, bufsize));
+        i = (i+1) % n;
+    }
 
-        //** Wait for the read to complete
-        if (rlen > 0) {
-            err = gop_waitall(gop);
-            gop_free(gop, OP_DESTROY);
-            if (err != OP_STATE_SUCCESS) {
-                log_printf(1, "ERROR write(dseg=" XIDT ") failed! wpos=" XOT " len=" XOT "\n", segment_id(sc->dest), wpos, wlen);
-                status = op_failure_status;
-                goto fail;
-            }
+    //** Drain anything still in flight if we bailed early
+    for (i=0; i<n; i++) {
+        if (slot[i].gop != NULL) {
+            gop_waitall(slot[i].gop);
+            gop_free(slot[i].gop, OP_DESTROY);
         }
-
-        dt_loop = apr_time_now() - loop_start;
-        dt_loop /= (double)APR_USEC_PER_SEC;
-        log_printf(1, "dt_loop=%lf  dt_file=%lf\n", dt_loop, dt_file);
-
-    } while (rlen > 0);
-
-fail:
+    }
+    free(slot);
 
     return(status);
 }
@@ -341,10 +515,12 @@ fail:
 
 //***********************************************************************
 // segment_get - Reads data from the given segment and copies it to the given FD
+//      The buffer is split into n_bufs slots.  If n_bufs <= 0 then
+//      SEGMENT_COPY_DEFAULT_BUFS is used.
 //      If len == -1 then all available data from src is copied
 //***********************************************************************
 
-op_generic_t *segment_get(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, segment_t *src_seg, FILE *fd, ex_off_t src_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int timeout)
+op_generic_t *segment_get(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, segment_t *src_seg, FILE *fd, ex_off_t src_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int n_bufs, int timeout)
 {
     segment_copy_t *sc;
 
@@ -359,141 +535,154 @@ op_generic_t *segment_get(thread_pool_context_t *tpc, data_attr_t *da, segment_r
     sc->len = len;
     sc->bufsize = bufsize;
     sc->buffer = buffer;
+    sc->n_bufs = n_bufs;
 
     return(new_thread_pool_op(tpc, NULL, segment_get_func, (void *)sc, free, 1));
 }
 
 //***********************************************************************
-// segment_put_func - Does the actual segment put operation
+// _segment_put_read - Loads the next rlen bytes from the file into tbuf and
+//    returns the number of bytes available.  Regular files are sent as a
+//    file range so the data can go straight from the page cache to the
+//    network.  buffer is only filled if a layer needs the data.  Otherwise
+//    the data is read into buffer.  foff is the file position for file
+//    ranges and is -1 if the file isn't a regular file.
+//***********************************************************************
+
+ex_off_t _segment_put_read(FILE *fd, tbx_tbuf_t *tbuf, char *buffer, ex_off_t rlen, ex_off_t *foff)
+{
+    struct stat st;
+    ex_off_t got;
+
+    if (*foff >= 0) {
+        if (fstat(fileno(fd), &st) != 0) return(0);  //** Check the size each time in case the file shrank
+        if (rlen > (st.st_size - *foff)) rlen = st.st_size - *foff;
+        if (rlen <= 0) return(0);
+        tbx_tbuf_fd(tbuf, rlen, fileno(fd), *foff, buffer);
+        *foff += rlen;
+        return(rlen);
+    }
+
+    tbx_tbuf_single(tbuf, rlen, buffer);
+    got = fread(buffer, 1, rlen, fd);
+
+    return(got);
+}
+
+//***********************************************************************
+// _segment_put_fill - Loads the next block from the file into the slot
+//     and adds the write for it to the que.  Returns 0 if a write was
+//     issued, 1 if there is nothing left to send, and -1 on a read error.
+//***********************************************************************
+
+int _segment_put_fill(segment_copy_t *sc, opque_t *q, segment_copy_slot_t *slot, int i, ex_off_t *wpos, ex_off_t *nbytes, ex_off_t *foff, ex_off_t bufsize)
+{
+    segment_copy_slot_t *s = &(slot[i]);
+    ex_off_t rlen, got;
+
+    rlen = ((*nbytes < 0) || (*nbytes > bufsize)) ? bufsize : *nbytes;
+    if (rlen == 0) return(1);
+
+    got = _segment_put_read(sc->fd, &(s->tbuf), s->buffer, rlen, foff);
+    if (got == 0) {
+        if (ferror(sc->fd) != 0)  {
+            log_printf(1, "ERROR from fread=%d  dest sid=" XIDT " rlen=" XOT "\n", errno, segment_id(sc->dest), rlen);
+            return(-1);
+        }
+        return(1);
+    }
+
+    s->writing = 1;
+    s->offset = *wpos;
+    s->len = got;
+    *wpos += got;
+    if (*nbytes > 0) *nbytes -= got;
+
+    log_printf(1, "dseg=" XIDT " slot=%d wpos=" XOT " len=" XOT "\n", segment_id(sc->dest), i, s->offset, s->len);
+
+    ex_iovec_single(&(s->ex), s->offset, s->len);
+    s->gop = segment_write(sc->dest, sc->da, sc->rw_hints, 1, &(s->ex), &(s->tbuf), 0, sc->timeout);
+    gop_set_myid(s->gop, i);
+    opque_add(q, s->gop);
+
+    return(0);
+}
+
+//***********************************************************************
+// segment_put_func - Does the actual segment put operation.  The file is
+//     read sequentially but the writes for each slot in the ring are
+//     kept in flight concurrently.
 //***********************************************************************
 
 op_status_t segment_put_func(void *arg, int id)
 {
     segment_copy_t *sc = (segment_copy_t *)arg;
-    tbx_tbuf_t *wbuf, *rbuf, *tmpbuf;
-    tbx_tbuf_t tbuf1, tbuf2;
-    char *rb, *wb, *tb;
+    segment_copy_slot_t *slot, *s;
     ex_off_t bufsize;
-    int err;
-    ex_off_t rpos, wpos, rlen, wlen, tlen, nbytes, got, dend;
-    ex_tbx_iovec_t wex;
+    int i, n, err, nerr, done;
+    ex_off_t wpos, nbytes, dend, foff;
+    opque_t *q;
     op_generic_t *gop;
     op_status_t status;
-    apr_time_t loop_start, file_start;
-    double dt_loop, dt_file;
-
-    //** Set up the buffers
-    bufsize = sc->bufsize / 2;  //** The buffer is split for R/W
-    rb = sc->buffer;
-    wb = &(sc->buffer[bufsize]);
-    tbx_tbuf_single(&tbuf1, bufsize, rb);
-    tbx_tbuf_single(&tbuf2, bufsize, wb);
-    rbuf = &tbuf1;
-    wbuf = &tbuf2;
+    struct stat st;
 
+    slot = _segment_copy_ring(sc, &n, &bufsize);
     nbytes = sc->len;
-    status = op_success_status;
+
+    //** See if we can send file ranges instead of reading it
+    foff = -1;
+    if ((fstat(fileno(sc->fd), &st) == 0) && (S_ISREG(st.st_mode))) foff = ftello(sc->fd);
 
     //** Go ahead and reserve the space in the destintaion
     dend = sc->dest_offset + nbytes;
     gop_sync_exec(segment_truncate(sc->dest, sc->da, -dend, sc->timeout));
 
-    //** Read the initial block
-    rpos = 0;
+    log_printf(0, "FILE fd=%p n_bufs=%d bufsize=" XOT " nbytes=" XOT " foff=" XOT "\n", sc->fd, n, bufsize, nbytes, foff);
+
+    //** Prime the ring
     wpos = sc->dest_offset;
-    if (nbytes < 0) {
-        rlen = bufsize;
-    } else {
-        rlen = (nbytes > bufsize) ? bufsize : nbytes;
+    nerr = 0;
+    done = 0;
+    q = new_opque();
+    for (i=0; i<n; i++) {
+        err = _segment_put_fill(sc, q, slot, i, &wpos, &nbytes, &foff, bufsize);
+        if (err != 0) {
+            if (err < 0) nerr++;
+            done = 1;
+            break;
+        }
     }
 
-    wlen = 0;
-    rpos += rlen;
-    nbytes -= rlen;
-    log_printf(0, "FILE fd=%p bufsize=" XOT " rlen=" XOT " nbytes=" XOT "\n", sc->fd, bufsize, rlen, nbytes);
+    while ((gop = opque_waitany(q)) != NULL) {
+        i = gop_get_myid(gop);
+        s = &(slot[i]);
+        status = gop_get_status(gop);
+        gop_free(gop, OP_DESTROY);
+        s->gop = NULL;
 
-    loop_start = apr_time_now();
-    got = fread(rb, 1, rlen, sc->fd);
-    dt_file = apr_time_now() - loop_start;
-    dt_file /= (double)APR_USEC_PER_SEC;
+        if (status.op_status != OP_STATE_SUCCESS) {
+            log_printf(1, "ERROR write(dseg=" XIDT ") failed! wpos=" XOT " len=" XOT "\n", segment_id(sc->dest), s->offset, s->len);
+            nerr++;
+            continue;
+        }
+        if ((nerr > 0) || (done == 1)) continue;
 
-    if (got == 0) {
-        if (feof(sc->fd) == 0)  {
-            log_printf(1, "ERROR from fread=%d  dest sid=" XIDT " rlen=" XOT " got=" XOT "\n", errno, segment_id(sc->dest), rlen, got);
-            status = op_failure_status;
+        err = _segment_put_fill(sc, q, slot, i, &wpos, &nbytes, &foff, bufsize);
+        if (err != 0) {
+            if (err < 0) nerr++;
+            done = 1;
         }
-        goto finished;
     }
-    rlen = got;
-
-    do {
-        //** Swap the buffers
-        tb = rb;
-        rb = wb;
-        wb = tb;
-        tmpbuf = rbuf;
-        rbuf = wbuf;
-        wbuf = tmpbuf;
-        tlen = rlen;
-        rlen = wlen;
-        wlen = tlen;
-
-        log_printf(1, "dseg=" XIDT " wpos=" XOT " rlen=" XOT " wlen=" XOT "\n", segment_id(sc->dest), wpos, rlen, wlen);
-
-        //** Start the write
-        ex_iovec_single(&wex, wpos, wlen);
-        wpos += wlen;
-        loop_start = apr_time_now();
-        gop = segment_write(sc->dest, sc->da, sc->rw_hints, 1, &wex, wbuf, 0, sc->timeout);
-        gop_start_execution(gop);  //** Start doing the transfer
-
-        //** Read in the next block
-        if (nbytes < 0) {
-            rlen = bufsize;
-        } else {
-            rlen = (nbytes > bufsize) ? bufsize : nbytes;
-        }
-        if (rlen > 0) {
-            file_start = apr_time_now();
-            got = fread(rb, 1, rlen, sc->fd);
-            dt_file = apr_time_now() - file_start;
-            dt_file /= (double)APR_USEC_PER_SEC;
-            if (got == 0) {
-                if (feof(sc->fd) == 0)  {
-                    log_printf(1, "ERROR from fread=%d  dest sid=" XIDT " got=" XOT " rlen=" XOT "\n", errno, segment_id(sc->dest), got, rlen);
-                    status = op_failure_status;
-                    gop_waitall(gop);
-                    gop_free(gop, OP_DESTROY);
-                    goto finished;
-                }
-            }
-            rlen = got;
-            rpos += rlen;
-            nbytes -= rlen;
-        }
-
-        //** Wait for it to complete
-        err = gop_waitall(gop);
-        dt_loop = apr_time_now() - loop_start;
-        dt_loop /= (double)APR_USEC_PER_SEC;
-
-        log_printf(1, "dt_loop=%lf  dt_file=%lf\n", dt_loop, dt_file);
 
-        if (err != OP_STATE_SUCCESS) {
-            log_printf(1, "ERROR write(dseg=" XIDT ") failed! wpos=" XOT " len=" XOT "\n", segment_id(sc->dest), wpos, wlen);
-            status = op_failure_status;
-            gop_free(gop, OP_DESTROY);
-            goto finished;
-        }
-        gop_free(gop, OP_DESTROY);
-    } while (rlen > 0);
+    opque_free(q, OP_DESTROY);
 
-    if (sc->truncate == 1) {  //** Truncate if wanted
+    if ((nerr == 0) && (sc->truncate == 1)) {  //** Truncate if wanted
         gop_sync_exec(segment_truncate(sc->dest, sc->da, wpos, sc->timeout));
     }
 
-finished:
-//  status.error_code = rpos;
+    status = (nerr == 0) ? op_success_status : op_failure_status;
+    free(slot);
+    if (foff >= 0) fseeko(sc->fd, foff, SEEK_SET);  //** Leave the file where a read would have
 
     return(status);
 }
@@ -502,10 +691,12 @@ finished:
 
 //***********************************************************************
 // segment_put - Stores data from the given FD into the segment.
+//      The buffer is split into n_bufs slots.  If n_bufs <= 0 then
+//      SEGMENT_COPY_DEFAULT_BUFS is used.
 //      If len == -1 then all available data from src is copied
 //***********************************************************************
 
-op_generic_t *segment_put(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, FILE *fd, segment_t *dest_seg, ex_off_t dest_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int do_truncate, int timeout)
+op_generic_t *segment_put(thread_pool_context_t *tpc, data_attr_t *da, segment_rw_hints_t *rw_hints, FILE *fd, segment_t *dest_seg, ex_off_t dest_offset, ex_off_t len, ex_off_t bufsize, char *buffer, int n_bufs, int do_truncate, int timeout)
 {
     segment_copy_t *sc;
 
@@ -520,8 +711,8 @@ op_generic_t *segment_put(thread_pool_context_t *tpc, data_attr_t *da, segment_r
     sc->len = len;
     sc->bufsize = bufsize;
     sc->buffer = buffer;
+    sc->n_bufs = n_bufs;
     sc->truncate = do_truncate;
 
     return(new_thread_pool_op(tpc, NULL, segment_put_func, (void *)sc, free, 1));
 }
-
@@ -280,6 +280,180 @@ void _cache_wait_for_page(segment_t *seg, int rw_mode, cache_page_t *p)
 }
 
 
+//*******************************************************************************
+// cache_page_table_create - Creates the segment's page table.  The ordered page
+//     list is used for range scans and is protected by the cache lock.  The
+//     shards hash the same pages by offset for point lookups done without it.
+//*******************************************************************************
+
+void cache_page_table_create(cache_segment_t *s, int n_shards, apr_pool_t *mpool)
+{
+    int i;
+
+    if (n_shards < 1) n_shards = 1;
+
+    s->pages = tbx_list_create(0, &skiplist_compare_ex_off, NULL, NULL, NULL);
+    s->n_shards = n_shards;
+    tbx_type_malloc_clear(s->shard, cache_page_shard_t, n_shards);
+    for (i=0; i<n_shards; i++) {
+        apr_thread_mutex_create(&(s->shard[i].lock), APR_THREAD_MUTEX_DEFAULT, mpool);
+        s->shard[i].pages = tbx_list_create(0, &skiplist_compare_ex_off, NULL, NULL, NULL);
+    }
+}
+
+//*******************************************************************************
+// cache_page_table_destroy - Destroys the segment's page table
+//*******************************************************************************
+
+void cache_page_table_destroy(cache_segment_t *s)
+{
+    int i;
+
+    for (i=0; i<s->n_shards; i++) {
+        tbx_list_destroy(s->shard[i].pages);
+        apr_thread_mutex_destroy(s->shard[i].lock);
+    }
+    free(s->shard);
+    s->shard = NULL;
+    s->n_shards = 0;
+
+    tbx_list_destroy(s->pages);
+}
+
+//*******************************************************************************
+// cache_page_table_insert - Adds the page to the table.
+//     NOTE: Assumes the cache lock is held
+//*******************************************************************************
+
+void cache_page_table_insert(cache_segment_t *s, cache_page_t *p)
+{
+    cache_page_shard_t *shard = cache_page_shard(s, p->offset);
+
+    tbx_list_insert(s->pages, &(p->offset), p);
+
+    apr_thread_mutex_lock(shard->lock);
+    tbx_list_insert(shard->pages, &(p->offset), p);
+    apr_thread_mutex_unlock(shard->lock);
+}
+
+//*******************************************************************************
+// cache_page_table_remove - Removes the page from the table.
+//     NOTE: Assumes the cache lock is held
+//*******************************************************************************
+
+void cache_page_table_remove(cache_segment_t *s, cache_page_t *p)
+{
+    cache_page_shard_t *shard = cache_page_shard(s, p->offset);
+
+    apr_thread_mutex_lock(shard->lock);
+    tbx_list_remove(shard->pages, &(p->offset), p);
+    apr_thread_mutex_unlock(shard->lock);
+
+    tbx_list_remove(s->pages, &(p->offset), p);
+}
+
+//*******************************************************************************
+// cache_page_table_remove_idle - Removes the page from the table if no one is
+//     using it and returns 1.  Otherwise the page is left in place, its bits
+//     are adjusted based on mark_mode, and 0 is returned.  The check is done
+//     under the shard lock so it can't race with a lock free pin.
+//     NOTE: Assumes the cache lock is held
+//*******************************************************************************
+
+int cache_page_table_remove_idle(cache_segment_t *s, cache_page_t *p, int mark_mode)
+{
+    cache_page_shard_t *shard = cache_page_shard(s, p->offset);
+    int idle;
+
+    apr_thread_mutex_lock(shard->lock);
+    idle = (cache_page_count(p) == 0) ? 1 : 0;
+    if (idle == 1) {
+        tbx_list_remove(shard->pages, &(p->offset), p);
+    } else if (mark_mode == CACHE_MARK_TORELEASE) {
+        tbx_atomic_or(p->bit_fields, C_TORELEASE);
+    } else if (mark_mode == CACHE_MARK_ONLY_RELEASE) {
+        tbx_atomic_set(p->bit_fields, C_TORELEASE);
+    }
+    apr_thread_mutex_unlock(shard->lock);
+
+    if (idle == 1) tbx_list_remove(s->pages, &(p->offset), p);
+
+    return(idle);
+}
+
+//*******************************************************************************
+// cache_page_table_pin - Acquires a READ reference on the page at poff without
+//     the cache lock.  Only loaded pages that aren't being written or released
+//     can be pinned.  Returns 0 on success and 1 if the page isn't available.
+//*******************************************************************************
+
+int cache_page_table_pin(cache_segment_t *s, ex_off_t poff, page_handle_t *ph)
+{
+    cache_page_shard_t *shard = cache_page_shard(s, poff);
+    cache_page_t *p;
+    int err;
+
+    err = 1;
+    apr_thread_mutex_lock(shard->lock);
+    p = tbx_list_search(shard->pages, (tbx_sl_key_t *)(&poff));
+    if (p != NULL) {
+        if (((tbx_atomic_get(p->bit_fields) & (C_EMPTY|C_TORELEASE)) == 0) &&
+                (tbx_atomic_get(p->access_pending[CACHE_WRITE]) == 0) && (p->curr_data->ptr != NULL)) {
+            tbx_atomic_inc(p->access_pending[CACHE_READ]);
+            ph->p = p;
+            ph->data = p->curr_data;
+            tbx_atomic_inc(ph->data->usage_count);
+            err = 0;
+        }
+    }
+    apr_thread_mutex_unlock(shard->lock);
+
+    return(err);
+}
+
+//*******************************************************************************
+// cache_page_table_swap_data - Makes data[index] the page's current buffer for a
+//     copy-on-write.  It's swapped under the shard lock so a lock free pin
+//     can't capture the buffer while it's being replaced.
+//     NOTE: Assumes the cache lock is held
+//*******************************************************************************
+
+void cache_page_table_swap_data(cache_segment_t *s, cache_page_t *p, int index)
+{
+    cache_page_shard_t *shard = cache_page_shard(s, p->offset);
+
+    apr_thread_mutex_lock(shard->lock);
+    p->current_index = index;
+    p->curr_data = &(p->data[index]);
+    apr_thread_mutex_unlock(shard->lock);
+}
+
+//*******************************************************************************
+// cache_page_table_unpin - Drops a reference acquired with cache_page_table_pin().
+//     If this is the final reference on a page flagged for release or on a
+//     retired COW buffer nothing is changed and 1 is returned.  The caller must
+//     then do a normal cache_release_pages() to finish the cleanup.
+//*******************************************************************************
+
+int cache_page_table_unpin(cache_segment_t *s, page_handle_t *ph)
+{
+    cache_page_t *p = ph->p;
+    cache_page_shard_t *shard = cache_page_shard(s, p->offset);
+    int slow;
+
+    slow = 0;
+    apr_thread_mutex_lock(shard->lock);
+    if (((tbx_atomic_get(p->bit_fields) & C_TORELEASE) > 0) && (cache_page_count(p) == 1)) slow = 1;
+    if ((ph->data != p->curr_data) && (tbx_atomic_get(ph->data->usage_count) == 1)) slow = 1;
+    if (slow == 0) {
+        tbx_atomic_dec(p->access_pending[CACHE_READ]);
+        tbx_atomic_dec(ph->data->usage_count);
+    }
+    apr_thread_mutex_unlock(shard->lock);
+
+    return(slow);
+}
+
 //*******************************************************************************
 // s_cache_page_init - Initializes a cache page for use and addes it to the segment page list
 //*******************************************************************************
@@ -294,9 +468,9 @@ void s_cache_page_init(segment_t *seg, cache_page_t *p, ex_off_t poff)
 //  memset(&(p->cond_pch), 0, sizeof(tbx_pch_t));
     p->used_count = 0;;
 
-    p->bit_fields = C_EMPTY;
+    tbx_atomic_set(p->bit_fields, C_EMPTY);
 
-    tbx_list_insert(s->pages, &(p->offset), p);
+    cache_page_table_insert(s, p);
 
     log_printf(15, "seg=" XIDT " init p->offset=" XOT " cr=%d cw=%d cf=%d bit_fields=%d\n", segment_id(seg),p->offset,
                p->access_pending[CACHE_READ], p->access_pending[CACHE_WRITE], p->access_pending[CACHE_FLUSH], p->bit_fields);
@@ -456,7 +630,7 @@ int cache_rw_pages(segment_t *seg, segment_rw_hints_t *rw_hints, page_handle_t *
         for (i=0; i<blank_count; i++) {
             ph = &(blank_pages[i]);
             if ((ph->p->bit_fields & C_EMPTY) > 0) {
-                ph->p->bit_fields = ph->p->bit_fields ^ C_EMPTY;
+                tbx_atomic_and(ph->p->bit_fields, ~C_EMPTY);
             }
             cache_cond = (cache_cond_t *)tbx_pch_data(&(ph->p->cond_pch));
             if (cache_cond != NULL) {  //** Someone is listening so wake them up
@@ -487,7 +661,7 @@ int cache_rw_pages(segment_t *seg, segment_rw_hints_t *rw_hints, page_handle_t *
             if (rw_mode == CACHE_READ) {
                 for (j=0; j<cio->n_iov; j++) {
                     log_printf(15, "error with read nullifying data p->offset=" XOT "\n", cio->page[j].p->offset);
-                    free(cio->page[j].data->ptr);  //** Errors are signified by data=NULL;
+                    cache_page_buffer_free(s->c, cio->page[j].data->ptr);  //** Errors are signified by data=NULL;
                     error_count++;
                     cio->page[j].data->ptr = NULL;
                 }
@@ -502,7 +676,7 @@ int cache_rw_pages(segment_t *seg, segment_rw_hints_t *rw_hints, page_handle_t *
         if ((rw_mode != CACHE_READ) && (last_page > s->child_last_page)) s->child_last_page = last_page;
         for (j=0; j<cio->n_iov; j++) {
             if ((cio->page[j].p->bit_fields & C_EMPTY) > 0) {
-                cio->page[j].p->bit_fields ^= C_EMPTY;
+                tbx_atomic_and(cio->page[j].p->bit_fields, ~C_EMPTY);
             }
             ph = &(cio->page[j]);
             cache_cond = (cache_cond_t *)tbx_pch_data(&(ph->p->cond_pch));
@@ -554,7 +728,7 @@ cache_page_t  *cache_page_force_get(segment_t *seg, segment_rw_hints_t *rw_hints
         p2 = tbx_list_search(s->pages, (tbx_sl_key_t *)(&off_row));
         if (p2 == NULL) {    //** Not inserted so I do it
             s_cache_page_init(seg, p, off_row);  //** Add the page
-            p->access_pending[rw_mode]++;  //** and mark it for my access mode
+            tbx_atomic_inc(p->access_pending[rw_mode]);  //** and mark it for my access mode
 
             log_printf(15, "seg=" XIDT " rw_mode=%d offset=" XOT ". child_last_page=" XOT "\n", segment_id(seg), rw_mode, p->offset, s->child_last_page);
 
@@ -563,13 +737,13 @@ cache_page_t  *cache_page_force_get(segment_t *seg, segment_rw_hints_t *rw_hints
                     log_printf(15, "seg=" XIDT " CACHE_RW_PAGES rw_mode=%d offset=" XOT ". child_last_page=" XOT "\n", segment_id(seg), rw_mode, p->offset, s->child_last_page);
                     ph.p = p;
                     ph.data = p->curr_data;
-                    p->curr_data->usage_count++;
+                    tbx_atomic_inc(p->curr_data->usage_count);
                     cache_unlock(s->c);  //** Now prep it
                     cache_rw_pages(seg, rw_hints, &ph, 1, CACHE_READ, 0);
                     cache_lock(s->c);
-                    ph.data->usage_count--;
+                    tbx_atomic_dec(ph.data->usage_count);
                 } else {   //** No data on disk yet and if not in memory then it's all zero's so flag it as such
-                    p->bit_fields = 0;
+                    tbx_atomic_set(p->bit_fields, 0);
                 }
             } else if (rw_mode == CACHE_WRITE) {
                 if (full_page_overlap(p->offset, s->page_size, lo, hi) == 0) { //** Determine if I need to load the page
@@ -577,11 +751,11 @@ cache_page_t  *cache_page_force_get(segment_t *seg, segment_rw_hints_t *rw_hints
                         log_printf(15, "seg=" XIDT " CACHE_RW_PAGES rw_mode=%d offset=" XOT ". child_last_page=" XOT "\n", segment_id(seg), rw_mode, p->offset, s->child_last_page);
                         ph.p = p;
                         ph.data = p->curr_data;
-                        p->curr_data->usage_count++;
+                        tbx_atomic_inc(p->curr_data->usage_count);
                         cache_unlock(s->c);  //** Now prep it
                         cache_rw_pages(seg, rw_hints, &ph, 1, CACHE_READ, 0);
                         cache_lock(s->c);
-                        ph.data->usage_count--;
+                        tbx_atomic_dec(ph.data->usage_count);
                     }
                 }
             }
@@ -590,20 +764,20 @@ cache_page_t  *cache_page_force_get(segment_t *seg, segment_rw_hints_t *rw_hints
             p = p2;
             log_printf(15, "cache_page_force_get: seg=" XIDT " offset=" XOT " rw_mode=%d. Already exists so wait for it to become accessible\n", segment_id(seg), poff, rw_mode);
 
-            p->access_pending[CACHE_READ]++;  //** Use a read to hold the page
+            tbx_atomic_inc(p->access_pending[CACHE_READ]);  //** Use a read to hold the page
             _cache_wait_for_page(seg, rw_mode, p);
-            p->access_pending[rw_mode]++;
-            p->access_pending[CACHE_READ]--;
+            tbx_atomic_inc(p->access_pending[rw_mode]);
+            tbx_atomic_dec(p->access_pending[CACHE_READ]);
         }
 
         cache_unlock(s->c); //** Now release  the lock
 
     } else {  //** Page already exists so wait for it to be filled if needed
         log_printf(15, "cache_page_force_get: seg=" XIDT " offset=" XOT " rw_mode=%d. Already exists so wait for it to become free\n", segment_id(seg), poff, rw_mode);
-        p->access_pending[CACHE_READ]++;  //** Use a read to hold the page
+        tbx_atomic_inc(p->access_pending[CACHE_READ]);  //** Use a read to hold the page
         _cache_wait_for_page(seg, rw_mode, p);
-        p->access_pending[rw_mode]++;
-        p->access_pending[CACHE_READ]--;
+        tbx_atomic_inc(p->access_pending[rw_mode]);
+        tbx_atomic_dec(p->access_pending[CACHE_READ]);
 
         cache_unlock(s->c);
     }
@@ -692,7 +866,7 @@ op_status_t cache_advise_fn(void *arg, int id)
                     np->access_pending[ca->rw_mode]++;
                     ca->page[*ca->n_pages].p = np;
                     ca->page[*ca->n_pages].data = np->curr_data;
-                    np->curr_data->usage_count++;
+                    tbx_atomic_inc(np->curr_data->usage_count);
 
                     (*ca->n_pages)++;
                     if (*ca->n_pages >= max_pages) break;
@@ -945,12 +1119,12 @@ int cache_dirty_pages_get(segment_t *seg, int mode, ex_off_t lo, ex_off_t hi, ex
                     cache_cond = (cache_cond_t *)tbx_pch_data(&(p->cond_pch));
                     cache_cond->count = 0;
                 }
-                p->access_pending[CACHE_FLUSH]++;
+                tbx_atomic_inc(p->access_pending[CACHE_FLUSH]);
                 cache_cond->count++;
                 while ((p->access_pending[CACHE_WRITE] > 0) || ((p->bit_fields & C_EMPTY) > 0)) {
                     apr_thread_cond_wait(cache_cond->cond, s->c->lock);
                 }
-                p->access_pending[CACHE_FLUSH]--;
+                tbx_atomic_dec(p->access_pending[CACHE_FLUSH]);
                 cache_cond->count--;
                 if (cache_cond->count <= 0) tbx_pch_release(s->c->cond_coop, &(p->cond_pch));
 
@@ -997,12 +1171,12 @@ int cache_dirty_pages_get(segment_t *seg, int mode, ex_off_t lo, ex_off_t hi, ex
             if ((n < *n_pages) && (p->offset < *hi_got)) {
                 if (skip_mode == 0) {
                     s->c->fn.s_page_access(s->c, p, CACHE_FLUSH, 0);  //** Update page access information
-                    p->access_pending[CACHE_FLUSH]++;
+                    tbx_atomic_inc(p->access_pending[CACHE_FLUSH]);
                     log_printf(15, "PAGE_GET seg=" XIDT " p->offset=" XOT " usage=%d index=%d\n", segment_id(seg), p->offset, p->curr_data->usage_count, p->current_index);
 
                     page[n].p = p;
                     page[n].data = p->curr_data;
-                    p->curr_data->usage_count++;
+                    tbx_atomic_inc(p->curr_data->usage_count);
                     n++;
                     if (n >= *n_pages) err = 1;
                 }
@@ -1048,6 +1222,103 @@ int cache_dirty_pages_get(segment_t *seg, int mode, ex_off_t lo, ex_off_t hi, ex
     return(skip_mode);
 }
 
+//*******************************************************************************
+//  _cache_read_pages_fast - Copies data from the leading run of resident pages
+//     without holding the cache lock during the copy.  The pages are pinned
+//     using the page table shard locks and the cache lock is only taken once
+//     to update the page access info.  Returns the number of pages copied.
+//     If 0 is returned nothing was done and the locked path should be used.
+//*******************************************************************************
+
+int _cache_read_pages_fast(segment_t *seg, ex_off_t lo, ex_off_t hi, ex_off_t *hi_got, page_handle_t *page, int max_pages, tbx_tbuf_t *buf, ex_off_t bpos_start, ex_off_t master_size)
+{
+    cache_segment_t *s = (cache_segment_t *)seg->priv;
+    apr_uint32_t seq[CACHE_MAX_PAGES_RETURNED];
+    char locked[CACHE_MAX_PAGES_RETURNED];
+    ex_off_t coff, hi_row, bpos, ppos, len;
+    cache_page_t *p;
+    tbx_tbuf_t tb;
+    int i, n, n_copy, n_slow, n_locked, torn;
+
+    if (max_pages > CACHE_MAX_PAGES_RETURNED) max_pages = CACHE_MAX_PAGES_RETURNED;
+
+    //** Pin as many consecutive pages as we can
+    coff = (lo / s->page_size) * s->page_size;
+    hi_row = (hi / s->page_size) * s->page_size;
+    n = 0;
+    while ((coff <= hi_row) && (n < max_pages)) {
+        if (cache_page_table_pin(s, coff, &(page[n])) != 0) break;
+        seq[n] = tbx_atomic_get(page[n].p->write_seq);
+        n++;
+        if ((seq[n-1] & 1) == 1) break;  //** A write is in progress so don't bother
+        coff += s->page_size;
+    }
+    n_copy = n;
+    if ((n > 0) && ((seq[n-1] & 1) == 1)) n_copy--;  //** Last page is being written
+
+    //** Copy the data without holding any locks
+    torn = (n_copy == 0) ? 1 : 0;
+    for (i=0; (i<n_copy) && (torn == 0); i++) {
+        p = page[i].p;
+
+        //** Determine the buffer / to page offset
+        if (lo >= p->offset) {
+            ppos = lo - p->offset;
+            bpos = bpos_start;
+        } else {
+            ppos = 0;
+            bpos = bpos_start + p->offset - lo;
+        }
+
+        //** and how much data to move
+        len = s->page_size - ppos;
+        if (hi < p->offset+s->page_size) len = hi - (p->offset+ppos) + 1;
+
+        tbx_tbuf_single(&tb, s->page_size, page[i].data->ptr);
+        tbx_tbuf_copy(&tb, ppos, buf, bpos, len, 1);
+
+        if (tbx_atomic_get(p->write_seq) != seq[i]) torn = 1;  //** Raced with a writer
+    }
+
+    //** Update the page access info.  If the policy can flag a hit lock free
+    //** only the pages it hands back need the short critical section.
+    if (torn == 0) {
+        *hi_got = page[n_copy-1].p->offset + s->page_size - 1;
+        n_locked = 0;
+        for (i=0; i<n_copy; i++) {
+            p = page[i].p;
+            locked[i] = 0;
+            if ((p->bit_fields & C_TORELEASE) != 0) continue;
+            tbx_atomic_inc(p->used_count);
+            if (s->c->fn.s_page_touch != NULL) {
+                locked[i] = s->c->fn.s_page_touch(s->c, p, CACHE_READ, master_size);
+            } else {
+                locked[i] = 1;
+            }
+            n_locked += locked[i];
+        }
+
+        if (n_locked > 0) {
+            cache_lock(s->c);
+            for (i=0; i<n_copy; i++) {
+                if (locked[i] == 1) s->c->fn.s_page_access(s->c, page[i].p, CACHE_READ, master_size);
+            }
+            cache_unlock(s->c);
+        }
+    }
+
+    //** and drop the pins.  Anything that needs cleaning up goes through the normal release
+    n_slow = 0;
+    for (i=0; i<n; i++) {
+        if (cache_page_table_unpin(s, &(page[i])) != 0) page[n_slow++] = page[i];
+    }
+    if (n_slow > 0) cache_release_pages(n_slow, page, CACHE_READ);
+
+    log_printf(15, "seg=" XIDT " lo=" XOT " hi=" XOT " n=%d n_copy=%d torn=%d n_slow=%d\n", segment_id(seg), lo, hi, n, n_copy, torn, n_slow);
+
+    return((torn == 0) ? n_copy : 0);
+}
+
 //*******************************************************************************
 //  cache_read_pages_get - Retrieves pages from cache for READING over the given range
 //*******************************************************************************
@@ -1070,6 +1341,13 @@ int cache_read_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode,
     max_pages = *n_pages;
     *n_pages = 0;
     log_printf(15, "START seg=" XIDT " mode=%d lo=" XOT " hi=" XOT " lo_row=" XOT " hi_row=" XOT "\n", segment_id(seg), mode, lo, hi, lo_row, hi_row);
+
+    //** Try and handle the leading resident pages without the cache lock
+    if (_cache_read_pages_fast(seg, lo, hi, hi_got, page, max_pages, buf, bpos_start, master_size) > 0) {
+        if (*hi_got > hi) *hi_got = hi;
+        return(0);
+    }
+
     cache_lock(s->c);
 
     //** Get the 1st point and figure out the if we are skipping or getting pages
@@ -1100,9 +1378,9 @@ int cache_read_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode,
             }
 
             if ((mode == CACHE_DOBLOCK) && (skip_mode == 1)) { //** Got to wait until I can acquire a lock
-                p->access_pending[CACHE_READ]++;
+                tbx_atomic_inc(p->access_pending[CACHE_READ]);
                 _cache_wait_for_page(seg, CACHE_READ, p);
-                p->access_pending[CACHE_READ]--;
+                tbx_atomic_dec(p->access_pending[CACHE_READ]);
                 skip_mode = 0;
 
                 //** Need to reset iterator due to potential changes while waiting
@@ -1141,8 +1419,8 @@ int cache_read_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode,
 
             if (err == 0) {
                 if (skip_mode == 0) {
-                    p->used_count++;
-                    p->curr_data->usage_count++;
+                    tbx_atomic_inc(p->used_count);
+                    tbx_atomic_inc(p->curr_data->usage_count);
                     s->c->fn.s_page_access(s->c, p, CACHE_READ, master_size);  //** Update page access information
 
                     //** Determine the buffer / to page offset
@@ -1208,7 +1486,7 @@ int cache_read_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode,
                 cache_lock(s->c);
                 page[0].p = p;
                 page[0].data = p->curr_data;
-                p->curr_data->usage_count++;
+                tbx_atomic_inc(p->curr_data->usage_count);
                 cache_unlock(s->c);
                 iov[0].iov_base = page[0].data->ptr;
                 iov[0].iov_len = s->page_size;
@@ -1289,7 +1567,7 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
         if (pstart > hi) pstart = hi;
         coff = lo_row;
 
-        if (pcheck.p != NULL) pcheck.p->access_pending[CACHE_READ]++;  //** Tag it so it doesn't get removed
+        if (pcheck.p != NULL) tbx_atomic_inc(pcheck.p->access_pending[CACHE_READ]);  //** Tag it so it doesn't get removed
 
         np = s->c->fn.create_empty_page(s->c, seg, 0);  //** Get the empty page  if possible
         while ((np != NULL) && (coff < pstart)) {
@@ -1302,22 +1580,22 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
                         pload[pload_count].p = np;
                         pload[pload_count].data = np->curr_data;
                         pload_iov_index[pload_count] = n;
-                        np->access_pending[CACHE_WRITE]++;
+                        tbx_atomic_inc(np->access_pending[CACHE_WRITE]);
                         pload_count++;
                         ok = 0;
                     }
                 }
 
-                np->used_count++;
+                tbx_atomic_inc(np->used_count);
                 s->c->fn.s_page_access(s->c, np, CACHE_WRITE, master_size);  //** Update page access information
-                np->bit_fields |= C_ISDIRTY;
+                tbx_atomic_or(np->bit_fields, C_ISDIRTY);
                 s->c->fn.adjust_dirty(s->c, s->page_size);
 
-                np->curr_data->usage_count++;
+                tbx_atomic_inc(np->curr_data->usage_count);
 
                 //** Determine the buffer / to page offset
                 if (ok == 1) {
-                    if (np->bit_fields & C_EMPTY) np->bit_fields ^= C_EMPTY;  //** not loading so clear the empty bit
+                    if (np->bit_fields & C_EMPTY) tbx_atomic_and(np->bit_fields, ~C_EMPTY);  //** not loading so clear the empty bit
 
                     if (lo >= np->offset) {
                         ppos = lo - np->offset;
@@ -1381,9 +1659,9 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
 
             if ((mode == CACHE_DOBLOCK) && (skip_mode == 1)) { //** Got to wait until I can acquire a lock
                 log_printf(15, "seg=" XIDT " waiting for p->offset=" XOT " lo=" XOT " hi=" XOT " skip_mode=%d\n", segment_id(seg), p->offset, lo, hi, skip_mode);
-                p->access_pending[CACHE_READ]++;  //** Use a read to hold the page
+                tbx_atomic_inc(p->access_pending[CACHE_READ]);  //** Use a read to hold the page
                 _cache_wait_for_page(seg, CACHE_WRITE, p);
-                p->access_pending[CACHE_READ]--;
+                tbx_atomic_dec(p->access_pending[CACHE_READ]);
 
                 skip_mode = 0;
 
@@ -1409,10 +1687,9 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
                         i = (p->current_index+1) % 2;
                         if (p->data[i].ptr == NULL) {  //** We can use the COW space
                             s->c->write_temp_overflow_used += s->page_size;
-                            tbx_type_malloc(p->data[i].ptr, char, s->page_size);
+                            p->data[i].ptr = cache_page_buffer_new(s->c, s->page_size, 0);
                             memcpy(p->data[i].ptr, p->data[p->current_index].ptr, s->page_size);
-                            p->current_index = i;
-                            p->curr_data = &(p->data[i]);
+                            cache_page_table_swap_data(s, p, i);
                             can_get = 1;
 //log_printf(0, "seg=" XIDT " p->offset=" XOT " COP triggered used=" XOT " usage=%d\n", segment_id(seg), p->offset, s->c->write_temp_overflow_used, p->curr_data->usage_count);
 //flush_skip = 0;
@@ -1442,17 +1719,17 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
             if (err == 0) {
                 if (skip_mode == 0) {
                     if (p == pcheck.p) { //** Actually using the page so no need to do the release
-                        pcheck.p->access_pending[CACHE_READ]--;
+                        tbx_atomic_dec(pcheck.p->access_pending[CACHE_READ]);
                         pcheck.p = NULL;
                     }
 
-                    p->used_count++;
+                    tbx_atomic_inc(p->used_count);
                     s->c->fn.s_page_access(s->c, p, CACHE_WRITE, master_size);  //** Update page access information
-                    p->curr_data->usage_count++;
+                    tbx_atomic_inc(p->curr_data->usage_count);
 
-                    if (p->bit_fields & C_EMPTY) p->bit_fields ^= C_EMPTY;
+                    if (p->bit_fields & C_EMPTY) tbx_atomic_and(p->bit_fields, ~C_EMPTY);
                     if ((p->bit_fields & C_ISDIRTY) == 0) {
-                        p->bit_fields |= C_ISDIRTY;
+                        tbx_atomic_or(p->bit_fields, C_ISDIRTY);
                         s->c->fn.adjust_dirty(s->c, s->page_size);
                     }
 
@@ -1469,9 +1746,11 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
                     len = s->page_size - ppos;
                     if (hi < p->offset+s->page_size) len = hi - (p->offset+ppos) + 1;
 
-                    //** Set the page transfer buffer size
+                    //** Set the page transfer buffer size.  The sequence bump lets lock free readers detect the overwrite
+                    tbx_atomic_inc(p->write_seq);
                     tbx_tbuf_single(&tb, s->page_size, p->curr_data->ptr);
                     tbx_tbuf_copy(buf, bpos, &tb, ppos, len, 1);
+                    tbx_atomic_inc(p->write_seq);
 
                     log_printf(15, "seg=" XIDT " adding page[" XOT "]->offset=" XOT "\n", segment_id(seg), n, p->offset);
                     log_printf(15, "PAGE_GET seg=" XIDT " get p->offset=" XOT " n=%" PRId64 " cr=%d cw=%d cf=%d bit_fields=%d usage=%d index=%d\n", segment_id(seg), p->offset, n,
@@ -1490,7 +1769,7 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
                         if (pstart > hi) pstart = hi;
                         pcheck.p = p;  //** TRack it
                         pcheck.data = p->curr_data;
-                        pcheck.p->access_pending[CACHE_READ]++;  //** Tag it so it doesn't disappear
+                        tbx_atomic_inc(pcheck.p->access_pending[CACHE_READ]);  //** Tag it so it doesn't disappear
                         np = NULL;
 
                         log_printf(15, "seg=" XIDT " before blank loop coff=" XOT " pstart=" XOT "\n", segment_id(seg), coff, pstart);
@@ -1505,23 +1784,23 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
                                         pload[pload_count].p = np;
                                         pload[pload_count].data = np->curr_data;
                                         pload_iov_index[pload_count] = n;
-                                        np->access_pending[CACHE_WRITE]++;
+                                        tbx_atomic_inc(np->access_pending[CACHE_WRITE]);
                                         pload_count++;
                                         ok = 0;
                                     }
                                 }
 
-                                np->used_count++;
+                                tbx_atomic_inc(np->used_count);
                                 s->c->fn.s_page_access(s->c, np, CACHE_WRITE, master_size);  //** Update page access information
-                                np->curr_data->usage_count++;
+                                tbx_atomic_inc(np->curr_data->usage_count);
                                 if ((np->bit_fields & C_ISDIRTY) == 0) {
-                                    np->bit_fields |= C_ISDIRTY;
+                                    tbx_atomic_or(np->bit_fields, C_ISDIRTY);
                                     s->c->fn.adjust_dirty(s->c, s->page_size);
                                 }
 
                                 //** Determine the buffer / to page offset
                                 if (ok == 1) {
-                                    if (np->bit_fields & C_EMPTY) np->bit_fields ^= C_EMPTY;  //** not loading so clear the empty bit
+                                    if (np->bit_fields & C_EMPTY) tbx_atomic_and(np->bit_fields, ~C_EMPTY);  //** not loading so clear the empty bit
 
                                     if (lo >= np->offset) {
                                         ppos = lo - np->offset;
@@ -1536,8 +1815,10 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
                                     if (hi < np->offset+s->page_size) len = hi - (np->offset+ppos) + 1;
 
                                     //** Set the page transfer buffer size
+                                    tbx_atomic_inc(np->write_seq);
                                     tbx_tbuf_single(&tb, s->page_size, np->curr_data->ptr);
                                     tbx_tbuf_copy(buf, bpos, &tb, ppos, len, 1);
+                                    tbx_atomic_inc(np->write_seq);
                                 }
 
                                 *hi_got = coff + s->page_size - 1;
@@ -1576,7 +1857,7 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
 
     //** See if we need to do a formal release on the check page
     if (pcheck.p != NULL) {
-        pcheck.data->usage_count++;
+        tbx_atomic_inc(pcheck.data->usage_count);
         cache_unlock(s->c);
 
         cache_release_pages(1, &pcheck, CACHE_READ);
@@ -1594,7 +1875,7 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
             cache_lock(s->c);
             pload[0].p = p;
             pload[0].data = p->curr_data;
-            p->curr_data->usage_count++;
+            tbx_atomic_inc(p->curr_data->usage_count);
             cache_unlock(s->c);
 
             iov[0].iov_base = pload[0].data->ptr;
@@ -1618,10 +1899,10 @@ int cache_write_pages_get(segment_t *seg, segment_rw_hints_t *rw_hints, int mode
         cache_lock(s->c);
         for (i=0; i<pload_count; i++) { //** This stuff requires a lock
             p = pload[i].p;
-            p->used_count++;
+            tbx_atomic_inc(p->used_count);
             s->c->fn.s_page_access(s->c, p, CACHE_WRITE, master_size);  //** Update page access information
 
-            p->curr_data->usage_count++;  //** NOTE don't have to update the bit_fields cause it's done in cache_release_pages()
+            tbx_atomic_inc(p->curr_data->usage_count);  //** NOTE don't have to update the bit_fields cause it's done in cache_release_pages()
         }
         cache_unlock(s->c);
 
@@ -1672,6 +1953,7 @@ int cache_release_pages(int n_pages, page_handle_t *page_list, int rw_mode)
 {
     segment_t *seg = page_list[0].p->seg;
     cache_segment_t *s = (cache_segment_t *)seg->priv;
+    cache_page_shard_t *shard;
     cache_page_t *page;
     cache_cond_t *cache_cond;
     int count, i, cow_hit;
@@ -1686,9 +1968,12 @@ int cache_release_pages(int n_pages, page_handle_t *page_list, int rw_mode)
 
     for (i=0; i<n_pages; i++) {
         page = page_list[i].p;
+        shard = cache_page_shard(s, page->offset);
 
-        page->access_pending[rw_mode]--;
-        page_list[i].data->usage_count--;
+        //** The counts and COW buffers are shared with the lock free readers
+        apr_thread_mutex_lock(shard->lock);
+        tbx_atomic_dec(page->access_pending[rw_mode]);
+        tbx_atomic_dec(page_list[i].data->usage_count);
 
         log_printf(15, "seg=" XIDT " initial rw_mode=%d p->offset=" XOT " cr=%d cw=%d cf=%d bit_fields=%d usage=%d index=%d\n", segment_id(seg), rw_mode, page->offset,
                    page->access_pending[CACHE_READ], page->access_pending[CACHE_WRITE], page->access_pending[CACHE_FLUSH], page->bit_fields, page_list[i].data->usage_count, page->current_index);
@@ -1697,24 +1982,25 @@ int cache_release_pages(int n_pages, page_handle_t *page_list, int rw_mode)
         if (page_list[i].data != page->curr_data) {
             cow_hit = 1;
             if (page_list[i].data->usage_count <= 0) {  //** Clean up a COW
-                free(page_list[i].data->ptr);
+                cache_page_buffer_free(s->c, page_list[i].data->ptr);
                 page_list[i].data->ptr = NULL;
                 s->c->write_temp_overflow_used -= s->page_size;
                 log_printf(15, "seg=" XIDT " p->offset=" XOT " COP cleanup used=" XOT " rw_mode=%d usage=%d\n", segment_id(seg), page->offset, s->c->write_temp_overflow_used, rw_mode, page_list[i].data->usage_count);
                 tbx_log_flush();
             }
         }
+        apr_thread_mutex_unlock(shard->lock);
 
         if (rw_mode == CACHE_WRITE) {  //** Write release
-            if (page->bit_fields & C_EMPTY) page->bit_fields ^= C_EMPTY;
+            if (page->bit_fields & C_EMPTY) tbx_atomic_and(page->bit_fields, ~C_EMPTY);
             if ((page->bit_fields & C_ISDIRTY) == 0) {
                 s->c->fn.adjust_dirty(s->c, s->page_size);
-                page->bit_fields |= C_ISDIRTY;
+                tbx_atomic_or(page->bit_fields, C_ISDIRTY);
             }
         } else if (rw_mode == CACHE_FLUSH) {  //** Flush release so tweak dirty page info
             if (cow_hit == 0) {
                 s->c->fn.adjust_dirty(s->c, -s->page_size);
-                page->bit_fields ^= C_ISDIRTY;
+                tbx_atomic_and(page->bit_fields, ~C_ISDIRTY);
             }
         }
 
@@ -1726,7 +2012,9 @@ int cache_release_pages(int n_pages, page_handle_t *page_list, int rw_mode)
             apr_thread_cond_broadcast(cache_cond->cond);
         } else {
             if ((page->bit_fields & C_TORELEASE) > 0) {
-                count = page->access_pending[CACHE_READ] + page->access_pending[CACHE_WRITE] + page->access_pending[CACHE_FLUSH];
+                apr_thread_mutex_lock(shard->lock);
+                count = cache_page_count(page);
+                apr_thread_mutex_unlock(shard->lock);
                 if (count == 0) {
                     //** page->data is an array so the 2nd bool is always false.
                     //** leaving the old code as a comment: if (((page->bit_fields & C_ISDIRTY) == 0) || (page->data == NULL)) {
@@ -2596,7 +2884,9 @@ op_status_t cache_rw_func(void *arg, int id)
                            curr->lo, curr->hi, cop->rw_mode, pstart, poff, bpos, blen);
 
                 if (cop->rw_mode == CACHE_WRITE) {
+                    for (i=0; i<n_pages; i++) tbx_atomic_inc(page[i].p->write_seq);  //** Let any lock free readers know the data is changing
                     tb_err += tbx_tbuf_copy(cop->buf, bpos, &tb, poff, blen, 1);
+                    for (i=0; i<n_pages; i++) tbx_atomic_inc(page[i].p->write_seq);
                     segment_lock(seg);  //** Tweak the size if needed
                     if (curr->hi > s->total_size) {
                         log_printf(0, "seg=" XIDT " total_size=" XOT " curr->hi=" XOT "\n", segment_id(cop->seg), s->total_size, curr->hi);
@@ -2943,6 +3233,7 @@ int cache_stats(cache_t *c, cache_stats_t *cs)
     cache_lock(c);
 
     *cs = c->stats;
+    if (c->arena != NULL) cache_arena_set_stats(c->arena, cs);
 //log_printf(0, "core hit=" XOT "\n", cs->hit_bytes);
 //log_printf(0, "core miss=" XOT "\n", cs->miss_bytes);
 
@@ -3037,6 +3328,14 @@ int cache_stats_print(cache_stats_t *cs, char *buffer, int *used, int nmax)
     d3 = cs->dirty_bytes * 1.0 / (1024.0*1024.0*1024.0);
     n += tbx_append_printf(buffer, used, nmax, "Dirty: " XOT " bytes (%lf GiB)\n", cs->dirty_bytes, d3);
 
+    if (cs->arena_bytes > 0) {
+        d1 = (100.0*cs->arena_used_bytes) / cs->arena_bytes;
+        d2 = (cs->arena_resident_bytes > 0) ? (100.0*(cs->arena_resident_bytes - cs->arena_used_bytes)) / cs->arena_resident_bytes : 0;
+        d3 = cs->arena_resident_bytes * 1.0 / (1024.0*1024.0*1024.0);
+        n += tbx_append_printf(buffer, used, nmax, "Arena: " XOT " bytes used of " XOT " (%lf%% occupancy) Resident: " XOT " bytes (%lf GiB) (%lf%% fragmentation)\n",
+                               cs->arena_used_bytes, cs->arena_bytes, d1, cs->arena_resident_bytes, d3, d2);
+    }
+
     return(n);
 }
 
@@ -3188,6 +3487,19 @@ int segcache_signature(segment_t *seg, char *buffer, int *used, int bufsize)
     return(segment_signature(s->child_seg, buffer, used, bufsize));
 }
 
+//***********************************************************************
+// segcache_extents - The cache doesn't hold the data so pass it to the child.
+//     NOTE: Any dirty pages should be flushed first.  Anyone writing to the
+//     extents directly must also drop the cached pages with cache_drop_pages().
+//***********************************************************************
+
+int segcache_extents(segment_t *seg, ex_off_t lo, ex_off_t hi, tbx_stack_t *stack)
+{
+    cache_segment_t *s = (cache_segment_t *)seg->priv;
+
+    return(segment_extents(s->child_seg, lo, hi, stack));
+}
+
 //***********************************************************************
 // segcache_clone - Clones a segment
 //***********************************************************************
@@ -3551,7 +3863,7 @@ void segcache_destroy(segment_t *seg)
     log_printf(5, "seg=" XIDT " Starting segment destruction\n", segment_id(seg));
 
     //** Clean up the list
-    tbx_list_destroy(s->pages);
+    cache_page_table_destroy(s);
     tbx_list_destroy(s->partial_pages);
 
     //** Destroy the child segment as well
@@ -3609,13 +3921,12 @@ segment_t *segment_cache_create(void *arg)
     s->tpc_unlimited = lookup_service(es, ESS_RUNNING, ESS_TPC_CACHE);
     assert(s->tpc_unlimited != NULL);
 
-    s->pages = tbx_list_create(0, &skiplist_compare_ex_off, NULL, NULL, NULL);
-
     s->ppages_unused = tbx_stack_new();
     s->partial_pages = tbx_list_create(0, &skiplist_compare_ex_off, NULL, NULL, NULL);
 
     s->c = lookup_service(es, ESS_RUNNING, ESS_CACHE);
     if (s->c != NULL) s->c = cache_get_handle(s->c);
+    cache_page_table_create(s, ((s->c != NULL) ? s->c->n_page_shards : CACHE_PAGE_SHARDS), seg->mpool);
     s->page_size = 64*1024;
     s->n_ppages = 0;
 
@@ -3643,6 +3954,7 @@ segment_t *segment_cache_create(void *arg)
     seg->fn.serialize = segcache_serialize;
     seg->fn.deserialize = segcache_deserialize;
     seg->fn.destroy = segcache_destroy;
+    seg->fn.extents = segcache_extents;
 
     if (s->c != NULL) { //** If no cache backend skip this  only used for temporary deseril/serial
         cache_lock(s->c);
@@ -21,7 +21,12 @@
 #define _log_module_index 162
 
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 #include <libgen.h>
 #include "ex3_abstract.h"
 #include "ex3_system.h"
@@ -77,9 +82,11 @@ op_status_t segfile_rw_func(void *arg, int id)
     segfile_rw_op_t *srw = (segfile_rw_op_t *)arg;
     segfile_priv_t *s = (segfile_priv_t *)srw->seg->priv;
     ex_off_t bleft, boff;
-    size_t nbytes, blen;
+    ssize_t nbytes;
+    size_t blen;
     tbx_tbuf_var_t tbv;
-    int i, err_cnt;
+    off_t soff;
+    int i, err_cnt, fd, sfd;
     op_status_t err;
 
 //    double r;
@@ -92,8 +99,13 @@ op_status_t segfile_rw_func(void *arg, int id)
 //    }
 //--}
 
-    FILE *fd = fopen(s->fname, "r+");
-    if (fd == NULL) fd = fopen(s->fname, "w+");
+    fd = open(s->fname, O_RDWR|O_CREAT, 0666);
+    if (fd == -1) {
+        log_printf(0, "ERROR opening fname=%s errno=%d\n", s->fname, errno);
+        tbx_atomic_inc(s->hard_errors);
+        if (srw->mode != 0) tbx_atomic_inc(s->write_errors);
+        return(op_failure_status);
+    }
 
     log_printf(15, "segfile_rw_func: tid=%d fname=%s n_iov=%d off[0]=" XOT " len[0]=" XOT " mode=%d\n", tbx_atomic_thread_id, s->fname, srw->n_iov, srw->iov[0].offset, srw->iov[0].len, srw->mode);
     tbx_log_flush();
@@ -104,18 +116,25 @@ op_status_t segfile_rw_func(void *arg, int id)
     bleft = blen;
     err_cnt = 0;
     for (i=0; i<srw->n_iov; i++) {
-        fseeko(fd, srw->iov[i].offset, SEEK_SET);
+        lseek(fd, srw->iov[i].offset, SEEK_SET);
         bleft = srw->iov[i].len;
         err = op_success_status;
         while ((bleft > 0) && (err.op_status == OP_STATE_SUCCESS)) {
             tbv.nbytes = bleft;
-            tbx_tbuf_next(srw->buffer, boff, &tbv);
-            blen = tbv.nbytes;
             if (srw->mode == 0) {
-                nbytes = readv(fileno(fd), tbv.buffer, tbv.n_iov);
+                tbx_tbuf_next(srw->buffer, boff, &tbv);
+                nbytes = readv(fd, tbv.buffer, tbv.n_iov);
+#ifdef __linux__
+            } else if ((tbx_tbuf_next_layout(srw->buffer, boff, &tbv) == TBUFFER_OK) &&
+                       (tbx_tbuf_fd_lookup(srw->buffer, tbv.buffer[0].iov_base, tbv.buffer[0].iov_len, &sfd, &soff) == 0)) {
+                nbytes = sendfile(fd, sfd, &soff, tbv.buffer[0].iov_len);  //** Source is a file range so skip the user space copy
+#endif
             } else {
-                nbytes = writev(fileno(fd), tbv.buffer, tbv.n_iov);
+                tbv.nbytes = bleft;
+                tbx_tbuf_next(srw->buffer, boff, &tbv);
+                nbytes = writev(fd, tbv.buffer, tbv.n_iov);
             }
+            blen = tbv.nbytes;
 
             int ib = blen;
             int inb = nbytes;
@@ -143,7 +162,7 @@ op_status_t segfile_rw_func(void *arg, int id)
     log_printf(15, "segfile_rw_func: tid=%d fname=%s n_iov=%d off[0]=" XOT " len[0]=" XOT " bleft=" XOT " err_cnt=%d\n", tbx_atomic_thread_id, s->fname, srw->n_iov, srw->iov[0].offset, srw->iov[0].len, bleft, err_cnt);
     tbx_log_flush();
 //log_printf(15, "segfile_rw_func: buf=%20s\n", (char *)srw->buffer->buf.iov[0].iov_base);
-    fclose(fd);
+    close(fd);
     return(err);
 }
 
@@ -50,6 +50,8 @@ typedef struct {
     thread_pool_context_t *tpc;
     blacklist_t *blacklist;
     ex_off_t max_parity;
+    ex_off_t encode_batch;      //** Data bytes encoded per batch on writes
+    int encode_threads;         //** Max batches encoding at once.  0 encodes inline
     int write_errors;
     int soft_errors;
     int hard_errors;
@@ -88,6 +90,18 @@ typedef struct {
     int nstripes;
 } segjerase_io_t;
 
+typedef struct {    //** Batch of stripes that are encoded and written together
+    segjerase_priv_t *s;
+    char **ptr;
+    char *magic;
+    ex_off_t boff;
+    ex_tbx_iovec_t ex_iov;
+    tbx_tbuf_t tbuf;
+    segment_rw_hints_t rw_hints;
+    int iov_index;
+    int nstripes;
+} segjerase_batch_t;
+
 typedef struct {
     segment_t *seg;
     data_attr_t *da;
@@ -1464,8 +1478,47 @@ tryagain:  //** We first try allowing blacklisting to proceed as normal and then
     return(status);
 }
 
+//***********************************************************************
+//  segjerase_encode_func - Encodes a batch of stripes and calculates their magic
+//***********************************************************************
+
+op_status_t segjerase_encode_func(void *arg, int id)
+{
+    segjerase_batch_t *bt = (segjerase_batch_t *)arg;
+    segjerase_priv_t *s = bt->s;
+    char **ptr;
+    int i;
+
+    for (i=0; i<bt->nstripes; i++) {
+        ptr = &(bt->ptr[i*s->n_devs]);
+        s->plan->encode_block(s->plan, ptr, s->chunk_size);
+        je_cksum_calc(&(bt->magic[i*JE_MAGIC_SIZE]), ptr, s->n_devs, s->chunk_size);
+    }
+
+    return(op_success_status);
+}
+
+//***********************************************************************
+//  _segjerase_write_batch - Sends an encoded batch to the child segment
+//***********************************************************************
+
+void _segjerase_write_batch(segjerase_rw_t *sw, segjerase_batch_t *bt, int b, opque_t *q)
+{
+    segjerase_priv_t *s = bt->s;
+    op_generic_t *gop;
+
+    gop = segment_write(s->child_seg, sw->da, &(bt->rw_hints), 1, &(bt->ex_iov), &(bt->tbuf), 0, sw->timeout);
+    gop_set_myid(gop, b);
+    opque_add(q, gop);
+    opque_start_execution(q);  //** Send it now instead of waiting for the flush
+}
+
 //***********************************************************************
 //  segjerase_write_func - Writes the stripes
+//    The request is split into batches of stripes.  Each batch is encoded
+//    on the thread pool and written as soon as its parity is ready so the
+//    encoding of later batches overlaps the writes of earlier ones.
+//
 //    NOTE: 1) Assumes only 1 writer/stripe!  Otherwise you get a race condition.
 //          2) Assumes a single iov/stripe
 //          These should be enfoced automatically if called from the segment_cache driver
@@ -1476,25 +1529,33 @@ op_status_t segjerase_write_func(void *arg, int id)
     segjerase_rw_t *sw = (segjerase_rw_t *)arg;
     segjerase_priv_t *s = (segjerase_priv_t *)sw->seg->priv;
     op_status_t status, op_status;
-    ex_off_t lo, boff, poff, len, parity_len, parity_used, curr_bytes;
-    int i, j, k, n_iov, nstripes, curr_stripe, pstripe, iov_start;
+    ex_off_t boff, poff, len, parity_len, parity_used;
+    int i, j, k, b, n_iov, nstripes, curr_stripe, pstripe, iov_start;
+    int n_batch, batch_stripes, n_encoding;
     int soft_error, hard_error;
     char *parity, *magic, **ptr, *stripe_magic, *empty;
-    opque_t *q;
+    opque_t *q, *eq;
     op_generic_t *gop;
-    ex_tbx_iovec_t *ex_iov;
-    tbx_tbuf_t *tbuf;
+    segjerase_batch_t *batch, *bt;
     tbx_iovec_t *iov;
-    segment_rw_hints_t *rw_hints;
     tbx_tbuf_var_t tbv;
     int loop;
 
     loop = 0;
 
+    //** Figure out how many batches we have
+    batch_stripes = s->encode_batch / s->data_size;
+    if (batch_stripes <= 0) batch_stripes = 1;
+    n_batch = 0;
+    for (i=0; i < sw->n_iov; i++) {
+        nstripes = sw->iov[i].len / s->data_size;
+        n_batch += (nstripes + batch_stripes - 1) / batch_stripes;
+    }
+
 tryagain: //** In case blacklisting failed we'll retry with it disabled
 
     q = new_opque();
-//  opque_start_execution(q);
+    eq = new_opque();
     tbx_tbuf_var_init(&tbv);
     status = op_success_status;
     soft_error = 0;
@@ -1504,15 +1565,10 @@ tryagain: //** In case blacklisting failed we'll retry with it disabled
     parity_len = sw->nstripes * s->parity_size;
     if (s->max_parity < parity_len) {
         parity_len = s->max_parity;
-        for (i=0; i < sw->n_iov; i++) {
-            len = sw->iov[i].len;
-            nstripes = len / s->data_size;
-            j = nstripes*s->parity_size;
-            if (j > parity_len) parity_len = j;
-        }
-
-        if (parity_len > s->max_parity) {
-            log_printf(1, "Parity to small.  Growing to parity_len=" XOT " s->max_parity=" XOT "\n", parity_len, s->max_parity);
+        j = ((sw->nstripes < batch_stripes) ? sw->nstripes : batch_stripes) * s->parity_size;
+        if (j > parity_len) {
+            log_printf(1, "Parity to small.  Growing to parity_len=%d s->max_parity=" XOT "\n", j, s->max_parity);
+            parity_len = j;
         }
     }
     tbx_type_malloc(parity, char, parity_len + s->chunk_size);
@@ -1520,17 +1576,14 @@ tryagain: //** In case blacklisting failed we'll retry with it disabled
 
     tbx_type_malloc_clear(magic, char, JE_MAGIC_SIZE*sw->nstripes);
     tbx_type_malloc(ptr, char *, sw->nstripes*s->n_devs);
-    tbx_type_malloc(ex_iov, ex_tbx_iovec_t, sw->n_iov);
     tbx_type_malloc(iov, tbx_iovec_t, 2*sw->nstripes*s->n_devs);
-    tbx_type_malloc(tbuf, tbx_tbuf_t, sw->n_iov);
-    tbx_type_malloc_clear(rw_hints, segment_rw_hints_t, sw->n_iov);
-
+    tbx_type_malloc_clear(batch, segjerase_batch_t, n_batch);
 
     //** Set up the blacklist structure
     if (sw->rw_hints == NULL) {
         k = (loop == 0) ? s->n_parity_devs : 0;
     } else {
-        log_printf(0, "rw_hints->lun_max_blacklist=%d loop=%d\n", rw_hints->lun_max_blacklist, loop);
+        log_printf(0, "rw_hints->lun_max_blacklist=%d loop=%d\n", sw->rw_hints->lun_max_blacklist, loop);
 
         if (loop == 0) {
             k = (sw->rw_hints->lun_max_blacklist > s->n_parity_devs) ? s->n_parity_devs : sw->rw_hints->lun_max_blacklist;
@@ -1540,28 +1593,43 @@ tryagain: //** In case blacklisting failed we'll retry with it disabled
     }
 //----if (k > 0) k++;  //** This will force a failure and retry
 
-    for (i=0; i<sw->n_iov; i++) rw_hints[i].lun_max_blacklist = k;
+    //** Carve up the iovs into batches
+    b = 0;
+    for (i=0; i<sw->n_iov; i++) {
+        nstripes = sw->iov[i].len / s->data_size;
+        boff = sw->boff;
+        for (j=0; j<i; j++) boff += sw->iov[j].len;
+        for (j=0; j<nstripes; j += batch_stripes) {
+            bt = &(batch[b]);
+            bt->s = s;
+            bt->iov_index = i;
+            bt->nstripes = ((nstripes - j) > batch_stripes) ? batch_stripes : nstripes - j;
+            bt->boff = boff + (ex_off_t)j * s->data_size;
+            bt->ex_iov.offset = (sw->iov[i].offset / s->data_size + j) * s->stripe_size_with_magic;
+            bt->ex_iov.len = (ex_off_t)bt->nstripes * s->stripe_size_with_magic;
+            bt->rw_hints.lun_max_blacklist = k;
+            b++;
+        }
+    }
 
-    //** Cycle through the tasks
+    //** Cycle through the batches
     parity_used = 0;
     curr_stripe = 0;
     pstripe = 0;
     n_iov = 0;
-    curr_bytes = 0;
-    for (i=0; i<=sw->n_iov; i++) {
-        if (i<sw->n_iov) {  //** Kludgy check so we don't have to copy the waitany code twice
-            lo = sw->iov[i].offset / s->data_size;
-            lo = lo * s->stripe_size_with_magic;
-            len = sw->iov[i].len;
-            nstripes = len / s->data_size;
-            j = nstripes*s->parity_size;
-        } else {
-            j = 0;
-        }
+    n_encoding = 0;
+    for (b=0; b<=n_batch; b++) {
+        j = (b<n_batch) ? batch[b].nstripes*s->parity_size : 0;
+
+        if (((j+parity_used) > parity_len) || (b==n_batch)) {  //** Filled the buffer so wait for the current tasks to complete
+            while ((gop = opque_waitany(eq)) != NULL) {  //** Flush out the encodes still in progress
+                _segjerase_write_batch(sw, &(batch[gop_get_myid(gop)]), gop_get_myid(gop), q);
+                gop_free(gop, OP_DESTROY);
+            }
+            n_encoding = 0;
 
-        if (((j+parity_used) > parity_len) || (i==sw->n_iov)) {  //** Filled the buffer so wait for the current tasks to complete
             while ((gop = opque_waitany(q)) != NULL) {
-                j = gop_get_myid(gop);
+                j = batch[gop_get_myid(gop)].iov_index;
                 if (gop_completed_successfully(gop) != OP_STATE_SUCCESS) {
                     op_status = gop_get_status(gop);
                     if (op_status.error_code > s->n_parity_devs) {
@@ -1585,22 +1653,19 @@ tryagain: //** In case blacklisting failed we'll retry with it disabled
             n_iov = 0;
         }
 
-        if (i < sw->n_iov) {  //** Kludgy check so we don't have to copy the waitany code twice
-            //** Construct the next ops base
-            ex_iov[i].offset = lo;
-            ex_iov[i].len = nstripes * s->stripe_size_with_magic;
-
+        if (b < n_batch) {  //** Kludgy check so we don't have to copy the waitany code twice
+            bt = &(batch[b]);
+            bt->ptr = &(ptr[pstripe]);
+            bt->magic = &(magic[curr_stripe*JE_MAGIC_SIZE]);
             iov_start = n_iov;
 
-            //** Cycle through the stripes for encoding
-            boff = sw->boff + curr_bytes;
-            for (j=0; j<nstripes; j++) {
+            //** Cycle through the stripes setting up the encoding and transfer data structs
+            boff = bt->boff;
+            for (j=0; j<bt->nstripes; j++) {
                 tbv.nbytes = s->data_size;
-//           boff += s->chunk_size;
                 tbx_tbuf_next(sw->buffer, boff, &tbv);
                 assert((tbv.n_iov == 1) && (tbv.nbytes == s->data_size));
 
-                //** Make the encoding and transfer data structs
                 stripe_magic = &(magic[curr_stripe*JE_MAGIC_SIZE]);
                 poff = 0;
                 for (k=0; k<s->n_data_devs; k++) {
@@ -1611,7 +1676,6 @@ tryagain: //** In case blacklisting failed we'll retry with it disabled
                             empty = &(parity[parity_len]);
                             memset(empty, 0, s->chunk_size);
                         }
-                        //ptr[pstripe+k] = NULL;  //** Segfault for debugging QWERT
                         log_printf(0, "seg=" XIDT " ERROR NULL ptr! dev=%d\n", segment_id(sw->seg), k);
                         fprintf(stderr, "seg=" XIDT " ERROR NULL ptr! dev=%d\n", segment_id(sw->seg), k);
                         ptr[pstripe + k] = empty;
@@ -1636,40 +1700,40 @@ tryagain: //** In case blacklisting failed we'll retry with it disabled
                     parity_used += s->chunk_size;
                 }
 
-                //** Encode the data
-                s->plan->encode_block(s->plan, &(ptr[pstripe]), s->chunk_size);
-
-                //** Calculate the magic/cksum
-                je_cksum_calc(stripe_magic, &ptr[pstripe], s->n_devs, s->chunk_size);
-
                 curr_stripe++;
                 pstripe += s->n_devs;
                 boff += s->data_size;
             }
 
-            boff = sw->boff + curr_bytes;
-            tbx_tbuf_vec(&(tbuf[i]), nstripes*s->stripe_size_with_magic, n_iov - iov_start, &(iov[iov_start]));
-            gop = segment_write(s->child_seg, sw->da, &(rw_hints[i]), 1, &(ex_iov[i]), &(tbuf[i]), boff, sw->timeout);
-            gop_set_myid(gop, i);
-            opque_add(q, gop);
-            curr_bytes += len;
-//        parity_used += s->parity_size * nstripes;
-
-//uint32_t *uptr;
-//int d;
-//char pbuffer[s->chunk_size+1];
-//log_printf(15, "seg=" XIDT " off=" XOT " len=" XOT "\n", segment_id(sw->seg), ex_iov[i].offset, ex_iov[i].len);
-//for (k=iov_start; k<n_iov; k += 2*s->n_devs) {
-//   log_printf(15, "PRINT iov=%d----------------\n", k);
-//   for (j=0; j < s->n_data_devs; j++) {
-//      uptr = (uint32_t *)iov[k+2*j].iov_base;
-//      d = *uptr;
-//      log_printf(15, "dev=%d magic=%d\n", j, d);
-//      memcpy(pbuffer, iov[k+2*j+1].iov_base, s->chunk_size);
-//      pbuffer[s->chunk_size] = '\0';
-//      log_printf(15, "        data=!%s!\n", pbuffer);
-//   }
-//}
+            len = bt->ex_iov.len;
+            tbx_tbuf_vec(&(bt->tbuf), len, n_iov - iov_start, &(iov[iov_start]));
+
+            if (s->encode_threads <= 0) {  //** Encode it inline
+                segjerase_encode_func(bt, b);
+                _segjerase_write_batch(sw, bt, b, q);
+                continue;
+            }
+
+            //** Send on any encodes that have already finished
+            while ((gop = opque_get_next_finished(eq)) != NULL) {
+                _segjerase_write_batch(sw, &(batch[gop_get_myid(gop)]), gop_get_myid(gop), q);
+                gop_free(gop, OP_DESTROY);
+                n_encoding--;
+            }
+
+            //** Keep at most encode_threads batches encoding
+            if (n_encoding >= s->encode_threads) {
+                gop = opque_waitany(eq);
+                _segjerase_write_batch(sw, &(batch[gop_get_myid(gop)]), gop_get_myid(gop), q);
+                gop_free(gop, OP_DESTROY);
+                n_encoding--;
+            }
+
+            gop = new_thread_pool_op(s->tpc, NULL, segjerase_encode_func, (void *)bt, NULL, 1);
+            gop_set_myid(gop, b);
+            opque_add(eq, gop);
+            opque_start_execution(eq);  //** Start encoding now instead of at the 1st wait
+            n_encoding++;
         }
     }
 
@@ -1678,12 +1742,11 @@ tryagain: //** In case blacklisting failed we'll retry with it disabled
     free(parity);
     free(magic);
     free(ptr);
-    free(ex_iov);
     free(iov);
-    free(tbuf);
-    free(rw_hints);
+    free(batch);
 
     opque_free(q, OP_DESTROY);
+    opque_free(eq, OP_DESTROY);
 
     //** See if we need to retry without blacklisting enabled
     if ((hard_error > 0) && (s->blacklist) && (loop == 0)) {
@@ -2129,7 +2192,7 @@ segment_t *segment_jerasure_create(void *arg)
     service_manager_t *es = (service_manager_t *)arg;
     segjerase_priv_t *s;
     segment_t *seg;
-    int *paranoid;
+    int *paranoid, *val;
 
     //** Make the space
     tbx_type_malloc_clear(seg, segment_t, 1);
@@ -2153,6 +2216,12 @@ segment_t *segment_jerasure_create(void *arg)
     s->paranoid_check = (paranoid == NULL) ? 0 : *paranoid;
     s->magic_cksum = 1;
 
+    //** and how the writes are encoded
+    val = lookup_service(es, ESS_RUNNING, "jerase_encode_batch");
+    s->encode_batch = (val == NULL) ? 4*1024*1024 : *val;
+    val = lookup_service(es, ESS_RUNNING, "jerase_encode_threads");
+    s->encode_threads = (val == NULL) ? 4 : *val;
+
     //** Also snag whether we're blacklisting
     s->blacklist = lookup_service(es, ESS_RUNNING, "blacklist");
 
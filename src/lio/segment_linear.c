@@ -1115,6 +1115,38 @@ int seglin_signature(segment_t *seg, char *buffer, int *used, int bufsize)
     return(0);
 }
 
+//***********************************************************************
+// seglin_extents - Maps the segment range [lo, hi] onto the data blocks
+//     holding it.  The extents are appended to the stack in segment order.
+//***********************************************************************
+
+int seglin_extents(segment_t *seg, ex_off_t lo, ex_off_t hi, tbx_stack_t *stack)
+{
+    seglin_priv_t *s = (seglin_priv_t *)seg->priv;
+    seglin_slot_t *b;
+    segment_extent_t *e;
+    tbx_isl_iter_t it;
+    ex_off_t start, end;
+
+    segment_lock(seg);
+    it = tbx_isl_iter_search(s->isl, (tbx_sl_key_t *)&lo, (tbx_sl_key_t *)&hi);
+    while ((b = (seglin_slot_t *)tbx_isl_next(&it)) != NULL) {
+        start = (lo <= b->seg_offset) ? 0 : (lo - b->seg_offset);
+        end = (hi >= b->seg_end) ? b->len-1 : (hi - b->seg_offset);
+
+        tbx_type_malloc(e, segment_extent_t, 1);
+        e->data = b->data;
+        e->seg_offset = b->seg_offset + start;
+        e->cap_offset = b->cap_offset + start;
+        e->len = end - start + 1;
+        tbx_stack_move_to_bottom(stack);
+        tbx_stack_insert_below(stack, e);
+    }
+    segment_unlock(seg);
+
+    return(0);
+}
+
 //***********************************************************************
 // seglin_deserialize_text -Read the text based segment
 //***********************************************************************
@@ -1332,6 +1364,7 @@ segment_t *segment_linear_create(void *arg)
     seg->fn.serialize = seglin_serialize;
     seg->fn.deserialize = seglin_deserialize;
     seg->fn.destroy = seglin_destroy;
+    seg->fn.extents = seglin_extents;
 
     return(seg);
 }
@@ -717,7 +717,7 @@ op_status_t seglog_clone_func(void *arg, int id)
     //** Now copy the data if needed
     if (do_segment_copy == 1) {  //** segment_copy() method
         tbx_type_malloc(buffer, char, bufsize);
-        opque_add(q, segment_copy(ss->tpc, slc->da, NULL, slc->sseg, slc->dseg, 0, 0, ss->file_size, bufsize, buffer, 0, slc->timeout));
+        opque_add(q, segment_copy(ss->tpc, slc->da, NULL, slc->sseg, slc->dseg, 0, 0, ss->file_size, bufsize, buffer, 0, 0, slc->timeout));
     } else if (slc->mode == CLONE_STRUCT_AND_DATA) {  //** Use the incremental log+base method
         //** First clone the base struct and data
         opque_add(q, segment_clone(base, slc->da, &(sd->base_seg), CLONE_STRUCT_AND_DATA, slc->attr, slc->timeout));
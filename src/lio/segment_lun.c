@@ -35,6 +35,9 @@
 #include <tbx/type_malloc.h>
 #include "rs_query_base.h"
 #include "segment_lun_priv.h"
+#include <apr_atomic.h>
+#include <apr_thread_proc.h>
+#include <stdint.h>
 
 typedef struct {
     data_block_t *data;    //** Data block
@@ -49,7 +52,6 @@ typedef struct {
     ex_off_t seg_end;     //** Ending location to use
     ex_off_t block_len;   //** Length of each block
     ex_off_t row_len;     //** Total length of row. (block_len*n_devices)
-    int rwop_index;
 } seglun_row_t;
 
 typedef struct {
@@ -112,6 +114,30 @@ typedef struct {
     ex_off_t len;
 } lun_rw_row_t;
 
+typedef struct {   //** Part of a R/W request that lands in a single row
+    seglun_row_t *row;
+    ex_off_t start;  //** Relative to the start of the row
+    ex_off_t bpos;
+    ex_off_t len;
+} lun_rw_piece_t;
+
+#define SEGLUN_SCRATCH_KEEP 4096   //** Max lun_rw_row_t's a thread keeps between calls
+
+typedef struct {   //** Per thread scratch space used by seglun_rw_op
+    lun_rw_piece_t *piece;
+    seglun_row_t **row;
+    int *hash;
+    lun_rw_row_t *rwb;
+    int max_piece;
+    int max_row;
+    int max_hash;
+    int max_rwb;
+    int in_use;
+} seglun_scratch_t;
+
+static apr_threadkey_t *_seglun_scratch_key = NULL;
+static apr_pool_t *_seglun_scratch_pool = NULL;
+
 //***********************************************************************
 // _slun_perform_remap - Does a cap remap
 //   **NOTE: Assumes the segment is locked
@@ -871,7 +897,6 @@ op_status_t _seglun_grow(segment_t *seg, data_attr_t *da, ex_off_t new_size_arg,
         tbx_type_malloc_clear(b, seglun_row_t, 1);
         tbx_type_malloc_clear(block, seglun_block_t, s->n_devices);
         b->block = block;
-        b->rwop_index = -1;
         b->seg_offset = off;
 
         dsize = off + s->max_row_size;
@@ -1178,7 +1203,7 @@ void lun_row_decompose(segment_t *seg, lun_rw_row_t *rw_buf, seglun_row_t *b, ex
                 tbv.nbytes = nleft;
                 err = TBUFFER_OK;
                 while ((nleft > 0) && (err == TBUFFER_OK)) {
-                    err = tbx_tbuf_next(buffer, pos, &tbv);
+                    err = tbx_tbuf_next_layout(buffer, pos, &tbv);  //** Don't load file ranges just to split them
                     k = rwb->n_iov + tbv.n_iov;
                     if (k >= rwb->c_iov) {
                         rwb->c_iov = 2*k;
@@ -1211,7 +1236,7 @@ void lun_row_decompose(segment_t *seg, lun_rw_row_t *rw_buf, seglun_row_t *b, ex
             if (rw_buf[i].n_ex == rw_buf[i].c_ex) {
                 k = 2 * (j+1);
                 rw_buf[i].c_ex = k;
-                if (rw_buf[i].n_ex == 0) {
+                if (rw_buf[i].ex_iov == NULL) {
                     tbx_type_malloc(rw_buf[i].ex_iov, ex_tbx_iovec_t, k);
                 } else {
                     tbx_type_realloc(rw_buf[i].ex_iov, ex_tbx_iovec_t, k);
@@ -1381,8 +1406,8 @@ int seglun_row_decompose_test()
             for (j=0; j < n_tests; j++) {  //** Random tests
 
                 //** Init the dest buf for the test
-                len = tbx_random_get_int64(0, bufsize-1);
-                offset = tbx_random_get_int64(0,bufsize-len-1);
+                len = tbx_random_fast_int64(0, bufsize-1);
+                offset = tbx_random_fast_int64(0,bufsize-len-1);
 //len = 30000;
 //offset = 8000;
                 k = len / niov;
@@ -1434,6 +1459,178 @@ int seglun_row_decompose_test()
     return(cerr);
 }
 
+//***********************************************************************
+// _seglun_scratch_free - Frees the scratch space contents
+//***********************************************************************
+
+void _seglun_scratch_free(seglun_scratch_t *sc)
+{
+    int i;
+
+    for (i=0; i<sc->max_rwb; i++) {
+        if (sc->rwb[i].iov != NULL) free(sc->rwb[i].iov);
+        if (sc->rwb[i].ex_iov != NULL) free(sc->rwb[i].ex_iov);
+    }
+    if (sc->rwb != NULL) free(sc->rwb);
+    if (sc->piece != NULL) free(sc->piece);
+    if (sc->row != NULL) free(sc->row);
+    if (sc->hash != NULL) free(sc->hash);
+    memset(sc, 0, sizeof(seglun_scratch_t));
+}
+
+//***********************************************************************
+
+void _seglun_scratch_destructor(void *ptr)
+{
+    _seglun_scratch_free((seglun_scratch_t *)ptr);
+    free(ptr);
+}
+
+//***********************************************************************
+// _seglun_scratch_get - Returns the thread's scratch space.  If it's already
+//     in use, ie a nested call, a private one is returned.
+//***********************************************************************
+
+seglun_scratch_t *_seglun_scratch_get()
+{
+    seglun_scratch_t *sc = NULL;
+    apr_threadkey_t *key;
+    apr_pool_t *mpool;
+
+    if (_seglun_scratch_key == NULL) {  //** 1st use so make the key
+        apr_pool_create(&mpool, NULL);
+        apr_threadkey_private_create(&key, _seglun_scratch_destructor, mpool);
+        if (apr_atomic_casptr((volatile void **)&_seglun_scratch_key, key, NULL) == NULL) {
+            _seglun_scratch_pool = mpool;
+        } else {  //** Somebody beat us to it
+            apr_threadkey_private_delete(key);
+            apr_pool_destroy(mpool);
+        }
+    }
+
+    apr_threadkey_private_get((void *)&sc, _seglun_scratch_key);
+    if (sc == NULL) {
+        tbx_type_malloc_clear(sc, seglun_scratch_t, 1);
+        apr_threadkey_private_set(sc, _seglun_scratch_key);
+    } else if (sc->in_use == 1) {
+        tbx_type_malloc_clear(sc, seglun_scratch_t, 1);
+        sc->in_use = -1;  //** Flag it as private
+        return(sc);
+    }
+
+    sc->in_use = 1;
+    return(sc);
+}
+
+//***********************************************************************
+// _seglun_scratch_release - Releases the scratch space.  Large tables are
+//     freed so a single huge request doesn't pin the memory.
+//***********************************************************************
+
+void _seglun_scratch_release(seglun_scratch_t *sc)
+{
+    if (sc->in_use == -1) {
+        _seglun_scratch_free(sc);
+        free(sc);
+        return;
+    }
+
+    if (sc->max_rwb > SEGLUN_SCRATCH_KEEP) _seglun_scratch_free(sc);
+    sc->in_use = 0;
+}
+
+//***********************************************************************
+// _seglun_scratch_piece - Returns the next free piece slot
+//***********************************************************************
+
+lun_rw_piece_t *_seglun_scratch_piece(seglun_scratch_t *sc, int n)
+{
+    if (n >= sc->max_piece) {
+        sc->max_piece = (sc->max_piece == 0) ? 16 : 2*sc->max_piece;
+        if (sc->piece == NULL) {
+            tbx_type_malloc(sc->piece, lun_rw_piece_t, sc->max_piece);
+        } else {
+            tbx_type_realloc(sc->piece, lun_rw_piece_t, sc->max_piece);
+        }
+    }
+
+    return(&(sc->piece[n]));
+}
+
+//***********************************************************************
+// _seglun_scratch_rows - Sizes and clears the row hash for n_pieces
+//***********************************************************************
+
+void _seglun_scratch_rows(seglun_scratch_t *sc, int n_pieces)
+{
+    int n;
+
+    n = 16;
+    while (n < 2*n_pieces) n <<= 1;
+    if (n > sc->max_hash) {
+        if (sc->hash != NULL) free(sc->hash);
+        tbx_type_malloc(sc->hash, int, n);
+        sc->max_hash = n;
+    }
+    memset(sc->hash, 0, sizeof(int)*sc->max_hash);
+
+    if (n_pieces > sc->max_row) {
+        if (sc->row != NULL) free(sc->row);
+        tbx_type_malloc(sc->row, seglun_row_t *, n_pieces);
+        sc->max_row = n_pieces;
+    }
+}
+
+//***********************************************************************
+// _seglun_scratch_row_slot - Returns the slot for the row adding it if needed.
+//     New slots get n_devices cleared lun_rw_row_t's.  The iov arrays from
+//     earlier calls are kept for reuse.
+//***********************************************************************
+
+int _seglun_scratch_row_slot(seglun_scratch_t *sc, seglun_row_t *b, int *n_rows, int n_devices)
+{
+    uint64_t h;
+    int i, slot, n, mask;
+    lun_rw_row_t *rwb;
+
+    mask = sc->max_hash - 1;
+    h = ((uint64_t)(uintptr_t)b >> 4) * 0x9E3779B97F4A7C15ULL;
+    i = (h >> 32) & mask;
+    while (sc->hash[i] != 0) {
+        if (sc->row[sc->hash[i]-1] == b) return(sc->hash[i]-1);
+        i = (i+1) & mask;
+    }
+
+    //** New row
+    slot = *n_rows;
+    (*n_rows)++;
+    sc->row[slot] = b;
+    sc->hash[i] = slot + 1;
+
+    n = (slot+1) * n_devices;
+    if (n > sc->max_rwb) {
+        if (n < 2*sc->max_rwb) n = 2*sc->max_rwb;
+        if (sc->rwb == NULL) {
+            tbx_type_malloc(sc->rwb, lun_rw_row_t, n);
+        } else {
+            tbx_type_realloc(sc->rwb, lun_rw_row_t, n);
+        }
+        memset(&(sc->rwb[sc->max_rwb]), 0, sizeof(lun_rw_row_t)*(n - sc->max_rwb));
+        sc->max_rwb = n;
+    }
+
+    for (i=0; i<n_devices; i++) {
+        rwb = &(sc->rwb[slot*n_devices + i]);
+        rwb->gop = NULL;
+        rwb->block = NULL;
+        rwb->n_ex = 0;
+        rwb->n_iov = 0;
+        rwb->len = 0;
+    }
+
+    return(slot);
+}
+
 //***********************************************************************
 // seglun_rw_op - Reads/Writes to a LUN segment
 //***********************************************************************
@@ -1449,9 +1646,9 @@ op_status_t seglun_rw_op(segment_t *seg, data_attr_t *da, segment_rw_hints_t *rw
     seglun_row_t *b, **bused;
     tbx_isl_iter_t it;
     ex_off_t lo, hi, start, end, blen, bpos;
-    int i, j, maxerr, nerr, slot, n_bslots, bl_count, dev;
-    int *bcount;
-    tbx_stack_t *stack;
+    int i, j, maxerr, nerr, slot, n_bslots, n_pieces, bl_count, dev;
+    seglun_scratch_t *sc;
+    lun_rw_piece_t *piece;
     lun_rw_row_t *rw_buf, *rwb_table;
     double dt;
     apr_time_t now, exec_time;
@@ -1494,17 +1691,14 @@ op_status_t seglun_rw_op(segment_t *seg, data_attr_t *da, segment_rw_hints_t *rw
 
     s->inprogress_count++;  //** Flag that we are doing an I/O op
 
-    tbx_type_malloc(bused, seglun_row_t *, tbx_isl_count(s->isl));
-    tbx_type_malloc(bcount, int, s->n_devices * tbx_isl_count(s->isl));
-    tbx_type_malloc(rwb_table, lun_rw_row_t, s->n_devices * tbx_isl_count(s->isl));
-
-    q = new_opque();
-    stack = tbx_stack_new();
+    //** The lock is held until the ops are formed.  inspect/migrate replace a
+    //** row's blocks under the segment lock without waiting on inprogress_count.
+    sc = _seglun_scratch_get();
     bpos = boff;
+    n_pieces = 0;
 
-    log_printf(15, "START sid=" XIDT " n_iov=%d rw_mode=%d intervals=%d\n", segment_id(seg), n_iov, rw_mode, tbx_isl_count(s->isl));
+    log_printf(15, "START sid=" XIDT " n_iov=%d rw_mode=%d\n", segment_id(seg), n_iov, rw_mode);
 
-    n_bslots = 0;
     for (slot=0; slot<n_iov; slot++) {
         lo = iov[slot].offset;
 
@@ -1518,32 +1712,37 @@ op_status_t seglun_rw_op(segment_t *seg, data_attr_t *da, segment_rw_hints_t *rw
             end = (hi >= b->seg_end) ? b->row_len-1 : (hi - b->seg_offset);
             blen = end - start + 1;
 
-            log_printf(15, "sid=" XIDT " soff=" XOT " bpos=" XOT " blen=" XOT " seg_off=" XOT " seg_len=" XOT " seg_end=" XOT " rwop_index=%d\n", segment_id(seg),
-                       start, bpos, blen, b->seg_offset, b->row_len, b->seg_end, b->rwop_index);
-            tbx_log_flush();
+            log_printf(15, "sid=" XIDT " soff=" XOT " bpos=" XOT " blen=" XOT " seg_off=" XOT " seg_len=" XOT " seg_end=" XOT "\n", segment_id(seg),
+                       start, bpos, blen, b->seg_offset, b->row_len, b->seg_end);
 
-            if (b->rwop_index < 0) {
-                bused[n_bslots] = b;
-                b->rwop_index = n_bslots;
-                n_bslots++;
-                j = b->rwop_index * s->n_devices;
-                memset(&(rwb_table[j]), 0, sizeof(lun_rw_row_t)*s->n_devices);
-            }
-
-            log_printf(15, "rwop_index=%d\n", b->rwop_index);
-
-            rw_buf = &(rwb_table[b->rwop_index*s->n_devices]);
-            lun_row_decompose(seg, rw_buf, b, start, buffer, bpos, blen);
+            piece = _seglun_scratch_piece(sc, n_pieces);
+            piece->row = b;
+            piece->start = start;
+            piece->bpos = bpos;
+            piece->len = blen;
+            n_pieces++;
 
             bpos = bpos + blen;
 
             b = (seglun_row_t *)tbx_isl_next(&it);
         }
         log_printf(15, "bottom sid=" XIDT " slot=%d\n", segment_id(seg), slot);
+    }
 
+    //** Split each piece across the devices in it's row
+    q = new_opque();
+    _seglun_scratch_rows(sc, n_pieces);
+    n_bslots = 0;
+    for (i=0; i<n_pieces; i++) {
+        piece = &(sc->piece[i]);
+        slot = _seglun_scratch_row_slot(sc, piece->row, &n_bslots, s->n_devices);
+        rw_buf = &(sc->rwb[slot*s->n_devices]);
+        lun_row_decompose(seg, rw_buf, piece->row, piece->start, buffer, piece->bpos, piece->len);
     }
+    bused = sc->row;
+    rwb_table = sc->rwb;
 
-    log_printf(15, " n_bslots=%d\n", n_bslots);
+    log_printf(15, " n_pieces=%d n_bslots=%d\n", n_pieces, n_bslots);
 
     //** Acquire the blacklist lock if using it
     if (bl) apr_thread_mutex_lock(bl->lock);
@@ -1552,7 +1751,6 @@ op_status_t seglun_rw_op(segment_t *seg, data_attr_t *da, segment_rw_hints_t *rw
     for (slot=0; slot < n_bslots; slot++) {
         b = bused[slot];
         bl_count = 0;
-        b->rwop_index = -1;
         j = slot * s->n_devices;
 
         for (i=0; i < s->n_devices; i++) {
@@ -1584,6 +1782,7 @@ op_status_t seglun_rw_op(segment_t *seg, data_attr_t *da, segment_rw_hints_t *rw
 
                 //** Form the op
                 tbx_tbuf_vec(&(rwb_table[j + i].buffer), rwb_table[j + i].len, rwb_table[j+i].n_iov, rwb_table[j+i].iov);
+                tbx_tbuf_fd_inherit(&(rwb_table[j + i].buffer), buffer);
                 if (rw_mode== 0) {
                     if (rwb_table[j+i].n_iov == 1) {
                         gop = (bl_rid == NULL) ? ds_read(b->block[i].data->ds, da, ds_get_cap(b->block[i].data->ds, b->block[i].data->cap, DS_CAP_READ),
@@ -1684,11 +1883,9 @@ op_status_t seglun_rw_op(segment_t *seg, data_attr_t *da, segment_rw_hints_t *rw
                         }
                     }
 
-                    free(rwb_table[j+i].ex_iov);
                     log_printf(15, "end stage i=%d gid=%d gop_completed_successfully=%d nerr=%d\n", i, gop_id(rwb_table[j+i].gop), gop_completed_successfully(rwb_table[j+i].gop), nerr);
                 }
 
-                if (rwb_table[j+i].iov != NULL) free(rwb_table[j+i].iov);
                 if (rwb_table[j+i].gop != NULL) gop_free(rwb_table[j+i].gop, OP_DESTROY);
             }
 
@@ -1714,10 +1911,7 @@ op_status_t seglun_rw_op(segment_t *seg, data_attr_t *da, segment_rw_hints_t *rw
     if (s->inprogress_count == 0) apr_thread_cond_broadcast(seg->cond);
     segment_unlock(seg);
 
-    free(rwb_table);
-    free(bcount);
-    free(bused);
-    tbx_stack_free(stack, 0);
+    _seglun_scratch_release(sc);
     opque_free(q, OP_DESTROY);
 
     dt = apr_time_now() - tstart;
@@ -2598,6 +2792,75 @@ int seglun_signature(segment_t *seg, char *buffer, int *used, int bufsize)
     return(0);
 }
 
+//***********************************************************************
+// _seglun_extent_add - Adds the extent to the bottom of the stack merging it
+//     with the previous one if they are contiguous in the same block
+//***********************************************************************
+
+void _seglun_extent_add(tbx_stack_t *stack, data_block_t *data, ex_off_t seg_offset, ex_off_t cap_offset, ex_off_t len)
+{
+    segment_extent_t *e;
+
+    tbx_stack_move_to_bottom(stack);
+    e = tbx_stack_get_current_data(stack);
+    if ((e != NULL) && (e->data == data) && (e->seg_offset + e->len == seg_offset) && (e->cap_offset + e->len == cap_offset)) {
+        e->len += len;
+        return;
+    }
+
+    tbx_type_malloc(e, segment_extent_t, 1);
+    e->data = data;
+    e->seg_offset = seg_offset;
+    e->cap_offset = cap_offset;
+    e->len = len;
+    tbx_stack_insert_below(stack, e);
+}
+
+//***********************************************************************
+// seglun_extents - Maps the segment range [lo, hi] onto the data blocks
+//     holding it.  The extents are appended to the stack in segment order.
+//***********************************************************************
+
+int seglun_extents(segment_t *seg, ex_off_t lo, ex_off_t hi, tbx_stack_t *stack)
+{
+    seglun_priv_t *s = (seglun_priv_t *)seg->priv;
+    seglun_row_t *b;
+    tbx_isl_iter_t it;
+    ex_off_t start, end, stripe_off, chunk_off, chunk_end, begin, last;
+    int i, dev, ss, stripe_shift;
+
+    segment_lock(seg);
+    it = tbx_isl_iter_search(s->isl, (tbx_sl_key_t *)&lo, (tbx_sl_key_t *)&hi);
+    while ((b = (seglun_row_t *)tbx_isl_next(&it)) != NULL) {
+        start = (lo <= b->seg_offset) ? 0 : (lo - b->seg_offset);
+        end = (hi >= b->seg_end) ? b->row_len-1 : (hi - b->seg_offset);
+
+        //** Same layout as lun_row_decompose() but walking the chunks in segment order
+        ss = start / s->stripe_size;
+        stripe_off = ss * s->stripe_size;
+        stripe_shift = ss * s->n_shift;
+        while (stripe_off <= end) {
+            for (dev=0; dev < s->n_devices; dev++) {
+                chunk_off = stripe_off + dev * s->chunk_size;
+                chunk_end = chunk_off + s->chunk_size - 1;
+                if ((chunk_end < start) || (chunk_off > end)) continue;
+
+                i = (dev + s->n_devices - (stripe_shift % s->n_devices)) % s->n_devices;  //** Block holding this chunk
+                begin = (chunk_off < start) ? start - chunk_off : 0;
+                last = (chunk_end > end) ? end - chunk_off : s->chunk_size - 1;
+                _seglun_extent_add(stack, b->block[i].data, b->seg_offset + chunk_off + begin, ss * s->chunk_size + begin, last - begin + 1);
+            }
+
+            stripe_off += s->stripe_size;
+            stripe_shift += s->n_shift;
+            ss++;
+        }
+    }
+    segment_unlock(seg);
+
+    return(0);
+}
+
 //***********************************************************************
 // seglun_serialize_text_try - Convert the segment to a text based format
 //***********************************************************************
@@ -2790,7 +3053,6 @@ int seglun_deserialize_text(segment_t *seg, ex_id_t id, exnode_exchange_t *exp)
             tbx_type_malloc_clear(b, seglun_row_t, 1);
             tbx_type_malloc_clear(block, seglun_block_t, s->n_devices);
             b->block = block;
-            b->rwop_index = -1;
 
             //** Parse the segment line
             value = tbx_inip_ele_get_value(ele);
@@ -2981,6 +3243,7 @@ segment_t *segment_lun_create(void *arg)
     seg->fn.serialize = seglun_serialize;
     seg->fn.deserialize = seglun_deserialize;
     seg->fn.destroy = seglun_destroy;
+    seg->fn.extents = seglun_extents;
 
     return(seg);
 }
@@ -50,6 +50,38 @@ inline int tbx_atomic_global_counter()
     return(tbx_atomic_counter(&_tbx_atomic_global_counter));
 }
 
+//*************************************************************************
+// tbx_atomic_or32 - Atomically OR's the mask into the value and returns the
+//     original value
+//*************************************************************************
+
+apr_uint32_t tbx_atomic_or32(tbx_atomic_unit32_t *v, apr_uint32_t mask)
+{
+    apr_uint32_t old;
+
+    do {
+        old = apr_atomic_read32(v);
+    } while (apr_atomic_cas32(v, old | mask, old) != old);
+
+    return(old);
+}
+
+//*************************************************************************
+// tbx_atomic_and32 - Atomically AND's the mask into the value and returns the
+//     original value
+//*************************************************************************
+
+apr_uint32_t tbx_atomic_and32(tbx_atomic_unit32_t *v, apr_uint32_t mask)
+{
+    apr_uint32_t old;
+
+    do {
+        old = apr_atomic_read32(v);
+    } while (apr_atomic_cas32(v, old & mask, old) != old);
+
+    return(old);
+}
+
 //*************************************************************************
 // tbx_a_thread_id_ptr - Returns the pointer to the thread unique id
 //*************************************************************************
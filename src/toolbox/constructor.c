@@ -1,6 +1,7 @@
 #include <apr_general.h>
 #include <assert.h>
 #include "tbx/constructor_wrapper.h"
+#include "tbx/random.h"
 
 #ifdef ACCRE_CONSTRUCTOR_PREPRAGMA_ARGS
 #pragma ACCRE_CONSTRUCTOR_PREPRAGMA_ARGS(tbx_construct_fn)
@@ -21,8 +22,12 @@ ACCRE_DEFINE_DESTRUCTOR(tbx_destruct_fn)
 static void tbx_construct_fn() {
     apr_status_t ret = apr_initialize();
     assert(ret == APR_SUCCESS);
+
+    //** The per-thread generators need the thread key before any thread can use them
+    tbx_random_startup();
 }
 
 static void tbx_destruct_fn() { 
+    tbx_random_shutdown();
     apr_terminate();
 }
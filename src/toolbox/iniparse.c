@@ -20,6 +20,7 @@
 
 typedef struct {
     FILE *fd;
+    const char *text;  //** Used instead of fd when parsing a string
     char buffer[BUFMAX];
     int used;
 } bfile_entry_t;
@@ -112,6 +113,41 @@ FILE *bfile_fopen(tbx_stack_t *include_paths, char *fname)
     return(NULL);
 }
 
+//***********************************************************************
+// _text_gets - fgets() equivalent for reading from a string.  The text
+//     pointer is advanced past the line returned.
+//***********************************************************************
+
+char *_text_gets(char *buffer, int size, const char **text)
+{
+    const char *s = *text;
+    int i;
+
+    if (s[0] == '\0') return(NULL);
+
+    for (i=0; (i < size-1) && (s[i] != '\0'); i++) {
+        buffer[i] = s[i];
+        if (s[i] == '\n') {
+            i++;
+            break;
+        }
+    }
+    buffer[i] = '\0';
+    *text = s + i;
+
+    return(buffer);
+}
+
+//***********************************************************************
+// _bfile_close - Closes the entry's file if it has one and frees it
+//***********************************************************************
+
+void _bfile_close(bfile_entry_t *entry)
+{
+    if (entry->fd != NULL) fclose(entry->fd);
+    free(entry);
+}
+
 //***********************************************************************
 // _get_line - Reads a line of text from the file
 //***********************************************************************
@@ -127,12 +163,15 @@ char * _get_line(bfile_t *bfd)
 
     if (bfd->curr->used == 1) return(bfd->curr->buffer);
 
-    comment = fgets(bfd->curr->buffer, BUFMAX, bfd->curr->fd);
+    if (bfd->curr->fd != NULL) {
+        comment = fgets(bfd->curr->buffer, BUFMAX, bfd->curr->fd);
+    } else {
+        comment = _text_gets(bfd->curr->buffer, BUFMAX, &(bfd->curr->text));
+    }
     log_printf(15, "_get_line: fgets=%s", comment);
 
     if (comment == NULL) {  //** EOF or error
-        fclose(bfd->curr->fd);
-        free(bfd->curr);
+        _bfile_close(bfd->curr);
 
         bfd->curr = (bfile_entry_t *) tbx_stack_pop(bfd->stack);
         if (bfd->curr == NULL) {
@@ -150,7 +189,7 @@ char * _get_line(bfile_t *bfd)
         fname = tbx_stk_string_token(&(bfd->curr->buffer[8]), " \n", &last, &fin);
         log_printf(10, "_get_line: Opening include file %s\n", fname);
 
-        tbx_type_malloc(entry, bfile_entry_t, 1);
+        tbx_type_malloc_clear(entry, bfile_entry_t, 1);
         entry->fd = bfile_fopen(bfd->include_paths, fname);
         if (entry->fd == NULL) {  //** Can't open the file
             log_printf(1, "_get_line: Problem opening include file !%s!\n", fname);
@@ -457,20 +496,14 @@ char *tbx_inip_get_string(tbx_inip_file_t *inip, const char *group, const char *
 
 
 //***********************************************************************
-//  inip_read_fd - Loads the .ini file pointed to by the file descriptor
+//  _inip_read - Parses the .ini file starting with the given entry
 //***********************************************************************
 
-tbx_inip_file_t *inip_read_fd(FILE *fd)
+tbx_inip_file_t *_inip_read(bfile_entry_t *entry)
 {
     tbx_inip_file_t *inip;
     tbx_inip_group_t *group, *prev;
     bfile_t bfd;
-    bfile_entry_t *entry;
-
-    tbx_type_malloc_clear(entry, bfile_entry_t, 1);
-    entry->fd = fd;
-
-    rewind(fd);
 
     entry->used = 0;
     bfd.curr = entry;
@@ -497,14 +530,10 @@ tbx_inip_file_t *inip_read_fd(FILE *fd)
 
 
 
-    if (bfd.curr != NULL) {
-        fclose(bfd.curr->fd);
-        free(bfd.curr);
-    }
+    if (bfd.curr != NULL) _bfile_close(bfd.curr);
 
     while ((entry = (bfile_entry_t *) tbx_stack_pop(bfd.stack)) != NULL) {
-        fclose(entry->fd);
-        free(entry);
+        _bfile_close(entry);
     }
 
     tbx_stack_free(bfd.stack, 1);
@@ -513,6 +542,22 @@ tbx_inip_file_t *inip_read_fd(FILE *fd)
     return(inip);
 }
 
+//***********************************************************************
+//  inip_read_fd - Loads the .ini file pointed to by the file descriptor
+//***********************************************************************
+
+tbx_inip_file_t *inip_read_fd(FILE *fd)
+{
+    bfile_entry_t *entry;
+
+    tbx_type_malloc_clear(entry, bfile_entry_t, 1);
+    entry->fd = fd;
+
+    rewind(fd);
+
+    return(_inip_read(entry));
+}
+
 //***********************************************************************
 //  inip_read - Reads a .ini file
 //***********************************************************************
@@ -542,36 +587,16 @@ tbx_inip_file_t *tbx_inip_file_read(const char *fname)
 }
 
 //***********************************************************************
-//  inip_read_text - Converts a character array into a .ini file
+//  inip_read_text - Converts a character array into a .ini file.  The
+//     text is parsed in place without a round trip through a file.
 //***********************************************************************
 
 tbx_inip_file_t *tbx_inip_string_read(const char *text)
 {
-    /* POSIX requires mkstemp sets the permissions of the resulting file to
-     * 0600. Coverity assumes the much broader stance that mkstemp is influenced
-     * by the current umask, so it complains that you need to set umask to 0000
-     * before calling mkstemp. It doesn't really make sense anyway, you can't
-     * safely set umask in a multithreaded application. Sinec it's only obscure
-     * versions of libc that have the other behavior, just tell coverity to
-     * ignore it
-     */
-    // coverity[secure_temp]
-    int file_temp = mkstemp("tbx_inip_XXXXXX");
-    if (file_temp == -1) {
-        goto error1;
-    }
-    FILE *fd = fdopen(file_temp, "r");
-    if (!fd) {
-        goto error2;
-    }
-    fprintf(fd, "%s\n", text);
+    bfile_entry_t *entry;
 
-    tbx_inip_file_t *ret = inip_read_fd(fd);
-    fclose(fd);
-    return ret;
+    tbx_type_malloc_clear(entry, bfile_entry_t, 1);
+    entry->text = text;
 
-error2:
-    close(file_temp);
-error1:
-    return NULL;
+    return(_inip_read(entry));
 }
@@ -38,6 +38,9 @@
 #include "tbx/fmttypes.h"
 #include "tbx/net_sock.h"
 #include <poll.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 // Private implementations
 #include "net_sock.h"
 #include "transfer_buffer.h"
@@ -202,6 +205,8 @@ apr_size_t my_write(tbx_net_sock_t *sock, tbx_tbuf_t *buf, apr_size_t bpos, apr_
     ssize_t n;
     sock_apr_overlay_t *s = (sock_apr_overlay_t *)(sock->fd);
     tbx_tbuf_var_t tbv;
+    off_t foff;
+    int ffd;
 
     int leni, ni;
     apr_time_t start = apr_time_now();
@@ -217,6 +222,18 @@ apr_size_t my_write(tbx_net_sock_t *sock, tbx_tbuf_t *buf, apr_size_t bpos, apr_
         tbv.nbytes = len;
 //len2 = 1024*1024;
 //if (len > len2) tbv.nbytes = len2;
+#ifdef __linux__
+        tbx_tbuf_next_layout(buf, bpos, &tbv);
+        if (tbx_tbuf_fd_lookup(buf, tbv.buffer[0].iov_base, tbv.buffer[0].iov_len, &ffd, &foff) == 0) {  //** Send it straight from the file
+            n = sendfile(s->fd, ffd, &foff, tbv.buffer[0].iov_len);
+            if (n == 0) {  //** The file shrank underneath us
+                n = -1;
+                errno = EIO;
+            }
+            continue;  //** Retries on EINTR like writev()
+        }
+        tbv.nbytes = len;
+#endif
         tbx_tbuf_next(buf, bpos, &tbv);
 //leni=len;
 //len2 = tbv.nbytes;
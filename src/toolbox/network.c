@@ -47,6 +47,12 @@ int tbx_ns_getid(tbx_ns_t *ns) {
 void tbx_ns_setid(tbx_ns_t *ns, int id) {
     ns->id = id;
 }
+int tbx_ns_native_fd(tbx_ns_t *ns) {
+    return((ns->native_fd != NULL) ? ns->native_fd(ns->sock) : -1);
+}
+int tbx_ns_read_pending(tbx_ns_t *ns) {
+    return((ns->end >= ns->start) ? ns->end - ns->start + 1 : 0);
+}
 
 void tbx_ns_chksum_write_set(tbx_ns_t *ns, tbx_ns_chksum_t ncs) {
     ns->write_chksum = ncs;
@@ -21,6 +21,7 @@
 
 #define _log_module_index 224
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -268,6 +269,484 @@ void pack_init_zlib(tbx_pack_t *pack, int type, int mode, unsigned char *buffer,
 }
 
 
+//***********************************************************************
+//--------------------------- LZ routines -------------------------------
+//  Fast LZ77 codec using the LZ4 block format.  Writes are staged and
+//  compressed PACK_LZ_BLOCK bytes at a time.  Each block is prefixed
+//  with its raw and stored lengths.  Blocks that don't shrink are stored
+//  as is, which is flagged by the lengths being equal.
+//***********************************************************************
+
+#define LZ_HASH_BITS     12
+#define LZ_MIN_MATCH     4
+#define LZ_LAST_LITERALS 5   //** The last bytes of a block are always literals
+#define LZ_MFLIMIT       12  //** and no match can start this close to the end
+
+//***********************************************************************
+// lz_get32/lz_put32 - Little endian helpers for the block header
+//***********************************************************************
+
+static unsigned int lz_get32(const unsigned char *p)
+{
+    return(p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24));
+}
+
+static void lz_put32(unsigned char *p, unsigned int v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+//***********************************************************************
+// lz_hash - Hashes the next 4 bytes
+//***********************************************************************
+
+static unsigned int lz_hash(const unsigned char *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, 4);
+    return((v * 2654435761U) >> (32 - LZ_HASH_BITS));
+}
+
+//***********************************************************************
+// lz_put_len - Stores the length overflow bytes
+//***********************************************************************
+
+static unsigned char *lz_put_len(unsigned char *op, unsigned int len)
+{
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = len;
+
+    return(op);
+}
+
+//***********************************************************************
+// lz_put_seq - Stores a sequence.  If mlen is 0 it's the final literal
+//    only sequence.  Returns the new output position or NULL if it
+//    doesn't fit.
+//***********************************************************************
+
+static unsigned char *lz_put_seq(unsigned char *op, unsigned char *oend, const unsigned char *lit, unsigned int nlit, unsigned int off, unsigned int mlen)
+{
+    unsigned char *token;
+
+    if ((unsigned int)(oend - op) < (1 + nlit/255 + 1 + nlit + 2 + mlen/255 + 1)) return(NULL);
+
+    token = op++;
+    if (nlit >= 15) {
+        *token = 15 << 4;
+        op = lz_put_len(op, nlit - 15);
+    } else {
+        *token = nlit << 4;
+    }
+    memcpy(op, lit, nlit);
+    op += nlit;
+
+    if (mlen == 0) return(op);  //** Last sequence
+
+    *op++ = off & 0xFF;
+    *op++ = off >> 8;
+    mlen -= LZ_MIN_MATCH;
+    if (mlen >= 15) {
+        *token |= 15;
+        op = lz_put_len(op, mlen - 15);
+    } else {
+        *token |= mlen;
+    }
+
+    return(op);
+}
+
+//***********************************************************************
+// lz_compress - Compresses a block of up to PACK_LZ_BLOCK bytes.  Returns
+//    the compressed size or -1 if it doesn't fit in dst.
+//***********************************************************************
+
+static int lz_compress(const unsigned char *src, int n, unsigned char *dst, int dmax)
+{
+    uint16_t htable[1<<LZ_HASH_BITS];
+    const unsigned char *ip, *anchor, *ref, *mflimit, *mlimit;
+    const unsigned char *iend = src + n;
+    unsigned char *op = dst;
+    unsigned char *oend = dst + dmax;
+    unsigned int h, mlen;
+
+    memset(htable, 0, sizeof(htable));
+    ip = anchor = src;
+
+    if (n > LZ_MFLIMIT) {
+        mflimit = iend - LZ_MFLIMIT;
+        mlimit = iend - LZ_LAST_LITERALS;
+        ip++;
+        while (ip < mflimit) {
+            h = lz_hash(ip);
+            ref = src + htable[h];
+            htable[h] = ip - src;
+            if (((ip - ref) > 65535) || (memcmp(ref, ip, LZ_MIN_MATCH) != 0)) {
+                ip += 1 + ((ip - anchor) >> 6);  //** Skip faster through data that doesn't compress
+                continue;
+            }
+
+            mlen = LZ_MIN_MATCH;
+            while (((ip + mlen) < mlimit) && (ip[mlen] == ref[mlen])) mlen++;
+
+            op = lz_put_seq(op, oend, anchor, ip - anchor, ip - ref, mlen);
+            if (op == NULL) return(-1);
+
+            ip += mlen;
+            anchor = ip;
+        }
+    }
+
+    //** Dump the remaining literals
+    op = lz_put_seq(op, oend, anchor, iend - anchor, 0, 0);
+    if (op == NULL) return(-1);
+
+    return(op - dst);
+}
+
+//***********************************************************************
+// lz_decompress - Decompresses a block.  Returns the number of bytes
+//    decompressed or -1 if the block is corrupt.
+//***********************************************************************
+
+static int lz_decompress(const unsigned char *src, int n, unsigned char *dst, int dmax)
+{
+    const unsigned char *ip = src;
+    const unsigned char *iend = src + n;
+    unsigned char *op = dst;
+    unsigned char *oend = dst + dmax;
+    unsigned char *ref;
+    unsigned int token, len, off, b;
+
+    while (ip < iend) {
+        token = *ip++;
+
+        //** Copy the literals
+        len = token >> 4;
+        if (len == 15) {
+            do {
+                if (ip >= iend) return(-1);
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        if ((len > (unsigned int)(iend - ip)) || (len > (unsigned int)(oend - op))) return(-1);
+        memcpy(op, ip, len);
+        ip += len;
+        op += len;
+
+        if (ip == iend) break;  //** Last sequence only has literals
+
+        //** And the match
+        if ((iend - ip) < 2) return(-1);
+        off = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if ((off == 0) || (off > (unsigned int)(op - dst))) return(-1);
+
+        len = token & 15;
+        if (len == 15) {
+            do {
+                if (ip >= iend) return(-1);
+                b = *ip++;
+                len += b;
+            } while (b == 255);
+        }
+        len += LZ_MIN_MATCH;
+        if (len > (unsigned int)(oend - op)) return(-1);
+
+        ref = op - off;
+        if (off >= len) {
+            memcpy(op, ref, len);
+            op += len;
+        } else {
+            while (len-- > 0) *op++ = *ref++;  //** Byte at a time since they overlap
+        }
+    }
+
+    return(op - dst);
+}
+
+//***********************************************************************
+// pack_lz_decode - Unpacks a block into the block buffer.  Returns 1 on
+//    success and PACK_ERROR otherwise.
+//***********************************************************************
+
+int pack_lz_decode(tbx_pack_lz_t *p, unsigned char *src, unsigned int rlen, unsigned int clen)
+{
+    if (clen == rlen) {
+        memcpy(p->block, src, rlen);
+    } else if (lz_decompress(src, clen, p->block, rlen) != (int)rlen) {
+        log_printf(0, "ERROR: Corrupt LZ block! rlen=%u clen=%u\n", rlen, clen);
+        return(PACK_ERROR);
+    }
+
+    p->bsize = rlen;
+    p->boff = 0;
+    return(1);
+}
+
+//***********************************************************************
+// pack_lz_next_block - Decodes the next block.  Returns 1 if a block was
+//    decoded, 0 if more data is needed, and PACK_ERROR on error.  Blocks
+//    split across buffers are assembled in the fragment buffer.
+//***********************************************************************
+
+int pack_lz_next_block(tbx_pack_lz_t *p)
+{
+    unsigned char *src;
+    unsigned int rlen, clen, avail, n;
+
+    avail = p->bufsize - p->bpos;
+    if ((p->fsize == 0) && (avail >= PACK_LZ_HEADER)) {  //** See if it's all here
+        src = &(p->buffer[p->bpos]);
+        rlen = lz_get32(src);
+        clen = lz_get32(&(src[4]));
+        if ((rlen == 0) || (rlen > PACK_LZ_BLOCK) || (clen == 0) || (clen > rlen)) return(PACK_ERROR);
+        if (avail >= (PACK_LZ_HEADER + clen)) {
+            p->bpos += PACK_LZ_HEADER + clen;
+            return(pack_lz_decode(p, &(src[PACK_LZ_HEADER]), rlen, clen));
+        }
+    }
+
+    //** It's split so stash what we have
+    if (p->frag == NULL) tbx_type_malloc(p->frag, unsigned char, PACK_LZ_HEADER + PACK_LZ_BLOCK);
+
+    if (p->fsize < PACK_LZ_HEADER) {
+        n = PACK_LZ_HEADER - p->fsize;
+        if (n > avail) n = avail;
+        memcpy(&(p->frag[p->fsize]), &(p->buffer[p->bpos]), n);
+        p->fsize += n;
+        p->bpos += n;
+        avail -= n;
+        if (p->fsize < PACK_LZ_HEADER) return(0);
+    }
+
+    rlen = lz_get32(p->frag);
+    clen = lz_get32(&(p->frag[4]));
+    if ((rlen == 0) || (rlen > PACK_LZ_BLOCK) || (clen == 0) || (clen > rlen)) return(PACK_ERROR);
+
+    n = PACK_LZ_HEADER + clen - p->fsize;
+    if (n > avail) n = avail;
+    memcpy(&(p->frag[p->fsize]), &(p->buffer[p->bpos]), n);
+    p->fsize += n;
+    p->bpos += n;
+    if (p->fsize < (PACK_LZ_HEADER + clen)) return(0);
+
+    p->fsize = 0;
+    return(pack_lz_decode(p, &(p->frag[PACK_LZ_HEADER]), rlen, clen));
+}
+
+//***********************************************************************
+// pack_read_lz - Retreives data from the buffer and returns the number
+//    of bytes retreived.
+//***********************************************************************
+
+int pack_read_lz(tbx_pack_t *pack, unsigned char *data, int len)
+{
+    tbx_pack_lz_t *p = &(pack->data.lz);
+    int n, nbytes, err;
+
+    n = 0;
+    while (n < len) {
+        if (p->boff == p->bsize) {  //** Need another block
+            err = pack_lz_next_block(p);
+            if (err == 0) break;
+            if (err < 0) return(PACK_ERROR);
+        }
+
+        nbytes = p->bsize - p->boff;
+        if (nbytes > (len - n)) nbytes = len - n;
+        memcpy(&(data[n]), &(p->block[p->boff]), nbytes);
+        p->boff += nbytes;
+        n += nbytes;
+    }
+
+    return(n);
+}
+
+//***********************************************************************
+// pack_read_new_data_lz - Replaces the current data array with that
+//    provided.  The old data array should have been completely consumed!
+//***********************************************************************
+
+int pack_read_new_data_lz(tbx_pack_t *pack, unsigned char *buffer, unsigned int bufsize)
+{
+    tbx_pack_lz_t *p = &(pack->data.lz);
+    int err = 0;
+
+    if (p->bpos < p->bufsize) err = PACK_ERROR;
+
+    p->buffer = buffer;
+    p->bufsize = bufsize;
+    p->bpos = 0;
+
+    return(err);
+}
+
+//***********************************************************************
+// pack_lz_emit - Compresses as much of the staged data as will fit in the
+//    output buffer.  Returns 0 on success and -1 if the buffer is full.
+//***********************************************************************
+
+int pack_lz_emit(tbx_pack_lz_t *p)
+{
+    unsigned char *hdr;
+    unsigned int avail, n;
+    int clen;
+
+    if (p->bsize == 0) return(0);
+
+    //** Find the largest chunk whose worst case will fit
+    avail = p->bufsize - p->bpos;
+    if (avail <= (PACK_LZ_HEADER + 16)) return(-1);
+    n = avail - PACK_LZ_HEADER - 16;
+    n -= (n + 255) / 256;
+    if (n > p->bsize) n = p->bsize;
+    if (n == 0) return(-1);
+
+    hdr = &(p->buffer[p->bpos]);
+    clen = lz_compress(p->block, n, &(hdr[PACK_LZ_HEADER]), avail - PACK_LZ_HEADER);
+    if ((clen < 0) || (clen >= (int)n)) {  //** Didn't shrink so store it
+        memcpy(&(hdr[PACK_LZ_HEADER]), p->block, n);
+        clen = n;
+    }
+    lz_put32(hdr, n);
+    lz_put32(&(hdr[4]), clen);
+    p->bpos += PACK_LZ_HEADER + clen;
+
+    //** Shift anything left over down
+    if (n < p->bsize) memmove(p->block, &(p->block[n]), p->bsize - n);
+    p->bsize -= n;
+
+    return(0);
+}
+
+//***********************************************************************
+// pack_write_lz - Stages data for compression and returns the number
+//    of bytes accepted.
+//***********************************************************************
+
+int pack_write_lz(tbx_pack_t *pack, unsigned char *data, int len)
+{
+    tbx_pack_lz_t *p = &(pack->data.lz);
+    int n, nbytes;
+
+    n = 0;
+    while (n < len) {
+        if (p->bsize == PACK_LZ_BLOCK) {
+            if (pack_lz_emit(p) != 0) break;  //** Output buffer is full
+        }
+
+        nbytes = PACK_LZ_BLOCK - p->bsize;
+        if (nbytes > (len - n)) nbytes = len - n;
+        memcpy(&(p->block[p->bsize]), &(data[n]), nbytes);
+        p->bsize += nbytes;
+        n += nbytes;
+    }
+
+    return(n);
+}
+
+//***********************************************************************
+// pack_write_resized_lz - Replaces the re-allocated data array with the
+//    expanded one.  The old data should have been copied to the new array
+//***********************************************************************
+
+void pack_write_resized_lz(tbx_pack_t *pack, unsigned char *buffer, unsigned int bufsize)
+{
+    tbx_pack_lz_t *p = &(pack->data.lz);
+
+    assert(bufsize >= p->bpos);
+
+    p->buffer = buffer;
+    p->bufsize = bufsize;
+}
+
+//***********************************************************************
+// pack_consumed_lz - Flags the write data as consumed.  Resetting the buffer
+//***********************************************************************
+
+void pack_consumed_lz(tbx_pack_t *pack)
+{
+    pack->data.lz.bpos = 0;
+}
+
+//***********************************************************************
+// pack_end_lz - Cleans up the LZ pack structure
+//***********************************************************************
+
+void pack_end_lz(tbx_pack_t *pack)
+{
+    tbx_pack_lz_t *p = &(pack->data.lz);
+
+    if (p->block != NULL) free(p->block);
+    if (p->frag != NULL) free(p->frag);
+}
+
+//***********************************************************************
+// pack_used_lz - Returns the number of buffer bytes used
+//***********************************************************************
+
+int pack_used_lz(tbx_pack_t *pack)
+{
+    return(pack->data.lz.bpos);
+}
+
+//***********************************************************************
+// pack_write_flush_lz - Compresses any staged data.  Depending on space
+//    available this routine may need to be called multiple times.
+//***********************************************************************
+
+int pack_write_flush_lz(tbx_pack_t *pack)
+{
+    tbx_pack_lz_t *p = &(pack->data.lz);
+
+    while (p->bsize > 0) {
+        if (pack_lz_emit(p) != 0) return(PACK_NONE);
+    }
+
+    return(PACK_FINISHED);
+}
+
+//***********************************************************************
+// pack_init_lz - Initializes a LZ pack object
+//***********************************************************************
+
+void pack_init_lz(tbx_pack_t *pack, int type, int mode, unsigned char *buffer, unsigned int bufsize)
+{
+    tbx_pack_lz_t *p = &(pack->data.lz);
+
+    memset(pack, 0, sizeof(tbx_pack_t));
+
+    pack->type = type;
+    pack->mode = mode;
+    p->buffer = buffer;
+    p->bufsize = bufsize;
+    p->bpos = 0;
+    tbx_type_malloc(p->block, unsigned char, PACK_LZ_BLOCK);
+
+    pack->end = pack_end_lz;
+
+    if (mode == PACK_READ) {
+        pack->read_new_data = pack_read_new_data_lz;
+        pack->read = pack_read_lz;
+        pack->used = pack_used_lz;
+    } else {
+        pack->write_resized = pack_write_resized_lz;
+        pack->write = pack_write_lz;
+        pack->used = pack_used_lz;
+        pack->consumed = pack_consumed_lz;
+        pack->write_flush = pack_write_flush_lz;
+    }
+}
+
 //***********************************************************************
 //-------------------------- Raw routines -------------------------------
 //***********************************************************************
@@ -450,6 +929,8 @@ void pack_init(tbx_pack_t *pack, int type, int mode, unsigned char *buffer, unsi
 {
     if (type == PACK_COMPRESS) {
         pack_init_zlib(pack, type, mode, buffer, bufsize);
+    } else if (type == PACK_LZ) {
+        pack_init_lz(pack, type, mode, buffer, bufsize);
     } else {
         pack_init_raw(pack, type, mode, buffer, bufsize);
     }
@@ -44,12 +44,27 @@ struct tbx_pack_zlib_t {
     z_stream z;
 };
 
+#define PACK_LZ_BLOCK   65536  //** Max bytes compressed as a single LZ block
+#define PACK_LZ_HEADER  8      //** Block header: raw length and stored length
+
+struct tbx_pack_lz_t {
+    unsigned char *buffer;   //** Write: Output buffer  Read: Compressed input
+    unsigned int bufsize;
+    unsigned int bpos;       //** Write: Bytes used  Read: Bytes consumed
+    unsigned char *block;    //** Write: Staged raw data  Read: Decompressed block
+    unsigned int bsize;      //** Bytes in the block
+    unsigned int boff;       //** Read: Next block byte to return
+    unsigned char *frag;     //** Read: Partial block split across buffers
+    unsigned int fsize;
+};
+
 struct tbx_pack_t {
     int type;
     int mode;
     union {
         tbx_pack_raw_t raw;
         tbx_pack_zlib_t zlib;
+        tbx_pack_lz_t lz;
     } data;
     void (*end)(tbx_pack_t *pack);
     void (*write_resized)(tbx_pack_t *pack, unsigned char *buffer, unsigned int bufsize);
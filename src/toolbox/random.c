@@ -15,13 +15,19 @@
 */
 
 //*******************************************************************
+// Random number routines.  The tbx_random_get_* routines use OpenSSL and
+// are safe for IDs and keys but serialize on a global lock.  The tbx_rng_*
+// and tbx_random_fast_* routines are a lock free xoshiro256** generator
+// with per-thread state for placement, jitter, and testing.
 //*******************************************************************
 
 #define _log_module_index 110
 
 #include "tbx/random.h"
 #include <apr_thread_mutex.h>
+#include <apr_thread_proc.h>
 #include <apr_pools.h>
+#include <stdlib.h>
 #include <openssl/rand.h>
 #include <assert.h>
 #include "tbx/assert_result.h"
@@ -31,8 +37,18 @@ void random_seed(const void *buf, int nbytes);
 double random_double(double lo, double hi);
 apr_thread_mutex_t  *_rnd_lock = NULL;
 apr_pool_t *_rnd_pool = NULL;
+apr_threadkey_t *_rnd_thread_key = NULL;
 int _rnd_count = 0;
 
+//*******************************************************************
+// _rng_destructor - Frees a thread's generator state
+//*******************************************************************
+
+void _rng_destructor(void *ptr)
+{
+    free(ptr);
+}
+
 //*******************************************************************
 //  init_random - Inititalizes the random number generator for use
 //*******************************************************************
@@ -48,6 +64,7 @@ int tbx_random_startup()
 
     apr_pool_create(&_rnd_pool, NULL);
     apr_thread_mutex_create(&_rnd_lock, APR_THREAD_MUTEX_DEFAULT,_rnd_pool);
+    apr_threadkey_private_create(&_rnd_thread_key, _rng_destructor, _rnd_pool);
 
     return(0);
 }
@@ -61,8 +78,11 @@ int tbx_random_shutdown()
     _rnd_count--;
     if (_rnd_count > 0) return(0);
 
+    apr_threadkey_private_delete(_rnd_thread_key);
     apr_thread_mutex_destroy(_rnd_lock);
     apr_pool_destroy(_rnd_pool);
+    _rnd_thread_key = NULL;
+    _rnd_lock = NULL;
 
     return(0);
 }
@@ -129,3 +149,128 @@ int64_t tbx_random_get_int64(int64_t lo, int64_t hi)
 
     return(n);
 }
+
+//*******************************************************************
+// _rng_splitmix64 - Used to expand a seed into the generator state
+//*******************************************************************
+
+uint64_t _rng_splitmix64(uint64_t *x)
+{
+    uint64_t z;
+
+    *x += 0x9E3779B97F4A7C15ULL;
+    z = *x;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return(z ^ (z >> 31));
+}
+
+//*******************************************************************
+// tbx_rng_seed - Seeds the generator.  The same seed always produces the
+//     same sequence.
+//*******************************************************************
+
+void tbx_rng_seed(tbx_rng_t *rng, uint64_t seed)
+{
+    int i;
+
+    for (i=0; i<4; i++) rng->s[i] = _rng_splitmix64(&seed);
+}
+
+//*******************************************************************
+// tbx_rng_next - Returns the next 64 random bits (xoshiro256**)
+//*******************************************************************
+
+#define _rng_rotl(x, k) (((x) << (k)) | ((x) >> (64 - (k))))
+
+uint64_t tbx_rng_next(tbx_rng_t *rng)
+{
+    uint64_t *s = rng->s;
+    uint64_t result, t;
+
+    result = _rng_rotl(s[1] * 5, 7) * 9;
+    t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = _rng_rotl(s[3], 45);
+
+    return(result);
+}
+
+//*******************************************************************
+// tbx_rng_get_double - Returns a random double in [0, 1)
+//*******************************************************************
+
+double tbx_rng_get_double(tbx_rng_t *rng)
+{
+    return((tbx_rng_next(rng) >> 11) * (1.0 / 9007199254740992.0));
+}
+
+//*******************************************************************
+// tbx_rng_get_int64 - Returns a random integer in [lo, hi]
+//*******************************************************************
+
+int64_t tbx_rng_get_int64(tbx_rng_t *rng, int64_t lo, int64_t hi)
+{
+    uint64_t dn;
+
+    dn = (uint64_t)hi - (uint64_t)lo + 1;
+    if (dn == 0) return((int64_t)tbx_rng_next(rng));  //** Full range
+
+    return(lo + (int64_t)(dn * tbx_rng_get_double(rng)));
+}
+
+//*******************************************************************
+// tbx_rng_thread - Returns the calling thread's generator.  It's created
+//     on first use and seeded from the cryptographic generator.  The thread
+//     key is made by the toolbox constructor so there's no racy lazy setup.
+//*******************************************************************
+
+tbx_rng_t *tbx_rng_thread()
+{
+    tbx_rng_t *rng = NULL;
+    uint64_t seed;
+
+    apr_threadkey_private_get((void *)&rng, _rnd_thread_key);
+    if (rng == NULL) {
+        rng = (tbx_rng_t *)malloc(sizeof(tbx_rng_t));
+        seed = 0;
+        tbx_random_get_bytes(&seed, sizeof(seed));
+        tbx_rng_seed(rng, seed);
+        apr_threadkey_private_set(rng, _rnd_thread_key);
+    }
+
+    return(rng);
+}
+
+//*******************************************************************
+// tbx_random_fast_seed - Reseeds the calling thread's generator
+//*******************************************************************
+
+void tbx_random_fast_seed(uint64_t seed)
+{
+    tbx_rng_seed(tbx_rng_thread(), seed);
+}
+
+//*******************************************************************
+// tbx_random_fast_next - Returns 64 random bits from the thread's generator
+//*******************************************************************
+
+uint64_t tbx_random_fast_next()
+{
+    return(tbx_rng_next(tbx_rng_thread()));
+}
+
+//*******************************************************************
+// tbx_random_fast_int64 - Returns a random integer in [lo, hi] from the
+//     thread's generator
+//*******************************************************************
+
+int64_t tbx_random_fast_int64(int64_t lo, int64_t hi)
+{
+    return(tbx_rng_get_int64(tbx_rng_thread(), lo, hi));
+}
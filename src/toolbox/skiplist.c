@@ -20,6 +20,7 @@
 #include <assert.h>
 #include "tbx/assert_result.h"
 #include "tbx/log.h"
+#include "tbx/random.h"
 #include "tbx/skiplist.h"
 #include "tbx/type_malloc.h"
 #include "skiplist.h"
@@ -381,14 +382,10 @@ void tbx_sl_empty(tbx_sl_t *sl)
 unsigned int get_random_level(unsigned int max_level, double p, unsigned int current_max)
 {
     unsigned int level = 0;
-    double r;
+    tbx_rng_t *rng = tbx_rng_thread();
 
     max_level--;
-    r = RAND_MAX+1.0;
-    r = (1.0*rand()) / r;
-    while ((r < p) && (level < max_level)) {
-        r = RAND_MAX+1.0;
-        r = (1.0*rand()) / r;
+    while ((tbx_rng_get_double(rng) < p) && (level < max_level)) {
         level++;
     }
 
@@ -39,12 +39,18 @@ TBX_API void tbx_atomic_startup();
 
 TBX_API int *tbx_a_thread_id_ptr();
 
+TBX_API apr_uint32_t tbx_atomic_or32(tbx_atomic_unit32_t *v, apr_uint32_t mask);
+
+TBX_API apr_uint32_t tbx_atomic_and32(tbx_atomic_unit32_t *v, apr_uint32_t mask);
+
 // Preprocessor macros
 #define tbx_atomic_inc(v) apr_atomic_inc32(&(v))
 #define tbx_atomic_dec(v) apr_atomic_dec32(&(v))
 #define tbx_atomic_set(v, n) apr_atomic_set32(&(v), n)
 #define tbx_atomic_get(v) apr_atomic_read32(&(v))
 #define tbx_atomic_exchange(a, v) apr_atomic_xchg32(&a, v)
+#define tbx_atomic_or(v, n) tbx_atomic_or32(&(v), n)
+#define tbx_atomic_and(v, n) tbx_atomic_and32(&(v), n)
 #define tbx_atomic_thread_id (*tbx_a_thread_id_ptr())
 
 #ifdef __cplusplus
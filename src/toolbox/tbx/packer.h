@@ -31,6 +31,8 @@ typedef struct tbx_pack_t tbx_pack_t;
 
 typedef struct tbx_pack_zlib_t tbx_pack_zlib_t;
 
+typedef struct tbx_pack_lz_t tbx_pack_lz_t;
+
 // Functions
 TBX_API void tbx_pack_consumed(tbx_pack_t *pack);
 TBX_API tbx_pack_t *tbx_pack_create(int type, int mode, unsigned char *buffer, unsigned int bufsize);
@@ -48,6 +50,7 @@ TBX_API void tbx_pack_write_resized(tbx_pack_t *pack, unsigned char *buffer, uns
 #define PACK_FULL    -1
 #define PACK_NONE     0
 #define PACK_COMPRESS 1
+#define PACK_LZ       2
 #define PACK_READ     0
 #define PACK_WRITE    1
 
@@ -25,12 +25,28 @@
 extern "C" {
 #endif
 
+// Types
+typedef struct {    //** Fast non-cryptographic generator state (xoshiro256**)
+    uint64_t s[4];
+} tbx_rng_t;
+
 // Functions
+//** Cryptographic randomness.  Use these for IDs, keys, and anything security related
 TBX_API int tbx_random_get_bytes(void *buf, int nbytes);
 TBX_API int64_t tbx_random_get_int64(int64_t lo, int64_t hi);
 TBX_API int tbx_random_shutdown();
 TBX_API int tbx_random_startup();
 
+//** Fast non-cryptographic randomness for placement, jitter, and testing.  Never use for security.
+TBX_API void tbx_rng_seed(tbx_rng_t *rng, uint64_t seed);
+TBX_API uint64_t tbx_rng_next(tbx_rng_t *rng);
+TBX_API double tbx_rng_get_double(tbx_rng_t *rng);
+TBX_API int64_t tbx_rng_get_int64(tbx_rng_t *rng, int64_t lo, int64_t hi);
+TBX_API tbx_rng_t *tbx_rng_thread();
+TBX_API void tbx_random_fast_seed(uint64_t seed);
+TBX_API uint64_t tbx_random_fast_next();
+TBX_API int64_t tbx_random_fast_int64(int64_t lo, int64_t hi);
+
 #ifdef __cplusplus
 }
 #endif
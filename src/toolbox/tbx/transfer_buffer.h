@@ -18,7 +18,9 @@
 #ifndef ACCRE_TRANSFER_BUFFER_H_INCLUDED
 #define ACCRE_TRANSFER_BUFFER_H_INCLUDED
 
+#include <sys/types.h>
 #include <sys/uio.h>
+#include "tbx/atomic_counter.h"
 #include "tbx/toolbox_visibility.h"
 
 #ifdef __cplusplus
@@ -28,6 +30,8 @@ extern "C" {
 // Types
 typedef struct iovec tbx_iovec_t;
 
+typedef struct tbx_tbuf_file_t tbx_tbuf_file_t;
+
 typedef struct tbx_tbuf_info_t tbx_tbuf_info_t;
 
 typedef struct tbx_tbuf_state_t tbx_tbuf_state_t;
@@ -40,6 +44,9 @@ typedef struct tbx_tbuf_var_t tbx_tbuf_var_t;
 TBX_API tbx_iovec_t * tbx_tbuf_var_buffer_get(tbx_tbuf_var_t *tbv);
 TBX_API int tbx_tbuf_copy(tbx_tbuf_t *tb_s, size_t off_s, tbx_tbuf_t *tb_d,
                             size_t off_d, size_t nbytes, int blank_missing);
+TBX_API int tbx_tbuf_fd(tbx_tbuf_t *tb, size_t nbytes, int fd, off_t offset, char *buffer);
+TBX_API void tbx_tbuf_fd_inherit(tbx_tbuf_t *tb, tbx_tbuf_t *src);
+TBX_API int tbx_tbuf_fd_lookup(tbx_tbuf_t *tb, void *ptr, size_t len, int *fd, off_t *offset);
 TBX_API void tbx_tbuf_fn(tbx_tbuf_t *tb, size_t total_bytes, void *arg,
                             int (*next_block)(tbx_tbuf_t *tb,
                                                 size_t pos,
@@ -49,6 +56,7 @@ TBX_API int tbx_tbuf_next(tbx_tbuf_t *tb, size_t off, tbx_tbuf_var_t *tbv);
 TBX_API int tbx_tbuf_next_block(tbx_tbuf_t *tb,
                                 size_t off,
                                 tbx_tbuf_var_t *tbv);
+TBX_API int tbx_tbuf_next_layout(tbx_tbuf_t *tb, size_t off, tbx_tbuf_var_t *tbv);
 TBX_API void tbx_tbuf_single(tbx_tbuf_t *tb, size_t nbytes, char *buffer);
 TBX_API size_t tbx_tbuf_size(tbx_tbuf_t *tb);
 TBX_API int tbx_tbuf_test();
@@ -65,6 +73,14 @@ TBX_API void tbx_tbuf_vec(tbx_tbuf_t *tb,
 #define TBUFFER_OUTOFSPACE 2
 #define tbx_tbuf_var_init(tbv) memset((tbv), 0, tbx_tbuf_var_size())
 #if !defined toolbox_EXPORTS && defined LSTORE_HACK_EXPORT
+    struct tbx_tbuf_file_t {
+        int fd;
+        off_t offset;
+        char *base;
+        size_t len;
+        tbx_atomic_unit32_t state;
+    };
+
     struct tbx_tbuf_info_t {
         size_t total_bytes;
         int n;
@@ -89,6 +105,8 @@ TBX_API void tbx_tbuf_vec(tbx_tbuf_t *tb,
         void *arg;
         int (*next_block)(tbx_tbuf_t *tb, size_t off, tbx_tbuf_var_t *tbv);
         tbx_tbuf_info_t buf;
+        tbx_tbuf_file_t *file;
+        tbx_tbuf_file_t fsrc;
     };
 #endif
 #ifdef __cplusplus
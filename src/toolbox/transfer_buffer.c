@@ -17,9 +17,14 @@
 #define _log_module_index 165
 
 #include <assert.h>
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include "tbx/atomic_counter.h"
+#include "tbx/fmttypes.h"
 #include "tbx/transfer_buffer.h"
 #include "tbx/log.h"
 #include "tbx/type_malloc.h"
@@ -213,6 +218,7 @@ void tbx_tbuf_single(tbx_tbuf_t *tb, size_t nbytes, char *buffer)
     tb->buf.total_bytes = nbytes;
     tb->buf.iov = &(tb->buf.io_single);
     tb->arg = NULL;
+    tb->file = NULL;
 
     tb->next_block = tb_next_block;
 
@@ -230,6 +236,7 @@ void tbx_tbuf_vec(tbx_tbuf_t *tb, size_t total_bytes, size_t n_vec, tbx_iovec_t
     tb->buf.total_bytes = total_bytes;
     tb->buf.iov = iov;
     tb->arg = NULL;
+    tb->file = NULL;
 
     tb->next_block = tb_next_block;
 }
@@ -245,9 +252,131 @@ void tbx_tbuf_fn(tbx_tbuf_t *tb, size_t total_bytes, void *arg, int (*next_block
     tb->arg = arg;
     tb->next_block = next_block;
     tb->buf.total_bytes = total_bytes;
+    tb->file = NULL;
 }
 
 
+//***************************************************************************
+//  File range buffers.  The tbuf carries the file and offset along with a
+//  buffer to load the range into.  The data is only read if someone asks
+//  for it with tbx_tbuf_next().  The network layer looks up the file range
+//  and hands it to sendfile() instead so the data never touches the buffer.
+//***************************************************************************
+
+//***************************************************************************
+//  _tbuf_fd_load - Reads the file range into the buffer if needed.  If the
+//     file is shorter than expected the rest of the buffer is zeroed.
+//***************************************************************************
+
+void _tbuf_fd_load(tbx_tbuf_file_t *f)
+{
+    ssize_t got;
+    size_t n;
+
+    if (tbx_atomic_get(f->state) == TBUF_FD_LOADED) return;
+
+    if (apr_atomic_cas32(&(f->state), TBUF_FD_LOADING, TBUF_FD_EMPTY) != TBUF_FD_EMPTY) {  //** Someone else is loading it
+        while (tbx_atomic_get(f->state) != TBUF_FD_LOADED) sched_yield();
+        return;
+    }
+
+    n = 0;
+    while (n < f->len) {
+        got = pread(f->fd, f->base + n, f->len - n, f->offset + n);
+        if (got > 0) {
+            n += got;
+        } else if ((got == -1) && (errno == EINTR)) {
+            continue;
+        } else {
+            break;
+        }
+    }
+
+    if (n < f->len) {
+        log_printf(0, "ERROR short read fd=%d offset=" OT " len=" ST " got=" ST " errno=%d\n", f->fd, f->offset, f->len, n, errno);
+        memset(f->base + n, 0, f->len - n);
+    }
+
+    tbx_atomic_set(f->state, TBUF_FD_LOADED);
+}
+
+//***************************************************************************
+//  tb_fd_next_block - Loads the file range and then acts like a normal buffer
+//***************************************************************************
+
+int tb_fd_next_block(tbx_tbuf_t *tb, size_t pos, tbx_tbuf_var_t *tbv)
+{
+    _tbuf_fd_load(tb->file);
+    return(tb_next_block(tb, pos, tbv));
+}
+
+//***************************************************************************
+//  tbx_tbuf_fd - Makes a read only buffer from the file range
+//     [offset, offset+nbytes).  buffer must hold nbytes and is only filled
+//     if the data is accessed with tbx_tbuf_next().  Returns 0 on success.
+//***************************************************************************
+
+int tbx_tbuf_fd(tbx_tbuf_t *tb, size_t nbytes, int fd, off_t offset, char *buffer)
+{
+    if ((nbytes == 0) || (fd < 0)) return(-1);
+
+    tbx_tbuf_single(tb, nbytes, buffer);
+
+    tb->fsrc.fd = fd;
+    tb->fsrc.offset = offset;
+    tb->fsrc.base = buffer;
+    tb->fsrc.len = nbytes;
+    tbx_atomic_set(tb->fsrc.state, TBUF_FD_EMPTY);
+    tb->file = &(tb->fsrc);
+    tb->next_block = tb_fd_next_block;
+
+    return(0);
+}
+
+//***************************************************************************
+//  tbx_tbuf_fd_inherit - Flags tb, which is built from iovecs returned by
+//     tbx_tbuf_next_layout() on src, as backed by src's file range.  src
+//     has to stay around as long as tb is used.
+//***************************************************************************
+
+void tbx_tbuf_fd_inherit(tbx_tbuf_t *tb, tbx_tbuf_t *src)
+{
+    if (src->file == NULL) return;
+
+    tb->file = src->file;
+    tb->next_block = tb_fd_next_block;
+}
+
+//***************************************************************************
+//  tbx_tbuf_next_layout - Same as tbx_tbuf_next() except file range buffers
+//     aren't loaded.  The iovecs can only be used to split the buffer or
+//     with tbx_tbuf_fd_lookup().
+//***************************************************************************
+
+int tbx_tbuf_next_layout(tbx_tbuf_t *tb, size_t off, tbx_tbuf_var_t *tbv)
+{
+    if (tb->file != NULL) return(tb_next_block(tb, off, tbv));
+    return(tb->next_block(tb, off, tbv));
+}
+
+//***************************************************************************
+//  tbx_tbuf_fd_lookup - Checks if [ptr, ptr+len) is part of a file range
+//     buffer.  If so 0 is returned along with the file and offset of ptr.
+//***************************************************************************
+
+int tbx_tbuf_fd_lookup(tbx_tbuf_t *tb, void *ptr, size_t len, int *fd, off_t *offset)
+{
+    tbx_tbuf_file_t *f = tb->file;
+    char *p = (char *)ptr;
+
+    if (f == NULL) return(1);
+    if ((p < f->base) || ((p + len) > (f->base + f->len))) return(1);
+
+    *fd = f->fd;
+    *offset = f->offset + (p - f->base);
+    return(0);
+}
+
 //***************************************************************************
 //  tbuffer_size - Returns the buffer size
 //***************************************************************************
@@ -459,7 +588,7 @@ int tbuffer_next_test_iovec(int n_iovec, int n_random, char *buffer, int bufsize
         frac = (i+1.0)/(n_iovec*1.0);
         maxlen = frac*bufsize - off;
 //log_printf(0, "tbuffer_next_text_iovec: n_iovec=%d i=%d frac=%lf maxlen=%d\n", n_iovec, i, frac,maxlen);
-        len = tbx_random_get_int64(0, maxlen);
+        len = tbx_random_fast_int64(0, maxlen);
         iov[i].iov_base = &(buffer[off]);
         iov[i].iov_len = len;
         off += len;
@@ -485,8 +614,8 @@ int tbuffer_next_test_iovec(int n_iovec, int n_random, char *buffer, int bufsize
 
     //** Now do the random offset/len tests
     for (i=0; i<n_random; i++) {
-        off = tbx_random_get_int64(0, bufsize);
-        len = tbx_random_get_int64(0, bufsize - off);
+        off = tbx_random_fast_int64(0, bufsize);
+        len = tbx_random_fast_int64(0, bufsize - off);
         err = tbx_tbuf_test_read(&tbuf, buffer, bufsize, off, len);
         if (err != 0) {
             log_printf(0, "tbuffer_next_test_iovec: Error with random read: n_iovec=%d off=%d len=%d\n", n_iovec, off, len);
@@ -546,7 +675,7 @@ int tbuffer_copy_test_iovec(int n1_iovec, int n2_iovec, int n_random, char *buff
     for (i=0; i<n1_iovec; i++) {
         frac = (i+1.0)/(n1_iovec*1.0);
         maxlen = frac*bufsize - off1;
-        len = tbx_random_get_int64(0, maxlen);
+        len = tbx_random_fast_int64(0, maxlen);
         iov1[i].iov_base = &(buffer[off1]);
         iov1[i].iov_len = len;
         off1 += len;
@@ -568,7 +697,7 @@ int tbuffer_copy_test_iovec(int n1_iovec, int n2_iovec, int n_random, char *buff
     for (i=0; i<n2_iovec; i++) {
         frac = (i+1.0)/(n2_iovec*1.0);
         maxlen = frac*bufsize - off2;
-        len = tbx_random_get_int64(0, maxlen);
+        len = tbx_random_fast_int64(0, maxlen);
         iov2[i].iov_base = &(output[off2]);
         iov2[i].iov_len = len;
         off2 += len;
@@ -597,10 +726,10 @@ int tbuffer_copy_test_iovec(int n1_iovec, int n2_iovec, int n_random, char *buff
 
     //** Now do the random offset/len tests
     for (i=0; i<n_random; i++) {
-        off1 = tbx_random_get_int64(0, bufsize);
-        off2 = tbx_random_get_int64(0, bufsize);
+        off1 = tbx_random_fast_int64(0, bufsize);
+        off2 = tbx_random_fast_int64(0, bufsize);
         len = (off1 > off2) ?  bufsize - off1 : bufsize - off2;
-        len = tbx_random_get_int64(0, len);
+        len = tbx_random_fast_int64(0, len);
         memset(output, '-', bufsize);
         output[bufsize] = 0;
         tbx_tbuf_copy(&tbuf1, 0, &tbuf2, 0, bufsize, 1);
@@ -21,6 +21,19 @@
 extern "C" {
 #endif
 
+//** File range states
+#define TBUF_FD_EMPTY   0
+#define TBUF_FD_LOADING 1
+#define TBUF_FD_LOADED  2
+
+struct tbx_tbuf_file_t {   //** File range backing a buffer
+    int fd;
+    off_t offset;          //** File offset of the start of the buffer
+    char *base;            //** Buffer the range is loaded into if the data is needed
+    size_t len;
+    tbx_atomic_unit32_t state;
+};
+
 struct tbx_tbuf_info_t {
     size_t total_bytes;
     int n;
@@ -45,11 +58,14 @@ struct tbx_tbuf_t {
     void *arg;
     int (*next_block)(tbx_tbuf_t *tb, size_t off, tbx_tbuf_var_t *tbv);
     tbx_tbuf_info_t buf;
+    tbx_tbuf_file_t *file;   //** Set if the data is backed by a file range
+    tbx_tbuf_file_t fsrc;    //** File range for buffers made with tbx_tbuf_fd()
 };
 tbx_tbuf_var_t *tbuffer_var_create();
 void tbuffer_var_destroy(tbx_tbuf_var_t *tbv);
 tbx_tbuf_t *tbuffer_create();
 void tbuffer_destroy(tbx_tbuf_t *tb);
+int tb_next_block(tbx_tbuf_t *tb, size_t pos, tbx_tbuf_var_t *tbv);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,116 @@
+#include "task.h"
+#include <apr_pools.h>
+#include <apr_thread_mutex.h>
+#include <apr_time.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tbx/type_malloc.h>
+#include <cache_priv.h>
+
+// Compares cache read hits done the old way, copying under one global lock,
+// against pinning through the sharded page table and copying lock free.
+
+#define CS_PAGE_SIZE      4096
+#define CS_PAGES          64      // Pages per thread so threads never share a page
+#define CS_MAX_THREADS    64
+#define CS_TOTAL_READS    (1024*1024)
+
+typedef struct {
+    cache_segment_t *s;
+    apr_thread_mutex_t *global_lock;
+    ex_off_t start;
+    int n_reads;
+    int sharded;
+} cs_thread_t;
+
+static void *cs_reader(void *arg) {
+    cs_thread_t *t = (cs_thread_t *)arg;
+    cache_segment_t *s = t->s;
+    page_handle_t ph;
+    cache_page_t *p;
+    ex_off_t off;
+    char buf[CS_PAGE_SIZE];
+    int i;
+
+    for (i=0; i<t->n_reads; i++) {
+        off = t->start + (i % CS_PAGES) * CS_PAGE_SIZE;
+        if (t->sharded) {
+            if (cache_page_table_pin(s, off, &ph) == 0) {
+                memcpy(buf, ph.data->ptr, CS_PAGE_SIZE);
+                cache_page_table_unpin(s, &ph);
+            }
+        } else {
+            apr_thread_mutex_lock(t->global_lock);
+            p = tbx_list_search(s->pages, (tbx_list_key_t *)&off);
+            if (p != NULL) memcpy(buf, p->curr_data->ptr, CS_PAGE_SIZE);
+            apr_thread_mutex_unlock(t->global_lock);
+        }
+    }
+
+    return(NULL);
+}
+
+static double cs_run(cache_segment_t *s, apr_thread_mutex_t *lock, int n_threads, int sharded) {
+    pthread_t tid[CS_MAX_THREADS];
+    cs_thread_t targ[CS_MAX_THREADS];
+    apr_time_t dt;
+    int i;
+
+    dt = apr_time_now();
+    for (i=0; i<n_threads; i++) {
+        targ[i].s = s;
+        targ[i].global_lock = lock;
+        targ[i].start = (ex_off_t)i * CS_PAGES * CS_PAGE_SIZE;
+        targ[i].n_reads = CS_TOTAL_READS / n_threads;
+        targ[i].sharded = sharded;
+        pthread_create(&(tid[i]), NULL, cs_reader, &(targ[i]));
+    }
+    for (i=0; i<n_threads; i++) pthread_join(tid[i], NULL);
+    dt = apr_time_now() - dt;
+    if (dt <= 0) dt = 1;
+
+    return((double)CS_TOTAL_READS * APR_USEC_PER_SEC / dt);
+}
+
+BENCHMARK_IMPL(cache_shards) {
+    apr_pool_t *mpool;
+    apr_thread_mutex_t *lock;
+    cache_segment_t *s;
+    cache_page_t *page;
+    double global, sharded;
+    int i, n, npages;
+
+    apr_pool_create(&mpool, NULL);
+    apr_thread_mutex_create(&lock, APR_THREAD_MUTEX_DEFAULT, mpool);
+
+    npages = CS_PAGES * CS_MAX_THREADS;
+    tbx_type_malloc_clear(s, cache_segment_t, 1);
+    tbx_type_malloc_clear(page, cache_page_t, npages);
+    s->page_size = CS_PAGE_SIZE;
+    cache_page_table_create(s, CACHE_PAGE_SHARDS, mpool);
+    for (i=0; i<npages; i++) {
+        page[i].offset = (ex_off_t)i * CS_PAGE_SIZE;
+        tbx_type_malloc_clear(page[i].data[0].ptr, char, CS_PAGE_SIZE);
+        page[i].curr_data = &(page[i].data[0]);
+        cache_page_table_insert(s, &(page[i]));
+    }
+
+    fprintf(stderr, "cache page reads: %d shards, %d byte pages\n", CACHE_PAGE_SHARDS, CS_PAGE_SIZE);
+    for (n=1; n<=CS_MAX_THREADS; n *= 2) {
+        global = cs_run(s, lock, n, 0);
+        sharded = cs_run(s, lock, n, 1);
+        fprintf(stderr, "  threads=%2d global=%10.0f reads/s sharded=%10.0f reads/s speedup=%5.2f\n",
+                n, global, sharded, sharded / global);
+    }
+    fflush(stderr);
+
+    cache_page_table_destroy(s);
+    for (i=0; i<npages; i++) free(page[i].data[0].ptr);
+    free(page);
+    free(s);
+    apr_pool_destroy(mpool);
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "task.h"
+#include <apr_time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <tbx/random.h>
+#include <erasure_tools.h>
+#include <erasure_gf8.h>
+
+// Compares reed_sol_van encode and decode throughput through the erasure plan
+// using Jerasure's region multiply and each GF(2^8) engine kernel.
+
+#define EB_DATA         6
+#define EB_PARITY       3
+#define EB_TOTAL_BYTES  (1024LL*1024*1024)   // Data bytes processed per measurement
+
+static double eb_run(erasure_plan_t *plan, char **ptr, int strip_size, int decode) {
+    int erasures[] = { 1, 4, -1 };
+    apr_time_t dt;
+    long long i, n;
+
+    n = EB_TOTAL_BYTES / ((long long)EB_DATA * strip_size);
+    if (n < 1) n = 1;
+
+    dt = apr_time_now();
+    for (i=0; i<n; i++) {
+        if (decode) {
+            plan->decode_block(plan, ptr, strip_size, erasures);
+        } else {
+            plan->encode_block(plan, ptr, strip_size);
+        }
+    }
+    dt = apr_time_now() - dt;
+    if (dt <= 0) dt = 1;
+
+    return((double)n * EB_DATA * strip_size / dt / 1000.0);  // GB/s
+}
+
+BENCHMARK_IMPL(erasure) {
+    int sizes[] = { 4096, 65536, 1048576 };
+    char *ptr[EB_DATA + EB_PARITY];
+    erasure_plan_t *plan;
+    double enc, dec;
+    tbx_rng_t rng;
+    int i, j, isa, size, current;
+
+    tbx_rng_seed(&rng, 1);
+    size = sizes[sizeof(sizes)/sizeof(int) - 1];
+    for (i=0; i<EB_DATA + EB_PARITY; i++) {
+        ptr[i] = malloc(size);
+        for (j=0; j<size; j++) ptr[i][j] = tbx_rng_next(&rng);
+    }
+
+    plan = et_new_plan(REED_SOL_VAN, size, EB_DATA, EB_PARITY, 8, 0, 0);
+    plan->form_encoding_matrix(plan);
+
+    current = gf8_get_isa();
+    fprintf(stderr, "reed_sol_van w=8: %d data + %d parity strips, 2 data strips lost on decode, default=%s\n",
+            EB_DATA, EB_PARITY, gf8_isa_name(current));
+    for (i=0; i<(int)(sizeof(sizes)/sizeof(int)); i++) {
+        size = sizes[i];
+        for (isa=GF8_ISA_JERASURE; isa<GF8_ISA_MAX; isa++) {
+            if (gf8_set_isa(isa) != isa) continue;
+            enc = eb_run(plan, ptr, size, 0);
+            dec = eb_run(plan, ptr, size, 1);
+            fprintf(stderr, "  strip=%8d %-8s encode=%7.2f GB/s decode=%7.2f GB/s\n", size, gf8_isa_name(isa), enc, dec);
+        }
+    }
+    fflush(stderr);
+
+    gf8_set_isa(current);
+    et_destroy_plan(plan);
+    for (i=0; i<EB_DATA + EB_PARITY; i++) free(ptr[i]);
+
+    return 0;
+}
@@ -20,7 +20,27 @@
  */
 
 BENCHMARK_DECLARE (sizes)
+BENCHMARK_DECLARE (cache_shards)
+BENCHMARK_DECLARE (thread_pool)
+BENCHMARK_DECLARE (raid4)
+BENCHMARK_DECLARE (erasure)
+BENCHMARK_DECLARE (os_attr)
+BENCHMARK_DECLARE (os_stat_storm)
+BENCHMARK_DECLARE (segment_copy)
+BENCHMARK_DECLARE (random)
+BENCHMARK_DECLARE (mq_dispatch)
+BENCHMARK_DECLARE (packer)
 
 TASK_LIST_START
   BENCHMARK_ENTRY  (sizes)
+  BENCHMARK_ENTRY  (cache_shards)
+  BENCHMARK_ENTRY  (thread_pool)
+  BENCHMARK_ENTRY  (raid4)
+  BENCHMARK_ENTRY  (erasure)
+  BENCHMARK_ENTRY  (os_attr)
+  BENCHMARK_ENTRY  (os_stat_storm)
+  BENCHMARK_ENTRY  (segment_copy)
+  BENCHMARK_ENTRY  (random)
+  BENCHMARK_ENTRY  (mq_dispatch)
+  BENCHMARK_ENTRY  (packer)
 TASK_LIST_END
@@ -0,0 +1,164 @@
+#include "task.h"
+#include <apr_thread_cond.h>
+#include <apr_thread_mutex.h>
+#include <apr_time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <tbx/iniparse.h>
+#include <tbx/type_malloc.h>
+#include <mq_portal.h>
+#include <mq_dispatch.h>
+
+// One batch client floods the server with slow scans and a pile of stats
+// while an interactive client trickles in stats.  Compares the interactive
+// latency when everything goes straight to the thread pool in arrival order
+// against the per client fair dispatcher with separate lanes.
+
+#define MD_THREADS       16
+#define MD_SCANS         64
+#define MD_SCAN_US       100000
+#define MD_BATCH_STATS   2000
+#define MD_USER_STATS    300
+#define MD_STAT_US       2000
+#define MD_USER_GAP_US   2000
+
+#define MD_STAT_KEY  "stat"
+#define MD_SCAN_KEY  "scan"
+
+typedef struct {
+    apr_thread_mutex_t *lock;
+    apr_thread_cond_t *cond;
+    int pending;
+} md_bench_t;
+
+typedef struct {
+    md_bench_t *b;
+    apr_time_t submitted;
+    apr_time_t latency;
+    int sleep_us;
+} md_req_t;
+
+static void md_cmd(void *arg, mq_task_t *task) {
+    md_req_t *r;
+    int n;
+
+    mq_msg_first(task->msg);  // Empty
+    mq_msg_next(task->msg);   // Version
+    mq_msg_next(task->msg);   // EXEC
+    mq_msg_next(task->msg);   // ID
+    mq_msg_next(task->msg);   // Command
+    mq_get_frame(mq_msg_next(task->msg), (void **)&r, &n);
+
+    usleep(r->sleep_us);
+    r->latency = apr_time_now() - r->submitted;
+
+    apr_thread_mutex_lock(r->b->lock);
+    r->b->pending--;
+    if (r->b->pending == 0) apr_thread_cond_broadcast(r->b->cond);
+    apr_thread_mutex_unlock(r->b->lock);
+}
+
+static void md_submit(mq_portal_t *p, mq_dispatch_t *d, char *hid, char *cmd, md_req_t *r) {
+    mq_msg_t *msg;
+
+    msg = mq_msg_new();
+    mq_msg_append_mem(msg, NULL, 0, MQF_MSG_KEEP_DATA);
+    mq_msg_append_mem(msg, MQF_VERSION_KEY, MQF_VERSION_SIZE, MQF_MSG_KEEP_DATA);
+    mq_msg_append_mem(msg, MQF_EXEC_KEY, MQF_EXEC_SIZE, MQF_MSG_KEEP_DATA);
+    mq_msg_append_mem(msg, "id", 2, MQF_MSG_KEEP_DATA);
+    mq_msg_append_mem(msg, cmd, strlen(cmd), MQF_MSG_KEEP_DATA);
+    mq_msg_append_mem(msg, r, sizeof(md_req_t), MQF_MSG_KEEP_DATA);
+    mq_msg_append_mem(msg, hid, strlen(hid), MQF_MSG_KEEP_DATA);
+
+    r->submitted = apr_time_now();
+    mq_dispatch_submit(d, mq_task_new(p->mqc, msg, NULL, p, -1));
+}
+
+static int md_cmp(const void *a, const void *b) {
+    apr_time_t x = *(const apr_time_t *)a;
+    apr_time_t y = *(const apr_time_t *)b;
+    return((x < y) ? -1 : (x > y));
+}
+
+static void md_run(mq_portal_t *p, md_bench_t *b, int fair) {
+    mq_dispatch_t *d;
+    md_req_t *batch, *user;
+    apr_time_t lat[MD_USER_STATS];
+    apr_time_t dt;
+    int i, lane;
+
+    d = mq_dispatch_create(p, 0, 0, 1000);
+    lane = (fair) ? MQD_LANE_CHEAP : MQD_LANE_DIRECT;
+    mq_dispatch_class_set(d, MD_STAT_KEY, strlen(MD_STAT_KEY), "stat", lane);
+    lane = (fair) ? MQD_LANE_EXPENSIVE : MQD_LANE_DIRECT;
+    mq_dispatch_class_set(d, MD_SCAN_KEY, strlen(MD_SCAN_KEY), "scan", lane);
+
+    tbx_type_malloc_clear(batch, md_req_t, MD_SCANS + MD_BATCH_STATS);
+    tbx_type_malloc_clear(user, md_req_t, MD_USER_STATS);
+    b->pending = MD_SCANS + MD_BATCH_STATS + MD_USER_STATS;
+
+    dt = apr_time_now();
+    for (i=0; i<MD_SCANS + MD_BATCH_STATS; i++) {
+        batch[i].b = b;
+        batch[i].sleep_us = (i < MD_SCANS) ? MD_SCAN_US : MD_STAT_US;
+        md_submit(p, d, "batch", (i < MD_SCANS) ? MD_SCAN_KEY : MD_STAT_KEY, &(batch[i]));
+    }
+    for (i=0; i<MD_USER_STATS; i++) {
+        user[i].b = b;
+        user[i].sleep_us = MD_STAT_US;
+        md_submit(p, d, "user", MD_STAT_KEY, &(user[i]));
+        usleep(MD_USER_GAP_US);
+    }
+
+    apr_thread_mutex_lock(b->lock);
+    while (b->pending > 0) apr_thread_cond_wait(b->cond, b->lock);
+    apr_thread_mutex_unlock(b->lock);
+    dt = apr_time_now() - dt;
+
+    for (i=0; i<MD_USER_STATS; i++) lat[i] = user[i].latency;
+    qsort(lat, MD_USER_STATS, sizeof(apr_time_t), md_cmp);
+    fprintf(stderr, "  %-6s interactive stat p50=%7.1fms p99=%7.1fms max=%7.1fms  total=%6.2fs\n", (fair) ? "fair" : "fifo",
+            lat[MD_USER_STATS/2] / 1000.0, lat[(MD_USER_STATS*99)/100] / 1000.0, lat[MD_USER_STATS-1] / 1000.0,
+            (double)dt / APR_USEC_PER_SEC);
+    if (fair) mq_dispatch_print(d, stderr);
+
+    mq_dispatch_destroy(d);
+    free(batch);
+    free(user);
+}
+
+BENCHMARK_IMPL(mq_dispatch) {
+    tbx_inip_file_t *ifd;
+    mq_context_t *mqc;
+    mq_portal_t *p;
+    apr_pool_t *mpool;
+    md_bench_t b;
+    char cfg[256];
+
+    snprintf(cfg, sizeof(cfg), "[mq]\nmin_threads=%d\nmax_threads=%d\n", MD_THREADS, MD_THREADS);
+    ifd = tbx_inip_string_read(cfg);
+    mqc = mq_create_context(ifd, "mq");
+    tbx_inip_destroy(ifd);
+    p = mq_portal_create(mqc, "bench", MQ_CMODE_SERVER);
+    mq_command_set(mq_portal_command_table(p), MD_STAT_KEY, strlen(MD_STAT_KEY), NULL, md_cmd);
+    mq_command_set(mq_portal_command_table(p), MD_SCAN_KEY, strlen(MD_SCAN_KEY), NULL, md_cmd);
+
+    apr_pool_create(&mpool, NULL);
+    memset(&b, 0, sizeof(b));
+    apr_thread_mutex_create(&(b.lock), APR_THREAD_MUTEX_DEFAULT, mpool);
+    apr_thread_cond_create(&(b.cond), mpool);
+
+    fprintf(stderr, "mq_dispatch: %d threads, batch client %d x %dms scans + %d x %dms stats, interactive %d stats every %dms\n",
+            MD_THREADS, MD_SCANS, MD_SCAN_US/1000, MD_BATCH_STATS, MD_STAT_US/1000, MD_USER_STATS, MD_USER_GAP_US/1000);
+    md_run(p, &b, 0);
+    md_run(p, &b, 1);
+    fflush(stderr);
+
+    mq_portal_destroy(p);
+    mq_destroy_context(mqc);
+    apr_pool_destroy(mpool);
+
+    return 0;
+}
@@ -0,0 +1,144 @@
+#include "task.h"
+#include <apr_time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <os_file_attr_log.h>
+
+// Compares the os_file attribute stores.  Each object gets the handful of
+// attributes an "ls -l" touches, which are then set and read back as a batch
+// using one file per attribute and the per object attribute log.
+
+#define OAB_OBJECTS   2000
+#define OAB_ATTRS     6
+#define OAB_ROUNDS    3
+#define OAB_PATH_MAX  4096
+
+static char *oab_key[OAB_ATTRS] = { "system.exnode", "system.exnode.size", "system.inode",
+                                    "system.modify_data", "user.owner", "user.mode" };
+
+static void oab_set_files(char *dir, char **val, int *v_size) {
+    FILE *fd;
+    char fname[OAB_PATH_MAX];
+    int i;
+
+    for (i=0; i<OAB_ATTRS; i++) {
+        snprintf(fname, OAB_PATH_MAX, "%s/%s", dir, oab_key[i]);
+        fd = fopen(fname, "w");
+        fwrite(val[i], v_size[i], 1, fd);
+        fclose(fd);
+    }
+}
+
+static int oab_get_files(char *dir, char *buf) {
+    FILE *fd;
+    char fname[OAB_PATH_MAX];
+    int i, n;
+
+    n = 0;
+    for (i=0; i<OAB_ATTRS; i++) {
+        snprintf(fname, OAB_PATH_MAX, "%s/%s", dir, oab_key[i]);
+        fd = fopen(fname, "r");
+        n += fread(buf, 1, 1024, fd);
+        fclose(fd);
+    }
+
+    return(n);
+}
+
+static void oab_set_log(char *dir, char **val, int *v_size) {
+    osf_alog_t *a;
+    int i;
+
+    a = osf_alog_load(dir);
+    for (i=0; i<OAB_ATTRS; i++) osf_alog_set(a, oab_key[i], val[i], v_size[i], 0);
+    osf_alog_flush(a);
+    osf_alog_destroy(a);
+}
+
+static int oab_get_log(char *dir, char *buf) {
+    osf_alog_t *a;
+    void *v;
+    int i, n, v_size;
+
+    n = 0;
+    a = osf_alog_load(dir);
+    for (i=0; i<OAB_ATTRS; i++) {
+        v = buf;
+        v_size = 1024;
+        osf_alog_get(a, oab_key[i], &v, &v_size);
+        n += v_size;
+    }
+    osf_alog_destroy(a);
+
+    return(n);
+}
+
+BENCHMARK_IMPL(os_attr) {
+    char base[] = "/tmp/benchmark-os-attr.XXXXXX";
+    char dir[OAB_PATH_MAX], cmd[OAB_PATH_MAX];
+    char buf[1024], vbuf[OAB_ATTRS][64];
+    char *val[OAB_ATTRS];
+    int v_size[OAB_ATTRS];
+    double dt_set[2], dt_get[2];
+    apr_time_t t;
+    int i, j, r, store;
+
+    if (mkdtemp(base) == NULL) {
+        fprintf(stderr, "os_attr: Unable to make the scratch directory\n");
+        return 1;
+    }
+
+    for (store=0; store<2; store++) {
+        for (i=0; i<OAB_OBJECTS; i++) {
+            snprintf(dir, OAB_PATH_MAX, "%s/%d/%d", base, store, i);
+            snprintf(cmd, OAB_PATH_MAX, "%s/%d", base, store);
+            if (i == 0) mkdir(cmd, S_IRWXU);
+            mkdir(dir, S_IRWXU);
+        }
+
+        dt_set[store] = dt_get[store] = 0;
+        for (r=0; r<OAB_ROUNDS; r++) {
+            for (j=0; j<OAB_ATTRS; j++) {
+                v_size[j] = snprintf(vbuf[j], sizeof(vbuf[j]), "value-%d-%d-%d", store, r, j);
+                val[j] = vbuf[j];
+            }
+
+            t = apr_time_now();
+            for (i=0; i<OAB_OBJECTS; i++) {
+                snprintf(dir, OAB_PATH_MAX, "%s/%d/%d", base, store, i);
+                if (store == OSF_ATTR_STORE_FILE) {
+                    oab_set_files(dir, val, v_size);
+                } else {
+                    oab_set_log(dir, val, v_size);
+                }
+            }
+            dt_set[store] += apr_time_now() - t;
+
+            t = apr_time_now();
+            for (i=0; i<OAB_OBJECTS; i++) {
+                snprintf(dir, OAB_PATH_MAX, "%s/%d/%d", base, store, i);
+                if (store == OSF_ATTR_STORE_FILE) {
+                    oab_get_files(dir, buf);
+                } else {
+                    oab_get_log(dir, buf);
+                }
+            }
+            dt_get[store] += apr_time_now() - t;
+        }
+    }
+
+    fprintf(stderr, "os_file attrs: %d objects, %d attrs per batch, %d rounds\n", OAB_OBJECTS, OAB_ATTRS, OAB_ROUNDS);
+    for (store=0; store<2; store++) {
+        fprintf(stderr, "  %-4s set=%10.0f batches/s get=%10.0f batches/s\n", (store == OSF_ATTR_STORE_FILE) ? "file" : "log",
+                (double)OAB_OBJECTS * OAB_ROUNDS * APR_USEC_PER_SEC / (dt_set[store] + 1),
+                (double)OAB_OBJECTS * OAB_ROUNDS * APR_USEC_PER_SEC / (dt_get[store] + 1));
+    }
+    fflush(stderr);
+
+    snprintf(cmd, OAB_PATH_MAX, "rm -rf %s", base);
+    if (system(cmd) != 0) fprintf(stderr, "os_attr: Unable to remove %s\n", base);
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+#include "task.h"
+#include <apr_hash.h>
+#include <apr_pools.h>
+#include <apr_thread_mutex.h>
+#include <apr_time.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tbx/type_malloc.h>
+#include <os_timecache_index.h>
+
+// Simulates the stat storm from parallel find/rsync jobs hitting the timecache.
+// Each lookup fetches the attributes a stat needs.  The old way walks the tree
+// a component at a time under one global lock.  The new way does a single
+// lookup in the striped path index holding just the stripe's read lock.
+
+#define SS_DIRS         100
+#define SS_FILES        100
+#define SS_ATTRS        6
+#define SS_STRIPES      64
+#define SS_MAX_THREADS  64
+#define SS_TOTAL_STATS  (1024*1024)
+#define SS_PATH_MAX     256
+
+static char *ss_key[SS_ATTRS] = { "system.inode", "system.exnode.size", "os.type",
+                                  "system.modify_data", "system.modify_attr", "os.link_count" };
+
+typedef struct {
+    char *fname;
+    char *path;
+    apr_hash_t *objects;
+    apr_hash_t *attrs;
+} ss_object_t;
+
+typedef struct {
+    ss_object_t *root;
+    ostc_index_t *idx;
+    apr_thread_mutex_t *global_lock;
+    char **path;
+    int start;
+    int n_stats;
+    int indexed;
+} ss_thread_t;
+
+static ss_object_t *ss_object_new(ss_object_t *parent, char *fname, int is_dir, apr_pool_t *mpool) {
+    ss_object_t *obj;
+    char path[SS_PATH_MAX];
+    int i;
+
+    tbx_type_malloc_clear(obj, ss_object_t, 1);
+    obj->fname = strdup(fname);
+    snprintf(path, SS_PATH_MAX, "%s/%s", ((parent) && (parent->path[1] != 0)) ? parent->path : "", fname);
+    obj->path = strdup(path);
+    obj->objects = (is_dir) ? apr_hash_make(mpool) : NULL;
+    obj->attrs = apr_hash_make(mpool);
+    for (i=0; i<SS_ATTRS; i++) apr_hash_set(obj->attrs, ss_key[i], APR_HASH_KEY_STRING, obj->path);
+    if (parent) apr_hash_set(parent->objects, obj->fname, APR_HASH_KEY_STRING, obj);
+
+    return(obj);
+}
+
+static ss_object_t *ss_walk(ss_object_t *root, char *fname) {
+    ss_object_t *curr;
+    int start, end;
+
+    curr = root;
+    start = 0;
+    while ((fname[start] != 0) && (curr != NULL)) {
+        while (fname[start] == '/') start++;
+        for (end=start; (fname[end] != '/') && (fname[end] != 0); end++) {}
+        if (end == start) break;
+        curr = (curr->objects) ? apr_hash_get(curr->objects, fname + start, end - start) : NULL;
+        start = end;
+    }
+
+    return(curr);
+}
+
+static int ss_stat(ss_object_t *obj, char *buf) {
+    char *val;
+    int i, n;
+
+    n = 0;
+    for (i=0; i<SS_ATTRS; i++) {
+        val = apr_hash_get(obj->attrs, ss_key[i], APR_HASH_KEY_STRING);
+        if (val == NULL) return(n);
+        n += strlen(val);
+        memcpy(buf, val, strlen(val)+1);
+    }
+
+    return(n);
+}
+
+static void *ss_reader(void *arg) {
+    ss_thread_t *t = (ss_thread_t *)arg;
+    ss_object_t *obj;
+    char buf[SS_PATH_MAX];
+    char *fname;
+    int i, stripe;
+
+    for (i=0; i<t->n_stats; i++) {
+        fname = t->path[(t->start + i) % (SS_DIRS*SS_FILES)];
+        if (t->indexed) {
+            stripe = ostc_index_stripe(t->idx, fname);
+            ostc_index_read_lock(t->idx, stripe);
+            obj = ostc_index_get(t->idx, stripe, fname);
+            if (obj != NULL) ss_stat(obj, buf);
+            ostc_index_unlock(t->idx, stripe);
+        } else {
+            apr_thread_mutex_lock(t->global_lock);
+            obj = ss_walk(t->root, fname);
+            if (obj != NULL) ss_stat(obj, buf);
+            apr_thread_mutex_unlock(t->global_lock);
+        }
+    }
+
+    return(NULL);
+}
+
+static double ss_run(ss_thread_t *base, int n_threads, int indexed) {
+    pthread_t tid[SS_MAX_THREADS];
+    ss_thread_t targ[SS_MAX_THREADS];
+    apr_time_t dt;
+    int i;
+
+    dt = apr_time_now();
+    for (i=0; i<n_threads; i++) {
+        targ[i] = *base;
+        targ[i].start = i * (SS_DIRS*SS_FILES) / n_threads;
+        targ[i].n_stats = SS_TOTAL_STATS / n_threads;
+        targ[i].indexed = indexed;
+        pthread_create(&(tid[i]), NULL, ss_reader, &(targ[i]));
+    }
+    for (i=0; i<n_threads; i++) pthread_join(tid[i], NULL);
+    dt = apr_time_now() - dt;
+    if (dt <= 0) dt = 1;
+
+    return((double)SS_TOTAL_STATS * APR_USEC_PER_SEC / dt);
+}
+
+BENCHMARK_IMPL(os_stat_storm) {
+    apr_pool_t *mpool;
+    ss_thread_t base;
+    ss_object_t **obj;
+    char name[SS_PATH_MAX];
+    double global, indexed;
+    int i, j, k, n, stripe;
+
+    apr_pool_create(&mpool, NULL);
+    memset(&base, 0, sizeof(base));
+    apr_thread_mutex_create(&(base.global_lock), APR_THREAD_MUTEX_DEFAULT, mpool);
+    base.idx = ostc_index_create(SS_STRIPES);
+
+    //** Build the tree and index every object by it's full path
+    tbx_type_malloc_clear(obj, ss_object_t *, SS_DIRS*SS_FILES + SS_DIRS + 2);
+    tbx_type_malloc_clear(base.path, char *, SS_DIRS*SS_FILES);
+    base.root = ss_object_new(NULL, "", 1, mpool);
+    obj[0] = ss_object_new(base.root, "lio", 1, mpool);
+    k = 1;
+    for (i=0; i<SS_DIRS; i++) {
+        snprintf(name, SS_PATH_MAX, "dir-%d", i);
+        obj[k] = ss_object_new(obj[0], name, 1, mpool);
+        n = k++;
+        for (j=0; j<SS_FILES; j++) {
+            snprintf(name, SS_PATH_MAX, "file-%d", j);
+            obj[k] = ss_object_new(obj[n], name, 0, mpool);
+            base.path[i*SS_FILES + j] = obj[k]->path;
+            k++;
+        }
+    }
+    for (i=0; i<k; i++) {
+        stripe = ostc_index_stripe(base.idx, obj[i]->path);
+        ostc_index_write_lock(base.idx, stripe);
+        ostc_index_set(base.idx, stripe, obj[i]->path, obj[i]);
+        ostc_index_unlock(base.idx, stripe);
+    }
+
+    fprintf(stderr, "timecache stat storm: %d objects, %d attrs per stat, %d stripes\n", k, SS_ATTRS, ostc_index_stripes(base.idx));
+    for (n=1; n<=SS_MAX_THREADS; n *= 2) {
+        global = ss_run(&base, n, 0);
+        indexed = ss_run(&base, n, 1);
+        fprintf(stderr, "  threads=%2d walk=%10.0f stats/s indexed=%10.0f stats/s speedup=%5.2f\n",
+                n, global, indexed, indexed / global);
+    }
+    fflush(stderr);
+
+    ostc_index_destroy(base.idx);
+    for (i=0; i<k; i++) {
+        free(obj[i]->fname);
+        free(obj[i]->path);
+        free(obj[i]);
+    }
+    free(base.root->fname);
+    free(base.root->path);
+    free(base.root);
+    free(obj);
+    free(base.path);
+    apr_pool_destroy(mpool);
+
+    return 0;
+}
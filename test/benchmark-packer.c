@@ -0,0 +1,113 @@
+#include "task.h"
+#include <apr_time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tbx/packer.h>
+#include <tbx/type_malloc.h>
+
+// Packs a listing like stream the way mq_stream does, in small writes that
+// are shipped whenever the chunk buffer fills, then unpacks it chunk by chunk.
+// Compares zlib against the LZ codec.
+
+#define PB_TOTAL_BYTES   (64*1024*1024)
+#define PB_CHUNK         (1024*1024)
+#define PB_WRITE         256
+
+static int pb_corpus(unsigned char *buf, int len) {
+    int n, i;
+
+    n = 0;
+    for (i=0; n < len; i++) {
+        n += snprintf((char *)&(buf[n]), len-n, "/lio/home/user%02d/project%03d/run_%06d/output.dat|size=%d|mode=0644|owner=user%02d\n",
+                      i % 37, (i / 100) % 200, i, (i * 7919) % 1000000, i % 37);
+    }
+
+    return(len);
+}
+
+static void pb_run(int type, char *name, unsigned char *src, int len) {
+    unsigned char *chunks, *out, *buf;
+    int *clen, nchunks, pos, n, err, i;
+    int64_t packed;
+    apr_time_t dt_pack, dt_unpack;
+    tbx_pack_t *pack;
+
+    nchunks = (len / PB_CHUNK) + 16;
+    tbx_type_malloc(chunks, unsigned char, (int64_t)nchunks * PB_CHUNK);
+    tbx_type_malloc_clear(clen, int, nchunks);
+    tbx_type_malloc(out, unsigned char, len);
+
+    //** Pack it shipping each chunk when it's full
+    dt_pack = apr_time_now();
+    n = 0;
+    buf = chunks;
+    pack = tbx_pack_create(type, PACK_WRITE, buf, PB_CHUNK);
+    for (pos=0; pos<len; ) {
+        err = tbx_pack_write(pack, &(src[pos]), (len-pos > PB_WRITE) ? PB_WRITE : len-pos);
+        if (err == PACK_ERROR) break;
+        if (err > 0) pos += err;
+        if ((pos < len) && (err < PB_WRITE)) {
+            clen[n++] = tbx_pack_used(pack);
+            buf = &(chunks[(int64_t)n * PB_CHUNK]);
+            tbx_pack_consumed(pack);
+            tbx_pack_write_resized(pack, buf, PB_CHUNK);
+        }
+    }
+    do {
+        err = tbx_pack_write_flush(pack);
+        clen[n++] = tbx_pack_used(pack);
+        buf = &(chunks[(int64_t)n * PB_CHUNK]);
+        tbx_pack_consumed(pack);
+        tbx_pack_write_resized(pack, buf, PB_CHUNK);
+    } while ((err != PACK_FINISHED) && (err != PACK_ERROR));
+    tbx_pack_destroy(pack);
+    dt_pack = apr_time_now() - dt_pack;
+    nchunks = n;
+
+    //** And unpack it
+    dt_unpack = apr_time_now();
+    pack = tbx_pack_create(type, PACK_READ, chunks, clen[0]);
+    pos = 0;
+    for (i=1; pos < len; ) {
+        err = tbx_pack_read(pack, &(out[pos]), len-pos);
+        if (err < 0) break;
+        pos += err;
+        if (pos < len) {
+            if (i >= nchunks) break;
+            tbx_pack_read_new_data(pack, &(chunks[(int64_t)i * PB_CHUNK]), clen[i]);
+            i++;
+        }
+    }
+    tbx_pack_destroy(pack);
+    dt_unpack = apr_time_now() - dt_unpack;
+
+    packed = 0;
+    for (i=0; i<nchunks; i++) packed += clen[i];
+    if (dt_pack <= 0) dt_pack = 1;
+    if (dt_unpack <= 0) dt_unpack = 1;
+
+    fprintf(stderr, "  %-5s chunks=%4d ratio=%5.2f pack=%7.1f MB/s unpack=%7.1f MB/s %s\n", name, nchunks, (double)len / packed,
+            (double)len * APR_USEC_PER_SEC / dt_pack / (1024*1024), (double)len * APR_USEC_PER_SEC / dt_unpack / (1024*1024),
+            ((pos == len) && (memcmp(src, out, len) == 0)) ? "" : "MISMATCH");
+
+    free(chunks);
+    free(clen);
+    free(out);
+}
+
+BENCHMARK_IMPL(packer) {
+    unsigned char *src;
+
+    tbx_type_malloc(src, unsigned char, PB_TOTAL_BYTES + 1);
+    pb_corpus(src, PB_TOTAL_BYTES + 1);
+
+    fprintf(stderr, "packer: %d MB listing text, %d byte writes, %d KB chunks\n", PB_TOTAL_BYTES/(1024*1024), PB_WRITE, PB_CHUNK/1024);
+    pb_run(PACK_COMPRESS, "zlib", src, PB_TOTAL_BYTES);
+    pb_run(PACK_LZ, "lz", src, PB_TOTAL_BYTES);
+    fflush(stderr);
+
+    free(src);
+
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "task.h"
+#include <apr_time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <tbx/random.h>
+#include <string.h>
+#include <raid4.h>
+
+// Reports RAID4 parity encode throughput for each XOR kernel the CPU supports
+// against the old memcpy then XOR a byte at a time loop.
+
+#define R4B_STRIPS      6
+#define R4B_TOTAL_BYTES (1024LL*1024*1024)   // Data bytes encoded per measurement
+
+static void r4b_bytewise(int n, char **data, char *parity, int nbytes) {
+    int i, j;
+
+    memcpy(parity, data[0], nbytes);
+    for (i=1; i<n; i++) {
+        for (j=0; j<nbytes; j++) parity[j] ^= data[i][j];
+    }
+}
+
+static double r4b_run(int isa, char **data, char *parity, int strip_size) {
+    apr_time_t dt;
+    long long i, n;
+
+    n = R4B_TOTAL_BYTES / ((long long)R4B_STRIPS * strip_size);
+    if (n < 1) n = 1;
+
+    dt = apr_time_now();
+    for (i=0; i<n; i++) {
+        if (isa < 0) {
+            r4b_bytewise(R4B_STRIPS, data, parity, strip_size);
+        } else {
+            raid4_encode(R4B_STRIPS, data, &parity, strip_size);
+        }
+    }
+    dt = apr_time_now() - dt;
+    if (dt <= 0) dt = 1;
+
+    return((double)n * R4B_STRIPS * strip_size / dt / 1000.0);  // GB/s
+}
+
+BENCHMARK_IMPL(raid4) {
+    int sizes[] = { 4096, 65536, 1048576 };
+    char *data[R4B_STRIPS];
+    char *parity;
+    double gbs;
+    tbx_rng_t rng;
+    int i, j, isa, size, current;
+
+    tbx_rng_seed(&rng, 1);
+    size = sizes[sizeof(sizes)/sizeof(int) - 1];
+    for (i=0; i<R4B_STRIPS; i++) {
+        data[i] = malloc(size);
+        for (j=0; j<size; j++) data[i][j] = tbx_rng_next(&rng);
+    }
+    parity = malloc(size);
+
+    current = raid4_get_isa();
+    fprintf(stderr, "raid4 encode: %d data strips, default kernel=%s\n", R4B_STRIPS, raid4_isa_name(current));
+    for (i=0; i<(int)(sizeof(sizes)/sizeof(int)); i++) {
+        size = sizes[i];
+        gbs = r4b_run(-1, data, parity, size);
+        fprintf(stderr, "  strip=%8d %-8s %7.2f GB/s\n", size, "bytewise", gbs);
+        for (isa=RAID4_ISA_SCALAR; isa<RAID4_ISA_MAX; isa++) {
+            if (raid4_set_isa(isa) != isa) continue;
+            gbs = r4b_run(isa, data, parity, size);
+            fprintf(stderr, "  strip=%8d %-8s %7.2f GB/s\n", size, raid4_isa_name(isa), gbs);
+        }
+    }
+    fflush(stderr);
+
+    raid4_set_isa(current);
+    for (i=0; i<R4B_STRIPS; i++) free(data[i]);
+    free(parity);
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "task.h"
+#include <apr_time.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <tbx/random.h>
+
+// Compares the OpenSSL backed tbx_random_get_int64, which serializes on a
+// global lock, with the per-thread tbx_random_fast_int64 as the number of
+// threads pulling random numbers grows.  This is the pattern rs_simple uses
+// when it picks a random starting RID for every block in a bulk allocation.
+
+#define RB_MAX_THREADS  16
+#define RB_TOTAL_CALLS  (2*1024*1024)
+
+typedef struct {
+    int n_calls;
+    int fast;
+    int64_t sum;
+} rb_thread_t;
+
+static void *rb_worker(void *arg) {
+    rb_thread_t *t = (rb_thread_t *)arg;
+    int64_t sum;
+    int i;
+
+    sum = 0;
+    if (t->fast) {
+        for (i=0; i<t->n_calls; i++) sum += tbx_random_fast_int64(0, 999);
+    } else {
+        for (i=0; i<t->n_calls; i++) sum += tbx_random_get_int64(0, 999);
+    }
+    t->sum = sum;
+
+    return(NULL);
+}
+
+static double rb_run(int n_threads, int fast) {
+    pthread_t tid[RB_MAX_THREADS];
+    rb_thread_t targ[RB_MAX_THREADS];
+    apr_time_t dt;
+    int i;
+
+    dt = apr_time_now();
+    for (i=0; i<n_threads; i++) {
+        targ[i].n_calls = RB_TOTAL_CALLS / n_threads;
+        targ[i].fast = fast;
+        pthread_create(&(tid[i]), NULL, rb_worker, &(targ[i]));
+    }
+    for (i=0; i<n_threads; i++) pthread_join(tid[i], NULL);
+    dt = apr_time_now() - dt;
+    if (dt <= 0) dt = 1;
+
+    return((double)RB_TOTAL_CALLS * APR_USEC_PER_SEC / dt);
+}
+
+BENCHMARK_IMPL(random) {
+    double crypto, fast;
+    int n;
+
+    tbx_random_startup();
+    fprintf(stderr, "random int64: %d calls split across the threads\n", RB_TOTAL_CALLS);
+    for (n=1; n<=RB_MAX_THREADS; n *= 2) {
+        crypto = rb_run(n, 0);
+        fast = rb_run(n, 1);
+        fprintf(stderr, "  threads=%2d openssl=%12.0f calls/s fast=%12.0f calls/s speedup=%7.1f\n",
+                n, crypto, fast, fast / crypto);
+    }
+    fflush(stderr);
+    tbx_random_shutdown();
+
+    return 0;
+}
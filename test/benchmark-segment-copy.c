@@ -0,0 +1,133 @@
+#include "task.h"
+#include <apr_time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <tbx/type_malloc.h>
+#include <ex3_abstract.h>
+#include <opque.h>
+#include <thread_pool.h>
+
+// Sweeps the number of buffers segment_copy keeps in flight.  The segments
+// are in memory but every read and write pays a fixed latency plus a per
+// stream transfer time like a single depot connection would.
+
+#define SCB_TOTAL_BYTES   (64*1024*1024)
+#define SCB_BUFSIZE       (8*1024*1024)
+#define SCB_LATENCY_US    1000              // Fixed cost per op
+#define SCB_STREAM_BW     (100*1024*1024)   // Bytes/s for a single op
+#define SCB_MAX_BUFS      16
+#define SCB_THREADS       64
+
+typedef struct {
+    char *data;
+    ex_off_t size;
+    thread_pool_context_t *tpc;
+} scb_seg_t;
+
+typedef struct {
+    scb_seg_t *s;
+    ex_tbx_iovec_t iov;
+    tbx_tbuf_t *buffer;
+    ex_off_t boff;
+    int is_write;
+} scb_op_t;
+
+static op_status_t scb_rw_fn(void *arg, int id) {
+    scb_op_t *op = (scb_op_t *)arg;
+    char *buf = (char *)op->buffer->buf.iov[0].iov_base + op->boff;
+
+    usleep(SCB_LATENCY_US + (op->iov.len * 1000000LL) / SCB_STREAM_BW);
+    if (op->is_write) {
+        memcpy(op->s->data + op->iov.offset, buf, op->iov.len);
+    } else {
+        memcpy(buf, op->s->data + op->iov.offset, op->iov.len);
+    }
+
+    return(op_success_status);
+}
+
+static op_generic_t *scb_rw(segment_t *seg, int n_iov, ex_tbx_iovec_t *iov, tbx_tbuf_t *buffer, ex_off_t boff, int is_write) {
+    scb_seg_t *s = (scb_seg_t *)seg->priv;
+    scb_op_t *op;
+
+    tbx_type_malloc(op, scb_op_t, 1);
+    op->s = s;
+    op->iov = iov[0];
+    op->buffer = buffer;
+    op->boff = boff;
+    op->is_write = is_write;
+
+    return(new_thread_pool_op(s->tpc, NULL, scb_rw_fn, (void *)op, free, 1));
+}
+
+static op_generic_t *scb_read(segment_t *seg, data_attr_t *da, segment_rw_hints_t *hints, int n_iov, ex_tbx_iovec_t *iov, tbx_tbuf_t *buffer, ex_off_t boff, int timeout) {
+    return(scb_rw(seg, n_iov, iov, buffer, boff, 0));
+}
+
+static op_generic_t *scb_write(segment_t *seg, data_attr_t *da, segment_rw_hints_t *hints, int n_iov, ex_tbx_iovec_t *iov, tbx_tbuf_t *buffer, ex_off_t boff, int timeout) {
+    return(scb_rw(seg, n_iov, iov, buffer, boff, 1));
+}
+
+static op_generic_t *scb_truncate(segment_t *seg, data_attr_t *da, ex_off_t new_size, int timeout) {
+    return(gop_dummy(op_success_status));
+}
+
+static ex_off_t scb_size(segment_t *seg) {
+    return(((scb_seg_t *)seg->priv)->size);
+}
+
+static void scb_seg_init(segment_t *seg, scb_seg_t *s, ex_id_t id, thread_pool_context_t *tpc) {
+    memset(seg, 0, sizeof(segment_t));
+    tbx_type_malloc_clear(s->data, char, SCB_TOTAL_BYTES);
+    s->size = SCB_TOTAL_BYTES;
+    s->tpc = tpc;
+    seg->header.id = id;
+    seg->priv = s;
+    seg->fn.read = scb_read;
+    seg->fn.write = scb_write;
+    seg->fn.truncate = scb_truncate;
+    seg->fn.size = scb_size;
+}
+
+BENCHMARK_IMPL(segment_copy) {
+    thread_pool_context_t *tpc;
+    segment_t src, dest;
+    scb_seg_t ssrc, sdest;
+    char *buffer;
+    apr_time_t dt;
+    op_status_t status;
+    double rate, base;
+    int i, n;
+
+    tpc = thread_pool_create_context("bench", 0, SCB_THREADS, 4);
+    scb_seg_init(&src, &ssrc, 1, tpc);
+    scb_seg_init(&dest, &sdest, 2, tpc);
+    for (i=0; i<SCB_TOTAL_BYTES; i++) ssrc.data[i] = i;
+    tbx_type_malloc(buffer, char, SCB_BUFSIZE);
+
+    fprintf(stderr, "segment_copy: %d MB, %d MB buffer, %dus latency, %d MB/s per op\n", SCB_TOTAL_BYTES/(1024*1024),
+            SCB_BUFSIZE/(1024*1024), SCB_LATENCY_US, SCB_STREAM_BW/(1024*1024));
+    base = 0;
+    for (n=1; n<=SCB_MAX_BUFS; n *= 2) {
+        memset(sdest.data, 0, SCB_TOTAL_BYTES);
+        dt = apr_time_now();
+        status = gop_sync_exec_status(segment_copy(tpc, NULL, NULL, &src, &dest, 0, 0, -1, SCB_BUFSIZE, buffer, n, 0, 60));
+        dt = apr_time_now() - dt;
+        if (dt <= 0) dt = 1;
+
+        rate = (double)SCB_TOTAL_BYTES * APR_USEC_PER_SEC / dt / (1024*1024);
+        if (n == 1) base = rate;
+        fprintf(stderr, "  n_bufs=%2d %8.1f MB/s speedup=%5.2f %s\n", n, rate, rate / base,
+                ((status.op_status == OP_STATE_SUCCESS) && (memcmp(ssrc.data, sdest.data, SCB_TOTAL_BYTES) == 0)) ? "" : "MISMATCH");
+    }
+    fflush(stderr);
+
+    thread_pool_destroy_context(tpc);
+    free(buffer);
+    free(ssrc.data);
+    free(sdest.data);
+
+    return 0;
+}
@@ -0,0 +1,91 @@
+#include "task.h"
+#include <apr_time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <tbx/atomic_counter.h>
+#include <opque.h>
+#include <thread_pool.h>
+
+// Compares small op throughput through thread_pool_context_t using the APR
+// thread pool and the work stealing executor.  Selected with GOP_TP_EXECUTOR.
+
+#define TPB_OPS         200000
+#define TPB_BATCH       10000
+#define TPB_CHILDREN    8
+#define TPB_THREADS     16
+
+typedef struct {
+    thread_pool_context_t *tpc;
+    tbx_atomic_unit32_t count;
+} tpb_arg_t;
+
+static op_status_t tpb_leaf(void *arg, int id) {
+    tpb_arg_t *a = (tpb_arg_t *)arg;
+
+    tbx_atomic_inc(a->count);
+    return(op_success_status);
+}
+
+static op_status_t tpb_nested(void *arg, int id) {
+    tpb_arg_t *a = (tpb_arg_t *)arg;
+    opque_t *q;
+    int i;
+
+    q = new_opque();
+    for (i=0; i<TPB_CHILDREN; i++) {
+        opque_add(q, new_thread_pool_op(a->tpc, NULL, tpb_leaf, arg, NULL, 1));
+    }
+    opque_waitall(q);
+    opque_free(q, OP_DESTROY);
+
+    tbx_atomic_inc(a->count);
+    return(op_success_status);
+}
+
+static double tpb_run(char *executor, int nested) {
+    tpb_arg_t a;
+    opque_t *q;
+    apr_time_t dt;
+    int i, j, n_ops, batch;
+
+    setenv("GOP_TP_EXECUTOR", executor, 1);
+    a.tpc = thread_pool_create_context("bench", 0, TPB_THREADS, 2);
+    tbx_atomic_set(a.count, 0);
+
+    n_ops = (nested) ? TPB_OPS / (TPB_CHILDREN + 1) : TPB_OPS;
+    batch = (nested) ? TPB_BATCH / (TPB_CHILDREN + 1) : TPB_BATCH;
+
+    dt = apr_time_now();
+    for (i=0; i<n_ops; i += batch) {
+        q = new_opque();
+        for (j=0; (j<batch) && (i+j<n_ops); j++) {
+            opque_add(q, new_thread_pool_op(a.tpc, NULL, (nested) ? tpb_nested : tpb_leaf, &a, NULL, 1));
+        }
+        opque_waitall(q);
+        opque_free(q, OP_DESTROY);
+    }
+    dt = apr_time_now() - dt;
+    if (dt <= 0) dt = 1;
+
+    thread_pool_destroy_context(a.tpc);
+
+    return((double)tbx_atomic_get(a.count) * APR_USEC_PER_SEC / dt);
+}
+
+BENCHMARK_IMPL(thread_pool) {
+    double apr, ws;
+    int nested;
+
+    fprintf(stderr, "thread pool ops: %d ops, %d threads, %d children per nested op\n", TPB_OPS, TPB_THREADS, TPB_CHILDREN);
+    for (nested=0; nested<2; nested++) {
+        apr = tpb_run("apr", nested);
+        ws = tpb_run("ws", nested);
+        fprintf(stderr, "  %-6s apr=%10.0f ops/s ws=%10.0f ops/s speedup=%5.2f\n",
+                (nested) ? "nested" : "flat", apr, ws, ws / apr);
+    }
+    fflush(stderr);
+
+    unsetenv("GOP_TP_EXECUTOR");
+
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include "task.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <tbx/atomic_counter.h>
+#include <opque.h>
+#include <thread_pool.h>
+
+// Every op fans out children and blocks in opque_waitall for them.  With far
+// more top level ops than threads every worker ends up a blocked parent so the
+// children have to get the overflow slots or the pool deadlocks.
+
+#define TGTP_THREADS    4
+#define TGTP_DEPTH      3
+#define TGTP_FANOUT     4
+#define TGTP_TOP_OPS    64
+
+typedef struct {
+    thread_pool_context_t *tpc;
+    pthread_mutex_t lock;
+    tbx_atomic_unit32_t n_done;
+    int n_top;
+    int max_top;
+} tgtp_t;
+
+typedef struct {
+    tgtp_t *t;
+    int level;
+} tgtp_op_t;
+
+static op_status_t tgtp_op(void *arg, int id) {
+    tgtp_op_t *op = (tgtp_op_t *)arg;
+    tgtp_t *t = op->t;
+    tgtp_op_t child[TGTP_FANOUT];
+    opque_t *q;
+    int i, err;
+
+    if (op->level == 0) {
+        pthread_mutex_lock(&(t->lock));
+        t->n_top++;
+        if (t->n_top > t->max_top) t->max_top = t->n_top;
+        pthread_mutex_unlock(&(t->lock));
+    }
+
+    err = OP_STATE_SUCCESS;
+    if (op->level < TGTP_DEPTH - 1) {
+        q = new_opque();
+        for (i=0; i<TGTP_FANOUT; i++) {
+            child[i].t = t;
+            child[i].level = op->level + 1;
+            opque_add(q, new_thread_pool_op(t->tpc, NULL, tgtp_op, &(child[i]), NULL, 1));
+        }
+        err = opque_waitall(q);
+        opque_free(q, OP_DESTROY);
+    }
+
+    if (op->level == 0) {
+        pthread_mutex_lock(&(t->lock));
+        t->n_top--;
+        pthread_mutex_unlock(&(t->lock));
+    }
+
+    tbx_atomic_inc(t->n_done);
+    return((err == OP_STATE_SUCCESS) ? op_success_status : op_failure_status);
+}
+
+TEST_IMPL(gop_thread_pool_nested) {
+    tgtp_t t;
+    tgtp_op_t top[TGTP_TOP_OPS];
+    opque_t *q;
+    int i, n_expected;
+
+    setenv("GOP_TP_EXECUTOR", "ws", 1);
+    t.tpc = thread_pool_create_context("test", 0, TGTP_THREADS, TGTP_DEPTH);
+    pthread_mutex_init(&(t.lock), NULL);
+    tbx_atomic_set(t.n_done, 0);
+    t.n_top = 0;
+    t.max_top = 0;
+
+    q = new_opque();
+    for (i=0; i<TGTP_TOP_OPS; i++) {
+        top[i].t = &t;
+        top[i].level = 0;
+        opque_add(q, new_thread_pool_op(t.tpc, NULL, tgtp_op, &(top[i]), NULL, 1));
+    }
+    ASSERT(opque_waitall(q) == OP_STATE_SUCCESS);
+    opque_free(q, OP_DESTROY);
+
+    // Every op ran and the top level ones stayed under the concurrency limit
+    n_expected = TGTP_TOP_OPS * (1 + TGTP_FANOUT + TGTP_FANOUT*TGTP_FANOUT);
+    ASSERT((int)tbx_atomic_get(t.n_done) == n_expected);
+    ASSERT(t.max_top <= t.tpc->max_concurrency);
+
+    thread_pool_destroy_context(t.tpc);
+    pthread_mutex_destroy(&(t.lock));
+    unsetenv("GOP_TP_EXECUTOR");
+
+    return 0;
+}
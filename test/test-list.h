@@ -1,9 +1,21 @@
 TEST_DECLARE(always_win)
 
+TEST_DECLARE(gop_thread_pool_nested)
+TEST_DECLARE(os_attr_log)
+TEST_DECLARE(tb_inip_string_read)
+TEST_DECLARE(tb_packer)
+TEST_DECLARE(tb_random)
 TEST_DECLARE(tb_stack)
 TEST_DECLARE(tb_stk_escape_text)
+TEST_DECLARE(tb_tbuf_fd)
 TASK_LIST_START
     TEST_ENTRY(always_win)
+    TEST_ENTRY(gop_thread_pool_nested)
+    TEST_ENTRY(os_attr_log)
+    TEST_ENTRY(tb_inip_string_read)
+    TEST_ENTRY(tb_packer)
+    TEST_ENTRY(tb_random)
     TEST_ENTRY(tb_stack)
     TEST_ENTRY(tb_stk_escape_text)
+    TEST_ENTRY(tb_tbuf_fd)
 TASK_LIST_END
@@ -0,0 +1,141 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include "task.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <os_file_attr_log.h>
+
+#define TOAL_PATH_MAX 4096
+
+static int toal_get(osf_alog_t *a, char *key, char *expected) {
+    char *val = NULL;
+    int v_size, err;
+
+    v_size = -1024;
+    err = osf_alog_get(a, key, (void **)&val, &v_size);
+    if (expected == NULL) return((err == 0) ? -1 : 0);
+    if (err != 0) return(-1);
+
+    err = ((v_size == (int)strlen(expected)) && (strcmp(val, expected) == 0)) ? 0 : -1;
+    free(val);
+    return(err);
+}
+
+static int64_t toal_size(char *fname) {
+    struct stat s;
+
+    return((stat(fname, &s) == 0) ? s.st_size : -1);
+}
+
+TEST_IMPL(os_attr_log) {
+    osf_alog_t *a;
+    struct stat s;
+    char dir[] = "/tmp/test-os-attr-log.XXXXXX";
+    char fname[TOAL_PATH_MAX], val[64];
+    char *key;
+    int i, n, fd;
+    int64_t before;
+    mode_t mask;
+
+    ASSERT(mkdtemp(dir) != NULL);
+    snprintf(fname, sizeof(fname), "%s/%s", dir, OSF_ALOG_NAME);
+
+    // Nothing is written until the flush and a missing log is empty
+    a = osf_alog_load(dir);
+    osf_alog_set(a, "user.a", "one", 3, 0);
+    osf_alog_set(a, "user.b", "two", 3, 0);
+    osf_alog_set(a, "user.c", "three", 5, 0);
+    ASSERT(toal_get(a, "user.a", "one") == 0);
+    ASSERT(toal_size(fname) == -1);
+    ASSERT(osf_alog_flush(a) == 0);
+    osf_alog_destroy(a);
+
+    // Replay picks up the latest record for each key including appends and removals
+    a = osf_alog_load(dir);
+    ASSERT(toal_get(a, "user.a", "one") == 0);
+    ASSERT(toal_get(a, "user.c", "three") == 0);
+    osf_alog_set(a, "user.a", "uno", 3, 0);
+    osf_alog_set(a, "user.b", "-more", 5, 1);
+    osf_alog_set(a, "user.c", NULL, -1, 0);
+    ASSERT(osf_alog_flush(a) == 0);
+    osf_alog_destroy(a);
+
+    a = osf_alog_load(dir);
+    ASSERT(toal_get(a, "user.a", "uno") == 0);
+    ASSERT(toal_get(a, "user.b", "two-more") == 0);
+    ASSERT(toal_get(a, "user.c", NULL) == 0);
+    ASSERT(osf_alog_exists(a, "user.c") == 0);
+    n = 0;
+    i = 0;
+    while (osf_alog_next(a, &i, &key) == 0) n++;
+    ASSERT(n == 2);
+    osf_alog_destroy(a);
+
+    // A torn tail is ignored on load and dropped by the next append
+    before = toal_size(fname);
+    fd = open(fname, O_WRONLY|O_APPEND);
+    ASSERT(fd != -1);
+    ASSERT(write(fd, "torn", 4) == 4);
+    close(fd);
+    a = osf_alog_load(dir);
+    ASSERT(toal_get(a, "user.a", "uno") == 0);
+    osf_alog_set(a, "user.d", "four", 4, 0);
+    ASSERT(osf_alog_flush(a) == 0);
+    osf_alog_destroy(a);
+    ASSERT(toal_size(fname) < before + 4 + 64);
+    a = osf_alog_load(dir);
+    ASSERT(toal_get(a, "user.d", "four") == 0);
+    ASSERT(toal_get(a, "user.b", "two-more") == 0);
+    osf_alog_destroy(a);
+
+    // Overwriting the same key leaves mostly dead records so the flush compacts it
+    a = osf_alog_load(dir);
+    for (i=0; i<400; i++) {
+        snprintf(val, sizeof(val), "value-%04d", i);
+        osf_alog_set(a, "user.hot", val, strlen(val), 0);
+        ASSERT(osf_alog_flush(a) == 0);
+    }
+    osf_alog_destroy(a);
+    ASSERT(toal_size(fname) < 4096);
+
+    // Compaction keeps every live key and the log's mode
+    a = osf_alog_load(dir);
+    ASSERT(toal_get(a, "user.hot", "value-0399") == 0);
+    ASSERT(toal_get(a, "user.a", "uno") == 0);
+    ASSERT(toal_get(a, "user.b", "two-more") == 0);
+    ASSERT(toal_get(a, "user.d", "four") == 0);
+    ASSERT(toal_get(a, "user.c", NULL) == 0);
+    osf_alog_destroy(a);
+
+    mask = umask(0);
+    umask(mask);
+    ASSERT(stat(fname, &s) == 0);
+    ASSERT((s.st_mode & 0777) == (0666 & ~mask));
+
+    // And an explicit compaction leaves no temp files behind
+    a = osf_alog_load(dir);
+    ASSERT(osf_alog_compact(a) == 0);
+    ASSERT(toal_get(a, "user.hot", "value-0399") == 0);
+    osf_alog_destroy(a);
+    ASSERT(unlink(fname) == 0);
+    ASSERT(rmdir(dir) == 0);
+
+    return 0;
+}
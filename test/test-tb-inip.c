@@ -0,0 +1,61 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include "task.h"
+#include <tbx/iniparse.h>
+#include <stdlib.h>
+#include <string.h>
+
+TEST_IMPL(tb_inip_string_read) {
+    tbx_inip_file_t *ifd;
+    tbx_inip_group_t *g;
+    tbx_inip_element_t *ele;
+    char *val;
+    int n;
+
+    ifd = tbx_inip_string_read("[view]\n"
+                               "default=1234 # comment\n"
+                               "segment=1234\n"
+                               "\n"
+                               "[segment-1234]\n"
+                               "type=lun\n"
+                               "block=0:0:4096\n"
+                               "block=1:4096:4096");
+    ASSERT(ifd != NULL);
+    ASSERT(tbx_inip_group_count(ifd) == 2);
+    ASSERT(tbx_inip_get_integer(ifd, "view", "default", 0) == 1234);
+
+    val = tbx_inip_get_string(ifd, "segment-1234", "type", NULL);
+    ASSERT(val != NULL);
+    ASSERT(strcmp(val, "lun") == 0);
+    free(val);
+
+    g = tbx_inip_group_find(ifd, "segment-1234");
+    ASSERT(g != NULL);
+    n = 0;
+    for (ele = tbx_inip_ele_first(g); ele != NULL; ele = tbx_inip_ele_next(ele)) {
+        if (strcmp(tbx_inip_ele_get_key(ele), "block") == 0) n++;
+    }
+    ASSERT(n == 2);  //** The last line has no newline
+
+    tbx_inip_destroy(ifd);
+
+    ifd = tbx_inip_string_read("");
+    ASSERT(ifd != NULL);
+    ASSERT(tbx_inip_group_count(ifd) == 0);
+    tbx_inip_destroy(ifd);
+
+    return 0;
+}
@@ -0,0 +1,98 @@
+#include "task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tbx/packer.h>
+#include <tbx/type_malloc.h>
+
+// Round trips a listing like stream through the packer the way mq_stream
+// does.  The chunk buffers are small so codec blocks get split across them
+// and the reads use odd sizes so they never line up with the writes.
+
+#define TP_TOTAL_BYTES   (256*1024)
+#define TP_CHUNK         1000
+#define TP_WRITE         37
+
+static int tp_round_trip(int type, unsigned char *src, int len) {
+    unsigned char *chunks, *out, *buf;
+    int *clen, nchunks, pos, n, err, i, nread, ok;
+    tbx_pack_t *pack;
+
+    nchunks = (2 * len / TP_CHUNK) + 16;
+    tbx_type_malloc(chunks, unsigned char, (int64_t)nchunks * TP_CHUNK);
+    tbx_type_malloc_clear(clen, int, nchunks);
+    tbx_type_malloc_clear(out, unsigned char, len + 1);
+
+    //** Pack it shipping each chunk when it's full
+    n = 0;
+    buf = chunks;
+    pack = tbx_pack_create(type, PACK_WRITE, buf, TP_CHUNK);
+    for (pos=0; (pos<len) && (n < nchunks-1); ) {
+        err = tbx_pack_write(pack, &(src[pos]), (len-pos > TP_WRITE) ? TP_WRITE : len-pos);
+        if (err == PACK_ERROR) break;
+        if (err > 0) pos += err;
+        if ((pos < len) && (err < TP_WRITE)) {
+            clen[n++] = tbx_pack_used(pack);
+            buf = &(chunks[(int64_t)n * TP_CHUNK]);
+            tbx_pack_consumed(pack);
+            tbx_pack_write_resized(pack, buf, TP_CHUNK);
+        }
+    }
+    do {
+        err = tbx_pack_write_flush(pack);
+        clen[n++] = tbx_pack_used(pack);
+        buf = &(chunks[(int64_t)n * TP_CHUNK]);
+        tbx_pack_consumed(pack);
+        tbx_pack_write_resized(pack, buf, TP_CHUNK);
+    } while ((err != PACK_FINISHED) && (err != PACK_ERROR) && (n < nchunks));
+    tbx_pack_destroy(pack);
+    ok = ((pos == len) && (err == PACK_FINISHED)) ? 0 : 1;
+    nchunks = n;
+    if (ok != 0) goto done;
+
+    //** And unpack it with read sizes that don't match the writes
+    pack = tbx_pack_create(type, PACK_READ, chunks, clen[0]);
+    pos = 0;
+    for (i=1, n=0; pos < len; n++) {
+        nread = 1 + (n * 53) % 211;
+        if (nread > len-pos) nread = len-pos;
+        err = tbx_pack_read(pack, &(out[pos]), nread);
+        if (err < 0) break;
+        pos += err;
+        if ((err == 0) && (pos < len)) {
+            if (i >= nchunks) break;
+            tbx_pack_read_new_data(pack, &(chunks[(int64_t)i * TP_CHUNK]), clen[i]);
+            i++;
+        }
+    }
+    tbx_pack_destroy(pack);
+
+    ok = ((pos == len) && (memcmp(src, out, len) == 0)) ? 0 : 1;
+
+done:
+    free(chunks);
+    free(clen);
+    free(out);
+
+    return(ok);
+}
+
+TEST_IMPL(tb_packer) {
+    unsigned char *src;
+    int n, i;
+
+    tbx_type_malloc(src, unsigned char, TP_TOTAL_BYTES + 1);
+    n = 0;
+    for (i=0; n < TP_TOTAL_BYTES; i++) {
+        n += snprintf((char *)&(src[n]), TP_TOTAL_BYTES+1-n, "/lio/home/user%02d/project%03d/run_%06d/output.dat|size=%d|mode=0644\n",
+                      i % 37, (i / 100) % 200, i, (i * 7919) % 1000000);
+    }
+
+    ASSERT(tp_round_trip(PACK_NONE, src, TP_TOTAL_BYTES) == 0);
+    ASSERT(tp_round_trip(PACK_COMPRESS, src, TP_TOTAL_BYTES) == 0);
+    ASSERT(tp_round_trip(PACK_LZ, src, TP_TOTAL_BYTES) == 0);
+
+    free(src);
+
+    return 0;
+}
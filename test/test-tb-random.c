@@ -0,0 +1,75 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include "task.h"
+#include <tbx/random.h>
+#include <pthread.h>
+#include <stdint.h>
+
+static void *tb_random_thread(void *arg) {
+    uint64_t *val = (uint64_t *)arg;
+
+    *val = tbx_random_fast_next();
+    return(NULL);
+}
+
+TEST_IMPL(tb_random) {
+    tbx_rng_t a, b;
+    pthread_t tid;
+    uint64_t x, y;
+    int64_t n;
+    double d;
+    int i, hit_lo, hit_hi;
+
+    // The same seed gives the same sequence and different seeds don't
+    tbx_rng_seed(&a, 12345);
+    tbx_rng_seed(&b, 12345);
+    for (i=0; i<1000; i++) ASSERT(tbx_rng_next(&a) == tbx_rng_next(&b));
+    tbx_rng_seed(&b, 12346);
+    ASSERT(tbx_rng_next(&a) != tbx_rng_next(&b));
+
+    // A zero seed still has to produce a usable state
+    tbx_rng_seed(&a, 0);
+    ASSERT((a.s[0] | a.s[1] | a.s[2] | a.s[3]) != 0);
+
+    // Ranges are inclusive on both ends
+    hit_lo = hit_hi = 0;
+    for (i=0; i<100000; i++) {
+        n = tbx_rng_get_int64(&a, -3, 3);
+        ASSERT((n >= -3) && (n <= 3));
+        if (n == -3) hit_lo = 1;
+        if (n == 3) hit_hi = 1;
+        d = tbx_rng_get_double(&a);
+        ASSERT((d >= 0) && (d < 1));
+    }
+    ASSERT(hit_lo && hit_hi);
+    ASSERT(tbx_rng_get_int64(&a, 7, 7) == 7);
+
+    // Reseeding the thread generator makes it reproducible
+    tbx_random_fast_seed(99);
+    x = tbx_random_fast_next();
+    tbx_random_fast_seed(99);
+    ASSERT(tbx_random_fast_next() == x);
+    n = tbx_random_fast_int64(10, 20);
+    ASSERT((n >= 10) && (n <= 20));
+
+    // Each thread gets it's own independently seeded generator
+    ASSERT(pthread_create(&tid, NULL, tb_random_thread, &y) == 0);
+    pthread_join(tid, NULL);
+    tbx_random_fast_seed(99);
+    ASSERT(y != tbx_random_fast_next());
+
+    return 0;
+}
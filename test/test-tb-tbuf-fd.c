@@ -0,0 +1,94 @@
+/*
+   Copyright 2016 Vanderbilt University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+#include "task.h"
+#include <tbx/transfer_buffer.h>
+#include <transfer_buffer.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+TEST_IMPL(tb_tbuf_fd) {
+    char fname[] = "/tmp/tb_tbuf_fd.XXXXXX";
+    char data[3*4096];
+    char buffer[5000];
+    tbx_tbuf_t tb, child;
+    tbx_tbuf_var_t tbv;
+    tbx_iovec_t *iov, half;
+    off_t foff;
+    int i, fd, ffd;
+
+    for (i=0; i<(int)sizeof(data); i++) data[i] = i % 251;
+    fd = mkstemp(fname);
+    ASSERT(fd != -1);
+    unlink(fname);
+    ASSERT(write(fd, data, sizeof(data)) == sizeof(data));
+
+    // A range that doesn't start on a page boundary
+    memset(buffer, 0xAA, sizeof(buffer));
+    ASSERT(tbx_tbuf_fd(&tb, 5000, fd, 3000, buffer) == 0);
+    ASSERT(tbx_tbuf_size(&tb) == 5000);
+
+    // Splitting it and finding the file behind it doesn't touch the data
+    tbx_tbuf_var_init(&tbv);
+    tbx_tbuf_var_nbytes_set(&tbv, 5000);
+    ASSERT(tbx_tbuf_next_layout(&tb, 0, &tbv) == TBUFFER_OK);
+    ASSERT(tbx_tbuf_var_n_iov_get(&tbv) == 1);
+    iov = tbx_tbuf_var_buffer_get(&tbv);
+    ASSERT(iov[0].iov_len == 5000);
+    ASSERT(tbx_tbuf_fd_lookup(&tb, (char *)iov[0].iov_base + 100, 200, &ffd, &foff) == 0);
+    ASSERT(ffd == fd);
+    ASSERT(foff == 3100);
+    ASSERT(tbx_tbuf_fd_lookup(&tb, (char *)iov[0].iov_base + 100, 5000, &ffd, &foff) != 0);
+    ASSERT(tbx_tbuf_fd_lookup(&tb, data, 10, &ffd, &foff) != 0);
+    ASSERT((unsigned char)buffer[0] == 0xAA);
+
+    // A buffer built from its iovecs maps back to the same file
+    half.iov_base = (char *)iov[0].iov_base + 2500;
+    half.iov_len = 2500;
+    tbx_tbuf_vec(&child, 2500, 1, &half);
+    ASSERT(tbx_tbuf_fd_lookup(&child, half.iov_base, 2500, &ffd, &foff) != 0);
+    tbx_tbuf_fd_inherit(&child, &tb);
+    ASSERT(tbx_tbuf_fd_lookup(&child, half.iov_base, 2500, &ffd, &foff) == 0);
+    ASSERT(foff == 5500);
+
+    // Asking for the data loads the whole range
+    tbx_tbuf_var_init(&tbv);
+    tbx_tbuf_var_nbytes_set(&tbv, 2500);
+    ASSERT(tbx_tbuf_next(&child, 0, &tbv) == TBUFFER_OK);
+    ASSERT(memcmp(buffer, data + 3000, 5000) == 0);
+
+    // A file that shrank is zero filled instead of faulting
+    memset(buffer, 0xAA, sizeof(buffer));
+    ASSERT(tbx_tbuf_fd(&tb, 5000, fd, 3000, buffer) == 0);
+    ASSERT(ftruncate(fd, 4000) == 0);
+    tbx_tbuf_var_init(&tbv);
+    tbx_tbuf_var_nbytes_set(&tbv, 5000);
+    ASSERT(tbx_tbuf_next(&tb, 0, &tbv) == TBUFFER_OK);
+    ASSERT(memcmp(buffer, data + 3000, 1000) == 0);
+    ASSERT(buffer[1000] == 0);
+    ASSERT(buffer[4999] == 0);
+
+    // Empty ranges aren't allowed
+    ASSERT(tbx_tbuf_fd(&tb, 0, fd, 0, buffer) != 0);
+
+    // Plain buffers aren't file ranges
+    tbx_tbuf_single(&tb, sizeof(data), data);
+    ASSERT(tbx_tbuf_fd_lookup(&tb, data, 10, &ffd, &foff) != 0);
+
+    close(fd);
+
+    return 0;
+}